@@ -2,6 +2,9 @@
 
 #include "mold.h"
 
+#include <tbb/parallel_for.h>
+#include <unordered_set>
+
 namespace mold {
 
 struct ArHdr {
@@ -65,7 +68,8 @@ FileType get_file_type(MappedFile<C> *mf) {
     return FileType::THIN_AR;
   if (data.starts_with("--- !tapi-tbd"))
     return FileType::TAPI;
-  if (data.starts_with("\xca\xfe\xba\xbe"))
+  if (data.starts_with("\xca\xfe\xba\xbe") ||
+      data.starts_with("\xca\xfe\xba\xbf"))
     return FileType::MACH_UNIVERSAL;
   if (is_text_file(mf))
     return FileType::TEXT;
@@ -80,13 +84,37 @@ static bool equal(const char *p, const char *q) {
   return memcmp(p, q, strlen(q)) == 0;
 }
 
+// Returns the offsets of archive members that define at least one
+// symbol according to the archive symbol table. Returns std::nullopt
+// if the archive has no symbol table.
+template <typename T>
+static std::optional<std::unordered_set<u64>>
+read_armap(u8 *body, u64 size) {
+  if (size < sizeof(T))
+    return {};
+
+  u64 num = *(T *)body;
+  if (size < (num + 1) * sizeof(T))
+    return {};
+
+  std::unordered_set<u64> offsets;
+  for (u64 i = 0; i < num; i++)
+    offsets.insert(((T *)body)[i + 1]);
+  return offsets;
+}
+
+// Returns the paths of thin archive members in the order they appear.
+// If `lazy` is true, members that the archive symbol table doesn't
+// refer to are omitted, since they can never be pulled out of the
+// archive to resolve an undefined symbol.
 template <typename C>
-std::vector<MappedFile<C> *>
-read_thin_archive_members(C &ctx, MappedFile<C> *mf) {
+std::vector<std::string>
+read_thin_archive_member_paths(C &ctx, MappedFile<C> *mf, bool lazy = false) {
   u8 *begin = mf->data;
   u8 *data = begin + 8;
-  std::vector<MappedFile<C> *> vec;
+  std::vector<std::pair<u64, std::string>> vec;
   std::string_view strtab;
+  std::optional<std::unordered_set<u64>> armap;
 
   while (data < begin + mf->size) {
     // Each header is aligned to a 2 byte boundary.
@@ -104,8 +132,14 @@ read_thin_archive_members(C &ctx, MappedFile<C> *mf) {
       continue;
     }
 
-    // Skip a symbol table.
-    if (equal(hdr.ar_name, "/ ")) {
+    // Read a symbol table.
+    if (equal(hdr.ar_name, "/ ") || equal(hdr.ar_name, "/SYM64/")) {
+      if (lazy) {
+        if (equal(hdr.ar_name, "/ "))
+          armap = read_armap<ubig32>(body, size);
+        else
+          armap = read_armap<ubig64>(body, size);
+      }
       data = body + size;
       continue;
     }
@@ -117,9 +151,29 @@ read_thin_archive_members(C &ctx, MappedFile<C> *mf) {
     std::string name(start, (const char *)strstr(start, "/\n"));
     std::string path = name.starts_with('/') ?
       name : std::string(path_dirname(mf->name)) + "/" + name;
-    vec.push_back(MappedFile<C>::must_open(ctx, path));
+    vec.push_back({data - begin, path});
     data = body;
   }
+
+  std::vector<std::string> paths;
+  for (auto &[offset, path] : vec)
+    if (!armap || armap->contains(offset))
+      paths.push_back(std::move(path));
+  return paths;
+}
+
+// Thin archives don't contain member files but only refer to them, and
+// a single archive may refer to thousands of files. We open them in
+// parallel.
+template <typename C>
+std::vector<MappedFile<C> *>
+read_thin_archive_members(C &ctx, MappedFile<C> *mf, bool lazy = false) {
+  std::vector<std::string> paths = read_thin_archive_member_paths(ctx, mf, lazy);
+  std::vector<MappedFile<C> *> vec(paths.size());
+
+  tbb::parallel_for((i64)0, (i64)paths.size(), [&](i64 i) {
+    vec[i] = MappedFile<C>::must_open(ctx, paths[i]);
+  });
   return vec;
 }
 
@@ -180,12 +234,12 @@ read_fat_archive_members(C &ctx, MappedFile<C> *mf) {
 
 template <typename C>
 std::vector<MappedFile<C> *>
-read_archive_members(C &ctx, MappedFile<C> *mf) {
+read_archive_members(C &ctx, MappedFile<C> *mf, bool lazy = false) {
   switch (get_file_type(mf)) {
   case FileType::AR:
     return read_fat_archive_members(ctx, mf);
   case FileType::THIN_AR:
-    return read_thin_archive_members(ctx, mf);
+    return read_thin_archive_members(ctx, mf, lazy);
   default:
     unreachable();
   }
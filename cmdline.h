@@ -4,47 +4,86 @@
 
 namespace mold {
 
+// Response files generated by build systems can be several megabytes
+// long, so we tokenize them in place. A token is a view into the
+// mapped file, which lives as long as `ctx`. Only quoted tokens
+// containing backslashes need to be copied.
+//
+// A response file can refer to other response files with "@file".
+// They are expanded recursively.
 template <typename C>
-std::vector<std::string_view>
-read_response_file(C &ctx, std::string_view path) {
-  std::vector<std::string_view> vec;
+void read_response_file(C &ctx, std::string_view path,
+                        std::vector<std::string_view> &vec, i64 depth) {
+  if (depth > 100)
+    Fatal(ctx) << path << ": response files nested too deeply";
+
   MappedFile<C> *mf = MappedFile<C>::must_open(ctx, std::string(path));
-  u8 *data = mf->data;
+  std::string_view data = mf->get_contents();
+
+  static constexpr auto is_space = [] {
+    std::array<bool, 256> tab = {};
+    for (u8 c : std::string_view(" \t\n\v\f\r"))
+      tab[c] = true;
+    return tab;
+  }();
+
+  auto add = [&](std::string_view tok) {
+    if (tok.starts_with('@'))
+      read_response_file(ctx, tok.substr(1), vec, depth + 1);
+    else
+      vec.push_back(tok);
+  };
 
   auto read_quoted = [&](i64 i, char quote) {
+    i64 end = data.find(quote, i);
+    if (end == data.npos)
+      Fatal(ctx) << path << ": premature end of input";
+
+    std::string_view tok = data.substr(i, end - i);
+    if (tok.find('\\') == tok.npos) {
+      add(tok);
+      return end + 1;
+    }
+
+    // Unescape the token. A backslash may escape the quote character,
+    // so we have to scan again from the beginning of the token.
     std::string buf;
-    while (i < mf->size && data[i] != quote) {
-      if (data[i] == '\\') {
+    while (i < data.size() && data[i] != quote) {
+      if (data[i] == '\\' && i + 1 < data.size()) {
         buf.append(1, data[i + 1]);
         i += 2;
       } else {
         buf.append(1, data[i++]);
       }
     }
-    if (i >= mf->size)
+    if (i >= data.size())
       Fatal(ctx) << path << ": premature end of input";
-    vec.push_back(save_string(ctx, buf));
+    add(save_string(ctx, buf));
     return i + 1;
   };
 
-  auto read_unquoted = [&](i64 i) {
-    std::string buf;
-    while (i < mf->size && !isspace(data[i]))
-      buf.append(1, data[i++]);
-    vec.push_back(save_string(ctx, buf));
-    return i;
-  };
-
-  for (i64 i = 0; i < mf->size;) {
-    if (isspace(data[i]))
+  for (i64 i = 0; i < data.size();) {
+    if (is_space[(u8)data[i]]) {
       i++;
-    else if (data[i] == '\'')
+    } else if (data[i] == '\'') {
       i = read_quoted(i + 1, '\'');
-    else if (data[i] == '\"')
+    } else if (data[i] == '\"') {
       i = read_quoted(i + 1, '\"');
-    else
-      i = read_unquoted(i);
+    } else {
+      i64 j = i + 1;
+      while (j < data.size() && !is_space[(u8)data[j]])
+        j++;
+      add(data.substr(i, j - i));
+      i = j;
+    }
   }
+}
+
+template <typename C>
+std::vector<std::string_view>
+read_response_file(C &ctx, std::string_view path) {
+  std::vector<std::string_view> vec;
+  read_response_file(ctx, path, vec, 0);
   return vec;
 }
 
@@ -53,7 +92,7 @@ std::vector<std::string_view> expand_response_files(C &ctx, char **argv) {
   std::vector<std::string_view> vec;
   for (i64 i = 0; argv[i]; i++) {
     if (argv[i][0] == '@')
-      append(vec, read_response_file(ctx, argv[i] + 1));
+      read_response_file(ctx, argv[i] + 1, vec, 0);
     else
       vec.push_back(argv[i]);
   }
@@ -1,4 +1,5 @@
-// This file implements a multi-threaded zlib compression routine.
+// This file implements multi-threaded zlib and zstd compression
+// routines.
 //
 // Multiple pieces of raw compressed data in zlib-format can be merged
 // just by concatenation as long as each zlib stream is flushed with
@@ -7,33 +8,200 @@
 // append a header, a trailer and a checksum so that the concatenated
 // data is valid zlib-format data.
 //
+// Zstandard is simpler in that respect. A zstd stream may consist of
+// multiple independent frames, so we compress each shard as a
+// separate frame and concatenate them without any extra header.
+//
 // Using threads to compress data has a downside. Since the dictionary
 // is reset on boundaries of shards, compression ratio is sacrificed
 // a little bit. However, if a shard size is large enough, that loss
 // is negligible in practice.
+//
+// The same property allows us to splice data that is already
+// compressed (e.g. compressed debug sections in input files) into
+// output without decompressing and compressing it again. A zstd
+// stream can be copied as-is. A zlib stream needs a little bit of
+// surgery: we have to clear its last-block bit and pad it to a byte
+// boundary with empty blocks. We do the same as zlib's
+// examples/gzjoin.c does.
+//
+// For zlib and gzip, we use libdeflate instead of zlib to compress
+// shards if it's available at runtime, as it's a few times faster than
+// zlib. libdeflate can only create complete zlib streams, so we turn
+// its output into concatenable data with the above surgery.
 
 #include "mold.h"
 
-#include <tbb/parallel_for_each.h>
+#include <dlfcn.h>
+#include <tbb/parallel_for.h>
 #include <zlib.h>
+#include <zstd.h>
 
 namespace mold {
 
 static constexpr i64 SHARD_SIZE = 1024 * 1024;
 
-static std::vector<std::string_view> split(std::string_view input) {
-  std::vector<std::string_view> shards;
+namespace {
+struct Shard {
+  i64 offset = 0;
+  i64 size = 0;
+  const CompressedRange *range = nullptr;
+};
+}
+
+// Splits input into shards. Each precompressed range becomes a shard
+// of its own, and the gaps between them are split into SHARD_SIZE
+// pieces.
+static std::vector<Shard>
+split_shards(i64 size, std::span<const CompressedRange> ranges) {
+  std::vector<Shard> vec;
+
+  auto add_gap = [&](i64 begin, i64 end) {
+    for (i64 i = begin; i < end; i += SHARD_SIZE)
+      vec.push_back({i, std::min(SHARD_SIZE, end - i)});
+  };
 
-  while (input.size() >= SHARD_SIZE) {
-    shards.push_back(input.substr(0, SHARD_SIZE));
-    input = input.substr(SHARD_SIZE);
+  i64 pos = 0;
+  for (const CompressedRange &r : ranges) {
+    assert(pos <= r.offset);
+    add_gap(pos, r.offset);
+    vec.push_back({r.offset, r.size, &r});
+    pos = r.offset + r.size;
   }
-  if (!input.empty())
-    shards.push_back(input);
-  return shards;
+  add_gap(pos, size);
+  return vec;
 }
 
-static std::vector<u8> do_compress(std::string_view input) {
+// Materializes a given shard into a temporary buffer and calls `fn`
+// with it. The buffer is freed as soon as `fn` returns.
+template <typename Fn>
+static void read_shard(const CompressorInput &input, const Shard &shard,
+                       Fn fn) {
+  std::unique_ptr<u8[]> buf(new u8[shard.size]);
+  input(buf.get(), shard.offset, shard.size);
+  fn(std::string_view((char *)buf.get(), shard.size));
+}
+
+static CompressorInput from_buffer(std::string_view buf) {
+  return [=](u8 *out, i64 offset, i64 size) {
+    memcpy(out, buf.data() + offset, size);
+  };
+}
+
+// Converts a zlib-format stream into raw deflate data that can be
+// followed by other raw deflate data, i.e. one that doesn't end with
+// a last block and ends at a byte boundary. Returns false if `data`
+// is not a zlib stream which inflates to `size` bytes.
+static bool splice_zlib(std::string_view data, i64 size,
+                        std::vector<u8> &out, u32 &adler) {
+  // Verify the zlib header. We don't support preset dictionaries.
+  if (data.size() < 7)
+    return false;
+  u8 cmf = data[0];
+  u8 flg = data[1];
+  if ((cmf & 0xf) != Z_DEFLATED || (cmf * 256 + flg) % 31 || (flg & 0x20))
+    return false;
+
+  out.assign(data.begin() + 2, data.end());
+
+  z_stream strm = {};
+  if (inflateInit2(&strm, -15) != Z_OK)
+    return false;
+
+  strm.next_in = out.data();
+  strm.avail_in = out.size();
+
+  // Inflate the stream one block at a time to find the last-block
+  // bit of each block and clear it if it is set. Inflated data is
+  // discarded.
+  u8 junk[32768];
+  i64 len = 0;
+  bool last = out[0] & 1;
+  out[0] &= ~1;
+
+  for (;;) {
+    strm.next_out = junk;
+    strm.avail_out = sizeof(junk);
+    if (inflate(&strm, Z_BLOCK) != Z_OK) {
+      inflateEnd(&strm);
+      return false;
+    }
+
+    len += sizeof(junk) - strm.avail_out;
+    if (len > size) {
+      inflateEnd(&strm);
+      return false;
+    }
+
+    if (!(strm.data_type & 128))
+      continue;
+    if (last)
+      break;
+
+    // The next block header starts right after the unused bits of
+    // the last consumed byte, or at the next byte if there's none.
+    i64 pos = strm.data_type & 7;
+    u8 *p;
+    u8 mask;
+
+    if (pos) {
+      p = strm.next_in - 1;
+      mask = 0x100 >> pos;
+    } else {
+      if (strm.avail_in == 0) {
+        inflateEnd(&strm);
+        return false;
+      }
+      p = strm.next_in;
+      mask = 1;
+    }
+
+    last = *p & mask;
+    *p &= ~mask;
+  }
+
+  i64 used = strm.next_in - out.data();
+  i64 pos = strm.data_type & 7;
+  inflateEnd(&strm);
+
+  // A zlib stream ends with an Adler-32 checksum of its contents.
+  if (len != size || out.size() < used + 4)
+    return false;
+  adler = *(ubig32 *)(out.data() + used);
+  out.resize(used);
+
+  if (pos == 0)
+    return true;
+
+  // Pad the stream to a byte boundary with empty blocks. An empty
+  // stored block takes 3 bits plus padding and 4 bytes, and an empty
+  // fixed block takes 10 bits.
+  out.back() &= (0x100 >> pos) - 1;
+
+  if (pos & 1) {
+    if (pos == 1)
+      out.push_back(0);
+    out.insert(out.end(), {0, 0, 0xff, 0xff});
+    return true;
+  }
+
+  switch (pos) {
+  case 6:
+    out.back() |= 8;
+    out.push_back(0);
+    [[fallthrough]];
+  case 4:
+    out.back() |= 0x20;
+    out.push_back(0);
+    [[fallthrough]];
+  case 2:
+    out.back() |= 0x80;
+    out.push_back(0);
+  }
+  return true;
+}
+
+static std::vector<u8> zlib_compress(std::string_view input) {
   // Initialize zlib stream. Since debug info is generally compressed
   // pretty well, we chose compression level 3.
   z_stream strm;
@@ -63,21 +231,121 @@ static std::vector<u8> do_compress(std::string_view input) {
   return buf;
 }
 
-ZlibCompressor::ZlibCompressor(std::string_view input) {
-  std::vector<std::string_view> inputs = split(input);
-  std::vector<u64> adlers(inputs.size());
-  shards.resize(inputs.size());
+namespace {
+struct Libdeflate {
+  void *(*alloc_compressor)(int level);
+  void (*free_compressor)(void *compressor);
+  size_t (*zlib_compress)(void *compressor, const void *in, size_t in_size,
+                          void *out, size_t out_size);
+  size_t (*zlib_compress_bound)(void *compressor, size_t in_size);
+  u32 (*crc32)(u32 crc, const void *buf, size_t len);
+};
+}
 
-  // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    adlers[i] = adler32(1, (u8 *)inputs[i].data(), inputs[i].size());
-    shards[i] = do_compress(inputs[i]);
+// libdeflate is loaded with dlopen() so that it's not a build-time
+// dependency. Setting MOLD_NO_LIBDEFLATE disables it.
+static Libdeflate *get_libdeflate() {
+  static Libdeflate *lib = []() -> Libdeflate * {
+    if (char *env = getenv("MOLD_NO_LIBDEFLATE"); env && env[0])
+      return nullptr;
+
+#ifdef __APPLE__
+    void *handle = dlopen("libdeflate.0.dylib", RTLD_NOW | RTLD_LOCAL);
+#else
+    void *handle = dlopen("libdeflate.so.0", RTLD_NOW | RTLD_LOCAL);
+#endif
+    if (!handle)
+      return nullptr;
+
+    static Libdeflate lib;
+    *(void **)&lib.alloc_compressor =
+      dlsym(handle, "libdeflate_alloc_compressor");
+    *(void **)&lib.free_compressor =
+      dlsym(handle, "libdeflate_free_compressor");
+    *(void **)&lib.zlib_compress = dlsym(handle, "libdeflate_zlib_compress");
+    *(void **)&lib.zlib_compress_bound =
+      dlsym(handle, "libdeflate_zlib_compress_bound");
+    *(void **)&lib.crc32 = dlsym(handle, "libdeflate_crc32");
+
+    if (!lib.alloc_compressor || !lib.free_compressor || !lib.zlib_compress ||
+        !lib.zlib_compress_bound || !lib.crc32)
+      return nullptr;
+    return &lib;
+  }();
+  return lib;
+}
+
+// Compresses a given shard with libdeflate. libdeflate's level 1 is
+// about twice as fast as zlib's level 3 and compresses slightly better.
+// A libdeflate compressor is not thread-safe, so each thread has its
+// own. Returns false if libdeflate is not available.
+static bool libdeflate_compress(std::string_view input, std::vector<u8> &out,
+                                u32 &adler) {
+  Libdeflate *lib = get_libdeflate();
+  if (!lib)
+    return false;
+
+  struct Compressor {
+    Compressor(Libdeflate *lib) : lib(lib), ptr(lib->alloc_compressor(1)) {}
+    ~Compressor() { lib->free_compressor(ptr); }
+    Libdeflate *lib;
+    void *ptr;
+  };
+
+  thread_local Compressor c(lib);
+  if (!c.ptr)
+    return false;
+
+  std::vector<u8> buf(lib->zlib_compress_bound(c.ptr, input.size()));
+  size_t sz = lib->zlib_compress(c.ptr, input.data(), input.size(),
+                                 buf.data(), buf.size());
+  if (sz == 0)
+    return false;
+
+  return splice_zlib({(char *)buf.data(), sz}, input.size(), out, adler);
+}
+
+// Compresses a given shard into raw deflate data that ends at a byte
+// boundary without a last block, and computes its Adler-32 checksum.
+static std::vector<u8> do_compress(std::string_view input, u32 &adler) {
+  std::vector<u8> buf;
+  if (libdeflate_compress(input, buf, adler))
+    return buf;
+
+  adler = adler32(1, (u8 *)input.data(), input.size());
+  return zlib_compress(input);
+}
+
+static u32 compute_crc32(std::string_view input) {
+  if (Libdeflate *lib = get_libdeflate())
+    return lib->crc32(0, input.data(), input.size());
+  return crc32(0, (u8 *)input.data(), input.size());
+}
+
+ZlibCompressor::ZlibCompressor(std::string_view input)
+  : ZlibCompressor(input.size(), from_buffer(input)) {}
+
+ZlibCompressor::ZlibCompressor(i64 size, CompressorInput input,
+                               std::span<const CompressedRange> ranges) {
+  std::vector<Shard> vec = split_shards(size, ranges);
+  std::vector<u32> adlers(vec.size());
+  shards.resize(vec.size());
+
+  // Compress each shard, or splice it if it's already compressed
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    if (vec[i].range &&
+        splice_zlib(vec[i].range->data, vec[i].size, shards[i], adlers[i]))
+      return;
+
+    read_shard(input, vec[i], [&](std::string_view data) {
+      shards[i] = do_compress(data, adlers[i]);
+    });
   });
 
   // Combine checksums
-  checksum = adlers[0];
-  for (i64 i = 1; i < inputs.size(); i++)
-    checksum = adler32_combine(checksum, adlers[i], inputs[i].size());
+  checksum = 1;
+  for (i64 i = 0; i < vec.size(); i++)
+    checksum = adler32_combine(checksum, adlers[i], vec[i].size);
 }
 
 i64 ZlibCompressor::size() const {
@@ -94,9 +362,10 @@ void ZlibCompressor::write_to(u8 *buf) {
 
   // Copy compressed data
   std::vector<i64> offsets(shards.size());
-  offsets[0] = 2; // +2 for header
-  for (i64 i = 1; i < shards.size(); i++)
-    offsets[i] = offsets[i - 1] + shards[i - 1].size();
+  for (i64 i = 0, off = 2; i < shards.size(); i++) { // +2 for header
+    offsets[i] = off;
+    off += shards[i].size();
+  }
 
   tbb::parallel_for((i64)0, (i64)shards.size(), [&](i64 i) {
     memcpy(&buf[offsets[i]], shards[i].data(), shards[i].size());
@@ -111,23 +380,29 @@ void ZlibCompressor::write_to(u8 *buf) {
   *(ubig32 *)(end - 4) = checksum;
 }
 
-GzipCompressor::GzipCompressor(std::string_view input) {
-  std::vector<std::string_view> inputs = split(input);
-  std::vector<u32> crc(inputs.size());
-  shards.resize(inputs.size());
+GzipCompressor::GzipCompressor(std::string_view input)
+  : GzipCompressor(input.size(), from_buffer(input)) {}
+
+GzipCompressor::GzipCompressor(i64 size, CompressorInput input) {
+  std::vector<Shard> vec = split_shards(size, {});
+  std::vector<u32> crc(vec.size());
+  shards.resize(vec.size());
 
   // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    crc[i] = crc32(0, (u8 *)inputs[i].data(), inputs[i].size());
-    shards[i] = do_compress(inputs[i]);
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    read_shard(input, vec[i], [&](std::string_view data) {
+      u32 adler;
+      crc[i] = compute_crc32(data);
+      shards[i] = do_compress(data, adler);
+    });
   });
 
   // Combine checksums
-  checksum = crc[0];
-  for (i64 i = 1; i < inputs.size(); i++)
-    checksum = crc32_combine(checksum, crc[i], inputs[i].size());
+  checksum = 0;
+  for (i64 i = 0; i < vec.size(); i++)
+    checksum = crc32_combine(checksum, crc[i], vec[i].size);
 
-  uncompressed_size = input.size();
+  uncompressed_size = size;
 }
 
 i64 GzipCompressor::size() const {
@@ -147,9 +422,10 @@ void GzipCompressor::write_to(u8 *buf) {
 
   // Copy compressed data
   std::vector<i64> offsets(shards.size());
-  offsets[0] = 10; // +10 for header
-  for (i64 i = 1; i < shards.size(); i++)
-    offsets[i] = offsets[i - 1] + shards[i - 1].size();
+  for (i64 i = 0, off = 10; i < shards.size(); i++) { // +10 for header
+    offsets[i] = off;
+    off += shards[i].size();
+  }
 
   tbb::parallel_for((i64)0, (i64)shards.size(), [&](i64 i) {
     memcpy(&buf[offsets[i]], shards[i].data(), shards[i].size());
@@ -163,4 +439,67 @@ void GzipCompressor::write_to(u8 *buf) {
   *(u32 *)(end - 4) = uncompressed_size;
 }
 
+// Returns true if `data` consists of zstd frames whose total content
+// size is `size`. A frame without a content size is not accepted.
+static bool is_zstd_frames(std::string_view data, i64 size) {
+  while (!data.empty()) {
+    size_t len = ZSTD_findFrameCompressedSize(data.data(), data.size());
+    u64 sz = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (ZSTD_isError(len) || sz == ZSTD_CONTENTSIZE_UNKNOWN ||
+        sz == ZSTD_CONTENTSIZE_ERROR || size < sz)
+      return false;
+    size -= sz;
+    data = data.substr(len);
+  }
+  return size == 0;
+}
+
+ZstdCompressor::ZstdCompressor(std::string_view input)
+  : ZstdCompressor(input.size(), from_buffer(input)) {}
+
+ZstdCompressor::ZstdCompressor(i64 size, CompressorInput input,
+                               std::span<const CompressedRange> ranges) {
+  std::vector<Shard> vec = split_shards(size, ranges);
+  shards.resize(vec.size());
+
+  // Compress each shard into an independent zstd frame. We chose
+  // compression level 3 (zstd's default) for the same reason as zlib.
+  // Precompressed zstd frames are copied as-is if they are supposed to
+  // be decompressed to the right size.
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    if (const CompressedRange *r = vec[i].range) {
+      if (is_zstd_frames(r->data, vec[i].size)) {
+        shards[i].assign(r->data.begin(), r->data.end());
+        return;
+      }
+    }
+
+    read_shard(input, vec[i], [&](std::string_view data) {
+      std::vector<u8> &buf = shards[i];
+      buf.resize(ZSTD_compressBound(data.size()));
+      size_t sz = ZSTD_compress(buf.data(), buf.size(), data.data(),
+                                data.size(), 3);
+      assert(!ZSTD_isError(sz));
+      buf.resize(sz);
+    });
+  });
+}
+
+i64 ZstdCompressor::size() const {
+  i64 size = 0;
+  for (const std::vector<u8> &shard : shards)
+    size += shard.size();
+  return size;
+}
+
+void ZstdCompressor::write_to(u8 *buf) {
+  std::vector<i64> offsets(shards.size());
+  for (i64 i = 1; i < shards.size(); i++)
+    offsets[i] = offsets[i - 1] + shards[i - 1].size();
+
+  tbb::parallel_for((i64)0, (i64)shards.size(), [&](i64 i) {
+    memcpy(&buf[offsets[i]], shards[i].data(), shards[i].size());
+  });
+}
+
 } // namespace mold
@@ -2,10 +2,11 @@
 
 #include <cstdlib>
 #include <cxxabi.h>
+#include <tbb/concurrent_unordered_map.h>
 
 namespace mold {
 
-std::string_view demangle(std::string_view name) {
+std::string_view demangle_uncached(std::string_view name) {
   if (name.starts_with("_Z")) {
     static thread_local char *buf1;
     static thread_local char *buf2;
@@ -25,4 +26,20 @@ std::string_view demangle(std::string_view name) {
   return name;
 }
 
+// The same symbol is often demangled many times, e.g. once for each
+// error message mentioning it, so we memoize results. Keys are not
+// copied; `name` must live as long as the process, which is the case
+// for interned symbol names.
+std::string_view demangle(std::string_view name) {
+  if (!name.starts_with("_Z"))
+    return name;
+
+  static tbb::concurrent_unordered_map<std::string_view, std::string> cache;
+
+  auto it = cache.find(name);
+  if (it == cache.end())
+    it = cache.insert({name, std::string(demangle_uncached(name))}).first;
+  return it->second;
+}
+
 } // namespace mold
@@ -1,4 +1,6 @@
 #include "mold.h"
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
 
 namespace mold::elf {
 
@@ -17,6 +19,14 @@ static u64 page(u64 val) {
   return val & ~(u64)0xfff;
 }
 
+// B and BL take a 26-bit immediate scaled by 4, so they can jump
+// within ±128 MiB of the instruction.
+static constexpr i64 BRANCH_REACH = 1 << 27;
+
+static bool is_branch_reachable(i64 val) {
+  return -BRANCH_REACH <= val && val < BRANCH_REACH;
+}
+
 template <>
 void GotPltSection<AARCH64>::copy_buf(Context<AARCH64> &ctx) {
   u64 *buf = (u64 *)(ctx.buf + this->shdr.sh_offset);
@@ -122,21 +132,126 @@ void EhFrameSection<AARCH64>::apply_reloc(Context<AARCH64> &ctx,
   Fatal(ctx) << "unsupported relocation in .eh_frame: " << rel;
 }
 
+// An ADRP+LDR pair loading a symbol's address from the GOT can be
+// rewritten to materialize the address directly if the symbol is not
+// preemptible. The instructions must be adjacent and use the same
+// register, so that we don't break code that shares the ADRP result
+// with other loads.
+static bool is_adrp_ldr_relaxable(Context<AARCH64> &ctx,
+                                  InputSection<AARCH64> &isec,
+                                  std::span<ElfRel<AARCH64>> rels,
+                                  i64 i, u8 *base) {
+  if (!ctx.arg.relax || i + 1 == rels.size())
+    return false;
+
+  const ElfRel<AARCH64> &rel = rels[i];
+  const ElfRel<AARCH64> &rel2 = rels[i + 1];
+  if (rel.r_type != R_AARCH64_ADR_GOT_PAGE ||
+      rel2.r_type != R_AARCH64_LD64_GOT_LO12_NC ||
+      rel.r_sym != rel2.r_sym || rel.r_offset + 4 != rel2.r_offset ||
+      rel.r_addend != 0 || rel2.r_addend != 0)
+    return false;
+
+  Symbol<AARCH64> &sym = *isec.file.symbols[rel.r_sym];
+  if (sym.is_imported || sym.get_type() == STT_GNU_IFUNC ||
+      !sym.is_relative(ctx))
+    return false;
+
+  u32 adrp = *(u32 *)(base + rel.r_offset);
+  u32 ldr = *(u32 *)(base + rel2.r_offset);
+  if ((adrp & 0x9f000000) != 0x90000000 || (ldr & 0xffc00000) != 0xf9400000)
+    return false;
+
+  u32 reg = adrp & 0x1f;
+  return (ldr & 0x1f) == reg && ((ldr >> 5) & 0x1f) == reg;
+}
+
+// A thread-local variable defined in an executable is at a fixed
+// offset from the thread pointer, so a general-dynamic or initial-exec
+// access to such variable can be rewritten to a local-exec one which
+// computes the address without calling __tls_get_addr or loading an
+// offset from the GOT.
+static bool is_tls_relaxable(Context<AARCH64> &ctx, Symbol<AARCH64> &sym) {
+  return ctx.arg.relax && !ctx.arg.shared && !sym.is_imported;
+}
+
+// General-dynamic relaxation rewrites the whole code sequence, so it
+// has to be in the canonical form of
+//
+//   adrp x0, :tlsgd:foo
+//   add  x0, x0, :tlsgd_lo12:foo
+//   bl   __tls_get_addr
+//   nop
+static bool is_tlsgd_relaxable(Context<AARCH64> &ctx,
+                               InputSection<AARCH64> &isec,
+                               std::span<ElfRel<AARCH64>> rels,
+                               i64 i, u8 *base) {
+  if (i + 2 >= rels.size())
+    return false;
+
+  const ElfRel<AARCH64> &rel = rels[i];
+  const ElfRel<AARCH64> &rel2 = rels[i + 1];
+  const ElfRel<AARCH64> &rel3 = rels[i + 2];
+  if (rel.r_type != R_AARCH64_TLSGD_ADR_PAGE21 ||
+      rel2.r_type != R_AARCH64_TLSGD_ADD_LO12_NC ||
+      rel3.r_type != R_AARCH64_CALL26 || rel.r_sym != rel2.r_sym ||
+      rel.r_offset + 4 != rel2.r_offset || rel.r_offset + 8 != rel3.r_offset ||
+      rel.r_offset + 16 > isec.contents.size())
+    return false;
+
+  if (!is_tls_relaxable(ctx, *isec.file.symbols[rel.r_sym]))
+    return false;
+
+  u32 *insn = (u32 *)(base + rel.r_offset);
+  return (insn[0] & 0x9f00001f) == 0x90000000 &&
+         (insn[1] & 0xffc003ff) == 0x91000000 &&
+         (insn[2] & 0xfc000000) == 0x94000000 &&
+         insn[3] == 0xd503201f;
+}
+
 template <>
 void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
   ElfRel<AARCH64> *dynrel = nullptr;
+  ElfRel<AARCH64> *baserel = nullptr;
   std::span<ElfRel<AARCH64>> rels = get_rels(ctx);
   i64 subsec_idx = 0;
 
-  if (ctx.reldyn)
-    dynrel = (ElfRel<AARCH64> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
-                                 file.reldyn_offset + this->reldyn_offset);
+  if (ctx.reldyn) {
+    u8 *buf = ctx.buf + ctx.reldyn->shdr.sh_offset;
+    dynrel = (ElfRel<AARCH64> *)(buf + reldyn_offset);
+    baserel = (ElfRel<AARCH64> *)(buf + baserel_offset);
+  }
+
+  // Data sections are dominated by long runs of ABS64 relocations
+  // which need no dynamic relocation. Such runs are applied by a tight
+  // loop which doesn't go through the generic switch below.
+  auto apply_run = [&](i64 i) {
+    i64 j = i;
+    for (; j < rels.size(); j++) {
+      const ElfRel<AARCH64> &rel = rels[j];
+      if (rel.r_type != R_AARCH64_ABS64 || needs_dynrel(j) ||
+          needs_baserel(j) ||
+          (rel_subsections && rel_subsections[subsec_idx].idx == j))
+        break;
+      *(u64 *)(base + rel.r_offset) =
+        file.symbols[rel.r_sym]->get_addr(ctx) + rel.r_addend;
+    }
+    return j;
+  };
 
   for (i64 i = 0; i < rels.size(); i++) {
     const ElfRel<AARCH64> &rel = rels[i];
     if (rel.r_type == R_AARCH64_NONE)
       continue;
 
+    if (rel.r_type == R_AARCH64_ABS64) {
+      i64 end = apply_run(i);
+      if (end != i) {
+        i = end - 1;
+        continue;
+      }
+    }
+
     Symbol<AARCH64> &sym = *file.symbols[rel.r_sym];
     u8 *loc = base + rel.r_offset;
 
@@ -151,20 +266,21 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
                    << lo << ", " << hi << ")";
     };
 
-#define S   (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S   (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A   (ref ? ref->addend : rel.r_addend)
 #define P   (output_section->shdr.sh_addr + offset + rel.r_offset)
 #define G   (sym.get_got_addr(ctx) - ctx.got->shdr.sh_addr)
 #define GOT ctx.got->shdr.sh_addr
 
-    if (needs_dynrel[i]) {
+    if (needs_dynrel(i)) {
       *dynrel++ = {P, R_AARCH64_ABS64, (u32)sym.get_dynsym_idx(ctx), A};
       *(u64 *)loc = A;
       continue;
     }
 
-    if (needs_baserel[i]) {
-      *dynrel++ = {P, R_AARCH64_RELATIVE, 0, (i64)(S + A)};
+    if (needs_baserel(i)) {
+      if (!is_relr_reloc(ctx, rel))
+        *baserel++ = {P, R_AARCH64_RELATIVE, 0, (i64)(S + A)};
       *(u64 *)loc = S + A;
       continue;
     }
@@ -204,6 +320,30 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
       *(u32 *)loc |= bits(S + A, 63, 48) << 5;
       continue;
     case R_AARCH64_ADR_GOT_PAGE: {
+      if (is_adrp_ldr_relaxable(ctx, *this, rels, i, base)) {
+        u32 reg = *(u32 *)loc & 0x1f;
+        i64 val = S + A - P - 4;
+
+        if (-((i64)1 << 20) <= val && val < ((i64)1 << 20)) {
+          // adrp+ldr -> nop+adr
+          *(u32 *)loc = 0xd503201f;
+          *(u32 *)(loc + 4) = 0x10000000 | reg;
+          write_adr(loc + 4, val);
+        } else {
+          // adrp+ldr -> adrp+add
+          val = page(S + A) - page(P);
+          overflow_check(val, -((i64)1 << 32), (i64)1 << 32);
+          write_adr(loc, bits(val, 32, 12));
+          *(u32 *)(loc + 4) = 0x91000000 | (reg << 5) | reg |
+                              (bits(S + A, 11, 0) << 10);
+        }
+
+        if (rel_subsections && rel_subsections[subsec_idx].idx == i + 1)
+          subsec_idx++;
+        i++;
+        continue;
+      }
+
       i64 val = page(G + GOT + A) - page(P);
       overflow_check(val, -((i64)1 << 32), (i64)1 << 32);
       write_adr(loc, bits(val, 32, 12));
@@ -224,8 +364,17 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
     case R_AARCH64_CALL26:
     case R_AARCH64_JUMP26:
       if (!sym.esym().is_undef_weak()) {
+        // If the destination is out of range, jump to a thunk instead,
+        // which in turn jumps to the destination.
         i64 val = S + A - P;
-        overflow_check(val, -((i64)1 << 26), (i64)1 << 26);
+        if (!is_branch_reachable(val) && range_extn &&
+            range_extn[i].thunk_idx != -1) {
+          RangeExtensionRef &ref = range_extn[i];
+          RangeExtensionThunk<AARCH64> &thunk =
+            *output_section->thunks[ref.thunk_idx];
+          val = thunk.get_addr(ref.sym_idx) - P;
+        }
+        overflow_check(val, -BRANCH_REACH, BRANCH_REACH);
         *(u32 *)loc |= (val >> 2) & 0x3ffffff;
       } else {
         // On ARM, calling an weak undefined symbol jumps to the
@@ -264,13 +413,27 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
       continue;
     }
     case R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21: {
-      i64 val = page(sym.get_gottp_addr(ctx) + A) - page(P);
-      overflow_check(val, -((i64)1 << 32), (i64)1 << 32);
-      write_adr(loc, bits(val, 32, 12));
+      if (is_tls_relaxable(ctx, sym)) {
+        // adrp xN, 0 -> movz xN, #tls_offset_hi, lsl #16
+        i64 val = S + A - ctx.tls_begin + 16;
+        overflow_check(val, 0, (i64)1 << 32);
+        *(u32 *)loc = 0xd2a00000 | (bits(val, 31, 16) << 5) |
+                      (*(u32 *)loc & 0x1f);
+      } else {
+        i64 val = page(sym.get_gottp_addr(ctx) + A) - page(P);
+        overflow_check(val, -((i64)1 << 32), (i64)1 << 32);
+        write_adr(loc, bits(val, 32, 12));
+      }
       continue;
     }
     case R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC:
-      *(u32 *)loc |= bits(sym.get_gottp_addr(ctx) + A, 11, 3) << 10;
+      if (is_tls_relaxable(ctx, sym)) {
+        // ldr xN, [xN] -> movk xN, #tls_offset_lo
+        u32 val = bits(S + A - ctx.tls_begin + 16, 15, 0);
+        *(u32 *)loc = 0xf2800000 | (val << 5) | (*(u32 *)loc & 0x1f);
+      } else {
+        *(u32 *)loc |= bits(sym.get_gottp_addr(ctx) + A, 11, 3) << 10;
+      }
       continue;
     case R_AARCH64_TLSLE_ADD_TPREL_HI12: {
       i64 val = S + A - ctx.tls_begin + 16;
@@ -282,6 +445,21 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
       *(u32 *)loc |= bits(S + A - ctx.tls_begin + 16, 11, 0) << 10;
       continue;
     case R_AARCH64_TLSGD_ADR_PAGE21: {
+      if (is_tlsgd_relaxable(ctx, *this, rels, i, base)) {
+        // adrp x0, 0           -> movz x0, #tls_offset_hi, lsl #16
+        // add  x0, x0, 0       -> movk x0, #tls_offset_lo
+        // bl   __tls_get_addr  -> mrs  x1, tpidr_el0
+        // nop                  -> add  x0, x1, x0
+        i64 val = S + A - ctx.tls_begin + 16;
+        overflow_check(val, 0, (i64)1 << 32);
+        *(u32 *)loc = 0xd2a00000 | (bits(val, 31, 16) << 5);
+        *(u32 *)(loc + 4) = 0xf2800000 | (bits(val, 15, 0) << 5);
+        *(u32 *)(loc + 8) = 0xd53bd041;
+        *(u32 *)(loc + 12) = 0x8b000020;
+        i += 2;
+        continue;
+      }
+
       i64 val = page(sym.get_tlsgd_addr(ctx) + A) - page(P);
       overflow_check(val, -((i64)1 << 32), (i64)1 << 32);
       write_adr(loc, bits(val, 32, 12));
@@ -339,11 +517,12 @@ void InputSection<AARCH64>::apply_reloc_alloc(Context<AARCH64> &ctx, u8 *base) {
 }
 
 template <>
-void InputSection<AARCH64>::apply_reloc_nonalloc(Context<AARCH64> &ctx, u8 *base) {
+void InputSection<AARCH64>::apply_reloc_nonalloc(Context<AARCH64> &ctx, u8 *base,
+                                                i64 begin, i64 end) {
   std::span<ElfRel<AARCH64>> rels = get_rels(ctx);
-  i64 subsec_idx = 0;
+  i64 subsec_idx = find_rel_subsection(begin);
 
-  for (i64 i = 0; i < rels.size(); i++) {
+  for (i64 i = begin; i < end; i++) {
     const ElfRel<AARCH64> &rel = rels[i];
     if (rel.r_type == R_AARCH64_NONE)
       continue;
@@ -360,7 +539,7 @@ void InputSection<AARCH64>::apply_reloc_nonalloc(Context<AARCH64> &ctx, u8 *base
     if (rel_subsections && rel_subsections[subsec_idx].idx == i)
       ref = &rel_subsections[subsec_idx++];
 
-#define S   (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S   (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A   (ref ? ref->addend : rel.r_addend)
 #define P   (output_section->shdr.sh_addr + offset + rel.r_offset)
 #define G   (sym.get_got_addr(ctx) - ctx.got->shdr.sh_addr)
@@ -388,10 +567,8 @@ void InputSection<AARCH64>::apply_reloc_nonalloc(Context<AARCH64> &ctx, u8 *base
 }
 
 template <>
-void InputSection<AARCH64>::scan_relocations(Context<AARCH64> &ctx) {
-  assert(shdr.sh_flags & SHF_ALLOC);
-
-  this->reldyn_offset = file.num_dynrel * sizeof(ElfRel<AARCH64>);
+template <OutputType T>
+void InputSection<AARCH64>::do_scan_relocations(Context<AARCH64> &ctx) {
   std::span<ElfRel<AARCH64>> rels = get_rels(ctx);
   bool is_writable = (shdr.sh_flags & SHF_WRITE);
 
@@ -416,16 +593,21 @@ void InputSection<AARCH64>::scan_relocations(Context<AARCH64> &ctx) {
 
     switch (rel.r_type) {
     case R_AARCH64_ABS64: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local    Imported data  Imported code
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // DSO
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // PIE
         {  NONE,     NONE,    COPYREL,       PLT    },     // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_AARCH64_ADR_GOT_PAGE:
+      if (is_adrp_ldr_relaxable(ctx, *this, rels, i, (u8 *)contents.data()))
+        i++;
+      else
+        sym.flags |= NEEDS_GOT;
+      break;
     case R_AARCH64_LD64_GOT_LO12_NC:
     case R_AARCH64_LD64_GOTPAGE_LO15:
       sym.flags |= NEEDS_GOT;
@@ -437,20 +619,24 @@ void InputSection<AARCH64>::scan_relocations(Context<AARCH64> &ctx) {
       break;
     case R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21:
     case R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC:
-      sym.flags |= NEEDS_GOTTP;
+      if (!is_tls_relaxable(ctx, sym))
+        sym.flags |= NEEDS_GOTTP;
       break;
     case R_AARCH64_ADR_PREL_PG_HI21: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local    Imported data  Imported code
         {  NONE,     NONE,    ERROR,         ERROR },      // DSO
         {  NONE,     NONE,    ERROR,         PLT   },      // PIE
         {  NONE,     NONE,    COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_AARCH64_TLSGD_ADR_PAGE21:
-      sym.flags |= NEEDS_TLSGD;
+      if (is_tlsgd_relaxable(ctx, *this, rels, i, (u8 *)contents.data()))
+        i += 2;
+      else
+        sym.flags |= NEEDS_TLSGD;
       break;
     case R_AARCH64_TLSDESC_ADR_PAGE21:
     case R_AARCH64_TLSDESC_LD64_LO12:
@@ -484,4 +670,229 @@ void InputSection<AARCH64>::scan_relocations(Context<AARCH64> &ctx) {
   }
 }
 
+template <>
+void InputSection<AARCH64>::scan_relocations(Context<AARCH64> &ctx) {
+  assert(shdr.sh_flags & SHF_ALLOC);
+
+  switch (get_output_type(ctx)) {
+  case OUTPUT_DSO:
+    do_scan_relocations<OUTPUT_DSO>(ctx);
+    break;
+  case OUTPUT_PIE:
+    do_scan_relocations<OUTPUT_PIE>(ctx);
+    break;
+  case OUTPUT_PDE:
+    do_scan_relocations<OUTPUT_PDE>(ctx);
+    break;
+  }
+}
+
+template <>
+void RangeExtensionThunk<AARCH64>::write_to(Context<AARCH64> &ctx, u8 *buf) {
+  static const u8 insn[] = {
+    0x10, 0x00, 0x00, 0x90, // adrp x16, 0
+    0x10, 0x02, 0x00, 0x91, // add  x16, x16, 0
+    0x00, 0x02, 0x1f, 0xd6, // br   x16
+  };
+
+  static_assert(sizeof(insn) == ENTRY_SIZE);
+
+  for (i64 i = 0; i < targets.size(); i++) {
+    auto [sym, addend] = targets[i];
+    u64 S = sym->get_addr(ctx) + addend;
+    u64 P = get_addr(i);
+
+    u8 *loc = buf + offset + i * ENTRY_SIZE;
+    memcpy(loc, insn, sizeof(insn));
+    write_adr(loc, bits(page(S) - page(P), 32, 12));
+    *(u32 *)(loc + 4) |= bits(S, 11, 0) << 10;
+  }
+}
+
+// Returns true if we know that a branch at `rel` in `isec` can reach
+// its destination directly. Offsets of input sections are final once
+// assigned, so this is exact for destinations in the same output
+// section. Everything else, including PLT entries and other output
+// sections, is assumed to be unreachable.
+static bool is_reachable(Context<AARCH64> &ctx, InputSection<AARCH64> &isec,
+                         Symbol<AARCH64> &sym, const ElfRel<AARCH64> &rel) {
+  if (sym.get_subsec() || sym.has_copyrel)
+    return false;
+
+  if (sym.has_plt(ctx) &&
+      (sym.is_imported || sym.esym().st_type == STT_GNU_IFUNC))
+    return false;
+
+  InputSection<AARCH64> *isec2 = sym.input_section;
+  if (!isec2 || !isec2->is_alive || isec2->offset == -1 ||
+      isec2->output_section != isec.output_section)
+    return false;
+
+  i64 S = isec2->offset + sym.value;
+  i64 P = isec.offset + rel.r_offset;
+  return is_branch_reachable(S + rel.r_addend - P);
+}
+
+// We create thunks for an output section in batches. Input sections
+// are laid out from the beginning of the output section, and a thunk
+// is placed after the sections that are within MAX_DISTANCE bytes from
+// the beginning of the current batch. Then, branches in the batch that
+// cannot reach their destinations directly are redirected to an entry
+// of either an existing thunk within reach or the new thunk.
+//
+// MAX_DISTANCE is smaller than BRANCH_REACH to leave room for the
+// thunk itself and the last input section, which may straddle the
+// MAX_DISTANCE boundary.
+static constexpr i64 MAX_DISTANCE = 100 * 1024 * 1024;
+static constexpr i64 BATCH_SIZE = MAX_DISTANCE / 10;
+
+static void create_thunks(Context<AARCH64> &ctx,
+                          OutputSection<AARCH64> &osec) {
+  typedef std::pair<Symbol<AARCH64> *, i64> Target;
+
+  std::span<InputSection<AARCH64> *> m = osec.members;
+  std::vector<std::unique_ptr<RangeExtensionThunk<AARCH64>>> &thunks =
+    osec.thunks;
+
+  // Thunk entry indices for each thunk
+  std::vector<std::map<Target, i32>> maps;
+
+  for (InputSection<AARCH64> *isec : m)
+    isec->offset = -1;
+
+  // Input sections in [b, c) are the current batch, and those in [b, d)
+  // have been assigned offsets. Thunks before `a` are too far behind to
+  // be reachable from the current batch.
+  i64 a = 0;
+  i64 b = 0;
+  i64 c = 0;
+  i64 d = 0;
+  i64 offset = 0;
+
+  while (b < m.size()) {
+    while (d < m.size()) {
+      i64 off = align_to(offset, m[d]->shdr.sh_addralign);
+      if (b < d && off + m[d]->shdr.sh_size - m[b]->offset > MAX_DISTANCE)
+        break;
+      m[d]->offset = off;
+      offset = off + m[d]->shdr.sh_size;
+      d++;
+    }
+
+    c = b + 1;
+    while (c < d &&
+           m[c]->offset + m[c]->shdr.sh_size - m[b]->offset < BATCH_SIZE)
+      c++;
+
+    while (a < thunks.size() &&
+           thunks[a]->offset + thunks[a]->size() + BRANCH_REACH <
+           m[b]->offset)
+      a++;
+
+    i64 cur = thunks.size();
+    thunks.emplace_back(new RangeExtensionThunk<AARCH64>(osec));
+    maps.emplace_back();
+
+    // Find branches that need thunks. If an existing thunk already has
+    // an entry for the same destination and is within reach, use it.
+    tbb::parallel_for(b, c, [&](i64 i) {
+      InputSection<AARCH64> &isec = *m[i];
+      std::span<ElfRel<AARCH64>> rels = isec.get_rels(ctx);
+
+      for (i64 j = 0; j < rels.size(); j++) {
+        const ElfRel<AARCH64> &rel = rels[j];
+        if (rel.r_type != R_AARCH64_CALL26 && rel.r_type != R_AARCH64_JUMP26)
+          continue;
+
+        Symbol<AARCH64> &sym = *isec.file.symbols[rel.r_sym];
+        if (sym.esym().is_undef_weak() || is_reachable(ctx, isec, sym, rel))
+          continue;
+
+        if (!isec.range_extn)
+          isec.range_extn.reset(new RangeExtensionRef[rels.size()]);
+
+        RangeExtensionRef &ref = isec.range_extn[j];
+        ref.thunk_idx = cur;
+
+        i64 P = isec.offset + rel.r_offset;
+        for (i64 k = a; k < cur; k++) {
+          auto it = maps[k].find({&sym, rel.r_addend});
+          if (it == maps[k].end())
+            continue;
+
+          i64 val = thunks[k]->offset + it->second * thunks[k]->ENTRY_SIZE - P;
+          if (is_branch_reachable(val)) {
+            ref = {(i32)k, it->second};
+            break;
+          }
+        }
+      }
+    });
+
+    // Add entries to the new thunk. This is done serially so that the
+    // output is deterministic.
+    RangeExtensionThunk<AARCH64> &thunk = *thunks[cur];
+
+    for (i64 i = b; i < c; i++) {
+      InputSection<AARCH64> &isec = *m[i];
+      if (!isec.range_extn)
+        continue;
+
+      std::span<ElfRel<AARCH64>> rels = isec.get_rels(ctx);
+
+      for (i64 j = 0; j < rels.size(); j++) {
+        RangeExtensionRef &ref = isec.range_extn[j];
+        if (ref.thunk_idx != cur)
+          continue;
+
+        Target target = {isec.file.symbols[rels[j].r_sym], rels[j].r_addend};
+        auto [it, inserted] = maps[cur].insert({target, thunk.targets.size()});
+        if (inserted)
+          thunk.targets.push_back(target);
+        ref.sym_idx = it->second;
+      }
+    }
+
+    if (thunk.targets.empty()) {
+      thunks.pop_back();
+      maps.pop_back();
+    } else {
+      thunk.offset = align_to(offset, 4);
+      offset = thunk.offset + thunk.size();
+    }
+
+    b = c;
+  }
+
+  osec.shdr.sh_size = offset;
+}
+
+// AArch64's branch instructions cannot reach destinations that are
+// more than 128 MiB away, so we create range extension thunks for
+// such branches. This function lays out input sections of executable
+// output sections again, with thunks interleaved.
+//
+// Executable sections are contiguous in the output, so if their total
+// size is small enough, all branches are reachable and we don't need
+// to do anything.
+void create_range_extension_thunks(Context<AARCH64> &ctx) {
+  Timer t(ctx, "create_range_extension_thunks");
+
+  i64 size = 0;
+  for (Chunk<AARCH64> *chunk : ctx.chunks)
+    if ((chunk->shdr.sh_flags & SHF_ALLOC) &&
+        (chunk->shdr.sh_flags & SHF_EXECINSTR))
+      size += chunk->shdr.sh_size + chunk->shdr.sh_addralign +
+              COMMON_PAGE_SIZE;
+
+  if (size < MAX_DISTANCE)
+    return;
+
+  tbb::parallel_for_each(ctx.output_sections,
+                         [&](std::unique_ptr<OutputSection<AARCH64>> &osec) {
+    if ((osec->shdr.sh_flags & SHF_EXECINSTR) && !osec->members.empty())
+      create_thunks(ctx, *osec);
+  });
+}
+
 } // namespace mold::elf
@@ -118,15 +118,29 @@ void EhFrameSection<I386>::apply_reloc(Context<I386> &ctx,
   unreachable();
 }
 
+// "mov foo@GOT(%reg1), %reg2" can be relaxed to "lea foo@GOTOFF(%reg1),
+// %reg2" if foo is not preemptible. We make the same decision when
+// scanning and applying relocations, so a symbol gets a GOT slot only
+// if some reference to it cannot be relaxed.
+static bool is_got32x_relaxable(Context<I386> &ctx, Symbol<I386> &sym,
+                                u8 *loc) {
+  return ctx.arg.relax && !sym.is_imported && sym.is_relative(ctx) &&
+         sym.get_type() != STT_GNU_IFUNC &&
+         loc[-2] == 0x8b && (loc[-1] & 0xc0) == 0x80 && (loc[-1] & 7) != 4;
+}
+
 template <>
 void InputSection<I386>::apply_reloc_alloc(Context<I386> &ctx, u8 *base) {
   ElfRel<I386> *dynrel = nullptr;
+  ElfRel<I386> *baserel = nullptr;
   std::span<ElfRel<I386>> rels = get_rels(ctx);
   i64 subsec_idx = 0;
 
-  if (ctx.reldyn)
-    dynrel = (ElfRel<I386> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
-                              file.reldyn_offset + this->reldyn_offset);
+  if (ctx.reldyn) {
+    u8 *buf = ctx.buf + ctx.reldyn->shdr.sh_offset;
+    dynrel = (ElfRel<I386> *)(buf + reldyn_offset);
+    baserel = (ElfRel<I386> *)(buf + baserel_offset);
+  }
 
   for (i64 i = 0; i < rels.size(); i++) {
     const ElfRel<I386> &rel = rels[i];
@@ -167,20 +181,21 @@ void InputSection<I386>::apply_reloc_alloc(Context<I386> &ctx, u8 *base) {
       *(u16 *)loc = val;
     };
 
-#define S      (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S      (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A      (ref ? ref->addend : this->get_addend(rel))
 #define P      (output_section->shdr.sh_addr + offset + rel.r_offset)
 #define G      (sym.get_got_addr(ctx) - ctx.got->shdr.sh_addr)
 #define GOTPLT ctx.gotplt->shdr.sh_addr
 
-    if (needs_dynrel[i]) {
+    if (needs_dynrel(i)) {
       *dynrel++ = {P, R_386_32, (u32)sym.get_dynsym_idx(ctx)};
       *(u32 *)loc = A;
       continue;
     }
 
-    if (needs_baserel[i]) {
-      *dynrel++ = {P, R_386_RELATIVE, 0};
+    if (needs_baserel(i)) {
+      if (!is_relr_reloc(ctx, rel))
+        *baserel++ = {P, R_386_RELATIVE, 0};
       *(u32 *)loc = S + A;
       continue;
     }
@@ -206,9 +221,16 @@ void InputSection<I386>::apply_reloc_alloc(Context<I386> &ctx, u8 *base) {
       *(u32 *)loc = S + A - P;
       continue;
     case R_386_GOT32:
-    case R_386_GOT32X:
       *(u32 *)loc = sym.get_got_addr(ctx) + A - GOTPLT;
       continue;
+    case R_386_GOT32X:
+      if (is_got32x_relaxable(ctx, sym, loc)) {
+        loc[-2] = 0x8d;
+        *(u32 *)loc = S + A - GOTPLT;
+      } else {
+        *(u32 *)loc = sym.get_got_addr(ctx) + A - GOTPLT;
+      }
+      continue;
     case R_386_GOTOFF:
       *(u32 *)loc = S + A - GOTPLT;
       continue;
@@ -267,11 +289,12 @@ void InputSection<I386>::apply_reloc_alloc(Context<I386> &ctx, u8 *base) {
 }
 
 template <>
-void InputSection<I386>::apply_reloc_nonalloc(Context<I386> &ctx, u8 *base) {
+void InputSection<I386>::apply_reloc_nonalloc(Context<I386> &ctx, u8 *base,
+                                                i64 begin, i64 end) {
   std::span<ElfRel<I386>> rels = get_rels(ctx);
-  i64 subsec_idx = 0;
+  i64 subsec_idx = find_rel_subsection(begin);
 
-  for (i64 i = 0; i < rels.size(); i++) {
+  for (i64 i = begin; i < end; i++) {
     const ElfRel<I386> &rel = rels[i];
     if (rel.r_type == R_386_NONE)
       continue;
@@ -315,7 +338,7 @@ void InputSection<I386>::apply_reloc_nonalloc(Context<I386> &ctx, u8 *base) {
       *(u16 *)loc = val;
     };
 
-#define S      (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S      (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A      (ref ? ref->addend : this->get_addend(rel))
 #define G      (sym.get_got_addr(ctx) - ctx.got->shdr.sh_addr)
 #define GOTPLT ctx.gotplt->shdr.sh_addr
@@ -362,10 +385,8 @@ void InputSection<I386>::apply_reloc_nonalloc(Context<I386> &ctx, u8 *base) {
 }
 
 template <>
-void InputSection<I386>::scan_relocations(Context<I386> &ctx) {
-  assert(shdr.sh_flags & SHF_ALLOC);
-
-  this->reldyn_offset = file.num_dynrel * sizeof(ElfRel<I386>);
+template <OutputType T>
+void InputSection<I386>::do_scan_relocations(Context<I386> &ctx) {
   std::span<ElfRel<I386>> rels = get_rels(ctx);
   bool is_writable = (shdr.sh_flags & SHF_WRITE);
 
@@ -391,51 +412,54 @@ void InputSection<I386>::scan_relocations(Context<I386> &ctx) {
     switch (rel.r_type) {
     case R_386_8:
     case R_386_16: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  NONE,     ERROR, ERROR,         ERROR },      // DSO
         {  NONE,     ERROR, ERROR,         ERROR },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_386_32: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local    Imported data  Imported code
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // DSO
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // PIE
         {  NONE,     NONE,    COPYREL,       PLT },        // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_386_PC8:
     case R_386_PC16: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  ERROR,    NONE,  ERROR,         ERROR },      // DSO
         {  ERROR,    NONE,  COPYREL,       PLT   },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_386_PC32: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  BASEREL,  NONE,  ERROR,         ERROR },      // DSO
         {  BASEREL,  NONE,  COPYREL,       PLT   },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_386_GOT32:
-    case R_386_GOT32X:
     case R_386_GOTPC:
       sym.flags |= NEEDS_GOT;
       break;
+    case R_386_GOT32X:
+      if (!is_got32x_relaxable(ctx, sym, loc))
+        sym.flags |= NEEDS_GOT;
+      break;
     case R_386_PLT32:
       if (sym.is_imported)
         sym.flags |= NEEDS_PLT;
@@ -452,7 +476,7 @@ void InputSection<I386>::scan_relocations(Context<I386> &ctx) {
       sym.flags |= NEEDS_TLSLD;
       break;
     case R_386_TLS_GOTDESC:
-      if (!ctx.arg.relax || ctx.arg.shared)
+      if (!ctx.arg.relax || T == OUTPUT_DSO)
         sym.flags |= NEEDS_TLSDESC;
       break;
     case R_386_GOTOFF:
@@ -466,4 +490,21 @@ void InputSection<I386>::scan_relocations(Context<I386> &ctx) {
   }
 }
 
+template <>
+void InputSection<I386>::scan_relocations(Context<I386> &ctx) {
+  assert(shdr.sh_flags & SHF_ALLOC);
+
+  switch (get_output_type(ctx)) {
+  case OUTPUT_DSO:
+    do_scan_relocations<OUTPUT_DSO>(ctx);
+    break;
+  case OUTPUT_PIE:
+    do_scan_relocations<OUTPUT_PIE>(ctx);
+    break;
+  case OUTPUT_PDE:
+    do_scan_relocations<OUTPUT_PDE>(ctx);
+    break;
+  }
+}
+
 } // namespace mold::elf
@@ -1,4 +1,5 @@
 #include "mold.h"
+#include <tbb/parallel_for_each.h>
 
 namespace mold::elf {
 
@@ -91,9 +92,18 @@ void EhFrameSection<X86_64>::apply_reloc(Context<X86_64> &ctx,
   unreachable();
 }
 
+// A GOT-indirect reference to a non-preemptible symbol can be rewritten
+// to refer to the symbol directly. We make the same decision when
+// scanning and applying relocations, so a symbol gets a GOT slot only
+// if some reference to it cannot be relaxed.
+static bool is_got_relaxable(Context<X86_64> &ctx, Symbol<X86_64> &sym) {
+  return ctx.arg.relax && !sym.is_imported && sym.is_relative(ctx) &&
+         sym.get_type() != STT_GNU_IFUNC;
+}
+
 static u32 relax_gotpcrelx(u8 *loc) {
   switch ((loc[0] << 8) | loc[1]) {
-  case 0xff15: return 0x90e8; // call *0(%rip) -> call 0
+  case 0xff15: return 0x67e8; // call *0(%rip) -> addr32 call 0
   case 0xff25: return 0x90e9; // jmp  *0(%rip) -> jmp  0
   }
   return 0;
@@ -149,18 +159,59 @@ static u32 relax_gottpoff(u8 *loc) {
 template <>
 void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
   ElfRel<X86_64> *dynrel = nullptr;
+  ElfRel<X86_64> *baserel = nullptr;
   std::span<ElfRel<X86_64>> rels = get_rels(ctx);
   i64 subsec_idx = 0;
 
-  if (ctx.reldyn)
-    dynrel = (ElfRel<X86_64> *)(ctx.buf + ctx.reldyn->shdr.sh_offset +
-                                file.reldyn_offset + this->reldyn_offset);
+  if (ctx.reldyn) {
+    u8 *buf = ctx.buf + ctx.reldyn->shdr.sh_offset;
+    dynrel = (ElfRel<X86_64> *)(buf + reldyn_offset);
+    baserel = (ElfRel<X86_64> *)(buf + baserel_offset);
+  }
+
+  // Most relocations in code and data are long runs of PC32/PLT32 or
+  // 64 relocations that need no dynamic relocation. Such runs are
+  // applied by a tight loop which doesn't go through the generic
+  // switch below. A relocation that doesn't fit the fast path
+  // (including one that would overflow) ends the run and is handled
+  // by the generic code, which also reports errors.
+  auto apply_run = [&](i64 i, u32 type) {
+    u64 addr = output_section->shdr.sh_addr + offset;
+    i64 j = i;
+
+    for (; j < rels.size(); j++) {
+      const ElfRel<X86_64> &rel = rels[j];
+      if (rel.r_type != type || needs_dynrel(j) || needs_baserel(j) ||
+          (rel_subsections && rel_subsections[subsec_idx].idx == j))
+        break;
+
+      u64 val = file.get_symbol_addr(ctx, rel.r_sym) + rel.r_addend;
+      if (type == R_X86_64_64) {
+        *(u64 *)(base + rel.r_offset) = val;
+      } else {
+        i64 pcrel = val - (addr + rel.r_offset);
+        if (pcrel != (i32)pcrel)
+          break;
+        *(u32 *)(base + rel.r_offset) = pcrel;
+      }
+    }
+    return j;
+  };
 
   for (i64 i = 0; i < rels.size(); i++) {
     const ElfRel<X86_64> &rel = rels[i];
     if (rel.r_type == R_X86_64_NONE)
       continue;
 
+    if (rel.r_type == R_X86_64_PC32 || rel.r_type == R_X86_64_PLT32 ||
+        rel.r_type == R_X86_64_64) {
+      i64 end = apply_run(i, rel.r_type);
+      if (end != i) {
+        i = end - 1;
+        continue;
+      }
+    }
+
     Symbol<X86_64> &sym = *file.symbols[rel.r_sym];
     u8 *loc = base + rel.r_offset;
 
@@ -205,20 +256,21 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
       *(u32 *)loc = val;
     };
 
-#define S   (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S   (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A   (ref ? ref->addend : rel.r_addend)
 #define P   (output_section->shdr.sh_addr + offset + rel.r_offset)
 #define G   (sym.get_got_addr(ctx) - ctx.got->shdr.sh_addr)
 #define GOT ctx.got->shdr.sh_addr
 
-    if (needs_dynrel[i]) {
+    if (needs_dynrel(i)) {
       *dynrel++ = {P, R_X86_64_64, (u32)sym.get_dynsym_idx(ctx), A};
       *(u64 *)loc = A;
       continue;
     }
 
-    if (needs_baserel[i]) {
-      *dynrel++ = {P, R_X86_64_RELATIVE, 0, (i64)(S + A)};
+    if (needs_baserel(i)) {
+      if (!is_relr_reloc(ctx, rel))
+        *baserel++ = {P, R_X86_64_RELATIVE, 0, (i64)(S + A)};
       *(u64 *)loc = S + A;
       continue;
     }
@@ -273,7 +325,7 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
       *(u64 *)loc = G + GOT + A - P;
       continue;
     case R_X86_64_GOTPCRELX:
-      if (sym.get_got_idx(ctx) == -1) {
+      if (is_got_relaxable(ctx, sym) && relax_gotpcrelx(loc - 2)) {
         u32 insn = relax_gotpcrelx(loc - 2);
         loc[-2] = insn >> 8;
         loc[-1] = insn;
@@ -283,7 +335,7 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
       }
       continue;
     case R_X86_64_REX_GOTPCRELX:
-      if (sym.get_got_idx(ctx) == -1) {
+      if (is_got_relaxable(ctx, sym) && relax_rex_gotpcrelx(loc - 3)) {
         u32 insn = relax_rex_gotpcrelx(loc - 3);
         loc[-3] = insn >> 16;
         loc[-2] = insn >> 8;
@@ -294,7 +346,21 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
       }
       continue;
     case R_X86_64_TLSGD:
-      if (sym.get_tlsgd_idx(ctx) == -1) {
+      if (sym.get_tlsgd_idx(ctx) != -1) {
+        write32s(sym.get_tlsgd_addr(ctx) + A - P);
+      } else if (sym.is_imported) {
+        // Relax GD to IE
+        static const u8 insn[] = {
+          0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0, // mov %fs:0, %rax
+          0x48, 0x03, 0x05, 0,    0,    0, 0,       // add 0(%rip), %rax
+        };
+        memcpy(loc - 4, insn, sizeof(insn));
+
+        i64 val = sym.get_gottp_addr(ctx) + A - P - 8;
+        overflow_check(val, -((i64)1 << 31), (i64)1 << 31);
+        *(u32 *)(loc + 8) = val;
+        i++;
+      } else {
         // Relax GD to LE
         static const u8 insn[] = {
           0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0, // mov %fs:0, %rax
@@ -306,18 +372,27 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
         overflow_check(val, -((i64)1 << 31), (i64)1 << 31);
         *(u32 *)(loc + 8) = val;
         i++;
-      } else {
-        write32s(sym.get_tlsgd_addr(ctx) + A - P);
       }
       continue;
     case R_X86_64_TLSLD:
       if (ctx.got->tlsld_idx == -1) {
         // Relax LD to LE
-        static const u8 insn[] = {
-          0x66, 0x66, 0x66,                         // (padding)
-          0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0, // mov %fs:0, %rax
-        };
-        memcpy(loc - 3, insn, sizeof(insn));
+        if (rels[i + 1].r_type == R_X86_64_PLT32 ||
+            rels[i + 1].r_type == R_X86_64_PC32) {
+          // lea 0(%rip), %rdi; call __tls_get_addr
+          static const u8 insn[] = {
+            0x66, 0x66, 0x66,                         // (padding)
+            0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0, // mov %fs:0, %rax
+          };
+          memcpy(loc - 3, insn, sizeof(insn));
+        } else {
+          // lea 0(%rip), %rdi; call *__tls_get_addr@GOTPCREL(%rip)
+          static const u8 insn[] = {
+            0x64, 0x48, 0x8b, 0x04, 0x25, 0, 0, 0, 0, // mov %fs:0, %rax
+            0x0f, 0x1f, 0x40, 0x00,                   // nop
+          };
+          memcpy(loc - 3, insn, sizeof(insn));
+        }
         i++;
       } else {
         write32s(ctx.got->get_tlsld_addr(ctx) + A - P);
@@ -401,11 +476,12 @@ void InputSection<X86_64>::apply_reloc_alloc(Context<X86_64> &ctx, u8 *base) {
 // Relocations against non-SHF_ALLOC sections are not scanned by
 // scan_relocations.
 template <>
-void InputSection<X86_64>::apply_reloc_nonalloc(Context<X86_64> &ctx, u8 *base) {
+void InputSection<X86_64>::apply_reloc_nonalloc(Context<X86_64> &ctx, u8 *base,
+                                                i64 begin, i64 end) {
   std::span<ElfRel<X86_64>> rels = get_rels(ctx);
-  i64 subsec_idx = 0;
+  i64 subsec_idx = find_rel_subsection(begin);
 
-  for (i64 i = 0; i < rels.size(); i++) {
+  for (i64 i = begin; i < end; i++) {
     const ElfRel<X86_64> &rel = rels[i];
     if (rel.r_type == R_X86_64_NONE)
       continue;
@@ -459,7 +535,7 @@ void InputSection<X86_64>::apply_reloc_nonalloc(Context<X86_64> &ctx, u8 *base)
       *(u32 *)loc = val;
     };
 
-#define S   (ref ? ref->subsec->get_addr(ctx) : sym.get_addr(ctx))
+#define S   (ref ? ref->subsec->get_addr(ctx) : file.get_symbol_addr(ctx, rel.r_sym))
 #define A   (ref ? ref->addend : rel.r_addend)
 
     switch (rel.r_type) {
@@ -507,10 +583,8 @@ void InputSection<X86_64>::apply_reloc_nonalloc(Context<X86_64> &ctx, u8 *base)
 // or in .plt for that symbol. In order to fix the file layout, we
 // need to scan relocations.
 template <>
-void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
-  assert(shdr.sh_flags & SHF_ALLOC);
-
-  this->reldyn_offset = file.num_dynrel * sizeof(ElfRel<X86_64>);
+template <OutputType T>
+void InputSection<X86_64>::do_scan_relocations(Context<X86_64> &ctx) {
   std::span<ElfRel<X86_64>> rels = get_rels(ctx);
   bool is_writable = (shdr.sh_flags & SHF_WRITE);
 
@@ -541,47 +615,47 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
       // Dynamic linker does not support 8, 16 or 32-bit dynamic
       // relocations for these types of relocations. We report an
       // error if we cannot relocate them even at load-time.
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  NONE,     ERROR, ERROR,         ERROR },      // DSO
         {  NONE,     ERROR, ERROR,         ERROR },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_X86_64_64: {
       // Unlike the above, we can use R_X86_64_RELATIVE and R_86_64_64
       // relocations.
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local    Imported data  Imported code
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // DSO
         {  NONE,     BASEREL, DYNREL,        DYNREL },     // PIE
         {  NONE,     NONE,    COPYREL,       PLT    },     // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_X86_64_PC8:
     case R_X86_64_PC16:
     case R_X86_64_PC32: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  ERROR,    NONE,  ERROR,         ERROR },      // DSO
         {  ERROR,    NONE,  COPYREL,       PLT   },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_X86_64_PC64: {
-      Action table[][4] = {
+      static constexpr Action table[][4] = {
         // Absolute  Local  Imported data  Imported code
         {  BASEREL,  NONE,  ERROR,         ERROR },      // DSO
         {  BASEREL,  NONE,  COPYREL,       PLT   },      // PIE
         {  NONE,     NONE,  COPYREL,       PLT   },      // PDE
       };
-      dispatch(ctx, table, i, rel, sym);
+      dispatch<T>(ctx, table, i, rel, sym);
       break;
     }
     case R_X86_64_GOT32:
@@ -596,9 +670,7 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
       if (rel.r_addend != -4)
         Fatal(ctx) << *this << ": bad r_addend for R_X86_64_GOTPCRELX";
 
-      bool do_relax = ctx.arg.relax && !sym.is_imported &&
-                      sym.is_relative(ctx) && relax_gotpcrelx(loc - 2);
-      if (!do_relax)
+      if (!is_got_relaxable(ctx, sym) || !relax_gotpcrelx(loc - 2))
         sym.flags |= NEEDS_GOT;
       break;
     }
@@ -606,9 +678,7 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
       if (rel.r_addend != -4)
         Fatal(ctx) << *this << ": bad r_addend for R_X86_64_REX_GOTPCRELX";
 
-      bool do_relax = ctx.arg.relax && !sym.is_imported &&
-                      sym.is_relative(ctx) && relax_rex_gotpcrelx(loc - 3);
-      if (!do_relax)
+      if (!is_got_relaxable(ctx, sym) || !relax_rex_gotpcrelx(loc - 3))
         sym.flags |= NEEDS_GOT;
       break;
     }
@@ -621,10 +691,19 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
         Fatal(ctx) << *this
                    << ": TLSGD reloc must be followed by PLT32 or GOTPCREL";
 
-      if (ctx.arg.relax && !ctx.arg.shared && !sym.is_imported)
+      // If we are creating an executable, a thread-local variable is
+      // always in the TLS block of either the executable itself (LE)
+      // or a DSO loaded at startup (IE), so we don't need to call
+      // __tls_get_addr.
+      if (ctx.arg.relax && T != OUTPUT_DSO) {
+        if (sym.is_imported) {
+          ctx.has_gottp_rel = true;
+          sym.flags |= NEEDS_GOTTP;
+        }
         i++;
-      else
+      } else {
         sym.flags |= NEEDS_TLSGD;
+      }
       break;
     case R_X86_64_TLSLD:
       if (i + 1 == rels.size())
@@ -633,7 +712,7 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
       if (sym.is_imported)
         Fatal(ctx) << *this << ": TLSLD reloc refers external symbol " << sym;
 
-      if (ctx.arg.relax && !ctx.arg.shared)
+      if (ctx.arg.relax && T != OUTPUT_DSO)
         i++;
       else
         sym.flags |= NEEDS_TLSLD;
@@ -646,7 +725,7 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
     case R_X86_64_GOTTPOFF: {
       ctx.has_gottp_rel = true;
 
-      bool do_relax = ctx.arg.relax && !ctx.arg.shared &&
+      bool do_relax = ctx.arg.relax && T != OUTPUT_DSO &&
                       !sym.is_imported && relax_gottpoff(loc - 3);
       if (!do_relax)
         sym.flags |= NEEDS_GOTTP;
@@ -674,4 +753,80 @@ void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
   }
 }
 
+// With -fbasic-block-sections, a compiler puts each basic block (or
+// each cluster of basic blocks) of a function into its own section.
+// Since the compiler can't know where the linker places the sections,
+// a block ends with an explicit jump to its fall-through successor.
+// If the successor immediately follows the block in the output, the
+// jump is redundant. This function removes such jumps.
+//
+// We handle only a trailing 5-byte `jmp rel32` to the beginning of the
+// next section. The next section must not require alignment, or
+// padding could be inserted between the two sections. This pass must
+// run after the order of input sections is fixed and before their
+// offsets are assigned.
+void optimize_bb_jumps(Context<X86_64> &ctx) {
+  Timer t(ctx, "optimize_bb_jumps");
+  static Counter counter("removed_bb_jumps");
+
+  auto is_jump_to_next = [&](InputSection<X86_64> &isec,
+                             InputSection<X86_64> &next) {
+    i64 size = isec.contents.size();
+    std::span<ElfRel<X86_64>> rels = isec.get_rels(ctx);
+    if (size < 5 || rels.empty() || isec.compress_type ||
+        std::max<i64>(next.shdr.sh_addralign, next.min_alignment) > 1)
+      return false;
+
+    const ElfRel<X86_64> &rel = rels.back();
+    if ((rel.r_type != R_X86_64_PC32 && rel.r_type != R_X86_64_PLT32) ||
+        rel.r_offset != size - 4 || (u8)isec.contents[size - 5] != 0xe9)
+      return false;
+
+    // A jump to an imported symbol may be interposed at runtime, so we
+    // can't remove it even if the symbol is defined in the next section.
+    Symbol<X86_64> &sym = *isec.file.symbols[rel.r_sym];
+    return !sym.is_imported && sym.input_section == &next &&
+           (i64)sym.value + rel.r_addend == -4;
+  };
+
+  tbb::parallel_for_each(ctx.output_sections,
+                         [&](std::unique_ptr<OutputSection<X86_64>> &osec) {
+    if (!(osec->shdr.sh_flags & SHF_EXECINSTR))
+      return;
+
+    std::vector<InputSection<X86_64> *> &m = osec->members;
+
+    for (i64 i = 0; i + 1 < m.size(); i++) {
+      if (!is_jump_to_next(*m[i], *m[i + 1]))
+        continue;
+
+      // initialize_sections() has given an executable section its own
+      // copy of the section header if --optimize-bb-jumps is given, so
+      // it is safe to update it here.
+      InputSection<X86_64> &isec = *m[i];
+      const_cast<ElfShdr<X86_64> &>(isec.shdr).sh_size -= 5;
+      isec.contents = isec.contents.substr(0, isec.contents.size() - 5);
+      isec.trailing_jump_removed = true;
+      counter++;
+    }
+  });
+}
+
+template <>
+void InputSection<X86_64>::scan_relocations(Context<X86_64> &ctx) {
+  assert(shdr.sh_flags & SHF_ALLOC);
+
+  switch (get_output_type(ctx)) {
+  case OUTPUT_DSO:
+    do_scan_relocations<OUTPUT_DSO>(ctx);
+    break;
+  case OUTPUT_PIE:
+    do_scan_relocations<OUTPUT_PIE>(ctx);
+    break;
+  case OUTPUT_PDE:
+    do_scan_relocations<OUTPUT_PDE>(ctx);
+    break;
+  }
+}
+
 } // namespace mold::elf
@@ -0,0 +1,203 @@
+// This file implements a profile-guided function layout for
+// --call-graph-ordering-file.
+//
+// The input is a call graph profile, i.e. a list of caller-callee
+// pairs with their call counts, which can be obtained with a sampling
+// profiler such as perf. Using the profile, we reorder input sections
+// so that functions that call each other frequently are placed close
+// together and hot functions are packed at the beginning of an output
+// section. That improves i-cache and iTLB utilization.
+//
+// The algorithm is C3 (Call-Chain Clustering) from "Optimizing Function
+// Placement for Large-Scale Data-Center Applications" by Ottoni and
+// Maher (CGO 2017), which is also what lld's --call-graph-profile-sort
+// implements. Each input section starts in its own cluster. We visit
+// clusters in decreasing order of density (call count per byte) and
+// merge each cluster into the cluster of its most frequent caller,
+// unless the merged cluster would become too large or too sparse.
+// Resulting clusters are then placed in decreasing order of density.
+
+#include "mold.h"
+
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+namespace mold::elf {
+
+// Merging clusters bigger than the page size doesn't improve locality
+// much, so we cap the size at 1 MiB as lld does.
+static constexpr i64 MAX_CLUSTER_SIZE = 1024 * 1024;
+
+// We don't merge two clusters if doing so decreases the density of
+// the caller's cluster by more than this factor.
+static constexpr i64 MAX_DENSITY_DEGRADATION = 8;
+
+namespace {
+struct Cluster {
+  Cluster(i64 idx, i64 size) : next(idx), prev(idx), size(size) {}
+
+  double get_density() const {
+    return size ? (double)weight / size : 0;
+  }
+
+  // Clusters are circular doubly-linked lists of sections.
+  i64 next;
+  i64 prev;
+  i64 size;
+  u64 weight = 0;
+  u64 initial_weight = 0;
+  i64 best_pred = -1;
+  u64 best_pred_weight = 0;
+};
+}
+
+static i64 get_leader(std::vector<i64> &leaders, i64 i) {
+  while (leaders[i] != i) {
+    leaders[i] = leaders[leaders[i]];
+    i = leaders[i];
+  }
+  return i;
+}
+
+static void merge_clusters(std::vector<Cluster> &clusters, i64 into_idx,
+                           i64 from_idx) {
+  Cluster &into = clusters[into_idx];
+  Cluster &from = clusters[from_idx];
+
+  i64 tail1 = into.prev;
+  i64 tail2 = from.prev;
+  into.prev = tail2;
+  clusters[tail2].next = into_idx;
+  from.prev = tail1;
+  clusters[tail1].next = from_idx;
+
+  into.size += from.size;
+  into.weight += from.weight;
+  from.size = 0;
+  from.weight = 0;
+}
+
+template <typename E>
+void sort_by_call_graph(Context<E> &ctx) {
+  Timer t(ctx, "sort_by_call_graph");
+
+  std::vector<InputSection<E> *> sections;
+  std::unordered_map<InputSection<E> *, i64> section_idx;
+  std::vector<Cluster> clusters;
+
+  auto get_node = [&](std::string_view name) -> i64 {
+    Symbol<E> *sym = intern(ctx, name);
+    if (!sym->file || sym->file->is_dso)
+      return -1;
+
+    InputSection<E> *isec = sym->input_section;
+    if (!isec || !isec->is_alive)
+      return -1;
+
+    auto [it, inserted] = section_idx.insert({isec, sections.size()});
+    if (inserted) {
+      clusters.push_back(Cluster(sections.size(), isec->shdr.sh_size));
+      sections.push_back(isec);
+    }
+    return it->second;
+  };
+
+  // Sum up weights of edges between the same pair of sections.
+  std::map<std::pair<i64, i64>, u64> edges;
+
+  for (CallGraphEdge &edge : ctx.arg.call_graph_ordering_file) {
+    i64 from = get_node(edge.from);
+    i64 to = get_node(edge.to);
+    if (from == -1 || to == -1)
+      continue;
+
+    // We can't place sections close to each other if they belong to
+    // different output sections.
+    if (sections[from]->output_section != sections[to]->output_section)
+      continue;
+    edges[{from, to}] += edge.weight;
+  }
+
+  for (auto [pair, weight] : edges) {
+    auto [from, to] = pair;
+    Cluster &c = clusters[to];
+    c.weight += weight;
+
+    if (from != to && c.best_pred_weight < weight) {
+      c.best_pred = from;
+      c.best_pred_weight = weight;
+    }
+  }
+
+  for (Cluster &c : clusters)
+    c.initial_weight = c.weight;
+
+  // Visit clusters in decreasing order of density and merge each
+  // of them into its most likely caller's cluster.
+  std::vector<i64> sorted(clusters.size());
+  std::iota(sorted.begin(), sorted.end(), 0);
+
+  sort(sorted, [&](i64 a, i64 b) {
+    return clusters[a].get_density() > clusters[b].get_density();
+  });
+
+  std::vector<i64> leaders(clusters.size());
+  std::iota(leaders.begin(), leaders.end(), 0);
+
+  for (i64 i : sorted) {
+    // Cluster `i` is not merged into other clusters yet, so it is
+    // its own leader.
+    Cluster &c = clusters[i];
+
+    // Don't merge if the edge is unlikely.
+    if (c.best_pred == -1 || c.best_pred_weight * 10 <= c.initial_weight)
+      continue;
+
+    i64 pred = get_leader(leaders, c.best_pred);
+    if (pred == i)
+      continue;
+
+    Cluster &pc = clusters[pred];
+    if (c.size + pc.size > MAX_CLUSTER_SIZE)
+      continue;
+
+    // Don't merge if the merged cluster would be too sparse.
+    double density = (double)(pc.weight + c.weight) / (pc.size + c.size);
+    if (density < pc.get_density() / MAX_DENSITY_DEGRADATION)
+      continue;
+
+    leaders[i] = pred;
+    merge_clusters(clusters, pred, i);
+  }
+
+  // Place remaining clusters in decreasing order of density.
+  sorted.clear();
+  for (i64 i = 0; i < clusters.size(); i++)
+    if (clusters[i].size)
+      sorted.push_back(i);
+
+  sort(sorted, [&](i64 a, i64 b) {
+    return clusters[a].get_density() > clusters[b].get_density();
+  });
+
+  std::unordered_map<InputSection<E> *, i64> order;
+  for (i64 leader : sorted) {
+    i64 i = leader;
+    do {
+      order.insert({sections[i], order.size()});
+      i = clusters[i].next;
+    } while (i != leader);
+  }
+
+  apply_section_order(ctx, order);
+}
+
+#define INSTANTIATE(E)                                                  \
+  template void sort_by_call_graph(Context<E> &ctx);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -27,7 +27,7 @@ Options:
   -M, --print-map             Write map file to stdout
   -N, --omagic                Do not page align data, do not make text readonly
     --no-omagic
-  -O NUMBER                   Ignored
+  -O NUMBER                   Set optimization level (-O2 merges string tails)
   -S, --strip-debug           Strip .debug_* sections
   -T FILE, --script FILE      Read linker script
   -X, --discard-locals        Discard temporary local symbols
@@ -48,22 +48,34 @@ Options:
   --Bsymbolic-functions       Bind global functions locally
   --Bno-symbolic              Cancel --Bsymbolic and --Bsymbolic-functions
   --Map FILE                  Write map file to a given file
+  --Map-format [text,json]    Set map file format (default: text)
   --allow-multiple-definition Allow multiple definitions
   --as-needed                 Only set DT_NEEDED if used
     --no-as-needed
-  --build-id [none,md5,sha1,sha256,uuid,HEXSTRING]
+  --batch FILE                Link each command line in FILE in turn
+  --build-id [none,md5,sha1,sha256,fast,uuid,HEXSTRING]
                               Generate build ID
     --no-build-id
+  --call-graph-ordering-file FILE
+                              Lay out functions using a call graph profile
   --chroot DIR                Set a given path to root directory
   --color-diagnostics         Ignored
-  --compress-debug-sections [none,zlib,zlib-gabi,zlib-gnu]
+  --data-ordering-file FILE   Place sections of data symbols listed in FILE
+                              first
+  --compress-debug-sections [none,zlib,zlib-gabi,zlib-gnu,zstd]
                               Compress .debug_* sections
+  --copy-file-range           Copy large unrelocated debug sections with copy_file_range
+  --debug-names               Merge .debug_names into one index for faster debugger startup
+    --no-debug-names
   --demangle                  Demangle C++ symbols in log messages (default)
     --no-demangle
   --disable-new-dtags         Ignored
   --dynamic-list              Read a list of dynamic symbols
+  --early-writeback           Start writing back output file pages while copying sections
+    --no-early-writeback
   --eh-frame-hdr              Create .eh_frame_hdr section
     --no-eh-frame-hdr
+  --emit-relocs, -q           Keep relocations of allocated sections in the output
   --enable-new-dtags          Ignored
   --exclude-libs LIB,LIB,..   Mark all symbols in given libraries hidden
   --fatal-warnings            Ignored
@@ -73,19 +85,35 @@ Options:
     --no-fork
   --gc-sections               Remove unreferenced sections
     --no-gc-sections
-  --gdb-index                 Ignored
+  --gdb-index                 Create .gdb_index for faster gdb startup
   --hash-style [sysv,gnu,both]
-                              Set hash style
-  --icf                       Fold identical code
+                              Set hash style (default: gnu)
+  --huge-pages                Build the output in a buffer backed by transparent huge pages
+    --no-huge-pages
+  --icf [all,all-data,safe,none]
+                              Fold identical code
     --no-icf
   --image-base ADDR           Set the base address to a given value
   --init SYMBOL               Call SYMBOl at load-time
+  --jobserver                 Share CPUs with other jobs via GNU make's jobserver
+    --no-jobserver
+  --link-cache DIR            Cache output files in DIR
+  --memory-limit SIZE         Limit memory used by parallel copy and compression
   --no-undefined              Report undefined symbols (even with --shared)
-  --perf                      Print performance statistics
+  --optimize-bb-jumps         Remove jumps to the next basic block section
+    --no-optimize-bb-jumps
+  --parse-cache DIR           Cache results of parsing object files in DIR
+  --perf [text,json,chrome-trace,files]
+                              Print performance statistics
+  --perf-counters             Print hardware performance counters with --perf
+  --perf-sweep COUNT[,COUNT...]
+                              Link with each number of threads and compare
+                              the time of each phase
+  --progress-fd FD            Report the current phase and progress to FD
   --pie, --pic-executable     Create a position independent executable
     --no-pie, --no-pic-executable
-  --plugin                    Ignored
-  --plugin-opt                Ignored
+  --plugin PLUGIN             Load a linker plugin for link-time optimization
+  --plugin-opt OPTION         Pass an option to the linker plugin
   --pop-state                 Pop state of flags governing input file handling
   --preload
     --no-preload
@@ -98,21 +126,33 @@ Options:
     --no-quick-exit
   --relax                     Optimize instructions (default)
     --no-relax
+  --release-inputs            Drop input files from memory once they are copied
   --repro                     Embed input files to .repro section
+  --repro-file FILE           Write input files to FILE as a .tar.zst archive
   --require-defined SYMBOL    Require SYMBOL be defined in the final output
   --retain-symbols-file FILE  Keep only symbols listed in FILE
   --rpath DIR                 Add DIR to runtime search path
   --rpath-link DIR            Ignored
   --run COMMAND ARG...        Run COMMAND with mold as /usr/bin/ld
+  --separate-debug-file[=FILE]
+                              Write debug info sections to FILE (default: OUTPUT.dbg)
   --shared, --Bshareable      Create a share library
+  --shm-parse-cache           Cache results of parsing object files in shared memory
+  --skip-unchanged-output     Do not rewrite the output if its inputs are unchanged
+    --no-skip-unchanged-output
   --sort-common               Ignored
   --sort-section              Ignored
   --spare-dynamic-tags NUMBER Reserve give number of tags in .dynamic section
   --start-lib                 Give following object files in-archive-file semantics
     --end-lib                 End the effect of --start-lib
   --static                    Do not link against shared libraries
-  --stats                     Print input statistics
+  --stats [text,json]         Print input statistics
+  --strip-debug-except SECTION,SECTION,...
+                              Strip .debug_* sections except given ones
+  --symbol-ordering-file FILE Place sections of symbols listed in FILE first
   --sysroot DIR               Set target system root directory
+  --thinlto-cache-dir DIR     Cache ThinLTO backend outputs in DIR (LLVMgold only)
+  --thinlto-jobs COUNT        Use COUNT threads for ThinLTO backends (LLVMgold only)
   --thread-count COUNT        Use COUNT number of threads
   --threads                   Use multiple threads (default)
     --no-threads
@@ -120,6 +160,7 @@ Options:
   --unique PATTERN            Don't merge input sections that match a given pattern
   --unresolved-symbols [report-all,ignore-all,ignore-in-object-files,ignore-in-shared-libs]
                               How to handle unresolved symbols
+  --update-in-place           Overwrite only changed pages of an existing output file
   --version-script FILE       Read version script
   --warn-common               Warn about common symbols
     --no-warn-common
@@ -129,10 +170,14 @@ Options:
   --whole-archive             Include all objects from static archives
     --no-whole-archive
   --wrap SYMBOL               Use wrapper function for a given symbol
+  -z compact-relro            Do not pad the end of the RELRO segment in the file
+    -z nocompact-relro
   -z defs                     Report undefined symbols (even with --shared)
     -z nodefs
   -z execstack                Require executable stack
     -z noexecstack
+  -z hugepage-text            Align and pad the executable segment to 2 MiB huge pages
+    -z nohugepage-text
   -z initfirst                Mark DSO to be initialized first at runtime
   -z interpose                Mark object to interpose all DSOs but executable
   -z keep-text-section-prefix Keep .text.{hot,unknown,unlikely,startup,exit} as separate sections in the final binary
@@ -144,6 +189,8 @@ Options:
   -z nodump                   Mark DSO not available to dldump
   -z now                      Disable lazy function resolution
   -z origin                   Mark object requiring immediate $ORIGIN processing at runtime
+  -z pack-relative-relocs     Use compact relative relocations (.relr.dyn)
+    -z nopack-relative-relocs
   -z relro                    Make some sections read-only after relocation (default)
     -z norelro
   -z text                     Report error if DT_TEXTREL is set
@@ -153,22 +200,33 @@ Options:
 mold: supported targets: elf32-i386 elf64-x86-64
 mold: supported emulations: elf_i386 elf_x86_64)";
 
-static std::vector<std::string> add_dashes(std::string name) {
-  // Multi-letter linker options can be preceded by either a single
-  // dash or double dashes except ones starting with "o", which must
-  // be preceded by double dashes. For example, "-omagic" is
-  // interpreted as "-o magic". If you really want to specify the
-  // "omagic" option, you have to pass "--omagic".
-  if (name[0] == 'o')
-    return {"--" + name};
-  return {"-" + name, "--" + name};
+// Returns the number of leading dashes of `opt` if they are valid as
+// a prefix of option `name`, or 0 otherwise.
+//
+// Multi-letter linker options can be preceded by either a single
+// dash or double dashes except ones starting with "o", which must
+// be preceded by double dashes. For example, "-omagic" is
+// interpreted as "-o magic". If you really want to specify the
+// "omagic" option, you have to pass "--omagic".
+//
+// These functions are called hundreds of times for each command line
+// argument, so they don't allocate memory.
+static i64 count_dashes(std::string_view opt, std::string_view name) {
+  if (opt.starts_with("--"))
+    return 2;
+  if (opt.starts_with('-') && name[0] != 'o')
+    return 1;
+  return 0;
 }
 
 template <typename E>
 bool read_arg(Context<E> &ctx, std::span<std::string_view> &args,
-              std::string_view &arg, std::string name) {
+              std::string_view &arg, std::string_view name) {
   if (name.size() == 1) {
-    if (args[0] == "-" + name) {
+    if (args[0].size() < 2 || args[0][0] != '-' || args[0][1] != name[0])
+      return false;
+
+    if (args[0].size() == 2) {
       if (args.size() == 1)
         Fatal(ctx) << "option -" << name << ": argument missing";
       arg = args[1];
@@ -176,49 +234,52 @@ bool read_arg(Context<E> &ctx, std::span<std::string_view> &args,
       return true;
     }
 
-    if (args[0].starts_with("-" + name)) {
-      arg = args[0].substr(name.size() + 1);
-      args = args.subspan(1);
-      return true;
-    }
-    return false;
+    arg = args[0].substr(2);
+    args = args.subspan(1);
+    return true;
   }
 
-  for (std::string opt : add_dashes(name)) {
-    if (args[0] == opt) {
-      if (args.size() == 1)
-        Fatal(ctx) << "option -" << name << ": argument missing";
-      arg = args[1];
-      args = args.subspan(2);
-      return true;
-    }
+  i64 dashes = count_dashes(args[0], name);
+  if (dashes == 0)
+    return false;
 
-    if (args[0].starts_with(opt + "=")) {
-      arg = args[0].substr(opt.size() + 1);
-      args = args.subspan(1);
-      return true;
-    }
+  std::string_view opt = args[0].substr(dashes);
+  if (!opt.starts_with(name))
+    return false;
+
+  if (opt.size() == name.size()) {
+    if (args.size() == 1)
+      Fatal(ctx) << "option -" << name << ": argument missing";
+    arg = args[1];
+    args = args.subspan(2);
+    return true;
+  }
+
+  if (opt[name.size()] == '=') {
+    arg = opt.substr(name.size() + 1);
+    args = args.subspan(1);
+    return true;
   }
   return false;
 }
 
-bool read_flag(std::span<std::string_view> &args, std::string name) {
-  for (std::string opt : add_dashes(name)) {
-    if (args[0] == opt) {
-      args = args.subspan(1);
-      return true;
-    }
+bool read_flag(std::span<std::string_view> &args, std::string_view name) {
+  i64 dashes = count_dashes(args[0], name);
+  if (dashes && args[0].substr(dashes) == name) {
+    args = args.subspan(1);
+    return true;
   }
   return false;
 }
 
-static bool read_z_flag(std::span<std::string_view> &args, std::string name) {
+static bool read_z_flag(std::span<std::string_view> &args,
+                        std::string_view name) {
   if (args.size() >= 2 && args[0] == "-z" && args[1] == name) {
     args = args.subspan(2);
     return true;
   }
 
-  if (!args.empty() && args[0] == "-z" + name) {
+  if (!args.empty() && args[0].starts_with("-z") && args[0].substr(2) == name) {
     args = args.subspan(1);
     return true;
   }
@@ -276,6 +337,24 @@ static i64 parse_number(Context<E> &ctx, std::string opt,
   return ret;
 }
 
+// Parses a number of bytes optionally followed by K, M or G.
+template <typename E>
+static i64 parse_size(Context<E> &ctx, std::string opt,
+                      std::string_view value) {
+  i64 shift = 0;
+  if (value.ends_with('K') || value.ends_with('k'))
+    shift = 10;
+  else if (value.ends_with('M') || value.ends_with('m'))
+    shift = 20;
+  else if (value.ends_with('G') || value.ends_with('g'))
+    shift = 30;
+
+  std::string_view digits = value.substr(0, value.size() - (shift ? 1 : 0));
+  if (digits.empty() || digits.find_first_not_of("0123456789") != digits.npos)
+    Fatal(ctx) << "option -" << opt << ": not a number: " << value;
+  return std::stol(std::string(digits)) << shift;
+}
+
 template <typename E>
 static std::vector<u8> parse_hex_build_id(Context<E> &ctx,
                                           std::string_view arg) {
@@ -314,7 +393,7 @@ split_by_comma_or_colon(std::string_view str) {
       break;
     }
     vec.push_back(str.substr(0, pos));
-    str = str.substr(pos);
+    str = str.substr(pos + 1);
   }
   return vec;
 }
@@ -331,13 +410,14 @@ static std::string_view trim(std::string_view str) {
   return str.substr(0, pos + 1);
 }
 
+// Reads a text file containing a symbol name on each line.
 template <typename E>
-static void read_retain_symbols_file(Context<E> &ctx, std::string_view path) {
+static std::vector<std::string_view>
+read_symbol_list(Context<E> &ctx, std::string_view path) {
   MappedFile<Context<E>> *mf =
     MappedFile<Context<E>>::must_open(ctx, std::string(path));
   std::string_view data((char *)mf->data, mf->size);
-
-  ctx.arg.retain_symbols_file.reset(new std::unordered_set<std::string_view>);
+  std::vector<std::string_view> vec;
 
   while (!data.empty()) {
     size_t pos = data.find('\n');
@@ -353,8 +433,52 @@ static void read_retain_symbols_file(Context<E> &ctx, std::string_view path) {
 
     name = trim(name);
     if (!name.empty())
-      ctx.arg.retain_symbols_file->insert(name);
+      vec.push_back(name);
   }
+  return vec;
+}
+
+// Reads a call graph profile. Each line consists of a caller symbol,
+// a callee symbol and the number of calls from the caller to the callee.
+template <typename E>
+static void read_call_graph_ordering_file(Context<E> &ctx,
+                                          std::string_view path) {
+  for (std::string_view line : read_symbol_list(ctx, path)) {
+    std::istringstream in{std::string(line)};
+    std::string from, to;
+    u64 weight;
+
+    if (!(in >> from >> to >> weight) || !(in >> std::ws).eof())
+      Fatal(ctx) << path << ": invalid call graph profile entry: " << line;
+
+    ctx.arg.call_graph_ordering_file.push_back(
+      {save_string(ctx, from), save_string(ctx, to), weight});
+  }
+}
+
+// Reads a data ordering file. Each line consists of a data symbol
+// optionally followed by "write-hot", which indicates that the symbol
+// is frequently written and should be on its own cache line.
+template <typename E>
+static void read_data_ordering_file(Context<E> &ctx, std::string_view path) {
+  for (std::string_view line : read_symbol_list(ctx, path)) {
+    std::istringstream in{std::string(line)};
+    std::string name, attr;
+
+    if (!(in >> name) || ((in >> attr) && attr != "write-hot") ||
+        !(in >> std::ws).eof())
+      Fatal(ctx) << path << ": invalid data ordering entry: " << line;
+
+    ctx.arg.data_ordering_file.push_back(
+      {save_string(ctx, name), attr == "write-hot"});
+  }
+}
+
+template <typename E>
+static void read_retain_symbols_file(Context<E> &ctx, std::string_view path) {
+  ctx.arg.retain_symbols_file.reset(new std::unordered_set<std::string_view>);
+  for (std::string_view name : read_symbol_list(ctx, path))
+    ctx.arg.retain_symbols_file->insert(name);
 }
 
 static bool is_file(std::string_view path) {
@@ -370,10 +494,19 @@ void parse_nonpositional_args(Context<E> &ctx,
   args = args.subspan(1);
 
   bool version_shown = false;
+  bool separate_debug_file = false;
 
   while (!args.empty()) {
     std::string_view arg;
 
+    // Most arguments are usually input file names. They can't match
+    // any option, so skip the long chain of comparisons below.
+    if (!args[0].starts_with('-')) {
+      remaining.push_back(args[0]);
+      args = args.subspan(1);
+      continue;
+    }
+
     if (read_flag(args, "help")) {
       SyncOut(ctx) << "Usage: " << ctx.cmdline_args[0]
                    << " [options] file...\n" << helpmsg;
@@ -428,6 +561,13 @@ void parse_nonpositional_args(Context<E> &ctx,
     } else if (read_arg(ctx, args, arg, "Map")) {
       ctx.arg.Map = arg;
       ctx.arg.print_map = true;
+    } else if (read_arg(ctx, args, arg, "Map-format")) {
+      if (arg == "text")
+        ctx.arg.print_map_json = false;
+      else if (arg == "json")
+        ctx.arg.print_map_json = true;
+      else
+        Fatal(ctx) << "invalid --Map-format argument: " << arg;
     } else if (read_flag(args, "print-map") || read_flag(args, "M")) {
       ctx.arg.print_map = true;
     } else if (read_flag(args, "static") || read_flag(args, "Bstatic")) {
@@ -440,6 +580,12 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.shared = true;
     } else if (read_arg(ctx, args, arg, "spare-dynamic-tags")) {
       ctx.arg.spare_dynamic_tags = parse_number(ctx, "spare-dynamic-tags", arg);
+    } else if (read_arg(ctx, args, arg, "call-graph-ordering-file")) {
+      read_call_graph_ordering_file(ctx, arg);
+    } else if (read_arg(ctx, args, arg, "data-ordering-file")) {
+      read_data_ordering_file(ctx, arg);
+    } else if (read_arg(ctx, args, arg, "symbol-ordering-file")) {
+      append(ctx.arg.symbol_ordering_file, read_symbol_list(ctx, arg));
     } else if (read_flag(args, "start-lib")) {
       remaining.push_back("-start-lib");
     } else if (read_flag(args, "demangle")) {
@@ -492,8 +638,26 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.soname = arg;
     } else if (read_flag(args, "allow-multiple-definition")) {
       ctx.arg.allow_multiple_definition = true;
+    } else if (read_flag(args, "copy-file-range")) {
+      ctx.arg.copy_file_range = true;
+    } else if (read_flag(args, "early-writeback")) {
+      ctx.arg.early_writeback = true;
+    } else if (read_flag(args, "no-early-writeback")) {
+      ctx.arg.early_writeback = false;
     } else if (read_flag(args, "trace")) {
       ctx.arg.trace = true;
+    } else if (read_flag(args, "update-in-place")) {
+      ctx.arg.update_in_place = true;
+    } else if (read_flag(args, "jobserver")) {
+      ctx.arg.jobserver = true;
+    } else if (read_flag(args, "no-jobserver")) {
+      ctx.arg.jobserver = false;
+    } else if (read_flag(args, "huge-pages")) {
+      ctx.arg.huge_pages = true;
+    } else if (read_flag(args, "no-huge-pages")) {
+      ctx.arg.huge_pages = false;
+    } else if (read_flag(args, "emit-relocs") || read_flag(args, "q")) {
+      ctx.arg.emit_relocs = true;
     } else if (read_flag(args, "eh-frame-hdr")) {
       ctx.arg.eh_frame_hdr = true;
     } else if (read_flag(args, "no-eh-frame-hdr")) {
@@ -509,13 +673,60 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.relax = true;
     } else if (read_flag(args, "no-relax")) {
       ctx.arg.relax = false;
+    } else if (read_flag(args, "release-inputs")) {
+      ctx.arg.release_inputs = true;
     } else if (read_flag(args, "r") || read_flag(args, "relocatable")) {
       ctx.arg.relocatable = true;
+    } else if (read_flag(args, "perf-counters")) {
+      ctx.arg.perf = true;
+      TimerRecord::enabled = true;
+      if (!HwCounters::enable())
+        Warn(ctx) << "--perf-counters: hardware performance counters are "
+                  << "not available";
+    } else if (read_arg(ctx, args, arg, "progress-fd")) {
+      i64 fd = parse_number(ctx, "progress-fd", arg);
+      if (fd < 0 || fcntl(fd, F_GETFD) == -1)
+        Fatal(ctx) << "--progress-fd: bad file descriptor: " << arg;
+      Progress::fd = fd;
+    } else if (read_arg(ctx, args, arg, "perf-sweep")) {
+      ctx.arg.perf_sweep.clear();
+      for (std::string_view s : split_by_comma_or_colon(arg)) {
+        i64 n = parse_number(ctx, "perf-sweep", s);
+        if (n <= 0)
+          Fatal(ctx) << "--perf-sweep: invalid thread count: " << s;
+        ctx.arg.perf_sweep.push_back(n);
+      }
+      TimerRecord::enabled = true;
     } else if (read_flag(args, "perf")) {
       ctx.arg.perf = true;
+      TimerRecord::enabled = true;
+    } else if (read_arg(ctx, args, arg, "perf")) {
+      ctx.arg.perf = true;
+      TimerRecord::enabled = true;
+      if (arg == "text")
+        ctx.arg.perf_format = PERF_TEXT;
+      else if (arg == "json")
+        ctx.arg.perf_format = PERF_JSON;
+      else if (arg == "chrome-trace")
+        ctx.arg.perf_format = PERF_CHROME_TRACE;
+      else if (arg == "files")
+        ctx.arg.perf_files = true;
+      else
+        Fatal(ctx) << "unknown --perf argument: " << arg;
     } else if (read_flag(args, "stats")) {
       ctx.arg.stats = true;
       Counter::enabled = true;
+      TimerRecord::enabled = true;
+    } else if (read_arg(ctx, args, arg, "stats")) {
+      ctx.arg.stats = true;
+      Counter::enabled = true;
+      TimerRecord::enabled = true;
+      if (arg == "text")
+        ctx.arg.stats_format = STATS_TEXT;
+      else if (arg == "json")
+        ctx.arg.stats_format = STATS_JSON;
+      else
+        Fatal(ctx) << "unknown --stats argument: " << arg;
     } else if (read_arg(ctx, args, arg, "C") ||
                read_arg(ctx, args, arg, "directory")) {
       ctx.arg.directory = arg;
@@ -530,6 +741,8 @@ void parse_nonpositional_args(Context<E> &ctx,
         ctx.arg.compress_debug_sections = COMPRESS_GABI;
       else if (arg == "zlib-gnu")
         ctx.arg.compress_debug_sections = COMPRESS_GNU;
+      else if (arg == "zstd")
+        ctx.arg.compress_debug_sections = COMPRESS_ZSTD;
       else if (arg == "none")
         ctx.arg.compress_debug_sections = COMPRESS_NONE;
       else
@@ -541,10 +754,34 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.is_static = true;
     } else if (read_flag(args, "no-omagic")) {
       ctx.arg.omagic = false;
+    } else if (read_flag(args, "optimize-bb-jumps")) {
+      ctx.arg.optimize_bb_jumps = true;
+    } else if (read_flag(args, "no-optimize-bb-jumps")) {
+      ctx.arg.optimize_bb_jumps = false;
     } else if (read_arg(ctx, args, arg, "retain-symbols-file")) {
       read_retain_symbols_file(ctx, arg);
+    } else if (read_arg(ctx, args, arg, "link-cache")) {
+      ctx.arg.link_cache = arg;
+    } else if (read_arg(ctx, args, arg, "parse-cache")) {
+      ctx.arg.parse_cache = arg;
+      ctx.arg.shm_parse_cache = false;
+    } else if (read_flag(args, "shm-parse-cache")) {
+      ctx.arg.parse_cache = "/dev/shm/mold-parse-cache-" +
+                            std::to_string(getuid());
+      ctx.arg.shm_parse_cache = true;
+    } else if (read_flag(args, "skip-unchanged-output")) {
+      ctx.arg.skip_unchanged_output = true;
+    } else if (read_flag(args, "no-skip-unchanged-output")) {
+      ctx.arg.skip_unchanged_output = false;
+    } else if (read_flag(args, "separate-debug-file")) {
+      separate_debug_file = true;
+    } else if (read_arg(ctx, args, arg, "separate-debug-file")) {
+      separate_debug_file = true;
+      ctx.arg.separate_debug_file = arg;
     } else if (read_flag(args, "repro")) {
       ctx.arg.repro = true;
+    } else if (read_arg(ctx, args, arg, "repro-file")) {
+      ctx.arg.repro_file = arg;
     } else if (read_z_flag(args, "now")) {
       ctx.arg.z_now = true;
     } else if (read_z_flag(args, "lazy")) {
@@ -557,6 +794,10 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.z_relro = true;
     } else if (read_z_flag(args, "norelro")) {
       ctx.arg.z_relro = false;
+    } else if (read_z_flag(args, "compact-relro")) {
+      ctx.arg.z_compact_relro = true;
+    } else if (read_z_flag(args, "nocompact-relro")) {
+      ctx.arg.z_compact_relro = false;
     } else if (read_z_flag(args, "defs")) {
       ctx.arg.z_defs = true;
     } else if (read_z_flag(args, "nodefs")) {
@@ -575,6 +816,10 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.z_interpose = true;
     } else if (read_z_flag(args, "muldefs")) {
       ctx.arg.allow_multiple_definition = true;
+    } else if (read_z_flag(args, "hugepage-text")) {
+      ctx.arg.z_hugepage_text = true;
+    } else if (read_z_flag(args, "nohugepage-text")) {
+      ctx.arg.z_hugepage_text = false;
     } else if (read_z_flag(args, "keep-text-section-prefix")) {
       ctx.arg.z_keep_text_section_prefix = true;
     } else if (read_z_flag(args, "nokeep-text-section-prefix")) {
@@ -585,6 +830,10 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.z_text = false;
     } else if (read_z_flag(args, "origin")) {
       ctx.arg.z_origin = true;
+    } else if (read_z_flag(args, "pack-relative-relocs")) {
+      ctx.arg.pack_dyn_relocs_relr = true;
+    } else if (read_z_flag(args, "nopack-relative-relocs")) {
+      ctx.arg.pack_dyn_relocs_relr = false;
     } else if (read_flag(args, "no-undefined")) {
       ctx.arg.z_defs = true;
     } else if (read_flag(args, "fatal-warnings")) {
@@ -599,17 +848,34 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.gc_sections = true;
     } else if (read_flag(args, "no-gc-sections")) {
       ctx.arg.gc_sections = false;
+    } else if (read_flag(args, "debug-names")) {
+      ctx.arg.debug_names = true;
+    } else if (read_flag(args, "no-debug-names")) {
+      ctx.arg.debug_names = false;
+    } else if (read_flag(args, "gdb-index")) {
+      ctx.arg.gdb_index = true;
     } else if (read_flag(args, "print-gc-sections")) {
       ctx.arg.print_gc_sections = true;
     } else if (read_flag(args, "no-print-gc-sections")) {
       ctx.arg.print_gc_sections = false;
     } else if (read_arg(ctx, args, arg, "icf")) {
-      if (arg == "all")
+      if (arg == "all") {
         ctx.arg.icf = true;
-      else if (arg == "none")
+        ctx.arg.icf_all = true;
+        ctx.arg.icf_data = false;
+      } else if (arg == "all-data") {
+        ctx.arg.icf = true;
+        ctx.arg.icf_all = true;
+        ctx.arg.icf_data = true;
+      } else if (arg == "safe") {
+        ctx.arg.icf = true;
+        ctx.arg.icf_all = false;
+        ctx.arg.icf_data = false;
+      } else if (arg == "none") {
         ctx.arg.icf = false;
-      else
+      } else {
         Fatal(ctx) << "unknown --icf argument: " << arg;
+      }
     } else if (read_flag(args, "no-icf")) {
       ctx.arg.icf = false;
     } else if (read_arg(ctx, args, arg, "image-base")) {
@@ -626,6 +892,12 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.quick_exit = true;
     } else if (read_flag(args, "no-quick-exit")) {
       ctx.arg.quick_exit = false;
+    } else if (read_arg(ctx, args, arg, "thinlto-cache-dir")) {
+      ctx.arg.thinlto_cache_dir = arg;
+    } else if (read_arg(ctx, args, arg, "memory-limit")) {
+      ctx.arg.memory_limit = parse_size(ctx, "memory-limit", arg);
+    } else if (read_arg(ctx, args, arg, "thinlto-jobs")) {
+      ctx.arg.thinlto_jobs = parse_number(ctx, "thinlto-jobs", arg);
     } else if (read_arg(ctx, args, arg, "thread-count")) {
       ctx.arg.thread_count = parse_number(ctx, "thread-count", arg);
     } else if (read_flag(args, "threads")) {
@@ -638,6 +910,9 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.discard_locals = true;
     } else if (read_flag(args, "strip-all") || read_flag(args, "s")) {
       ctx.arg.strip_all = true;
+    } else if (read_arg(ctx, args, arg, "strip-debug-except")) {
+      for (std::string_view name : split_by_comma_or_colon(arg))
+        ctx.arg.strip_debug_except.insert(name);
     } else if (read_flag(args, "strip-debug") || read_flag(args, "S")) {
       ctx.arg.strip_all = true;
     } else if (read_flag(args, "warn-unresolved-symbols")) {
@@ -658,6 +933,7 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.rpaths += arg;
     } else if (read_flag(args, "build-id")) {
       ctx.arg.build_id.kind = BuildId::HASH;
+      ctx.arg.build_id.hash_func = BuildId::SHA256;
       ctx.arg.build_id.hash_size = 20;
     } else if (read_arg(ctx, args, arg, "build-id")) {
       if (arg == "none") {
@@ -666,13 +942,20 @@ void parse_nonpositional_args(Context<E> &ctx,
         ctx.arg.build_id.kind = BuildId::UUID;
       } else if (arg == "md5") {
         ctx.arg.build_id.kind = BuildId::HASH;
+        ctx.arg.build_id.hash_func = BuildId::SHA256;
         ctx.arg.build_id.hash_size = 16;
       } else if (arg == "sha1") {
         ctx.arg.build_id.kind = BuildId::HASH;
+        ctx.arg.build_id.hash_func = BuildId::SHA256;
         ctx.arg.build_id.hash_size = 20;
       } else if (arg == "sha256") {
         ctx.arg.build_id.kind = BuildId::HASH;
+        ctx.arg.build_id.hash_func = BuildId::SHA256;
         ctx.arg.build_id.hash_size = 32;
+      } else if (arg == "fast") {
+        ctx.arg.build_id.kind = BuildId::HASH;
+        ctx.arg.build_id.hash_func = BuildId::XXH3;
+        ctx.arg.build_id.hash_size = 16;
       } else if (arg.starts_with("0x") || arg.starts_with("0X")) {
         ctx.arg.build_id.kind = BuildId::HEX;
         ctx.arg.build_id.value = parse_hex_build_id(ctx, arg);
@@ -692,14 +975,17 @@ void parse_nonpositional_args(Context<E> &ctx,
     } else if (read_flag(args, "no-preload")) {
       ctx.arg.preload = false;
     } else if (read_arg(ctx, args, arg, "O")) {
-    } else if (read_flag(args, "O0")) {
-    } else if (read_flag(args, "O1")) {
+      ctx.arg.tail_merge_strings = (parse_number(ctx, "O", arg) >= 2);
+    } else if (read_flag(args, "O0") || read_flag(args, "O1")) {
+      ctx.arg.tail_merge_strings = false;
     } else if (read_flag(args, "O2")) {
+      ctx.arg.tail_merge_strings = true;
     } else if (read_flag(args, "verbose")) {
     } else if (read_arg(ctx, args, arg, "plugin")) {
+      ctx.arg.plugin = arg;
     } else if (read_arg(ctx, args, arg, "plugin-opt")) {
+      ctx.arg.plugin_opt.push_back(std::string(arg));
     } else if (read_flag(args, "color-diagnostics")) {
-    } else if (read_flag(args, "gdb-index")) {
     } else if (read_flag(args, "eh-frame-hdr")) {
     } else if (read_flag(args, "start-group")) {
     } else if (read_flag(args, "end-group")) {
@@ -783,6 +1069,26 @@ void parse_nonpositional_args(Context<E> &ctx,
   if (ctx.arg.relocatable)
     ctx.arg.is_static = true;
 
+  if (ctx.arg.memory_limit) {
+    ctx.arg.release_inputs = true;
+    ctx.memory_budget.limit = ctx.arg.memory_limit;
+  }
+
+  // A daemon can't know which inputs will be given by a client
+  // when it computes a digest of them.
+  if (ctx.arg.preload)
+    ctx.arg.skip_unchanged_output = false;
+
+  // Each link of --perf-sweep must do the actual work, and the
+  // parent process waits for them anyway.
+  if (!ctx.arg.perf_sweep.empty()) {
+    if (ctx.arg.preload)
+      Fatal(ctx) << "--perf-sweep may not be used with --preload";
+    ctx.arg.fork = false;
+    ctx.arg.link_cache = "";
+    ctx.arg.skip_unchanged_output = false;
+  }
+
   if (!ctx.arg.shared) {
     if (!ctx.arg.filter.empty())
       Fatal(ctx) << "-filter may not be used without -shared";
@@ -796,6 +1102,19 @@ void parse_nonpositional_args(Context<E> &ctx,
   if (ctx.arg.output.empty())
     ctx.arg.output = "a.out";
 
+  if (separate_debug_file) {
+    if (ctx.arg.relocatable)
+      Fatal(ctx) << "--separate-debug-file may not be used with -r";
+    if (ctx.arg.output == "-")
+      Fatal(ctx) << "--separate-debug-file may not be used with -o -";
+    if (ctx.arg.separate_debug_file.empty())
+      ctx.arg.separate_debug_file = ctx.arg.output + ".dbg";
+
+    // The link cache and the input digest check only the output file.
+    ctx.arg.link_cache = "";
+    ctx.arg.skip_unchanged_output = false;
+  }
+
   // TLSDESC relocs must be always relaxed for statically-linked
   // executables even if -no-relax is given. It is because a
   // statically-linked executable doesn't contain a tranpoline
@@ -810,7 +1129,7 @@ void parse_nonpositional_args(Context<E> &ctx,
   template                                                              \
   bool read_arg(Context<E> &ctx, std::span<std::string_view> &args,     \
                 std::string_view &arg,                                  \
-                std::string name);                                      \
+                std::string_view name);                                 \
                                                                         \
   template std::string create_response_file(Context<E> &ctx);           \
                                                                         \
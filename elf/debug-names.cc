@@ -0,0 +1,545 @@
+// This file creates a merged .debug_names section if --debug-names is
+// given.
+//
+// .debug_names is a DWARF 5 accelerator table mapping names of
+// functions, variables and types to DIEs in .debug_info. A compiler
+// emits one name index for each compilation unit (CU) if -gpubnames
+// is given, and a linker concatenates them by default. Debuggers can
+// use a concatenated index, but they have to look up a name in each
+// of them, which is as slow as having no index for a large program.
+// This pass merges them into one index covering all CUs.
+//
+// A name index consists of the following parts:
+//
+//  - A header
+//  - A list of CU offsets and a list of type unit (TU) offsets
+//  - A hash table consisting of buckets and hash values
+//  - Two arrays of offsets to name strings and to entry lists
+//  - An abbreviation table describing entry formats
+//  - An entry pool, containing a list of entries for each name
+//
+// Each entry refers to a DIE by a CU index and an offset from the
+// beginning of the CU. In a merged index, CU indices are different
+// from those in input indices, so we re-encode all entries. Strings
+// are in .debug_str, and we read them from mergeable string sections
+// of input files.
+//
+// We drop DW_IDX_parent attributes because they refer to other entries
+// by entry pool offsets. It is optional, and debuggers can find parent
+// DIEs in .debug_info anyway.
+//
+// Input indices are read in parallel, and names are uniquified using a
+// concurrent hash table. If an input index uses a feature we don't
+// support (e.g. 64-bit DWARF or foreign type units), we leave
+// .debug_names as is.
+//
+// The format is documented in section 6.1.1 of the DWARF 5 spec.
+
+#include "mold.h"
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_sort.h>
+
+namespace mold::elf {
+
+static constexpr i64 HEADER_SIZE = 36;
+
+// LLVM uses the same heuristic to pick a bucket count.
+static i64 get_bucket_count(i64 num_names) {
+  if (num_names > 1024)
+    return num_names / 4;
+  if (num_names > 16)
+    return num_names / 2;
+  return std::max<i64>(num_names, 1);
+}
+
+static bool is_supported_form(u64 form) {
+  switch (form) {
+  case DW_FORM_flag_present:
+  case DW_FORM_flag:
+  case DW_FORM_data1:
+  case DW_FORM_data2:
+  case DW_FORM_data4:
+  case DW_FORM_data8:
+  case DW_FORM_udata:
+  case DW_FORM_ref1:
+  case DW_FORM_ref2:
+  case DW_FORM_ref4:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_udata:
+  case DW_FORM_ref_sig8:
+    return true;
+  }
+  return false;
+}
+
+static u64 read_value(u8 *&p, u64 form) {
+  auto read = [&](auto val) {
+    p += sizeof(val);
+    return val;
+  };
+
+  switch (form) {
+  case DW_FORM_flag_present:
+    return 0;
+  case DW_FORM_flag:
+  case DW_FORM_data1:
+  case DW_FORM_ref1:
+    return read(*p);
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+    return read(*(u16 *)p);
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+    return read(*(u32 *)p);
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_sig8:
+    return read(*(u64 *)p);
+  case DW_FORM_udata:
+  case DW_FORM_ref_udata:
+    return read_uleb(p);
+  }
+  unreachable();
+}
+
+// Reads a name index at `begin`. `strings` maps offsets of string
+// references from the beginning of the input section `buf` to their
+// contents.
+template <typename E>
+bool DebugNamesSection<E>::read_unit(Context<E> &ctx, Unit &unit, u8 *buf,
+                                     u8 *begin, u8 *end,
+                                     std::span<std::pair<u64, std::string_view>> strings) {
+  InputSection<E> &isec = *unit.isec;
+
+  auto unsupported = [&](std::string_view msg) {
+    Warn(ctx) << isec << ": --debug-names: " << msg
+              << "; .debug_names is not merged";
+    return false;
+  };
+
+  if (*(u32 *)begin == 0xffff'ffff)
+    return unsupported("64-bit DWARF is not supported");
+  if (*(u16 *)(begin + 4) != 5)
+    return unsupported("unknown version");
+
+  u32 cu_count = *(u32 *)(begin + 8);
+  u32 local_tu_count = *(u32 *)(begin + 12);
+  u32 foreign_tu_count = *(u32 *)(begin + 16);
+  u32 bucket_count = *(u32 *)(begin + 20);
+  u32 name_count = *(u32 *)(begin + 24);
+  u32 abbrev_table_size = *(u32 *)(begin + 28);
+  u32 augmentation_size = *(u32 *)(begin + 32);
+
+  if (foreign_tu_count)
+    return unsupported("foreign type units are not supported");
+
+  u8 *p = begin + HEADER_SIZE + align_to(augmentation_size, 4);
+
+  for (i64 i = 0; i < cu_count; i++)
+    unit.cu_offsets.push_back(((u32 *)p)[i]);
+  p += cu_count * 4;
+
+  for (i64 i = 0; i < local_tu_count; i++)
+    unit.tu_offsets.push_back(((u32 *)p)[i]);
+  p += local_tu_count * 4;
+
+  // We compute hash values by ourselves, so skip the hash table.
+  p += bucket_count * 4;
+  if (bucket_count)
+    p += name_count * 4;
+
+  u32 *str_offsets = (u32 *)p;
+  u32 *entry_offsets = (u32 *)p + name_count;
+  u8 *abbrev = p + name_count * 8;
+  unit.pool = abbrev + abbrev_table_size;
+
+  if (end < unit.pool)
+    return unsupported("corrupted name index");
+
+  // Read the abbreviation table
+  for (;;) {
+    u64 code = read_uleb(abbrev);
+    if (code == 0)
+      break;
+
+    Abbrev &ent = unit.abbrevs[code];
+    ent.tag = read_uleb(abbrev);
+
+    for (;;) {
+      u64 idx = read_uleb(abbrev);
+      u64 form = read_uleb(abbrev);
+      if (idx == 0 && form == 0)
+        break;
+      if (!is_supported_form(form))
+        return unsupported("unknown form: " + std::to_string(form));
+      ent.attrs.push_back({idx, form});
+    }
+  }
+
+  // Read names
+  for (i64 i = 0; i < name_count; i++) {
+    u64 offset = (u8 *)(str_offsets + i) - buf;
+    auto it = std::partition_point(strings.begin(), strings.end(),
+                                   [&](const std::pair<u64, std::string_view> &x) {
+      return x.first < offset;
+    });
+
+    if (it == strings.end() || it->first != offset)
+      return unsupported("name strings must be in a mergeable section");
+
+    NameRef ref;
+    ref.name = it->second;
+    ref.str_offset = str_offsets[i];
+    ref.entry_offset = entry_offsets[i];
+    unit.names.push_back(ref);
+  }
+  return true;
+}
+
+// Converts an input abbreviation to the one we use in the output.
+template <typename Abbrev>
+static Abbrev to_output_abbrev(const Abbrev &abbrev) {
+  Abbrev ent;
+  ent.tag = abbrev.tag;
+
+  // An entry without a CU index refers to the only CU of its index.
+  bool has_unit = false;
+  for (std::pair<u64, u64> attr : abbrev.attrs)
+    if (attr.first == DW_IDX_compile_unit || attr.first == DW_IDX_type_unit)
+      has_unit = true;
+
+  if (!has_unit)
+    ent.attrs.push_back({DW_IDX_compile_unit, DW_FORM_data4});
+
+  for (std::pair<u64, u64> attr : abbrev.attrs) {
+    switch (attr.first) {
+    case DW_IDX_compile_unit:
+    case DW_IDX_type_unit:
+      ent.attrs.push_back({attr.first, DW_FORM_data4});
+      break;
+    case DW_IDX_die_offset:
+      ent.attrs.push_back({attr.first, DW_FORM_ref4});
+      break;
+    case DW_IDX_parent:
+      break;
+    default:
+      ent.attrs.push_back(attr);
+    }
+  }
+  return ent;
+}
+
+// Re-encodes the entries of a given name in the output format and
+// returns their size. If `buf` is null, it only computes the size.
+template <typename E>
+i64 DebugNamesSection<E>::encode_entries(Context<E> &ctx, Unit &unit,
+                                         NameRef &ref, u8 *buf) {
+  u8 *p = unit.pool + ref.entry_offset;
+  i64 size = 0;
+
+  auto write32 = [&](u32 val) {
+    if (buf)
+      *(u32 *)(buf + size) = val;
+    size += 4;
+  };
+
+  for (;;) {
+    u64 code = read_uleb(p);
+    if (code == 0)
+      return size;
+
+    auto it = unit.abbrevs.find(code);
+    if (it == unit.abbrevs.end())
+      Fatal(ctx) << *unit.isec << ": --debug-names: unknown abbreviation code: "
+                 << code;
+
+    u32 out_code = unit.codes[code];
+    if (buf)
+      write_uleb(buf + size, out_code);
+    size += uleb_size(out_code);
+
+    bool has_unit = false;
+    for (std::pair<u64, u64> attr : it->second.attrs)
+      if (attr.first == DW_IDX_compile_unit || attr.first == DW_IDX_type_unit)
+        has_unit = true;
+
+    if (!has_unit)
+      write32(unit.cu_base);
+
+    for (auto [idx, form] : it->second.attrs) {
+      u8 *start = p;
+      u64 val = read_value(p, form);
+
+      switch (idx) {
+      case DW_IDX_compile_unit:
+        write32(unit.cu_base + val);
+        break;
+      case DW_IDX_type_unit:
+        write32(unit.tu_base + val);
+        break;
+      case DW_IDX_die_offset:
+        write32(val);
+        break;
+      case DW_IDX_parent:
+        break;
+      default:
+        if (buf)
+          memcpy(buf + size, start, p - start);
+        size += p - start;
+      }
+    }
+  }
+}
+
+template <typename E>
+bool DebugNamesSection<E>::construct(Context<E> &ctx, OutputSection<E> &osec) {
+  std::vector<InputSection<E> *> &members = osec.members;
+  std::vector<std::vector<Unit>> vec(members.size());
+  std::atomic_bool ok = true;
+
+  for (InputSection<E> *isec : members)
+    bufs.emplace_back(new u8[isec->shdr.sh_size]);
+
+  // Read input name indices
+  tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+    InputSection<E> &isec = *members[i];
+    u8 *buf = bufs[i].get();
+    isec.write_to(ctx, buf);
+
+    // Name strings are referenced by relocations against .debug_str,
+    // which is a mergeable string section.
+    std::vector<std::pair<u64, std::string_view>> strings;
+    std::span<ElfRel<E>> rels = isec.get_rels(ctx);
+
+    if (isec.rel_subsections) {
+      for (i64 j = 0; isec.rel_subsections[j].idx != -1; j++) {
+        SubsectionRef<E> &ref = isec.rel_subsections[j];
+        std::string_view str =
+          ref.subsec->output_section.get_contents(ref.subsec).substr(ref.addend);
+        strings.push_back({rels[ref.idx].r_offset, str.substr(0, str.find('\0'))});
+      }
+    }
+    sort(strings);
+
+    u8 *p = buf;
+    u8 *end = buf + isec.shdr.sh_size;
+
+    while (p < end) {
+      Unit unit;
+      unit.isec = &isec;
+      u8 *next = p + *(u32 *)p + 4;
+
+      if (!read_unit(ctx, unit, buf, p, std::min(next, end), strings)) {
+        ok = false;
+        return;
+      }
+
+      vec[i].push_back(std::move(unit));
+      p = next;
+    }
+  });
+
+  if (!ok)
+    return false;
+
+  units = flatten(vec);
+
+  // Assign CU and TU indices in the output
+  for (Unit &unit : units) {
+    unit.cu_base = num_cus;
+    unit.tu_base = num_tus;
+    num_cus += unit.cu_offsets.size();
+    num_tus += unit.tu_offsets.size();
+  }
+
+  // Create an abbreviation table. We assign abbreviation codes in
+  // sorted order for the sake of reproducibility.
+  std::vector<Abbrev> abbrevs;
+  for (Unit &unit : units)
+    for (auto &[code, abbrev] : unit.abbrevs)
+      abbrevs.push_back(to_output_abbrev(abbrev));
+  sort(abbrevs);
+  abbrevs.erase(std::unique(abbrevs.begin(), abbrevs.end()), abbrevs.end());
+
+  for (i64 i = 0; i < abbrevs.size(); i++) {
+    encode_uleb(abbrev_table, i + 1);
+    encode_uleb(abbrev_table, abbrevs[i].tag);
+    for (std::pair<u64, u64> attr : abbrevs[i].attrs) {
+      encode_uleb(abbrev_table, attr.first);
+      encode_uleb(abbrev_table, attr.second);
+    }
+    abbrev_table.push_back(0);
+    abbrev_table.push_back(0);
+  }
+  abbrev_table.push_back(0);
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    for (auto &[code, abbrev] : unit.abbrevs) {
+      auto it = std::lower_bound(abbrevs.begin(), abbrevs.end(),
+                                 to_output_abbrev(abbrev));
+      unit.codes[code] = it - abbrevs.begin() + 1;
+    }
+  });
+
+  // Uniquify names
+  i64 num_names = 0;
+  for (Unit &unit : units)
+    num_names += unit.names.size();
+
+  if (num_names) {
+    map.resize(num_names);
+
+    tbb::parallel_for_each(units, [&](Unit &unit) {
+      for (NameRef &ref : unit.names) {
+        // DWARF 5 uses the same hash function as .gnu.hash.
+        MapValue val;
+        val.hash = djb_hash(ref.name);
+        val.str_offset = ref.str_offset;
+        ref.value = map.insert(ref.name, hash_string(ref.name), val).first;
+        assert(ref.value);
+        ref.size = encode_entries(ctx, unit, ref, nullptr);
+      }
+    });
+
+    for (i64 i = 0; i < map.nbuckets; i++)
+      if (map.has_key(i))
+        symbols.push_back({{map.keys[i], map.sizes[i]}, &map.values[i]});
+  }
+
+  // Names are sorted by buckets. The bucket order depends on thread
+  // scheduling, so sort them fully to make the output deterministic.
+  bucket_count = get_bucket_count(symbols.size());
+
+  tbb::parallel_sort(symbols.begin(), symbols.end(),
+                     [&](const std::pair<std::string_view, MapValue *> &a,
+                         const std::pair<std::string_view, MapValue *> &b) {
+    return std::tuple(a.second->hash % bucket_count, a.second->hash, a.first) <
+           std::tuple(b.second->hash % bucket_count, b.second->hash, b.first);
+  });
+
+  // Entries of the same name are concatenated in input order.
+  for (Unit &unit : units) {
+    for (NameRef &ref : unit.names) {
+      ref.offset = ref.value->size;
+      ref.value->size += ref.size;
+    }
+  }
+
+  // Each entry list is terminated by a null byte.
+  for (auto [name, val] : symbols) {
+    val->pool_offset = pool_size;
+    pool_size += val->size + 1;
+  }
+
+  i64 size = HEADER_SIZE + num_cus * 4 + num_tus * 4 + bucket_count * 4 +
+             symbols.size() * 12 + abbrev_table.size() + pool_size;
+
+  if (size >= UINT32_MAX)
+    Fatal(ctx) << "--debug-names: .debug_names is too large";
+
+  this->shdr.sh_size = size;
+  return true;
+}
+
+template <typename E>
+void DebugNamesSection<E>::copy_buf(Context<E> &ctx) {
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void DebugNamesSection<E>::write_to(Context<E> &ctx, u8 *base) {
+  // Write a header
+  *(u32 *)base = this->shdr.sh_size - 4;
+  *(u16 *)(base + 4) = 5;
+  *(u16 *)(base + 6) = 0;
+  *(u32 *)(base + 8) = num_cus;
+  *(u32 *)(base + 12) = num_tus;
+  *(u32 *)(base + 16) = 0;
+  *(u32 *)(base + 20) = bucket_count;
+  *(u32 *)(base + 24) = symbols.size();
+  *(u32 *)(base + 28) = abbrev_table.size();
+  *(u32 *)(base + 32) = 0;
+
+  // Write CU and TU lists
+  u32 *cu_list = (u32 *)(base + HEADER_SIZE);
+  u32 *tu_list = cu_list + num_cus;
+
+  for (Unit &unit : units) {
+    for (u32 offset : unit.cu_offsets)
+      *cu_list++ = offset;
+    for (u32 offset : unit.tu_offsets)
+      *tu_list++ = offset;
+  }
+
+  // Write a hash table and name arrays
+  u32 *buckets = (u32 *)(base + HEADER_SIZE) + num_cus + num_tus;
+  u32 *hashes = buckets + bucket_count;
+  u32 *str_offsets = hashes + symbols.size();
+  u32 *entry_offsets = str_offsets + symbols.size();
+
+  memset(buckets, 0, bucket_count * 4);
+
+  for (i64 i = symbols.size() - 1; i >= 0; i--)
+    buckets[symbols[i].second->hash % bucket_count] = i + 1;
+
+  tbb::parallel_for((i64)0, (i64)symbols.size(), [&](i64 i) {
+    MapValue &val = *symbols[i].second;
+    hashes[i] = val.hash;
+    str_offsets[i] = val.str_offset;
+    entry_offsets[i] = val.pool_offset;
+  });
+
+  // Write an abbreviation table
+  u8 *abbrev = (u8 *)(entry_offsets + symbols.size());
+  write_vector(abbrev, abbrev_table);
+
+  // Write the entry pool
+  u8 *pool = abbrev + abbrev_table.size();
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    for (NameRef &ref : unit.names)
+      encode_entries(ctx, unit, ref,
+                     pool + ref.value->pool_offset + ref.offset);
+  });
+
+  tbb::parallel_for_each(symbols, [&](std::pair<std::string_view, MapValue *> &sym) {
+    pool[sym.second->pool_offset + sym.second->size] = 0;
+  });
+}
+
+template <typename E>
+void create_debug_names(Context<E> &ctx) {
+  Timer t(ctx, "create_debug_names");
+
+  auto it = std::find_if(ctx.chunks.begin(), ctx.chunks.end(),
+                         [](Chunk<E> *chunk) {
+    return chunk->kind == Chunk<E>::REGULAR && chunk->name == ".debug_names";
+  });
+
+  if (it == ctx.chunks.end())
+    return;
+
+  std::unique_ptr<DebugNamesSection<E>> sec =
+    std::make_unique<DebugNamesSection<E>>();
+  if (!sec->construct(ctx, *(OutputSection<E> *)*it))
+    return;
+
+  sec->shndx = (*it)->shndx;
+  *it = sec.get();
+  ctx.debug_names = std::move(sec);
+
+  ctx.shstrtab->update_shdr(ctx);
+  ctx.ehdr->update_shdr(ctx);
+  ctx.shdr->update_shdr(ctx);
+}
+
+#define INSTANTIATE(E)                                                  \
+  template void create_debug_names(Context<E> &ctx);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -1,10 +1,13 @@
 // This file implements a mark-sweep garbage collector for -gc-sections.
 // In this algorithm, vertices are sections and edges are relocations.
 // Any section that is reachable from a root section is considered alive.
+// The graph is built by build_section_graph() in section-graph.cc.
 
 #include "mold.h"
 
 #include <tbb/concurrent_vector.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_for_each.h>
 
 namespace mold::elf {
@@ -25,47 +28,19 @@ static bool mark_section(InputSection<E> *isec) {
   return isec && isec->is_alive && !isec->is_visited.exchange(true);
 }
 
+// A relocation can refer either a subsection (i.e. a piece of string
+// in a mergeable string section) or a symbol. Subsections are not
+// vertices of the section graph, so we mark subsections referred to
+// by a live section after marking sections.
 template <typename E>
-static void visit(Context<E> &ctx, InputSection<E> *isec,
-                  tbb::feeder<InputSection<E> *> &feeder, i64 depth) {
-  assert(isec->is_visited);
-
-  // A relocation can refer either a subsection (i.e. a piece of
-  // string in a mergeable string section) or a symbol. Mark all
-  // subsections as alive.
-  if (SubsectionRef<E> *refs = isec->rel_subsections.get())
+static void mark_subsections(Context<E> &ctx, InputSection<E> &isec) {
+  if (SubsectionRef<E> *refs = isec.rel_subsections.get())
     for (i64 i = 0; refs[i].idx >= 0; i++)
       refs[i].subsec->is_alive.store(true, std::memory_order_relaxed);
 
-  // If this is a text section, .eh_frame may contain records
-  // describing how to handle exceptions for that function.
-  // We want to keep associated .eh_frame records.
-  for (FdeRecord<E> &fde : isec->get_fdes())
-    for (ElfRel<E> &rel : fde.get_rels().subspan(1))
-      if (Symbol<E> *sym = isec->file.symbols[rel.r_sym])
-        if (mark_section(sym->input_section))
-          feeder.add(sym->input_section);
-
-  for (ElfRel<E> &rel : isec->get_rels(ctx)) {
-    Symbol<E> &sym = *isec->file.symbols[rel.r_sym];
-
-    // Symbol can refer either a subsection or an input section.
-    // Mark a subsection as alive.
-    if (Subsection<E> *subsec = sym.get_subsec()) {
+  for (ElfRel<E> &rel : isec.get_rels(ctx))
+    if (Subsection<E> *subsec = isec.file.symbols[rel.r_sym]->get_subsec())
       subsec->is_alive.store(true, std::memory_order_relaxed);
-      continue;
-    }
-
-    if (!mark_section(sym.input_section))
-      continue;
-
-    // Mark a section alive. For better performacne, we don't call
-    // `feeder.add` too often.
-    if (depth < 3)
-      visit(ctx, sym.input_section, feeder, depth + 1);
-    else
-      feeder.add(sym.input_section);
-  }
 }
 
 template <typename E>
@@ -90,7 +65,7 @@ collect_root_set(Context<E> &ctx) {
 
   // Add sections that are not subject to garbage collection.
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-    for (std::unique_ptr<InputSection<E>> &isec : file->sections) {
+    for (InputSection<E> *isec : file->sections) {
       if (!isec || !isec->is_alive)
         continue;
 
@@ -103,7 +78,7 @@ collect_root_set(Context<E> &ctx) {
 
       if (is_init_fini(*isec) || is_c_identifier(isec->name()) ||
           isec->shdr.sh_type == SHT_NOTE)
-        enqueue_section(isec.get());
+        enqueue_section(isec);
     }
   });
 
@@ -135,15 +110,52 @@ collect_root_set(Context<E> &ctx) {
   return rootset;
 }
 
-// Mark all reachable sections
+// Mark all reachable sections. We traverse the section graph in
+// breadth-first order. Each level of the search is processed in
+// parallel, and a bitmap is used to record visited vertices, which is
+// much more compact than `is_visited` flags scattered in the heap.
 template <typename E>
 static void mark(Context<E> &ctx,
                  tbb::concurrent_vector<InputSection<E> *> &rootset) {
   Timer t(ctx, "mark");
 
-  tbb::parallel_for_each(rootset, [&](InputSection<E> *isec,
-                                    tbb::feeder<InputSection<E> *> &feeder) {
-    visit(ctx, isec, feeder, 0);
+  SectionGraph<E> &graph = *ctx.section_graph;
+  i64 num_vertices = graph.sections.size();
+  std::vector<std::atomic<u64>> bitmap((num_vertices + 63) / 64);
+
+  auto test_and_set = [&](u32 i) {
+    u64 mask = (u64)1 << (i % 64);
+    return !(bitmap[i / 64].fetch_or(mask, std::memory_order_relaxed) & mask);
+  };
+
+  std::vector<u32> frontier;
+  for (InputSection<E> *isec : rootset)
+    if (test_and_set(isec->graph_idx))
+      frontier.push_back(isec->graph_idx);
+
+  while (!frontier.empty()) {
+    tbb::enumerable_thread_specific<std::vector<u32>> next;
+
+    tbb::parallel_for((i64)0, (i64)frontier.size(), [&](i64 i) {
+      std::vector<u32> &vec = next.local();
+      for (u32 j : graph.get_edges(frontier[i]))
+        if (test_and_set(j))
+          vec.push_back(j);
+    });
+
+    frontier.clear();
+    for (std::vector<u32> &vec : next)
+      append(frontier, vec);
+  }
+
+  tbb::parallel_for((i64)0, num_vertices, [&](i64 i) {
+    if (bitmap[i / 64].load(std::memory_order_relaxed) & ((u64)1 << (i % 64))) {
+      InputSection<E> &isec = *graph.sections[i];
+      if (isec.shdr.sh_flags & SHF_ALLOC) {
+        isec.is_visited = true;
+        mark_subsections(ctx, isec);
+      }
+    }
   });
 }
 
@@ -152,12 +164,13 @@ template <typename E>
 static void sweep(Context<E> &ctx) {
   Timer t(ctx, "sweep");
   static Counter counter("garbage_sections");
+  DeferredOut<Context<E>> out(ctx);
 
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-    for (std::unique_ptr<InputSection<E>> &isec : file->sections) {
+    for (InputSection<E> *isec : file->sections) {
       if (isec && isec->is_alive && !isec->is_visited) {
         if (ctx.arg.print_gc_sections)
-          SyncOut(ctx) << "removing unused section " << *isec;
+          out.line() << "removing unused section " << *isec;
         isec->kill();
         counter++;
       }
@@ -0,0 +1,688 @@
+// This file creates a .gdb_index section if --gdb-index is given.
+//
+// .gdb_index is an index of debug info. Without it, gdb has to read
+// all .debug_info at startup to find out which compilation unit
+// defines which symbol, which is slow for large programs. A developer
+// can create the index with gdb-add-index after linking, but that's
+// a separate, single-threaded step which can take longer than the
+// link itself. Creating it in the linker is much faster.
+//
+// The section consists of the following parts:
+//
+//  - A header
+//  - A list of compilation units (CUs) in .debug_info
+//  - A list of type units (always empty in our output)
+//  - An address area, which maps address ranges to CUs
+//  - A hash table mapping symbol names to offsets in a constant pool
+//  - A constant pool, containing a list of CUs for each symbol name
+//    followed by symbol name strings
+//
+// We construct the index from linker-relocated debug info. CUs and
+// their address ranges are read from the first DIE of each CU, and
+// symbol names are read from .debug_gnu_pubnames and
+// .debug_gnu_pubtypes, which the compiler emits if -ggnu-pubnames is
+// given. Each input section is processed in parallel.
+//
+// Since the index size has to be known before the output file is
+// laid out, we construct it after symbol addresses are fixed but
+// before file offsets for non-allocated sections are assigned.
+//
+// The format is documented in gdb's manual:
+// https://sourceware.org/gdb/onlinedocs/gdb/Index-Section-Format.html
+
+#include "mold.h"
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_sort.h>
+#include <unordered_map>
+
+namespace mold::elf {
+
+static constexpr i64 GDB_INDEX_VERSION = 7;
+static constexpr i64 HEADER_SIZE = 24;
+
+template <typename E>
+static OutputSection<E> *find_section(Context<E> &ctx, std::string_view name) {
+  for (Chunk<E> *chunk : ctx.chunks)
+    if (chunk->kind == Chunk<E>::REGULAR && chunk->name == name)
+      return (OutputSection<E> *)chunk;
+  return nullptr;
+}
+
+// Debug info refers to other debug sections by offsets from the
+// beginning of output sections. SectionReader translates them to
+// pointers into relocated contents of input sections. Input sections
+// are rendered on demand and cached.
+template <typename E>
+class SectionReader {
+public:
+  SectionReader(Context<E> &ctx, OutputSection<E> *osec)
+    : ctx(ctx), osec(osec) {}
+
+  u8 *get(u64 offset) {
+    if (!osec || osec->shdr.sh_size <= offset)
+      Fatal(ctx) << "--gdb-index: invalid offset " << offset << " to "
+                 << (osec ? osec->name : "a missing section");
+
+    std::vector<InputSection<E> *> &members = osec->members;
+    auto it = std::partition_point(members.begin(), members.end(),
+                                   [&](InputSection<E> *isec) {
+      return isec->offset + isec->shdr.sh_size <= offset;
+    });
+
+    if (it == members.end() || offset < (*it)->offset)
+      Fatal(ctx) << "--gdb-index: invalid offset " << offset << " to "
+                 << osec->name;
+
+    InputSection<E> &isec = **it;
+    std::unique_ptr<u8[]> &buf = cache[&isec];
+    if (!buf) {
+      buf.reset(new u8[isec.shdr.sh_size]);
+      isec.write_to(ctx, buf.get());
+    }
+    return buf.get() + offset - isec.offset;
+  }
+
+private:
+  Context<E> &ctx;
+  OutputSection<E> *osec;
+  std::unordered_map<InputSection<E> *, std::unique_ptr<u8[]>> cache;
+};
+
+template <typename E>
+struct DebugSections {
+  DebugSections(Context<E> &ctx)
+    : abbrev(ctx, find_section(ctx, ".debug_abbrev")),
+      addr(ctx, find_section(ctx, ".debug_addr")),
+      ranges(ctx, find_section(ctx, ".debug_ranges")),
+      rnglists(ctx, find_section(ctx, ".debug_rnglists")) {}
+
+  SectionReader<E> abbrev;
+  SectionReader<E> addr;
+  SectionReader<E> ranges;
+  SectionReader<E> rnglists;
+};
+
+static u64 read_addr(u8 *&p, i64 addr_size) {
+  u64 val = (addr_size == 8) ? *(u64 *)p : *(u32 *)p;
+  p += addr_size;
+  return val;
+}
+
+// Reads an attribute value of a given form. For forms whose values
+// are not numbers (e.g. strings or blocks), this function just skips
+// them and returns 0.
+template <typename E>
+static u64 read_form(Context<E> &ctx, InputSection<E> &isec, u8 *&p,
+                     u64 form, i64 addr_size) {
+  auto read = [&](auto val) {
+    p += sizeof(val);
+    return val;
+  };
+
+  switch (form) {
+  case DW_FORM_flag_present:
+  case DW_FORM_implicit_const:
+    return 0;
+  case DW_FORM_data1:
+  case DW_FORM_flag:
+  case DW_FORM_ref1:
+  case DW_FORM_strx1:
+  case DW_FORM_addrx1:
+    return read(*p);
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+  case DW_FORM_strx2:
+  case DW_FORM_addrx2:
+    return read(*(u16 *)p);
+  case DW_FORM_strx3:
+  case DW_FORM_addrx3:
+    p += 3;
+    return p[-3] | (p[-2] << 8) | (p[-1] << 16);
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_strp:
+  case DW_FORM_line_strp:
+  case DW_FORM_sec_offset:
+  case DW_FORM_ref_addr:
+  case DW_FORM_ref_sup4:
+  case DW_FORM_strp_sup:
+  case DW_FORM_strx4:
+  case DW_FORM_addrx4:
+  case DW_FORM_GNU_ref_alt:
+  case DW_FORM_GNU_strp_alt:
+    return read(*(u32 *)p);
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_sig8:
+  case DW_FORM_ref_sup8:
+    return read(*(u64 *)p);
+  case DW_FORM_data16:
+    p += 16;
+    return 0;
+  case DW_FORM_addr:
+    return read_addr(p, addr_size);
+  case DW_FORM_sdata:
+  case DW_FORM_udata:
+  case DW_FORM_ref_udata:
+  case DW_FORM_strx:
+  case DW_FORM_addrx:
+  case DW_FORM_loclistx:
+  case DW_FORM_rnglistx:
+  case DW_FORM_GNU_addr_index:
+  case DW_FORM_GNU_str_index:
+    return read_uleb(p);
+  case DW_FORM_string:
+    p += strlen((char *)p) + 1;
+    return 0;
+  case DW_FORM_block1:
+    p += *p + 1;
+    return 0;
+  case DW_FORM_block2:
+    p += *(u16 *)p + 2;
+    return 0;
+  case DW_FORM_block4:
+    p += *(u32 *)p + 4;
+    return 0;
+  case DW_FORM_block:
+  case DW_FORM_exprloc: {
+    u64 len = read_uleb(p);
+    p += len;
+    return 0;
+  }
+  case DW_FORM_indirect:
+    return read_form(ctx, isec, p, read_uleb(p), addr_size);
+  }
+
+  Fatal(ctx) << isec << ": --gdb-index: unknown DWARF form: " << form;
+}
+
+static bool is_addrx_form(u64 form) {
+  switch (form) {
+  case DW_FORM_addrx:
+  case DW_FORM_addrx1:
+  case DW_FORM_addrx2:
+  case DW_FORM_addrx3:
+  case DW_FORM_addrx4:
+  case DW_FORM_GNU_addr_index:
+    return true;
+  }
+  return false;
+}
+
+// Returns a pointer to an abbreviation entry for a given code.
+template <typename E>
+static u8 *find_abbrev(Context<E> &ctx, InputSection<E> &isec,
+                       DebugSections<E> &sec, u64 abbrev_offset, u64 code) {
+  u8 *p = sec.abbrev.get(abbrev_offset);
+
+  for (;;) {
+    u64 c = read_uleb(p);
+    if (c == 0)
+      Fatal(ctx) << isec << ": --gdb-index: abbrev code not found: " << code;
+    if (c == code)
+      return p;
+
+    read_uleb(p); // tag
+    p++;          // has_children byte
+
+    for (;;) {
+      u64 name = read_uleb(p);
+      u64 form = read_uleb(p);
+      if (name == 0 && form == 0)
+        break;
+      if (form == DW_FORM_implicit_const)
+        read_uleb(p);
+    }
+  }
+}
+
+// Reads address ranges of a given compilation unit from the
+// attributes of its first DIE.
+template <typename E>
+static std::vector<std::pair<u64, u64>>
+read_address_ranges(Context<E> &ctx, InputSection<E> &isec,
+                    DebugSections<E> &sec, u8 *cu) {
+  u16 version = *(u16 *)(cu + 4);
+  u64 abbrev_offset;
+  i64 addr_size;
+  u8 *p;
+
+  if (version <= 4) {
+    abbrev_offset = *(u32 *)(cu + 6);
+    addr_size = cu[10];
+    p = cu + 11;
+  } else {
+    u8 unit_type = cu[6];
+    addr_size = cu[7];
+    abbrev_offset = *(u32 *)(cu + 8);
+    p = cu + 12;
+    if (unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile)
+      p += 8; // skip dwo_id
+  }
+
+  if (addr_size != 4 && addr_size != 8)
+    Fatal(ctx) << isec << ": --gdb-index: unsupported address size: "
+               << addr_size;
+
+  u64 code = read_uleb(p);
+  if (code == 0)
+    return {};
+
+  u8 *abbrev = find_abbrev(ctx, isec, sec, abbrev_offset, code);
+  read_uleb(abbrev); // tag
+  abbrev++;          // has_children byte
+
+  u64 low_pc = 0;
+  u64 high_pc = 0;
+  u64 ranges = 0;
+  u64 addr_base = 8;
+  u64 rnglists_base = 0;
+  u64 low_pc_form = 0;
+  u64 high_pc_form = 0;
+  u64 ranges_form = 0;
+
+  for (;;) {
+    u64 name = read_uleb(abbrev);
+    u64 form = read_uleb(abbrev);
+    if (name == 0 && form == 0)
+      break;
+
+    u64 val;
+    if (form == DW_FORM_implicit_const)
+      val = read_uleb(abbrev);
+    else
+      val = read_form(ctx, isec, p, form, addr_size);
+
+    switch (name) {
+    case DW_AT_low_pc:
+      low_pc = val;
+      low_pc_form = form;
+      break;
+    case DW_AT_high_pc:
+      high_pc = val;
+      high_pc_form = form;
+      break;
+    case DW_AT_ranges:
+      ranges = val;
+      ranges_form = form;
+      break;
+    case DW_AT_addr_base:
+      addr_base = val;
+      break;
+    case DW_AT_rnglists_base:
+      rnglists_base = val;
+      break;
+    }
+  }
+
+  auto get_addrx = [&](u64 idx) {
+    u8 *q = sec.addr.get(addr_base + idx * addr_size);
+    return read_addr(q, addr_size);
+  };
+
+  if (is_addrx_form(low_pc_form))
+    low_pc = get_addrx(low_pc);
+  if (is_addrx_form(high_pc_form))
+    high_pc = get_addrx(high_pc);
+
+  std::vector<std::pair<u64, u64>> vec;
+
+  auto add = [&](u64 lo, u64 hi) {
+    // Ranges of discarded sections are resolved to zero.
+    if (lo != 0 && lo < hi)
+      vec.push_back({lo, hi});
+  };
+
+  if (ranges_form == 0) {
+    if (low_pc_form && high_pc_form) {
+      if (high_pc_form == DW_FORM_addr || is_addrx_form(high_pc_form))
+        add(low_pc, high_pc);
+      else
+        add(low_pc, low_pc + high_pc);
+    }
+    return vec;
+  }
+
+  if (version <= 4) {
+    // .debug_ranges consists of pairs of beginning and ending
+    // addresses relative to the base address.
+    u64 max = (addr_size == 8) ? -1 : 0xffff'ffff;
+    u64 base = low_pc;
+    u8 *q = sec.ranges.get(ranges);
+
+    for (;;) {
+      u64 lo = read_addr(q, addr_size);
+      u64 hi = read_addr(q, addr_size);
+      if (lo == 0 && hi == 0)
+        break;
+      if (lo == max)
+        base = hi;
+      else
+        add(base + lo, base + hi);
+    }
+    return vec;
+  }
+
+  // DWARF 5 .debug_rnglists
+  if (ranges_form == DW_FORM_rnglistx)
+    ranges = rnglists_base + *(u32 *)sec.rnglists.get(rnglists_base + ranges * 4);
+
+  u64 base = low_pc;
+  u8 *q = sec.rnglists.get(ranges);
+
+  for (;;) {
+    switch (*q++) {
+    case DW_RLE_end_of_list:
+      return vec;
+    case DW_RLE_base_addressx:
+      base = get_addrx(read_uleb(q));
+      break;
+    case DW_RLE_startx_endx: {
+      u64 lo = get_addrx(read_uleb(q));
+      u64 hi = get_addrx(read_uleb(q));
+      add(lo, hi);
+      break;
+    }
+    case DW_RLE_startx_length: {
+      u64 lo = get_addrx(read_uleb(q));
+      u64 len = read_uleb(q);
+      add(lo, lo + len);
+      break;
+    }
+    case DW_RLE_offset_pair: {
+      u64 lo = read_uleb(q);
+      u64 hi = read_uleb(q);
+      add(base + lo, base + hi);
+      break;
+    }
+    case DW_RLE_base_address:
+      base = read_addr(q, addr_size);
+      break;
+    case DW_RLE_start_end: {
+      u64 lo = read_addr(q, addr_size);
+      u64 hi = read_addr(q, addr_size);
+      add(lo, hi);
+      break;
+    }
+    case DW_RLE_start_length: {
+      u64 lo = read_addr(q, addr_size);
+      u64 len = read_uleb(q);
+      add(lo, lo + len);
+      break;
+    }
+    default:
+      Fatal(ctx) << isec << ": --gdb-index: unknown range list entry: "
+                 << (u32)q[-1];
+    }
+  }
+}
+
+// Type units don't belong to the CU list.
+static bool is_compunit(u8 *cu) {
+  u16 version = *(u16 *)(cu + 4);
+  if (version <= 4)
+    return true;
+
+  u8 unit_type = cu[6];
+  return unit_type == DW_UT_compile || unit_type == DW_UT_partial ||
+         unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile;
+}
+
+// This is gdb's mapped_index_string_hash.
+static u32 gdb_hash(std::string_view name) {
+  u32 h = 0;
+  for (u8 c : name)
+    h = h * 67 + tolower(c) - 113;
+  return h;
+}
+
+template <typename E>
+void GdbIndexSection<E>::construct(Context<E> &ctx) {
+  OutputSection<E> *info = find_section(ctx, ".debug_info");
+
+  // Read compilation units and their address ranges.
+  std::vector<std::vector<Compunit>> cus(info->members.size());
+
+  tbb::parallel_for((i64)0, (i64)info->members.size(), [&](i64 i) {
+    InputSection<E> &isec = *info->members[i];
+    std::unique_ptr<u8[]> buf(new u8[isec.shdr.sh_size]);
+    isec.write_to(ctx, buf.get());
+
+    DebugSections<E> sec(ctx);
+    u8 *p = buf.get();
+    u8 *end = p + isec.shdr.sh_size;
+
+    while (p < end) {
+      u32 len = *(u32 *)p;
+      if (len == 0xffff'ffff)
+        Fatal(ctx) << isec << ": --gdb-index: 64-bit DWARF is not supported";
+
+      if (is_compunit(p)) {
+        Compunit cu;
+        cu.offset = isec.offset + (p - buf.get());
+        cu.size = len + 4;
+        cu.ranges = read_address_ranges(ctx, isec, sec, p);
+        cus[i].push_back(std::move(cu));
+      }
+      p += len + 4;
+    }
+  });
+
+  compunits = flatten(cus);
+  for (Compunit &cu : compunits)
+    num_areas += cu.ranges.size();
+
+  auto get_cu_idx = [&](InputSection<E> &isec, u64 offset) -> u32 {
+    auto it = std::partition_point(compunits.begin(), compunits.end(),
+                                   [&](const Compunit &cu) {
+      return cu.offset < offset;
+    });
+    if (it == compunits.end() || it->offset != offset)
+      Fatal(ctx) << isec << ": --gdb-index: invalid debug_info_offset: "
+                 << offset;
+    return it - compunits.begin();
+  };
+
+  // Read public names and types.
+  std::vector<InputSection<E> *> pubs;
+  for (std::string_view name : {".debug_gnu_pubnames", ".debug_gnu_pubtypes"})
+    if (OutputSection<E> *osec = find_section(ctx, name))
+      append(pubs, osec->members);
+
+  names.resize(pubs.size());
+
+  tbb::parallel_for((i64)0, (i64)pubs.size(), [&](i64 i) {
+    InputSection<E> &isec = *pubs[i];
+    std::unique_ptr<u8[]> buf(new u8[isec.shdr.sh_size]);
+    isec.write_to(ctx, buf.get());
+
+    // Name strings are not subject to relocation, so we refer to
+    // the original section contents so that they outlive `buf`.
+    u8 *begin = buf.get();
+    u8 *p = begin;
+    u8 *end = begin + isec.shdr.sh_size;
+
+    while (p < end) {
+      u8 *set_end = p + *(u32 *)p + 4;
+      u32 cu_idx = get_cu_idx(isec, *(u32 *)(p + 6));
+      p += 14;
+
+      while (p < set_end) {
+        u32 die_offset = *(u32 *)p;
+        if (die_offset == 0)
+          break;
+
+        u8 flags = p[4];
+        std::string_view name = isec.contents.data() + (p + 5 - begin);
+        names[i].push_back({name, ((u32)flags << 24) | cu_idx});
+        p += name.size() + 6;
+      }
+      p = set_end;
+    }
+
+    // A name may appear more than once in the same CU (e.g. for a
+    // declaration and a definition of the same variable).
+    std::vector<NameEntry> &vec = names[i];
+    sort(vec, [](const NameEntry &a, const NameEntry &b) {
+      return std::tie(a.name, a.attr) < std::tie(b.name, b.attr);
+    });
+    vec.erase(std::unique(vec.begin(), vec.end(),
+                          [](const NameEntry &a, const NameEntry &b) {
+      return a.name == b.name && a.attr == b.attr;
+    }), vec.end());
+  });
+
+  // Uniquify names.
+  i64 num_names = 0;
+  for (std::vector<NameEntry> &vec : names)
+    num_names += vec.size();
+
+  if (num_names) {
+    map.resize(num_names);
+
+    tbb::parallel_for_each(names, [&](std::vector<NameEntry> &vec) {
+      for (NameEntry &ent : vec) {
+        MapValue val;
+        val.gdb_hash = gdb_hash(ent.name);
+        ent.value = map.insert(ent.name, hash_string(ent.name), val).first;
+        assert(ent.value);
+        ent.value->num_attrs++;
+      }
+    });
+
+    for (i64 i = 0; i < map.nbuckets; i++)
+      if (map.has_key(i))
+        symbols.push_back({{map.keys[i], map.sizes[i]}, &map.values[i]});
+
+    // The bucket order depends on thread scheduling, so sort symbols
+    // to make the output deterministic.
+    tbb::parallel_sort(symbols.begin(), symbols.end());
+  }
+
+  // Assign offsets in the constant pool. CU vectors come first,
+  // followed by name strings.
+  i64 offset = 0;
+  for (auto [name, val] : symbols) {
+    val->attr_offset = offset;
+    offset += (val->num_attrs + 1) * 4;
+  }
+  for (auto [name, val] : symbols) {
+    val->name_offset = offset;
+    offset += name.size() + 1;
+  }
+
+  // gdb's hash table needs to have at least one empty slot.
+  symtab_size = next_power_of_two(symbols.size() * 4 / 3 + 1);
+  symtab_offset = HEADER_SIZE + compunits.size() * 16 + num_areas * 20;
+  pool_offset = symtab_offset + symtab_size * 8;
+  this->shdr.sh_size = pool_offset + offset;
+}
+
+template <typename E>
+void GdbIndexSection<E>::copy_buf(Context<E> &ctx) {
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void GdbIndexSection<E>::write_to(Context<E> &ctx, u8 *base) {
+  i64 cu_list_offset = HEADER_SIZE;
+  i64 areas_offset = cu_list_offset + compunits.size() * 16;
+
+  // Write a header
+  u32 *hdr = (u32 *)base;
+  hdr[0] = GDB_INDEX_VERSION;
+  hdr[1] = cu_list_offset;
+  hdr[2] = areas_offset; // type unit list is empty
+  hdr[3] = areas_offset;
+  hdr[4] = symtab_offset;
+  hdr[5] = pool_offset;
+
+  // Write a CU list and an address area
+  u64 *cu_list = (u64 *)(base + cu_list_offset);
+  u8 *area = base + areas_offset;
+
+  for (i64 i = 0; i < compunits.size(); i++) {
+    Compunit &cu = compunits[i];
+    *cu_list++ = cu.offset;
+    *cu_list++ = cu.size;
+
+    for (std::pair<u64, u64> range : cu.ranges) {
+      *(u64 *)area = range.first;
+      *(u64 *)(area + 8) = range.second;
+      *(u32 *)(area + 16) = i;
+      area += 20;
+    }
+  }
+
+  // Write a hash table. gdb uses open addressing with double hashing.
+  u32 *symtab = (u32 *)(base + symtab_offset);
+  memset(symtab, 0, symtab_size * 8);
+
+  for (auto [name, val] : symbols) {
+    u32 mask = symtab_size - 1;
+    u32 idx = val->gdb_hash & mask;
+    u32 step = ((val->gdb_hash * 17) & mask) | 1;
+
+    while (symtab[idx * 2] || symtab[idx * 2 + 1])
+      idx = (idx + step) & mask;
+
+    symtab[idx * 2] = val->name_offset;
+    symtab[idx * 2 + 1] = val->attr_offset;
+  }
+
+  // Write CU vectors and names to the constant pool
+  u8 *pool = base + pool_offset;
+
+  tbb::parallel_for_each(symbols, [&](std::pair<std::string_view, MapValue *> &sym) {
+    *(u32 *)(pool + sym.second->attr_offset) = sym.second->num_attrs;
+    write_string(pool + sym.second->name_offset, sym.first);
+  });
+
+  tbb::parallel_for_each(names, [&](std::vector<NameEntry> &vec) {
+    for (NameEntry &ent : vec) {
+      u32 *attrs = (u32 *)(pool + ent.value->attr_offset) + 1;
+      attrs[ent.value->num_written++] = ent.attr;
+    }
+  });
+
+  // Attributes were written in a nondeterministic order above.
+  tbb::parallel_for_each(symbols, [&](std::pair<std::string_view, MapValue *> &sym) {
+    u32 *attrs = (u32 *)(pool + sym.second->attr_offset) + 1;
+    std::sort(attrs, attrs + sym.second->num_attrs);
+  });
+}
+
+template <typename E>
+void create_gdb_index(Context<E> &ctx) {
+  Timer t(ctx, "create_gdb_index");
+
+  if (!find_section(ctx, ".debug_info"))
+    return;
+
+  ctx.gdb_index = std::make_unique<GdbIndexSection<E>>();
+  ctx.gdb_index->construct(ctx);
+
+  // Append the section to the end of the section header table
+  i64 shndx = 0;
+  for (Chunk<E> *chunk : ctx.chunks)
+    shndx = std::max<i64>(shndx, chunk->shndx);
+  ctx.gdb_index->shndx = shndx + 1;
+
+  auto it = std::find(ctx.chunks.begin(), ctx.chunks.end(), ctx.shdr.get());
+  ctx.chunks.insert(it, ctx.gdb_index.get());
+
+  ctx.shstrtab->update_shdr(ctx);
+  ctx.ehdr->update_shdr(ctx);
+  ctx.shdr->update_shdr(ctx);
+}
+
+#define INSTANTIATE(E)                                                  \
+  template void create_gdb_index(Context<E> &ctx);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -51,10 +51,19 @@
 // It scales better for number of available cores, require less overall
 // computation, and has a smaller working set. So, it's better with a single
 // thread and even better with multiple threads.
-
+//
+// Section digests are computed with XXH3-128 rather than a cryptographic
+// hash function. Adversarial collisions are not a concern for a linker,
+// and accidental collisions of a 128-bit hash are practically
+// impossible. As a safety net, we still compare contents and
+// relocations of each section with those of its leader before merging
+// them.
+
+#define XXH_STATIC_LINKING_ONLY
 #include "mold.h"
 
 #include <array>
+#include <numeric>
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/concurrent_vector.h>
 #include <tbb/enumerable_thread_specific.h>
@@ -62,13 +71,6 @@
 #include <tbb/parallel_for_each.h>
 #include <tbb/parallel_sort.h>
 
-#ifdef __APPLE__
-#  define COMMON_DIGEST_FOR_OPENSSL
-#  include <CommonCrypto/CommonDigest.h>
-#else
-#  include <openssl/sha.h>
-#endif
-
 static constexpr int64_t HASH_SIZE = 16;
 
 typedef std::array<uint8_t, HASH_SIZE> Digest;
@@ -103,8 +105,47 @@ static void uniquify_cies(Context<E> &ctx) {
   }
 }
 
+// For --icf=safe, we don't fold sections whose addresses may be
+// significant, since a program may compare function pointers. The
+// compiler lists symbols whose addresses are taken in .llvm_addrsig.
+// If an object file doesn't have that section, we have to assume that
+// all of its sections are address-significant. Exported symbols are
+// also address-significant because they can be referenced from other
+// modules.
+template <typename E>
+static void mark_addrsig(Context<E> &ctx) {
+  Timer t(ctx, "mark_addrsig");
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    if (const ElfShdr<E> *shdr = file->llvm_addrsig) {
+      std::string_view data = file->get_string(ctx, *shdr);
+      u8 *cur = (u8 *)data.data();
+      u8 *end = cur + data.size();
+
+      while (cur < end) {
+        i64 idx = read_uleb(cur);
+        if (idx >= file->symbols.size())
+          Fatal(ctx) << *file << ": .llvm_addrsig: invalid symbol index";
+
+        Symbol<E> &sym = *file->symbols[idx];
+        if (sym.file == file && sym.input_section)
+          sym.input_section->address_significant = true;
+      }
+    }
+
+    for (Symbol<E> *sym : file->symbols)
+      if (sym->file == file && sym->input_section &&
+          (!file->llvm_addrsig || sym->is_exported))
+        sym->input_section->address_significant = true;
+  });
+}
+
+// With --icf=all-data, read-only data sections such as constant tables
+// and vtables are folded too. A program may compare pointers to data,
+// so unlike code, data is folded only if its address is known to be
+// insignificant by .llvm_addrsig.
 template <typename E>
-static bool is_eligible(InputSection<E> &isec) {
+static bool is_eligible(Context<E> &ctx, InputSection<E> &isec) {
   const ElfShdr<E> &shdr = isec.shdr;
   std::string_view name = isec.name();
 
@@ -118,18 +159,19 @@ static bool is_eligible(InputSection<E> &isec) {
   bool is_init = (shdr.sh_type == SHT_INIT_ARRAY || name == ".init");
   bool is_fini = (shdr.sh_type == SHT_FINI_ARRAY || name == ".fini");
   bool is_enumerable = is_c_identifier(name);
+  bool is_data = ctx.arg.icf_data && !is_executable;
+  bool is_addr_taken = isec.address_significant &&
+                       (!ctx.arg.icf_all || is_data);
 
-  return is_alloc && is_executable && is_readonly && !is_bss &&
-         !is_empty && !is_init && !is_fini && !is_enumerable;
+  return is_alloc && (is_executable || is_data) && is_readonly &&
+         !is_bss && !is_empty && !is_init && !is_fini && !is_enumerable &&
+         !is_addr_taken;
 }
 
-static Digest digest_final(SHA256_CTX &sha) {
-  u8 buf[SHA256_SIZE];
-  int res = SHA256_Final(buf, &sha);
-  assert(res == 1);
-
+static Digest digest_final(XXH3_state_t &state) {
+  XXH128_hash_t hash = XXH3_128bits_digest(&state);
   Digest digest;
-  memcpy(digest.data(), buf, HASH_SIZE);
+  memcpy(digest.data(), &hash, HASH_SIZE);
   return digest;
 }
 
@@ -164,7 +206,8 @@ struct LeafHasher {
 template <typename E>
 struct LeafEq {
   bool operator()(const InputSection<E> *a, const InputSection<E> *b) const {
-    if (a->contents != b->contents)
+    if (a->contents != b->contents || a->shdr.sh_flags != b->shdr.sh_flags ||
+        a->shdr.sh_addralign != b->shdr.sh_addralign)
       return false;
 
     std::span<FdeRecord<E>> x = a->get_fdes();
@@ -192,11 +235,11 @@ static void merge_leaf_nodes(Context<E> &ctx) {
                                 LeafHasher<E>, LeafEq<E>> map;
 
   tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
-    for (std::unique_ptr<InputSection<E>> &isec : ctx.objs[i]->sections) {
+    for (InputSection<E> *isec : ctx.objs[i]->sections) {
       if (!isec || !isec->is_alive)
         continue;
 
-      if (!is_eligible(*isec)) {
+      if (!is_eligible(ctx, *isec)) {
         non_eligible++;
         continue;
       }
@@ -204,9 +247,9 @@ static void merge_leaf_nodes(Context<E> &ctx) {
       if (is_leaf(ctx, *isec)) {
         leaf++;
         isec->icf_leaf = true;
-        auto [it, inserted] = map.insert({isec.get(), isec.get()});
+        auto [it, inserted] = map.insert({isec, isec});
         if (!inserted && isec->get_priority() < it->second->get_priority())
-          it->second = isec.get();
+          it->second = isec;
       } else {
         eligible++;
         isec->icf_eligible = true;
@@ -215,9 +258,9 @@ static void merge_leaf_nodes(Context<E> &ctx) {
   });
 
   tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
-    for (std::unique_ptr<InputSection<E>> &isec : ctx.objs[i]->sections) {
+    for (InputSection<E> *isec : ctx.objs[i]->sections) {
       if (isec && isec->is_alive && isec->icf_leaf) {
-        auto it = map.find(isec.get());
+        auto it = map.find(isec);
         assert(it != map.end());
         isec->leader = it->second;
       }
@@ -227,18 +270,16 @@ static void merge_leaf_nodes(Context<E> &ctx) {
 
 template <typename E>
 static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
-  SHA256_CTX sha;
-  SHA256_Init(&sha);
-
-  u8 *buf = (u8 *)isec.contents.data();
+  XXH3_state_t state;
+  XXH3_128bits_reset(&state);
 
   auto hash = [&](auto val) {
-    SHA256_Update(&sha, &val, sizeof(val));
+    XXH3_128bits_update(&state, &val, sizeof(val));
   };
 
   auto hash_string = [&](std::string_view str) {
     hash(str.size());
-    SHA256_Update(&sha, str.data(), str.size());
+    XXH3_128bits_update(&state, str.data(), str.size());
   };
 
   auto hash_symbol = [&](Symbol<E> &sym) {
@@ -266,6 +307,7 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
 
   hash_string(isec.contents);
   hash(isec.shdr.sh_flags);
+  hash(isec.shdr.sh_addralign);
   hash(isec.get_fdes().size());
   hash(isec.get_rels(ctx).size());
 
@@ -304,7 +346,7 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
     }
   }
 
-  return digest_final(sha);
+  return digest_final(state);
 }
 
 template <typename E>
@@ -315,7 +357,7 @@ static std::vector<InputSection<E> *> gather_sections(Context<E> &ctx) {
   std::vector<i64> num_sections(ctx.objs.size());
 
   tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
-    for (std::unique_ptr<InputSection<E>> &isec : ctx.objs[i]->sections)
+    for (InputSection<E> *isec : ctx.objs[i]->sections)
       if (isec && isec->is_alive && isec->icf_eligible)
         num_sections[i]++;
   });
@@ -330,9 +372,9 @@ static std::vector<InputSection<E> *> gather_sections(Context<E> &ctx) {
   // Fill `sections` contents.
   tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
     i64 idx = section_indices[i];
-    for (std::unique_ptr<InputSection<E>> &isec : ctx.objs[i]->sections)
+    for (InputSection<E> *isec : ctx.objs[i]->sections)
       if (isec && isec->is_alive && isec->icf_eligible)
-        sections[idx++] = isec.get();
+        sections[idx++] = isec;
   });
 
   tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
@@ -354,6 +396,8 @@ compute_digests(Context<E> &ctx, std::span<InputSection<E> *> sections) {
   return digests;
 }
 
+// Edges between ICF-eligible sections are extracted from the section
+// graph and renumbered with `icf_idx`.
 template <typename E>
 static void gather_edges(Context<E> &ctx,
                          std::span<InputSection<E> *> sections,
@@ -361,25 +405,21 @@ static void gather_edges(Context<E> &ctx,
                          std::vector<u32> &edge_indices) {
   Timer t(ctx, "gather_edges");
 
+  SectionGraph<E> &graph = *ctx.section_graph;
   std::vector<i64> num_edges(sections.size());
   edge_indices.resize(sections.size());
 
+  // With --icf=safe, there may be no eligible sections at all.
+  if (sections.empty())
+    return;
+
   tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
     InputSection<E> &isec = *sections[i];
     assert(isec.icf_eligible);
-    i64 subsec_idx = 0;
 
-    for (i64 j = 0; j < isec.get_rels(ctx).size(); j++) {
-      if (isec.rel_subsections && isec.rel_subsections[subsec_idx].idx == j) {
-        subsec_idx++;
-      } else {
-        ElfRel<E> &rel = isec.get_rels(ctx)[j];
-        Symbol<E> &sym = *isec.file.symbols[rel.r_sym];
-        if (!sym.get_subsec() && sym.input_section &&
-            sym.input_section->icf_eligible)
-          num_edges[i]++;
-      }
-    }
+    for (u32 j : graph.get_edges(isec.graph_idx))
+      if (graph.sections[j]->icf_eligible)
+        num_edges[i]++;
   });
 
   for (i64 i = 0; i < num_edges.size() - 1; i++)
@@ -388,69 +428,250 @@ static void gather_edges(Context<E> &ctx,
   edges.resize(edge_indices.back() + num_edges.back());
 
   tbb::parallel_for((i64)0, (i64)num_edges.size(), [&](i64 i) {
-    InputSection<E> &isec = *sections[i];
-    i64 subsec_idx = 0;
     i64 idx = edge_indices[i];
+    for (u32 j : graph.get_edges(sections[i]->graph_idx))
+      if (graph.sections[j]->icf_eligible)
+        edges[idx++] = graph.sections[j]->icf_idx;
+  });
+}
 
-    for (i64 j = 0; j < isec.get_rels(ctx).size(); j++) {
-      if (isec.rel_subsections && isec.rel_subsections[subsec_idx].idx == j) {
-        subsec_idx++;
-        ElfRel<E> &rel = isec.get_rels(ctx)[j];
-        Symbol<E> &sym = *isec.file.symbols[rel.r_sym];
-        if (!sym.get_subsec() && sym.input_section &&
-            sym.input_section->icf_eligible)
-          edges[idx++] = sym.input_section->icf_idx;
-      }
-    }
+// Computes the reverse of the edge list, so that we can find sections
+// that refer to a given section.
+static void gather_reverse_edges(std::span<u32> edges,
+                                 std::span<u32> edge_indices,
+                                 std::vector<u32> &rev_edges,
+                                 std::vector<u32> &rev_edge_indices) {
+  i64 num_digests = edge_indices.size();
+  std::vector<i64> num_edges(num_digests);
+  for (u32 j : edges)
+    num_edges[j]++;
+
+  rev_edge_indices.resize(num_digests);
+  for (i64 i = 0; i < num_digests - 1; i++)
+    rev_edge_indices[i + 1] = rev_edge_indices[i] + num_edges[i];
+
+  rev_edges.resize(edges.size());
+  std::vector<i64> pos(rev_edge_indices.begin(), rev_edge_indices.end());
+
+  for (i64 i = 0; i < num_digests; i++) {
+    i64 begin = edge_indices[i];
+    i64 end = (i + 1 == num_digests) ? edges.size() : edge_indices[i + 1];
+    for (u32 j : edges.subspan(begin, end - begin))
+      rev_edges[pos[j]++] = i;
+  }
+}
+
+// A digest of a section in a propagation round is computed from the
+// section's initial digest and its successors' digests in the previous
+// round. Therefore, a digest can change only if one of its successors'
+// digests changed in the previous round. We keep track of such
+// sections so that we don't have to rehash all sections in each round.
+// In late rounds, only a small fraction of digests are still changing.
+//
+// Sections that are not in the worklist have the same digest in both
+// slots.
+namespace {
+struct Worklist {
+  std::vector<u32> sections;
+  std::unique_ptr<std::atomic_bool[]> queued;
+};
+}
+
+// Propagation rounds may not reach a fixed point if the graph contains
+// cycles, since digests of sections in a cycle keep changing. So we
+// also stop when the number of distinct digests (i.e. the number of
+// equivalence classes) stops changing.
+//
+// ClassCounter counts distinct digests. The first count visits all
+// sections. After that, we keep a reference count for each digest and
+// update it only for sections whose digests have changed since the
+// last count, so that a count in late rounds costs proportional to the
+// number of changing sections rather than all sections.
+namespace {
+class ClassCounter {
+public:
+  bool is_active() const {
+    return !last.empty();
+  }
+
+  void mark_changed(u32 i) {
+    if (!dirty[i].exchange(true))
+      changed.local().push_back(i);
+  }
+
+  i64 count(std::span<Digest> digests);
+
+private:
+  void recount(std::span<Digest> digests);
+
+  std::vector<Digest> last;
+  std::unique_ptr<std::atomic_bool[]> dirty;
+  tbb::enumerable_thread_specific<std::vector<u32>> changed;
+  tbb::concurrent_unordered_map<Digest, i64> refcounts;
+  i64 num_classes = 0;
+};
+}
+
+void ClassCounter::recount(std::span<Digest> digests) {
+  refcounts.clear();
+  tbb::parallel_for((i64)0, (i64)digests.size(), [&](i64 i) {
+    auto it = refcounts.insert({digests[i], 0}).first;
+    std::atomic_ref(it->second)++;
   });
+  num_classes = refcounts.size();
+}
+
+i64 ClassCounter::count(std::span<Digest> digests) {
+  if (last.empty()) {
+    last.assign(digests.begin(), digests.end());
+    dirty.reset(new std::atomic_bool[digests.size()]{});
+    recount(digests);
+    return num_classes;
+  }
+
+  std::vector<u32> vec;
+  for (std::vector<u32> &v : changed)
+    append(vec, v);
+  changed.clear();
+
+  // Digests that are no longer used stay in the table with a zero count.
+  // Start over if they make up the majority of the table.
+  if (refcounts.size() + vec.size() > digests.size() * 2) {
+    tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 k) {
+      last[vec[k]] = digests[vec[k]];
+      dirty[vec[k]] = false;
+    });
+    recount(digests);
+    return num_classes;
+  }
+
+  // Remove old digests first so that a count never goes below zero.
+  std::atomic<i64> delta = 0;
+
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 k) {
+    auto it = refcounts.find(last[vec[k]]);
+    assert(it != refcounts.end());
+    if (--std::atomic_ref(it->second) == 0)
+      delta--;
+  });
+
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 k) {
+    i64 i = vec[k];
+    auto it = refcounts.insert({digests[i], 0}).first;
+    if (std::atomic_ref(it->second)++ == 0)
+      delta++;
+    last[i] = digests[i];
+    dirty[i] = false;
+  });
+
+  num_classes += delta;
+  return num_classes;
 }
 
 template <typename E>
 static i64 propagate(std::span<std::vector<Digest>> digests,
                      std::span<u32> edges, std::span<u32> edge_indices,
-                     bool &slot, tbb::affinity_partitioner &ap) {
+                     std::span<u32> rev_edges, std::span<u32> rev_edge_indices,
+                     Worklist &worklist, ClassCounter &counter, bool &slot,
+                     tbb::affinity_partitioner &ap) {
   static Counter round("icf_round");
+  static Counter rehashed("icf_rehashed");
   round++;
+  rehashed += worklist.sections.size();
 
   i64 num_digests = digests[0].size();
-  tbb::enumerable_thread_specific<i64> changed;
+  tbb::enumerable_thread_specific<std::vector<u32>> changed;
 
-  tbb::parallel_for((i64)0, num_digests, [&](i64 i) {
-    if (digests[slot][i] == digests[!slot][i])
-      return;
+  tbb::parallel_for((i64)0, (i64)worklist.sections.size(), [&](i64 k) {
+    i64 i = worklist.sections[k];
 
-    SHA256_CTX sha;
-    SHA256_Init(&sha);
-    SHA256_Update(&sha, digests[2][i].data(), HASH_SIZE);
+    XXH3_state_t state;
+    XXH3_128bits_reset(&state);
+    XXH3_128bits_update(&state, digests[2][i].data(), HASH_SIZE);
 
     i64 begin = edge_indices[i];
     i64 end = (i + 1 == num_digests) ? edges.size() : edge_indices[i + 1];
 
     for (i64 j : edges.subspan(begin, end - begin))
-      SHA256_Update(&sha, digests[slot][j].data(), HASH_SIZE);
+      XXH3_128bits_update(&state, digests[slot][j].data(), HASH_SIZE);
 
-    digests[!slot][i] = digest_final(sha);
+    digests[!slot][i] = digest_final(state);
 
-    if (digests[slot][i] != digests[!slot][i])
-      changed.local()++;
+    if (digests[slot][i] != digests[!slot][i]) {
+      changed.local().push_back(i);
+      if (counter.is_active())
+        counter.mark_changed(i);
+    }
   }, ap);
 
   slot = !slot;
-  return changed.combine(std::plus());
+
+  // Compute the next worklist. A changed section needs to be revisited
+  // too because its digest differs between the two slots.
+  tbb::enumerable_thread_specific<std::vector<u32>> next;
+
+  auto add = [&](u32 i) {
+    if (!worklist.queued[i].exchange(true))
+      next.local().push_back(i);
+  };
+
+  i64 num_changed = 0;
+  for (std::vector<u32> &vec : changed)
+    num_changed += vec.size();
+
+  tbb::parallel_for_each(changed.begin(), changed.end(),
+                         [&](std::vector<u32> &vec) {
+    tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 k) {
+      i64 i = vec[k];
+      add(i);
+
+      i64 begin = rev_edge_indices[i];
+      i64 end = (i + 1 == num_digests) ? rev_edges.size()
+                                       : rev_edge_indices[i + 1];
+      for (u32 j : rev_edges.subspan(begin, end - begin))
+        add(j);
+    });
+  });
+
+  worklist.sections.clear();
+  for (std::vector<u32> &vec : next)
+    append(worklist.sections, vec);
+
+  tbb::parallel_for((i64)0, (i64)worklist.sections.size(), [&](i64 k) {
+    worklist.queued[worklist.sections[k]] = false;
+  });
+  return num_changed;
 }
 
+// Returns true if two sections have the same contents, flags, FDEs
+// and relocations except their targets. Sections with the same digest
+// always satisfy this unless their digests accidentally collide.
 template <typename E>
-static i64 count_num_classes(std::span<Digest> digests,
-                             tbb::affinity_partitioner &ap) {
-  std::vector<Digest> vec(digests.begin(), digests.end());
-  tbb::parallel_sort(vec);
-
-  tbb::enumerable_thread_specific<i64> num_classes;
-  tbb::parallel_for((i64)0, (i64)vec.size() - 1, [&](i64 i) {
-    if (vec[i] != vec[i + 1])
-      num_classes.local()++;
-  }, ap);
-  return num_classes.combine(std::plus());
+static bool has_same_contents(Context<E> &ctx, InputSection<E> &a,
+                              InputSection<E> &b) {
+  if (a.contents != b.contents || a.shdr.sh_flags != b.shdr.sh_flags)
+    return false;
+
+  std::span<FdeRecord<E>> x = a.get_fdes();
+  std::span<FdeRecord<E>> y = b.get_fdes();
+  if (x.size() != y.size())
+    return false;
+
+  for (i64 i = 0; i < x.size(); i++)
+    if (x[i].cie->icf_idx != y[i].cie->icf_idx ||
+        x[i].get_contents().substr(8) != y[i].get_contents().substr(8))
+      return false;
+
+  std::span<ElfRel<E>> r1 = a.get_rels(ctx);
+  std::span<ElfRel<E>> r2 = b.get_rels(ctx);
+  if (r1.size() != r2.size())
+    return false;
+
+  for (i64 i = 0; i < r1.size(); i++)
+    if (r1[i].r_offset != r2[i].r_offset || r1[i].r_type != r2[i].r_type ||
+        a.get_addend(r1[i]) != b.get_addend(r2[i]))
+      return false;
+  return true;
 }
 
 template <typename E>
@@ -459,12 +680,12 @@ static void print_icf_sections(Context<E> &ctx) {
   tbb::concurrent_unordered_multimap<InputSection<E> *, InputSection<E> *> map;
 
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-    for (std::unique_ptr<InputSection<E>> &isec : file->sections) {
+    for (InputSection<E> *isec : file->sections) {
       if (isec && isec->is_alive && isec->leader) {
-        if (isec.get() == isec->leader)
-          leaders.push_back(isec.get());
+        if (isec == isec->leader)
+          leaders.push_back(isec);
         else
-          map.insert({isec->leader, isec.get()});
+          map.insert({isec->leader, isec});
       }
     }
   });
@@ -476,28 +697,35 @@ static void print_icf_sections(Context<E> &ctx) {
 
   i64 saved_bytes = 0;
 
+  // Write the report with a single SyncOut so that we take the output
+  // lock only once.
+  SyncOut out(ctx);
+
   for (InputSection<E> *leader : leaders) {
     auto [begin, end] = map.equal_range(leader);
     if (begin == end)
       continue;
 
-    SyncOut(ctx) << "selected section " << *leader;
+    out << "selected section " << *leader << "\n";
 
     i64 n = 0;
     for (auto it = begin; it != end; it++) {
-      SyncOut(ctx) << "  removing identical section " << *it->second;
+      out << "  removing identical section " << *it->second << "\n";
       n++;
     }
     saved_bytes += leader->contents.size() * n;
   }
 
-  SyncOut(ctx) << "ICF saved " << saved_bytes << " bytes";
+  out << "ICF saved " << saved_bytes << " bytes";
 }
 
 template <typename E>
 void icf_sections(Context<E> &ctx) {
   Timer t(ctx, "icf");
 
+  if (!ctx.arg.icf_all || ctx.arg.icf_data)
+    mark_addrsig(ctx);
+
   uniquify_cies(ctx);
   merge_leaf_nodes(ctx);
 
@@ -513,55 +741,103 @@ void icf_sections(Context<E> &ctx) {
   std::vector<u32> edge_indices;
   gather_edges<E>(ctx, sections, edges, edge_indices);
 
+  std::vector<u32> rev_edges;
+  std::vector<u32> rev_edge_indices;
+  gather_reverse_edges(edges, edge_indices, rev_edges, rev_edge_indices);
+
+  static Counter digest_bytes("mem_icf_digests");
+  digest_bytes += digests[0].size() * sizeof(Digest) * digests.size();
+
+  static Counter edge_bytes("mem_icf_edges");
+  edge_bytes += (edges.size() + edge_indices.size() + rev_edges.size() +
+                 rev_edge_indices.size()) * sizeof(u32);
+
+  // All sections are rehashed in the first round.
+  Worklist worklist;
+  worklist.sections.resize(sections.size());
+  std::iota(worklist.sections.begin(), worklist.sections.end(), 0);
+  worklist.queued.reset(new std::atomic_bool[sections.size()]{});
+
   bool slot = 0;
 
   // Execute the propagation rounds until convergence is obtained.
   {
     Timer t(ctx, "propagate");
     tbb::affinity_partitioner ap;
+    ClassCounter counter;
+    i64 num_rounds = 0;
+
+    // Runs a round and reports the number of changed digests to
+    // --progress-fd.
+    auto run_round = [&] {
+      i64 n = propagate<E>(digests, edges, edge_indices, rev_edges,
+                           rev_edge_indices, worklist, counter, slot, ap);
+      if (Progress::fd != -1)
+        Progress::write("icf " + std::to_string(++num_rounds) + " " +
+                        std::to_string(n));
+      return n;
+    };
 
     i64 num_changed = -1;
-    for (;;) {
-      i64 n = propagate<E>(digests, edges, edge_indices, slot, ap);
+    while (!worklist.sections.empty()) {
+      i64 n = run_round();
       if (n == num_changed)
         break;
       num_changed = n;
     }
 
     i64 num_classes = -1;
-    for (;;) {
-      for (i64 i = 0; i < 10; i++)
-        propagate<E>(digests, edges, edge_indices, slot, ap);
+    while (!worklist.sections.empty()) {
+      for (i64 i = 0; i < 10 && !worklist.sections.empty(); i++)
+        run_round();
 
-      i64 n = count_num_classes<E>(digests[slot], ap);
+      i64 n = counter.count(digests[slot]);
       if (n == num_classes)
         break;
       num_classes = n;
     }
   }
 
-  // Group sections by SHA digest.
+  // Group sections by digest. We sort (digest, priority, index)
+  // tuples so that sections with the same digest are adjacent and the
+  // one with the smallest priority value comes first in each group.
+  // That section becomes the leader of the group.
   {
     Timer t(ctx, "group");
 
-    auto *map = new tbb::concurrent_unordered_map<Digest, InputSection<E> *>;
+    struct Entry {
+      Digest digest;
+      i64 priority;
+      u32 idx;
+    };
+
     std::span<Digest> digest = digests[slot];
+    std::vector<Entry> entries(sections.size());
 
     tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-      InputSection<E> *isec = sections[i];
-      auto [it, inserted] = map->insert({digest[i], isec});
-      if (!inserted && isec->get_priority() < it->second->get_priority())
-        it->second = isec;
+      entries[i] = {digest[i], sections[i]->get_priority(), (u32)i};
     });
 
-    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-      auto it = map->find(digest[i]);
-      assert(it != map->end());
-      sections[i]->leader = it->second;
+    tbb::parallel_sort(entries.begin(), entries.end(),
+                       [](const Entry &a, const Entry &b) {
+      if (int cmp = memcmp(&a.digest, &b.digest, HASH_SIZE))
+        return cmp < 0;
+      return std::tuple(a.priority, a.idx) < std::tuple(b.priority, b.idx);
     });
 
-    // Since free'ing the map is slow, postpone it.
-    ctx.on_exit.push_back([=]() { delete map; });
+    tbb::parallel_for((i64)0, (i64)entries.size(), [&](i64 i) {
+      if (i > 0 && entries[i - 1].digest == entries[i].digest)
+        return;
+
+      InputSection<E> *leader = sections[entries[i].idx];
+      for (i64 j = i; j < entries.size(); j++) {
+        if (entries[j].digest != entries[i].digest)
+          break;
+        InputSection<E> *isec = sections[entries[j].idx];
+        if (has_same_contents(ctx, *isec, *leader))
+          isec->leader = leader;
+      }
+    });
   }
 
   if (ctx.arg.print_icf_sections)
@@ -1,6 +1,15 @@
 #include "mold.h"
 
+#include <fcntl.h>
 #include <limits>
+#include <tbb/parallel_for.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 namespace mold::elf {
 
@@ -55,19 +64,190 @@ InputSection<E>::InputSection(Context<E> &ctx, ObjectFile<E> &file,
     OutputSection<E>::get_instance(ctx, name, shdr.sh_type, shdr.sh_flags);
 }
 
+// With --copy-file-range, large non-alloc sections that need no
+// relocation are copied by the kernel from an input file to the
+// output file. Filesystems that support reflinks (e.g. XFS or btrfs)
+// can then share disk blocks between the two files instead of copying
+// bytes. compute_section_sizes() places such sections so that they
+// are block-aligned in the same way in both files.
+template <typename E>
+bool InputSection<E>::is_kernel_copyable(Context<E> &ctx) const {
+  MappedFile<Context<E>> *mf = file.mf;
+  return ctx.arg.copy_file_range && !(shdr.sh_flags & SHF_ALLOC) &&
+         shdr.sh_type != SHT_NOBITS && relsec_idx == -1 && !compress_type &&
+         contents.size() >= 64 * 1024 &&
+         (u8 *)contents.data() >= mf->data &&
+         (u8 *)contents.data() + contents.size() <= mf->data + mf->size;
+}
+
+// Returns the offset of this section's contents in its input file.
+// For an archive member, it is the offset in the archive file.
+template <typename E>
+i64 InputSection<E>::get_file_offset() const {
+  MappedFile<Context<E>> *mf = file.mf;
+  while (mf->parent)
+    mf = mf->parent;
+  return (u8 *)contents.data() - mf->data;
+}
+
+template <typename E>
+static bool copy_by_kernel(Context<E> &ctx, InputSection<E> &isec, u8 *buf) {
+#ifdef __linux__
+  // The destination may be a temporary buffer rather than the output
+  // file (e.g. when debug sections are compressed).
+  OutputFile<E> *out = ctx.output_file.get();
+  if (!out || out->fd == -1 || buf < ctx.buf ||
+      ctx.buf + out->filesize <= buf || !isec.is_kernel_copyable(ctx))
+    return false;
+
+  MappedFile<Context<E>> *mf = isec.file.mf;
+  while (mf->parent)
+    mf = mf->parent;
+
+  std::string path = mf->name;
+  if (path.starts_with('/') && !ctx.arg.chroot.empty())
+    path = ctx.arg.chroot + "/" + path_clean(path);
+
+  i64 fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  loff_t in_off = isec.get_file_offset();
+  loff_t out_off = buf - ctx.buf;
+  i64 size = isec.contents.size();
+
+  while (size > 0) {
+    ssize_t n = copy_file_range(fd, &in_off, out->fd, &out_off, size, 0);
+    if (n <= 0)
+      break;
+    size -= n;
+  }
+  ::close(fd);
+
+  // Copy the remaining bytes if the kernel gave up halfway.
+  i64 done = isec.contents.size() - size;
+  memcpy(buf + done, isec.contents.data() + done, size);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Inflates a compressed section to a given buffer, which must be
+// shdr.sh_size bytes long. write_to() calls this to decompress input
+// debug sections directly into the output file.
+template <typename E>
+void InputSection<E>::uncompress_to(Context<E> &ctx, u8 *buf) {
+  switch (compress_type) {
+  case ELFCOMPRESS_ZLIB: {
+    unsigned long size = shdr.sh_size;
+    if (uncompress(buf, &size, (u8 *)contents.data(), contents.size()) != Z_OK)
+      Fatal(ctx) << *this << ": uncompress failed";
+    if (size != shdr.sh_size)
+      Fatal(ctx) << *this << ": uncompress: invalid size";
+    return;
+  }
+  case ELFCOMPRESS_ZSTD: {
+    size_t size = ZSTD_decompress(buf, shdr.sh_size, contents.data(),
+                                  contents.size());
+    if (ZSTD_isError(size))
+      Fatal(ctx) << *this << ": ZSTD_decompress failed";
+    if (size != shdr.sh_size)
+      Fatal(ctx) << *this << ": ZSTD_decompress: invalid size";
+    return;
+  }
+  default:
+    unreachable();
+  }
+}
+
+// Copies data using non-temporal stores if available. They write to
+// memory without bringing destination cache lines into the CPU cache,
+// which is what we want for the output file, as we never read it back.
+static void copy_nontemporal(u8 *dst, const u8 *src, i64 size) {
+#ifdef __SSE2__
+  i64 head = std::min<i64>(size, -(uintptr_t)dst & 15);
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  for (; size >= 64; dst += 64, src += 64, size -= 64) {
+    __m128i a = _mm_loadu_si128((__m128i *)src);
+    __m128i b = _mm_loadu_si128((__m128i *)(src + 16));
+    __m128i c = _mm_loadu_si128((__m128i *)(src + 32));
+    __m128i d = _mm_loadu_si128((__m128i *)(src + 48));
+    _mm_stream_si128((__m128i *)dst, a);
+    _mm_stream_si128((__m128i *)(dst + 16), b);
+    _mm_stream_si128((__m128i *)(dst + 32), c);
+    _mm_stream_si128((__m128i *)(dst + 48), d);
+  }
+  _mm_sfence();
+#endif
+  memcpy(dst, src, size);
+}
+
+// Copies a section with relocations applied in a staging buffer and
+// writes the result to the output with non-temporal stores. Otherwise,
+// we would write each destination page twice, once by memcpy and
+// once by relocation processing. The staging buffer is reused by the
+// same thread, so it is likely to be in cache. Returns false if the
+// section is not suitable. .ctors and .dtors are excluded because
+// write_to() has to reverse them in place.
+template <typename E>
+static bool copy_and_relocate(Context<E> &ctx, InputSection<E> &isec,
+                              u8 *buf) {
+  constexpr i64 min_size = 64 * 1024;
+  constexpr i64 max_size = 4 * 1024 * 1024;
+
+  i64 size = isec.contents.size();
+  if (size < min_size || max_size < size || isec.compress_type ||
+      !(isec.shdr.sh_flags & SHF_ALLOC) || isec.get_rels(ctx).empty() ||
+      isec.name().starts_with(".ctors") || isec.name().starts_with(".dtors"))
+    return false;
+
+  thread_local std::vector<u8> staging;
+  if (staging.size() < size)
+    staging.resize(max_size);
+
+  memcpy(staging.data(), isec.contents.data(), size);
+  isec.apply_reloc_alloc(ctx, staging.data());
+  copy_nontemporal(buf, staging.data(), size);
+  return true;
+}
+
 template <typename E>
 void InputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   if (shdr.sh_type == SHT_NOBITS || shdr.sh_size == 0)
     return;
 
+  if (copy_and_relocate(ctx, *this, buf))
+    return;
+
   // Copy data
-  memcpy(buf, contents.data(), contents.size());
+  if (compress_type)
+    uncompress_to(ctx, buf);
+  else if (!copy_by_kernel(ctx, *this, buf))
+    memcpy(buf, contents.data(), contents.size());
 
   // Apply relocations
-  if (shdr.sh_flags & SHF_ALLOC)
+  if (shdr.sh_flags & SHF_ALLOC) {
     apply_reloc_alloc(ctx, buf);
-  else
-    apply_reloc_nonalloc(ctx, buf);
+  } else {
+    // A debug info section of a large translation unit may have
+    // millions of relocations. We split them into ranges and apply
+    // them in parallel so that such section doesn't become a straggler.
+    constexpr i64 chunk_size = 1 << 16;
+    i64 size = get_rels(ctx).size();
+
+    if (size <= chunk_size) {
+      apply_reloc_nonalloc(ctx, buf, 0, size);
+    } else {
+      tbb::parallel_for((i64)0, size, chunk_size, [&](i64 i) {
+        apply_reloc_nonalloc(ctx, buf, i, std::min(i + chunk_size, size));
+      });
+    }
+  }
 
   // As a special case, .ctors and .dtors section contents are
   // reversed. These sections are now obsolete and mapped to
@@ -83,29 +263,8 @@ void InputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
 }
 
 template <typename E>
-static i64 get_output_type(Context<E> &ctx) {
-  if (ctx.arg.shared)
-    return 0;
-  if (ctx.arg.pie)
-    return 1;
-  return 2;
-}
-
-template <typename E>
-static i64 get_sym_type(Context<E> &ctx, Symbol<E> &sym) {
-  if (sym.is_absolute(ctx))
-    return 0;
-  if (!sym.is_imported)
-    return 1;
-  if (sym.get_type() != STT_FUNC)
-    return 2;
-  return 3;
-}
-
-template <typename E>
-void InputSection<E>::dispatch(Context<E> &ctx, Action table[3][4], i64 i,
-                               const ElfRel<E> &rel, Symbol<E> &sym) {
-  Action action = table[get_output_type(ctx)][get_sym_type(ctx, sym)];
+void InputSection<E>::apply_action(Context<E> &ctx, Action action, i64 i,
+                                   const ElfRel<E> &rel, Symbol<E> &sym) {
   bool is_code = (shdr.sh_flags & SHF_EXECINSTR);
   bool is_writable = (shdr.sh_flags & SHF_WRITE);
 
@@ -114,9 +273,13 @@ void InputSection<E>::dispatch(Context<E> &ctx, Action table[3][4], i64 i,
                << sym << "' can not be used; recompile with -fPIC";
   };
 
+  auto record = [&](Action action) {
+    if (!rel_actions)
+      rel_actions.reset(new u8[get_rels(ctx).size()]());
+    rel_actions[i] = action;
+  };
+
   switch (action) {
-  case NONE:
-    return;
   case ERROR:
     error();
     return;
@@ -145,8 +308,8 @@ void InputSection<E>::dispatch(Context<E> &ctx, Action table[3][4], i64 i,
       ctx.has_textrel = true;
     }
     sym.flags |= NEEDS_DYNSYM;
-    needs_dynrel[i] = true;
-    file.num_dynrel++;
+    record(DYNREL);
+    num_dynrel++;
     return;
   case BASEREL:
     if (!is_writable) {
@@ -156,8 +319,9 @@ void InputSection<E>::dispatch(Context<E> &ctx, Action table[3][4], i64 i,
       }
       ctx.has_textrel = true;
     }
-    needs_baserel[i] = true;
-    file.num_dynrel++;
+    record(BASEREL);
+    if (!is_relr_reloc(ctx, rel))
+      num_baserel++;
     return;
   default:
     unreachable();
@@ -166,12 +330,17 @@ void InputSection<E>::dispatch(Context<E> &ctx, Action table[3][4], i64 i,
 
 template <typename E>
 void InputSection<E>::report_undef(Context<E> &ctx, Symbol<E> &sym) {
+  // This is called from parallel loops, so messages are buffered and
+  // written in sorted order by the next ctx.checkpoint().
   switch (ctx.arg.unresolved_symbols) {
   case UnresolvedKind::ERROR:
-    Error(ctx) << "undefined symbol: " << file << ": " << sym;
+    ctx.has_error = true;
+    ctx.undef_out.line() << "mold: undefined symbol: " << file << ": " << sym;
     break;
   case UnresolvedKind::WARN:
-    Warn(ctx) << "undefined symbol: " << file << ": " << sym;
+    if (ctx.arg.fatal_warnings)
+      ctx.has_error = true;
+    ctx.undef_out.line() << "mold: undefined symbol: " << file << ": " << sym;
     break;
   case UnresolvedKind::IGNORE:
     break;
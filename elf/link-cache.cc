@@ -0,0 +1,260 @@
+// This file implements --link-cache, an optional content-addressed
+// cache of output files.
+//
+// When the same program is linked from byte-identical inputs over and
+// over again (which is common in CI), the output is always the same.
+// With --link-cache=DIR, we compute a SHA256 digest of the fully
+// expanded command line and the contents of all input files, and use it
+// as a file name in DIR. If the file exists, we copy it to the output
+// path without linking. Otherwise, we link as usual and store the
+// output to DIR for later invocations.
+//
+// DIR can be shared by multiple machines (e.g. via NFS), as cache
+// entries are written to temporary files first and then renamed.
+//
+// Only the output file is cached. Other side outputs such as map files
+// or messages printed by --trace are not reproduced on a cache hit.
+//
+// --skip-unchanged-output uses the same digest without a cache
+// directory. We embed the digest to the output as .mold.input-digest.
+// If an existing output file has the same digest as the one we are
+// about to create, it is up to date, so we exit without writing it.
+// Its mtime is left unchanged, so that build systems which compare
+// mtimes (e.g. ninja with restat) don't rebuild what depends on it.
+
+#include "mold.h"
+#include "../subprocess.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tbb/parallel_for.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#  define COMMON_DIGEST_FOR_OPENSSL
+#  include <CommonCrypto/CommonDigest.h>
+#else
+#  include <openssl/sha.h>
+#endif
+
+#ifdef __linux__
+#  include <linux/fs.h>
+#  include <sys/ioctl.h>
+#endif
+
+namespace mold::elf {
+
+template <typename E>
+static std::string compute_input_digest(Context<E> &ctx) {
+  Timer t(ctx, "compute_input_digest");
+
+  // Archive members and other slices share contents with their parent
+  // files, so we hash only files directly opened by us.
+  std::vector<MappedFile<Context<E>> *> files;
+  for (std::unique_ptr<MappedFile<Context<E>>> &mf : ctx.mf_pool)
+    if (!mf->parent)
+      files.push_back(mf.get());
+
+  // Input files can be large, so hash them in parallel.
+  std::vector<std::array<u8, SHA256_SIZE>> digests(files.size());
+
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    SHA256(files[i]->data, files[i]->size, digests[i].data());
+  });
+
+  SHA256_CTX sha;
+  SHA256_Init(&sha);
+
+  auto update = [&](std::string_view str) {
+    SHA256_Update(&sha, str.data(), str.size());
+    char buf[] = {0};
+    SHA256_Update(&sha, buf, 1);
+  };
+
+  update(mold_version);
+  for (std::string_view arg : remove_plugin_args(ctx.cmdline_args))
+    update(arg);
+
+  for (i64 i = 0; i < files.size(); i++) {
+    update(files[i]->name);
+    SHA256_Update(&sha, digests[i].data(), SHA256_SIZE);
+  }
+
+  u8 digest[SHA256_SIZE];
+  SHA256_Final(digest, &sha);
+
+  static const char chars[] = "0123456789abcdef";
+  std::string str;
+  for (u8 c : digest) {
+    str += chars[c >> 4];
+    str += chars[c & 0xf];
+  }
+  return str;
+}
+
+// Creates `dest` as a copy of `src` atomically. Returns false on error.
+static bool copy_file(const std::string &src, const std::string &dest,
+                      i64 perm) {
+  i64 in = ::open(src.c_str(), O_RDONLY);
+  if (in == -1)
+    return false;
+
+  std::string tmp = std::string(path_dirname(dest)) + "/.mold-XXXXXX";
+  i64 out = mkstemp(tmp.data());
+  if (out == -1) {
+    ::close(in);
+    return false;
+  }
+
+  auto copy = [&] {
+#ifdef __linux__
+    // Try reflink first. It shares data blocks between the two files
+    // on file systems that support it, so it's almost free.
+    if (ioctl(out, FICLONE, in) == 0)
+      return true;
+#endif
+
+    std::vector<u8> buf(1024 * 1024);
+    for (;;) {
+      i64 n = read(in, buf.data(), buf.size());
+      if (n == 0)
+        return true;
+      if (n == -1 || write(out, buf.data(), n) != n)
+        return false;
+    }
+  };
+
+  bool ok = copy() && fchmod(out, perm) == 0;
+  ::close(in);
+  ::close(out);
+
+  if (ok && rename(tmp.c_str(), dest.c_str()) == 0)
+    return true;
+  unlink(tmp.c_str());
+  return false;
+}
+
+template <typename E>
+static std::string get_output_path(Context<E> &ctx) {
+  std::string path = ctx.arg.output;
+  if (path.starts_with('/') && !ctx.arg.chroot.empty())
+    path = ctx.arg.chroot + "/" + path_clean(path);
+  return path;
+}
+
+// Returns true if the output file was created from a cache entry.
+template <typename E>
+bool try_link_cache(Context<E> &ctx) {
+  Timer t(ctx, "try_link_cache");
+
+  // We can cache only regular output files.
+  std::string output = get_output_path(ctx);
+  if (output == "-")
+    return false;
+
+  struct stat st;
+  if (stat(output.c_str(), &st) == 0 && (st.st_mode & S_IFMT) != S_IFREG)
+    return false;
+
+  if (ctx.input_digest.empty())
+    ctx.input_digest = compute_input_digest(ctx);
+
+  u32 orig_umask = umask(0);
+  umask(orig_umask);
+
+  std::string path = ctx.arg.link_cache + "/" + ctx.input_digest;
+  return copy_file(path, output, 0777 & ~orig_umask);
+}
+
+template <typename E>
+void save_to_link_cache(Context<E> &ctx) {
+  Timer t(ctx, "save_to_link_cache");
+
+  mkdir(ctx.arg.link_cache.c_str(), 0777);
+
+  std::string path = ctx.arg.link_cache + "/" + ctx.input_digest;
+  if (!copy_file(get_output_path(ctx), path, 0777))
+    Warn(ctx) << "--link-cache: cannot write " << path << ": "
+              << errno_string();
+}
+
+// Returns the contents of .mold.input-digest of a given ELF file, or an
+// empty string if it doesn't exist.
+template <typename E>
+static std::string_view read_input_digest(std::string_view file) {
+  if (file.size() < sizeof(ElfEhdr<E>) || !file.starts_with("\177ELF"))
+    return "";
+
+  ElfEhdr<E> &ehdr = *(ElfEhdr<E> *)file.data();
+  if (ehdr.e_machine != E::e_machine || ehdr.e_shstrndx >= ehdr.e_shnum ||
+      file.size() < ehdr.e_shoff + ehdr.e_shnum * sizeof(ElfShdr<E>))
+    return "";
+
+  std::span<ElfShdr<E>> shdrs{(ElfShdr<E> *)(file.data() + ehdr.e_shoff),
+                              ehdr.e_shnum};
+
+  auto get_contents = [&](ElfShdr<E> &shdr) -> std::string_view {
+    if (file.size() < shdr.sh_offset + shdr.sh_size)
+      return "";
+    return file.substr(shdr.sh_offset, shdr.sh_size);
+  };
+
+  std::string_view shstrtab = get_contents(shdrs[ehdr.e_shstrndx]);
+
+  for (ElfShdr<E> &shdr : shdrs) {
+    if (shdr.sh_name >= shstrtab.size())
+      continue;
+    std::string_view name = shstrtab.data() + shdr.sh_name;
+    if (name == ".mold.input-digest")
+      return get_contents(shdr);
+  }
+  return "";
+}
+
+// Returns true if the existing output file was created from the same
+// command line and input files.
+template <typename E>
+bool is_output_unchanged(Context<E> &ctx) {
+  Timer t(ctx, "is_output_unchanged");
+
+  // We need a digest to embed to the output even if we can't reuse it.
+  if (ctx.input_digest.empty())
+    ctx.input_digest = compute_input_digest(ctx);
+
+  std::string path = get_output_path(ctx);
+  if (path == "-")
+    return false;
+
+  i64 fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (st.st_mode & S_IFMT) != S_IFREG ||
+      st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  u8 *data = (u8 *)mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  std::string_view file((char *)data, st.st_size);
+  bool ret = (read_input_digest<E>(file) == ctx.input_digest);
+  munmap(data, st.st_size);
+  return ret;
+}
+
+#define INSTANTIATE(E)                                  \
+  template bool try_link_cache(Context<E> &ctx);        \
+  template void save_to_link_cache(Context<E> &ctx);    \
+  template bool is_output_unchanged(Context<E> &ctx);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
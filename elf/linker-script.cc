@@ -175,21 +175,107 @@ static MappedFile<Context<E>> *resolve_path(Context<E> &ctx, std::string_view to
   SyntaxError(ctx, tok) << "library not found: " << str;
 }
 
+static i64 get_output_type(std::span<const std::string_view> tok) {
+  if (tok.size() >= 3 && tok[0] == "OUTPUT_FORMAT" && tok[1] == "(") {
+    if (tok[2] == "elf64-x86-64")
+      return EM_X86_64;
+    if (tok[2] == "elf32-i386")
+      return EM_386;
+  }
+  return -1;
+}
+
+// Most linker scripts we read are libc.so-style ones that only list
+// other files with INPUT or GROUP. Tokenizing such a script and
+// searching library directories for the files it lists is repeated
+// whenever the script is used, so we memoize the results by pathname
+// and modification time. Since the files are searched for, the result
+// also depends on the search paths, so they are part of the key.
+//
+// The cache lives as long as the process. A --preload daemon reads
+// input files before forking a child for each client, so the children
+// inherit the daemon's cache.
+struct ScriptInput {
+  std::string path;
+  bool as_needed = false;
+};
+
+struct CachedScript {
+  i64 output_type = -1;
+  std::unordered_map<std::string, std::vector<ScriptInput>> inputs;
+};
+
+template <typename E>
+static CachedScript *get_cached_script(Context<E> &ctx,
+                                       MappedFile<Context<E>> *mf) {
+  // Files given as memory buffers don't have modification times.
+  if (mf->mtime == 0)
+    return nullptr;
+
+  static std::unordered_map<std::string, std::unique_ptr<CachedScript>> cache;
+
+  std::string key = path_to_absolute(mf->name) + '\0' +
+                    std::to_string(mf->mtime) + '\0' + std::to_string(mf->size);
+
+  std::unique_ptr<CachedScript> &ent = cache[key];
+  if (!ent) {
+    ent.reset(new CachedScript);
+    current_file<E> = mf;
+    ent->output_type = get_output_type(tokenize(ctx, mf->get_contents()));
+  }
+  return ent.get();
+}
+
+template <typename E>
+static std::string get_search_key(Context<E> &ctx) {
+  std::string key = get_current_dir() + '\0' + ctx.arg.sysroot + '\0' +
+                    ctx.arg.chroot + '\0' + (ctx.is_static ? "1" : "0");
+  for (std::string_view dir : ctx.arg.library_paths) {
+    key += '\0';
+    key += dir;
+  }
+  return key;
+}
+
+// Reads files listed by a cached script. Returns false if any of them
+// can no longer be opened, in which case the script is parsed again.
+template <typename E>
+static bool read_cached_inputs(Context<E> &ctx,
+                               std::span<ScriptInput> inputs) {
+  std::vector<MappedFile<Context<E>> *> files;
+  for (ScriptInput &in : inputs) {
+    MappedFile<Context<E>> *mf = MappedFile<Context<E>>::open(ctx, in.path);
+    if (!mf)
+      return false;
+    files.push_back(mf);
+  }
+
+  for (i64 i = 0; i < inputs.size(); i++) {
+    bool orig = ctx.as_needed;
+    ctx.as_needed = ctx.as_needed || inputs[i].as_needed;
+    read_file(ctx, files[i]);
+    ctx.as_needed = orig;
+  }
+  return true;
+}
+
 template <typename E>
 static std::span<std::string_view>
-read_group(Context<E> &ctx, std::span<std::string_view> tok) {
+read_group(Context<E> &ctx, std::span<std::string_view> tok,
+           std::vector<ScriptInput> &inputs, bool as_needed = false) {
   tok = skip(ctx, tok, "(");
 
   while (!tok.empty() && tok[0] != ")") {
     if (tok[0] == "AS_NEEDED") {
       bool orig = ctx.as_needed;
       ctx.as_needed = true;
-      tok = read_group(ctx, tok.subspan(1));
+      tok = read_group(ctx, tok.subspan(1), inputs, true);
       ctx.as_needed = orig;
       continue;
     }
 
     MappedFile<Context<E>> *mf = resolve_path(ctx, tok[0]);
+    inputs.push_back({mf->name, as_needed});
     read_file(ctx, mf);
     tok = tok.subspan(1);
   }
@@ -201,17 +287,31 @@ read_group(Context<E> &ctx, std::span<std::string_view> tok) {
 
 template <typename E>
 void parse_linker_script(Context<E> &ctx, MappedFile<Context<E>> *mf) {
+  CachedScript *cached = get_cached_script(ctx, mf);
+  std::string search_key;
+
+  if (cached) {
+    search_key = get_search_key(ctx);
+    if (auto it = cached->inputs.find(search_key); it != cached->inputs.end())
+      if (read_cached_inputs(ctx, it->second))
+        return;
+  }
+
   current_file<E> = mf;
 
   std::vector<std::string_view> vec = tokenize(ctx, mf->get_contents());
   std::span<std::string_view> tok = vec;
+  std::vector<ScriptInput> inputs;
+  bool cacheable = true;
 
   while (!tok.empty()) {
     if (tok[0] == "OUTPUT_FORMAT") {
       tok = read_output_format(ctx, tok.subspan(1));
     } else if (tok[0] == "INPUT" || tok[0] == "GROUP") {
-      tok = read_group(ctx, tok.subspan(1));
+      tok = read_group(ctx, tok.subspan(1), inputs);
     } else if (tok[0] == "VERSION") {
+      // A version script updates the context, which we don't replay.
+      cacheable = false;
       tok = tok.subspan(1);
       tok = skip(ctx, tok, "{");
       read_version_script(ctx, tok);
@@ -222,22 +322,18 @@ void parse_linker_script(Context<E> &ctx, MappedFile<Context<E>> *mf) {
       SyntaxError(ctx, tok[0]) << "unknown linker script token";
     }
   }
+
+  if (cached && cacheable)
+    cached->inputs[search_key] = std::move(inputs);
 }
 
 template <typename E>
 i64 get_script_output_type(Context<E> &ctx, MappedFile<Context<E>> *mf) {
-  current_file<E> = mf;
+  if (CachedScript *cached = get_cached_script(ctx, mf))
+    return cached->output_type;
 
-  std::vector<std::string_view> vec = tokenize(ctx, mf->get_contents());
-  std::span<std::string_view> tok = vec;
-
-  if (tok.size() >= 3 && tok[0] == "OUTPUT_FORMAT" && tok[1] == "(") {
-    if (tok[2] == "elf64-x86-64")
-      return EM_X86_64;
-    if (tok[2] == "elf32-i386")
-      return EM_386;
-  }
-  return -1;
+  current_file<E> = mf;
+  return get_output_type(tokenize(ctx, mf->get_contents()));
 }
 
 static bool read_label(std::span<std::string_view> &tok,
@@ -0,0 +1,537 @@
+// This file implements link-time optimization (LTO) using a linker
+// plugin (GCC's liblto_plugin.so or LLVM's LLVMgold.so).
+//
+// With LTO, the compiler emits its intermediate representation (IR)
+// instead of machine code to object files. The linker cannot do much
+// with IR files by itself, so it passes them to the plugin given by
+// --plugin. The plugin "claims" IR files and reports their symbols to
+// the linker. We create an ObjectFile with no sections for each
+// claimed file and resolve symbols as usual.
+//
+// After symbol resolution, we tell the plugin how each symbol in IR
+// files was resolved, so that the compiler backend can internalize
+// or discard symbols that are not referenced from outside of the IR
+// world. The plugin then compiles the IR files into a few regular
+// object files and gives them back to us. We then replace the IR
+// files with the returned object files and redo symbol resolution.
+//
+// The plugin interface is process-global and not reentrant, so all
+// plugin state lives in static variables in this file.
+
+#include "mold.h"
+#include "lto.h"
+#include "../archive-file.h"
+
+#include <cstdarg>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for_each.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace mold::elf {
+
+template <typename E>
+static Context<E> *gctx;
+
+static bool is_plugin_loaded = false;
+static ClaimFileHandler *claim_file_hook;
+static AllSymbolsReadHandler *all_symbols_read_hook;
+static CleanupHandler *cleanup_hook;
+
+// Symbols reported by the plugin for the file being claimed.
+static std::vector<PluginSymbol> plugin_symbols;
+
+// File descriptors opened by get_input_file() and not released yet.
+static std::unordered_map<const void *, i32> input_fds;
+
+// Object files returned by the plugin after LTO.
+template <typename E>
+static std::vector<ObjectFile<E> *> lto_objects;
+
+template <typename E>
+static PluginStatus message(int level, const char *fmt, ...) {
+  Context<E> &ctx = *gctx<E>;
+
+  char buf[1024];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  switch (level) {
+  case LDPL_INFO:
+    SyncOut(ctx) << buf;
+    break;
+  case LDPL_WARNING:
+    Warn(ctx) << buf;
+    break;
+  case LDPL_ERROR:
+    Error(ctx) << buf;
+    break;
+  case LDPL_FATAL:
+    Fatal(ctx) << buf;
+  }
+  return LDPS_OK;
+}
+
+static PluginStatus register_claim_file_hook(ClaimFileHandler fn) {
+  claim_file_hook = fn;
+  return LDPS_OK;
+}
+
+static PluginStatus
+register_all_symbols_read_hook(AllSymbolsReadHandler fn) {
+  all_symbols_read_hook = fn;
+  return LDPS_OK;
+}
+
+static PluginStatus register_cleanup_hook(CleanupHandler fn) {
+  cleanup_hook = fn;
+  return LDPS_OK;
+}
+
+static PluginStatus
+add_symbols(void *handle, int nsyms, const PluginSymbol *psyms) {
+  plugin_symbols.assign(psyms, psyms + nsyms);
+  return LDPS_OK;
+}
+
+template <typename E>
+static PluginStatus add_input_file(const char *path) {
+  Context<E> &ctx = *gctx<E>;
+
+  MappedFile<Context<E>> *mf = MappedFile<Context<E>>::must_open(ctx, path);
+  if (get_file_type(mf) != FileType::ELF_OBJ)
+    Fatal(ctx) << path << ": LTO plugin returned a non-ELF file";
+
+  ObjectFile<E> *file = ObjectFile<E>::create(ctx, mf, "", false);
+  file->priority = ctx.file_priority++;
+  lto_objects<E>.push_back(file);
+  if (ctx.arg.trace)
+    SyncOut(ctx) << "trace: " << *file;
+  return LDPS_OK;
+}
+
+// Libraries given by -plugin-opt=-pass-through= are already on the
+// command line, so there's nothing to do.
+static PluginStatus add_input_library(const char *path) {
+  return LDPS_OK;
+}
+
+static PluginStatus set_extra_library_path(const char *path) {
+  return LDPS_OK;
+}
+
+// Returns the topmost file of a given file. For an archive member,
+// it's the archive file.
+template <typename E>
+static MappedFile<Context<E>> *get_root(MappedFile<Context<E>> *mf) {
+  while (mf->parent)
+    mf = mf->parent;
+  return mf;
+}
+
+template <typename E>
+static std::string get_path(Context<E> &ctx, MappedFile<Context<E>> *mf) {
+  std::string path = get_root(mf)->name;
+  if (path.starts_with('/') && !ctx.arg.chroot.empty())
+    path = ctx.arg.chroot + "/" + path_clean(path);
+  return path;
+}
+
+template <typename E>
+static PluginStatus get_input_file(const void *handle, PluginInputFile *file) {
+  Context<E> &ctx = *gctx<E>;
+  ObjectFile<E> &obj = *(ObjectFile<E> *)handle;
+  MappedFile<Context<E>> *mf = obj.mf;
+
+  file->name = get_root(mf)->name.c_str();
+  file->fd = ::open(get_path(ctx, mf).c_str(), O_RDONLY);
+  if (file->fd == -1)
+    Fatal(ctx) << "cannot open " << file->name << ": " << errno_string();
+  file->offset = mf->data - get_root(mf)->data;
+  file->filesize = mf->size;
+  file->handle = (void *)handle;
+  input_fds[handle] = file->fd;
+  return LDPS_OK;
+}
+
+static PluginStatus release_input_file(const void *handle) {
+  if (auto it = input_fds.find(handle); it != input_fds.end()) {
+    ::close(it->second);
+    input_fds.erase(it);
+  }
+  return LDPS_OK;
+}
+
+template <typename E>
+static PluginStatus get_view(const void *handle, const void **view) {
+  *view = ((ObjectFile<E> *)handle)->mf->data;
+  return LDPS_OK;
+}
+
+// Tells the plugin how symbols in a given IR file were resolved.
+template <typename E>
+static PluginStatus get_symbols(const void *handle, int nsyms,
+                                PluginSymbol *psyms, i64 version) {
+  Context<E> &ctx = *gctx<E>;
+  ObjectFile<E> &file = *(ObjectFile<E> *)handle;
+  assert(file.is_lto_obj);
+
+  // An archive member that was not pulled in contributes nothing.
+  if (!file.is_alive) {
+    for (i64 i = 0; i < nsyms; i++)
+      psyms[i].resolution = LDPR_PREEMPTED_REG;
+    return (version == 3) ? LDPS_NO_SYMS : LDPS_OK;
+  }
+
+  auto get_resolution = [&](const ElfSym<E> &esym, Symbol<E> &sym) {
+    if (!sym.file)
+      return LDPR_UNDEF;
+
+    if (sym.file == &file) {
+      if (sym.referenced_by_regular_obj)
+        return LDPR_PREVAILING_DEF;
+
+      bool is_exported = (ctx.arg.shared || ctx.arg.export_dynamic) &&
+                         sym.visibility != STV_HIDDEN;
+      if (!is_exported)
+        return LDPR_PREVAILING_DEF_IRONLY;
+      if (version == 1)
+        return LDPR_PREVAILING_DEF;
+      return LDPR_PREVAILING_DEF_IRONLY_EXP;
+    }
+
+    if (sym.file->is_dso)
+      return esym.is_undef() ? LDPR_RESOLVED_DYN : LDPR_PREEMPTED_REG;
+
+    if (((ObjectFile<E> *)sym.file)->is_lto_obj)
+      return esym.is_undef() ? LDPR_RESOLVED_IR : LDPR_PREEMPTED_IR;
+    return esym.is_undef() ? LDPR_RESOLVED_EXEC : LDPR_PREEMPTED_REG;
+  };
+
+  for (i64 i = 0; i < nsyms; i++)
+    psyms[i].resolution = get_resolution(file.elf_syms[i + 1],
+                                         *file.symbols[i + 1]);
+  return LDPS_OK;
+}
+
+template <typename E>
+static PluginStatus get_symbols_v1(const void *handle, int nsyms,
+                                   PluginSymbol *psyms) {
+  return get_symbols<E>(handle, nsyms, psyms, 1);
+}
+
+template <typename E>
+static PluginStatus get_symbols_v2(const void *handle, int nsyms,
+                                   PluginSymbol *psyms) {
+  return get_symbols<E>(handle, nsyms, psyms, 2);
+}
+
+template <typename E>
+static PluginStatus get_symbols_v3(const void *handle, int nsyms,
+                                   PluginSymbol *psyms) {
+  return get_symbols<E>(handle, nsyms, psyms, 3);
+}
+
+template <typename E>
+static bool is_llvm(Context<E> &ctx) {
+  return path_filename(ctx.arg.plugin).starts_with("LLVMgold");
+}
+
+template <typename E>
+static bool has_plugin_opt(Context<E> &ctx, std::string_view prefix) {
+  for (std::string_view opt : ctx.arg.plugin_opt)
+    if (opt.starts_with(prefix))
+      return true;
+  return false;
+}
+
+template <typename E>
+static void load_plugin(Context<E> &ctx) {
+  if (is_plugin_loaded)
+    return;
+  is_plugin_loaded = true;
+  gctx<E> = &ctx;
+
+  void *handle = dlopen(ctx.arg.plugin.c_str(), RTLD_NOW | RTLD_GLOBAL);
+  if (!handle)
+    Fatal(ctx) << "could not open plugin file: " << dlerror();
+
+  OnloadFn *onload = (OnloadFn *)dlsym(handle, "onload");
+  if (!onload)
+    Fatal(ctx) << "failed to load plugin " << ctx.arg.plugin << ": "
+               << dlerror();
+
+  // The plugin may keep pointers to the option strings, so they have
+  // to live until the end of the process.
+  std::vector<std::string_view> opts;
+  for (std::string_view opt : ctx.arg.plugin_opt)
+    opts.push_back(opt);
+
+  // LLVM runs ThinLTO backends in a thread pool of its own. Size it
+  // to the number of threads we use, and enable its cache if asked.
+  if (is_llvm(ctx)) {
+    if (!has_plugin_opt(ctx, "jobs=")) {
+      i64 jobs = ctx.arg.thinlto_jobs;
+      if (jobs == 0)
+        jobs = tbb::global_control::active_value(
+          tbb::global_control::max_allowed_parallelism);
+      opts.push_back(save_string(ctx, "jobs=" + std::to_string(jobs)));
+    }
+
+    if (!ctx.arg.thinlto_cache_dir.empty() &&
+        !has_plugin_opt(ctx, "cache-dir="))
+      opts.push_back(save_string(ctx, "cache-dir=" + ctx.arg.thinlto_cache_dir));
+  }
+
+  auto get_output_type = [&] {
+    if (ctx.arg.relocatable)
+      return LDPO_REL;
+    if (ctx.arg.shared)
+      return LDPO_DYN;
+    if (ctx.arg.pie)
+      return LDPO_PIE;
+    return LDPO_EXEC;
+  };
+
+  static std::vector<PluginTagValue> tv;
+  tv.emplace_back(LDPT_MESSAGE, message<E>);
+  tv.emplace_back(LDPT_API_VERSION, LD_PLUGIN_API_VERSION);
+  tv.emplace_back(LDPT_GNU_LD_VERSION, 23800);
+  tv.emplace_back(LDPT_LINKER_OUTPUT, get_output_type());
+
+  for (std::string_view opt : opts)
+    tv.emplace_back(LDPT_OPTION, opt.data());
+
+  tv.emplace_back(LDPT_REGISTER_CLAIM_FILE_HOOK, register_claim_file_hook);
+  tv.emplace_back(LDPT_REGISTER_ALL_SYMBOLS_READ_HOOK,
+                  register_all_symbols_read_hook);
+  tv.emplace_back(LDPT_REGISTER_CLEANUP_HOOK, register_cleanup_hook);
+  tv.emplace_back(LDPT_ADD_SYMBOLS, add_symbols);
+  tv.emplace_back(LDPT_ADD_SYMBOLS_V2, add_symbols);
+  tv.emplace_back(LDPT_GET_SYMBOLS, get_symbols_v1<E>);
+  tv.emplace_back(LDPT_GET_SYMBOLS_V2, get_symbols_v2<E>);
+  tv.emplace_back(LDPT_GET_SYMBOLS_V3, get_symbols_v3<E>);
+  tv.emplace_back(LDPT_ADD_INPUT_FILE, add_input_file<E>);
+  tv.emplace_back(LDPT_ADD_INPUT_LIBRARY, add_input_library);
+  tv.emplace_back(LDPT_SET_EXTRA_LIBRARY_PATH, set_extra_library_path);
+  tv.emplace_back(LDPT_GET_INPUT_FILE, get_input_file<E>);
+  tv.emplace_back(LDPT_RELEASE_INPUT_FILE, release_input_file);
+  tv.emplace_back(LDPT_GET_VIEW, get_view<E>);
+  tv.emplace_back(LDPT_OUTPUT_NAME, ctx.arg.output.c_str());
+  tv.emplace_back(LDPT_NULL, 0);
+
+  if (onload(tv.data()) != LDPS_OK)
+    Fatal(ctx) << ctx.arg.plugin << ": onload failed";
+}
+
+// GCC's IR object files are ELF files containing .gnu.lto_* sections.
+// A slim IR object file has only a dummy common symbol `__gnu_lto_slim`
+// in its symbol table, and a fat one has regular sections in addition
+// to IR sections so that it can be linked without LTO.
+template <typename E>
+bool is_gcc_lto_obj(Context<E> &ctx, MappedFile<Context<E>> *mf) {
+  u8 *data = mf->data;
+  ElfEhdr<E> &ehdr = *(ElfEhdr<E> *)data;
+  if (mf->size < sizeof(ehdr) || ehdr.e_shoff == 0 ||
+      mf->size < ehdr.e_shoff + sizeof(ElfShdr<E>))
+    return false;
+
+  ElfShdr<E> *sh_begin = (ElfShdr<E> *)(data + ehdr.e_shoff);
+  i64 num_sections = (ehdr.e_shnum == 0) ? sh_begin->sh_size : ehdr.e_shnum;
+  if (mf->size < ehdr.e_shoff + num_sections * sizeof(ElfShdr<E>))
+    return false;
+
+  std::span<ElfShdr<E>> shdrs{sh_begin, (size_t)num_sections};
+  i64 shstrtab_idx = (ehdr.e_shstrndx == SHN_XINDEX)
+    ? sh_begin->sh_link : ehdr.e_shstrndx;
+  if (shstrtab_idx >= num_sections)
+    return false;
+
+  char *shstrtab = (char *)data + shdrs[shstrtab_idx].sh_offset;
+
+  for (ElfShdr<E> &shdr : shdrs) {
+    std::string_view name = shstrtab + shdr.sh_name;
+    if (name.starts_with(".gnu.lto_.symtab."))
+      return true;
+  }
+  return false;
+}
+
+template <typename E>
+static ElfSym<E> to_elf_sym(PluginSymbol &psym) {
+  ElfSym<E> esym;
+  memset(&esym, 0, sizeof(esym));
+  esym.st_bind = STB_GLOBAL;
+
+  switch (psym.def) {
+  case LDPK_DEF:
+    esym.st_shndx = SHN_ABS;
+    break;
+  case LDPK_WEAKDEF:
+    esym.st_shndx = SHN_ABS;
+    esym.st_bind = STB_WEAK;
+    break;
+  case LDPK_UNDEF:
+    esym.st_shndx = SHN_UNDEF;
+    break;
+  case LDPK_WEAKUNDEF:
+    esym.st_shndx = SHN_UNDEF;
+    esym.st_bind = STB_WEAK;
+    break;
+  case LDPK_COMMON:
+    esym.st_shndx = SHN_COMMON;
+    esym.st_value = 1;
+    break;
+  }
+
+  switch (psym.symbol_type) {
+  case LDST_FUNCTION:
+    esym.st_type = STT_FUNC;
+    break;
+  case LDST_VARIABLE:
+    esym.st_type = STT_OBJECT;
+    break;
+  }
+
+  switch (psym.visibility) {
+  case LDPV_PROTECTED:
+    esym.st_visibility = STV_PROTECTED;
+    break;
+  case LDPV_INTERNAL:
+    esym.st_visibility = STV_INTERNAL;
+    break;
+  case LDPV_HIDDEN:
+    esym.st_visibility = STV_HIDDEN;
+    break;
+  }
+
+  esym.st_size = psym.size;
+  return esym;
+}
+
+// Passes a given IR file to the plugin. Returns null if the plugin
+// doesn't claim it.
+template <typename E>
+ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                               std::string archive_name, bool is_in_lib) {
+  if (ctx.arg.plugin.empty())
+    Fatal(ctx) << mf->name << ": looks like this is an LTO IR file, "
+               << "but no --plugin option was given";
+
+  load_plugin(ctx);
+  if (!claim_file_hook)
+    Fatal(ctx) << ctx.arg.plugin << ": no claim_file hook was registered";
+
+  ObjectFile<E> *obj = ObjectFile<E>::create_lto(ctx, mf, archive_name,
+                                                 is_in_lib);
+
+  PluginInputFile file;
+  get_input_file<E>(obj, &file);
+
+  plugin_symbols.clear();
+  int claimed = false;
+  claim_file_hook(&file, &claimed);
+  release_input_file(obj);
+
+  if (!claimed)
+    return nullptr;
+
+  // Create a symbol table and a string table from plugin symbols.
+  // The first symbol is a null symbol as in regular ELF files.
+  i64 nsyms = plugin_symbols.size() + 1;
+  u8 *buf = new u8[nsyms * sizeof(ElfSym<E>)];
+  add_to_string_pool(ctx, buf, nsyms * sizeof(ElfSym<E>));
+
+  ElfSym<E> *esyms = (ElfSym<E> *)buf;
+  memset(esyms, 0, sizeof(ElfSym<E>));
+  std::string strtab(1, '\0');
+
+  for (i64 i = 0; i < plugin_symbols.size(); i++) {
+    PluginSymbol &psym = plugin_symbols[i];
+    esyms[i + 1] = to_elf_sym<E>(psym);
+    esyms[i + 1].st_name = strtab.size();
+    strtab += psym.name;
+    strtab += '\0';
+  }
+
+  obj->elf_syms = {esyms, (size_t)nsyms};
+  obj->symbol_strtab = save_string(ctx, strtab);
+  obj->first_global = 1;
+  return obj;
+}
+
+// Compiles IR files into regular object files with the plugin and
+// returns the object files.
+template <typename E>
+std::vector<ObjectFile<E> *> do_lto(Context<E> &ctx) {
+  Timer t(ctx, "do_lto");
+
+  // The compiler must not remove or internalize symbols that are
+  // referenced from outside of the IR world.
+  auto is_lto_sym = [](Symbol<E> *sym) {
+    return sym->file && !sym->file->is_dso &&
+           ((ObjectFile<E> *)sym->file)->is_lto_obj;
+  };
+
+  auto mark = [&](Symbol<E> *sym) {
+    if (is_lto_sym(sym)) {
+      ProfiledLock lock(sym->mu, symbol_lock_stats());
+      sym->referenced_by_regular_obj = true;
+    }
+  };
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    if (file->is_alive && !file->is_lto_obj)
+      for (Symbol<E> *sym : file->get_global_syms())
+        mark(sym);
+  });
+
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    for (Symbol<E> *sym : file->globals)
+      mark(sym);
+  });
+
+  for (std::string_view name : ctx.arg.undefined)
+    mark(intern(ctx, name));
+  for (std::string_view name : ctx.arg.require_defined)
+    mark(intern(ctx, name));
+
+  mark(intern(ctx, ctx.arg.entry));
+  mark(intern(ctx, ctx.arg.init));
+  mark(intern(ctx, ctx.arg.fini));
+
+  // all_symbols_read_hook() calls get_symbols() for each IR file and
+  // then add_input_file() for each object file it creates.
+  if (PluginStatus st = all_symbols_read_hook(); st != LDPS_OK)
+    Fatal(ctx) << ctx.arg.plugin << ": all_symbols_read_hook returned " << st;
+
+  tbb::parallel_for_each(lto_objects<E>, [&](ObjectFile<E> *file) {
+    file->parse(ctx);
+  });
+  return lto_objects<E>;
+}
+
+// Lets the plugin remove its temporary files.
+template <typename E>
+void lto_cleanup(Context<E> &ctx) {
+  if (cleanup_hook)
+    cleanup_hook();
+}
+
+#define INSTANTIATE(E)                                                  \
+  template bool is_gcc_lto_obj(Context<E> &, MappedFile<Context<E>> *); \
+  template ObjectFile<E> *                                              \
+  read_lto_object(Context<E> &, MappedFile<Context<E>> *,               \
+                  std::string, bool);                                   \
+  template std::vector<ObjectFile<E> *> do_lto(Context<E> &);           \
+  template void lto_cleanup(Context<E> &)
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -1,15 +1,20 @@
 #include "mold.h"
 #include "../archive-file.h"
 #include "../cmdline.h"
+#include "../libmold.h"
+#include "../subprocess.h"
 
 #include <cstring>
+#include <dirent.h>
 #include <functional>
 #include <iomanip>
 #include <map>
 #include <signal.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_for_each.h>
 #include <unistd.h>
 #include <unordered_set>
@@ -29,14 +34,12 @@ std::regex glob_to_regex(std::string_view pattern) {
 
 template <typename E>
 static ObjectFile<E> *new_object_file(Context<E> &ctx, MappedFile<Context<E>> *mf,
-                                      std::string archive_name) {
+                                      std::string archive_name, bool in_lib) {
   static Counter count("parsed_objs");
   count++;
 
-  bool in_lib = ctx.in_lib || (!archive_name.empty() && !ctx.whole_archive);
   ObjectFile<E> *file = ObjectFile<E>::create(ctx, mf, archive_name, in_lib);
   file->priority = ctx.file_priority++;
-  ctx.tg.run([file, &ctx]() { file->parse(ctx); });
   if (ctx.arg.trace)
     SyncOut(ctx) << "trace: " << *file;
   return file;
@@ -46,12 +49,43 @@ template <typename E>
 static SharedFile<E> *new_shared_file(Context<E> &ctx, MappedFile<Context<E>> *mf) {
   SharedFile<E> *file = SharedFile<E>::create(ctx, mf);
   file->priority = ctx.file_priority++;
-  ctx.tg.run([file, &ctx]() { file->parse(ctx); });
   if (ctx.arg.trace)
     SyncOut(ctx) << "trace: " << *file;
   return file;
 }
 
+// Creates an object file for an LTO IR file. If the linker plugin
+// doesn't claim a GCC fat LTO object, it is read as a regular object.
+template <typename E>
+static ObjectFile<E> *new_lto_obj(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                                  std::string archive_name, bool in_lib) {
+  static Counter count("parsed_lto_objs");
+  count++;
+
+  ObjectFile<E> *file = read_lto_object(ctx, mf, archive_name, in_lib);
+  if (!file) {
+    if (get_file_type(mf) == FileType::LLVM_BITCODE)
+      Fatal(ctx) << mf->name << ": not claimed by the LTO plugin; "
+                 << "please make sure you are using the same compiler "
+                 << "for compiling and linking";
+    return new_object_file(ctx, mf, archive_name, in_lib);
+  }
+
+  file->priority = ctx.file_priority++;
+  if (ctx.arg.trace)
+    SyncOut(ctx) << "trace: " << *file;
+  return file;
+}
+
+template <typename E>
+static ObjectFile<E> *read_object(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                                  std::string archive_name, bool in_lib) {
+  if (get_file_type(mf) == FileType::LLVM_BITCODE ||
+      (!ctx.arg.plugin.empty() && is_gcc_lto_obj(ctx, mf)))
+    return new_lto_obj(ctx, mf, archive_name, in_lib);
+  return new_object_file(ctx, mf, archive_name, in_lib);
+}
+
 template <typename E>
 void read_file(Context<E> &ctx, MappedFile<Context<E>> *mf) {
   if (ctx.visited.contains(mf->name))
@@ -59,25 +93,26 @@ void read_file(Context<E> &ctx, MappedFile<Context<E>> *mf) {
 
   switch (get_file_type(mf)) {
   case FileType::ELF_OBJ:
-    ctx.objs.push_back(new_object_file(ctx, mf, ""));
+  case FileType::LLVM_BITCODE:
+    ctx.objs.push_back(read_object(ctx, mf, "", ctx.in_lib));
     return;
   case FileType::ELF_DSO:
     ctx.dsos.push_back(new_shared_file(ctx, mf));
     ctx.visited.insert(mf->name);
     return;
   case FileType::AR:
-  case FileType::THIN_AR:
-    for (MappedFile<Context<E>> *child : read_archive_members(ctx, mf))
-      if (get_file_type(child) == FileType::ELF_OBJ)
-        ctx.objs.push_back(new_object_file(ctx, child, mf->name));
+  case FileType::THIN_AR: {
+    bool in_lib = ctx.in_lib || !ctx.whole_archive;
+    for (MappedFile<Context<E>> *child : read_archive_members(ctx, mf, in_lib))
+      if (FileType ty = get_file_type(child);
+          ty == FileType::ELF_OBJ || ty == FileType::LLVM_BITCODE)
+        ctx.objs.push_back(read_object(ctx, child, mf->name, in_lib));
     ctx.visited.insert(mf->name);
     return;
+  }
   case FileType::TEXT:
     parse_linker_script(ctx, mf);
     return;
-  case FileType::LLVM_BITCODE:
-    Fatal(ctx) << mf->name << ": looks like this is an LLVM bitcode, "
-               << "but mold does not support LTO";
   default:
     Fatal(ctx) << mf->name << ": unknown file type";
   }
@@ -96,9 +131,12 @@ static i64 get_machine_type(Context<E> &ctx, MappedFile<Context<E>> *mf) {
         return ((ElfEhdr<E> *)child->data)->e_machine;
     return -1;
   case FileType::THIN_AR:
-    for (MappedFile<Context<E>> *child : read_thin_archive_members(ctx, mf))
-      if (get_file_type(child) == FileType::ELF_OBJ)
+    // Open members one by one, as we need only the first object file.
+    for (std::string &path : read_thin_archive_member_paths(ctx, mf)) {
+      MappedFile<Context<E>> *child = MappedFile<Context<E>>::open(ctx, path);
+      if (child && get_file_type(child) == FileType::ELF_OBJ)
         return ((ElfEhdr<E> *)child->data)->e_machine;
+    }
     return -1;
   case FileType::TEXT:
     return get_script_output_type(ctx, mf);
@@ -121,23 +159,63 @@ static MappedFile<Context<E>> *open_library(Context<E> &ctx, std::string path) {
   return nullptr;
 }
 
+// Returns the names of files in a given directory, or nullptr if the
+// directory cannot be read.
+static std::unique_ptr<std::unordered_set<std::string>>
+list_directory(const std::string &path) {
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return nullptr;
+
+  std::unique_ptr<std::unordered_set<std::string>> names(
+    new std::unordered_set<std::string>);
+  while (struct dirent *ent = readdir(dir))
+    names->insert(ent->d_name);
+  closedir(dir);
+  return names;
+}
+
+// Each -l option used to try to open lib<name>.so and lib<name>.a in
+// each library directory in turn. That's a lot of failed system calls
+// if there are many -L and -l options, especially on a network file
+// system. So we read all library directories in parallel on the first
+// -l option and look up files in the listings. If a directory cannot
+// be listed, we fall back to trying to open files in it.
+template <typename E>
+static bool maybe_in_library_dir(Context<E> &ctx, i64 idx,
+                                 const std::string &name) {
+  if (ctx.library_dirs.empty() && !ctx.arg.library_paths.empty()) {
+    ctx.library_dirs.resize(ctx.arg.library_paths.size());
+    tbb::parallel_for((i64)0, (i64)ctx.library_dirs.size(), [&](i64 i) {
+      ctx.library_dirs[i] = list_directory(ctx.arg.library_paths[i]);
+    });
+  }
+
+  std::unordered_set<std::string> *names = ctx.library_dirs[idx].get();
+  return !names || name.find('/') != name.npos || names->contains(name);
+}
+
 template <typename E>
 MappedFile<Context<E>> *find_library(Context<E> &ctx, std::string name) {
+  auto open = [&](i64 idx, const std::string &filename) {
+    MappedFile<Context<E>> *mf = nullptr;
+    if (maybe_in_library_dir(ctx, idx, filename))
+      mf = open_library(ctx, ctx.arg.library_paths[idx] + "/" + filename);
+    return mf;
+  };
+
   if (name.starts_with(':')) {
-    for (std::string_view dir : ctx.arg.library_paths) {
-      std::string path = std::string(dir) + "/" + name.substr(1);
-      if (MappedFile<Context<E>> *mf = open_library(ctx, path))
+    for (i64 i = 0; i < ctx.arg.library_paths.size(); i++)
+      if (MappedFile<Context<E>> *mf = open(i, name.substr(1)))
         return mf;
-    }
     Fatal(ctx) << "library not found: " << name;
   }
 
-  for (std::string_view dir : ctx.arg.library_paths) {
-    std::string stem = std::string(dir) + "/lib" + name;
+  for (i64 i = 0; i < ctx.arg.library_paths.size(); i++) {
     if (!ctx.is_static)
-      if (MappedFile<Context<E>> *mf = open_library(ctx, stem + ".so"))
+      if (MappedFile<Context<E>> *mf = open(i, "lib" + name + ".so"))
         return mf;
-    if (MappedFile<Context<E>> *mf = open_library(ctx, stem + ".a"))
+    if (MappedFile<Context<E>> *mf = open(i, "lib" + name + ".a"))
       return mf;
   }
   Fatal(ctx) << "library not found: " << name;
@@ -147,12 +225,50 @@ template <typename E>
 static void read_input_files(Context<E> &ctx, std::span<std::string_view> args) {
   Timer t(ctx, "read_input_files");
 
+  // Opening and mmap'ing input files one by one can be the critical
+  // path if there are tens of thousands of them on a cold page cache.
+  // So we open all positional arguments in parallel first. Positional
+  // arguments never start with '-', and only the following options
+  // take a separate argument after parse_nonpositional_args().
+  // Files that failed to open here are opened again below so that
+  // errors are reported in command line order.
+  std::span<std::string_view> orig = args;
+  std::vector<MappedFile<Context<E>> *> preopened(orig.size());
+
+  tbb::parallel_for((i64)0, (i64)orig.size(), [&](i64 i) {
+    if (orig[i].starts_with('-'))
+      return;
+    if (i > 0 && (orig[i - 1] == "-l" || orig[i - 1] == "--version-script" ||
+                  orig[i - 1] == "--dynamic-list"))
+      return;
+
+    MappedFile<Context<E>> *mf =
+      MappedFile<Context<E>>::open(ctx, std::string(orig[i]));
+
+    // Classify the file here so that its header is paged in in parallel.
+    if (mf)
+      get_file_type(mf);
+    preopened[i] = mf;
+  });
+
+  auto open_positional = [&] {
+    if (MappedFile<Context<E>> *mf = preopened[args.data() - orig.data()])
+      return mf;
+    return MappedFile<Context<E>>::must_open(ctx, std::string(args[0]));
+  };
+
   std::vector<std::tuple<bool, bool, bool, bool>> state;
   ctx.is_static = ctx.arg.is_static;
 
   while (!args.empty()) {
     std::string_view arg;
 
+    if (!args[0].starts_with('-')) {
+      read_file(ctx, open_positional());
+      args = args.subspan(1);
+      continue;
+    }
+
     if (read_flag(args, "as-needed")) {
       ctx.as_needed = true;
     } else if (read_flag(args, "no-as-needed")) {
@@ -187,68 +303,267 @@ static void read_input_files(Context<E> &ctx, std::span<std::string_view> args)
       mf->given_fullpath = false;
       read_file(ctx, mf);
     } else {
-      read_file(ctx, MappedFile<Context<E>>::must_open(ctx, std::string(args[0])));
+      read_file(ctx, open_positional());
       args = args.subspan(1);
     }
   }
 
   if (ctx.objs.empty())
     Fatal(ctx) << "no input files";
+}
+
+// Estimates the number of distinct global symbol names in input files
+// so that we can size the symbol table before parsing them.
+template <typename E>
+static i64 estimate_num_symbols(Context<E> &ctx) {
+  Timer t(ctx, "estimate_num_symbols");
+  HyperLogLog estimator;
+
+  auto scan = [&](InputFile<E> *file, u32 type) {
+    ElfShdr<E> *shdr = file->find_section(type);
+    if (!shdr)
+      return;
+
+    std::span<ElfSym<E>> syms = file->template get_data<ElfSym<E>>(ctx, *shdr);
+    std::string_view strtab = file->get_string(ctx, shdr->sh_link);
+
+    HyperLogLog local;
+    for (i64 i = shdr->sh_info; i < syms.size(); i++)
+      local.insert(hash_string(strtab.data() + syms[i].st_name));
+    estimator.merge(local);
+  };
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    scan(file, SHT_SYMTAB);
+  });
+
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    scan(file, SHT_DYNSYM);
+  });
+
+  return estimator.get_cardinality();
+}
+
+// Estimates the number of distinct comdat group signatures in input
+// files so that we can size the comdat group table before parsing them.
+template <typename E>
+static i64 estimate_num_comdat_groups(Context<E> &ctx) {
+  Timer t(ctx, "estimate_num_comdat_groups");
+  HyperLogLog estimator;
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    ElfShdr<E> *symtab = file->find_section(SHT_SYMTAB);
+    if (!symtab)
+      return;
+
+    std::span<ElfSym<E>> syms =
+      file->template get_data<ElfSym<E>>(ctx, *symtab);
+    std::string_view strtab = file->get_string(ctx, symtab->sh_link);
+
+    HyperLogLog local;
+    for (ElfShdr<E> &shdr : file->elf_sections)
+      if (shdr.sh_type == SHT_GROUP && shdr.sh_info < syms.size())
+        local.insert(hash_string(strtab.data() + syms[shdr.sh_info].st_name));
+    estimator.merge(local);
+  });
+
+  return estimator.get_cardinality();
+}
+
+template <typename E>
+static void parse_input_files(Context<E> &ctx) {
+  Timer t(ctx, "parse_input_files");
+  ProgressCounter progress("parse", ctx.objs.size() + ctx.dsos.size());
+
+  for (ObjectFile<E> *file : ctx.objs) {
+    ctx.tg.run([file, &ctx, &t, &progress]() {
+      TaskTimer t2(ctx, t, file->filename);
+      CostTimer t3(ctx.arg.perf_files, file->parse_time);
+      file->parse(ctx);
+      progress.add(1);
+    });
+  }
 
+  // DSOs given under --as-needed are usually not needed, so we don't
+  // register their definitions eagerly. They are registered only if
+  // someone refers to them. We can't do that if LTO may add new
+  // references later or if files may be reloaded by the daemon.
+  bool lazy = !ctx.arg.preload &&
+              std::none_of(ctx.objs.begin(), ctx.objs.end(),
+                           [](ObjectFile<E> *file) { return file->is_lto_obj; });
+
+  for (SharedFile<E> *file : ctx.dsos) {
+    file->is_lazy = lazy && !file->is_alive;
+    ctx.tg.run([file, &ctx, &t, &progress]() {
+      TaskTimer t2(ctx, t, file->filename);
+      CostTimer t3(ctx.arg.perf_files, file->parse_time);
+      file->parse(ctx);
+      progress.add(1);
+    });
+  }
   ctx.tg.wait();
+
+  if (!lazy)
+    return;
+
+  // Names given by -u and --require-defined can make a DSO needed,
+  // so they have to be in the symbol table before we look up names.
+  for (std::string_view name : ctx.arg.undefined)
+    intern(ctx, name);
+  for (std::string_view name : ctx.arg.require_defined)
+    intern(ctx, name);
+
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    if (file->is_lazy) {
+      CostTimer t2(ctx.arg.perf_files, file->parse_time);
+      file->register_lazy_symbols(ctx);
+    }
+  });
 }
 
+// Removes DSOs that have the same soname as preceding ones. We do this
+// before parsing because reading DT_SONAME is much cheaper than reading
+// a dynamic symbol table.
 template <typename E>
-static i64 get_mtime(Context<E> &ctx, std::string path) {
-  struct stat st;
-  if (stat(path.c_str(), &st) < 0)
-    Fatal(ctx) << path << ": stat failed: " << errno_string();
-  return st.st_mtime;
+static void uniquify_dsos(Context<E> &ctx) {
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    file->read_soname(ctx);
+  });
+
+  std::unordered_set<std::string_view> seen;
+  erase(ctx.dsos, [&](SharedFile<E> *file) {
+    return !seen.insert(file->soname).second;
+  });
 }
 
+// When mold is running as a daemon, input files may have been updated
+// between the time when we preloaded them and the time when we get
+// a link request. This function re-reads only the updated files.
+//
+// If a member of an archive file is updated, the archive file is
+// usually rewritten as a whole, so we re-read all members of the
+// archive and replace the stale ones with them.
 template <typename E>
-static bool reload_input_files(Context<E> &ctx) {
+static void reload_input_files(Context<E> &ctx) {
   Timer t(ctx, "reload_input_files");
 
   std::vector<ObjectFile<E> *> objs;
   std::vector<SharedFile<E> *> dsos;
+  std::unordered_set<MappedFile<Context<E>> *> reloaded;
 
-  // Reload updated .o files
+  auto parse = [&](auto *file) {
+    ctx.tg.run([file, &ctx]() { file->parse(ctx); });
+    return file;
+  };
+
+  // Reload updated .o and .a files
   for (ObjectFile<E> *file : ctx.objs) {
-    if (file->mf->parent) {
-      if (get_mtime(ctx, file->mf->parent->name) != file->mf->parent->mtime)
-        return false;
-      objs.push_back(file);
+    if (MappedFile<Context<E>> *parent = file->mf->parent) {
+      if (!is_updated(ctx, parent)) {
+        objs.push_back(file);
+        continue;
+      }
+
+      if (!reloaded.insert(parent).second)
+        continue;
+
+      MappedFile<Context<E>> *mf =
+        MappedFile<Context<E>>::must_open(ctx, parent->name);
+      for (MappedFile<Context<E>> *child : read_archive_members(ctx, mf))
+        if (get_file_type(child) == FileType::ELF_OBJ)
+          objs.push_back(parse(new_object_file(ctx, child, file->archive_name,
+                                               file->is_in_lib)));
       continue;
     }
 
-    if (get_mtime(ctx, file->mf->name) == file->mf->mtime) {
+    if (!is_updated(ctx, file->mf)) {
       objs.push_back(file);
       continue;
     }
 
     MappedFile<Context<E>> *mf =
       MappedFile<Context<E>>::must_open(ctx, file->mf->name);
-    objs.push_back(new_object_file(ctx, mf, file->mf->name));
+    objs.push_back(parse(new_object_file(ctx, mf, file->archive_name,
+                                         file->is_in_lib)));
   }
 
   // Reload updated .so files
   for (SharedFile<E> *file : ctx.dsos) {
-    MappedFile<Context<E>> *mf =
-      MappedFile<Context<E>>::must_open(ctx, file->mf->name);
-
-    if (get_mtime(ctx, file->mf->name) == file->mf->mtime) {
+    if (!is_updated(ctx, file->mf)) {
       dsos.push_back(file);
-    } else {
-      MappedFile<Context<E>> *mf =
-        MappedFile<Context<E>>::must_open(ctx, file->mf->name);
-      dsos.push_back(new_shared_file(ctx, mf));
+      continue;
     }
+
+    MappedFile<Context<E>> *mf =
+      MappedFile<Context<E>>::must_open(ctx, file->mf->name);
+    mf->given_fullpath = file->mf->given_fullpath;
+    dsos.push_back(parse(new_shared_file(ctx, mf)));
   }
 
+  ctx.tg.wait();
   ctx.objs = objs;
   ctx.dsos = dsos;
-  return true;
+}
+
+// Returns the files that reload_input_files() checks for updates.
+template <typename E>
+static std::vector<MappedFile<Context<E>> *> get_input_files(Context<E> &ctx) {
+  std::vector<MappedFile<Context<E>> *> vec;
+  for (ObjectFile<E> *file : ctx.objs)
+    vec.push_back(file->mf->parent ? file->mf->parent : file->mf);
+  for (SharedFile<E> *file : ctx.dsos)
+    vec.push_back(file->mf);
+
+  sort(vec);
+  vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
+  return vec;
+}
+
+template <typename T>
+static i64 vector_bytes(const std::vector<T> &vec) {
+  return vec.capacity() * sizeof(T);
+}
+
+// Counts approximate numbers of bytes held by major data structures.
+// Only the largest members are taken into account.
+template <typename E>
+static void count_memory_usage(Context<E> &ctx) {
+  static Counter obj_bytes("mem_obj_pool");
+  for (std::unique_ptr<ObjectFile<E>> &file : ctx.obj_pool) {
+    obj_bytes += sizeof(ObjectFile<E>) + vector_bytes(file->sections) +
+                 vector_bytes(file->symbols) + vector_bytes(file->cies) +
+                 vector_bytes(file->fdes) + vector_bytes(file->symvers) +
+                 vector_bytes(file->subsections) +
+                 vector_bytes(file->sym_subsections) +
+                 vector_bytes(file->comdat_groups) +
+                 file->first_global * sizeof(Symbol<E>);
+
+    for (InputSection<E> *isec : file->sections)
+      if (isec)
+        obj_bytes += sizeof(InputSection<E>);
+  }
+
+  static Counter dso_bytes("mem_dso_pool");
+  for (std::unique_ptr<SharedFile<E>> &file : ctx.dso_pool)
+    dso_bytes += sizeof(SharedFile<E>) + vector_bytes(file->symbols) +
+                 vector_bytes(file->globals) + vector_bytes(file->elf_syms) +
+                 vector_bytes(file->version_strings);
+
+  static Counter symbol_map_bytes("mem_symbol_map");
+  symbol_map_bytes += ctx.symbol_map.get_memory_usage();
+
+  static Counter merged_bytes("mem_merged_sections");
+  for (std::unique_ptr<MergedSection<E>> &sec : ctx.merged_sections)
+    merged_bytes += sec->get_memory_usage();
+
+  static Counter output_bytes("mem_output_buffer");
+  if (ctx.output_file)
+    output_bytes += ctx.output_file->filesize;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  static Counter peak_rss("peak_rss_kb");
+  peak_rss += usage.ru_maxrss;
 }
 
 template <typename E>
@@ -260,7 +575,13 @@ static void show_stats(Context<E> &ctx) {
     static Counter undefined("undefined_syms");
     undefined += obj->symbols.size() - obj->first_global;
 
-    for (std::unique_ptr<InputSection<E>> &sec : obj->sections) {
+    static Histogram syms_per_file("symbols_per_file");
+    syms_per_file.add(obj->symbols.size());
+
+    static Histogram sections_per_file("sections_per_file");
+    sections_per_file.add(obj->sections.size());
+
+    for (InputSection<E> *sec : obj->sections) {
       if (!sec || !sec->is_alive)
         continue;
 
@@ -271,15 +592,21 @@ static void show_stats(Context<E> &ctx) {
         alloc += sec->get_rels(ctx).size();
       else
         nonalloc += sec->get_rels(ctx).size();
+
+      static Histogram section_size("input_section_size");
+      section_size.add(sec->shdr.sh_size);
+
+      static Histogram rels_per_section("relocs_per_section");
+      rels_per_section.add(sec->get_rels(ctx).size());
     }
 
     static Counter comdats("comdats");
     comdats += obj->comdat_groups.size();
 
     static Counter removed_comdats("removed_comdat_mem");
-    for (auto &pair : obj->comdat_groups)
-      if (ComdatGroup *group = pair.first; group->owner != obj->priority)
-        removed_comdats += pair.second.size();
+    for (ComdatGroupRef<E> &ref : obj->comdat_groups)
+      if (ref.group->owner != &ref)
+        removed_comdats += ref.members.size();
 
     static Counter num_cies("num_cies");
     num_cies += obj->cies.size();
@@ -305,18 +632,171 @@ static void show_stats(Context<E> &ctx) {
   static Counter num_objs("num_objs", ctx.objs.size());
   static Counter num_dsos("num_dsos", ctx.dsos.size());
 
-  Counter::print();
+  count_memory_usage(ctx);
+  print_stats(ctx.timer_records, ctx.arg.stats_format);
+}
+
+// Prints input files that took the most time to link for --perf=files.
+template <typename E>
+static void print_file_costs(Context<E> &ctx) {
+  std::vector<InputFile<E> *> files;
+  append(files, ctx.objs);
+  append(files, ctx.dsos);
+
+  auto get_cost = [](InputFile<E> *file) {
+    return file->parse_time + file->scan_time + file->copy_time;
+  };
+
+  std::stable_sort(files.begin(), files.end(),
+                   [&](InputFile<E> *a, InputFile<E> *b) {
+    return get_cost(a) > get_cost(b);
+  });
+
+  if (files.size() > 20)
+    files.resize(20);
+
+  std::cout << "\nParse(ms) Scan(ms) Copy(ms) Size(MB) Sections   Relocs"
+               "  Symbols  File\n";
+
+  for (InputFile<E> *file : files) {
+    i64 num_sections = file->elf_sections.size();
+    i64 num_rels = 0;
+    i64 num_syms = file->symbols.size();
+
+    if (!file->is_dso) {
+      ObjectFile<E> *obj = (ObjectFile<E> *)file;
+      for (InputSection<E> *isec : obj->sections)
+        if (isec && isec->is_alive)
+          num_rels += isec->get_rels(ctx).size();
+      num_syms -= obj->first_global;
+    }
+
+    std::ostringstream name;
+    name << *file;
+
+    printf(" % 8.3f % 8.3f % 8.3f % 8.3f % 8lld % 8lld % 8lld  %s\n",
+           (double)file->parse_time / 1000000,
+           (double)file->scan_time / 1000000,
+           (double)file->copy_time / 1000000,
+           (double)(file->mf ? file->mf->size : 0) / 1024 / 1024,
+           (long long)num_sections, (long long)num_rels, (long long)num_syms,
+           name.str().c_str());
+  }
 }
 
+// TBB's default parallelism already takes the process's CPU affinity
+// mask into account, so we use it as is. Memory allocated by mimalloc
+// comes from per-thread heaps and is first touched by the thread that
+// parses an input file, so per-file data tends to stay local to the
+// NUMA node that uses it.
 static i64 get_default_thread_count() {
-  // mold doesn't scale above 32 threads.
-  int n = tbb::global_control::active_value(
+  return tbb::global_control::active_value(
     tbb::global_control::max_allowed_parallelism);
-  return std::min(n, 32);
+}
+
+// Returns true if input files given as positional arguments are so
+// small that the fixed costs of starting worker threads and forking a
+// child process would dominate the link time. Libraries given by -l
+// are not counted, as they are usually shared objects of which we read
+// only the dynamic symbol tables.
+template <typename E>
+static bool is_small_link(Context<E> &ctx, std::span<std::string_view> args) {
+  static constexpr i64 MAX_FILES = 64;
+  static constexpr i64 MAX_BYTES = 4 * 1024 * 1024;
+
+  i64 num_files = 0;
+  i64 num_bytes = 0;
+
+  for (i64 i = 0; i < args.size(); i++) {
+    if (args[i].starts_with('-'))
+      continue;
+    if (i > 0 && (args[i - 1] == "-l" || args[i - 1] == "--version-script" ||
+                  args[i - 1] == "--dynamic-list"))
+      continue;
+
+    std::string path(args[i]);
+    if (!path.starts_with('/') && !ctx.arg.directory.empty())
+      path = ctx.arg.directory + "/" + path;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+      num_bytes += st.st_size;
+      if (++num_files > MAX_FILES || num_bytes > MAX_BYTES)
+        return false;
+    }
+  }
+  return true;
+}
+
+template <typename E>
+static int elf_main(int argc, char **argv,
+                    const std::vector<MemoryInput> *inputs = nullptr,
+                    std::vector<u8> *output = nullptr);
+
+// Handles `mold -batch FILE`. Each non-empty line of FILE is a command
+// line of one link job (excluding the program name), and lines starting
+// with `#` are ignored. This is for build systems that link many small
+// executables such as test binaries, so that they don't have to spawn
+// a linker process for each of them.
+//
+// A link mutates its input files and symbols as it proceeds, so each job
+// runs in a child process forked from this process. The parent never
+// starts TBB worker threads, so forking is safe, and each child can use
+// all threads. Jobs are linked one at a time.
+template <typename E>
+[[noreturn]]
+static void process_batch_subcommand(Context<E> &ctx, int argc, char **argv) {
+  if (argc != 3)
+    Fatal(ctx) << "-batch: usage: " << argv[0] << " -batch FILE";
+
+  MappedFile<Context<E>> *mf = MappedFile<Context<E>>::must_open(ctx, argv[2]);
+  std::string_view contents = mf->get_contents();
+  i64 num_failed = 0;
+
+  while (!contents.empty()) {
+    size_t pos = contents.find('\n');
+    std::string_view line = contents.substr(0, pos);
+    contents = (pos == contents.npos) ? "" : contents.substr(pos + 1);
+
+    std::vector<std::string> args;
+    std::istringstream ss{std::string(line)};
+    for (std::string arg; ss >> arg;)
+      args.push_back(arg);
+
+    if (args.empty() || args[0].starts_with('#'))
+      continue;
+
+    std::vector<char *> argv2;
+    argv2.push_back(argv[0]);
+    for (std::string &arg : args)
+      argv2.push_back(arg.data());
+    argv2.push_back(nullptr);
+
+    std::cout << std::flush;
+    std::cerr << std::flush;
+
+    pid_t pid = fork();
+    if (pid == -1)
+      Fatal(ctx) << "-batch: fork failed: " << errno_string();
+
+    if (pid == 0)
+      _exit(elf_main<X86_64>(argv2.size() - 1, argv2.data()));
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      SyncOut(ctx, std::cerr) << "mold: -batch: job failed: " << line;
+      num_failed++;
+    }
+  }
+
+  _exit(num_failed ? 1 : 0);
 }
 
 template <typename E>
-static int elf_main(int argc, char **argv) {
+static int elf_main(int argc, char **argv,
+                    const std::vector<MemoryInput> *inputs,
+                    std::vector<u8> *output) {
   Context<E> ctx;
 
   // Process -run option first. process_run_subcommand() does not return.
@@ -324,6 +804,11 @@ static int elf_main(int argc, char **argv) {
     if (argv[1] == "-run"sv || argv[1] == "--run"sv)
       process_run_subcommand(ctx, argc, argv);
 
+  // Likewise, process_batch_subcommand() does not return.
+  if (argc >= 2)
+    if (argv[1] == "-batch"sv || argv[1] == "--batch"sv)
+      process_batch_subcommand(ctx, argc, argv);
+
   // Parse non-positional command line options
   ctx.cmdline_args = expand_response_files(ctx, argv);
   std::vector<std::string_view> file_args;
@@ -333,13 +818,26 @@ static int elf_main(int argc, char **argv) {
   if (ctx.arg.emulation != E::e_machine) {
     switch (ctx.arg.emulation) {
     case EM_386:
-      return elf_main<I386>(argc, argv);
+      return elf_main<I386>(argc, argv, inputs, output);
     case EM_AARCH64:
-      return elf_main<AARCH64>(argc, argv);
+      return elf_main<AARCH64>(argc, argv, inputs, output);
     }
     unreachable();
   }
 
+  // If we are called by link_in_memory(), we are running in the
+  // caller's process, so we must neither fork nor exit.
+  if (output) {
+    for (const MemoryInput &in : *inputs)
+      ctx.memory_inputs[in.name] = in.contents;
+    ctx.memory_output = output;
+    ctx.arg.fork = false;
+    ctx.arg.preload = false;
+    ctx.arg.quick_exit = false;
+    ctx.arg.link_cache.clear();
+    ctx.arg.skip_unchanged_output = false;
+  }
+
   Timer t_all(ctx, "all");
 
   if (ctx.arg.relocatable) {
@@ -347,21 +845,101 @@ static int elf_main(int argc, char **argv) {
     return 0;
   }
 
-  if (!ctx.arg.preload)
+  if (!ctx.arg.preload && !output)
     try_resume_daemon(ctx);
 
+  // With --perf-sweep, the thread count of each child is capped by
+  // that of the parent.
+  if (!ctx.arg.perf_sweep.empty())
+    ctx.arg.thread_count = *std::max_element(ctx.arg.perf_sweep.begin(),
+                                             ctx.arg.perf_sweep.end());
+
+  // Link small programs serially in this process unless the number of
+  // threads is given explicitly.
+  if (ctx.arg.thread_count == 0 && !ctx.arg.preload &&
+      is_small_link(ctx, file_args)) {
+    ctx.arg.thread_count = 1;
+    ctx.arg.fork = false;
+  }
+
   i64 thread_count = ctx.arg.thread_count;
   if (thread_count == 0)
     thread_count = get_default_thread_count();
-  tbb::global_control tbb_cont(tbb::global_control::max_allowed_parallelism,
-                               thread_count);
+  ThreadBudget thread_budget(thread_count,
+                             ctx.arg.jobserver && !ctx.arg.preload);
 
-  install_signal_handler();
+  if (!output)
+    install_signal_handler();
 
   if (!ctx.arg.directory.empty() && chdir(ctx.arg.directory.c_str()) == -1)
     Fatal(ctx) << "chdir failed: " << ctx.arg.directory
                << ": " << errno_string();
 
+  // Preload input files
+  std::function<void()> on_complete;
+  std::function<bool(std::function<void()>)> wait_for_client;
+  std::function<void(std::function<bool()>)> wait_for_speculative_client;
+
+  // The daemon forks a child for each client, and forking a process
+  // with running TBB worker threads is not safe. So the daemon reads
+  // files with a single thread, and the children use all threads.
+  std::unique_ptr<tbb::global_control> daemon_cont;
+
+  if (ctx.arg.preload) {
+    daemon_cont.reset(new tbb::global_control(
+      tbb::global_control::max_allowed_parallelism, 1));
+    daemonize(ctx, &wait_for_client, &wait_for_speculative_client,
+              &on_complete);
+  } else if (!ctx.arg.perf_sweep.empty()) {
+    // Likewise, --perf-sweep forks children after reading files.
+    daemon_cont.reset(new tbb::global_control(
+      tbb::global_control::max_allowed_parallelism, 1));
+  } else if (ctx.arg.fork) {
+    on_complete = fork_child();
+  }
+
+  // With --jobserver, take as many job slots as available. We do this
+  // at phase boundaries to pick up slots freed by other jobs.
+  thread_budget.update();
+
+  // Read input files
+  read_input_files(ctx, file_args);
+
+  if (!ctx.arg.perf_sweep.empty()) {
+    i64 n = fork_perf_sweep(ctx);
+    daemon_cont.reset();
+    daemon_cont.reset(new tbb::global_control(
+      tbb::global_control::max_allowed_parallelism, n));
+  }
+
+  // If --link-cache is given and we have linked the same inputs with
+  // the same command line before, reuse the previous output.
+  if (!ctx.arg.link_cache.empty() && !ctx.arg.preload &&
+      try_link_cache(ctx)) {
+    std::cout << std::flush;
+    std::cerr << std::flush;
+    if (on_complete)
+      on_complete();
+    return 0;
+  }
+
+  // If --skip-unchanged-output is given and the existing output was
+  // created from the same inputs, there's nothing to do.
+  if (ctx.arg.skip_unchanged_output && is_output_unchanged(ctx)) {
+    std::cout << std::flush;
+    std::cerr << std::flush;
+    if (on_complete)
+      on_complete();
+    return 0;
+  }
+
+  uniquify_dsos(ctx);
+
+  // Size the symbol table and the comdat group table. No symbol or
+  // comdat group may be inserted before this.
+  ctx.symbol_map.reserve(estimate_num_symbols(ctx));
+  ctx.comdat_groups.reserve(estimate_num_comdat_groups(ctx));
+
   // Handle --wrap options if any.
   for (std::string_view name : ctx.arg.wrap)
     intern(ctx, name)->wrap = true;
@@ -371,38 +949,38 @@ static int elf_main(int argc, char **argv) {
     for (std::string_view name : *ctx.arg.retain_symbols_file)
       intern(ctx, name)->write_to_symtab = true;
 
-  // Preload input files
-  std::function<void()> on_complete;
-  std::function<void()> wait_for_client;
-
-  if (ctx.arg.preload)
-    daemonize(ctx, &wait_for_client, &on_complete);
-  else if (ctx.arg.fork)
-    on_complete = fork_child();
-
   for (std::string_view arg : ctx.arg.trace_symbol)
     intern(ctx, arg)->traced = true;
 
   // Parse input files
-  read_input_files(ctx, file_args);
-
+  thread_budget.update();
+  parse_input_files(ctx);
+
+  // If we are a speculative process forked by the daemon, we compute
+  // the output layout before a client asks for it. The layout is valid
+  // as long as none of these files are updated.
+  bool speculative = false;
+  std::vector<MappedFile<Context<E>> *> speculated_files;
+
+  // The daemon outlives any number of links, so we give back memory
+  // used only while parsing files before waiting for clients. The
+  // daemon is single-threaded, so this releases all of it.
   if (ctx.arg.preload) {
-    wait_for_client();
-    if (!reload_input_files(ctx)) {
-      std::vector<char *> args(argv, argv + argc);
-      args.push_back((char *)"--no-preload");
-      return elf_main<E>(argc + 1, args.data());
-    }
-  }
-
-  {
-    Timer t(ctx, "register_subsections");
-    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-      file->register_subsections(ctx);
+    release_free_memory();
+    speculative = wait_for_client([&] {
+      reload_input_files(ctx);
+      release_free_memory();
     });
+    if (speculative) {
+      speculated_files = get_input_files(ctx);
+    } else {
+      daemon_cont.reset();
+      reload_input_files(ctx);
+    }
   }
 
-  // Uniquify shared object files by soname
+  // Uniquify shared object files by soname again because reloaded
+  // DSOs may have new sonames.
   {
     std::unordered_set<std::string_view> seen;
     erase(ctx.dsos, [&](SharedFile<E> *file) {
@@ -422,8 +1000,14 @@ static int elf_main(int argc, char **argv) {
 
   // Resolve symbols and fix the set of object files that are
   // included to the final output.
+  thread_budget.update();
   resolve_symbols(ctx);
 
+  // Register pieces of mergeable sections to merged sections. We do this
+  // after symbol resolution so that strings in archive members that are
+  // not pulled in don't take up space in merged sections.
+  register_subsections(ctx);
+
   // Remove redundant comdat sections (e.g. duplicate inline functions).
   eliminate_comdats(ctx);
 
@@ -439,6 +1023,10 @@ static int elf_main(int argc, char **argv) {
   // Set is_import and is_export bits for each symbol.
   compute_import_export(ctx);
 
+  // Build a relocation graph of input sections.
+  if (ctx.arg.gc_sections || ctx.arg.icf)
+    build_section_graph(ctx);
+
   // Garbage-collect unreachable sections.
   if (ctx.arg.gc_sections)
     gc_sections(ctx);
@@ -447,6 +1035,8 @@ static int elf_main(int argc, char **argv) {
   if (ctx.arg.icf)
     icf_sections(ctx);
 
+  ctx.section_graph.reset();
+
   // Compute sizes of sections containing mergeable strings.
   compute_merged_section_sizes(ctx);
 
@@ -460,6 +1050,7 @@ static int elf_main(int argc, char **argv) {
   // (e.g. `__bss_start`).
   ctx.internal_obj = create_internal_file(ctx);
   ctx.internal_obj->resolve_regular_symbols(ctx);
+  ctx.internal_obj->update_symbols(ctx);
   ctx.objs.push_back(ctx.internal_obj);
 
   // Beyond this point, no new files will be added to ctx.objs
@@ -484,10 +1075,41 @@ static int elf_main(int argc, char **argv) {
   // a special rule. Sort them.
   sort_init_fini(ctx);
 
+  // Handle --symbol-ordering-file or --call-graph-ordering-file.
+  // The former takes precedence if both are given.
+  if (!ctx.arg.symbol_ordering_file.empty())
+    sort_by_symbol_order(ctx);
+  else if (!ctx.arg.call_graph_ordering_file.empty())
+    sort_by_call_graph(ctx);
+
+  // Handle --data-ordering-file. Since this affects only data
+  // sections, it can be used with the function ordering options.
+  if (!ctx.arg.data_ordering_file.empty())
+    sort_by_data_order(ctx);
+
+  // With --optimize-bb-jumps, remove jumps to the immediately
+  // following basic block section. This has to be done after the
+  // order of input sections is fixed.
+  if constexpr (std::is_same_v<E, X86_64>)
+    if (ctx.arg.optimize_bb_jumps)
+      optimize_bb_jumps(ctx);
+
   // Compute sizes of output sections while assigning offsets
   // within an output section to input sections.
   compute_section_sizes(ctx);
 
+  // Inflate compressed debug sections in the background while we are
+  // working on the rest of the layout. With --memory-limit, they are
+  // inflated one by one at copy time instead to keep memory usage low.
+  tbb::task_group inflate_tg;
+  if (ctx.arg.memory_limit == 0)
+    inflate_tg.run([&] { inflate_nonalloc_sections(ctx); });
+
+  // With --emit-relocs, create a relocation section for each output
+  // section.
+  if (ctx.arg.emit_relocs)
+    create_reloc_sections(ctx);
+
   // Sort sections by section attributes so that we'll have to
   // create as few segments as possible.
   sort(ctx.chunks, [&](Chunk<E> *a, Chunk<E> *b) {
@@ -508,8 +1130,19 @@ static int elf_main(int argc, char **argv) {
 
   // Scan relocations to find symbols that need entries in .got, .plt,
   // .got.plt, .dynsym, .dynstr, etc.
+  thread_budget.update();
   scan_rels(ctx);
 
+  // Branch instructions on AArch64 can reach only ±128 MiB. Create
+  // thunks for branches whose destinations may be farther than that.
+  if constexpr (std::is_same_v<E, AARCH64>)
+    create_range_extension_thunks(ctx);
+
+  // If -z pack-relative-relocs is given, base relocations are written
+  // to .relr.dyn in a compact form.
+  if (ctx.relrdyn)
+    construct_relr(ctx);
+
   // Reserve a space for dynamic symbol strings in .dynstr and sort
   // .dynsym contents if necessary. Beyond this point, no symbol will
   // be added to .dynsym.
@@ -527,6 +1160,7 @@ static int elf_main(int argc, char **argv) {
     tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
       file->compute_symtab(ctx);
     });
+    ctx.strtab->construct(ctx);
   }
 
   // .eh_frame is a special section from the linker's point of view,
@@ -568,6 +1202,23 @@ static int elf_main(int argc, char **argv) {
   // Fix linker-synthesized symbol addresses.
   fix_synthetic_symbols(ctx);
 
+  // Passes below read contents of debug sections.
+  inflate_tg.wait();
+
+  // If --gdb-index is given, create .gdb_index from debug info. This
+  // has to be done before debug info sections are compressed.
+  if (ctx.arg.gdb_index) {
+    create_gdb_index(ctx);
+    filesize = set_osec_offsets(ctx);
+  }
+
+  // If --debug-names is given, merge .debug_names sections into one
+  // name index. This also has to be done before compression.
+  if (ctx.arg.debug_names) {
+    create_debug_names(ctx);
+    filesize = set_osec_offsets(ctx);
+  }
+
   // If --compress-debug-sections is given, compress .debug_* sections
   // using zlib.
   if (ctx.arg.compress_debug_sections != COMPRESS_NONE) {
@@ -575,6 +1226,14 @@ static int elf_main(int argc, char **argv) {
     filesize = set_osec_offsets(ctx);
   }
 
+  // If --separate-debug-file is given, move debug info sections to
+  // another file.
+  if (!ctx.arg.separate_debug_file.empty()) {
+    ctx.debug_file = std::make_unique<DebugFile<E>>();
+    ctx.debug_file->move_sections(ctx);
+    filesize = set_osec_offsets(ctx);
+  }
+
   // At this point, file layout is fixed.
 
   // Beyond this, you can assume that symbol addresses including their
@@ -590,36 +1249,61 @@ static int elf_main(int argc, char **argv) {
     }
   }
 
+  // Cache final symbol addresses for applying relocations.
+  {
+    Timer t(ctx, "compute_symbol_addrs");
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+      file->compute_symbol_addrs(ctx);
+    });
+  }
+
+  if (speculative) {
+    wait_for_speculative_client([&] {
+      Timer t(ctx, "check_speculated_files");
+      for (MappedFile<Context<E>> *mf : speculated_files)
+        if (is_updated(ctx, mf))
+          return true;
+      return false;
+    });
+    daemon_cont.reset();
+  }
+
   t_before_copy.stop();
 
   // Create an output file
+  thread_budget.update();
   ctx.output_file = OutputFile<E>::open(ctx, ctx.arg.output, filesize, 0777);
   ctx.buf = ctx.output_file->buf;
 
-  Timer t_copy(ctx, "copy");
+  if (ctx.debug_file)
+    ctx.debug_file->open(ctx);
 
-  // Copy input sections to the output file
-  {
-    Timer t(ctx, "copy_buf");
+  Timer t_copy(ctx, "copy");
 
-    tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
-      std::string name(chunk->name);
-      if (name.empty())
-        name = "(header)";
-      Timer t2(ctx, name, &t);
+  // Zero-clear paddings between sections
+  clear_padding(ctx);
 
-      chunk->copy_buf(ctx);
-    });
+  // If --build-id is given, we hash the output file while copying
+  // chunks to it. See BuildIdSection for details.
+  if (ctx.buildid)
+    ctx.buildid->begin_hashing(ctx);
 
-    ctx.checkpoint();
-  }
+  // Copy input sections to the output file
+  copy_chunks(ctx);
+  ctx.checkpoint();
 
   // Dynamic linker works better with sorted .rela.dyn section,
   // so we sort them.
   ctx.reldyn->sort(ctx);
 
-  // Zero-clear paddings between sections
-  clear_padding(ctx);
+  // .gnu_debuglink contains the CRC32 of the debug info file, so it
+  // has to be written after the debug info file is complete.
+  if (ctx.debug_file) {
+    ctx.debug_file->write_headers(ctx);
+    ctx.gnu_debuglink->write_crc(ctx, ctx.debug_file->compute_crc(ctx));
+    if (ctx.buildid)
+      ctx.buildid->release(ctx, ctx.gnu_debuglink.get());
+  }
 
   if (ctx.buildid) {
     Timer t(ctx, "build_id");
@@ -628,12 +1312,29 @@ static int elf_main(int argc, char **argv) {
 
   t_copy.stop();
 
+  if (!ctx.arg.repro_file.empty())
+    write_repro_file(ctx);
+
   // Commit
+  if (ctx.debug_file)
+    ctx.debug_file->file->close(ctx);
   ctx.output_file->close(ctx);
 
+  // The rest is mostly serial, so let other jobs use our job slots.
+  thread_budget.release();
+
+  // Remove temporary files created by the LTO plugin
+  lto_cleanup(ctx);
+
+  if (!ctx.arg.link_cache.empty() && !ctx.input_digest.empty())
+    save_to_link_cache(ctx);
+
   t_total.stop();
   t_all.stop();
 
+  if (Progress::fd != -1)
+    Progress::write("done");
+
   if (ctx.arg.print_map)
     print_map(ctx);
 
@@ -642,15 +1343,34 @@ static int elf_main(int argc, char **argv) {
     show_stats(ctx);
 
   if (ctx.arg.perf)
-    print_timer_records(ctx.timer_records);
+    print_timer_records(ctx.timer_records, ctx.arg.perf_format);
+
+  if (ctx.perf_sweep_fd != -1) {
+    std::string buf = serialize_timer_records(ctx.timer_records);
+    for (i64 i = 0; i < buf.size();) {
+      i64 n = write(ctx.perf_sweep_fd, buf.data() + i, buf.size() - i);
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        Fatal(ctx) << "--perf-sweep: write failed: " << errno_string();
+      i += n;
+    }
+    close(ctx.perf_sweep_fd);
+  }
+
+  if (ctx.arg.perf_files)
+    print_file_costs(ctx);
 
   std::cout << std::flush;
   std::cerr << std::flush;
   if (on_complete)
     on_complete();
 
-  if (ctx.arg.quick_exit)
+  if (ctx.arg.quick_exit) {
+    if (!on_complete)
+      release_process_memory(ctx);
     _exit(0);
+  }
 
   for (std::function<void()> &fn : ctx.on_exit)
     fn();
@@ -661,6 +1381,23 @@ int main(int argc, char **argv) {
   return elf_main<X86_64>(argc, argv);
 }
 
+int link_in_memory(const std::vector<std::string> &args,
+                   const std::vector<MemoryInput> &inputs,
+                   std::vector<u8> &output) {
+  std::vector<std::string> args2 = args;
+  std::vector<char *> argv;
+  argv.push_back((char *)"mold");
+  for (std::string &arg : args2)
+    argv.push_back(arg.data());
+  argv.push_back(nullptr);
+  int ret = elf_main<X86_64>(argv.size() - 1, argv.data(), &inputs, &output);
+
+  // The caller may link many times in the same process, so we don't
+  // want to keep memory that was used only for this link.
+  release_free_memory();
+  return ret;
+}
+
 #define INSTANTIATE(E)                                                  \
   template void read_file(Context<E> &, MappedFile<Context<E>> *);
 
@@ -4,15 +4,11 @@
 #include <iomanip>
 #include <ios>
 #include <sstream>
-#include <tbb/parallel_for_each.h>
-#include <unordered_map>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
 
 namespace mold::elf {
 
-template <typename E>
-using Map =
-  tbb::concurrent_hash_map<InputSection<E> *, std::vector<Symbol<E> *>>;
-
 template <typename E>
 static std::unique_ptr<std::ofstream> open_output_file(Context<E> &ctx) {
   std::unique_ptr<std::ofstream> file(new std::ofstream);
@@ -22,83 +18,202 @@ static std::unique_ptr<std::ofstream> open_output_file(Context<E> &ctx) {
   return file;
 }
 
+// Returns all defined symbols sorted by their input sections and then
+// by their addresses, so that symbols of each input section form a
+// contiguous slice.
 template <typename E>
-static Map<E> get_map(Context<E> &ctx) {
-  Map<E> map;
+static std::vector<Symbol<E> *> get_symbols(Context<E> &ctx) {
+  std::vector<std::vector<Symbol<E> *>> vec(ctx.objs.size());
 
-  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
     for (Symbol<E> *sym : file->symbols) {
       if (sym->file == file && sym->input_section &&
           sym->get_type() != STT_SECTION) {
         assert(file == &sym->input_section->file);
-
-        typename Map<E>::accessor acc;
-        map.insert(acc, {sym->input_section, {}});
-        acc->second.push_back(sym);
+        vec[i].push_back(sym);
       }
     }
   });
 
-  tbb::parallel_for(map.range(), [](const typename Map<E>::range_type &range) {
-    for (auto it = range.begin(); it != range.end(); it++) {
-      std::vector<Symbol<E> *> &vec = it->second;
-      sort(vec, [](Symbol<E> *a, Symbol<E> *b) { return a->value < b->value; });
-    }
+  std::vector<Symbol<E> *> syms = flatten(vec);
+
+  tbb::parallel_sort(syms.begin(), syms.end(), [](Symbol<E> *a, Symbol<E> *b) {
+    return std::tuple(a->input_section->get_priority(), a->value) <
+           std::tuple(b->input_section->get_priority(), b->value);
   });
-  return map;
+  return syms;
 }
 
 template <typename E>
-void print_map(Context<E> &ctx) {
-  std::ostream *out = &std::cout;
-  std::unique_ptr<std::ofstream> file;
+static std::span<Symbol<E> *>
+get_section_symbols(std::span<Symbol<E> *> syms, InputSection<E> *isec) {
+  i64 priority = isec->get_priority();
 
-  if (!ctx.arg.Map.empty()) {
-    file = open_output_file(ctx);
-    out = file.get();
-  }
+  auto begin = std::partition_point(syms.begin(), syms.end(),
+                                    [&](Symbol<E> *sym) {
+    return sym->input_section->get_priority() < priority;
+  });
 
-  // Construct a section-to-symbol map.
-  Map<E> map = get_map(ctx);
+  auto end = std::partition_point(begin, syms.end(), [&](Symbol<E> *sym) {
+    return sym->input_section->get_priority() == priority;
+  });
+  return {begin, end};
+}
 
-  // Print a mapfile.
-  *out << "             VMA       Size Align Out     In      Symbol\n";
+// Formats members of an output section in parallel and writes them
+// to `out` in order. Members are formatted in fixed-size batches. We
+// keep only a bounded number of formatted batches in memory at once
+// and write them before formatting the next ones, so that memory
+// usage doesn't grow with the size of the output.
+template <typename E, typename Fn>
+static void write_members(Context<E> &ctx, std::ostream &out,
+                          std::span<InputSection<E> *> members, Fn fn) {
+  constexpr i64 batch_size = 1024;
+  constexpr i64 window_size = batch_size * 64;
+
+  for (i64 win = 0; win < members.size(); win += window_size) {
+    i64 win_end = std::min<i64>(win + window_size, members.size());
+    std::vector<std::string> bufs((win_end - win + batch_size - 1) /
+                                  batch_size);
+
+    tbb::parallel_for((i64)0, (i64)bufs.size(), [&](i64 i) {
+      i64 begin = win + i * batch_size;
+      i64 end = std::min(begin + batch_size, win_end);
+      std::ostringstream ss;
+      opt_demangle = ctx.arg.demangle;
+
+      for (i64 j = begin; j < end; j++)
+        fn(ss, j);
+      bufs[i] = std::move(ss.str());
+    });
+
+    for (std::string &str : bufs)
+      out << str;
+  }
+}
+
+template <typename E>
+static void print_text_map(Context<E> &ctx, std::ostream &out,
+                           std::span<Symbol<E> *> syms) {
+  out << "             VMA       Size Align Out     In      Symbol\n";
 
   for (Chunk<E> *osec : ctx.chunks) {
-    *out << std::setw(16) << (u64)osec->shdr.sh_addr
-         << std::setw(11) << (u64)osec->shdr.sh_size
-         << std::setw(6) << (u64)osec->shdr.sh_addralign
-         << " " << osec->name << "\n";
+    out << std::setw(16) << (u64)osec->shdr.sh_addr
+        << std::setw(11) << (u64)osec->shdr.sh_size
+        << std::setw(6) << (u64)osec->shdr.sh_addralign
+        << " " << osec->name << "\n";
 
     if (osec->kind != Chunk<E>::REGULAR)
       continue;
 
     std::span<InputSection<E> *> members = ((OutputSection<E> *)osec)->members;
-    std::vector<std::string> bufs(members.size());
 
-    tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+    write_members(ctx, out, members, [&](std::ostream &ss, i64 i) {
       InputSection<E> *mem = members[i];
-      std::ostringstream ss;
-      opt_demangle = ctx.arg.demangle;
 
       ss << std::setw(16) << (osec->shdr.sh_addr + mem->offset)
          << std::setw(11) << (u64)mem->shdr.sh_size
          << std::setw(6) << (u64)mem->shdr.sh_addralign
          << "         " << *mem << "\n";
 
-      typename Map<E>::const_accessor acc;
-      if (map.find(acc, mem))
-        for (Symbol<E> *sym : acc->second)
-          ss << std::setw(16) << sym->get_addr(ctx)
-             << "          0     0                 "
-             << *sym << "\n";
-
-      bufs[i] = std::move(ss.str());
+      for (Symbol<E> *sym : get_section_symbols<E>(syms, mem))
+        ss << std::setw(16) << sym->get_addr(ctx)
+           << "          0     0                 "
+           << *sym << "\n";
     });
+  }
+}
 
-    for (std::string &str : bufs)
-      *out << str;
+static void write_json_string(std::ostream &out, std::string_view str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if ((u8)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out << buf;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+// Writes the same information as the text map file as a JSON object
+// for size analysis tools. Symbol names are not demangled. Each input
+// section is written on its own line so that the output can be parsed
+// incrementally.
+template <typename E>
+static void print_json_map(Context<E> &ctx, std::ostream &out,
+                           std::span<Symbol<E> *> syms) {
+  out << "{\"output_sections\":[";
+  bool first = true;
+
+  for (Chunk<E> *osec : ctx.chunks) {
+    if (!first)
+      out << ",";
+    first = false;
+
+    out << "\n{\"name\":";
+    write_json_string(out, osec->name);
+    out << ",\"address\":" << (u64)osec->shdr.sh_addr
+        << ",\"size\":" << (u64)osec->shdr.sh_size
+        << ",\"align\":" << (u64)osec->shdr.sh_addralign
+        << ",\"input_sections\":[";
+
+    if (osec->kind == Chunk<E>::REGULAR) {
+      std::span<InputSection<E> *> members =
+        ((OutputSection<E> *)osec)->members;
+
+      write_members(ctx, out, members, [&](std::ostream &ss, i64 i) {
+        InputSection<E> *mem = members[i];
+        std::ostringstream filename;
+        filename << mem->file;
+
+        ss << (i ? ",\n" : "\n") << "{\"file\":";
+        write_json_string(ss, filename.str());
+        ss << ",\"name\":";
+        write_json_string(ss, mem->name());
+        ss << ",\"address\":" << (osec->shdr.sh_addr + mem->offset)
+           << ",\"size\":" << (u64)mem->shdr.sh_size
+           << ",\"align\":" << (u64)mem->shdr.sh_addralign
+           << ",\"symbols\":[";
+
+        bool first_sym = true;
+        for (Symbol<E> *sym : get_section_symbols<E>(syms, mem)) {
+          if (!first_sym)
+            ss << ",";
+          first_sym = false;
+          ss << "{\"name\":";
+          write_json_string(ss, sym->name());
+          ss << ",\"address\":" << sym->get_addr(ctx) << "}";
+        }
+        ss << "]}";
+      });
+    }
+    out << "]}";
   }
+  out << "\n]}\n";
+}
+
+template <typename E>
+void print_map(Context<E> &ctx) {
+  std::ostream *out = &std::cout;
+  std::unique_ptr<std::ofstream> file;
+
+  if (!ctx.arg.Map.empty()) {
+    file = open_output_file(ctx);
+    out = file.get();
+  }
+
+  std::vector<Symbol<E> *> syms = get_symbols(ctx);
+
+  if (ctx.arg.print_map_json)
+    print_json_map<E>(ctx, *out, syms);
+  else
+    print_text_map<E>(ctx, *out, syms);
 }
 
 #define INSTANTIATE(E)                          \
@@ -17,6 +17,7 @@
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <tbb/concurrent_hash_map.h>
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/concurrent_vector.h>
@@ -43,6 +44,7 @@ namespace mold::elf {
 
 static constexpr i32 SECTOR_SIZE = 512;
 static constexpr i32 COMMON_PAGE_SIZE = 4096;
+static constexpr i32 HUGE_PAGE_SIZE = 2 * 1024 * 1024;
 static constexpr i32 SHA256_SIZE = 32;
 
 template <typename E> class InputFile;
@@ -53,6 +55,7 @@ template <typename E> class Chunk;
 template <typename E> class OutputSection;
 template <typename E> class SharedFile;
 template <typename E> class Symbol;
+template <typename E> class SymbolMap;
 template <typename E> struct CieRecord;
 template <typename E> struct Context;
 template <typename E> struct FdeRecord;
@@ -84,6 +87,10 @@ struct Subsection {
   u32 offset = -1;
   std::atomic_uint16_t alignment = 1;
   std::atomic_bool is_alive = false;
+
+  // True if this string is placed at the end of another string in the
+  // output section by tail merging.
+  bool is_tail_merged = false;
 };
 
 template <typename E>
@@ -106,6 +113,9 @@ struct SymbolAux {
   i32 plt_idx = -1;
   i32 pltgot_idx = -1;
   i32 dynsym_idx = -1;
+
+  // Output section index of a linker-synthesized symbol
+  i32 shndx = 0;
 };
 
 inline u64 hash_string(std::string_view str) {
@@ -225,6 +235,26 @@ struct FdeRecord {
   std::atomic_bool is_alive = true;
 };
 
+// A reference from a branch relocation to a range extension thunk
+// entry. See create_range_extension_thunks() in arch-aarch64.cc.
+struct RangeExtensionRef {
+  i32 thunk_idx = -1;
+  i32 sym_idx = -1;
+};
+
+// The kind of file we are creating. The values are row indices of
+// the relocation action tables in scan_relocations().
+enum OutputType : u8 { OUTPUT_DSO, OUTPUT_PIE, OUTPUT_PDE };
+
+template <typename E>
+inline OutputType get_output_type(Context<E> &ctx) {
+  if (ctx.arg.shared)
+    return OUTPUT_DSO;
+  if (ctx.arg.pie)
+    return OUTPUT_PIE;
+  return OUTPUT_PDE;
+}
+
 // InputSection represents a section in an input object file.
 template <typename E>
 class InputSection {
@@ -235,8 +265,11 @@ public:
 
   void scan_relocations(Context<E> &ctx);
   void write_to(Context<E> &ctx, u8 *buf);
+  void uncompress_to(Context<E> &ctx, u8 *buf);
+  bool is_kernel_copyable(Context<E> &ctx) const;
+  i64 get_file_offset() const;
   void apply_reloc_alloc(Context<E> &ctx, u8 *base);
-  void apply_reloc_nonalloc(Context<E> &ctx, u8 *base);
+  void apply_reloc_nonalloc(Context<E> &ctx, u8 *base, i64 begin, i64 end);
   inline void kill();
 
   inline std::string_view name() const {
@@ -248,16 +281,29 @@ public:
   inline i64 get_addend(const ElfRel<E> &rel) const;
   inline std::span<ElfRel<E>> get_rels(Context<E> &ctx) const;
   inline std::span<FdeRecord<E>> get_fdes() const;
+  inline bool is_relr_reloc(Context<E> &ctx, const ElfRel<E> &rel) const;
+  inline bool needs_dynrel(i64 i) const;
+  inline bool needs_baserel(i64 i) const;
+  inline i64 find_rel_subsection(i64 i) const;
 
   ObjectFile<E> &file;
   const ElfShdr<E> &shdr;
   OutputSection<E> *output_section = nullptr;
 
+  // If compress_type is not 0, `contents` is a compressed stream of
+  // ELFCOMPRESS_ZLIB or ELFCOMPRESS_ZSTD which is inflated on demand,
+  // and shdr.sh_size is the uncompressed size.
   std::string_view contents;
 
   std::unique_ptr<SubsectionRef<E>[]> rel_subsections;
-  BitVector needs_dynrel;
-  BitVector needs_baserel;
+  std::unique_ptr<RangeExtensionRef[]> range_extn;
+
+  // The outcome of dispatch() for each relocation, recorded by
+  // scan_relocations() so that apply_reloc_alloc() doesn't have to
+  // decide it again. Allocated only if at least one relocation in
+  // this section needs a dynamic relocation.
+  std::unique_ptr<u8[]> rel_actions;
+
   i32 fde_begin = -1;
   i32 fde_end = -1;
 
@@ -267,7 +313,18 @@ public:
   u32 offset = -1;
   u32 section_idx = -1;
   u32 relsec_idx = -1;
+
+  // The minimum alignment of this section in an output section. This
+  // is larger than shdr.sh_addralign if the section has to start at
+  // a cache line boundary.
+  u32 min_alignment = 1;
+
+  // Dynamic relocations are written to reldyn_offset, and R_RELATIVE
+  // relocations are written to baserel_offset in .rel.dyn.
+  u32 num_dynrel = 0;
+  u32 num_baserel = 0;
   u32 reldyn_offset = 0;
+  u32 baserel_offset = 0;
 
   // For COMDAT de-duplication and garbage collection
   std::atomic_bool is_alive = true;
@@ -275,23 +332,51 @@ public:
   // For garbage collection
   std::atomic_bool is_visited = false;
 
+  // An index in the section graph
+  u32 graph_idx = -1;
+
   // For ICF
   InputSection *leader = nullptr;
   u32 icf_idx = -1;
   bool icf_eligible = false;
   bool icf_leaf = false;
+  bool address_significant = false;
 
   bool is_ehframe = false;
+  u8 compress_type = 0;
+
+  // Set by optimize_bb_jumps() if a trailing jump to the next section
+  // has been removed. The last relocation is dropped if this is true.
+  bool trailing_jump_removed = false;
 
 private:
   typedef enum : u8 { NONE, ERROR, COPYREL, PLT, DYNREL, BASEREL } Action;
 
-  void uncompress_old_style(Context<E> &ctx);
-  void uncompress_new_style(Context<E> &ctx);
-  void do_uncompress(Context<E> &ctx, std::string_view data, u64 size);
+  // scan_relocations() selects one of these instantiations once per
+  // section, so that the output type is a compile-time constant in
+  // the per-relocation loop.
+  template <OutputType T> void do_scan_relocations(Context<E> &ctx);
 
-  void dispatch(Context<E> &ctx, Action table[3][4], i64 i,
-                const ElfRel<E> &rel, Symbol<E> &sym);
+  template <OutputType T>
+  void dispatch(Context<E> &ctx, const Action (&table)[3][4], i64 i,
+                const ElfRel<E> &rel, Symbol<E> &sym) {
+    Action action = table[T][get_sym_type(ctx, sym)];
+    if (action != NONE)
+      apply_action(ctx, action, i, rel, sym);
+  }
+
+  static i64 get_sym_type(Context<E> &ctx, Symbol<E> &sym) {
+    if (sym.is_absolute(ctx))
+      return 0;
+    if (!sym.is_imported)
+      return 1;
+    if (sym.get_type() != STT_FUNC)
+      return 2;
+    return 3;
+  }
+
+  void apply_action(Context<E> &ctx, Action action, i64 i,
+                    const ElfRel<E> &rel, Symbol<E> &sym);
   void report_undef(Context<E> &ctx, Symbol<E> &sym);
 };
 
@@ -321,6 +406,8 @@ public:
   i64 shndx = 0;
   Kind kind;
   bool new_page = false;
+  bool new_huge_page = false;
+  bool new_page_in_memory = false;
   ElfShdr<E> shdr = {};
 
 protected:
@@ -380,6 +467,32 @@ public:
   void copy_buf(Context<E> &ctx) override;
 };
 
+// A range extension thunk is a small piece of code placed between
+// input sections. A branch instruction whose destination is too far
+// away jumps to a thunk entry instead, which then jumps to the
+// destination using a register.
+template <typename E>
+class RangeExtensionThunk {
+public:
+  RangeExtensionThunk(OutputSection<E> &osec) : output_section(osec) {}
+
+  i64 size() const { return targets.size() * ENTRY_SIZE; }
+
+  u64 get_addr(i64 idx) const {
+    return output_section.shdr.sh_addr + offset + idx * ENTRY_SIZE;
+  }
+
+  void write_to(Context<E> &ctx, u8 *buf);
+
+  static constexpr i64 ENTRY_SIZE = 12;
+
+  OutputSection<E> &output_section;
+  i64 offset = -1;
+
+  // Branch destinations as symbol and addend pairs
+  std::vector<std::pair<Symbol<E> *, i64>> targets;
+};
+
 // Sections
 template <typename E>
 class OutputSection : public Chunk<E> {
@@ -389,14 +502,66 @@ public:
 
   void copy_buf(Context<E> &ctx) override;
   void write_to(Context<E> &ctx, u8 *buf) override;
+  void write_range(Context<E> &ctx, u8 *buf, i64 offset, i64 size);
+  void write_members(Context<E> &ctx, u8 *buf, i64 begin, i64 end);
+  void construct_relr(Context<E> &ctx);
 
   std::vector<InputSection<E> *> members;
+  std::vector<std::unique_ptr<RangeExtensionThunk<E>>> thunks;
+  std::vector<typename E::WordTy> relr;
   u32 idx;
 
 private:
   OutputSection(std::string_view name, u32 type, u64 flags, u32 idx);
 };
 
+// OutputSectionMap is a cache for OutputSection::get_instance(), which
+// is called for every input section. It is an open-addressing hash
+// table of output sections. A slot is set only once, so lookups are
+// lock-free. New output sections are created under a mutex, which
+// happens only a few dozen times per link.
+template <typename E>
+class OutputSectionMap {
+public:
+  static constexpr i64 NBUCKETS = 1 << 14;
+
+  template <typename Fn>
+  OutputSection<E> *get(std::string_view name, u64 type, u64 flags,
+                        Fn create) {
+    u64 hash = hash_string(name) ^ (type << 48) ^ (flags * 0x9e3779b97f4a7c15);
+
+    for (i64 i = 0; i < NBUCKETS; i++) {
+      std::atomic<OutputSection<E> *> &slot =
+        slots[(hash + i) & (NBUCKETS - 1)];
+      OutputSection<E> *osec = slot.load(std::memory_order_acquire);
+
+      if (!osec) {
+        std::scoped_lock lock(mu);
+        osec = slot.load(std::memory_order_relaxed);
+        if (!osec) {
+          osec = create();
+          slot.store(osec, std::memory_order_release);
+          return osec;
+        }
+      }
+
+      if (osec->name == name && osec->shdr.sh_type == type &&
+          osec->shdr.sh_flags == flags)
+        return osec;
+    }
+
+    // The table is full (e.g. because of --unique). All output
+    // sections are created with `mu` held, so we can fall back to
+    // creating one under the lock.
+    std::scoped_lock lock(mu);
+    return create();
+  }
+
+private:
+  std::array<std::atomic<OutputSection<E> *>, NBUCKETS> slots;
+  std::mutex mu;
+};
+
 template <typename E>
 class GotSection : public Chunk<E> {
 public:
@@ -407,21 +572,20 @@ public:
     this->shdr.sh_addralign = E::wordsize;
   }
 
-  void add_got_symbol(Context<E> &ctx, Symbol<E> *sym);
-  void add_gottp_symbol(Context<E> &ctx, Symbol<E> *sym);
-  void add_tlsgd_symbol(Context<E> &ctx, Symbol<E> *sym);
-  void add_tlsdesc_symbol(Context<E> &ctx, Symbol<E> *sym);
-  void add_tlsld(Context<E> &ctx);
-
   u64 get_tlsld_addr(Context<E> &ctx) const;
-  i64 get_reldyn_size(Context<E> &ctx) const;
+  i64 get_num_baserel(Context<E> &ctx) const;
+  i64 get_num_dynrel(Context<E> &ctx) const;
   void copy_buf(Context<E> &ctx) override;
+  void construct_relr(Context<E> &ctx);
 
   std::vector<Symbol<E> *> got_syms;
   std::vector<Symbol<E> *> gottp_syms;
   std::vector<Symbol<E> *> tlsgd_syms;
   std::vector<Symbol<E> *> tlsdesc_syms;
+  std::vector<typename E::WordTy> relr;
   u32 tlsld_idx = -1;
+  u64 reldyn_offset = 0;
+  u64 baserel_offset = 0;
 };
 
 template <typename E>
@@ -447,7 +611,6 @@ public:
     this->shdr.sh_addralign = E::plt_hdr_size;
   }
 
-  void add_symbol(Context<E> &ctx, Symbol<E> *sym);
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> symbols;
@@ -463,7 +626,6 @@ public:
     this->shdr.sh_addralign = E::pltgot_size;
   }
 
-  void add_symbol(Context<E> &ctx, Symbol<E> *sym);
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> symbols;
@@ -500,6 +662,25 @@ public:
   void sort(Context<E> &ctx);
 
   i64 relcount = 0;
+  i64 copyrel_offset = 0;
+};
+
+// .relr.dyn contains R_RELATIVE relocations in a compact form. An
+// even entry is an address to relocate, and an odd entry is a bitmap
+// telling which of the following words are to be relocated.
+template <typename E>
+class RelrDynSection : public Chunk<E> {
+public:
+  RelrDynSection() : Chunk<E>(this->SYNTHETIC) {
+    this->name = ".relr.dyn";
+    this->shdr.sh_type = SHT_RELR;
+    this->shdr.sh_flags = SHF_ALLOC;
+    this->shdr.sh_entsize = E::wordsize;
+    this->shdr.sh_addralign = E::wordsize;
+  }
+
+  void update_shdr(Context<E> &ctx) override;
+  void copy_buf(Context<E> &ctx) override;
 };
 
 template <typename E>
@@ -511,7 +692,7 @@ public:
     this->shdr.sh_size = 1;
   }
 
-  void update_shdr(Context<E> &ctx) override;
+  void construct(Context<E> &ctx);
 };
 
 template <typename E>
@@ -540,8 +721,6 @@ public:
   i64 find_string(std::string_view str);
   void copy_buf(Context<E> &ctx) override;
 
-  i64 dynsym_offset = -1;
-
 private:
   std::unordered_map<std::string_view, i64> strings;
 };
@@ -575,6 +754,24 @@ public:
   void copy_buf(Context<E> &ctx) override;
 };
 
+// With --emit-relocs, a relocation section is created for each
+// allocated output section to keep relocations of its input sections
+// in the output file, so that post-link optimizers such as BOLT can
+// rewrite the output. See relocatable.cc.
+template <typename E>
+class RelocSection : public Chunk<E> {
+public:
+  RelocSection(Context<E> &ctx, OutputSection<E> &osec);
+  void update_shdr(Context<E> &ctx) override;
+  void copy_buf(Context<E> &ctx) override;
+
+private:
+  OutputSection<E> &output_section;
+
+  // Indices of the first relocations of input sections
+  std::vector<i64> offsets;
+};
+
 template <typename E>
 class DynsymSection : public Chunk<E> {
 public:
@@ -592,6 +789,9 @@ public:
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> symbols{1};
+
+  // .dynstr offsets of symbol names, indexed by dynsym index
+  std::vector<u32> name_offsets;
 };
 
 template <typename E>
@@ -629,6 +829,9 @@ public:
 
   u32 num_buckets = -1;
   u32 num_bloom = 1;
+
+  // Hash values of global dynamic symbols in the .dynsym order
+  std::vector<u32> hashes;
 };
 
 template <typename E>
@@ -638,17 +841,37 @@ public:
   get_instance(Context<E> &ctx, std::string_view name, u64 type, u64 flags);
 
   Subsection<E> *insert(std::string_view data, u64 hash, i64 alignment);
+  void insert(std::span<std::string_view> data, std::span<u64> hashes,
+              i64 alignment, std::vector<Subsection<E> *> &out);
+  void grow();
   void assign_offsets(Context<E> &ctx);
   void copy_buf(Context<E> &ctx) override;
   void write_to(Context<E> &ctx, u8 *buf) override;
+  i64 get_memory_usage() const { return map.get_memory_usage(); }
+
+  std::string_view get_contents(Subsection<E> *subsec) const {
+    i64 idx = subsec - map.values;
+    return {map.keys[idx], map.sizes[idx]};
+  }
 
   HyperLogLog estimator;
+  std::atomic_bool has_non_strings = false;
+  std::atomic_bool is_full = false;
 
 private:
+  struct TailMerged {
+    Subsection<E> *subsec;
+    Subsection<E> *host;
+    i64 offset;
+  };
+
   MergedSection(std::string_view name, u64 flags, u32 type);
+  void init_map();
+  void tail_merge(Context<E> &ctx);
 
   ConcurrentMap<Subsection<E>> map;
   std::vector<i64> shard_offsets;
+  std::vector<TailMerged> tail_merged;
   std::once_flag once_flag;
 };
 
@@ -765,9 +988,22 @@ public:
 
   void update_shdr(Context<E> &ctx) override;
   void copy_buf(Context<E> &ctx) override;
+  void begin_hashing(Context<E> &ctx);
+  void release(Context<E> &ctx, Chunk<E> *chunk);
   void write_buildid(Context<E> &ctx);
 
   static constexpr i64 HEADER_SIZE = 16;
+  static constexpr i64 SHARD_SIZE = 4096 * 1024;
+
+private:
+  i64 get_digest_size(Context<E> &ctx);
+  void hash(Context<E> &ctx, u8 *buf, i64 size, u8 *digest);
+  void hash_shard(Context<E> &ctx, i64 idx);
+  void compute_hash(Context<E> &ctx, i64 offset);
+
+  i64 num_shards = 0;
+  std::vector<u8> shard_hashes;
+  std::unique_ptr<std::atomic_int32_t[]> num_pending;
 };
 
 template <typename E>
@@ -791,10 +1027,11 @@ class GabiCompressedSection : public Chunk<E> {
 public:
   GabiCompressedSection(Context<E> &ctx, Chunk<E> &chunk);
   void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
 
 private:
   ElfChdr<E> chdr = {};
-  std::unique_ptr<ZlibCompressor> contents;
+  std::unique_ptr<Compressor> contents;
 };
 
 template <typename E>
@@ -802,6 +1039,7 @@ class GnuCompressedSection : public Chunk<E> {
 public:
   GnuCompressedSection(Context<E> &ctx, Chunk<E> &chunk);
   void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
 
 private:
   static constexpr i64 HEADER_SIZE = 12;
@@ -824,6 +1062,159 @@ private:
   std::unique_ptr<GzipCompressor> contents;
 };
 
+// .mold.input-digest contains a digest of the command line and input
+// files for --skip-unchanged-output.
+template <typename E>
+class InputDigestSection : public Chunk<E> {
+public:
+  InputDigestSection() : Chunk<E>(this->SYNTHETIC) {
+    this->name = ".mold.input-digest";
+    this->shdr.sh_type = SHT_PROGBITS;
+    this->shdr.sh_size = SHA256_SIZE * 2;
+  }
+
+  void copy_buf(Context<E> &ctx) override;
+};
+
+// .gnu_debuglink contains the name of a separate debug info file and
+// its CRC32 for --separate-debug-file.
+template <typename E>
+class GnuDebuglinkSection : public Chunk<E> {
+public:
+  GnuDebuglinkSection() : Chunk<E>(this->SYNTHETIC) {
+    this->name = ".gnu_debuglink";
+    this->shdr.sh_type = SHT_PROGBITS;
+    this->shdr.sh_addralign = 4;
+  }
+
+  void update_shdr(Context<E> &ctx) override;
+  void copy_buf(Context<E> &ctx) override;
+  void write_crc(Context<E> &ctx, u32 crc);
+};
+
+// .gdb_index is an index of debug info for gdb. It consists of a list
+// of compilation units, their address ranges and a hash table mapping
+// public names to compilation units. See gdb-index.cc for details.
+template <typename E>
+class GdbIndexSection : public Chunk<E> {
+public:
+  GdbIndexSection() : Chunk<E>(this->SYNTHETIC) {
+    this->name = ".gdb_index";
+    this->shdr.sh_type = SHT_PROGBITS;
+    this->shdr.sh_addralign = 4;
+  }
+
+  void construct(Context<E> &ctx);
+  void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
+
+private:
+  struct Compunit {
+    u64 offset = 0;
+    u64 size = 0;
+    std::vector<std::pair<u64, u64>> ranges;
+  };
+
+  struct MapValue {
+    MapValue() = default;
+    MapValue(const MapValue &other) : gdb_hash(other.gdb_hash) {}
+
+    u32 gdb_hash = 0;
+    std::atomic_uint32_t num_attrs = 0;
+    std::atomic_uint32_t num_written = 0;
+    u32 name_offset = 0;
+    u32 attr_offset = 0;
+  };
+
+  struct NameEntry {
+    std::string_view name;
+    u32 attr = 0;
+    MapValue *value = nullptr;
+  };
+
+  std::vector<Compunit> compunits;
+  std::vector<std::vector<NameEntry>> names;
+  ConcurrentMap<MapValue> map;
+  std::vector<std::pair<std::string_view, MapValue *>> symbols;
+
+  i64 num_areas = 0;
+  i64 symtab_size = 0;
+  i64 symtab_offset = 0;
+  i64 pool_offset = 0;
+};
+
+// .debug_names is a DWARF 5 name index. Compilers emit one index per
+// compilation unit, and with --debug-names, we merge them into one.
+// See debug-names.cc for details.
+template <typename E>
+class DebugNamesSection : public Chunk<E> {
+public:
+  DebugNamesSection() : Chunk<E>(this->SYNTHETIC) {
+    this->name = ".debug_names";
+    this->shdr.sh_type = SHT_PROGBITS;
+    this->shdr.sh_addralign = 4;
+  }
+
+  bool construct(Context<E> &ctx, OutputSection<E> &osec);
+  void copy_buf(Context<E> &ctx) override;
+  void write_to(Context<E> &ctx, u8 *buf) override;
+
+private:
+  struct Abbrev {
+    auto operator<=>(const Abbrev &) const = default;
+
+    u64 tag = 0;
+    std::vector<std::pair<u64, u64>> attrs;
+  };
+
+  struct MapValue {
+    MapValue() = default;
+    MapValue(const MapValue &other)
+      : hash(other.hash), str_offset(other.str_offset) {}
+
+    u32 hash = 0;
+    u32 str_offset = 0;
+    u32 pool_offset = 0;
+    u32 size = 0;
+  };
+
+  struct NameRef {
+    std::string_view name;
+    u32 str_offset = 0;
+    u32 entry_offset = 0;
+    u32 size = 0;
+    u32 offset = 0;
+    MapValue *value = nullptr;
+  };
+
+  struct Unit {
+    InputSection<E> *isec = nullptr;
+    u8 *pool = nullptr;
+    std::unordered_map<u64, Abbrev> abbrevs;
+    std::unordered_map<u64, u32> codes;
+    std::vector<u32> cu_offsets;
+    std::vector<u32> tu_offsets;
+    i64 cu_base = 0;
+    i64 tu_base = 0;
+    std::vector<NameRef> names;
+  };
+
+  bool read_unit(Context<E> &ctx, Unit &unit, u8 *buf, u8 *begin, u8 *end,
+                 std::span<std::pair<u64, std::string_view>> strings);
+  i64 encode_entries(Context<E> &ctx, Unit &unit, NameRef &ref, u8 *buf);
+
+  std::vector<std::unique_ptr<u8[]>> bufs;
+  std::vector<Unit> units;
+  std::vector<u8> abbrev_table;
+  ConcurrentMap<MapValue> map;
+  std::vector<std::pair<std::string_view, MapValue *>> symbols;
+
+  i64 num_cus = 0;
+  i64 num_tus = 0;
+  i64 bucket_count = 0;
+  i64 pool_size = 0;
+};
+
 bool is_c_identifier(std::string_view name);
 
 template <typename E>
@@ -844,13 +1235,56 @@ std::vector<ElfPhdr<E>> create_phdr(Context<E> &ctx);
 // sections have the same signature, the linker picks up one and
 // discards the other by eliminating all sections that the other
 // comdat section refers to.
+template <typename E>
+struct ComdatGroupRef;
+
+template <typename E>
 struct ComdatGroup {
   ComdatGroup() = default;
-  ComdatGroup(const ComdatGroup &other)
-    : owner(other.owner.load()) {}
+  ComdatGroup(const ComdatGroup<E> &other) : owner(other.owner.load()) {}
+
+  // The member of the highest-priority file among those examined so
+  // far by eliminate_comdats().
+  std::atomic<ComdatGroupRef<E> *> owner = nullptr;
+};
+
+// A comdat section in an object file
+template <typename E>
+struct ComdatGroupRef {
+  ComdatGroup<E> *group;
+  ObjectFile<E> *file;
+  std::span<u32> members;
+};
+
+// ComdatGroupMap maps comdat group signatures to ComdatGroups. Like
+// SymbolMap, it is a lock-free ConcurrentMap sized beforehand with a
+// fallback to a lock-based map, because C++ programs can have hundreds
+// of thousands of distinct comdat groups, each of which is inserted by
+// many files.
+template <typename E>
+class ComdatGroupMap {
+public:
+  // This function must be called before any group is inserted.
+  void reserve(i64 ngroups) {
+    if (!fallback.empty() || map.nbuckets)
+      return;
+    map.resize(ngroups * 2);
+  }
+
+  ComdatGroup<E> *insert(std::string_view signature) {
+    if (ComdatGroup<E> *group =
+        map.insert(signature, hash_string(signature), {}).first)
+      return group;
 
-  // The file priority of the owner file of this comdat section.
-  std::atomic_uint32_t owner = -1;
+    static LockStats stats("comdat_groups_lock", false);
+    typename decltype(fallback)::const_accessor acc;
+    stats.measure([&] { fallback.insert(acc, {signature, {}}); });
+    return const_cast<ComdatGroup<E> *>(&acc->second);
+  }
+
+private:
+  ConcurrentMap<ComdatGroup<E>> map;
+  tbb::concurrent_hash_map<std::string_view, ComdatGroup<E>> fallback;
 };
 
 template <typename E>
@@ -891,6 +1325,12 @@ public:
   std::atomic_bool is_alive = false;
   std::string_view shstrtab;
 
+  // Time in nanoseconds spent for this file. Recorded only with
+  // --perf=files.
+  std::atomic<i64> parse_time = 0;
+  std::atomic<i64> scan_time = 0;
+  std::atomic<i64> copy_time = 0;
+
 protected:
   std::unique_ptr<Symbol<E>[]> local_syms;
 };
@@ -904,49 +1344,70 @@ public:
   static ObjectFile<E> *create(Context<E> &ctx, MappedFile<Context<E>> *mf,
                                std::string archive_name, bool is_in_lib);
 
+  static ObjectFile<E> *create_lto(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                                   std::string archive_name, bool is_in_lib);
+
   void parse(Context<E> &ctx);
   void register_subsections(Context<E> &ctx);
   void resolve_lazy_symbols(Context<E> &ctx);
   void resolve_regular_symbols(Context<E> &ctx);
+  void update_symbols(Context<E> &ctx);
   void mark_live_objects(Context<E> &ctx,
                          std::function<void(ObjectFile<E> *)> feeder);
   void resolve_common_symbols(Context<E> &ctx);
   void convert_undefined_weak_symbols(Context<E> &ctx);
-  void resolve_comdat_groups();
   void eliminate_duplicate_comdat_groups();
   void claim_unresolved_symbols(Context<E> &ctx);
+  void update_unresolved_symbols(Context<E> &ctx);
   void scan_relocations(Context<E> &ctx);
   void convert_common_symbols(Context<E> &ctx);
   void compute_symtab(Context<E> &ctx);
   void write_symtab(Context<E> &ctx);
+  void compute_output_sym_indices(Context<E> &ctx);
+  void inflate_nonalloc_sections(Context<E> &ctx);
 
   inline i64 get_shndx(const ElfSym<E> &esym);
   inline InputSection<E> *get_section(const ElfSym<E> &esym);
   inline std::span<Symbol<E> *> get_global_syms();
 
+  void compute_symbol_addrs(Context<E> &ctx);
+  inline u64 get_symbol_addr(Context<E> &ctx, i64 idx) const;
+
   std::string archive_name;
-  std::vector<std::unique_ptr<InputSection<E>>> sections;
+  std::vector<InputSection<E> *> sections;
   std::span<ElfSym<E>> elf_syms;
+  std::string_view symbol_strtab;
   i64 first_global = 0;
   const bool is_in_lib = false;
+  bool is_lto_obj = false;
   std::vector<CieRecord<E>> cies;
   std::vector<FdeRecord<E>> fdes;
   std::vector<const char *> symvers;
   std::vector<Subsection<E> *> subsections;
   std::vector<SubsectionRef<E>> sym_subsections;
-  std::vector<std::pair<ComdatGroup *, std::span<u32>>> comdat_groups;
+  std::vector<ComdatGroupRef<E>> comdat_groups;
+  const ElfShdr<E> *llvm_addrsig = nullptr;
+  std::atomic<i64> num_unwritten_sections = 0;
   bool exclude_libs = false;
   u32 features = 0;
 
-  u64 num_dynrel = 0;
-  u64 reldyn_offset = 0;
-
   u64 local_symtab_offset = 0;
   u64 global_symtab_offset = 0;
   u64 num_local_symtab = 0;
   u64 num_global_symtab = 0;
   u64 strtab_offset = 0;
   u64 strtab_size = 0;
+
+  // .strtab offsets of local symbols written to .symtab
+  std::vector<u32> local_strtab_offsets;
+
+  // With --emit-relocs, .symtab indices of symbols indexed by symbol
+  // index, or -1 if a symbol isn't written to .symtab
+  std::vector<i32> output_sym_indices;
+
+  // Final symbol addresses indexed by symbol index. See
+  // compute_symbol_addrs().
+  std::vector<u64> sym_addrs;
   u64 fde_idx = 0;
   u64 fde_offset = 0;
   u64 fde_size = 0;
@@ -954,9 +1415,13 @@ public:
 private:
   ObjectFile(Context<E> &ctx, MappedFile<Context<E>> *mf,
              std::string archive_name, bool is_in_lib);
+  ObjectFile(MappedFile<Context<E>> *mf, std::string archive_name,
+             bool is_in_lib);
 
+  void parse_sections(Context<E> &ctx);
   void initialize_sections(Context<E> &ctx);
   void initialize_symbols(Context<E> &ctx);
+  void initialize_local_symbols(Context<E> &ctx);
   void initialize_mergeable_sections(Context<E> &ctx);
   void initialize_ehframe_sections(Context<E> &ctx);
   u32 read_note_gnu_property(Context<E> &ctx, const ElfShdr<E> &shdr);
@@ -965,16 +1430,20 @@ private:
                        const ElfSym<E> &esym, i64 symidx);
   void merge_visibility(Context<E> &ctx, Symbol<E> &sym, u8 visibility);
 
-  std::pair<std::string_view, const ElfShdr<E> *>
+  std::tuple<std::string_view, const ElfShdr<E> *, u8>
   uncompress_contents(Context<E> &ctx, const ElfShdr<E> &shdr,
                       std::string_view name);
 
-  bool has_common_symbol;
+  bool has_common_symbol = false;
+  bool is_sections_parsed = false;
 
-  std::string_view symbol_strtab;
   const ElfShdr<E> *symtab_sec;
   std::span<u32> symtab_shndx_sec;
   std::vector<std::unique_ptr<MergeableSection<E>>> mergeable_sections;
+
+  // Input sections, decompressed section contents and section headers
+  // created for this file are allocated from this arena.
+  Arena arena;
 };
 
 // SharedFile represents an input .so file.
@@ -983,8 +1452,12 @@ class SharedFile : public InputFile<E> {
 public:
   static SharedFile<E> *create(Context<E> &ctx, MappedFile<Context<E>> *mf);
 
+  void read_soname(Context<E> &ctx);
   void parse(Context<E> &ctx);
-  void resolve_dso_symbols(Context<E> &ctx);
+  void register_lazy_symbols(Context<E> &ctx);
+  i64 load_lazy_symbols(Context<E> &ctx);
+  void resolve_dso_symbols(Context<E> &ctx, i64 begin = 0);
+  void update_symbols(Context<E> &ctx, i64 begin = 0);
   std::vector<Symbol<E> *> find_aliases(Symbol<E> *sym);
   bool is_readonly(Context<E> &ctx, Symbol<E> *sym);
 
@@ -993,14 +1466,25 @@ public:
   std::vector<Symbol<E> *> globals;
   std::vector<const ElfSym<E> *> elf_syms;
 
+  // If true, parse() interns only undefined symbols, and defined
+  // symbols are added later by register_lazy_symbols() and
+  // load_lazy_symbols().
+  bool is_lazy = false;
+
 private:
   SharedFile(Context<E> &ctx, MappedFile<Context<E>> *mf);
 
   std::string_view get_soname(Context<E> &ctx);
   void maybe_override_symbol(Symbol<E> &sym, const ElfSym<E> &esym);
   std::vector<std::string_view> read_verdef(Context<E> &ctx);
+  std::span<u16> get_versyms(Context<E> &ctx);
+  void add_symbol(Symbol<E> *sym, const ElfSym<E> &esym, u16 ver);
+  void sort_symbols();
 
+  // Indices of defined dynamic symbols that are not registered yet
+  std::vector<u32> lazy_syms;
   std::vector<u16> versyms;
+  std::vector<u32> sorted_syms;
   std::string_view symbol_strtab;
   const ElfShdr<E> *symtab_sec;
 };
@@ -1021,6 +1505,24 @@ void parse_version_script(Context<E> &ctx, std::string path);
 template <typename E>
 void parse_dynamic_list(Context<E> &ctx, std::string path);
 
+//
+// section-graph.cc
+//
+
+template <typename E>
+struct SectionGraph {
+  std::span<u32> get_edges(i64 i) {
+    return {edges.data() + edge_indices[i], edges.data() + edge_indices[i + 1]};
+  }
+
+  std::vector<InputSection<E> *> sections;
+  std::vector<u32> edge_indices;
+  std::vector<u32> edges;
+};
+
+template <typename E>
+void build_section_graph(Context<E> &ctx);
+
 //
 // gc-sections.cc
 //
@@ -1028,6 +1530,27 @@ void parse_dynamic_list(Context<E> &ctx, std::string path);
 template <typename E>
 void gc_sections(Context<E> &ctx);
 
+//
+// call-graph-sort.cc
+//
+
+template <typename E>
+void sort_by_call_graph(Context<E> &ctx);
+
+//
+// gdb-index.cc
+//
+
+template <typename E>
+void create_gdb_index(Context<E> &ctx);
+
+//
+// debug-names.cc
+//
+
+template <typename E>
+void create_debug_names(Context<E> &ctx);
+
 //
 // icf.cc
 //
@@ -1042,6 +1565,9 @@ void icf_sections(Context<E> &ctx);
 template <typename E>
 void combine_objects(Context<E> &ctx, std::span<std::string_view> file_args);
 
+template <typename E>
+void create_reloc_sections(Context<E> &ctx);
+
 //
 // mapfile.cc
 //
@@ -1053,29 +1579,45 @@ void print_map(Context<E> &ctx);
 // subprocess.cc
 //
 
-std::function<void()> fork_child();
+template <typename E>
+[[noreturn]]
+void process_run_subcommand(Context<E> &ctx, int argc, char **argv);
+
+//
+// link-cache.cc
+//
 
 template <typename E>
-void try_resume_daemon(Context<E> &ctx);
+bool try_link_cache(Context<E> &ctx);
 
 template <typename E>
-void daemonize(Context<E> &ctx, std::function<void()> *wait_for_client,
-               std::function<void()> *on_complete);
+void save_to_link_cache(Context<E> &ctx);
 
 template <typename E>
-[[noreturn]]
-void process_run_subcommand(Context<E> &ctx, int argc, char **argv);
+bool is_output_unchanged(Context<E> &ctx);
+
+//
+// parse-cache.cc
+//
+
+template <typename E>
+bool read_parse_cache(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                      std::span<std::unique_ptr<MergeableSection<E>>> secs);
+
+template <typename E>
+void write_parse_cache(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                       std::span<std::unique_ptr<MergeableSection<E>>> secs);
 
 //
 // commandline.cc
 //
 
-bool read_flag(std::span<std::string_view> &args, std::string name);
+bool read_flag(std::span<std::string_view> &args, std::string_view name);
 
 template <typename E>
 bool read_arg(Context<E> &ctx, std::span<std::string_view> &args,
               std::string_view &arg,
-              std::string name);
+              std::string_view name);
 
 template <typename E>
 std::string create_response_file(Context<E> &ctx);
@@ -1084,6 +1626,18 @@ template <typename E>
 void parse_nonpositional_args(Context<E> &ctx,
                               std::vector<std::string_view> &remaining);
 
+//
+// arch-aarch64.cc
+//
+
+void create_range_extension_thunks(Context<AARCH64> &ctx);
+
+//
+// arch-x86-64.cc
+//
+
+void optimize_bb_jumps(Context<X86_64> &ctx);
+
 //
 // passes.cc
 //
@@ -1092,6 +1646,7 @@ template <typename E> void apply_exclude_libs(Context<E> &);
 template <typename E> void create_synthetic_sections(Context<E> &);
 template <typename E> void set_file_priority(Context<E> &);
 template <typename E> void resolve_symbols(Context<E> &);
+template <typename E> void register_subsections(Context<E> &);
 template <typename E> void eliminate_comdats(Context<E> &);
 template <typename E> void convert_common_symbols(Context<E> &);
 template <typename E> void compute_merged_section_sizes(Context<E> &);
@@ -1099,11 +1654,17 @@ template <typename E> void bin_sections(Context<E> &);
 template <typename E> ObjectFile<E> *create_internal_file(Context<E> &);
 template <typename E> void check_duplicate_symbols(Context<E> &);
 template <typename E> void sort_init_fini(Context<E> &);
+template <typename E> void
+apply_section_order(Context<E> &,
+                    const std::unordered_map<InputSection<E> *, i64> &);
+template <typename E> void sort_by_symbol_order(Context<E> &);
+template <typename E> void sort_by_data_order(Context<E> &);
 template <typename E> std::vector<Chunk<E> *>
 collect_output_sections(Context<E> &);
 template <typename E> void compute_section_sizes(Context<E> &);
 template <typename E> void claim_unresolved_symbols(Context<E> &);
 template <typename E> void scan_rels(Context<E> &);
+template <typename E> void construct_relr(Context<E> &);
 template <typename E> void apply_version_script(Context<E> &);
 template <typename E> void parse_symbol_version(Context<E> &);
 template <typename E> void compute_import_export(Context<E> &);
@@ -1111,7 +1672,28 @@ template <typename E> void clear_padding(Context<E> &);
 template <typename E> i64 get_section_rank(Context<E> &, Chunk<E> *chunk);
 template <typename E> i64 set_osec_offsets(Context<E> &);
 template <typename E> void fix_synthetic_symbols(Context<E> &);
+template <typename E> void inflate_nonalloc_sections(Context<E> &);
 template <typename E> void compress_debug_sections(Context<E> &);
+template <typename E> void copy_chunks(Context<E> &);
+template <typename E> TarFile create_repro_tar(Context<E> &);
+template <typename E> void write_repro_file(Context<E> &);
+
+//
+// lto.cc
+//
+
+template <typename E>
+bool is_gcc_lto_obj(Context<E> &ctx, MappedFile<Context<E>> *mf);
+
+template <typename E>
+ObjectFile<E> *read_lto_object(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                               std::string archive_name, bool is_in_lib);
+
+template <typename E>
+std::vector<ObjectFile<E> *> do_lto(Context<E> &ctx);
+
+template <typename E>
+void lto_cleanup(Context<E> &ctx);
 
 //
 // output-file.cc
@@ -1127,16 +1709,57 @@ public:
   virtual ~OutputFile() {}
 
   u8 *buf = nullptr;
+  i64 fd = -1;
   std::string path;
   i64 filesize;
   bool is_mmapped;
   bool is_unmapped = false;
 
+  // True if `buf` is known to be filled with zeros when opened, so
+  // that we don't have to zero-clear padding or all-zero sections.
+  bool is_zero_filled = false;
+
 protected:
   OutputFile(std::string path, i64 filesize, bool is_mmapped)
     : path(path), filesize(filesize), is_mmapped(is_mmapped) {}
 };
 
+//
+// separate-debug-file.cc
+//
+
+// DebugFile is a separate debug info file for --separate-debug-file.
+// Debug info sections are moved from the output file to this file and
+// written in the same parallel loop as the output file's sections.
+template <typename E>
+class DebugFile {
+public:
+  void move_sections(Context<E> &ctx);
+  void open(Context<E> &ctx);
+  void release(Context<E> &ctx, Chunk<E> *chunk);
+  void write_headers(Context<E> &ctx);
+  u32 compute_crc(Context<E> &ctx);
+
+  std::vector<Chunk<E> *> chunks;
+  std::unique_ptr<OutputFile<E>> file;
+
+  static constexpr i64 SHARD_SIZE = 4096 * 1024;
+
+private:
+  std::pair<i64, i64> get_shard_range(Chunk<E> *chunk);
+  i64 get_shard_size(i64 idx);
+  void release_shard(i64 idx);
+
+  std::vector<ElfShdr<E>> shdrs;
+  std::string shstrtab;
+  i64 shstrtab_offset = 0;
+  i64 shoff = 0;
+
+  i64 num_shards = 0;
+  std::vector<u32> shard_crcs;
+  std::unique_ptr<std::atomic_int32_t[]> num_pending;
+};
+
 //
 // main.cc
 //
@@ -1146,13 +1769,27 @@ struct BuildId {
   i64 size(Context<E> &ctx) const;
 
   enum { NONE, HEX, HASH, UUID } kind = NONE;
+  enum { SHA256, XXH3 } hash_func = SHA256;
   std::vector<u8> value;
   i64 hash_size = 0;
 };
 
-typedef enum { COMPRESS_NONE, COMPRESS_GABI, COMPRESS_GNU } CompressKind;
+typedef enum {
+  COMPRESS_NONE, COMPRESS_GABI, COMPRESS_GNU, COMPRESS_ZSTD,
+} CompressKind;
 typedef enum { ERROR, WARN, IGNORE } UnresolvedKind;
 
+struct CallGraphEdge {
+  std::string_view from;
+  std::string_view to;
+  u64 weight = 0;
+};
+
+struct DataOrderEntry {
+  std::string_view name;
+  bool write_hot = false;
+};
+
 struct VersionPattern {
   std::string_view pattern;
   i16 ver_idx;
@@ -1194,6 +1831,7 @@ struct Context {
   Context(const Context<E> &) = delete;
 
   void checkpoint() {
+    undef_out.flush();
     if (has_error) {
       cleanup();
       _exit(1);
@@ -1204,48 +1842,69 @@ struct Context {
   struct {
     BuildId build_id;
     CompressKind compress_debug_sections = COMPRESS_NONE;
+    PerfFormat perf_format = PERF_TEXT;
+    StatsFormat stats_format = STATS_TEXT;
     UnresolvedKind unresolved_symbols = UnresolvedKind::ERROR;
     bool Bsymbolic = false;
     bool Bsymbolic_functions = false;
     bool allow_multiple_definition = false;
+    bool copy_file_range = false;
+    bool debug_names = false;
     bool demangle = true;
     bool discard_all = false;
     bool discard_locals = false;
+    bool early_writeback = false;
     bool eh_frame_hdr = true;
+    bool emit_relocs = false;
     bool export_dynamic = false;
     bool fatal_warnings = false;
     bool fork = true;
     bool gc_sections = false;
-    bool hash_style_gnu = false;
-    bool hash_style_sysv = true;
+    bool gdb_index = false;
+    bool hash_style_gnu = true;
+    bool hash_style_sysv = false;
+    bool huge_pages = false;
     bool icf = false;
+    bool icf_all = false;
+    bool icf_data = false;
     bool is_static = false;
+    bool jobserver = false;
     bool omagic = false;
+    bool optimize_bb_jumps = false;
+    bool pack_dyn_relocs_relr = false;
     bool perf = false;
+    bool perf_files = false;
     bool pic = false;
     bool pie = false;
     bool preload = false;
     bool print_gc_sections = false;
     bool print_icf_sections = false;
     bool print_map = false;
+    bool print_map_json = false;
     bool quick_exit = true;
     bool relax = true;
     bool relocatable = false;
+    bool release_inputs = false;
     bool repro = false;
+    bool skip_unchanged_output = false;
     bool shared = false;
     bool stats = false;
     bool strip_all = false;
     bool strip_debug = false;
+    bool tail_merge_strings = false;
     bool trace = false;
+    bool update_in_place = false;
     bool warn_common = false;
     bool z_copyreloc = true;
     bool z_defs = false;
     bool z_delete = true;
     bool z_dlopen = true;
+    bool z_compact_relro = false;
     bool z_dump = true;
     bool z_execstack = false;
     bool z_initfirst = false;
     bool z_interpose = false;
+    bool z_hugepage_text = false;
     bool z_keep_text_section_prefix = false;
     bool z_now = false;
     bool z_origin = false;
@@ -1254,8 +1913,10 @@ struct Context {
     i16 default_version = VER_NDX_GLOBAL;
     i64 emulation = EM_X86_64;
     i64 filler = -1;
+    i64 memory_limit = 0;
     i64 spare_dynamic_tags = 5;
     i64 thread_count = 0;
+    i64 thinlto_jobs = 0;
     std::string Map;
     std::string chroot;
     std::string directory;
@@ -1263,22 +1924,35 @@ struct Context {
     std::string entry = "_start";
     std::string fini = "_fini";
     std::string init = "_init";
+    std::string link_cache;
     std::string output;
+    std::string parse_cache;
+    bool shm_parse_cache = false;
+    std::string plugin;
+    std::string repro_file;
     std::string rpaths;
+    std::string separate_debug_file;
     std::string soname;
     std::string sysroot;
+    std::string thinlto_cache_dir;
     std::unique_ptr<std::regex> unique;
     std::unique_ptr<std::unordered_set<std::string_view>> retain_symbols_file;
+    std::unordered_set<std::string_view> strip_debug_except;
     std::unordered_set<std::string_view> wrap;
+    std::vector<CallGraphEdge> call_graph_ordering_file;
+    std::vector<DataOrderEntry> data_ordering_file;
     std::vector<VersionPattern> version_patterns;
     std::vector<std::string> library_paths;
+    std::vector<std::string> plugin_opt;
     std::vector<std::string_view> auxiliary;
     std::vector<std::string_view> exclude_libs;
     std::vector<std::string_view> filter;
     std::vector<std::string_view> require_defined;
+    std::vector<std::string_view> symbol_ordering_file;
     std::vector<std::string_view> trace_symbol;
     std::vector<std::string_view> undefined;
     std::vector<std::string_view> version_definitions;
+    std::vector<i64> perf_sweep;
     u64 image_base = 0x200000;
   } arg;
 
@@ -1291,41 +1965,65 @@ struct Context {
   std::unordered_set<std::string_view> visited;
   tbb::task_group tg;
 
+  // Listings of library directories for -l. An entry is null if the
+  // directory couldn't be read.
+  std::vector<std::unique_ptr<std::unordered_set<std::string>>> library_dirs;
+
   bool has_error = false;
 
+  // Undefined symbol errors, which are reported from parallel loops
+  DeferredOut<Context<E>> undef_out{*this, std::cerr};
+
   // Symbol table
-  tbb::concurrent_hash_map<std::string_view, Symbol<E>> symbol_map;
-  tbb::concurrent_hash_map<std::string_view, ComdatGroup> comdat_groups;
+  SymbolMap<E> symbol_map;
+  ComdatGroupMap<E> comdat_groups;
   tbb::concurrent_vector<std::unique_ptr<MergedSection<E>>> merged_sections;
   tbb::concurrent_vector<std::unique_ptr<Chunk<E>>> output_chunks;
   std::vector<std::unique_ptr<OutputSection<E>>> output_sections;
+  std::vector<std::unique_ptr<RelocSection<E>>> reloc_sections;
+  OutputSectionMap<E> output_section_map;
   FileCache<E, ObjectFile<E>> obj_cache;
   FileCache<E, SharedFile<E>> dso_cache;
 
   tbb::concurrent_vector<std::unique_ptr<TimerRecord>> timer_records;
+
+  // With --perf-sweep, a pipe to send timer records to the parent
+  i64 perf_sweep_fd = -1;
   tbb::concurrent_vector<std::function<void()>> on_exit;
 
   tbb::concurrent_vector<std::unique_ptr<ObjectFile<E>>> obj_pool;
   tbb::concurrent_vector<std::unique_ptr<SharedFile<E>>> dso_pool;
   tbb::concurrent_vector<std::unique_ptr<u8[]>> string_pool;
-  tbb::concurrent_vector<std::unique_ptr<ElfShdr<E>>> shdr_pool;
   tbb::concurrent_vector<std::unique_ptr<MappedFile<Context<E>>>> mf_pool;
 
+  // Input files and an output buffer given by link_in_memory()
+  std::unordered_map<std::string, std::string_view> memory_inputs;
+  std::vector<u8> *memory_output = nullptr;
+
   // Symbol auxiliary data
   std::vector<SymbolAux> symbol_aux;
 
   // Fully-expanded command line args
   std::vector<std::string_view> cmdline_args;
 
+  // Digest of the command line and inputs for --link-cache and
+  // --skip-unchanged-output
+  std::string input_digest;
+
   // Input files
   std::vector<ObjectFile<E> *> objs;
   std::vector<SharedFile<E> *> dsos;
   ObjectFile<E> *internal_obj = nullptr;
 
+  // Relocation graph of input sections for -gc-sections and ICF
+  std::unique_ptr<SectionGraph<E>> section_graph;
+
   // Output buffer
   std::unique_ptr<OutputFile<E>> output_file;
   u8 *buf = nullptr;
 
+  MemoryBudget memory_budget;
+
   std::vector<Chunk<E> *> chunks;
   std::atomic_bool has_gottp_rel = false;
   std::atomic_bool has_textrel = false;
@@ -1339,6 +2037,7 @@ struct Context {
   std::unique_ptr<GotPltSection<E>> gotplt;
   std::unique_ptr<RelPltSection<E>> relplt;
   std::unique_ptr<RelDynSection<E>> reldyn;
+  std::unique_ptr<RelrDynSection<E>> relrdyn;
   std::unique_ptr<DynamicSection<E>> dynamic;
   std::unique_ptr<StrtabSection<E>> strtab;
   std::unique_ptr<DynstrSection<E>> dynstr;
@@ -1359,6 +2058,11 @@ struct Context {
   std::unique_ptr<BuildIdSection<E>> buildid;
   std::unique_ptr<NotePropertySection<E>> note_property;
   std::unique_ptr<ReproSection<E>> repro;
+  std::unique_ptr<InputDigestSection<E>> input_digest_section;
+  std::unique_ptr<GnuDebuglinkSection<E>> gnu_debuglink;
+  std::unique_ptr<DebugFile<E>> debug_file;
+  std::unique_ptr<GdbIndexSection<E>> gdb_index;
+  std::unique_ptr<DebugNamesSection<E>> debug_names;
 
   // For --relocatable
   std::vector<RChunk<E> *> r_chunks;
@@ -1432,8 +2136,10 @@ template <typename E>
 class Symbol {
 public:
   Symbol() = default;
-  Symbol(std::string_view name) : nameptr(name.data()), namelen(name.size()) {}
-  Symbol(const Symbol<E> &other) : Symbol(other.name()) {}
+  Symbol(std::string_view name, u64 name_hash = 0)
+    : nameptr(name.data()), name_hash(name_hash), namelen(name.size()) {}
+
+  Symbol(const Symbol<E> &other) : Symbol(other.name(), other.name_hash) {}
 
   u64 get_addr(Context<E> &ctx, bool allow_plt = true) const {
     if (Subsection<E> *subsec = get_subsec()) {
@@ -1671,35 +2377,51 @@ public:
     return {nameptr, (size_t)namelen};
   }
 
+  i32 get_shndx(Context<E> &ctx) const {
+    return (aux_idx == -1) ? 0 : ctx.symbol_aux[aux_idx].shndx;
+  }
+
+  // Pointer-sized members that symbol resolution and relocation
+  // scanning read for almost every symbol are packed into the first 32
+  // bytes, followed by the name and cold members. One-byte members are
+  // at the end so that the struct has no padding.
+
   // A symbol is owned by a file. If two or more files define the
   // same symbol, the one with the strongest definition owns the symbol.
   // If `file` is null, the symbol is equivalent to nonexistent.
   InputFile<E> *file = nullptr;
 
   InputSection<E> *input_section = nullptr;
-  const char *nameptr = nullptr;
-
   u64 value = -1;
 
   // Index into the symbol table of the owner file.
   i32 sym_idx = -1;
 
+  // The rank of the current definition. A lower value means a stronger
+  // definition. See get_rank() in object-file.cc.
+  std::atomic_uint32_t rank = 7 << 24;
+
+  const char *nameptr = nullptr;
+
+  // hash_string(name()) of an interned symbol, computed once when the
+  // symbol is created, so that later passes don't hash the name again.
+  // Zero for local symbols.
+  u64 name_hash = 0;
+
   i32 namelen = 0;
   i32 aux_idx = -1;
-  u16 shndx = 0;
   u16 ver_idx = 0;
 
   // `flags` has NEEDS_ flags.
   std::atomic_uint8_t flags = 0;
 
+  // Protects bits that are set by multiple threads after symbol
+  // resolution, such as `is_exported`.
   tbb::spin_mutex mu;
   std::atomic_uint8_t visibility = STV_DEFAULT;
 
   u8 is_lazy : 1 = false;
   u8 is_weak : 1 = false;
-  u8 write_to_symtab : 1 = false;
-  u8 traced : 1 = false;
-  u8 wrap : 1 = false;
   u8 has_copyrel : 1 = false;
   u8 copyrel_readonly : 1 = false;
 
@@ -1726,6 +2448,89 @@ public:
   // protected symbol (i.e. a symbol whose visibility is STV_PROTECTED).
   u8 is_imported : 1 = false;
   u8 is_exported : 1 = false;
+
+  u8 write_to_symtab : 1 = false;
+  u8 traced : 1 = false;
+  u8 wrap : 1 = false;
+
+  // True if a non-LTO file refers this symbol. Used to tell the LTO
+  // plugin which symbols must be kept after link-time optimization.
+  u8 referenced_by_regular_obj : 1 = false;
+};
+
+// Stats of `Symbol::mu`, which is shared by all symbols
+inline LockStats &symbol_lock_stats() {
+  static LockStats stats("symbol_lock");
+  return stats;
+}
+
+// SymbolMap is the global symbol table which maps symbol names to
+// Symbol objects.
+//
+// Most symbols are stored to a lock-free ConcurrentMap, so interning
+// a symbol doesn't take a lock. Since the map can't grow, we size it
+// beforehand with a HyperLogLog estimate of the number of distinct
+// symbol names in input files. Symbols that are interned before the
+// map is sized or that don't fit into the map go to a lock-based map.
+// Entries are never removed from the lock-free map, so once a key goes
+// to the lock-based map, it always goes there.
+template <typename E>
+class SymbolMap {
+public:
+  // This function must be called before any symbol is interned.
+  void reserve(i64 nsyms) {
+    if (!fallback.empty() || map.nbuckets)
+      return;
+
+    // We aim 1/2 occupation ratio
+    map.resize(nsyms * 2);
+  }
+
+  Symbol<E> *insert(std::string_view key, std::string_view name) {
+    // `key` differs from `name` only for versioned or wrapped symbols.
+    u64 hash = hash_string(key);
+    u64 name_hash = (key == name) ? hash : hash_string(name);
+
+    if (Symbol<E> *sym =
+        map.insert(key, hash, Symbol<E>(name, name_hash)).first)
+      return sym;
+
+    static Counter counter("symbol_map_fallback");
+    counter++;
+
+    static LockStats stats("symbol_map_fallback_lock", false);
+    typename decltype(fallback)::const_accessor acc;
+    stats.measure([&] {
+      fallback.insert(acc, {key, Symbol<E>(name, name_hash)});
+    });
+    return const_cast<Symbol<E> *>(&acc->second);
+  }
+
+  // Returns a symbol for a given key if it has already been interned.
+  // Unlike insert(), this function never adds a new entry, so it can
+  // be used to test if someone has referred to a given name.
+  Symbol<E> *find(std::string_view key) {
+    if (Symbol<E> *sym = map.find(key, hash_string(key)))
+      return sym;
+
+    typename decltype(fallback)::const_accessor acc;
+    if (fallback.find(acc, key))
+      return const_cast<Symbol<E> *>(&acc->second);
+    return nullptr;
+  }
+
+  // Returns an approximate number of bytes used by this map. Each entry
+  // of the fallback map costs a node with a few pointers in addition to
+  // the key and the value.
+  i64 get_memory_usage() const {
+    return map.get_memory_usage() +
+           fallback.size() * (sizeof(std::pair<std::string_view, Symbol<E>>) +
+                              sizeof(void *) * 2);
+  }
+
+private:
+  ConcurrentMap<Symbol<E>> map;
+  tbb::concurrent_hash_map<std::string_view, Symbol<E>> fallback;
 };
 
 // If we haven't seen the same `key` before, create a new instance
@@ -1734,9 +2539,7 @@ public:
 template <typename E>
 inline Symbol<E> *intern(Context<E> &ctx, std::string_view key,
                          std::string_view name) {
-  typename decltype(ctx.symbol_map)::const_accessor acc;
-  ctx.symbol_map.insert(acc, {key, Symbol<E>(name)});
-  return const_cast<Symbol<E> *>(&acc->second);
+  return ctx.symbol_map.insert(key, name);
 }
 
 template <typename E>
@@ -1784,6 +2587,37 @@ inline u64 InputSection<E>::get_addr() const {
   return output_section->shdr.sh_addr + offset;
 }
 
+// Returns true if a base relocation at `rel` should go to .relr.dyn
+// instead of .rel.dyn. .relr.dyn can only represent relocations at
+// word-aligned addresses.
+template <typename E>
+inline bool
+InputSection<E>::is_relr_reloc(Context<E> &ctx, const ElfRel<E> &rel) const {
+  return ctx.relrdyn && shdr.sh_addralign % E::wordsize == 0 &&
+         rel.r_offset % E::wordsize == 0;
+}
+
+template <typename E>
+inline bool InputSection<E>::needs_dynrel(i64 i) const {
+  return rel_actions && rel_actions[i] == DYNREL;
+}
+
+template <typename E>
+inline bool InputSection<E>::needs_baserel(i64 i) const {
+  return rel_actions && rel_actions[i] == BASEREL;
+}
+
+// Returns the index of the first rel_subsections entry whose
+// relocation index is not less than `i`.
+template <typename E>
+inline i64 InputSection<E>::find_rel_subsection(i64 i) const {
+  i64 j = 0;
+  if (rel_subsections)
+    while (rel_subsections[j].idx != -1 && rel_subsections[j].idx < i)
+      j++;
+  return j;
+}
+
 template <typename E>
 inline i64 InputSection<E>::get_priority() const {
   return ((i64)file.priority << 32) | section_idx;
@@ -1836,7 +2670,9 @@ template <typename E>
 inline std::span<ElfRel<E>> InputSection<E>::get_rels(Context<E> &ctx) const {
   if (relsec_idx == -1)
     return {};
-  return file.template get_data<ElfRel<E>>(ctx, file.elf_sections[relsec_idx]);
+  std::span<ElfRel<E>> rels =
+    file.template get_data<ElfRel<E>>(ctx, file.elf_sections[relsec_idx]);
+  return rels.first(rels.size() - trailing_jump_removed);
 }
 
 template <typename E>
@@ -1895,7 +2731,7 @@ inline i64 ObjectFile<E>::get_shndx(const ElfSym<E> &esym) {
 
 template <typename E>
 inline InputSection<E> *ObjectFile<E>::get_section(const ElfSym<E> &esym) {
-  return sections[get_shndx(esym)].get();
+  return sections[get_shndx(esym)];
 }
 
 template <typename E>
@@ -1903,6 +2739,13 @@ std::span<Symbol<E> *> ObjectFile<E>::get_global_syms() {
   return std::span<Symbol<E> *>(this->symbols).subspan(first_global);
 }
 
+template <typename E>
+u64 ObjectFile<E>::get_symbol_addr(Context<E> &ctx, i64 idx) const {
+  if (idx < sym_addrs.size() && sym_addrs[idx] != -1)
+    return sym_addrs[idx];
+  return this->symbols[idx]->get_addr(ctx);
+}
+
 inline u32 elf_hash(std::string_view name) {
   u32 h = 0;
   for (u8 c : name) {
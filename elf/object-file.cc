@@ -1,9 +1,11 @@
 #include "mold.h"
 
 #include <cstring>
+#include <numeric>
 #include <regex>
 #include <unistd.h>
 #include <zlib.h>
+#include <zstd.h>
 
 namespace mold::elf {
 
@@ -54,6 +56,18 @@ ObjectFile<E>::ObjectFile(Context<E> &ctx, MappedFile<Context<E>> *mf,
   this->is_alive = !is_in_lib;
 }
 
+// An LTO object file is not an ELF file but a compiler IR file, so
+// we don't read ELF headers here. Its symbol table is set up by
+// read_lto_object() from the symbols reported by the linker plugin.
+template <typename E>
+ObjectFile<E>::ObjectFile(MappedFile<Context<E>> *mf,
+                          std::string archive_name, bool is_in_lib)
+  : archive_name(archive_name), is_in_lib(is_in_lib), is_lto_obj(true) {
+  this->mf = mf;
+  this->filename = mf->name;
+  this->is_alive = !is_in_lib;
+}
+
 template <typename E>
 ObjectFile<E>::ObjectFile() {}
 
@@ -62,7 +76,16 @@ ObjectFile<E> *
 ObjectFile<E>::create(Context<E> &ctx, MappedFile<Context<E>> *mf,
                       std::string archive_name, bool is_in_lib) {
   ObjectFile<E> *obj = new ObjectFile<E>(ctx, mf, archive_name, is_in_lib);
-  ctx.obj_pool.push_back(std::unique_ptr<ObjectFile<E>>(obj));
+  push_to_pool(ctx.obj_pool, std::unique_ptr<ObjectFile<E>>(obj));
+  return obj;
+}
+
+template <typename E>
+ObjectFile<E> *
+ObjectFile<E>::create_lto(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                          std::string archive_name, bool is_in_lib) {
+  ObjectFile<E> *obj = new ObjectFile<E>(mf, archive_name, is_in_lib);
+  push_to_pool(ctx.obj_pool, std::unique_ptr<ObjectFile<E>>(obj));
   return obj;
 }
 
@@ -72,6 +95,22 @@ static bool is_debug_section(const ElfShdr<E> &shdr, std::string_view name) {
          (name.starts_with(".debug") || name.starts_with(".zdebug"));
 }
 
+// Returns true if a given debug section should be discarded. With
+// --strip-debug-except, only sections not listed are discarded.
+// A compressed .zdebug_* section matches its .debug_* name.
+template <typename E>
+static bool should_strip_debug(Context<E> &ctx, std::string_view name) {
+  if (ctx.arg.strip_all || ctx.arg.strip_debug)
+    return true;
+  if (ctx.arg.strip_debug_except.empty())
+    return false;
+
+  if (name.starts_with(".zdebug"))
+    return !ctx.arg.strip_debug_except.contains(
+      std::string(".") + std::string(name.substr(2)));
+  return !ctx.arg.strip_debug_except.contains(name);
+}
+
 template <typename E>
 u32 ObjectFile<E>::read_note_gnu_property(Context<E> &ctx,
                                           const ElfShdr<E> &shdr) {
@@ -104,29 +143,24 @@ u32 ObjectFile<E>::read_note_gnu_property(Context<E> &ctx,
 }
 
 template <typename E>
-std::pair<std::string_view, const ElfShdr<E> *>
+static bool can_defer_uncompress(const ElfShdr<E> &shdr, std::string_view name) {
+  if (shdr.sh_flags & (SHF_ALLOC | SHF_MERGE))
+    return false;
+  return !name.ends_with("_gnu_pubnames") && !name.ends_with("_gnu_pubtypes");
+}
+
+// Returns the compressed stream, a section header describing the
+// uncompressed contents and the compression type of a given section.
+// The compression type is 0 if the section is not compressed.
+template <typename E>
+std::tuple<std::string_view, const ElfShdr<E> *, u8>
 ObjectFile<E>::uncompress_contents(Context<E> &ctx, const ElfShdr<E> &shdr,
                                    std::string_view name) {
   if (shdr.sh_type == SHT_NOBITS)
-    return {{}, &shdr};
-
-  auto do_uncompress = [&](std::string_view data, u64 size) {
-    u8 *buf = new u8[size];
-    ctx.string_pool.push_back(std::unique_ptr<u8[]>(buf));
-
-    unsigned long size2 = size;
-    if (uncompress(buf, &size2, (u8 *)&data[0], data.size()) != Z_OK)
-      Fatal(ctx) << *this << ": " << name << ": uncompress failed";
-    if (size != size2)
-      Fatal(ctx) << *this << ": " << name << ": uncompress: invalid size";
-    return std::string_view((char *)buf, size);
-  };
+    return {{}, &shdr, 0};
 
   auto copy_shdr = [&](const ElfShdr<E> &shdr) {
-    ElfShdr<E> *ret = new ElfShdr<E>;
-    ctx.shdr_pool.push_back(std::unique_ptr<ElfShdr<E>>(ret));
-    *ret = shdr;
-    return ret;
+    return arena.create<ElfShdr<E>>(shdr);
   };
 
   if (name.starts_with(".zdebug")) {
@@ -134,12 +168,10 @@ ObjectFile<E>::uncompress_contents(Context<E> &ctx, const ElfShdr<E> &shdr,
     std::string_view data = this->get_string(ctx, shdr);
     if (!data.starts_with("ZLIB") || data.size() <= 12)
       Fatal(ctx) << *this << ": " << name << ": corrupted compressed section";
-    u64 size = *(ubig64 *)&data[4];
-    std::string_view contents = do_uncompress(data.substr(12), size);
 
     ElfShdr<E> *shdr2 = copy_shdr(shdr);
-    shdr2->sh_size = size;
-    return {contents, shdr2};
+    shdr2->sh_size = *(ubig64 *)&data[4];
+    return {data.substr(12), shdr2, ELFCOMPRESS_ZLIB};
   }
 
   if (shdr.sh_flags & SHF_COMPRESSED) {
@@ -148,21 +180,18 @@ ObjectFile<E>::uncompress_contents(Context<E> &ctx, const ElfShdr<E> &shdr,
     if (data.size() < sizeof(ElfChdr<E>))
       Fatal(ctx) << *this << ": " << name << ": corrupted compressed section";
     ElfChdr<E> &hdr = *(ElfChdr<E> *)&data[0];
-    data = data.substr(sizeof(ElfChdr<E>));
 
-    if (hdr.ch_type != ELFCOMPRESS_ZLIB)
+    if (hdr.ch_type != ELFCOMPRESS_ZLIB && hdr.ch_type != ELFCOMPRESS_ZSTD)
       Fatal(ctx) << *this << ": " << name << ": unsupported compression type";
 
     ElfShdr<E> *shdr2 = copy_shdr(shdr);
     shdr2->sh_flags &= ~(u64)(SHF_COMPRESSED);
     shdr2->sh_size = hdr.ch_size;
     shdr2->sh_addralign = hdr.ch_addralign;
-
-    std::string_view contents = do_uncompress(data, hdr.ch_size);
-    return {contents, shdr2};
+    return {data.substr(sizeof(ElfChdr<E>)), shdr2, (u8)hdr.ch_type};
   }
 
-  return {this->get_string(ctx, shdr), &shdr};
+  return {this->get_string(ctx, shdr), &shdr, 0};
 }
 
 template <typename E>
@@ -171,6 +200,16 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
   for (i64 i = 0; i < this->elf_sections.size(); i++) {
     const ElfShdr<E> &shdr = this->elf_sections[i];
 
+    // .llvm_addrsig is an SHF_EXCLUDE section, so it's not copied to
+    // the output, but we use it for --icf=safe. If a tool which doesn't
+    // know about the section has processed the file, sh_link is reset
+    // to 0, and symbol indices in the section are no longer reliable.
+    if (shdr.sh_type == SHT_LLVM_ADDRSIG) {
+      if (shdr.sh_link != 0)
+        llvm_addrsig = &shdr;
+      continue;
+    }
+
     if ((shdr.sh_flags & SHF_EXCLUDE) && !(shdr.sh_flags & SHF_ALLOC))
       continue;
 
@@ -192,10 +231,8 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
       if (entries[0] != GRP_COMDAT)
         Fatal(ctx) << *this << ": unsupported SHT_GROUP format";
 
-      typename decltype(ctx.comdat_groups)::const_accessor acc;
-      ctx.comdat_groups.insert(acc, {signature, ComdatGroup()});
-      ComdatGroup *group = const_cast<ComdatGroup *>(&acc->second);
-      comdat_groups.push_back({group, entries.subspan(1)});
+      ComdatGroup<E> *group = ctx.comdat_groups.insert(signature);
+      comdat_groups.push_back({group, this, entries.subspan(1)});
       break;
     }
     case SHT_SYMTAB_SHNDX:
@@ -217,17 +254,36 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
         continue;
       }
 
-      if ((ctx.arg.strip_all || ctx.arg.strip_debug) &&
-          is_debug_section(shdr, name))
+      if (is_debug_section(shdr, name) && should_strip_debug(ctx, name))
         continue;
 
-      std::string_view contents;
-      const ElfShdr<E> *shdr2;
-      std::tie(contents, shdr2) = uncompress_contents(ctx, shdr, name);
+      auto [contents, shdr2, compress_type] =
+        uncompress_contents(ctx, shdr, name);
+
+      // optimize_bb_jumps() may shrink an executable section, so give
+      // it a mutable copy of the section header.
+      if (ctx.arg.optimize_bb_jumps && (shdr.sh_flags & SHF_EXECINSTR) &&
+          shdr2 == &shdr)
+        shdr2 = arena.create<ElfShdr<E>>(shdr);
+
+      InputSection<E> *isec =
+        arena.create<InputSection<E>>(ctx, *this, *shdr2, name, contents, i);
+      isec->compress_type = compress_type;
+
+      // A compressed section is usually kept compressed until it is
+      // copied to the output file, so that we don't have to hold
+      // uncompressed contents of all debug sections in memory.
+      // Sections whose contents are read before that (e.g. mergeable
+      // sections, or pubnames which --gdb-index refers to) are
+      // inflated now.
+      if (compress_type && !can_defer_uncompress(*shdr2, name)) {
+        u8 *buf = (u8 *)arena.alloc(shdr2->sh_size);
+        isec->uncompress_to(ctx, buf);
+        isec->contents = {(char *)buf, (size_t)shdr2->sh_size};
+        isec->compress_type = 0;
+      }
 
-      this->sections[i] =
-        std::make_unique<InputSection<E>>(ctx, *this, *shdr2, name,
-                                          contents, i);
+      this->sections[i] = isec;
 
       static Counter counter("regular_sections");
       counter++;
@@ -246,15 +302,9 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
       Fatal(ctx) << *this << ": invalid relocated section index: "
                  << (u32)shdr.sh_info;
 
-    if (std::unique_ptr<InputSection<E>> &target = sections[shdr.sh_info]) {
+    if (InputSection<E> *target = sections[shdr.sh_info]) {
       assert(target->relsec_idx == -1);
       target->relsec_idx = i;
-
-      if (target->shdr.sh_flags & SHF_ALLOC) {
-        i64 size = shdr.sh_size / sizeof(ElfRel<E>);
-        target->needs_dynrel.resize(size);
-        target->needs_baserel.resize(size);
-      }
     }
   }
 }
@@ -262,7 +312,7 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
 template <typename E>
 void ObjectFile<E>::initialize_ehframe_sections(Context<E> &ctx) {
   for (i64 i = 0; i < sections.size(); i++) {
-    std::unique_ptr<InputSection<E>> &isec = sections[i];
+    InputSection<E> *isec = sections[i];
     if (isec && isec->is_alive && isec->name() == ".eh_frame") {
       read_ehframe(ctx, *isec);
       isec->is_ehframe = true;
@@ -438,14 +488,10 @@ static Symbol<E> *insert_symbol(Context<E> &ctx, const ElfSym<E> &esym,
 }
 
 template <typename E>
-void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
+void ObjectFile<E>::initialize_local_symbols(Context<E> &ctx) {
   if (!symtab_sec)
     return;
 
-  static Counter counter("all_syms");
-  counter += elf_syms.size();
-
-  // Initialize local symbols
   this->local_syms.reset(new Symbol<E>[first_global]);
   new (&this->local_syms[0]) Symbol<E>;
 
@@ -476,16 +522,24 @@ void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
     }
   }
 
+  for (i64 i = 0; i < first_global; i++)
+    this->symbols[i] = &this->local_syms[i];
+}
+
+template <typename E>
+void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
+  if (elf_syms.empty())
+    return;
+
+  static Counter counter("all_syms");
+  counter += elf_syms.size();
+
   this->symbols.resize(elf_syms.size());
 
   i64 num_globals = elf_syms.size() - first_global;
   sym_subsections.resize(elf_syms.size());
   symvers.resize(num_globals);
 
-  for (i64 i = 0; i < first_global; i++)
-    this->symbols[i] = &this->local_syms[i];
-
-  // Initialize global symbols
   for (i64 i = first_global; i < elf_syms.size(); i++) {
     const ElfSym<E> &esym = elf_syms[i];
 
@@ -512,17 +566,86 @@ void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
   }
 }
 
+// Returns the offset of the first zero word of type T in a given
+// string. We look for a block containing a zero word first, because a
+// loop without an early exit can be vectorized by the compiler. This
+// is inlined into each clone of the functions below, so that it is
+// vectorized for each instruction set.
+template <typename T>
+[[gnu::always_inline]] static inline size_t
+find_null_word(std::string_view data) {
+  constexpr i64 block_size = 64 / sizeof(T);
+  i64 n = data.size() / sizeof(T);
+  i64 i = 0;
+
+  for (; i + block_size <= n; i += block_size) {
+    T found = 0;
+    for (i64 j = 0; j < block_size; j++) {
+      T val;
+      memcpy(&val, data.data() + (i + j) * sizeof(T), sizeof(T));
+      found |= (val == 0);
+    }
+    if (found)
+      break;
+  }
+
+  for (; i < n; i++) {
+    T val;
+    memcpy(&val, data.data() + i * sizeof(T), sizeof(T));
+    if (val == 0)
+      return i * sizeof(T);
+  }
+  return data.npos;
+}
+
+MOLD_TARGET_CLONES
+static size_t find_null16(std::string_view data) {
+  return find_null_word<u16>(data);
+}
+
+MOLD_TARGET_CLONES
+static size_t find_null32(std::string_view data) {
+  return find_null_word<u32>(data);
+}
+
+// Returns the offset of the first null character in a given string.
+// For entsize > 1 (e.g. UTF-16 or UTF-32 strings), a null character is
+// an entsize-aligned run of zero bytes.
 static size_t find_null(std::string_view data, u64 entsize) {
+  // For single-byte strings, this is memchr, which is vectorized by libc.
   if (entsize == 1)
     return data.find('\0');
+  if (entsize == 2)
+    return find_null16(data);
+  if (entsize == 4)
+    return find_null32(data);
 
-  for (i64 i = 0; i <= data.size() - entsize; i += entsize)
-    if (data.substr(i, i + entsize).find_first_not_of('\0') == data.npos)
+  for (i64 i = 0; i + entsize <= data.size(); i += entsize)
+    if (data.substr(i, entsize).find_first_not_of('\0') == data.npos)
       return i;
-
   return data.npos;
 }
 
+template <typename E>
+static std::unique_ptr<MergeableSection<E>>
+new_mergeable_section(Context<E> &ctx, InputSection<E> &sec) {
+  std::unique_ptr<MergeableSection<E>> rec(new MergeableSection<E>);
+  rec->parent = MergedSection<E>::get_instance(ctx, sec.name(), sec.shdr.sh_type,
+                                               sec.shdr.sh_flags);
+  rec->shdr = sec.shdr;
+
+  static_assert(sizeof(Subsection<E>::alignment) == 2);
+  if (sec.shdr.sh_addralign >= UINT16_MAX)
+    Fatal(ctx) << sec << ": alignment too large";
+
+  if (!(sec.shdr.sh_flags & SHF_STRINGS)) {
+    rec->parent->has_non_strings = true;
+    if (sec.contents.size() % sec.shdr.sh_entsize)
+      Fatal(ctx) << sec << ": section size is not multiple of sh_entsize";
+  }
+  return rec;
+}
+
 // Mergeable sections (sections with SHF_MERGE bit) typically contain
 // string literals. Linker is expected to split the section contents
 // into null-terminated strings, merge them with mergeable strings
@@ -541,21 +664,11 @@ static size_t find_null(std::string_view data, u64 entsize) {
 //
 // We do not support mergeable sections that have relocations.
 template <typename E>
-static std::unique_ptr<MergeableSection<E>>
-split_section(Context<E> &ctx, InputSection<E> &sec) {
-  std::unique_ptr<MergeableSection<E>> rec(new MergeableSection<E>);
-  rec->parent = MergedSection<E>::get_instance(ctx, sec.name(), sec.shdr.sh_type,
-                                               sec.shdr.sh_flags);
-  rec->shdr = sec.shdr;
-
+static void split_section(Context<E> &ctx, InputSection<E> &sec,
+                          MergeableSection<E> &rec) {
   std::string_view data = sec.contents;
   const char *begin = data.data();
   u64 entsize = sec.shdr.sh_entsize;
-  HyperLogLog estimator;
-
-  static_assert(sizeof(Subsection<E>::alignment) == 2);
-  if (sec.shdr.sh_addralign >= UINT16_MAX)
-    Fatal(ctx) << sec << ": alignment too large";
 
   if (sec.shdr.sh_flags & SHF_STRINGS) {
     while (!data.empty()) {
@@ -566,35 +679,32 @@ split_section(Context<E> &ctx, InputSection<E> &sec) {
       std::string_view substr = data.substr(0, end + entsize);
       data = data.substr(end + entsize);
 
-      rec->strings.push_back(substr);
-      rec->subsec_offsets.push_back(substr.data() - begin);
-
-      u64 hash = hash_string(substr);
-      rec->hashes.push_back(hash);
-      estimator.insert(hash);
+      rec.strings.push_back(substr);
+      rec.subsec_offsets.push_back(substr.data() - begin);
+      rec.hashes.push_back(hash_string(substr));
     }
   } else {
-    if (data.size() % entsize)
-      Fatal(ctx) << sec << ": section size is not multiple of sh_entsize";
-
     while (!data.empty()) {
       std::string_view substr = data.substr(0, entsize);
       data = data.substr(entsize);
 
-      rec->strings.push_back(substr);
-      rec->subsec_offsets.push_back(substr.data() - begin);
-
-      u64 hash = hash_string(substr);
-      rec->hashes.push_back(hash);
-      estimator.insert(hash);
+      rec.strings.push_back(substr);
+      rec.subsec_offsets.push_back(substr.data() - begin);
+      rec.hashes.push_back(hash_string(substr));
     }
   }
+}
 
-  rec->parent->estimator.merge(estimator);
+// Recreates pieces from piece boundaries read from --parse-cache.
+template <typename E>
+static void split_section_at(InputSection<E> &sec, MergeableSection<E> &rec) {
+  std::string_view data = sec.contents;
+  std::span<u32> offsets = rec.subsec_offsets;
 
-  static Counter counter("string_subsections");
-  counter += rec->subsections.size();
-  return rec;
+  for (i64 i = 0; i < offsets.size(); i++) {
+    u32 end = (i + 1 < offsets.size()) ? offsets[i + 1] : data.size();
+    rec.strings.push_back(data.substr(offsets[i], end - offsets[i]));
+  }
 }
 
 // Usually a section is an atomic unit of inclusion and exclusion.
@@ -642,28 +752,70 @@ split_section(Context<E> &ctx, InputSection<E> &sec) {
 template <typename E>
 void ObjectFile<E>::initialize_mergeable_sections(Context<E> &ctx) {
   mergeable_sections.resize(sections.size());
+  bool has_mergeable_sections = false;
 
   for (i64 i = 0; i < sections.size(); i++) {
-    std::unique_ptr<InputSection<E>> &isec = sections[i];
+    InputSection<E> *isec = sections[i];
     if (isec && isec->is_alive && (isec->shdr.sh_flags & SHF_MERGE) &&
         isec->shdr.sh_size && isec->shdr.sh_entsize &&
         isec->relsec_idx == -1) {
-      mergeable_sections[i] = split_section(ctx, *isec);
-      isec->is_alive = false;
+      mergeable_sections[i] = new_mergeable_section(ctx, *isec);
+      has_mergeable_sections = true;
     }
   }
+
+  if (!has_mergeable_sections)
+    return;
+
+  bool cached = !ctx.arg.parse_cache.empty() &&
+                read_parse_cache(ctx, this->mf, std::span(mergeable_sections));
+
+  static Counter hits("parse_cache_hits");
+  hits += cached;
+
+  for (i64 i = 0; i < sections.size(); i++) {
+    if (MergeableSection<E> *m = mergeable_sections[i].get()) {
+      if (cached) {
+        split_section_at(*sections[i], *m);
+      } else {
+        m->strings.clear();
+        m->hashes.clear();
+        m->subsec_offsets.clear();
+        split_section(ctx, *sections[i], *m);
+      }
+
+      HyperLogLog estimator;
+      for (u64 hash : m->hashes)
+        estimator.insert(hash);
+      m->parent->estimator.merge(estimator);
+      sections[i]->is_alive = false;
+
+      static Counter counter("string_subsections");
+      counter += m->strings.size();
+    }
+  }
+
+  if (!ctx.arg.parse_cache.empty() && !cached)
+    write_parse_cache(ctx, this->mf, std::span(mergeable_sections));
 }
 
 template <typename E>
 void ObjectFile<E>::register_subsections(Context<E> &ctx) {
-  for (std::unique_ptr<MergeableSection<E>> &m : mergeable_sections)
-    if (m)
-      for (i64 i = 0; i < m->strings.size(); i++)
-        m->subsections.push_back(m->parent->insert(m->strings[i], m->hashes[i],
-                                                   m->shdr.sh_addralign));
+  // This function may be called more than once if a hash table of a
+  // merged section overflows. See register_subsections() in passes.cc.
+  subsections.clear();
+
+  for (std::unique_ptr<MergeableSection<E>> &m : mergeable_sections) {
+    if (!m)
+      continue;
+
+    m->subsections.clear();
+    m->parent->insert(m->strings, m->hashes, m->shdr.sh_addralign,
+                      m->subsections);
+  }
 
   // Initialize rel_subsections
-  for (std::unique_ptr<InputSection<E>> &isec : sections) {
+  for (InputSection<E> *isec : sections) {
     if (!isec || !isec->is_alive)
       continue;
 
@@ -731,8 +883,12 @@ void ObjectFile<E>::register_subsections(Context<E> &ctx) {
       Fatal(ctx) << *this << ": bad symbol value: " << esym.st_value;
     i64 idx = it - 1 - offsets.begin();
 
-    if (i < first_global)
-      this->symbols[i]->value = esym.st_value - offsets[idx];
+    // Symbols have already been resolved, so we need to fix up the
+    // values of not only local symbols but also global symbols that
+    // this file defines.
+    Symbol<E> &sym = *this->symbols[i];
+    if (i < first_global || (sym.file == this && sym.sym_idx == i))
+      sym.value = esym.st_value - offsets[idx];
 
     sym_subsections[i].subsec = m->subsections[idx];
     sym_subsections[i].addend = esym.st_value - offsets[idx];
@@ -746,6 +902,14 @@ void ObjectFile<E>::register_subsections(Context<E> &ctx) {
 
 template <typename E>
 void ObjectFile<E>::parse(Context<E> &ctx) {
+  // An LTO object file has only symbols. They are replaced with the
+  // contents of real object files after link-time optimization.
+  if (is_lto_obj) {
+    initialize_symbols(ctx);
+    is_sections_parsed = true;
+    return;
+  }
+
   sections.resize(this->elf_sections.size());
   symtab_sec = this->find_section(SHT_SYMTAB);
 
@@ -755,10 +919,23 @@ void ObjectFile<E>::parse(Context<E> &ctx) {
     symbol_strtab = this->get_string(ctx, symtab_sec->sh_link);
   }
 
-  initialize_sections(ctx);
   initialize_symbols(ctx);
+
+  // An archive member is included in the output only if it is needed to
+  // resolve undefined symbols, and usually only a small fraction of
+  // members are. So, for archive members, we read only global symbols
+  // here and parse the rest when they are pulled in.
+  if (this->is_alive)
+    parse_sections(ctx);
+}
+
+template <typename E>
+void ObjectFile<E>::parse_sections(Context<E> &ctx) {
+  initialize_sections(ctx);
+  initialize_local_symbols(ctx);
   initialize_mergeable_sections(ctx);
   initialize_ehframe_sections(ctx);
+  is_sections_parsed = true;
 }
 
 // Symbols with higher priorities overwrites symbols with lower priorities.
@@ -772,9 +949,18 @@ void ObjectFile<E>::parse(Context<E> &ctx) {
 //  6. Common symbol
 //  7. Unclaimed (nonexistent) symbol
 //
-// Ties are broken by file priority.
+// Ties are broken by file priority. A remaining undefined symbol claimed
+// by claim_unresolved_symbols() also has rank 7.
+//
+// Symbols are resolved without locks in two steps. First, each file
+// atomically lowers the rank of each symbol it defines to its own rank
+// if its definition is stronger. After all files are done, each file
+// sets up the symbols whose ranks are equal to its own ranks. Since a
+// rank identifies a file, only one thread writes to each symbol in the
+// second step.
 template <typename E>
-static u64 get_rank(InputFile<E> *file, const ElfSym<E> &esym, bool is_lazy) {
+static u32 get_rank(InputFile<E> *file, const ElfSym<E> &esym, bool is_lazy) {
+  assert(file->priority < (1 << 24));
   if (esym.is_common())
     return (6 << 24) + file->priority;
   if (is_lazy)
@@ -789,11 +975,20 @@ static u64 get_rank(InputFile<E> *file, const ElfSym<E> &esym, bool is_lazy) {
   return (1 << 24) + file->priority;
 }
 
+// Replaces the rank of a given symbol with `rank` if `pred` returns true
+// for the current rank.
+template <typename E, typename Pred>
+static bool update_rank(Symbol<E> &sym, u32 rank, Pred pred) {
+  u32 cur = sym.rank;
+  while (pred(cur))
+    if (sym.rank.compare_exchange_weak(cur, rank))
+      return true;
+  return false;
+}
+
 template <typename E>
-static u64 get_rank(const Symbol<E> &sym) {
-  if (!sym.file)
-    return 7 << 24;
-  return get_rank(sym.file, sym.esym(), sym.is_lazy);
+static bool update_rank(Symbol<E> &sym, u32 rank) {
+  return update_rank(sym, rank, [&](u32 cur) { return rank < cur; });
 }
 
 template <typename E>
@@ -851,16 +1046,7 @@ void ObjectFile<E>::resolve_lazy_symbols(Context<E> &ctx) {
     if (esym.is_undef() || esym.is_common())
       continue;
 
-    std::lock_guard lock(sym.mu);
-    if (get_rank(this, esym, true) < get_rank(sym)) {
-      sym.file = this;
-      sym.sym_idx = i;
-      sym.is_lazy = true;
-      sym.is_weak = false;
-      if (sym.traced)
-        SyncOut(ctx) << "trace-symbol: " << *this
-                     << ": lazy definition of " << sym;
-    }
+    update_rank(sym, get_rank(this, esym, true));
   }
 }
 
@@ -874,9 +1060,50 @@ void ObjectFile<E>::resolve_regular_symbols(Context<E> &ctx) {
     if (esym.is_undef() || esym.is_common())
       continue;
 
-    std::lock_guard lock(sym.mu);
-    if (get_rank(this, esym, false) < get_rank(sym))
-      override_symbol(ctx, sym, esym, i);
+    update_rank(sym, get_rank(this, esym, false));
+  }
+}
+
+// Sets up symbols for which definitions in this file have won.
+// We visit symbols backwards so that the first one wins if this file
+// defines the same symbol more than once.
+template <typename E>
+void ObjectFile<E>::update_symbols(Context<E> &ctx) {
+  for (i64 i = this->symbols.size() - 1; i >= first_global; i--) {
+    Symbol<E> &sym = *this->symbols[i];
+    const ElfSym<E> &esym = elf_syms[i];
+    if (esym.is_undef())
+      continue;
+
+    if (sym.rank == get_rank(this, esym, false)) {
+      if (!esym.is_common()) {
+        override_symbol(ctx, sym, esym, i);
+        continue;
+      }
+
+      sym.file = this;
+      sym.input_section = nullptr;
+      sym.value = esym.st_value;
+      sym.sym_idx = i;
+      sym.ver_idx = ctx.arg.default_version;
+      sym.is_lazy = false;
+      sym.is_weak = false;
+      sym.is_imported = false;
+      sym.is_exported = false;
+
+      if (sym.traced)
+        SyncOut(ctx) << "trace-symbol: " << *this
+                     << ": common definition of " << sym;
+    } else if (is_in_lib && sym.rank == get_rank(this, esym, true)) {
+      sym.file = this;
+      sym.sym_idx = i;
+      sym.is_lazy = true;
+      sym.is_weak = false;
+
+      if (sym.traced)
+        SyncOut(ctx) << "trace-symbol: " << *this
+                     << ": lazy definition of " << sym;
+    }
   }
 }
 
@@ -886,6 +1113,9 @@ ObjectFile<E>::mark_live_objects(Context<E> &ctx,
                                  std::function<void(ObjectFile<E> *)> feeder) {
   assert(this->is_alive);
 
+  if (!is_sections_parsed)
+    parse_sections(ctx);
+
   for (i64 i = first_global; i < this->symbols.size(); i++) {
     const ElfSym<E> &esym = elf_syms[i];
     Symbol<E> &sym = *this->symbols[i];
@@ -900,10 +1130,13 @@ ObjectFile<E>::mark_live_objects(Context<E> &ctx,
         SyncOut(ctx) << "trace-symbol: " << *this << ": reference to " << sym;
     }
 
-    std::lock_guard lock(sym.mu);
-
     if (esym.is_undef() || esym.is_common()) {
-      if (!esym.is_weak() && sym.file && !sym.file->is_alive.exchange(true)) {
+      // `sym.file` is not updated until update_symbols() is called after
+      // this pass. If the symbol's rank says that it has been taken by a
+      // regular definition, the owner is already alive. DSOs are marked
+      // alive later in resolve_symbols().
+      if (!esym.is_weak() && sym.file && !sym.file->is_dso &&
+          (sym.rank >> 24) > 2 && !sym.file->is_alive.exchange(true)) {
         feeder((ObjectFile<E> *)sym.file);
         if (sym.traced)
           SyncOut(ctx) << "trace-symbol: " << *this << " keeps " << *sym.file
@@ -912,8 +1145,7 @@ ObjectFile<E>::mark_live_objects(Context<E> &ctx,
       continue;
     }
 
-    if (get_rank(this, esym, false) < get_rank(sym))
-      override_symbol(ctx, sym, esym, i);
+    update_rank(sym, get_rank(this, esym, false));
   }
 }
 
@@ -927,112 +1159,130 @@ void ObjectFile<E>::resolve_common_symbols(Context<E> &ctx) {
     if (!esym.is_common())
       continue;
 
-    Symbol<E> &sym = *this->symbols[i];
-    std::lock_guard lock(sym.mu);
-
-    if (get_rank(this, esym, false) < get_rank(sym)) {
-      sym.file = this;
-      sym.input_section = nullptr;
-      sym.value = esym.st_value;
-      sym.sym_idx = i;
-      sym.ver_idx = ctx.arg.default_version;
-      sym.is_lazy = false;
-      sym.is_weak = false;
-      sym.is_imported = false;
-      sym.is_exported = false;
-
-      if (sym.traced)
-        SyncOut(ctx) << "trace-symbol: " << *this
-                     << ": common definition of " << sym;
-    }
+    update_rank(*this->symbols[i], get_rank(this, esym, false));
   }
 }
 
 template <typename E>
-void ObjectFile<E>::resolve_comdat_groups() {
-  for (auto &pair : comdat_groups) {
-    ComdatGroup *group = pair.first;
-    u32 cur = group->owner;
-    while (cur == -1 || cur > this->priority)
-      if (group->owner.compare_exchange_weak(cur, this->priority))
-        break;
-  }
+static void kill_comdat_members(ComdatGroupRef<E> &ref) {
+  for (u32 i : ref.members)
+    if (InputSection<E> *isec = ref.file->sections[i])
+      isec->kill();
 }
 
+// Only the copy of a comdat group in the file with the highest priority
+// (i.e. the smallest priority value) survives. A file examining a group
+// kills its own copy if the current owner has a higher priority.
+// Otherwise, it takes over the group and kills the previous owner's
+// copy. Each copy but the final owner's is killed exactly once, so all
+// files can be processed in a single parallel pass.
 template <typename E>
 void ObjectFile<E>::eliminate_duplicate_comdat_groups() {
-  for (auto &pair : comdat_groups) {
-    ComdatGroup *group = pair.first;
-    if (group->owner == this->priority)
-      continue;
+  for (ComdatGroupRef<E> &ref : comdat_groups) {
+    ComdatGroupRef<E> *cur = ref.group->owner;
+    for (;;) {
+      if (cur && cur->file->priority < this->priority) {
+        kill_comdat_members(ref);
+        break;
+      }
 
-    std::span<u32> entries = pair.second;
-    for (u32 i : entries)
-      if (sections[i])
-        sections[i]->kill();
+      if (ref.group->owner.compare_exchange_weak(cur, &ref)) {
+        if (cur)
+          kill_comdat_members(*cur);
+        break;
+      }
+    }
   }
 }
 
+// Traditionally, remaining undefined symbols cause a link failure only
+// when we are creating an executable. Undefined symbols in shared
+// objects are promoted to dynamic symbols, so that they'll get another
+// chance to be resolved at run-time. You can change the behavior by
+// passing `-z defs` to the linker.
+//
+// Even if `-z defs` is given, weak undefined symbols are still promoted
+// to dynamic symbols for compatibility with other linkers. Some major
+// programs, notably Firefox, depend on the behavior (they use this
+// loophole to export symbols from libxul.so).
+template <typename E>
+static bool is_unresolved_dynamic(Context<E> &ctx, const ElfSym<E> &esym) {
+  return ctx.arg.shared && (!ctx.arg.z_defs || esym.is_undef_weak());
+}
+
+// Returns true if an unresolved symbol can be converted to an absolute
+// symbol with value 0.
+template <typename E>
+static bool is_unresolved_absolute(Context<E> &ctx, const ElfSym<E> &esym) {
+  return ctx.arg.unresolved_symbols != UnresolvedKind::ERROR ||
+         esym.is_undef_weak();
+}
+
 template <typename E>
 void ObjectFile<E>::claim_unresolved_symbols(Context<E> &ctx) {
   if (!this->is_alive)
     return;
 
+  // A symbol that is still undefined is claimed by the file with the
+  // highest priority number that refers it.
+  u32 rank = (7 << 24) + this->priority;
+
+  auto pred = [&](u32 cur) {
+    return (cur >> 24) == 7 && (cur & 0xffffff) < this->priority;
+  };
+
   for (i64 i = first_global; i < this->symbols.size(); i++) {
     const ElfSym<E> &esym = elf_syms[i];
     Symbol<E> &sym = *this->symbols[i];
     if (!esym.is_undef())
       continue;
 
-    std::lock_guard lock(sym.mu);
-
-    auto claim = [&](bool is_imported) {
-      sym.file = this;
-      sym.input_section = nullptr;
-      sym.value = 0;
-      sym.sym_idx = i;
-      sym.ver_idx = ctx.arg.default_version;
-      sym.is_lazy = false;
-      sym.is_weak = false;
-      sym.is_imported = is_imported;
-      sym.is_exported = false;
-    };
-
-    if (!sym.file ||
-        (sym.esym().is_undef() && sym.file->priority < this->priority)) {
-      // Traditionally, remaining undefined symbols cause a link failure
-      // only when we are creating an executable. Undefined symbols in
-      // shared objects are promoted to dynamic symbols, so that they'll
-      // get another chance to be resolved at run-time. You can change the
-      // behavior by passing `-z defs` to the linker.
-      //
-      // Even if `-z defs` is given, weak undefined symbols are still
-      // promoted to dynamic symbols for compatibility with other linkers.
-      // Some major programs, notably Firefox, depend on the behavior
-      // (they use this loophole to export symbols from libxul.so).
-      if (ctx.arg.shared && (!ctx.arg.z_defs || esym.is_undef_weak())) {
-        // Convert remaining undefined symbols to dynamic symbols.
-        claim(!ctx.arg.is_static);
-        if (sym.traced)
-          SyncOut(ctx) << "trace-symbol: " << *this << ": unresolved"
-                       << (esym.is_weak() ? " weak" : "")
-                       << " symbol " << sym;
-      } else if (ctx.arg.unresolved_symbols != UnresolvedKind::ERROR ||
-                 esym.is_undef_weak()) {
-        // Convert remaining undefined symbols to absolute symbols with
-        // value 0.
-        claim(false);
-        if (ctx.arg.unresolved_symbols == UnresolvedKind::WARN)
-          Warn(ctx) << "undefined symbol: " << *this << ": " << sym;
+    if (is_unresolved_dynamic(ctx, esym)) {
+      if (update_rank(sym, rank, pred) && sym.traced)
+        SyncOut(ctx) << "trace-symbol: " << *this << ": unresolved"
+                     << (esym.is_weak() ? " weak" : "")
+                     << " symbol " << sym;
+    } else if (is_unresolved_absolute(ctx, esym)) {
+      if (update_rank(sym, rank, pred) &&
+          ctx.arg.unresolved_symbols == UnresolvedKind::WARN) {
+        if (ctx.arg.fatal_warnings)
+          ctx.has_error = true;
+        ctx.undef_out.line() << "mold: undefined symbol: " << *this
+                             << ": " << sym;
       }
     }
   }
 }
 
+template <typename E>
+void ObjectFile<E>::update_unresolved_symbols(Context<E> &ctx) {
+  if (!this->is_alive)
+    return;
+
+  u32 rank = (7 << 24) + this->priority;
+
+  for (i64 i = this->symbols.size() - 1; i >= first_global; i--) {
+    const ElfSym<E> &esym = elf_syms[i];
+    Symbol<E> &sym = *this->symbols[i];
+    if (!esym.is_undef() || sym.rank != rank)
+      continue;
+
+    sym.file = this;
+    sym.input_section = nullptr;
+    sym.value = 0;
+    sym.sym_idx = i;
+    sym.ver_idx = ctx.arg.default_version;
+    sym.is_lazy = false;
+    sym.is_weak = false;
+    sym.is_imported = is_unresolved_dynamic(ctx, esym) && !ctx.arg.is_static;
+    sym.is_exported = false;
+  }
+}
+
 template <typename E>
 void ObjectFile<E>::scan_relocations(Context<E> &ctx) {
   // Scan relocations against seciton contents
-  for (std::unique_ptr<InputSection<E>> &isec : sections)
+  for (InputSection<E> *isec : sections)
     if (isec && isec->is_alive && (isec->shdr.sh_flags & SHF_ALLOC))
       isec->scan_relocations(ctx);
 
@@ -1072,22 +1322,19 @@ void ObjectFile<E>::convert_common_symbols(Context<E> &ctx) {
       continue;
     }
 
-    auto *shdr = new ElfShdr<E>;
-    ctx.shdr_pool.push_back(std::unique_ptr<ElfShdr<E>>(shdr));
-
-    memset(shdr, 0, sizeof(*shdr));
+    ElfShdr<E> *shdr = arena.create<ElfShdr<E>>();
     shdr->sh_flags = SHF_ALLOC;
     shdr->sh_type = SHT_NOBITS;
     shdr->sh_size = elf_syms[i].st_size;
     shdr->sh_addralign = elf_syms[i].st_value;
 
-    std::unique_ptr<InputSection<E>> isec =
-      std::make_unique<InputSection<E>>(ctx, *this, *shdr, ".common",
-                                        std::string_view(), sections.size());
+    InputSection<E> *isec =
+      arena.create<InputSection<E>>(ctx, *this, *shdr, ".common",
+                                    std::string_view(), sections.size());
     isec->output_section = osec;
 
     sym.file = this;
-    sym.input_section = isec.get();
+    sym.input_section = isec;
     sym.value = 0;
     sym.sym_idx = i;
     sym.ver_idx = ctx.arg.default_version;
@@ -1096,7 +1343,27 @@ void ObjectFile<E>::convert_common_symbols(Context<E> &ctx) {
     sym.is_imported = false;
     sym.is_exported = false;
 
-    sections.push_back(std::move(isec));
+    sections.push_back(isec);
+  }
+}
+
+// Computes the final addresses of this file's symbols, so that the
+// relocation loops in the copy phase do a single array load per
+// relocation instead of going through Symbol::get_addr(). This must be
+// called after the file layout is fixed.
+//
+// Symbols in .eh_frame are resolved by get_addr() using their names,
+// and some of them are errors, so they are left for get_addr().
+template <typename E>
+void ObjectFile<E>::compute_symbol_addrs(Context<E> &ctx) {
+  sym_addrs.resize(this->symbols.size());
+
+  for (i64 i = 0; i < this->symbols.size(); i++) {
+    Symbol<E> *sym = this->symbols[i];
+    if (!sym || (sym->input_section && sym->input_section->is_ehframe))
+      sym_addrs[i] = -1;
+    else
+      sym_addrs[i] = sym->get_addr(ctx);
   }
 }
 
@@ -1154,12 +1421,12 @@ void ObjectFile<E>::write_symtab(Context<E> &ctx) {
   i64 strtab_off = strtab_offset;
   i64 symtab_off;
 
-  auto write_sym = [&](Symbol<E> &sym) {
+  auto write_sym = [&](Symbol<E> &sym, i64 name_off) {
     ElfSym<E> &esym = *(ElfSym<E> *)(symtab_base + symtab_off);
     symtab_off += sizeof(esym);
 
     esym = sym.esym();
-    esym.st_name = strtab_off;
+    esym.st_name = name_off;
 
     if (sym.get_type() == STT_TLS)
       esym.st_value = sym.get_addr(ctx) - ctx.tls_begin;
@@ -1168,29 +1435,70 @@ void ObjectFile<E>::write_symtab(Context<E> &ctx) {
 
     if (sym.input_section)
       esym.st_shndx = sym.input_section->output_section->shndx;
-    else if (sym.shndx)
-      esym.st_shndx = sym.shndx;
+    else if (i32 shndx = sym.get_shndx(ctx))
+      esym.st_shndx = shndx;
     else if (esym.is_undef())
       esym.st_shndx = SHN_UNDEF;
     else
       esym.st_shndx = SHN_ABS;
 
-    write_string(strtab_base + strtab_off, sym.name());
-    strtab_off += sym.name().size() + 1;
+    // A local symbol name may refer to an identical string written
+    // by other symbol. Such string is always at a lower offset.
+    if (name_off == strtab_off) {
+      write_string(strtab_base + strtab_off, sym.name());
+      strtab_off += sym.name().size() + 1;
+    }
   };
 
   symtab_off = local_symtab_offset;
-  for (i64 i = 1; i < first_global; i++) {
+  for (i64 i = 1, j = 0; i < first_global; i++) {
     Symbol<E> &sym = *this->symbols[i];
     if (sym.write_to_symtab)
-      write_sym(sym);
+      write_sym(sym, local_strtab_offsets[j++]);
   }
 
   symtab_off = global_symtab_offset;
   for (i64 i = first_global; i < elf_syms.size(); i++) {
     Symbol<E> &sym = *this->symbols[i];
     if (sym.file == this && sym.write_to_symtab)
-      write_sym(sym);
+      write_sym(sym, strtab_off);
+  }
+}
+
+// Computes .symtab indices of symbols for --emit-relocs. Symbols are
+// visited in the same order as write_symtab() writes them.
+template <typename E>
+void ObjectFile<E>::compute_output_sym_indices(Context<E> &ctx) {
+  output_sym_indices.clear();
+  output_sym_indices.resize(elf_syms.size(), -1);
+
+  i64 idx = local_symtab_offset / sizeof(ElfSym<E>);
+  for (i64 i = 1; i < first_global; i++)
+    if (this->symbols[i]->write_to_symtab)
+      output_sym_indices[i] = idx++;
+
+  idx = global_symtab_offset / sizeof(ElfSym<E>);
+  for (i64 i = first_global; i < elf_syms.size(); i++) {
+    Symbol<E> &sym = *this->symbols[i];
+    if (sym.file == this && sym.write_to_symtab)
+      output_sym_indices[i] = idx++;
+  }
+}
+
+// Inflates compressed non-alloc sections of this file whose
+// decompression has been deferred by initialize_sections(). See
+// inflate_nonalloc_sections() in passes.cc.
+template <typename E>
+void ObjectFile<E>::inflate_nonalloc_sections(Context<E> &ctx) {
+  for (InputSection<E> *isec : sections) {
+    if (!isec || !isec->is_alive || !isec->compress_type ||
+        (isec->shdr.sh_flags & SHF_ALLOC))
+      continue;
+
+    u8 *buf = (u8 *)arena.alloc(isec->shdr.sh_size);
+    isec->uncompress_to(ctx, buf);
+    isec->contents = {(char *)buf, (size_t)isec->shdr.sh_size};
+    isec->compress_type = 0;
   }
 }
 
@@ -1219,7 +1527,7 @@ template <typename E>
 SharedFile<E> *
 SharedFile<E>::create(Context<E> &ctx, MappedFile<Context<E>> *mf) {
   SharedFile<E> *obj = new SharedFile(ctx, mf);
-  ctx.dso_pool.push_back(std::unique_ptr<SharedFile<E>>(obj));
+  push_to_pool(ctx.dso_pool, std::unique_ptr<SharedFile<E>>(obj));
   return obj;
 }
 
@@ -1240,36 +1548,74 @@ std::string_view SharedFile<E>::get_soname(Context<E> &ctx) {
   return path_filename(this->filename);
 }
 
+// Reads only DT_SONAME so that we can remove duplicate DSOs before
+// paying the cost of parsing their symbol tables.
 template <typename E>
-void SharedFile<E>::parse(Context<E> &ctx) {
+void SharedFile<E>::read_soname(Context<E> &ctx) {
   symtab_sec = this->find_section(SHT_DYNSYM);
   if (!symtab_sec)
     return;
 
   symbol_strtab = this->get_string(ctx, symtab_sec->sh_link);
   soname = get_soname(ctx);
+}
+
+template <typename E>
+std::span<u16> SharedFile<E>::get_versyms(Context<E> &ctx) {
+  if (ElfShdr<E> *sec = this->find_section(SHT_GNU_VERSYM))
+    return this->template get_data<u16>(ctx, *sec);
+  return {};
+}
+
+template <typename E>
+void SharedFile<E>::parse(Context<E> &ctx) {
+  read_soname(ctx);
+  if (!symtab_sec)
+    return;
+
   version_strings = read_verdef(ctx);
 
   // Read a symbol table.
   i64 first_global = symtab_sec->sh_info;
   std::span<ElfSym<E>> esyms =
     this->template get_data<ElfSym<E>>(ctx, *symtab_sec);
+  std::span<u16> vers = get_versyms(ctx);
+
+  // A lazy DSO interns only the names it refers to. Its definitions
+  // are registered later only if someone refers to them, so that
+  // unreferenced --as-needed libraries don't fill up the symbol table.
+  if (is_lazy) {
+    for (i64 i = first_global; i < esyms.size(); i++) {
+      if (esyms[i].is_undef())
+        globals.push_back(intern(ctx, symbol_strtab.data() +
+                                      esyms[i].st_name));
+      else if (vers.empty() || (vers[i] & ~VERSYM_HIDDEN) != VER_NDX_LOCAL)
+        lazy_syms.push_back(i);
+    }
+    return;
+  }
 
-  std::span<u16> vers;
-  if (ElfShdr<E> *sec = this->find_section(SHT_GNU_VERSYM))
-    vers = this->template get_data<u16>(ctx, *sec);
+  // System libraries such as libc.so are linked to almost every
+  // program and have thousands of dynamic symbols, so this loop is on
+  // the hot path of small links. Intern each name only once.
+  i64 num_globals = esyms.size() - first_global;
+  globals.reserve(num_globals);
+  elf_syms.reserve(num_globals);
+  versyms.reserve(num_globals);
+  this->symbols.reserve(num_globals);
 
   for (i64 i = first_global; i < esyms.size(); i++) {
     std::string_view name = symbol_strtab.data() + esyms[i].st_name;
+    Symbol<E> *sym = intern(ctx, name);
 
-    globals.push_back(intern(ctx, name));
+    globals.push_back(sym);
     if (esyms[i].is_undef())
       continue;
 
     if (vers.empty()) {
       elf_syms.push_back(&esyms[i]);
       versyms.push_back(VER_NDX_GLOBAL);
-      this->symbols.push_back(intern(ctx, name));
+      this->symbols.push_back(sym);
     } else {
       u16 ver = vers[i] & ~VERSYM_HIDDEN;
       if (ver == VER_NDX_LOCAL)
@@ -1283,15 +1629,104 @@ void SharedFile<E>::parse(Context<E> &ctx) {
           ctx, std::string(name) + "@" + std::string(version_strings[ver]));
         this->symbols.push_back(intern(ctx, mangled_name, name));
       } else {
-        this->symbols.push_back(intern(ctx, name));
+        this->symbols.push_back(sym);
       }
     }
   }
 
+  sort_symbols();
+
   static Counter counter("dso_syms");
   counter += elf_syms.size();
 }
 
+template <typename E>
+void SharedFile<E>::add_symbol(Symbol<E> *sym, const ElfSym<E> &esym, u16 ver) {
+  globals.push_back(sym);
+  elf_syms.push_back(&esym);
+  versyms.push_back(ver);
+  this->symbols.push_back(sym);
+}
+
+// Sort symbol indices by address so that find_aliases() can look up
+// symbols at the same address by binary search.
+template <typename E>
+void SharedFile<E>::sort_symbols() {
+  sorted_syms.resize(elf_syms.size());
+  std::iota(sorted_syms.begin(), sorted_syms.end(), 0);
+  sort(sorted_syms, [&](u32 a, u32 b) {
+    return elf_syms[a]->st_value < elf_syms[b]->st_value;
+  });
+}
+
+// Registers defined symbols of a lazy DSO whose names have already
+// been interned by someone else. This must be called after all names
+// that can be referred to have been interned and while no one interns
+// a new name, so that the result is deterministic.
+template <typename E>
+void SharedFile<E>::register_lazy_symbols(Context<E> &ctx) {
+  std::span<ElfSym<E>> esyms =
+    this->template get_data<ElfSym<E>>(ctx, *symtab_sec);
+  std::span<u16> vers = get_versyms(ctx);
+  std::vector<u32> rest;
+
+  for (u32 i : lazy_syms) {
+    std::string_view name = symbol_strtab.data() + esyms[i].st_name;
+    u16 ver = vers.empty() ? VER_NDX_GLOBAL : vers[i];
+
+    Symbol<E> *sym;
+    if (ver & VERSYM_HIDDEN)
+      sym = ctx.symbol_map.find(
+        std::string(name) + "@" +
+        std::string(version_strings[ver & ~VERSYM_HIDDEN]));
+    else
+      sym = ctx.symbol_map.find(name);
+
+    if (sym)
+      add_symbol(sym, esyms[i], ver & ~VERSYM_HIDDEN);
+    else
+      rest.push_back(i);
+  }
+
+  lazy_syms = std::move(rest);
+  sort_symbols();
+
+  static Counter counter("dso_syms");
+  counter += elf_syms.size();
+
+  static Counter skipped("dso_lazy_syms");
+  skipped += lazy_syms.size();
+}
+
+// Registers the remaining defined symbols of a lazy DSO that turned
+// out to be needed. Returns the index of the first new symbol.
+template <typename E>
+i64 SharedFile<E>::load_lazy_symbols(Context<E> &ctx) {
+  std::span<ElfSym<E>> esyms =
+    this->template get_data<ElfSym<E>>(ctx, *symtab_sec);
+  std::span<u16> vers = get_versyms(ctx);
+  i64 begin = this->symbols.size();
+
+  for (u32 i : lazy_syms) {
+    std::string_view name = symbol_strtab.data() + esyms[i].st_name;
+    u16 ver = vers.empty() ? VER_NDX_GLOBAL : vers[i];
+
+    if (ver & VERSYM_HIDDEN) {
+      std::string_view mangled_name = save_string(
+        ctx, std::string(name) + "@" +
+             std::string(version_strings[ver & ~VERSYM_HIDDEN]));
+      add_symbol(intern(ctx, mangled_name, name), esyms[i],
+                 ver & ~VERSYM_HIDDEN);
+    } else {
+      add_symbol(intern(ctx, name), esyms[i], ver);
+    }
+  }
+
+  lazy_syms.clear();
+  sort_symbols();
+  return begin;
+}
+
 template <typename E>
 std::vector<std::string_view> SharedFile<E>::read_verdef(Context<E> &ctx) {
   std::vector<std::string_view> ret(VER_NDX_LAST_RESERVED + 1);
@@ -1320,14 +1755,26 @@ std::vector<std::string_view> SharedFile<E>::read_verdef(Context<E> &ctx) {
 }
 
 template <typename E>
-void SharedFile<E>::resolve_dso_symbols(Context<E> &ctx) {
-  for (i64 i = 0; i < this->symbols.size(); i++) {
+void SharedFile<E>::resolve_dso_symbols(Context<E> &ctx, i64 begin) {
+  for (i64 i = begin; i < this->symbols.size(); i++) {
     Symbol<E> &sym = *this->symbols[i];
     const ElfSym<E> &esym = *elf_syms[i];
 
-    std::lock_guard lock(sym.mu);
+    // A DSO symbol takes a symbol that is not defined yet or whose
+    // definition comes from a file after this DSO on the command line.
+    update_rank(sym, get_rank(this, esym, false), [&](u32 cur) {
+      return cur == (7 << 24) || this->priority < (cur & 0xffffff);
+    });
+  }
+}
+
+template <typename E>
+void SharedFile<E>::update_symbols(Context<E> &ctx, i64 begin) {
+  for (i64 i = this->symbols.size() - 1; i >= begin; i--) {
+    Symbol<E> &sym = *this->symbols[i];
+    const ElfSym<E> &esym = *elf_syms[i];
 
-    if (!sym.file || this->priority < sym.file->priority) {
+    if (sym.rank == get_rank(this, esym, false)) {
       sym.file = this;
       sym.input_section = nullptr;
       sym.value = esym.st_value;
@@ -1347,11 +1794,19 @@ void SharedFile<E>::resolve_dso_symbols(Context<E> &ctx) {
 template <typename E>
 std::vector<Symbol<E> *> SharedFile<E>::find_aliases(Symbol<E> *sym) {
   assert(sym->file == this);
+  u64 val = sym->esym().st_value;
+
+  auto it = std::partition_point(sorted_syms.begin(), sorted_syms.end(),
+                                 [&](u32 i) {
+    return elf_syms[i]->st_value < val;
+  });
+
   std::vector<Symbol<E> *> vec;
-  for (Symbol<E> *sym2 : this->symbols)
-    if (sym2->file == this && sym != sym2 &&
-        sym->esym().st_value == sym2->esym().st_value)
+  for (; it != sorted_syms.end() && elf_syms[*it]->st_value == val; it++) {
+    Symbol<E> *sym2 = this->symbols[*it];
+    if (sym2->file == this && sym != sym2 && sym2->esym().st_value == val)
       vec.push_back(sym2);
+  }
   return vec;
 }
 
@@ -1369,6 +1824,7 @@ bool SharedFile<E>::is_readonly(Context<E> &ctx, Symbol<E> *sym) {
 }
 
 #define INSTANTIATE(E)                                                  \
+  template class InputFile<E>;                                          \
   template class ObjectFile<E>;                                         \
   template class SharedFile<E>;                                         \
   template std::ostream &operator<<(std::ostream &, const InputFile<E> &)
@@ -3,6 +3,8 @@
 #include <shared_mutex>
 #include <sys/mman.h>
 #include <tbb/parallel_for_each.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_scan.h>
 #include <tbb/parallel_sort.h>
 
 #ifdef __APPLE__
@@ -170,8 +172,23 @@ std::vector<ElfPhdr<E>> create_phdr(Context<E> &ctx) {
   }
 
   // Create PT_LOAD segments.
-  for (Chunk<E> *chunk : ctx.chunks)
+  for (Chunk<E> *chunk : ctx.chunks) {
     chunk->new_page = false;
+    chunk->new_huge_page = false;
+    chunk->new_page_in_memory = false;
+  }
+
+  // With -z compact-relro, non-BSS data following the RELRO region
+  // starts a new PT_LOAD segment, so that it can be moved to the next
+  // page in memory without padding in the file. See set_osec_offsets().
+  if (ctx.arg.z_relro && ctx.arg.z_compact_relro) {
+    for (i64 i = 1; i < ctx.chunks.size(); i++) {
+      Chunk<E> *chunk = ctx.chunks[i];
+      if ((chunk->shdr.sh_flags & SHF_ALLOC) && !is_bss(chunk) &&
+          is_relro(ctx, ctx.chunks[i - 1]) && !is_relro(ctx, chunk))
+        chunk->new_page_in_memory = true;
+    }
+  }
 
   for (i64 i = 0, end = ctx.chunks.size(); i < end;) {
     Chunk<E> *first = ctx.chunks[i++];
@@ -184,12 +201,28 @@ std::vector<ElfPhdr<E>> create_phdr(Context<E> &ctx) {
 
     if (!is_bss(first))
       while (i < end && !is_bss(ctx.chunks[i]) &&
-             to_phdr_flags(ctx.chunks[i]) == flags)
+             to_phdr_flags(ctx.chunks[i]) == flags &&
+             !ctx.chunks[i]->new_page_in_memory)
         append(ctx.chunks[i++]);
 
     while (i < end && is_bss(ctx.chunks[i]) &&
            to_phdr_flags(ctx.chunks[i]) == flags)
       append(ctx.chunks[i++]);
+
+    // With -z hugepage-text, the executable segment starts at a huge
+    // page boundary and is padded to the next huge page boundary, so
+    // that the text can be remapped onto huge pages at runtime without
+    // dragging other segments along.
+    if (ctx.arg.z_hugepage_text && (flags & PF_X)) {
+      ElfPhdr<E> &phdr = vec.back();
+      phdr.p_align = HUGE_PAGE_SIZE;
+      phdr.p_filesz = align_to(phdr.p_filesz, HUGE_PAGE_SIZE);
+      phdr.p_memsz = align_to(phdr.p_memsz, HUGE_PAGE_SIZE);
+
+      first->new_huge_page = true;
+      if (i < end)
+        ctx.chunks[i]->new_huge_page = true;
+    }
   }
 
   // Create a PT_TLS.
@@ -229,8 +262,18 @@ std::vector<ElfPhdr<E>> create_phdr(Context<E> &ctx) {
       i++;
       while (i < ctx.chunks.size() && is_relro(ctx, ctx.chunks[i]))
         append(ctx.chunks[i++]);
-      if (i < ctx.chunks.size())
+
+      // If the next chunk is moved to the next page only in memory,
+      // the rest of the last RELRO page is not used by anyone, so we
+      // extend PT_GNU_RELRO to cover the entire page. Otherwise, the
+      // dynamic linker would leave the partial page writable.
+      if (i < ctx.chunks.size() && ctx.chunks[i]->new_page_in_memory) {
+        ElfPhdr<E> &phdr = vec.back();
+        phdr.p_memsz = align_to(phdr.p_vaddr + phdr.p_memsz,
+                                COMMON_PAGE_SIZE) - phdr.p_vaddr;
+      } else if (i < ctx.chunks.size()) {
         ctx.chunks[i]->new_page = true;
+      }
     }
   }
 
@@ -257,22 +300,54 @@ void InterpSection<E>::copy_buf(Context<E> &ctx) {
   write_string(ctx.buf + this->shdr.sh_offset, ctx.arg.dynamic_linker);
 }
 
+// .rel.dyn contents are filled by GotSection::copy_buf(),
+// RelDynSection::copy_buf() and InputSection::apply_reloc_alloc().
+//
+// The dynamic linker wants R_RELATIVE relocations to precede other
+// ones, and it works better if relocations are sorted. Here, we
+// assign each writer its own slots so that R_RELATIVE relocations
+// come first in the address order, and the rest follow in the same
+// order. Only the latter part is sorted by symbol after copy_buf.
 template <typename E>
 void RelDynSection<E>::update_shdr(Context<E> &ctx) {
   this->shdr.sh_link = ctx.dynsym->shndx;
 
-  // .rel.dyn contents are filled by GotSection::copy_buf(Context<E> &ctx) and
-  // InputSection::apply_reloc_alloc().
-  i64 offset = ctx.got->get_reldyn_size(ctx);
+  auto assign = [&](bool is_baserel) {
+    i64 offset = this->shdr.sh_size;
+
+    for (Chunk<E> *chunk : ctx.chunks) {
+      if (chunk == ctx.got.get()) {
+        if (is_baserel) {
+          ctx.got->baserel_offset = offset;
+          offset += ctx.got->get_num_baserel(ctx) * sizeof(ElfRel<E>);
+        } else {
+          ctx.got->reldyn_offset = offset;
+          offset += ctx.got->get_num_dynrel(ctx) * sizeof(ElfRel<E>);
+        }
+      } else if (chunk->kind == Chunk<E>::REGULAR &&
+                 (chunk->shdr.sh_flags & SHF_ALLOC)) {
+        for (InputSection<E> *isec : ((OutputSection<E> *)chunk)->members) {
+          if (is_baserel) {
+            isec->baserel_offset = offset;
+            offset += isec->num_baserel * sizeof(ElfRel<E>);
+          } else {
+            isec->reldyn_offset = offset;
+            offset += isec->num_dynrel * sizeof(ElfRel<E>);
+          }
+        }
+      }
+    }
+    this->shdr.sh_size = offset;
+  };
 
-  offset += ctx.dynbss->symbols.size() * sizeof(ElfRel<E>);
-  offset += ctx.dynbss_relro->symbols.size() * sizeof(ElfRel<E>);
+  this->shdr.sh_size = 0;
+  assign(true);
+  relcount = this->shdr.sh_size / sizeof(ElfRel<E>);
 
-  for (ObjectFile<E> *file : ctx.objs) {
-    file->reldyn_offset = offset;
-    offset += file->num_dynrel * sizeof(ElfRel<E>);
-  }
-  this->shdr.sh_size = offset;
+  copyrel_offset = this->shdr.sh_size;
+  this->shdr.sh_size += ctx.dynbss->symbols.size() * sizeof(ElfRel<E>);
+  this->shdr.sh_size += ctx.dynbss_relro->symbols.size() * sizeof(ElfRel<E>);
+  assign(false);
 }
 
 template <typename E>
@@ -296,7 +371,7 @@ ElfRel<AARCH64> reloc<AARCH64>(u64 offset, u32 type, u32 sym, i64 addend) {
 template <typename E>
 void RelDynSection<E>::copy_buf(Context<E> &ctx) {
   ElfRel<E> *rel = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset +
-                                 ctx.got->get_reldyn_size(ctx));
+                                 copyrel_offset);
 
   for (Symbol<E> *sym : ctx.dynbss->symbols)
     *rel++ = reloc<E>(sym->get_addr(ctx), E::R_COPY, sym->get_dynsym_idx(ctx));
@@ -305,36 +380,202 @@ void RelDynSection<E>::copy_buf(Context<E> &ctx) {
     *rel++ = reloc<E>(sym->get_addr(ctx), E::R_COPY, sym->get_dynsym_idx(ctx));
 }
 
+// Encodes sorted, word-aligned offsets in the .relr.dyn format. An
+// address entry is followed by zero or more bitmap entries, each of
+// which covers the next (wordsize * 8 - 1) words. The resulting
+// entries are relative to the beginning of a chunk; address entries
+// are rebased when written to the output file.
+template <typename E>
+std::vector<typename E::WordTy> encode_relr(std::span<u64> pos) {
+  std::vector<typename E::WordTy> vec;
+  i64 num_bits = E::wordsize * 8 - 1;
+  i64 max_delta = E::wordsize * num_bits;
+
+  for (i64 i = 0; i < pos.size();) {
+    assert(pos[i] % E::wordsize == 0);
+    vec.push_back(pos[i]);
+    u64 base = pos[i++] + E::wordsize;
+
+    for (;;) {
+      u64 bits = 0;
+      for (; i < pos.size() && pos[i] - base < max_delta; i++)
+        bits |= (u64)1 << ((pos[i] - base) / E::wordsize);
+
+      if (!bits)
+        break;
+
+      vec.push_back((bits << 1) | 1);
+      base += max_delta;
+    }
+  }
+  return vec;
+}
+
+template <typename E>
+static std::vector<typename E::WordTy> *get_relr(Context<E> &ctx,
+                                                 Chunk<E> *chunk) {
+  if (chunk == ctx.got.get())
+    return &ctx.got->relr;
+  if (chunk->kind == Chunk<E>::REGULAR)
+    return &((OutputSection<E> *)chunk)->relr;
+  return nullptr;
+}
+
+template <typename E>
+void RelrDynSection<E>::update_shdr(Context<E> &ctx) {
+  this->shdr.sh_link = ctx.dynsym->shndx;
+
+  i64 n = 0;
+  for (Chunk<E> *chunk : ctx.chunks)
+    if (std::vector<typename E::WordTy> *relr = get_relr(ctx, chunk))
+      n += relr->size();
+  this->shdr.sh_size = n * E::wordsize;
+}
+
+template <typename E>
+void RelrDynSection<E>::copy_buf(Context<E> &ctx) {
+  typename E::WordTy *buf =
+    (typename E::WordTy *)(ctx.buf + this->shdr.sh_offset);
+
+  for (Chunk<E> *chunk : ctx.chunks)
+    if (std::vector<typename E::WordTy> *relr = get_relr(ctx, chunk))
+      for (typename E::WordTy val : *relr)
+        *buf++ = (val & 1) ? val : chunk->shdr.sh_addr + val;
+}
+
 template <typename E>
 void RelDynSection<E>::sort(Context<E> &ctx) {
   Timer t(ctx, "sort_dynamic_relocs");
 
-  ElfRel<E> *begin = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset);
-  ElfRel<E> *end = (ElfRel<E> *)((u8 *)begin + this->shdr.sh_size);
+  // R_RELATIVE relocations are already sorted by address. Sort only
+  // the rest by symbol so that the dynamic linker can reuse the result
+  // of a symbol lookup for consecutive relocations.
+  ElfRel<E> *begin = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset) + relcount;
+  ElfRel<E> *end = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset +
+                                 this->shdr.sh_size);
 
   tbb::parallel_sort(begin, end, [](const ElfRel<E> &a, const ElfRel<E> &b) {
-    return std::tuple(a.r_type != E::R_RELATIVE, a.r_sym, a.r_offset) <
-           std::tuple(b.r_type != E::R_RELATIVE, b.r_sym, b.r_offset);
+    return std::tuple(a.r_sym, a.r_offset) < std::tuple(b.r_sym, b.r_offset);
   });
+}
+
+// A value type of ConcurrentMap to elect a leader among elements with
+// the same key. Each element is ranked by its position in the input,
+// and the one with the smallest rank becomes the leader, so that the
+// result doesn't depend on thread scheduling.
+struct Leader {
+  Leader(u64 rank) : rank(rank) {}
+  Leader(const Leader &other) : rank(other.rank.load()) {}
+
+  void update(u64 val) {
+    u64 cur = rank;
+    while (val < cur && !rank.compare_exchange_weak(cur, val));
+  }
+
+  std::atomic<u64> rank;
+};
+
+static u64 get_rank(i64 file_idx, i64 idx) {
+  return ((u64)file_idx << 32) | idx;
+}
 
-  // Dynamic section contains the number of R_RELATIVE dynamic relocations,
-  // so rewrite it if necessary.
-  if (ctx.dynamic->shdr.sh_size) {
-    auto it = std::find_if(begin, end, [](const ElfRel<E> &rel) {
-      return rel.r_type != E::R_RELATIVE;
+// keys[i][j] is the j'th key of the i'th file. Returns the map entries
+// for the keys in the same shape.
+template <typename T>
+static std::vector<std::vector<Leader *>>
+elect_leaders(ConcurrentMap<Leader> &map, std::vector<std::vector<T>> &keys) {
+  std::vector<std::vector<Leader *>> vec(keys.size());
+  i64 num_keys = 0;
+  for (i64 i = 0; i < keys.size(); i++) {
+    vec[i].resize(keys[i].size());
+    num_keys += keys[i].size();
+  }
+
+  for (i64 nbuckets = num_keys * 2;; nbuckets *= 2) {
+    map.resize(nbuckets);
+    std::atomic_bool is_full = false;
+
+    tbb::parallel_for((i64)0, (i64)keys.size(), [&](i64 i) {
+      for (i64 j = 0; j < keys[i].size(); j++) {
+        std::string_view key = keys[i][j];
+        u64 rank = get_rank(i, j);
+        Leader *leader = map.insert(key, hash_string(key), {rank}).first;
+        if (!leader) {
+          is_full = true;
+          return;
+        }
+        leader->update(rank);
+        vec[i][j] = leader;
+      }
     });
-    this->relcount = it - begin;
-    ctx.dynamic->copy_buf(ctx);
+
+    if (!is_full)
+      return vec;
   }
 }
 
+// Local symbols often have the same names in different files, e.g.
+// static functions defined in headers or helper functions in CRT
+// files. This function merges identical local symbol names and
+// assigns .strtab offsets to files. Global symbols don't need merging
+// because their names are unique.
 template <typename E>
-void StrtabSection<E>::update_shdr(Context<E> &ctx) {
+void StrtabSection<E>::construct(Context<E> &ctx) {
+  std::vector<std::vector<std::string_view>> keys(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    for (i64 j = 1; j < file->first_global; j++)
+      if (file->symbols[j]->write_to_symtab)
+        keys[i].push_back(file->symbols[j]->name());
+  });
+
+  ConcurrentMap<Leader> map;
+  std::vector<std::vector<Leader *>> leaders = elect_leaders(map, keys);
+
+  auto is_leader = [&](i64 i, i64 j) {
+    return leaders[i][j]->rank == get_rank(i, j);
+  };
+
+  // Assign offsets to leader names within each file.
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    file->local_strtab_offsets.resize(keys[i].size());
+
+    i64 offset = 0;
+    for (i64 j = 0; j < keys[i].size(); j++) {
+      if (is_leader(i, j)) {
+        file->local_strtab_offsets[j] = offset;
+        offset += keys[i][j].size() + 1;
+      } else {
+        file->strtab_size -= keys[i][j].size() + 1;
+      }
+    }
+  });
+
   this->shdr.sh_size = 1;
   for (ObjectFile<E> *file : ctx.objs) {
     file->strtab_offset = this->shdr.sh_size;
     this->shdr.sh_size += file->strtab_size;
   }
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    for (i64 j = 0; j < keys[i].size(); j++)
+      if (is_leader(i, j))
+        file->local_strtab_offsets[j] += file->strtab_offset;
+  });
+
+  // Other names refer to their leaders.
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    for (i64 j = 0; j < keys[i].size(); j++) {
+      u64 rank = leaders[i][j]->rank;
+      if (!is_leader(i, j))
+        file->local_strtab_offsets[j] =
+          ctx.objs[rank >> 32]->local_strtab_offsets[(u32)rank];
+    }
+  });
 }
 
 template <typename E>
@@ -386,19 +627,28 @@ void DynstrSection<E>::copy_buf(Context<E> &ctx) {
   for (std::pair<std::string_view, i64> pair : strings)
     write_string(base + pair.second, pair.first);
 
-  if (!ctx.dynsym->symbols.empty()) {
-    i64 offset = dynsym_offset;
-    for (Symbol<E> *sym :
-           std::span<Symbol<E> *>(ctx.dynsym->symbols).subspan(1)) {
-      write_string(base + offset, sym->name());
-      offset += sym->name().size() + 1;
-    }
-  }
+  std::vector<Symbol<E> *> &syms = ctx.dynsym->symbols;
+  tbb::parallel_for((i64)1, (i64)syms.size(), [&](i64 i) {
+    write_string(base + ctx.dynsym->name_offsets[i], syms[i]->name());
+  });
+}
+
+// With --emit-relocs, relocations against local symbols that are not
+// in .symtab are rewritten to refer to section symbols. We write a
+// section symbol for each output section right after the null symbol,
+// so that the index of a section symbol is its section index.
+template <typename E>
+static i64 get_num_section_symbols(Context<E> &ctx) {
+  i64 n = 0;
+  if (ctx.arg.emit_relocs)
+    for (Chunk<E> *chunk : ctx.chunks)
+      n = std::max(n, chunk->shndx);
+  return n;
 }
 
 template <typename E>
 void SymtabSection<E>::update_shdr(Context<E> &ctx) {
-  this->shdr.sh_size = sizeof(ElfSym<E>);
+  this->shdr.sh_size = sizeof(ElfSym<E>) * (get_num_section_symbols(ctx) + 1);
 
   for (ObjectFile<E> *file : ctx.objs) {
     file->local_symtab_offset = this->shdr.sh_size;
@@ -413,18 +663,34 @@ void SymtabSection<E>::update_shdr(Context<E> &ctx) {
   this->shdr.sh_info = ctx.objs[0]->global_symtab_offset / sizeof(ElfSym<E>);
   this->shdr.sh_link = ctx.strtab->shndx;
 
-  if (this->shdr.sh_size == sizeof(ElfSym<E>))
+  if (this->shdr.sh_size == sizeof(ElfSym<E>) && !ctx.arg.emit_relocs)
     this->shdr.sh_size = 0;
 
+  if (ctx.arg.emit_relocs)
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+      file->compute_output_sym_indices(ctx);
+    });
+
   static Counter counter("symtab");
   counter += this->shdr.sh_size / sizeof(ElfSym<E>);
 }
 
 template <typename E>
 void SymtabSection<E>::copy_buf(Context<E> &ctx) {
-  memset(ctx.buf + this->shdr.sh_offset, 0, sizeof(ElfSym<E>));
+  ElfSym<E> *syms = (ElfSym<E> *)(ctx.buf + this->shdr.sh_offset);
+  i64 num_section_syms = get_num_section_symbols(ctx);
+  memset(syms, 0, sizeof(ElfSym<E>) * (num_section_syms + 1));
   ctx.buf[ctx.strtab->shdr.sh_offset] = '\0';
 
+  for (Chunk<E> *chunk : ctx.chunks) {
+    if (chunk->shndx && num_section_syms) {
+      ElfSym<E> &esym = syms[chunk->shndx];
+      esym.st_type = STT_SECTION;
+      esym.st_shndx = chunk->shndx;
+      esym.st_value = chunk->shdr.sh_addr;
+    }
+  }
+
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     file->write_symtab(ctx);
   });
@@ -476,6 +742,12 @@ static std::vector<typename E::WordTy> create_dynamic_section(Context<E> &ctx) {
     define(E::is_rel ? DT_RELENT : DT_RELAENT, sizeof(ElfRel<E>));
   }
 
+  if (ctx.relrdyn && ctx.relrdyn->shdr.sh_size) {
+    define(DT_RELR, ctx.relrdyn->shdr.sh_addr);
+    define(DT_RELRSZ, ctx.relrdyn->shdr.sh_size);
+    define(DT_RELRENT, E::wordsize);
+  }
+
   if (ctx.relplt->shdr.sh_size) {
     define(DT_JMPREL, ctx.relplt->shdr.sh_addr);
     define(DT_PLTRELSZ, ctx.relplt->shdr.sh_size);
@@ -625,6 +897,7 @@ static std::string_view get_output_name(Context<E> &ctx, std::string_view name)
   static std::string_view prefixes[] = {
     ".text.", ".data.rel.ro.", ".data.", ".rodata.", ".bss.rel.ro.", ".bss.",
     ".init_array.", ".fini_array.", ".tbss.", ".tdata.", ".gcc_except_table.",
+    ".ldata.rel.ro.", ".ldata.", ".lrodata.", ".lbss.",
   };
 
   for (std::string_view prefix : prefixes) {
@@ -689,32 +962,22 @@ OutputSection<E>::get_instance(Context<E> &ctx, std::string_view name,
   type = canonicalize_type(name, type);
   flags = flags & ~(u64)SHF_GROUP & ~(u64)SHF_COMPRESSED;
 
-  auto find = [&]() -> OutputSection<E> * {
+  // Create a new output section. This is called with the map's mutex
+  // held. We search for an existing one first, because we may be here
+  // after the map is full.
+  auto create = [&]() -> OutputSection<E> * {
     for (std::unique_ptr<OutputSection<E>> &osec : ctx.output_sections)
       if (name == osec->name && type == osec->shdr.sh_type &&
           flags == osec->shdr.sh_flags)
         return osec.get();
-    return nullptr;
-  };
 
-  static std::shared_mutex mu;
-
-  // Search for an exiting output section.
-  {
-    std::shared_lock lock(mu);
-    if (OutputSection<E> *osec = find())
-      return osec;
-  }
-
-  // Create a new output section.
-  std::unique_lock lock(mu);
-  if (OutputSection<E> *osec = find())
+    OutputSection<E> *osec = new OutputSection(name, type, flags,
+                                               ctx.output_sections.size());
+    ctx.output_sections.push_back(std::unique_ptr<OutputSection<E>>(osec));
     return osec;
+  };
 
-  OutputSection<E> *osec = new OutputSection(name, type, flags,
-                                             ctx.output_sections.size());
-  ctx.output_sections.push_back(std::unique_ptr<OutputSection<E>>(osec));
-  return osec;
+  return ctx.output_section_map.get(name, type, flags, create);
 }
 
 template <typename E>
@@ -726,74 +989,152 @@ void OutputSection<E>::copy_buf(Context<E> &ctx) {
 template <typename E>
 void OutputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+    write_members(ctx, buf, i, i + 1);
+  });
+}
+
+// Returns true if a given section consists only of zeros and needs no
+// relocation, such as a large zero-initialized array in .data.
+template <typename E>
+static bool is_all_zero(Context<E> &ctx, InputSection<E> &isec) {
+  std::string_view data = isec.contents;
+  return !isec.compress_type && !data.empty() && data[0] == 0 &&
+         memcmp(data.data(), data.data() + 1, data.size() - 1) == 0 &&
+         isec.get_rels(ctx).empty();
+}
+
+// Writes members[begin, end) and their trailing padding to buf.
+//
+// Allocated sections are always written to the output file. If it is
+// known to be zero-filled, we don't write padding or all-zero members
+// so that we don't touch their pages at all.
+template <typename E>
+void OutputSection<E>::write_members(Context<E> &ctx, u8 *buf, i64 begin,
+                                     i64 end) {
+  bool zero_filled = (this->shdr.sh_flags & SHF_ALLOC) &&
+                     ctx.output_file->is_zero_filled;
+
+  for (i64 i = begin; i < end; i++) {
     // Copy section contents to an output file
     InputSection<E> &isec = *members[i];
-    isec.write_to(ctx, buf + isec.offset);
+    if (!zero_filled || !is_all_zero(ctx, isec)) {
+      CostTimer t(ctx.arg.perf_files, isec.file.copy_time);
+      isec.write_to(ctx, buf + isec.offset);
+    }
 
     // Zero-clear trailing padding
-    u64 this_end = isec.offset + isec.shdr.sh_size;
-    u64 next_start = (i == members.size() - 1) ?
-      this->shdr.sh_size : members[i + 1]->offset;
-    memset(buf + this_end, 0, next_start - this_end);
-  });
-}
+    if (!zero_filled) {
+      u64 this_end = isec.offset + isec.shdr.sh_size;
+      u64 next_start = (i == members.size() - 1) ?
+        this->shdr.sh_size : members[i + 1]->offset;
+      memset(buf + this_end, 0, next_start - this_end);
+    }
+  }
 
-template <typename E>
-void GotSection<E>::add_got_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  sym->set_got_idx(ctx, this->shdr.sh_size / E::wordsize);
-  this->shdr.sh_size += E::wordsize;
-  got_syms.push_back(sym);
+  // Range extension thunks are placed in padding between members, so
+  // they have to be written after the padding is cleared.
+  if constexpr (std::is_same_v<E, AARCH64>) {
+    if (thunks.empty() || begin == end)
+      return;
+
+    i64 lo = members[begin]->offset;
+    i64 hi = (end == members.size()) ?
+      this->shdr.sh_size : members[end]->offset;
+
+    auto it = std::partition_point(thunks.begin(), thunks.end(),
+                                   [&](auto &thunk) {
+      return thunk->offset < lo;
+    });
 
-  if (sym->is_imported)
-    ctx.dynsym->add_symbol(ctx, sym);
+    for (; it != thunks.end() && (*it)->offset < hi; it++)
+      (*it)->write_to(ctx, buf);
+  }
 }
 
+// Collects base relocations that go to .relr.dyn.
 template <typename E>
-void GotSection<E>::add_gottp_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  sym->set_gottp_idx(ctx, this->shdr.sh_size / E::wordsize);
-  this->shdr.sh_size += E::wordsize;
-  gottp_syms.push_back(sym);
+void OutputSection<E>::construct_relr(Context<E> &ctx) {
+  if (!(this->shdr.sh_flags & SHF_ALLOC))
+    return;
+
+  std::vector<std::vector<u64>> shards(members.size());
 
-  if (sym->is_imported)
-    ctx.dynsym->add_symbol(ctx, sym);
+  tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+    InputSection<E> &isec = *members[i];
+    std::span<ElfRel<E>> rels = isec.get_rels(ctx);
+    for (i64 j = 0; j < rels.size(); j++)
+      if (isec.needs_baserel(j) && isec.is_relr_reloc(ctx, rels[j]))
+        shards[i].push_back(isec.offset + rels[j].r_offset);
+    sort(shards[i]);
+  });
+
+  std::vector<u64> pos = flatten(shards);
+  relr = encode_relr<E>(pos);
 }
 
+// Writes the [offset, offset + size) part of this section to buf.
+// This is used to compress a debug section without rendering the
+// entire section to memory. Relocations are applied to an input
+// section as a whole, so a member that straddles the range boundary
+// is rendered to a temporary buffer first.
 template <typename E>
-void GotSection<E>::add_tlsgd_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  sym->set_tlsgd_idx(ctx, this->shdr.sh_size / E::wordsize);
-  this->shdr.sh_size += E::wordsize * 2;
-  tlsgd_syms.push_back(sym);
-  ctx.dynsym->add_symbol(ctx, sym);
+void OutputSection<E>::write_range(Context<E> &ctx, u8 *buf, i64 offset,
+                                   i64 size) {
+  i64 end = offset + size;
+  memset(buf, 0, size);
+
+  auto it = std::partition_point(members.begin(), members.end(),
+                                 [&](InputSection<E> *isec) {
+    return isec->offset + isec->shdr.sh_size <= offset;
+  });
+
+  for (; it != members.end() && (*it)->offset < end; it++) {
+    InputSection<E> &isec = **it;
+    i64 isec_begin = isec.offset;
+    i64 isec_end = isec.offset + isec.shdr.sh_size;
+
+    if (offset <= isec_begin && isec_end <= end) {
+      isec.write_to(ctx, buf + isec_begin - offset);
+      continue;
+    }
+
+    std::unique_ptr<u8[]> tmp(new u8[isec.shdr.sh_size]);
+    isec.write_to(ctx, tmp.get());
+
+    i64 lo = std::max(isec_begin, offset);
+    i64 hi = std::min(isec_end, end);
+    memcpy(buf + lo - offset, tmp.get() + lo - isec_begin, hi - lo);
+  }
 }
 
 template <typename E>
-void GotSection<E>::add_tlsdesc_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  sym->set_tlsdesc_idx(ctx, this->shdr.sh_size / E::wordsize);
-  this->shdr.sh_size += E::wordsize * 2;
-  tlsdesc_syms.push_back(sym);
-  ctx.dynsym->add_symbol(ctx, sym);
+u64 GotSection<E>::get_tlsld_addr(Context<E> &ctx) const {
+  assert(tlsld_idx != -1);
+  return this->shdr.sh_addr + tlsld_idx * E::wordsize;
 }
 
 template <typename E>
-void GotSection<E>::add_tlsld(Context<E> &ctx) {
-  if (tlsld_idx != -1)
-    return;
-  tlsld_idx = this->shdr.sh_size / E::wordsize;
-  this->shdr.sh_size += E::wordsize * 2;
+static bool has_got_baserel(Context<E> &ctx, Symbol<E> *sym) {
+  return !sym->is_imported && sym->get_type() != STT_GNU_IFUNC &&
+         ctx.arg.pic && sym->is_relative(ctx) && !ctx.relrdyn;
 }
 
+// Returns the number of R_RELATIVE relocations for .got.
 template <typename E>
-u64 GotSection<E>::get_tlsld_addr(Context<E> &ctx) const {
-  assert(tlsld_idx != -1);
-  return this->shdr.sh_addr + tlsld_idx * E::wordsize;
+i64 GotSection<E>::get_num_baserel(Context<E> &ctx) const {
+  i64 n = 0;
+  for (Symbol<E> *sym : got_syms)
+    if (has_got_baserel(ctx, sym))
+      n++;
+  return n;
 }
 
+// Returns the number of other dynamic relocations for .got.
 template <typename E>
-i64 GotSection<E>::get_reldyn_size(Context<E> &ctx) const {
+i64 GotSection<E>::get_num_dynrel(Context<E> &ctx) const {
   i64 n = 0;
   for (Symbol<E> *sym : got_syms)
-    if (sym->is_imported || (ctx.arg.pic && sym->is_relative(ctx)) ||
-        sym->get_type() == STT_GNU_IFUNC)
+    if (sym->is_imported || sym->get_type() == STT_GNU_IFUNC)
       n++;
 
   n += tlsgd_syms.size() * 2;
@@ -805,8 +1146,7 @@ i64 GotSection<E>::get_reldyn_size(Context<E> &ctx) const {
 
   if (tlsld_idx != -1)
     n++;
-
-  return n * sizeof(ElfRel<E>);
+  return n;
 }
 
 // Fill .got and .rel.dyn.
@@ -817,7 +1157,9 @@ void GotSection<E>::copy_buf(Context<E> &ctx) {
 
   memset(buf, 0, this->shdr.sh_size);
 
-  ElfRel<E> *rel = (ElfRel<E> *)(ctx.buf + ctx.reldyn->shdr.sh_offset);
+  u8 *reldyn = ctx.buf + ctx.reldyn->shdr.sh_offset;
+  ElfRel<E> *rel = (ElfRel<E> *)(reldyn + reldyn_offset);
+  ElfRel<E> *baserel = (ElfRel<E> *)(reldyn + baserel_offset);
 
   for (Symbol<E> *sym : got_syms) {
     u64 addr = sym->get_got_addr(ctx);
@@ -830,8 +1172,8 @@ void GotSection<E>::copy_buf(Context<E> &ctx) {
         buf[sym->get_got_idx(ctx)] = resolver_addr;
     } else {
       buf[sym->get_got_idx(ctx)] = sym->get_addr(ctx);
-      if (ctx.arg.pic && sym->is_relative(ctx))
-        *rel++ = reloc<E>(addr, E::R_RELATIVE, 0, (i64)sym->get_addr(ctx));
+      if (has_got_baserel(ctx, sym))
+        *baserel++ = reloc<E>(addr, E::R_RELATIVE, 0, (i64)sym->get_addr(ctx));
     }
   }
 
@@ -862,33 +1204,18 @@ void GotSection<E>::copy_buf(Context<E> &ctx) {
     *rel++ = reloc<E>(get_tlsld_addr(ctx), E::R_DTPMOD, 0);
 }
 
+// Base relocations for GOT entries go to .relr.dyn if -z
+// pack-relative-relocs is given.
 template <typename E>
-void PltSection<E>::add_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  assert(!sym->has_plt(ctx));
-
-  if (this->shdr.sh_size == 0) {
-    this->shdr.sh_size = E::plt_hdr_size;
-    ctx.gotplt->shdr.sh_size = E::wordsize * 3;
-  }
-
-  sym->set_plt_idx(ctx, this->shdr.sh_size / E::plt_size);
-  this->shdr.sh_size += E::plt_size;
-  symbols.push_back(sym);
-
-  sym->set_gotplt_idx(ctx, ctx.gotplt->shdr.sh_size / E::wordsize);
-  ctx.gotplt->shdr.sh_size += E::wordsize;
-  ctx.relplt->shdr.sh_size += sizeof(ElfRel<E>);
-  ctx.dynsym->add_symbol(ctx, sym);
-}
-
-template <typename E>
-void PltGotSection<E>::add_symbol(Context<E> &ctx, Symbol<E> *sym) {
-  assert(!sym->has_plt(ctx));
-  assert(sym->has_got(ctx));
+void GotSection<E>::construct_relr(Context<E> &ctx) {
+  std::vector<u64> pos;
+  for (Symbol<E> *sym : got_syms)
+    if (!sym->is_imported && sym->get_type() != STT_GNU_IFUNC &&
+        sym->is_relative(ctx))
+      pos.push_back(sym->get_got_idx(ctx) * E::wordsize);
 
-  sym->set_pltgot_idx(ctx, this->shdr.sh_size / E::pltgot_size);
-  this->shdr.sh_size += E::pltgot_size;
-  symbols.push_back(sym);
+  sort(pos);
+  relr = encode_relr<E>(pos);
 }
 
 template <typename E>
@@ -915,6 +1242,74 @@ void DynsymSection<E>::add_symbol(Context<E> &ctx, Symbol<E> *sym) {
   symbols.push_back(sym);
 }
 
+// Sorts global dynamic symbols by .gnu.hash bucket. We need a stable
+// sort for build reproducibility, so we use a counting sort. Input is
+// split into shards, and each shard counts its symbols per bucket so
+// that all shards can write their symbols to the final places in
+// parallel.
+template <typename E>
+static void sort_by_gnu_hash(Context<E> &ctx, i64 global_offset) {
+  GnuHashSection<E> &gnu_hash = *ctx.gnu_hash;
+  std::span<Symbol<E> *> syms =
+    std::span<Symbol<E> *>(ctx.dynsym->symbols).subspan(global_offset);
+
+  i64 num_globals = syms.size();
+  i64 num_buckets = num_globals / gnu_hash.LOAD_FACTOR + 1;
+  gnu_hash.num_buckets = num_buckets;
+
+  std::vector<u32> hashes(num_globals);
+  tbb::parallel_for((i64)0, num_globals, [&](i64 i) {
+    hashes[i] = djb_hash(syms[i]->name());
+  });
+
+  i64 shard_size = std::max<i64>(num_globals / 16 + 1, 4096);
+  i64 num_shards = (num_globals + shard_size - 1) / shard_size;
+  std::vector<u32> counts(num_shards * num_buckets);
+
+  tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+    i64 end = std::min<i64>((i + 1) * shard_size, num_globals);
+    u32 *cnt = counts.data() + i * num_buckets;
+    for (i64 j = i * shard_size; j < end; j++)
+      cnt[hashes[j] % num_buckets]++;
+  });
+
+  // Compute the first output index of each (bucket, shard) pair.
+  std::vector<u32> bucket_offsets(num_buckets + 1);
+  tbb::parallel_for((i64)0, num_buckets, [&](i64 i) {
+    for (i64 j = 0; j < num_shards; j++)
+      bucket_offsets[i + 1] += counts[j * num_buckets + i];
+  });
+
+  for (i64 i = 1; i < num_buckets + 1; i++)
+    bucket_offsets[i] += bucket_offsets[i - 1];
+
+  tbb::parallel_for((i64)0, num_buckets, [&](i64 i) {
+    u32 offset = bucket_offsets[i];
+    for (i64 j = 0; j < num_shards; j++) {
+      u32 n = counts[j * num_buckets + i];
+      counts[j * num_buckets + i] = offset;
+      offset += n;
+    }
+  });
+
+  std::vector<Symbol<E> *> sorted(num_globals);
+  gnu_hash.hashes.resize(num_globals);
+
+  tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+    i64 end = std::min<i64>((i + 1) * shard_size, num_globals);
+    u32 *cnt = counts.data() + i * num_buckets;
+    for (i64 j = i * shard_size; j < end; j++) {
+      u32 idx = cnt[hashes[j] % num_buckets]++;
+      sorted[idx] = syms[j];
+      gnu_hash.hashes[idx] = hashes[j];
+    }
+  });
+
+  tbb::parallel_for((i64)0, num_globals, [&](i64 i) {
+    syms[i] = sorted[i];
+  });
+}
+
 template <typename E>
 void DynsymSection<E>::finalize(Context<E> &ctx) {
   Timer t(ctx, "DynsymSection::finalize");
@@ -930,39 +1325,31 @@ void DynsymSection<E>::finalize(Context<E> &ctx) {
 
   // If we have .gnu.hash section, we need to sort .dynsym contents by
   // symbol hashes.
-  if (ctx.gnu_hash) {
-    // We need a stable sort for build reproducibility, but parallel_sort
-    // isn't stable, so we use this struct to make it stable.
-    struct T {
-      Symbol<E> *sym;
-      u32 hash;
-      i32 idx;
-    };
-
-    std::vector<T> vec(num_globals);
-    ctx.gnu_hash->num_buckets = num_globals / ctx.gnu_hash->LOAD_FACTOR + 1;
-
-    tbb::parallel_for((i64)0, num_globals, [&](i64 i) {
-      Symbol<E> *sym = symbols[global_offset + i];
-      vec[i].sym = sym;
-      vec[i].hash = djb_hash(sym->name()) % ctx.gnu_hash->num_buckets;
-      vec[i].idx = i;
-    });
-
-    tbb::parallel_sort(vec.begin(), vec.end(), [&](const T &a, const T &b) {
-      return std::tuple(a.hash, a.idx) < std::tuple(b.hash, b.idx);
-    });
-
-    for (i64 i = 0; i < num_globals; i++)
-      symbols[global_offset + i] = vec[i].sym;
-  }
-
-  ctx.dynstr->dynsym_offset = ctx.dynstr->shdr.sh_size;
+  if (ctx.gnu_hash)
+    sort_by_gnu_hash(ctx, global_offset);
 
-  for (i64 i = 1; i < symbols.size(); i++) {
+  tbb::parallel_for((i64)1, (i64)symbols.size(), [&](i64 i) {
     symbols[i]->set_dynsym_idx(ctx, i);
-    ctx.dynstr->shdr.sh_size += symbols[i]->name().size() + 1;
-  }
+  });
+
+  // Symbol names are appended to .dynstr. Compute their offsets with
+  // a prefix sum so that .dynstr and .dynsym can be written in parallel.
+  i64 base = ctx.dynstr->shdr.sh_size;
+  name_offsets.resize(symbols.size());
+
+  ctx.dynstr->shdr.sh_size += tbb::parallel_scan(
+    tbb::blocked_range<i64>(1, symbols.size(), 10000),
+    (i64)0,
+    [&](const tbb::blocked_range<i64> &r, i64 sum, bool is_final) {
+      for (i64 i = r.begin(); i < r.end(); i++) {
+        if (is_final)
+          name_offsets[i] = base + sum;
+        sum += symbols[i]->name().size() + 1;
+      }
+      return sum;
+    },
+    std::plus<i64>(),
+    tbb::simple_partitioner());
 
   // ELF's symbol table sh_info holds the offset of the first global symbol.
   this->shdr.sh_info = global_offset;
@@ -978,9 +1365,8 @@ template <typename E>
 void DynsymSection<E>::copy_buf(Context<E> &ctx) {
   u8 *base = ctx.buf + this->shdr.sh_offset;
   memset(base, 0, sizeof(ElfSym<E>));
-  i64 name_offset = ctx.dynstr->dynsym_offset;
 
-  for (i64 i = 1; i < symbols.size(); i++) {
+  tbb::parallel_for((i64)1, (i64)symbols.size(), [&](i64 i) {
     Symbol<E> &sym = *symbols[i];
     ElfSym<E> &esym =
       *(ElfSym<E> *)(base + sym.get_dynsym_idx(ctx) * sizeof(ElfSym<E>));
@@ -998,8 +1384,7 @@ void DynsymSection<E>::copy_buf(Context<E> &ctx) {
     else
       esym.st_bind = sym.esym().st_bind;
 
-    esym.st_name = name_offset;
-    name_offset += sym.name().size() + 1;
+    esym.st_name = name_offsets[i];
 
     if (sym.has_copyrel) {
       esym.st_shndx = sym.copyrel_readonly
@@ -1023,7 +1408,7 @@ void DynsymSection<E>::copy_buf(Context<E> &ctx) {
       esym.st_value = sym.get_addr(ctx, false);
       esym.st_visibility = sym.visibility;
     }
-  }
+  });
 }
 
 template <typename E>
@@ -1049,12 +1434,25 @@ void HashSection<E>::copy_buf(Context<E> &ctx) {
 
   hdr[0] = hdr[1] = num_slots;
 
-  for (i64 i = 1; i < ctx.dynsym->symbols.size(); i++) {
+  // Each bucket refers to the symbol with the largest index in it, and
+  // the chain goes from there towards smaller indices. To build that in
+  // parallel, we sort symbol indices by bucket and link neighbors.
+  std::vector<std::pair<u32, u32>> vec(num_slots - 1);
+
+  tbb::parallel_for((i64)1, num_slots, [&](i64 i) {
     Symbol<E> *sym = ctx.dynsym->symbols[i];
-    i64 idx = elf_hash(sym->name()) % num_slots;
-    chains[sym->get_dynsym_idx(ctx)] = buckets[idx];
-    buckets[idx] = sym->get_dynsym_idx(ctx);
-  }
+    vec[i - 1] = {elf_hash(sym->name()) % num_slots, i};
+  });
+
+  tbb::parallel_sort(vec.begin(), vec.end());
+
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    auto [idx, symidx] = vec[i];
+    if (i > 0 && vec[i - 1].first == idx)
+      chains[symidx] = vec[i - 1].second;
+    if (i == vec.size() - 1 || vec[i + 1].first != idx)
+      buckets[idx] = symidx;
+  });
 }
 
 template <typename E>
@@ -1091,39 +1489,36 @@ void GnuHashSection<E>::copy_buf(Context<E> &ctx) {
   std::span<Symbol<E> *> symbols =
     std::span<Symbol<E> *>(ctx.dynsym->symbols).subspan(symoffset);
 
-  std::vector<u32> hashes(symbols.size());
-  for (i64 i = 0; i < symbols.size(); i++)
-    hashes[i] = djb_hash(symbols[i]->name());
+  assert(hashes.size() == symbols.size());
 
-  // Write a bloom filter
+  // Write a bloom filter. Multiple symbols may set bits in the same
+  // word, so we use atomic operations.
   typename E::WordTy *bloom = (typename E::WordTy *)(base + HEADER_SIZE);
-  for (i64 hash : hashes) {
+
+  tbb::parallel_for((i64)0, (i64)hashes.size(), [&](i64 i) {
+    u32 hash = hashes[i];
     i64 idx = (hash / ELFCLASS_BITS) % num_bloom;
-    bloom[idx] |= (u64)1 << (hash % ELFCLASS_BITS);
-    bloom[idx] |= (u64)1 << ((hash >> BLOOM_SHIFT) % ELFCLASS_BITS);
-  }
+    typename E::WordTy val = (u64)1 << (hash % ELFCLASS_BITS);
+    val |= (u64)1 << ((hash >> BLOOM_SHIFT) % ELFCLASS_BITS);
+    std::atomic_ref(bloom[idx]).fetch_or(val, std::memory_order_relaxed);
+  });
 
-  // Write hash bucket indices
+  // Write hash bucket indices and a hash table. Symbols are sorted by
+  // bucket, so each bucket refers to the first symbol of a run, and
+  // the last symbol of a run has the lowest bit set.
   u32 *buckets = (u32 *)(bloom + num_bloom);
-  for (i64 i = 0; i < hashes.size(); i++) {
+  u32 *table = buckets + num_buckets;
+
+  tbb::parallel_for((i64)0, (i64)symbols.size(), [&](i64 i) {
     i64 idx = hashes[i] % num_buckets;
-    if (!buckets[idx])
+    if (i == 0 || idx != hashes[i - 1] % num_buckets)
       buckets[idx] = i + symoffset;
-  }
 
-  // Write a hash table
-  u32 *table = buckets + num_buckets;
-  for (i64 i = 0; i < symbols.size(); i++) {
-    bool is_last = false;
-    if (i == symbols.size() - 1 ||
-        (hashes[i] % num_buckets) != (hashes[i + 1] % num_buckets))
-      is_last = true;
-
-    if (is_last)
+    if (i == symbols.size() - 1 || idx != hashes[i + 1] % num_buckets)
       table[i] = hashes[i] | 1;
     else
       table[i] = hashes[i] & ~1;
-  }
+  });
 }
 
 template <typename E>
@@ -1168,19 +1563,28 @@ MergedSection<E>::get_instance(Context<E> &ctx, std::string_view name,
 }
 
 template <typename E>
-Subsection<E> *
-MergedSection<E>::insert(std::string_view data, u64 hash, i64 alignment) {
-  assert(alignment < UINT16_MAX);
-
+void MergedSection<E>::init_map() {
   std::call_once(once_flag, [&]() {
     // We aim 2/3 occupation ratio
     map.resize(estimator.get_cardinality() * 3 / 2);
   });
+}
+
+template <typename E>
+Subsection<E> *
+MergedSection<E>::insert(std::string_view data, u64 hash, i64 alignment) {
+  assert(alignment < UINT16_MAX);
+  init_map();
 
   Subsection<E> *subsec;
   bool inserted;
   std::tie(subsec, inserted) = map.insert(data, hash, Subsection(this));
-  assert(subsec);
+
+  if (!subsec) {
+    // The hash table is full. The caller will grow it and retry.
+    is_full = true;
+    return nullptr;
+  }
 
   for (u16 cur = subsec->alignment; cur < alignment;)
     if (subsec->alignment.compare_exchange_weak(cur, alignment))
@@ -1188,8 +1592,95 @@ MergedSection<E>::insert(std::string_view data, u64 hash, i64 alignment) {
   return subsec;
 }
 
+// Inserts pieces of an input section and appends the results to `out`.
+// This is equivalent to calling insert() for each piece, but lookups
+// are software-pipelined: we prefetch the bucket of a piece 16 pieces
+// ahead and the key in the bucket 8 pieces ahead, so that most probes
+// hit the cache.
+template <typename E>
+void MergedSection<E>::insert(std::span<std::string_view> data,
+                              std::span<u64> hashes, i64 alignment,
+                              std::vector<Subsection<E> *> &out) {
+  static constexpr i64 DIST = 16;
+  init_map();
+
+  for (i64 i = 0; i < data.size(); i++) {
+    if (i + DIST < data.size())
+      map.prefetch(hashes[i + DIST]);
+    if (i + DIST / 2 < data.size())
+      map.prefetch_key(hashes[i + DIST / 2]);
+    out.push_back(insert(data[i], hashes[i], alignment));
+  }
+}
+
+// Doubles the size of the hash table. Existing entries are discarded,
+// so all pieces have to be inserted again.
+template <typename E>
+void MergedSection<E>::grow() {
+  map.resize(map.nbuckets * 2);
+  is_full = false;
+
+  static Counter counter("merged_section_grow");
+  counter++;
+}
+
+// If -O2 is given, we merge a string into another string if the former
+// is a suffix of the latter (e.g. "bar" can be placed at the end of
+// "foobar"). To find such pairs, we sort strings by their reversed
+// contents in descending order. Then, if a string is a suffix of some
+// other string, it is a suffix of the string immediately preceding it.
+//
+// A string and its host are usually in different shards, so we sort
+// strings of all shards together rather than shard by shard.
+template <typename E>
+void MergedSection<E>::tail_merge(Context<E> &ctx) {
+  struct KeyVal {
+    std::string_view key;
+    Subsection<E> *val;
+  };
+
+  // Collect strings. Strings with a larger alignment requirement can't
+  // be placed at an arbitrary offset, so they are not merged.
+  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
+  std::vector<std::vector<KeyVal>> vec(map.NUM_SHARDS);
+
+  tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
+      if (Subsection<E> &subsec = map.values[j];
+          subsec.is_alive && subsec.alignment == 1)
+        vec[i].push_back({{map.keys[j], map.sizes[j]}, &subsec});
+  });
+
+  std::vector<KeyVal> strings = flatten(vec);
+
+  tbb::parallel_sort(strings.begin(), strings.end(),
+                     [](const KeyVal &a, const KeyVal &b) {
+    return std::lexicographical_compare(b.key.rbegin(), b.key.rend(),
+                                        a.key.rbegin(), a.key.rend());
+  });
+
+  for (i64 i = 1, host = 0; i < strings.size(); i++) {
+    if (!strings[i - 1].key.ends_with(strings[i].key)) {
+      host = i;
+      continue;
+    }
+
+    Subsection<E> &subsec = *strings[i].val;
+    subsec.is_tail_merged = true;
+    tail_merged.push_back({&subsec, strings[host].val,
+                           (i64)(strings[host].key.size() -
+                                 strings[i].key.size())});
+  }
+
+  static Counter counter("tail_merged_strings");
+  counter += tail_merged.size();
+}
+
 template <typename E>
 void MergedSection<E>::assign_offsets(Context<E> &ctx) {
+  if (ctx.arg.tail_merge_strings && !has_non_strings)
+    tail_merge(ctx);
+
   std::vector<i64> sizes(map.NUM_SHARDS);
   std::vector<i64> max_alignments(map.NUM_SHARDS);
   shard_offsets.resize(map.NUM_SHARDS + 1);
@@ -1197,45 +1688,55 @@ void MergedSection<E>::assign_offsets(Context<E> &ctx) {
   i64 shard_size = map.nbuckets / map.NUM_SHARDS;
 
   tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
-    struct KeyVal {
-      std::string_view key;
-      Subsection<E> *val;
+    struct Entry {
+      u16 alignment;
+      u64 hash;
+      i64 idx;
     };
 
-    std::vector<KeyVal> subsections;
-    subsections.reserve(shard_size);
+    std::vector<Entry> entries;
+    entries.reserve(shard_size);
 
-    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
-      if (Subsection<E> &subsec = map.values[j]; subsec.is_alive)
-        subsections.push_back({{map.keys[j], map.sizes[j]}, &subsec});
-
-    // Sort subsections to make output deterministic.
-    tbb::parallel_sort(subsections.begin(), subsections.end(),
-                       [](const KeyVal &a, const KeyVal &b) {
-      if (a.val->alignment != b.val->alignment)
-        return a.val->alignment < b.val->alignment;
-      if (a.key.size() != b.key.size())
-        return a.key.size() < b.key.size();
-      return a.key < b.key;
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++) {
+      Subsection<E> &subsec = map.values[j];
+      if (subsec.is_alive && !subsec.is_tail_merged) {
+        std::string_view key(map.keys[j], map.sizes[j]);
+        entries.push_back({subsec.alignment, hash_string(key), j});
+      }
+    }
+
+    // Sort subsections to make output deterministic. Bucket order isn't
+    // deterministic because concurrent insertions may take buckets in
+    // any order. We sort by alignment to minimize padding and then by
+    // content hash, which doesn't need string comparisons except for
+    // the extremely rare case of a hash collision.
+    tbb::parallel_sort(entries.begin(), entries.end(),
+                       [&](const Entry &a, const Entry &b) {
+      if (a.alignment != b.alignment)
+        return a.alignment < b.alignment;
+      if (a.hash != b.hash)
+        return a.hash < b.hash;
+      return std::string_view(map.keys[a.idx], map.sizes[a.idx]) <
+             std::string_view(map.keys[b.idx], map.sizes[b.idx]);
     });
 
     // Assign offsets.
     i64 offset = 0;
     i64 max_alignment = 0;
 
-    for (KeyVal &kv : subsections) {
-      Subsection<E> &subsec = *kv.val;
-      offset = align_to(offset, subsec.alignment);
+    for (Entry &ent : entries) {
+      Subsection<E> &subsec = map.values[ent.idx];
+      offset = align_to(offset, ent.alignment);
       subsec.offset = offset;
-      offset += kv.key.size();
-      max_alignment = std::max<i64>(max_alignment, subsec.alignment);
+      offset += map.sizes[ent.idx];
+      max_alignment = std::max<i64>(max_alignment, ent.alignment);
     }
 
     sizes[i] = offset;
     max_alignments[i] = max_alignment;
 
     static Counter merged_strings("merged_strings");
-    merged_strings += subsections.size();
+    merged_strings += entries.size();
   });
 
   i64 alignment = 1;
@@ -1248,10 +1749,15 @@ void MergedSection<E>::assign_offsets(Context<E> &ctx) {
 
   tbb::parallel_for((i64)1, map.NUM_SHARDS, [&](i64 i) {
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
-      if (Subsection<E> &subsec = map.values[j]; subsec.is_alive)
+      if (Subsection<E> &subsec = map.values[j];
+          subsec.is_alive && !subsec.is_tail_merged)
         subsec.offset += shard_offsets[i];
   });
 
+  tbb::parallel_for_each(tail_merged, [](TailMerged &x) {
+    x.subsec->offset = x.host->offset + x.offset;
+  });
+
   this->shdr.sh_size = shard_offsets[map.NUM_SHARDS];
   this->shdr.sh_addralign = alignment;
 }
@@ -1263,17 +1769,45 @@ void MergedSection<E>::copy_buf(Context<E> &ctx) {
 
 template <typename E>
 void MergedSection<E>::write_to(Context<E> &ctx, u8 *buf) {
-  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
-
-  tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
-    memset(buf + shard_offsets[i], 0, shard_offsets[i + 1] - shard_offsets[i]);
+  // If the section alignment is 1, pieces are laid out with no gap
+  // between them, so there's no padding to clear. This is usually the
+  // case for .debug_str, which can be very large.
+  if (this->shdr.sh_addralign > 1) {
+    tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
+      memset(buf + shard_offsets[i], 0, shard_offsets[i + 1] - shard_offsets[i]);
+    });
+  }
 
-    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
-      if (Subsection<E> &subsec = map.values[j]; subsec.is_alive)
+  // Pieces are copied in ranges of buckets rather than per shard, so
+  // that a single huge section can keep all threads busy. Pieces may
+  // be distributed unevenly across buckets, so we let TBB split the
+  // ranges further as needed.
+  tbb::parallel_for(tbb::blocked_range<i64>(0, map.nbuckets, 4096),
+                    [&](const tbb::blocked_range<i64> &r) {
+    for (i64 j = r.begin(); j < r.end(); j++)
+      if (Subsection<E> &subsec = map.values[j];
+          subsec.is_alive && !subsec.is_tail_merged)
         memcpy(buf + subsec.offset, map.keys[j], map.sizes[j]);
   });
 }
 
+// Returns a string that uniquely identifies the contents of a given
+// CIE including its relocations.
+template <typename E>
+static std::string get_cie_key(CieRecord<E> &cie) {
+  std::string key(cie.get_contents());
+  for (ElfRel<E> &rel : cie.get_rels()) {
+    u64 vals[] = {
+      rel.r_offset - cie.input_offset,
+      rel.r_type,
+      (u64)cie.file.symbols[rel.r_sym],
+      (u64)cie.input_section.get_addend(rel),
+    };
+    key.append((char *)vals, sizeof(vals));
+  }
+  return key;
+}
+
 template <typename E>
 void EhFrameSection<E>::construct(Context<E> &ctx) {
   // Remove dead FDEs and assign them offsets within their corresponding
@@ -1289,30 +1823,57 @@ void EhFrameSection<E>::construct(Context<E> &ctx) {
     file->fde_size = offset;
   });
 
-  // Uniquify CIEs and assign offsets to them.
-  std::vector<CieRecord<E> *> leaders;
-  auto find_leader = [&](CieRecord<E> &cie) -> CieRecord<E> * {
-    for (CieRecord<E> *leader : leaders)
-      if (cie.equals(*leader))
-        return leader;
-    return nullptr;
-  };
+  // Uniquify CIEs. Two CIEs are identical if they have the same
+  // contents and relocations, so we serialize them to strings and
+  // use them as keys to elect leaders.
+  std::vector<std::vector<std::string>> keys(ctx.objs.size());
 
-  i64 offset = 0;
-  for (ObjectFile<E> *file : ctx.objs) {
-    for (CieRecord<E> &cie : file->cies) {
-      if (CieRecord<E> *leader = find_leader(cie)) {
-        cie.output_offset = leader->output_offset;
-      } else {
-        cie.output_offset = offset;
-        cie.is_leader = true;
-        offset += cie.size();
-        leaders.push_back(&cie);
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    for (CieRecord<E> &cie : ctx.objs[i]->cies)
+      keys[i].push_back(get_cie_key(cie));
+  });
+
+  ConcurrentMap<Leader> map;
+  std::vector<std::vector<Leader *>> groups = elect_leaders(map, keys);
+
+  // Assign offsets to leader CIEs.
+  std::vector<i64> cie_offsets(ctx.objs.size() + 1);
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    std::vector<CieRecord<E>> &cies = ctx.objs[i]->cies;
+    i64 offset = 0;
+    for (i64 j = 0; j < cies.size(); j++) {
+      if (groups[i][j]->rank == get_rank(i, j)) {
+        cies[j].is_leader = true;
+        cies[j].output_offset = offset;
+        offset += cies[j].size();
       }
     }
-  }
+    cie_offsets[i + 1] = offset;
+  });
+
+  for (i64 i = 1; i < ctx.objs.size() + 1; i++)
+    cie_offsets[i] += cie_offsets[i - 1];
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    for (CieRecord<E> &cie : ctx.objs[i]->cies)
+      if (cie.is_leader)
+        cie.output_offset += cie_offsets[i];
+  });
+
+  // Non-leader CIEs share their leaders' offsets.
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    std::vector<CieRecord<E>> &cies = ctx.objs[i]->cies;
+    for (i64 j = 0; j < cies.size(); j++) {
+      u64 rank = groups[i][j]->rank;
+      if (rank != get_rank(i, j))
+        cies[j].output_offset =
+          ctx.objs[rank >> 32]->cies[(u32)rank].output_offset;
+    }
+  });
 
   // Assign FDE offsets to files.
+  i64 offset = cie_offsets.back();
   i64 idx = 0;
   for (ObjectFile<E> *file : ctx.objs) {
     file->fde_idx = idx;
@@ -1383,6 +1944,29 @@ void EhFrameHdrSection<E>::update_shdr(Context<E> &ctx) {
   this->shdr.sh_size = HEADER_SIZE + num_fdes * 8;
 }
 
+// Merges two sorted arrays into `out`. If the arrays are large, they
+// are split at the median of the larger one and merged in parallel.
+template <typename T, typename Less>
+static void parallel_merge(T *a, i64 na, T *b, i64 nb, T *out, Less less) {
+  if (na < nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+
+  if (na + nb < 10000) {
+    std::merge(a, a + na, b, b + nb, out, less);
+    return;
+  }
+
+  i64 ma = na / 2;
+  i64 mb = std::lower_bound(b, b + nb, a[ma], less) - b;
+
+  tbb::parallel_invoke(
+    [&] { parallel_merge(a, ma, b, mb, out, less); },
+    [&] { parallel_merge(a + ma, na - ma, b + mb, nb - mb, out + ma + mb,
+                         less); });
+}
+
 template <typename E>
 void EhFrameHdrSection<E>::copy_buf(Context<E> &ctx) {
   u8 *base = ctx.buf + this->shdr.sh_offset;
@@ -1403,29 +1987,81 @@ void EhFrameHdrSection<E>::copy_buf(Context<E> &ctx) {
     i32 fde_addr;
   };
 
-  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-    Entry *entries = (Entry *)(base + HEADER_SIZE) + file->fde_idx;
+  auto less = [](const Entry &a, const Entry &b) {
+    return a.init_addr < b.init_addr;
+  };
+
+  std::vector<Entry> vec(num_fdes);
+  std::vector<std::vector<i64>> breaks(ctx.objs.size());
 
-    for (i64 i = 0; i < file->fdes.size(); i++) {
-      FdeRecord<E> &fde = file->fdes[i];
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    Entry *entries = vec.data() + file->fde_idx;
+
+    for (i64 j = 0; j < file->fdes.size(); j++) {
+      FdeRecord<E> &fde = file->fdes[j];
 
       ElfRel<E> &rel = fde.cie->rels[fde.rel_idx];
       u64 val = file->symbols[rel.r_sym]->get_addr(ctx);
       u64 addend = fde.cie->input_section.get_addend(rel);
       i64 offset = file->fde_offset + fde.output_offset;
 
-      entries[i].init_addr = val + addend - this->shdr.sh_addr;
-      entries[i].fde_addr = eh_frame_addr + offset - this->shdr.sh_addr;
+      entries[j].init_addr = val + addend - this->shdr.sh_addr;
+      entries[j].fde_addr = eh_frame_addr + offset - this->shdr.sh_addr;
+
+      if (j > 0 && less(entries[j], entries[j - 1]))
+        breaks[i].push_back(file->fde_idx + j);
     }
   });
 
-  // Sort contents
-  Entry *begin = (Entry *)(base + HEADER_SIZE);
-  Entry *end = begin + num_fdes;
+  // Input sections are usually laid out in the input file order, so
+  // the table is mostly sorted already. We split it into ascending runs
+  // and merge them pairwise, so that the output buffer is written
+  // sequentially only once.
+  std::vector<i64> runs = {0};
+  for (i64 i = 0; i < ctx.objs.size(); i++) {
+    i64 idx = ctx.objs[i]->fde_idx;
+    if (runs.back() < idx && idx < num_fdes && less(vec[idx], vec[idx - 1]))
+      runs.push_back(idx);
+    append(runs, breaks[i]);
+  }
+  runs.push_back(num_fdes);
 
-  tbb::parallel_sort(begin, end, [](const Entry &a, const Entry &b) {
-    return a.init_addr < b.init_addr;
-  });
+  Entry *out = (Entry *)(base + HEADER_SIZE);
+  if (runs.size() <= 2) {
+    memcpy(out, vec.data(), num_fdes * sizeof(Entry));
+    return;
+  }
+
+  std::vector<Entry> vec2(num_fdes);
+  Entry *src = vec.data();
+  Entry *dst = vec2.data();
+
+  while (runs.size() > 2) {
+    if (runs.size() <= 3)
+      dst = out;
+
+    i64 num_runs = runs.size() - 1;
+
+    tbb::parallel_for((i64)0, num_runs, (i64)2, [&](i64 i) {
+      i64 begin = runs[i];
+      i64 mid = runs[i + 1];
+      if (i + 1 == num_runs) {
+        memcpy(dst + begin, src + begin, (mid - begin) * sizeof(Entry));
+        return;
+      }
+      i64 end = runs[i + 2];
+      parallel_merge(src + begin, mid - begin, src + mid, end - mid,
+                     dst + begin, less);
+    });
+
+    std::vector<i64> next;
+    for (i64 i = 0; i < num_runs; i += 2)
+      next.push_back(runs[i]);
+    next.push_back(num_fdes);
+    runs = std::move(next);
+    std::swap(src, dst);
+  }
 }
 
 template <typename E>
@@ -1459,7 +2095,18 @@ template <typename E>
 void VerneedSection<E>::construct(Context<E> &ctx) {
   Timer t(ctx, "fill_verneed");
 
-  if (ctx.dynsym->symbols.empty())
+  // glibc's dynamic loader refuses to load an object containing
+  // .relr.dyn unless the object depends on GLIBC_ABI_DT_RELR of libc.
+  SharedFile<E> *libc = nullptr;
+  if (ctx.relrdyn) {
+    for (SharedFile<E> *file : ctx.dsos) {
+      std::vector<std::string_view> &vec = file->version_strings;
+      if (std::find(vec.begin(), vec.end(), "GLIBC_ABI_DT_RELR") != vec.end())
+        libc = file;
+    }
+  }
+
+  if (ctx.dynsym->symbols.empty() && !libc)
     return;
 
   // Create a list of versioned symbols and sort by file and version.
@@ -1470,7 +2117,7 @@ void VerneedSection<E>::construct(Context<E> &ctx) {
     return !sym->file->is_dso || sym->ver_idx <= VER_NDX_LAST_RESERVED;
   });
 
-  if (syms.empty())
+  if (syms.empty() && !libc)
     return;
 
   sort(syms, [](Symbol<E> *a, Symbol<E> *b) {
@@ -1484,7 +2131,7 @@ void VerneedSection<E>::construct(Context<E> &ctx) {
 
   // Allocate a large enough buffer for .gnu.version_r.
   contents.resize((sizeof(ElfVerneed<E>) + sizeof(ElfVernaux<E>)) *
-                  syms.size());
+                  (syms.size() + 1));
 
   // Fill .gnu.version_r.
   u8 *buf = (u8 *)&contents[0];
@@ -1507,7 +2154,7 @@ void VerneedSection<E>::construct(Context<E> &ctx) {
     aux = nullptr;
   };
 
-  auto add_entry = [&](Symbol<E> *sym) {
+  auto add_entry = [&](std::string_view verstr) {
     verneed->vn_cnt++;
 
     if (aux)
@@ -1515,21 +2162,56 @@ void VerneedSection<E>::construct(Context<E> &ctx) {
     aux = (ElfVernaux<E> *)ptr;
     ptr += sizeof(*aux);
 
-    std::string_view verstr = sym->get_version();
     aux->vna_hash = elf_hash(verstr);
     aux->vna_other = ++veridx;
     aux->vna_name = ctx.dynstr->add_string(verstr);
   };
 
+  auto end_group = [&](InputFile<E> *file) {
+    if (file == libc) {
+      add_entry("GLIBC_ABI_DT_RELR");
+      libc = nullptr;
+    }
+  };
+
+  // Runs of symbols sharing the same version, as pairs of the index of
+  // the first symbol in `syms` and the version index assigned to them.
+  std::vector<std::pair<i64, u16>> runs;
+
   for (i64 i = 0; i < syms.size(); i++) {
     if (i == 0 || syms[i - 1]->file != syms[i]->file) {
+      if (i > 0)
+        end_group(syms[i - 1]->file);
       start_group(syms[i]->file);
-      add_entry(syms[i]);
+      add_entry(syms[i]->get_version());
+      runs.push_back({i, veridx});
     } else if (syms[i - 1]->ver_idx != syms[i]->ver_idx) {
-      add_entry(syms[i]);
+      add_entry(syms[i]->get_version());
+      runs.push_back({i, veridx});
     }
+  }
+
+  // Fill .gnu.version. Its entries are scattered, so do it in parallel.
+  tbb::parallel_for(tbb::blocked_range<i64>(0, syms.size()),
+                    [&](const tbb::blocked_range<i64> &r) {
+    i64 j = std::upper_bound(runs.begin(), runs.end(), r.begin(),
+                             [](i64 i, const std::pair<i64, u16> &run) {
+      return i < run.first;
+    }) - runs.begin() - 1;
+
+    for (i64 i = r.begin(); i < r.end(); i++) {
+      if (j + 1 < runs.size() && runs[j + 1].first == i)
+        j++;
+      ctx.versym->contents[syms[i]->get_dynsym_idx(ctx)] = runs[j].second;
+    }
+  });
+
+  if (!syms.empty())
+    end_group(syms.back()->file);
 
-    ctx.versym->contents[syms[i]->get_dynsym_idx(ctx)] = veridx;
+  if (libc) {
+    start_group(libc);
+    end_group(libc);
   }
 
   // Resize .gnu.version_r to fit to its contents.
@@ -1594,8 +2276,10 @@ void VerdefSection<E>::construct(Context<E> &ctx) {
   for (std::string_view verstr : ctx.arg.version_definitions)
     write(verstr, idx++, 0);
 
-  for (Symbol<E> *sym : std::span<Symbol<E> *>(ctx.dynsym->symbols).subspan(1))
-    ctx.versym->contents[sym->get_dynsym_idx(ctx)] = sym->ver_idx;
+  std::vector<Symbol<E> *> &syms = ctx.dynsym->symbols;
+  tbb::parallel_for((i64)1, (i64)syms.size(), [&](i64 i) {
+    ctx.versym->contents[syms[i]->get_dynsym_idx(ctx)] = syms[i]->ver_idx;
+  });
 }
 
 template <typename E>
@@ -1638,36 +2322,118 @@ void BuildIdSection<E>::copy_buf(Context<E> &ctx) {
   memcpy(base + 3, "GNU", 4);           // Name string
 }
 
+// For --build-id=[md5,sha1,sha256,fast], we split an output file into
+// fixed-size shards, compute a hash for each shard, and then compute
+// a hash of the concatenated shard hashes.
+//
+// Instead of hashing the entire output file after all chunks have been
+// written, we hash each shard as soon as the last chunk overlapping it
+// is copied, so that build-id computation overlaps with copy_buf and
+// each shard is hashed while it is still hot in cache. To do that, we
+// keep the number of not-yet-written chunks for each shard.
+//
+// .rela.dyn is partially rewritten after copy_buf by
+// RelDynSection::sort(), so shards overlapping it are hashed last.
 template <typename E>
-static void compute_sha256(Context<E> &ctx, i64 offset) {
-  u8 *buf = ctx.buf;
-  i64 bufsize = ctx.output_file->filesize;
+static std::pair<i64, i64> get_shard_range(Chunk<E> *chunk, i64 shard_size) {
+  i64 begin = chunk->shdr.sh_offset;
+  i64 end = begin;
+  if (chunk->shdr.sh_type != SHT_NOBITS)
+    end += chunk->shdr.sh_size;
+
+  if (begin == end)
+    return {0, 0};
+  return {begin / shard_size, (end - 1) / shard_size + 1};
+}
+
+// SHA256 is the default hash function for build-id. XXH3-128 is
+// selected by --build-id=fast; it is not a cryptographic hash, but
+// it is good enough for identifying an output file and is several
+// times faster than SHA256 even on processors with SHA extensions.
+template <typename E>
+i64 BuildIdSection<E>::get_digest_size(Context<E> &ctx) {
+  if (ctx.arg.build_id.hash_func == BuildId::XXH3)
+    return sizeof(XXH128_canonical_t);
+  return SHA256_SIZE;
+}
 
-  i64 shard_size = 4096 * 1024;
-  i64 num_shards = bufsize / shard_size + 1;
-  std::vector<u8> shards(num_shards * SHA256_SIZE);
+template <typename E>
+void BuildIdSection<E>::hash(Context<E> &ctx, u8 *buf, i64 size, u8 *digest) {
+  if (ctx.arg.build_id.hash_func == BuildId::XXH3)
+    XXH128_canonicalFromHash((XXH128_canonical_t *)digest,
+                             XXH3_128bits(buf, size));
+  else
+    SHA256(buf, size, digest);
+}
+
+template <typename E>
+void BuildIdSection<E>::hash_shard(Context<E> &ctx, i64 i) {
+  u8 *begin = ctx.buf + SHARD_SIZE * i;
+  i64 filesize = ctx.output_file->filesize;
+  i64 sz = (i < num_shards - 1) ? SHARD_SIZE : (filesize % SHARD_SIZE);
+  i64 digest_size = get_digest_size(ctx);
+  hash(ctx, begin, sz, shard_hashes.data() + i * digest_size);
+
+  // We call munmap early for each chunk so that the last munmap
+  // gets cheaper. We assume that the .note.build-id section is
+  // at the beginning of an output file. This is an ugly performance
+  // hack, but we can save about 30 ms for a 2 GiB output.
+  if (i > 0 && ctx.output_file->is_mmapped)
+    munmap(begin, sz);
+}
 
+template <typename E>
+void BuildIdSection<E>::begin_hashing(Context<E> &ctx) {
+  if (ctx.arg.build_id.kind != BuildId::HASH)
+    return;
+
+  num_shards = ctx.output_file->filesize / SHARD_SIZE + 1;
+  shard_hashes.resize(num_shards * get_digest_size(ctx));
+  num_pending.reset(new std::atomic_int32_t[num_shards]);
+
+  for (i64 i = 0; i < num_shards; i++)
+    num_pending[i] = 0;
+
+  for (Chunk<E> *chunk : ctx.chunks) {
+    auto [begin, end] = get_shard_range(chunk, SHARD_SIZE);
+    for (i64 i = begin; i < end; i++)
+      num_pending[i]++;
+  }
+
+  auto [begin, end] = get_shard_range(ctx.reldyn.get(), SHARD_SIZE);
+  for (i64 i = begin; i < end; i++)
+    num_pending[i]++;
+
+  // Shards that consist only of paddings can be hashed now.
   tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
-    u8 *begin = buf + shard_size * i;
-    i64 sz = (i < num_shards - 1) ? shard_size : (bufsize % shard_size);
-    SHA256(begin, sz, shards.data() + i * SHA256_SIZE);
-
-    // We call munmap early for each chunk so that the last munmap
-    // gets cheaper. We assume that the .note.build-id section is
-    // at the beginning of an output file. This is an ugly performance
-    // hack, but we can save about 30 ms for a 2 GiB output.
-    if (i > 0 && ctx.output_file->is_mmapped)
-      munmap(begin, sz);
+    if (num_pending[i] == 0)
+      hash_shard(ctx, i);
   });
+}
 
-  assert(ctx.arg.build_id.size(ctx) <= SHA256_SIZE);
+template <typename E>
+void BuildIdSection<E>::release(Context<E> &ctx, Chunk<E> *chunk) {
+  if (ctx.arg.build_id.kind != BuildId::HASH)
+    return;
+
+  auto [begin, end] = get_shard_range(chunk, SHARD_SIZE);
+  for (i64 i = begin; i < end; i++)
+    if (--num_pending[i] == 0)
+      hash_shard(ctx, i);
+}
+
+template <typename E>
+void BuildIdSection<E>::compute_hash(Context<E> &ctx, i64 offset) {
+  release(ctx, ctx.reldyn.get());
+
+  assert(ctx.arg.build_id.size(ctx) <= get_digest_size(ctx));
 
   u8 digest[SHA256_SIZE];
-  SHA256(shards.data(), shards.size(), digest);
-  memcpy(buf + offset, digest, ctx.arg.build_id.size(ctx));
+  hash(ctx, shard_hashes.data(), shard_hashes.size(), digest);
+  memcpy(ctx.buf + offset, digest, ctx.arg.build_id.size(ctx));
 
   if (ctx.output_file->is_mmapped) {
-    munmap(buf, std::min(bufsize, shard_size));
+    munmap(ctx.buf, std::min<i64>(ctx.output_file->filesize, SHARD_SIZE));
     ctx.output_file->is_unmapped = true;
   }
 }
@@ -1705,7 +2471,8 @@ void BuildIdSection<E>::write_buildid(Context<E> &ctx) {
     // SHA256 computation, and SHA256 outperforms MD5 on such computers.
     // So, we always compute SHA256 and truncate it if smaller digest was
     // requested.
-    compute_sha256(ctx, this->shdr.sh_offset + HEADER_SIZE);
+    // Shard hashes have been computed during copy_buf.
+    compute_hash(ctx, this->shdr.sh_offset + HEADER_SIZE);
     return;
   case BuildId::UUID:
     write_vector(ctx.buf + this->shdr.sh_offset + HEADER_SIZE,
@@ -1741,6 +2508,49 @@ void NotePropertySection<E>::copy_buf(Context<E> &ctx) {
   buf[6] = features;                       // Feature flags
 }
 
+// Returns a callback to read the contents of a given chunk for
+// compression. Output sections can render any part of them on demand,
+// so we don't need to have an uncompressed copy of the entire section.
+// Other chunks are rendered to `buf` in full.
+template <typename E>
+static CompressorInput
+get_compressor_input(Context<E> &ctx, Chunk<E> &chunk,
+                     std::unique_ptr<u8[]> &buf) {
+  if (chunk.kind == Chunk<E>::REGULAR) {
+    OutputSection<E> *osec = (OutputSection<E> *)&chunk;
+    return [&ctx, osec](u8 *out, i64 offset, i64 size) {
+      osec->write_range(ctx, out, offset, size);
+    };
+  }
+
+  buf.reset(new u8[chunk.shdr.sh_size]);
+  chunk.write_to(ctx, buf.get());
+  u8 *data = buf.get();
+  return [data](u8 *out, i64 offset, i64 size) {
+    memcpy(out, data + offset, size);
+  };
+}
+
+// Returns input sections of a given chunk that are compressed in the
+// same format as the output and can be copied to the output without
+// inflating them, so that the compressor can splice their compressed
+// streams as-is. A section with relocations has to be inflated because
+// its contents need to be modified.
+template <typename E>
+static std::vector<CompressedRange>
+get_compressed_ranges(Chunk<E> &chunk, u8 compress_type) {
+  if (chunk.kind != Chunk<E>::REGULAR)
+    return {};
+
+  std::vector<CompressedRange> vec;
+  for (InputSection<E> *isec : ((OutputSection<E> *)&chunk)->members)
+    if (isec->compress_type == compress_type && isec->relsec_idx == -1 &&
+        isec->shdr.sh_size > 0)
+      vec.push_back({(i64)isec->offset, (i64)isec->shdr.sh_size,
+                     isec->contents});
+  return vec;
+}
+
 template <typename E>
 GabiCompressedSection<E>::GabiCompressedSection(Context<E> &ctx,
                                                 Chunk<E> &chunk)
@@ -1748,14 +2558,23 @@ GabiCompressedSection<E>::GabiCompressedSection(Context<E> &ctx,
   assert(chunk.name.starts_with(".debug"));
   this->name = chunk.name;
 
-  std::unique_ptr<u8[]> buf(new u8[chunk.shdr.sh_size]);
-  chunk.write_to(ctx, buf.get());
-
-  chdr.ch_type = ELFCOMPRESS_ZLIB;
   chdr.ch_size = chunk.shdr.sh_size;
   chdr.ch_addralign = chunk.shdr.sh_addralign;
 
-  contents.reset(new ZlibCompressor({(char *)buf.get(), chunk.shdr.sh_size}));
+  std::unique_ptr<u8[]> buf;
+  CompressorInput input = get_compressor_input(ctx, chunk, buf);
+
+  if (ctx.arg.compress_debug_sections == COMPRESS_ZSTD) {
+    chdr.ch_type = ELFCOMPRESS_ZSTD;
+    std::vector<CompressedRange> ranges =
+      get_compressed_ranges(chunk, ELFCOMPRESS_ZSTD);
+    contents.reset(new ZstdCompressor(chunk.shdr.sh_size, input, ranges));
+  } else {
+    chdr.ch_type = ELFCOMPRESS_ZLIB;
+    std::vector<CompressedRange> ranges =
+      get_compressed_ranges(chunk, ELFCOMPRESS_ZLIB);
+    contents.reset(new ZlibCompressor(chunk.shdr.sh_size, input, ranges));
+  }
 
   this->shdr = chunk.shdr;
   this->shdr.sh_flags |= SHF_COMPRESSED;
@@ -1766,9 +2585,13 @@ GabiCompressedSection<E>::GabiCompressedSection(Context<E> &ctx,
 
 template <typename E>
 void GabiCompressedSection<E>::copy_buf(Context<E> &ctx) {
-  u8 *base = ctx.buf + this->shdr.sh_offset;
-  memcpy(base, &chdr, sizeof(chdr));
-  contents->write_to(base + sizeof(chdr));
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void GabiCompressedSection<E>::write_to(Context<E> &ctx, u8 *buf) {
+  memcpy(buf, &chdr, sizeof(chdr));
+  contents->write_to(buf + sizeof(chdr));
 }
 
 template <typename E>
@@ -1778,10 +2601,11 @@ GnuCompressedSection<E>::GnuCompressedSection(Context<E> &ctx,
   assert(chunk.name.starts_with(".debug"));
   this->name = save_string(ctx, ".zdebug" + std::string(chunk.name.substr(6)));
 
-  std::unique_ptr<u8[]> buf(new u8[chunk.shdr.sh_size]);
-  chunk.write_to(ctx, buf.get());
-
-  contents.reset(new ZlibCompressor({(char *)buf.get(), chunk.shdr.sh_size}));
+  std::unique_ptr<u8[]> buf;
+  CompressorInput input = get_compressor_input(ctx, chunk, buf);
+  std::vector<CompressedRange> ranges =
+    get_compressed_ranges(chunk, ELFCOMPRESS_ZLIB);
+  contents.reset(new ZlibCompressor(chunk.shdr.sh_size, input, ranges));
 
   this->shdr = chunk.shdr;
   this->shdr.sh_size = HEADER_SIZE + contents->size();
@@ -1791,31 +2615,28 @@ GnuCompressedSection<E>::GnuCompressedSection(Context<E> &ctx,
 
 template <typename E>
 void GnuCompressedSection<E>::copy_buf(Context<E> &ctx) {
-  u8 *base = ctx.buf + this->shdr.sh_offset;
-  memcpy(base, "ZLIB", 4);
-  *(ubig64 *)(base + 4) = this->original_size;
-  contents->write_to(base + 12);
+  write_to(ctx, ctx.buf + this->shdr.sh_offset);
+}
+
+template <typename E>
+void GnuCompressedSection<E>::write_to(Context<E> &ctx, u8 *buf) {
+  memcpy(buf, "ZLIB", 4);
+  *(ubig64 *)(buf + 4) = this->original_size;
+  contents->write_to(buf + 12);
 }
 
 template <typename E>
 void ReproSection<E>::update_shdr(Context<E> &ctx) {
   if (contents)
     return;
-  TarFile tar("repro");
 
-  tar.append("response.txt", save_string(ctx, create_response_file(ctx)));
-  tar.append("version.txt", save_string(ctx, mold_version + "\n"));
-
-  std::unordered_set<std::string> seen;
-  for (std::unique_ptr<MappedFile<Context<E>>> &mf : ctx.mf_pool) {
-    std::string path = path_to_absolute(mf->name);
-    if (seen.insert(path).second)
-      tar.append(path, mf->get_contents());
-  }
-
-  std::vector<u8> buf(tar.size());
-  tar.write_to(&buf[0]);
-  contents.reset(new GzipCompressor({(char *)&buf[0], buf.size()}));
+  // The tar file is rendered one compression shard at a time, so it
+  // never exists in memory as a whole.
+  TarFile tar = create_repro_tar(ctx);
+  contents.reset(new GzipCompressor(tar.size(), [&](u8 *buf, i64 offset,
+                                                    i64 size) {
+    tar.write_to(buf, offset, size);
+  }));
   this->shdr.sh_size = contents->size();
 }
 
@@ -1824,6 +2645,33 @@ void ReproSection<E>::copy_buf(Context<E> &ctx) {
   contents->write_to(ctx.buf + this->shdr.sh_offset);
 }
 
+template <typename E>
+void InputDigestSection<E>::copy_buf(Context<E> &ctx) {
+  assert(ctx.input_digest.size() == this->shdr.sh_size);
+  memcpy(ctx.buf + this->shdr.sh_offset, ctx.input_digest.data(),
+         this->shdr.sh_size);
+}
+
+template <typename E>
+void GnuDebuglinkSection<E>::update_shdr(Context<E> &ctx) {
+  std::string_view name = path_filename(ctx.arg.separate_debug_file);
+  this->shdr.sh_size = align_to(name.size() + 1, 4) + 4;
+}
+
+template <typename E>
+void GnuDebuglinkSection<E>::copy_buf(Context<E> &ctx) {
+  u8 *base = ctx.buf + this->shdr.sh_offset;
+  memset(base, 0, this->shdr.sh_size);
+  write_string(base, path_filename(ctx.arg.separate_debug_file));
+}
+
+// The CRC is filled after the debug info file is written.
+template <typename E>
+void GnuDebuglinkSection<E>::write_crc(Context<E> &ctx, u32 crc) {
+  u8 *base = ctx.buf + this->shdr.sh_offset;
+  *(u32 *)(base + this->shdr.sh_size - 4) = crc;
+}
+
 #define INSTANTIATE(E)                                          \
   template class Chunk<E>;                                      \
   template class OutputEhdr<E>;                                 \
@@ -1837,6 +2685,7 @@ void ReproSection<E>::copy_buf(Context<E> &ctx) {
   template class PltGotSection<E>;                              \
   template class RelPltSection<E>;                              \
   template class RelDynSection<E>;                              \
+  template class RelrDynSection<E>;                             \
   template class StrtabSection<E>;                              \
   template class ShstrtabSection<E>;                            \
   template class DynstrSection<E>;                              \
@@ -1857,6 +2706,8 @@ void ReproSection<E>::copy_buf(Context<E> &ctx) {
   template class GabiCompressedSection<E>;                      \
   template class GnuCompressedSection<E>;                       \
   template class ReproSection<E>;                               \
+  template class InputDigestSection<E>;                         \
+  template class GnuDebuglinkSection<E>;                        \
   template i64 BuildId::size(Context<E> &) const;               \
   template bool is_relro(Context<E> &, Chunk<E> *);             \
   template std::vector<ElfPhdr<E>> create_phdr(Context<E> &)
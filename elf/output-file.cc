@@ -4,6 +4,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <tbb/parallel_for.h>
 
 namespace mold::elf {
 
@@ -13,32 +14,114 @@ inline u32 get_umask() {
   return orig_umask;
 }
 
+// Touching a page of a newly-created output file for the first time
+// causes a page fault, and the kernel has to allocate a disk block and
+// zero-fill a page for each of them. We reserve disk blocks with
+// fallocate and then prefault pages in parallel in large batches,
+// which is much cheaper than taking one fault per page when copying
+// sections. Both are just optimizations, so errors are ignored (e.g.
+// MADV_POPULATE_WRITE is available only on Linux 5.14 or later).
+static void preallocate(i64 fd, i64 filesize) {
+#ifdef __linux__
+  fallocate(fd, 0, 0, filesize);
+#endif
+}
+
+static void prefault(u8 *buf, i64 filesize) {
+#ifdef MADV_POPULATE_WRITE
+  i64 chunk_size = 16 * 1024 * 1024;
+  i64 num_chunks = (filesize + chunk_size - 1) / chunk_size;
+
+  tbb::parallel_for((i64)0, num_chunks, [&](i64 i) {
+    i64 size = std::min(chunk_size, filesize - i * chunk_size);
+    madvise(buf + i * chunk_size, size, MADV_POPULATE_WRITE);
+  });
+#endif
+}
+
+// With --huge-pages, an anonymous output buffer is backed by
+// transparent huge pages, so that a large output takes 512x fewer page
+// faults. It's just a hint, so an error is ignored.
+template <typename E>
+static void advise_huge_pages(Context<E> &ctx, u8 *buf, i64 filesize) {
+#ifdef MADV_HUGEPAGE
+  if (ctx.arg.huge_pages)
+    madvise(buf, filesize, MADV_HUGEPAGE);
+#endif
+}
+
+// Writes a given buffer to a file with multiple threads. A single
+// writer thread often can't saturate a fast storage device.
+template <typename E>
+static void write_parallel(Context<E> &ctx, i64 fd, u8 *buf, i64 filesize,
+                           std::string_view path) {
+  i64 chunk_size = 16 * 1024 * 1024;
+  i64 num_chunks = (filesize + chunk_size - 1) / chunk_size;
+
+  tbb::parallel_for((i64)0, num_chunks, [&](i64 i) {
+    i64 off = i * chunk_size;
+    i64 end = std::min(filesize, off + chunk_size);
+
+    while (off < end) {
+      ssize_t n = pwrite(fd, buf + off, end - off, off);
+      if (n <= 0)
+        Fatal(ctx) << path << ": write failed: " << errno_string();
+      off += n;
+    }
+  });
+}
+
+// Writes a given buffer to a file that is not seekable, such as a pipe.
+template <typename E>
+static void write_sequential(Context<E> &ctx, i64 fd, u8 *buf, i64 filesize,
+                             std::string_view path) {
+  for (i64 off = 0; off < filesize;) {
+    ssize_t n = write(fd, buf + off, filesize - off);
+    if (n <= 0)
+      Fatal(ctx) << path << ": write failed: " << errno_string();
+    off += n;
+  }
+}
+
 template <typename E>
 class MemoryMappedOutputFile : public OutputFile<E> {
 public:
   MemoryMappedOutputFile(Context<E> &ctx, std::string path, i64 filesize, i64 perm)
     : OutputFile<E>(path, filesize, true) {
     std::string dir(path_dirname(path));
-    output_tmpfile = (char *)save_string(ctx, dir + "/.mold-XXXXXX").data();
-    i64 fd = mkstemp(output_tmpfile);
+    tmpfile = (char *)save_string(ctx, dir + "/.mold-XXXXXX").data();
+    i64 fd = mkstemp(tmpfile);
     if (fd == -1)
-      Fatal(ctx) << "cannot open " << output_tmpfile <<  ": " << errno_string();
+      Fatal(ctx) << "cannot open " << tmpfile <<  ": " << errno_string();
 
-    if (rename(path.c_str(), output_tmpfile) == 0) {
+    // Only one temporary file is removed on abnormal exit. If we are
+    // creating a second file (e.g. --separate-debug-file), the output
+    // file's one takes precedence.
+    if (!output_tmpfile)
+      output_tmpfile = tmpfile;
+
+    // A new file is zero-filled, but if we reuse an existing output
+    // file, it still contains the previous output.
+    this->is_zero_filled = true;
+
+    if (rename(path.c_str(), tmpfile) == 0) {
       ::close(fd);
-      fd = ::open(output_tmpfile, O_RDWR | O_CREAT, perm);
+      fd = ::open(tmpfile, O_RDWR | O_CREAT, perm);
+      this->is_zero_filled = false;
       if (fd == -1) {
         if (errno != ETXTBSY)
           Fatal(ctx) << "cannot open " << path << ": " << errno_string();
-        unlink(output_tmpfile);
-        fd = ::open(output_tmpfile, O_RDWR | O_CREAT, perm);
+        unlink(tmpfile);
+        fd = ::open(tmpfile, O_RDWR | O_CREAT, perm);
         if (fd == -1)
           Fatal(ctx) << "cannot open " << path << ": " << errno_string();
+        this->is_zero_filled = true;
       }
     }
 
     if (ftruncate(fd, filesize))
       Fatal(ctx) << "ftruncate failed";
+    preallocate(fd, filesize);
 
     if (fchmod(fd, (perm & ~get_umask())) == -1)
       Fatal(ctx) << "fchmod failed";
@@ -47,7 +130,15 @@ public:
                            MAP_SHARED, fd, 0);
     if (this->buf == MAP_FAILED)
       Fatal(ctx) << path << ": mmap failed: " << errno_string();
-    ::close(fd);
+    prefault(this->buf, filesize);
+
+    // With --copy-file-range, some input sections are copied to the
+    // output file by the kernel, and with --early-writeback, we ask the
+    // kernel to write back finished ranges. Both need a file descriptor.
+    if (ctx.arg.copy_file_range || ctx.arg.early_writeback)
+      this->fd = fd;
+    else
+      ::close(fd);
   }
 
   void close(Context<E> &ctx) override {
@@ -55,11 +146,67 @@ public:
 
     if (!this->is_unmapped)
       munmap(this->buf, this->filesize);
+    if (this->fd != -1)
+      ::close(this->fd);
+
+    if (rename(tmpfile, this->path.c_str()) == -1)
+      Fatal(ctx) << this->path << ": rename failed: " << errno_string();
+    if (output_tmpfile == tmpfile)
+      output_tmpfile = nullptr;
+  }
+
+private:
+  char *tmpfile = nullptr;
+};
+
+// With --huge-pages, we create an output image in an anonymous buffer
+// backed by transparent huge pages instead of mapping the output file
+// directly, and write it to a new file at the end. Page cache of most
+// filesystems is made of small pages, so mapping a file of a few
+// gigabytes takes about a million page faults.
+template <typename E>
+class HugePageOutputFile : public OutputFile<E> {
+public:
+  HugePageOutputFile(Context<E> &ctx, std::string path, i64 filesize, i64 perm)
+    : OutputFile<E>(path, filesize, false), perm(perm) {
+    this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (this->buf == MAP_FAILED)
+      Fatal(ctx) << "mmap failed: " << errno_string();
+    this->is_zero_filled = true;
+    advise_huge_pages(ctx, this->buf, filesize);
+    prefault(this->buf, filesize);
+  }
+
+  void close(Context<E> &ctx) override {
+    Timer t(ctx, "close_file");
+
+    std::string dir(path_dirname(this->path));
+    char *tmpfile = (char *)save_string(ctx, dir + "/.mold-XXXXXX").data();
+    i64 fd = mkstemp(tmpfile);
+    if (fd == -1)
+      Fatal(ctx) << "cannot open " << tmpfile << ": " << errno_string();
+    if (!output_tmpfile)
+      output_tmpfile = tmpfile;
+
+    if (fchmod(fd, (perm & ~get_umask())) == -1)
+      Fatal(ctx) << "fchmod failed";
+    if (ftruncate(fd, this->filesize))
+      Fatal(ctx) << "ftruncate failed";
+    preallocate(fd, this->filesize);
+
+    write_parallel(ctx, fd, this->buf, this->filesize, this->path);
+    ::close(fd);
+    munmap(this->buf, this->filesize);
 
-    if (rename(output_tmpfile, this->path.c_str()) == -1)
+    if (rename(tmpfile, this->path.c_str()) == -1)
       Fatal(ctx) << this->path << ": rename failed: " << errno_string();
-    output_tmpfile = nullptr;
+    if (output_tmpfile == tmpfile)
+      output_tmpfile = nullptr;
   }
+
+private:
+  i64 perm;
 };
 
 template <typename E>
@@ -71,13 +218,19 @@ public:
                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
     if (this->buf == MAP_FAILED)
       Fatal(ctx) << "mmap failed: " << errno_string();
+    this->is_zero_filled = true;
+    advise_huge_pages(ctx, this->buf, filesize);
+    prefault(this->buf, filesize);
   }
 
   void close(Context<E> &ctx) override {
     Timer t(ctx, "close_file");
 
+    // We write to stdout from its current file offset, so it's always
+    // written sequentially.
     if (this->path == "-") {
-      fwrite(this->buf, this->filesize, 1, stdout);
+      fflush(stdout);
+      write_sequential(ctx, STDOUT_FILENO, this->buf, this->filesize, "-");
       fclose(stdout);
       return;
     }
@@ -86,15 +239,90 @@ public:
     if (fd == -1)
       Fatal(ctx) << "cannot open " << this->path << ": " << errno_string();
 
-    FILE *fp = fdopen(fd, "w");
-    fwrite(this->buf, this->filesize, 1, fp);
-    fclose(fp);
+    // A block device can be written by multiple threads, but a pipe or
+    // a character device has to be written from beginning to end.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)))
+      write_parallel(ctx, fd, this->buf, this->filesize, this->path);
+    else
+      write_sequential(ctx, fd, this->buf, this->filesize, this->path);
+    ::close(fd);
   }
 
 private:
   i64 perm;
 };
 
+// With --update-in-place, we link into an anonymous buffer and then
+// copy only pages that differ from the existing output file. When we
+// relink after a small change, most pages are identical, so we avoid
+// dirtying them. That reduces writeback and copy-on-write of the
+// entire file on filesystems such as btrfs or ZFS.
+template <typename E>
+class InPlaceOutputFile : public OutputFile<E> {
+public:
+  InPlaceOutputFile(Context<E> &ctx, std::string path, i64 filesize, i64 perm,
+                    i64 fd)
+    : OutputFile<E>(path, filesize, false), fd(fd) {
+    if (fchmod(fd, (perm & ~get_umask())) == -1)
+      Fatal(ctx) << "fchmod failed";
+
+    this->buf = (u8 *)mmap(NULL, filesize, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (this->buf == MAP_FAILED)
+      Fatal(ctx) << "mmap failed: " << errno_string();
+    this->is_zero_filled = true;
+    advise_huge_pages(ctx, this->buf, filesize);
+    prefault(this->buf, filesize);
+  }
+
+  void close(Context<E> &ctx) override {
+    Timer t(ctx, "close_file");
+
+    if (ftruncate(fd, this->filesize))
+      Fatal(ctx) << "ftruncate failed";
+
+    u8 *dst = (u8 *)mmap(nullptr, this->filesize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    if (dst == MAP_FAILED)
+      Fatal(ctx) << this->path << ": mmap failed: " << errno_string();
+    ::close(fd);
+
+    i64 page_size = 4096;
+    i64 chunk_size = 1024 * page_size;
+    i64 num_chunks = (this->filesize + chunk_size - 1) / chunk_size;
+
+    tbb::parallel_for((i64)0, num_chunks, [&](i64 i) {
+      i64 end = std::min(this->filesize, (i + 1) * chunk_size);
+      for (i64 off = i * chunk_size; off < end; off += page_size) {
+        i64 sz = std::min(page_size, end - off);
+        if (memcmp(dst + off, this->buf + off, sz))
+          memcpy(dst + off, this->buf + off, sz);
+      }
+    });
+
+    munmap(dst, this->filesize);
+    munmap(this->buf, this->filesize);
+  }
+
+private:
+  i64 fd;
+};
+
+// link_in_memory() gives us a buffer to which we directly write the
+// output instead of a file.
+template <typename E>
+class MemoryOutputFile : public OutputFile<E> {
+public:
+  MemoryOutputFile(Context<E> &ctx, std::string path, i64 filesize)
+    : OutputFile<E>(path, filesize, false) {
+    ctx.memory_output->resize(filesize);
+    this->buf = ctx.memory_output->data();
+  }
+
+  void close(Context<E> &ctx) override {}
+};
+
 template <typename E>
 std::unique_ptr<OutputFile<E>>
 OutputFile<E>::open(Context<E> &ctx, std::string path, i64 filesize, i64 perm) {
@@ -113,10 +341,30 @@ OutputFile<E>::open(Context<E> &ctx, std::string path, i64 filesize, i64 perm) {
   }
 
   std::unique_ptr<OutputFile<E>> file;
-  if (is_special)
+  // A memory buffer is given only for the output file, not for other
+  // files such as a separate debug info file.
+  if (ctx.memory_output && !ctx.output_file) {
+    file = std::make_unique<MemoryOutputFile<E>>(ctx, path, filesize);
+  } else if (is_special) {
     file = std::make_unique<MallocOutputFile<E>>(ctx, path, filesize, perm);
-  else
-    file = std::make_unique<MemoryMappedOutputFile<E>>(ctx, path, filesize, perm);
+  } else {
+    // If the existing file can't be opened for writing (e.g. it is
+    // being executed), we fall back to creating a new file.
+    if (ctx.arg.update_in_place) {
+      i64 fd = ::open(path.c_str(), O_RDWR);
+      if (fd != -1)
+        file = std::make_unique<InPlaceOutputFile<E>>(ctx, path, filesize,
+                                                      perm, fd);
+    }
+
+    if (!file && ctx.arg.huge_pages)
+      file = std::make_unique<HugePageOutputFile<E>>(ctx, path, filesize,
+                                                     perm);
+
+    if (!file)
+      file = std::make_unique<MemoryMappedOutputFile<E>>(ctx, path, filesize,
+                                                         perm);
+  }
 
   if (ctx.arg.filler != -1)
     memset(file->buf, ctx.arg.filler, filesize);
@@ -0,0 +1,232 @@
+// This file implements --parse-cache, an optional on-disk cache of
+// results of parsing object files.
+//
+// Splitting mergeable sections into pieces and hashing each piece is
+// one of the most expensive parts of parsing an object file, and it
+// produces exactly the same result every time for the same file. With
+// --parse-cache=DIR, we save piece boundaries and hashes of each object
+// file to DIR and read them back instead of splitting sections again.
+//
+// Cache entries are keyed by the path, size and mtime of a file (or of
+// the archive containing it), so an entry is never used for a file that
+// has been updated. The key is also stored in each entry to detect hash
+// collisions. Entries are written to temporary files first and then
+// renamed, so multiple processes can share the same directory.
+//
+// Entries are mapped read-only, so concurrent links reading the same
+// entry share its pages in the page cache. With --shm-parse-cache, the
+// cache directory is a per-user directory in /dev/shm, which works as
+// a host-wide in-memory cache shared by all mold processes of the user.
+// We don't share parsed objects themselves, as they are full of
+// pointers that are only valid in the process that created them.
+//
+// An entry has the following format in host byte order:
+//
+//   "MOLDPC01"
+//   u64 key_size, key, padded to 8 bytes
+//   For each mergeable section:
+//     u64 shndx, u64 num_pieces, u64 hashes[num_pieces],
+//     u32 offsets[num_pieces], padded to 8 bytes
+
+#include "mold.h"
+
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mold::elf {
+
+static constexpr std::string_view MAGIC = "MOLDPC01";
+
+template <typename E>
+static std::string get_cache_key(MappedFile<Context<E>> *mf) {
+  MappedFile<Context<E>> *root = mf;
+  while (root->parent)
+    root = root->parent;
+
+  // Memory inputs given by a library user don't have mtime.
+  if (root->mtime == 0)
+    return "";
+
+  std::ostringstream ss;
+  ss << E::e_machine << '\0'
+     << path_clean(std::filesystem::absolute(root->name).string()) << '\0'
+     << root->size << '\0' << root->mtime << '\0'
+     << (mf->data - root->data) << '\0' << mf->size;
+  return ss.str();
+}
+
+template <typename E>
+static std::string get_cache_path(Context<E> &ctx, std::string_view key) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash_string(key));
+  return ctx.arg.parse_cache + "/" + buf;
+}
+
+// Creates the cache directory if it doesn't exist. The shared-memory
+// cache directory must be private to the user, as anyone who can write
+// to it can change the output of our links, so we don't use it if it's
+// owned by someone else.
+template <typename E>
+static bool init_cache_dir(Context<E> &ctx) {
+  static bool ok = [&] {
+    const char *dir = ctx.arg.parse_cache.c_str();
+    if (!ctx.arg.shm_parse_cache) {
+      mkdir(dir, 0777);
+      return true;
+    }
+
+    mkdir(dir, 0700);
+    struct stat st;
+    if (lstat(dir, &st) == 0 && S_ISDIR(st.st_mode) &&
+        st.st_uid == getuid() && !(st.st_mode & 077))
+      return true;
+    Warn(ctx) << dir << ": not a private directory; parse cache is disabled";
+    return false;
+  }();
+  return ok;
+}
+
+namespace {
+// A read-only mapping of a cache entry.
+class MappedEntry {
+public:
+  MappedEntry(const std::string &path) {
+    i64 fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED)
+        data = {(char *)p, (size_t)st.st_size};
+    }
+    ::close(fd);
+  }
+
+  ~MappedEntry() {
+    if (!data.empty())
+      munmap((void *)data.data(), data.size());
+  }
+
+  std::string_view data;
+};
+}
+
+// Fills `subsec_offsets` and `hashes` of given mergeable sections with
+// the contents of a cache entry. Returns false if there's no valid entry.
+template <typename E>
+bool read_parse_cache(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                      std::span<std::unique_ptr<MergeableSection<E>>> secs) {
+  std::string key = get_cache_key(mf);
+  if (key.empty() || !init_cache_dir(ctx))
+    return false;
+
+  MappedEntry entry(get_cache_path(ctx, key));
+  std::string_view data = entry.data;
+
+  auto read_u64 = [&](u64 &val) {
+    if (data.size() < 8)
+      return false;
+    memcpy(&val, data.data(), 8);
+    data = data.substr(8);
+    return true;
+  };
+
+  if (!data.starts_with(MAGIC))
+    return false;
+  data = data.substr(MAGIC.size());
+
+  u64 key_size;
+  if (!read_u64(key_size) || data.substr(0, key_size) != key)
+    return false;
+  data = data.substr(std::min<u64>(align_to(key_size, 8), data.size()));
+
+  for (i64 i = 0; i < secs.size(); i++) {
+    MergeableSection<E> *m = secs[i].get();
+    if (!m)
+      continue;
+
+    u64 shndx, num;
+    if (!read_u64(shndx) || shndx != i || !read_u64(num) ||
+        num == 0 || num > m->shdr.sh_size ||
+        data.size() < align_to(num * 12, 8))
+      return false;
+
+    m->hashes.resize(num);
+    m->subsec_offsets.resize(num);
+    memcpy(m->hashes.data(), data.data(), num * 8);
+    memcpy(m->subsec_offsets.data(), data.data() + num * 8, num * 4);
+    data = data.substr(align_to(num * 12, 8));
+
+    // Piece boundaries must be sane, as we trust them without looking
+    // at the section contents.
+    std::span<u32> offsets = m->subsec_offsets;
+    if (offsets[0] != 0 || offsets.back() >= m->shdr.sh_size)
+      return false;
+    for (i64 j = 1; j < num; j++)
+      if (offsets[j - 1] >= offsets[j])
+        return false;
+  }
+  return data.empty();
+}
+
+// Saves `subsec_offsets` and `hashes` of given mergeable sections.
+// Failure is not an error as it is just a cache.
+template <typename E>
+void write_parse_cache(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                       std::span<std::unique_ptr<MergeableSection<E>>> secs) {
+  std::string key = get_cache_key(mf);
+  if (key.empty() || !init_cache_dir(ctx))
+    return;
+
+  std::string buf(MAGIC);
+
+  auto write_u64 = [&](u64 val) {
+    buf.append((char *)&val, 8);
+  };
+
+  write_u64(key.size());
+  buf += key;
+  buf.resize(align_to(buf.size(), 8));
+
+  for (i64 i = 0; i < secs.size(); i++) {
+    MergeableSection<E> *m = secs[i].get();
+    if (!m)
+      continue;
+
+    i64 num = m->hashes.size();
+    write_u64(i);
+    write_u64(num);
+    buf.append((char *)m->hashes.data(), num * 8);
+    buf.append((char *)m->subsec_offsets.data(), num * 4);
+    buf.resize(align_to(buf.size(), 8));
+  }
+
+  std::string path = get_cache_path(ctx, key);
+  std::string tmp = ctx.arg.parse_cache + "/.mold-XXXXXX";
+  i64 fd = mkstemp(tmp.data());
+  if (fd == -1)
+    return;
+
+  bool ok = (write(fd, buf.data(), buf.size()) == buf.size());
+  ::close(fd);
+
+  if (!ok || rename(tmp.c_str(), path.c_str()) == -1)
+    unlink(tmp.c_str());
+}
+
+#define INSTANTIATE(E)                                                  \
+  template bool read_parse_cache(Context<E> &, MappedFile<Context<E>> *, \
+    std::span<std::unique_ptr<MergeableSection<E>>>);                   \
+  template void write_parse_cache(Context<E> &, MappedFile<Context<E>> *, \
+    std::span<std::unique_ptr<MergeableSection<E>>>);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -1,11 +1,13 @@
 #include "mold.h"
 
+#include <fcntl.h>
 #include <functional>
 #include <map>
-#include <regex>
 #include <tbb/parallel_for_each.h>
 #include <tbb/parallel_scan.h>
+#include <tbb/parallel_sort.h>
 #include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
 #include <unordered_set>
 
 namespace mold::elf {
@@ -39,6 +41,8 @@ void create_synthetic_sections(Context<E> &ctx) {
   add(ctx.got = std::make_unique<GotSection<E>>());
   add(ctx.gotplt = std::make_unique<GotPltSection<E>>());
   add(ctx.reldyn = std::make_unique<RelDynSection<E>>());
+  if (ctx.arg.pack_dyn_relocs_relr && ctx.arg.pic)
+    add(ctx.relrdyn = std::make_unique<RelrDynSection<E>>());
   add(ctx.relplt = std::make_unique<RelPltSection<E>>());
   add(ctx.strtab = std::make_unique<StrtabSection<E>>());
   add(ctx.shstrtab = std::make_unique<ShstrtabSection<E>>());
@@ -71,25 +75,38 @@ void create_synthetic_sections(Context<E> &ctx) {
 
   if (ctx.arg.repro)
     add(ctx.repro = std::make_unique<ReproSection<E>>());
+  if (ctx.arg.skip_unchanged_output)
+    add(ctx.input_digest_section = std::make_unique<InputDigestSection<E>>());
+  if (!ctx.arg.separate_debug_file.empty())
+    add(ctx.gnu_debuglink = std::make_unique<GnuDebuglinkSection<E>>());
 }
 
+// Registers symbols of object files and DSOs and marks archive members
+// needed to resolve undefined symbols as alive.
 template <typename E>
-void resolve_symbols(Context<E> &ctx) {
-  Timer t(ctx, "resolve_obj_symbols");
-
+static void resolve_obj_symbols(Context<E> &ctx, Timer<Context<E>> &t) {
   // Register object symbols
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    TaskTimer t2(ctx, t, file->filename);
     if (file->is_in_lib)
       file->resolve_lazy_symbols(ctx);
     else
       file->resolve_regular_symbols(ctx);
   });
 
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    file->update_symbols(ctx);
+  });
+
   // Register DSO symbols
   tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
     file->resolve_dso_symbols(ctx);
   });
 
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    file->update_symbols(ctx);
+  });
+
   // Mark reachable objects to decide which files to include
   // into an output.
   std::vector<ObjectFile<E> *> live_objs = ctx.objs;
@@ -112,12 +129,66 @@ void resolve_symbols(Context<E> &ctx) {
     file->mark_live_objects(ctx, [&](ObjectFile<E> *obj) { feeder.add(obj); });
   });
 
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    if (file->is_alive)
+      file->update_symbols(ctx);
+  });
+}
+
+// Resets a symbol to the unresolved state. Flags given by command
+// line options are preserved.
+template <typename E>
+static void clear_symbol(Symbol<E> &sym) {
+  bool write_to_symtab = sym.write_to_symtab;
+  bool traced = sym.traced;
+  bool wrap = sym.wrap;
+
+  new (&sym) Symbol<E>(sym.name(), sym.name_hash);
+  sym.write_to_symtab = write_to_symtab;
+  sym.traced = traced;
+  sym.wrap = wrap;
+}
+
+template <typename E>
+void resolve_symbols(Context<E> &ctx) {
+  Timer t(ctx, "resolve_obj_symbols");
+  resolve_obj_symbols(ctx, t);
+
+  // If LTO IR files are needed, compile them to object files with the
+  // linker plugin. The resulting object files may refer archive members
+  // or DSOs that were not needed by the IR files, so we start symbol
+  // resolution over with the object files instead of the IR files.
+  if (std::any_of(ctx.objs.begin(), ctx.objs.end(), [](ObjectFile<E> *file) {
+        return file->is_lto_obj && file->is_alive;
+      })) {
+    std::vector<ObjectFile<E> *> lto_objs = do_lto(ctx);
+
+    tbb::parallel_for_each(ctx.objs, [](ObjectFile<E> *file) {
+      for (Symbol<E> *sym : file->get_global_syms())
+        if (sym->file == file)
+          clear_symbol(*sym);
+    });
+
+    tbb::parallel_for_each(ctx.dsos, [](SharedFile<E> *file) {
+      for (Symbol<E> *sym : file->symbols)
+        if (sym->file == file)
+          clear_symbol(*sym);
+    });
+
+    erase(ctx.objs, [](ObjectFile<E> *file) { return file->is_lto_obj; });
+    for (ObjectFile<E> *file : ctx.objs)
+      file->is_alive = !file->is_in_lib;
+    append(ctx.objs, lto_objs);
+
+    resolve_obj_symbols(ctx, t);
+  }
+
   // Remove symbols of eliminated objects.
   tbb::parallel_for_each(ctx.objs, [](ObjectFile<E> *file) {
     if (!file->is_alive)
       for (Symbol<E> *sym : file->get_global_syms())
         if (sym->file == file)
-          new (sym) Symbol<E>(sym->name());
+          new (sym) Symbol<E>(sym->name(), sym->name_hash);
   });
 
   // Eliminate unused archive members.
@@ -129,7 +200,7 @@ void resolve_symbols(Context<E> &ctx) {
       const ElfSym<E> &esym = file->elf_syms[i];
       Symbol<E> &sym = *file->symbols[i];
       if (esym.is_undef_strong() && sym.file && sym.file->is_dso) {
-        std::lock_guard lock(sym.mu);
+        ProfiledLock lock(sym.mu, symbol_lock_stats());
         sym.file->is_alive = true;
         sym.is_weak = false;
       }
@@ -149,12 +220,33 @@ void resolve_symbols(Context<E> &ctx) {
         feeder.add(file);
   });
 
+  // Lazy DSOs that turned out to be needed may have to provide other
+  // definitions as well, e.g. aliases of a copy-relocated symbol, so
+  // register the rest of their symbols. Names interned here are new,
+  // so they can be resolved only to definitions of these DSOs.
+  {
+    std::vector<SharedFile<E> *> files;
+    for (SharedFile<E> *file : ctx.dsos)
+      if (file->is_lazy && file->is_alive)
+        files.push_back(file);
+
+    std::vector<i64> begin(files.size());
+    tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+      begin[i] = files[i]->load_lazy_symbols(ctx);
+      files[i]->resolve_dso_symbols(ctx, begin[i]);
+    });
+
+    tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+      files[i]->update_symbols(ctx, begin[i]);
+    });
+  }
+
   // Remove symbols of unreferenced DSOs.
   tbb::parallel_for_each(ctx.dsos, [](SharedFile<E> *file) {
     if (!file->is_alive)
       for (Symbol<E> *sym : file->symbols)
         if (sym->file == file)
-          new (sym) Symbol<E>(sym->name());
+          new (sym) Symbol<E>(sym->name(), sym->name_hash);
   });
 
   // Remove unreferenced DSOs
@@ -165,19 +257,47 @@ void resolve_symbols(Context<E> &ctx) {
     file->resolve_common_symbols(ctx);
   });
 
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    file->update_symbols(ctx);
+  });
+
   if (Symbol<E> *sym = intern(ctx, "__gnu_lto_slim"); sym->file)
     Fatal(ctx) << *sym->file << ": looks like this file contains a GCC "
-               << "intermediate code, but mold does not support LTO";
+               << "intermediate code, but it was not claimed by an LTO "
+               << "plugin; try again with -flto";
+}
+
+template <typename E>
+void register_subsections(Context<E> &ctx) {
+  Timer t(ctx, "register_subsections");
+
+  // Hash tables of merged sections are sized from estimated numbers of
+  // distinct pieces. If an estimate turns out to be too small and a
+  // table overflows, we grow the table and register all pieces again.
+  // Registration is idempotent, and tables that didn't overflow keep
+  // their contents, so the second round is cheap and rarely needed.
+  for (;;) {
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+      file->register_subsections(ctx);
+    });
+
+    bool retry = false;
+    for (std::unique_ptr<MergedSection<E>> &sec : ctx.merged_sections) {
+      if (sec->is_full) {
+        sec->grow();
+        retry = true;
+      }
+    }
+
+    if (!retry)
+      return;
+  }
 }
 
 template <typename E>
 void eliminate_comdats(Context<E> &ctx) {
   Timer t(ctx, "eliminate_comdats");
 
-  tbb::parallel_for_each(ctx.objs, [](ObjectFile<E> *file) {
-    file->resolve_comdat_groups();
-  });
-
   tbb::parallel_for_each(ctx.objs, [](ObjectFile<E> *file) {
     file->eliminate_duplicate_comdat_groups();
   });
@@ -252,6 +372,35 @@ static std::vector<std::span<T>> split(std::vector<T> &input, i64 unit) {
   return vec;
 }
 
+template <typename E>
+static void sort_text_by_prefix(std::vector<InputSection<E> *> &members) {
+  auto get_rank = [](std::string_view name) {
+    auto is = [&](std::string_view stem) {
+      return name.starts_with(stem) &&
+             (name.size() == stem.size() || name[stem.size()] == '.');
+    };
+
+    if (is(".text.hot"))
+      return 0;
+    if (is(".text.startup"))
+      return 2;
+    if (is(".text.unlikely") || is(".text.exit"))
+      return 3;
+    return 1;
+  };
+
+  std::vector<InputSection<E> *> buckets[4];
+  for (InputSection<E> *isec : members)
+    buckets[get_rank(isec->name())].push_back(isec);
+
+  if (buckets[1].size() == members.size())
+    return;
+
+  members.clear();
+  for (std::vector<InputSection<E> *> &vec : buckets)
+    append(members, vec);
+}
+
 // So far, each input section has a pointer to its corresponding
 // output section, but there's no reverse edge to get a list of
 // input sections from an output section. This function creates it.
@@ -274,9 +423,9 @@ void bin_sections(Context<E> &ctx) {
 
   tbb::parallel_for((i64)0, (i64)slices.size(), [&](i64 i) {
     for (ObjectFile<E> *file : slices[i])
-      for (std::unique_ptr<InputSection<E>> &isec : file->sections)
+      for (InputSection<E> *isec : file->sections)
         if (isec && isec->is_alive)
-          groups[i][isec->output_section->idx].push_back(isec.get());
+          groups[i][isec->output_section->idx].push_back(isec);
   });
 
   std::vector<i64> sizes(num_osec);
@@ -290,6 +439,16 @@ void bin_sections(Context<E> &ctx) {
     for (i64 i = 0; i < groups.size(); i++)
       append(ctx.output_sections[j]->members, groups[i][j]);
   });
+
+  // Compilers put functions that are likely to be executed often in
+  // .text.hot.*, functions executed only at startup in .text.startup.*,
+  // and cold functions in .text.unlikely.*. Unless
+  // -z keep-text-section-prefix is given, they are all merged into
+  // .text. We order them hot -> normal -> startup -> unlikely so that
+  // cold code doesn't dilute pages of hot code.
+  for (std::unique_ptr<OutputSection<E>> &osec : ctx.output_sections)
+    if (osec->name == ".text")
+      sort_text_by_prefix(osec->members);
 }
 
 // Create a dummy object file containing linker-synthesized
@@ -297,7 +456,7 @@ void bin_sections(Context<E> &ctx) {
 template <typename E>
 ObjectFile<E> *create_internal_file(Context<E> &ctx) {
   ObjectFile<E> *obj = new ObjectFile<E>;
-  ctx.obj_pool.push_back(std::unique_ptr<ObjectFile<E>>(obj));
+  push_to_pool(ctx.obj_pool, std::unique_ptr<ObjectFile<E>>(obj));
 
   // Create linker-synthesized symbols.
   auto *esyms = new std::vector<ElfSym<E>>(1);
@@ -395,25 +554,140 @@ void check_duplicate_symbols(Context<E> &ctx) {
   ctx.checkpoint();
 }
 
+// Returns the priority of an .init_array or .fini_array section, which
+// is given as a numeric suffix such as `.init_array.100`. Sections
+// without a priority are run last.
+static i64 get_init_fini_priority(std::string_view name) {
+  size_t pos = name.find_last_of('.');
+  if (pos == name.npos || pos + 1 == name.size() ||
+      !name.substr(0, pos).ends_with("_array"))
+    return 65536;
+
+  i64 val = 0;
+  for (char c : name.substr(pos + 1)) {
+    if (c < '0' || '9' < c)
+      return 65536;
+    val = std::min<i64>(val * 10 + (c - '0'), INT32_MAX);
+  }
+  return val;
+}
+
+// Sorts .init_array and .fini_array members by priority. The sort key
+// is computed once for each member, and members with the same priority
+// keep their original order.
 template <typename E>
 void sort_init_fini(Context<E> &ctx) {
   Timer t(ctx, "sort_init_fini");
 
-  auto get_priority = [](InputSection<E> *isec) {
-    static std::regex re(R"(_array\.(\d+)$)", std::regex_constants::optimize);
-    std::string name = isec->name().begin();
-    std::smatch m;
-    if (std::regex_search(name, m, re))
-      return std::stoi(m[1]);
-    return 65536;
+  for (std::unique_ptr<OutputSection<E>> &osec : ctx.output_sections) {
+    if (osec->name != ".init_array" && osec->name != ".fini_array")
+      continue;
+
+    std::vector<InputSection<E> *> &members = osec->members;
+    std::vector<std::pair<i64, i64>> keys(members.size());
+
+    tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+      keys[i] = {get_init_fini_priority(members[i]->name()), i};
+    });
+
+    tbb::parallel_sort(keys.begin(), keys.end());
+
+    std::vector<InputSection<E> *> vec(members.size());
+    tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+      vec[i] = members[keys[i].second];
+    });
+    members = std::move(vec);
+  }
+}
+
+// Moves input sections in `order` to the beginning of their output
+// sections, sorted by their values. Other sections keep their original
+// order after them.
+template <typename E>
+void apply_section_order(Context<E> &ctx,
+                         const std::unordered_map<InputSection<E> *, i64> &order) {
+  std::unordered_set<OutputSection<E> *> osecs;
+  for (auto [isec, val] : order)
+    osecs.insert(isec->output_section);
+
+  auto get_order = [&](InputSection<E> *isec) {
+    auto it = order.find(isec);
+    return (it == order.end()) ? INT64_MAX : it->second;
   };
 
-  for (std::unique_ptr<OutputSection<E>> &osec : ctx.output_sections) {
-    if (osec->name == ".init_array" || osec->name == ".fini_array") {
-      sort(osec->members, [&](InputSection<E> *a, InputSection<E> *b) {
-        return get_priority(a) < get_priority(b);
-      });
-    }
+  tbb::parallel_for_each(osecs, [&](OutputSection<E> *osec) {
+    sort(osec->members, [&](InputSection<E> *a, InputSection<E> *b) {
+      return get_order(a) < get_order(b);
+    });
+  });
+}
+
+// If --symbol-ordering-file is given, input sections containing the
+// listed symbols are moved to the beginning of their output sections
+// in the order of the symbols. This is typically used to put functions
+// executed at startup next to each other to reduce page faults.
+template <typename E>
+void sort_by_symbol_order(Context<E> &ctx) {
+  Timer t(ctx, "sort_by_symbol_order");
+  std::unordered_map<InputSection<E> *, i64> order;
+
+  for (i64 i = 0; i < ctx.arg.symbol_ordering_file.size(); i++) {
+    Symbol<E> *sym = intern(ctx, ctx.arg.symbol_ordering_file[i]);
+    if (!sym->file || sym->file->is_dso)
+      continue;
+
+    InputSection<E> *isec = sym->input_section;
+    if (isec && isec->is_alive)
+      order.insert({isec, i});
+  }
+
+  apply_section_order(ctx, order);
+}
+
+// --data-ordering-file does for writable data sections what
+// --symbol-ordering-file does for all sections, so that hot global
+// variables are packed into as few cache lines and pages as possible.
+// A section containing a symbol marked as write-hot is moved to a cache
+// line boundary and the section following it is moved to the next one,
+// so that the symbol doesn't share a cache line with other data.
+template <typename E>
+void sort_by_data_order(Context<E> &ctx) {
+  Timer t(ctx, "sort_by_data_order");
+  constexpr i64 cache_line_size = 64;
+
+  std::unordered_map<InputSection<E> *, i64> order;
+  std::unordered_set<InputSection<E> *> write_hot;
+
+  for (i64 i = 0; i < ctx.arg.data_ordering_file.size(); i++) {
+    DataOrderEntry &ent = ctx.arg.data_ordering_file[i];
+    Symbol<E> *sym = intern(ctx, ent.name);
+    if (!sym->file || sym->file->is_dso)
+      continue;
+
+    InputSection<E> *isec = sym->input_section;
+    if (!isec || !isec->is_alive)
+      continue;
+
+    u64 flags = isec->shdr.sh_flags;
+    if (!(flags & SHF_ALLOC) || !(flags & SHF_WRITE) ||
+        (flags & (SHF_EXECINSTR | SHF_TLS)))
+      continue;
+
+    order.insert({isec, i});
+    if (ent.write_hot)
+      write_hot.insert(isec);
+  }
+
+  apply_section_order(ctx, order);
+
+  for (InputSection<E> *isec : write_hot) {
+    std::vector<InputSection<E> *> &members = isec->output_section->members;
+    auto it = std::find(members.begin(), members.end(), isec);
+    assert(it != members.end());
+
+    isec->min_alignment = cache_line_size;
+    if (it + 1 != members.end())
+      it[1]->min_alignment = cache_line_size;
   }
 }
 
@@ -438,6 +712,12 @@ std::vector<Chunk<E> *> collect_output_sections(Context<E> &ctx) {
   return vec;
 }
 
+// Returns the smallest number n such that
+// n >= val and n % align == skew.
+inline u64 align_with_skew(u64 val, u64 align, u64 skew) {
+  return align_to(val + align - skew, align) - align + skew;
+}
+
 template <typename E>
 void compute_section_sizes(Context<E> &ctx) {
   Timer t(ctx, "compute_section_sizes");
@@ -447,6 +727,36 @@ void compute_section_sizes(Context<E> &ctx) {
     if (osec->members.empty())
       return;
 
+    TaskTimer t2(ctx, t, osec->name);
+
+    // With --copy-file-range, sections that may be copied by the kernel
+    // are placed so that their output file offsets are congruent to
+    // their input file offsets modulo the page size, which allows
+    // filesystems to share their disk blocks by reflink. Since that
+    // depends on preceding members, we lay out members serially.
+    if (ctx.arg.copy_file_range && !(osec->shdr.sh_flags & SHF_ALLOC)) {
+      i64 offset = 0;
+      i64 align = 1;
+
+      for (InputSection<E> *isec : osec->members) {
+        offset = align_to(offset, isec->shdr.sh_addralign);
+        align = std::max<i64>(align, isec->shdr.sh_addralign);
+
+        if (isec->is_kernel_copyable(ctx)) {
+          offset = align_with_skew(offset, COMMON_PAGE_SIZE,
+                                   isec->get_file_offset() % COMMON_PAGE_SIZE);
+          align = std::max<i64>(align, COMMON_PAGE_SIZE);
+        }
+
+        isec->offset = offset;
+        offset += isec->shdr.sh_size;
+      }
+
+      osec->shdr.sh_size = offset;
+      osec->shdr.sh_addralign = align;
+      return;
+    }
+
     struct T {
       i64 offset;
       i64 align;
@@ -458,11 +768,12 @@ void compute_section_sizes(Context<E> &ctx) {
       [&](const tbb::blocked_range<i64> &r, T sum, bool is_final) {
         for (i64 i = r.begin(); i < r.end(); i++) {
           InputSection<E> &isec = *osec->members[i];
-          sum.offset = align_to(sum.offset, isec.shdr.sh_addralign);
+          i64 align = std::max<i64>(isec.shdr.sh_addralign, isec.min_alignment);
+          sum.offset = align_to(sum.offset, align);
           if (is_final)
             isec.offset = sum.offset;
           sum.offset += isec.shdr.sh_size;
-          sum.align = std::max<i64>(sum.align, isec.shdr.sh_addralign);
+          sum.align = std::max<i64>(sum.align, align);
         }
         return sum;
       },
@@ -484,6 +795,210 @@ void claim_unresolved_symbols(Context<E> &ctx) {
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     file->claim_unresolved_symbols(ctx);
   });
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    file->update_unresolved_symbols(ctx);
+  });
+}
+
+// Assigns .got, .plt, .plt.got and .dynsym slots to symbols based on
+// their flags. Since each symbol needs a fixed number of slots in each
+// table, we split symbols into blocks, count slots for each block in
+// parallel, compute prefix sums, and then assign indices in parallel.
+// The resulting layout is the same as if we added symbols to the
+// tables one by one.
+template <typename E>
+static void assign_slots(Context<E> &ctx, std::span<Symbol<E> *> syms) {
+  struct Counts {
+    i64 got = 0;
+    i64 got_syms = 0;
+    i64 gottp_syms = 0;
+    i64 tlsgd_syms = 0;
+    i64 tlsdesc_syms = 0;
+    i64 plt = 0;
+    i64 pltgot = 0;
+    i64 dynsym = 0;
+    bool has_tlsld = false;
+  };
+
+  // If we need to create a canonical PLT, we can't use .plt.got
+  // because otherwise .plt.got and .got would refer each other,
+  // resulting in an infinite loop at runtime.
+  auto is_plt = [&](Symbol<E> *sym) {
+    return (sym->flags & NEEDS_PLT) &&
+           (!(sym->flags & NEEDS_GOT) || (!ctx.arg.pic && sym->is_imported));
+  };
+
+  auto is_pltgot = [&](Symbol<E> *sym) {
+    return (sym->flags & NEEDS_PLT) && !is_plt(sym);
+  };
+
+  // With -z now, lazy binding is never used, so there's no point in
+  // creating lazy PLT entries along with a PLT header and .got.plt
+  // slots. We give such symbols GOT slots so that they use compact
+  // .plt.got entries that just jump through the GOT instead.
+  if (ctx.arg.z_now) {
+    tbb::parallel_for_each(syms, [&](Symbol<E> *sym) {
+      if ((sym->flags & NEEDS_PLT) && (ctx.arg.pic || !sym->is_imported))
+        sym->flags |= NEEDS_GOT;
+    });
+  }
+
+  auto is_dynsym = [&](Symbol<E> *sym) {
+    u8 flags = sym->flags;
+    return (flags & (NEEDS_DYNSYM | NEEDS_TLSGD | NEEDS_TLSDESC |
+                     NEEDS_COPYREL)) ||
+           (sym->is_imported && (flags & (NEEDS_GOT | NEEDS_GOTTP))) ||
+           is_plt(sym);
+  };
+
+  constexpr i64 block_size = 10000;
+  i64 num_blocks = (syms.size() + block_size - 1) / block_size;
+  std::vector<Counts> counts(num_blocks + 1);
+
+  auto get_block = [&](i64 i) {
+    return syms.subspan(i * block_size,
+                        std::min<i64>(block_size, syms.size() - i * block_size));
+  };
+
+  tbb::parallel_for((i64)0, num_blocks, [&](i64 i) {
+    Counts &c = counts[i + 1];
+    for (Symbol<E> *sym : get_block(i)) {
+      u8 flags = sym->flags;
+      c.got_syms += !!(flags & NEEDS_GOT);
+      c.gottp_syms += !!(flags & NEEDS_GOTTP);
+      c.tlsgd_syms += !!(flags & NEEDS_TLSGD);
+      c.tlsdesc_syms += !!(flags & NEEDS_TLSDESC);
+      c.has_tlsld |= !!(flags & NEEDS_TLSLD);
+      c.plt += is_plt(sym);
+      c.pltgot += is_pltgot(sym);
+      c.dynsym += is_dynsym(sym);
+    }
+    c.got = c.got_syms + c.gottp_syms + c.tlsgd_syms * 2 + c.tlsdesc_syms * 2;
+  });
+
+  // Only the first symbol with NEEDS_TLSLD allocates a GOT slot pair.
+  i64 tlsld_block = -1;
+  if (ctx.got->tlsld_idx == -1) {
+    for (i64 i = 0; i < num_blocks; i++) {
+      if (counts[i + 1].has_tlsld) {
+        tlsld_block = i;
+        counts[i + 1].got += 2;
+        break;
+      }
+    }
+  }
+
+  // Compute prefix sums. counts[i] becomes the first indices for the
+  // i'th block, and counts[num_blocks] holds totals.
+  counts[0].got = ctx.got->shdr.sh_size / E::wordsize;
+  for (i64 i = 1; i < num_blocks + 1; i++) {
+    counts[i].got += counts[i - 1].got;
+    counts[i].got_syms += counts[i - 1].got_syms;
+    counts[i].gottp_syms += counts[i - 1].gottp_syms;
+    counts[i].tlsgd_syms += counts[i - 1].tlsgd_syms;
+    counts[i].tlsdesc_syms += counts[i - 1].tlsdesc_syms;
+    counts[i].plt += counts[i - 1].plt;
+    counts[i].pltgot += counts[i - 1].pltgot;
+    counts[i].dynsym += counts[i - 1].dynsym;
+  }
+
+  Counts &total = counts[num_blocks];
+
+  // Allocate table entries.
+  GotSection<E> &got = *ctx.got;
+  got.got_syms.resize(got.got_syms.size() + total.got_syms);
+  got.gottp_syms.resize(got.gottp_syms.size() + total.gottp_syms);
+  got.tlsgd_syms.resize(got.tlsgd_syms.size() + total.tlsgd_syms);
+  got.tlsdesc_syms.resize(got.tlsdesc_syms.size() + total.tlsdesc_syms);
+
+  if (total.plt && ctx.plt->shdr.sh_size == 0) {
+    ctx.plt->shdr.sh_size = E::plt_hdr_size;
+    ctx.gotplt->shdr.sh_size = E::wordsize * 3;
+  }
+
+  i64 plt_size = ctx.plt->shdr.sh_size;
+  i64 gotplt_idx = ctx.gotplt->shdr.sh_size / E::wordsize;
+  i64 pltgot_size = ctx.pltgot->shdr.sh_size;
+
+  std::span<Symbol<E> *> got_syms =
+    std::span(got.got_syms).last(total.got_syms);
+  std::span<Symbol<E> *> gottp_syms =
+    std::span(got.gottp_syms).last(total.gottp_syms);
+  std::span<Symbol<E> *> tlsgd_syms =
+    std::span(got.tlsgd_syms).last(total.tlsgd_syms);
+  std::span<Symbol<E> *> tlsdesc_syms =
+    std::span(got.tlsdesc_syms).last(total.tlsdesc_syms);
+
+  ctx.plt->symbols.resize(ctx.plt->symbols.size() + total.plt);
+  ctx.pltgot->symbols.resize(ctx.pltgot->symbols.size() + total.pltgot);
+  ctx.dynsym->symbols.resize(ctx.dynsym->symbols.size() + total.dynsym);
+
+  std::span<Symbol<E> *> plt_syms =
+    std::span(ctx.plt->symbols).last(total.plt);
+  std::span<Symbol<E> *> pltgot_syms =
+    std::span(ctx.pltgot->symbols).last(total.pltgot);
+  std::span<Symbol<E> *> dynsyms =
+    std::span(ctx.dynsym->symbols).last(total.dynsym);
+
+  // Assign indices.
+  tbb::parallel_for((i64)0, num_blocks, [&](i64 i) {
+    Counts c = counts[i];
+    bool has_tlsld = (i == tlsld_block);
+
+    for (Symbol<E> *sym : get_block(i)) {
+      u8 flags = sym->flags;
+
+      if (is_dynsym(sym)) {
+        sym->set_dynsym_idx(ctx, -2);
+        dynsyms[c.dynsym++] = sym;
+      }
+
+      if (flags & NEEDS_GOT) {
+        sym->set_got_idx(ctx, c.got++);
+        got_syms[c.got_syms++] = sym;
+      }
+
+      if (is_plt(sym)) {
+        sym->set_plt_idx(ctx, (plt_size + c.plt * E::plt_size) / E::plt_size);
+        sym->set_gotplt_idx(ctx, gotplt_idx + c.plt);
+        plt_syms[c.plt++] = sym;
+      } else if (is_pltgot(sym)) {
+        sym->set_pltgot_idx(ctx, (pltgot_size + c.pltgot * E::pltgot_size) /
+                                 E::pltgot_size);
+        pltgot_syms[c.pltgot++] = sym;
+      }
+
+      if (flags & NEEDS_GOTTP) {
+        sym->set_gottp_idx(ctx, c.got++);
+        gottp_syms[c.gottp_syms++] = sym;
+      }
+
+      if (flags & NEEDS_TLSGD) {
+        sym->set_tlsgd_idx(ctx, c.got);
+        c.got += 2;
+        tlsgd_syms[c.tlsgd_syms++] = sym;
+      }
+
+      if (flags & NEEDS_TLSDESC) {
+        sym->set_tlsdesc_idx(ctx, c.got);
+        c.got += 2;
+        tlsdesc_syms[c.tlsdesc_syms++] = sym;
+      }
+
+      if ((flags & NEEDS_TLSLD) && has_tlsld) {
+        got.tlsld_idx = c.got;
+        c.got += 2;
+        has_tlsld = false;
+      }
+    }
+  });
+
+  got.shdr.sh_size = total.got * E::wordsize;
+  ctx.plt->shdr.sh_size += total.plt * E::plt_size;
+  ctx.gotplt->shdr.sh_size += total.plt * E::wordsize;
+  ctx.relplt->shdr.sh_size += total.plt * sizeof(ElfRel<E>);
+  ctx.pltgot->shdr.sh_size += total.pltgot * E::pltgot_size;
 }
 
 template <typename E>
@@ -492,6 +1007,8 @@ void scan_rels(Context<E> &ctx) {
 
   // Scan relocations to find dynamic symbols.
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    TaskTimer t2(ctx, t, file->filename);
+    CostTimer t3(ctx.arg.perf_files, file->scan_time);
     file->scan_relocations(ctx);
   });
 
@@ -517,8 +1034,13 @@ void scan_rels(Context<E> &ctx) {
     for (Symbol<E> *sym : files[i]->symbols) {
       if (!files[i]->is_dso && (sym->is_imported || sym->is_exported))
         sym->flags |= NEEDS_DYNSYM;
-      if (sym->file == files[i] && sym->flags)
+
+      // A symbol may appear more than once in the same file's symbol
+      // list, so we use aux_idx to mark it as visited.
+      if (sym->file == files[i] && sym->flags && sym->aux_idx == -1) {
+        sym->aux_idx = 0;
         vec[i].push_back(sym);
+      }
     }
   });
 
@@ -529,40 +1051,11 @@ void scan_rels(Context<E> &ctx) {
     syms[i]->aux_idx = i;
 
   // Assign offsets in additional tables for each dynamic symbol.
-  for (Symbol<E> *sym : syms) {
-    if (sym->flags & NEEDS_DYNSYM)
-      ctx.dynsym->add_symbol(ctx, sym);
-
-    if (sym->flags & NEEDS_GOT)
-      ctx.got->add_got_symbol(ctx, sym);
-
-    if (sym->flags & NEEDS_PLT) {
-      if (sym->flags & NEEDS_GOT) {
-        // If we need to create a canonical PLT, we can't use .plt.got
-        // because otherwise .plt.got and .got would refer each other,
-        // resulting in an infinite loop at runtime.
-        if (!ctx.arg.pic && sym->is_imported)
-          ctx.plt->add_symbol(ctx, sym);
-        else
-          ctx.pltgot->add_symbol(ctx, sym);
-      } else {
-        ctx.plt->add_symbol(ctx, sym);
-      }
-    }
-
-
-    if (sym->flags & NEEDS_GOTTP)
-      ctx.got->add_gottp_symbol(ctx, sym);
-
-    if (sym->flags & NEEDS_TLSGD)
-      ctx.got->add_tlsgd_symbol(ctx, sym);
-
-    if (sym->flags & NEEDS_TLSDESC)
-      ctx.got->add_tlsdesc_symbol(ctx, sym);
-
-    if (sym->flags & NEEDS_TLSLD)
-      ctx.got->add_tlsld(ctx);
+  assign_slots<E>(ctx, syms);
 
+  // COPYREL symbols need to be aligned in .dynbss, and they are rare,
+  // so we assign their offsets serially.
+  for (Symbol<E> *sym : syms) {
     if (sym->flags & NEEDS_COPYREL) {
       assert(sym->file->is_dso);
       SharedFile<E> *file = (SharedFile<E> *)sym->file;
@@ -580,40 +1073,64 @@ void scan_rels(Context<E> &ctx) {
         ctx.dynsym->add_symbol(ctx, alias);
       }
     }
-
-    sym->flags = 0;
   }
+
+  tbb::parallel_for_each(syms, [](Symbol<E> *sym) { sym->flags = 0; });
+}
+
+// Collect base relocations that can be represented in .relr.dyn.
+template <typename E>
+void construct_relr(Context<E> &ctx) {
+  Timer t(ctx, "construct_relr");
+
+  tbb::parallel_for_each(ctx.output_sections,
+                         [&](std::unique_ptr<OutputSection<E>> &osec) {
+    osec->construct_relr(ctx);
+  });
+
+  ctx.got->construct_relr(ctx);
 }
 
 template <typename E>
 void apply_version_script(Context<E> &ctx) {
   Timer t(ctx, "apply_version_script");
 
-  for (VersionPattern &elem : ctx.arg.version_patterns) {
+  // If multiple patterns match a symbol, the last one takes precedence.
+  // We compile all patterns into two matchers, one for C symbols and
+  // the other for demangled C++ symbols, so that each symbol is
+  // examined only once no matter how many patterns we have.
+  MultiGlob matcher;
+  MultiGlob cpp_matcher;
+
+  for (i64 i = 0; i < ctx.arg.version_patterns.size(); i++) {
+    VersionPattern &elem = ctx.arg.version_patterns[i];
     assert(elem.pattern != "*");
 
-    if (!elem.is_extern_cpp &&
-        elem.pattern.find('*') == elem.pattern.npos) {
-      Symbol<E> *sym = intern(ctx, elem.pattern);
-      if (sym->file && !sym->file->is_dso)
-        sym->ver_idx = elem.ver_idx;
-      continue;
-    }
+    if (elem.is_extern_cpp)
+      cpp_matcher.add(elem.pattern, i);
+    else
+      matcher.add(elem.pattern, i);
+  }
 
-    std::regex re = glob_to_regex(elem.pattern);
+  if (matcher.empty() && cpp_matcher.empty())
+    return;
 
-    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-      for (Symbol<E> *sym : file->get_global_syms()) {
-        if (sym->file == file) {
-          std::string_view name = sym->name();
-          if (elem.is_extern_cpp)
-            name = demangle(name);
-          if (std::regex_match(name.begin(), name.end(), re))
-            sym->ver_idx = elem.ver_idx;
-        }
-      }
-    });
-  }
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    for (Symbol<E> *sym : file->get_global_syms()) {
+      if (sym->file != file)
+        continue;
+
+      std::string_view name = sym->name();
+      i64 idx = matcher.find(name, sym->name_hash);
+      // Each symbol is visited only once, so there's no point in
+      // caching demangled names here.
+      if (!cpp_matcher.empty())
+        idx = std::max(idx, cpp_matcher.find(demangle_uncached(name)));
+
+      if (idx != -1)
+        sym->ver_idx = ctx.arg.version_patterns[idx].ver_idx;
+    }
+  });
 }
 
 template <typename E>
@@ -667,7 +1184,7 @@ void compute_import_export(Context<E> &ctx) {
     tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
       for (Symbol<E> *sym : file->globals) {
         if (sym->file && !sym->file->is_dso && sym->visibility != STV_HIDDEN) {
-          std::lock_guard lock(sym->mu);
+          ProfiledLock lock(sym->mu, symbol_lock_stats());
           sym->is_exported = true;
         }
       }
@@ -695,20 +1212,52 @@ void compute_import_export(Context<E> &ctx) {
   }
 }
 
+// Zero-clears gaps between output chunks. There's nothing to do if the
+// output buffer is already zero-filled. Otherwise, we reuse an existing
+// output file, and page-aligned parts of large gaps are dropped from
+// the file with MADV_REMOVE, which leaves holes instead of writing
+// zero pages. The rest is cleared in parallel.
 template <typename E>
 void clear_padding(Context<E> &ctx) {
   Timer t(ctx, "clear_padding");
 
-  auto zero = [&](Chunk<E> *chunk, i64 next_start) {
+  OutputFile<E> &file = *ctx.output_file;
+  if (file.is_zero_filled)
+    return;
+
+  std::vector<std::pair<i64, i64>> gaps;
+
+  auto add = [&](Chunk<E> *chunk, i64 next_start) {
     i64 pos = chunk->shdr.sh_offset;
     if (chunk->shdr.sh_type != SHT_NOBITS)
       pos += chunk->shdr.sh_size;
-    memset(ctx.buf + pos, 0, next_start - pos);
+    if (pos < next_start)
+      gaps.push_back({pos, next_start});
   };
 
   for (i64 i = 1; i < ctx.chunks.size(); i++)
-    zero(ctx.chunks[i - 1], ctx.chunks[i]->shdr.sh_offset);
-  zero(ctx.chunks.back(), ctx.output_file->filesize);
+    add(ctx.chunks[i - 1], ctx.chunks[i]->shdr.sh_offset);
+  add(ctx.chunks.back(), file.filesize);
+
+  static const i64 page_size = sysconf(_SC_PAGESIZE);
+  constexpr i64 hole_threshold = 1024 * 1024;
+
+  tbb::parallel_for_each(gaps, [&](std::pair<i64, i64> gap) {
+    auto [begin, end] = gap;
+
+#ifdef MADV_REMOVE
+    if (file.is_mmapped && end - begin >= hole_threshold) {
+      u64 lo = align_to((u64)ctx.buf + begin, page_size);
+      u64 hi = align_down((u64)ctx.buf + end, page_size);
+      if (madvise((void *)lo, hi - lo, MADV_REMOVE) == 0) {
+        memset(ctx.buf + begin, 0, (u8 *)lo - (ctx.buf + begin));
+        memset((u8 *)hi, 0, ctx.buf + end - (u8 *)hi);
+        return;
+      }
+    }
+#endif
+    memset(ctx.buf + begin, 0, end - begin);
+  });
 }
 
 // We want to sort output chunks in the following order.
@@ -725,8 +1274,18 @@ void clear_padding(Context<E> &ctx) {
 //   alloc writable RELRO bss
 //   alloc writable non-RELRO data
 //   alloc writable non-RELRO bss
+//   x86-64 large bss
+//   x86-64 large readonly data
+//   x86-64 large writable data
 //   nonalloc
 //   section header
+//
+// Sections with SHF_X86_64_LARGE (.lbss, .lrodata and .ldata) are
+// accessed by the medium or large code model without 32-bit
+// PC-relative relocations, so we place them after all the other
+// sections. Then they don't push small-model data out of the range of
+// small-model code. .lbss follows .bss to share its segment as GNU ld
+// does.
 template <typename E>
 i64 get_section_rank(Context<E> &ctx, Chunk<E> *chunk) {
   u64 type = chunk->shdr.sh_type;
@@ -741,9 +1300,9 @@ i64 get_section_rank(Context<E> &ctx, Chunk<E> *chunk) {
   if (type == SHT_NOTE && (flags & SHF_ALLOC))
     return -1;
   if (chunk == ctx.shdr.get())
-    return 1 << 6;
+    return 1 << 7;
   if (!(flags & SHF_ALLOC))
-    return 1 << 5;
+    return 1 << 6;
 
   bool writable = (flags & SHF_WRITE);
   bool exec = (flags & SHF_EXECINSTR);
@@ -751,16 +1310,14 @@ i64 get_section_rank(Context<E> &ctx, Chunk<E> *chunk) {
   bool relro = is_relro(ctx, chunk);
   bool is_bss = (type == SHT_NOBITS);
 
+  if (E::e_machine == EM_X86_64 && (flags & SHF_X86_64_LARGE) &&
+      !exec && !tls && !relro)
+    return (1 << 5) | (!is_bss << 1) | writable;
+
   return (writable << 4) | (exec << 3) | (!tls << 2) |
          (!relro << 1) | is_bss;
 }
 
-// Returns the smallest number n such that
-// n >= val and n % align == skew.
-inline u64 align_with_skew(u64 val, u64 align, u64 skew) {
-  return align_to(val + align - skew, align) - align + skew;
-}
-
 // Assign virtual addresses and file offsets to output sections.
 template <typename E>
 i64 set_osec_offsets(Context<E> &ctx) {
@@ -785,11 +1342,25 @@ i64 set_osec_offsets(Context<E> &ctx) {
       Chunk<E> &chunk = *ctx.chunks[i];
       u64 prev_vaddr = vaddr;
 
-      if (chunk.new_page)
+      // A chunk with new_page_in_memory is moved to the next page in
+      // memory while keeping its offset within a page, so that it
+      // doesn't need padding in the file.
+      if (chunk.new_page_in_memory) {
+        vaddr = align_to(vaddr, COMMON_PAGE_SIZE) + vaddr % COMMON_PAGE_SIZE;
+        prev_vaddr = vaddr;
+      } else if (chunk.new_page) {
         vaddr = align_to(vaddr, COMMON_PAGE_SIZE);
+      }
       vaddr = align_to(vaddr, chunk.shdr.sh_addralign);
       fileoff += vaddr - prev_vaddr;
 
+      // A huge page boundary is a huge page boundary both in memory
+      // and in the file.
+      if (chunk.new_huge_page) {
+        vaddr = align_to(vaddr, HUGE_PAGE_SIZE);
+        fileoff = align_to(fileoff, HUGE_PAGE_SIZE);
+      }
+
       chunk.shdr.sh_addr = vaddr;
       vaddr += chunk.shdr.sh_size;
 
@@ -802,6 +1373,8 @@ i64 set_osec_offsets(Context<E> &ctx) {
 
       if (chunk.new_page)
         vaddr = align_to(vaddr, COMMON_PAGE_SIZE);
+      if (chunk.new_huge_page)
+        vaddr = align_to(vaddr, HUGE_PAGE_SIZE);
       vaddr = align_to(vaddr, chunk.shdr.sh_addralign);
       fileoff = align_with_skew(fileoff, COMMON_PAGE_SIZE, vaddr % COMMON_PAGE_SIZE);
 
@@ -815,6 +1388,8 @@ i64 set_osec_offsets(Context<E> &ctx) {
   for (; i < ctx.chunks.size(); i++) {
     Chunk<E> &chunk = *ctx.chunks[i];
     assert(!(chunk.shdr.sh_flags & SHF_ALLOC));
+    if (chunk.new_huge_page)
+      fileoff = align_to(fileoff, HUGE_PAGE_SIZE);
     fileoff = align_to(fileoff, chunk.shdr.sh_addralign);
     chunk.shdr.sh_offset = fileoff;
     fileoff += chunk.shdr.sh_size;
@@ -833,16 +1408,26 @@ static i64 get_num_irelative_relocs(Context<E> &ctx) {
 
 template <typename E>
 void fix_synthetic_symbols(Context<E> &ctx) {
-  auto start = [](Symbol<E> *sym, auto &chunk) {
+  // Output section indices of synthetic symbols are rarely needed, so
+  // they are not members of Symbol but of SymbolAux.
+  auto set_shndx = [&](Symbol<E> *sym, i64 shndx) {
+    if (sym->aux_idx == -1) {
+      sym->aux_idx = ctx.symbol_aux.size();
+      ctx.symbol_aux.push_back({});
+    }
+    ctx.symbol_aux[sym->aux_idx].shndx = shndx;
+  };
+
+  auto start = [&](Symbol<E> *sym, auto &chunk) {
     if (sym && chunk) {
-      sym->shndx = chunk->shndx;
+      set_shndx(sym, chunk->shndx);
       sym->value = chunk->shdr.sh_addr;
     }
   };
 
-  auto stop = [](Symbol<E> *sym, auto &chunk) {
+  auto stop = [&](Symbol<E> *sym, auto &chunk) {
     if (sym && chunk) {
-      sym->shndx = chunk->shndx;
+      set_shndx(sym, chunk->shndx);
       sym->value = chunk->shdr.sh_addr + chunk->shdr.sh_size;
     }
   };
@@ -858,10 +1443,10 @@ void fix_synthetic_symbols(Context<E> &ctx) {
   // __ehdr_start and __executable_start
   for (Chunk<E> *chunk : ctx.chunks) {
     if (chunk->shndx == 1) {
-      ctx.__ehdr_start->shndx = 1;
+      set_shndx(ctx.__ehdr_start, 1);
       ctx.__ehdr_start->value = ctx.ehdr->shdr.sh_addr;
 
-      ctx.__executable_start->shndx = 1;
+      set_shndx(ctx.__executable_start, 1);
       ctx.__executable_start->value = ctx.ehdr->shdr.sh_addr;
       break;
     }
@@ -871,7 +1456,7 @@ void fix_synthetic_symbols(Context<E> &ctx) {
   start(ctx.__rel_iplt_start, ctx.reldyn);
 
   // __rel_iplt_end
-  ctx.__rel_iplt_end->shndx = ctx.reldyn->shndx;
+  set_shndx(ctx.__rel_iplt_end, ctx.reldyn->shndx);
   ctx.__rel_iplt_end->value = ctx.reldyn->shdr.sh_addr +
     get_num_irelative_relocs(ctx) * sizeof(ElfRel<E>);
 
@@ -939,6 +1524,24 @@ void fix_synthetic_symbols(Context<E> &ctx) {
   }
 }
 
+// Debug info sections usually account for most of the output, but
+// they can't be copied until the file layout is fixed. Compressed
+// input debug sections are inflated only when they are copied, which
+// puts their decompression on the critical path of the copy phase.
+//
+// This function inflates them ahead of time. main() runs it in the
+// background right after input section offsets are assigned, so that
+// it overlaps with relocation scanning, symbol table construction and
+// the rest of the layout passes. Nothing may read contents of non-alloc
+// input sections until it finishes.
+template <typename E>
+void inflate_nonalloc_sections(Context<E> &ctx) {
+  Timer t(ctx, "inflate_nonalloc_sections");
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    file->inflate_nonalloc_sections(ctx);
+  });
+}
+
 template <typename E>
 void compress_debug_sections(Context<E> &ctx) {
   Timer t(ctx, "compress_debug_sections");
@@ -950,11 +1553,26 @@ void compress_debug_sections(Context<E> &ctx) {
         !chunk.name.starts_with(".debug"))
       return;
 
+    TaskTimer t2(ctx, t, chunk.name);
     Chunk<E> *comp = nullptr;
-    if (ctx.arg.compress_debug_sections == COMPRESS_GABI)
-      comp = new GabiCompressedSection<E>(ctx, chunk);
-    else if (ctx.arg.compress_debug_sections == COMPRESS_GNU)
-      comp = new GnuCompressedSection<E>(ctx, chunk);
+
+    auto compress = [&] {
+      if (ctx.arg.compress_debug_sections == COMPRESS_GABI ||
+          ctx.arg.compress_debug_sections == COMPRESS_ZSTD)
+        comp = new GabiCompressedSection<E>(ctx, chunk);
+      else if (ctx.arg.compress_debug_sections == COMPRESS_GNU)
+        comp = new GnuCompressedSection<E>(ctx, chunk);
+    };
+
+    // Compressing a section may need buffers as large as the section.
+    // With --memory-limit, we compress only as many sections at once as
+    // fit in the limit.
+    if (ctx.memory_budget.limit) {
+      MemoryBudget::Share share(ctx.memory_budget, chunk.shdr.sh_size);
+      tbb::this_task_arena::isolate(compress);
+    } else {
+      compress();
+    }
     assert(comp);
 
     ctx.output_chunks.push_back(std::unique_ptr<Chunk<E>>(comp));
@@ -966,10 +1584,238 @@ void compress_debug_sections(Context<E> &ctx) {
   ctx.shdr->update_shdr(ctx);
 }
 
+// Writes back a finished range of the output file and drops it from
+// memory. Pages that are read or written again later are just faulted
+// in again.
+template <typename E>
+static void page_out(OutputFile<E> &file, i64 offset, i64 size) {
+  if (!file.is_mmapped)
+    return;
+
+  static const i64 page_size = sysconf(_SC_PAGESIZE);
+  u64 begin = align_to((u64)file.buf + offset, page_size);
+  u64 end = align_down((u64)file.buf + offset + size, page_size);
+  if (begin >= end)
+    return;
+
+#ifdef MADV_PAGEOUT
+  if (madvise((void *)begin, end - begin, MADV_PAGEOUT) == 0)
+    return;
+#endif
+  madvise((void *)begin, end - begin, MADV_DONTNEED);
+}
+
+// Starts writing back a finished range of the output file without
+// waiting for the I/O to complete. Otherwise, all dirty pages are
+// flushed at once after we exit, which can throttle other processes.
+template <typename E>
+static void start_writeback(OutputFile<E> &file, i64 offset, i64 size) {
+#ifdef SYNC_FILE_RANGE_WRITE
+  if (file.fd != -1 && size > 0)
+    sync_file_range(file.fd, offset, size, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+// Copies all output chunks to the output file.
+//
+// If we simply created one task for each chunk, a link with one huge
+// output section such as .text or .debug_info would end up with a long
+// tail in which only one thread was working on that section. So we
+// split output sections into shards of members of roughly the same
+// size and schedule shards of all chunks together.
+//
+// With --separate-debug-file, debug info sections are written to the
+// debug info file in the same loop. Chunk indices beyond the end of
+// ctx.chunks refer to them.
+template <typename E>
+void copy_chunks(Context<E> &ctx) {
+  Timer t(ctx, "copy_buf");
+
+  struct Shard {
+    i64 chunk_idx;
+    i64 begin;
+    i64 end;
+  };
+
+  // Each shard contains input sections of about this many bytes.
+  static constexpr i64 SHARD_SIZE = 1024 * 1024;
+
+  std::vector<Chunk<E> *> chunks = ctx.chunks;
+  if (ctx.debug_file)
+    append(chunks, ctx.debug_file->chunks);
+
+  auto is_debug_chunk = [&](i64 idx) { return idx >= ctx.chunks.size(); };
+
+  std::vector<Shard> shards;
+  std::vector<std::atomic<i64>> num_shards(chunks.size());
+
+  for (i64 i = 0; i < chunks.size(); i++) {
+    Chunk<E> *chunk = chunks[i];
+
+    if (chunk->kind != Chunk<E>::REGULAR ||
+        chunk->shdr.sh_type == SHT_NOBITS) {
+      shards.push_back({i, -1, -1});
+      num_shards[i]++;
+      continue;
+    }
+
+    std::vector<InputSection<E> *> &members =
+      ((OutputSection<E> *)chunk)->members;
+
+    i64 begin = 0;
+    i64 size = 0;
+
+    for (i64 j = 0; j < members.size(); j++) {
+      if (ctx.arg.release_inputs)
+        members[j]->file.num_unwritten_sections++;
+
+      size += members[j]->shdr.sh_size;
+      if (size >= SHARD_SIZE || j == members.size() - 1) {
+        shards.push_back({i, begin, j + 1});
+        num_shards[i]++;
+        begin = j + 1;
+        size = 0;
+      }
+    }
+
+    if (members.empty()) {
+      shards.push_back({i, 0, 0});
+      num_shards[i]++;
+    }
+  }
+
+  i64 total_bytes = 0;
+  for (Chunk<E> *chunk : chunks)
+    if (chunk->shdr.sh_type != SHT_NOBITS)
+      total_bytes += chunk->shdr.sh_size;
+
+  ProgressCounter progress("copy_buf", total_bytes);
+
+  tbb::parallel_for_each(shards, [&](Shard &shard) {
+    Chunk<E> *chunk = chunks[shard.chunk_idx];
+    TaskTimer t2(ctx, t, chunk->name.empty() ? "(header)" : chunk->name);
+
+    bool is_debug = is_debug_chunk(shard.chunk_idx);
+    OutputFile<E> &file = is_debug ? *ctx.debug_file->file : *ctx.output_file;
+
+    if (shard.begin == -1) {
+      if (is_debug)
+        chunk->write_to(ctx, file.buf + chunk->shdr.sh_offset);
+      else
+        chunk->copy_buf(ctx);
+
+      if (ctx.arg.early_writeback && chunk->shdr.sh_type != SHT_NOBITS)
+        start_writeback(file, chunk->shdr.sh_offset, chunk->shdr.sh_size);
+    } else {
+      OutputSection<E> *osec = (OutputSection<E> *)chunk;
+
+      // With --memory-limit, non-allocated sections such as debug info
+      // are written only as much at once as fit in the limit, and
+      // written-back as soon as they are written, so that they don't
+      // accumulate in memory. Other sections are small in comparison.
+      if (ctx.memory_budget.limit && !(chunk->shdr.sh_flags & SHF_ALLOC) &&
+          shard.begin < shard.end) {
+        InputSection<E> *first = osec->members[shard.begin];
+        InputSection<E> *last = osec->members[shard.end - 1];
+        i64 offset = chunk->shdr.sh_offset + first->offset;
+        i64 size = last->offset + last->shdr.sh_size - first->offset;
+
+        MemoryBudget::Share share(ctx.memory_budget, size);
+        osec->write_members(ctx, file.buf + chunk->shdr.sh_offset,
+                            shard.begin, shard.end);
+        page_out(file, offset, size);
+      } else {
+        osec->write_members(ctx, file.buf + chunk->shdr.sh_offset,
+                            shard.begin, shard.end);
+
+        if (ctx.arg.early_writeback && shard.begin < shard.end) {
+          InputSection<E> *first = osec->members[shard.begin];
+          InputSection<E> *last = osec->members[shard.end - 1];
+          start_writeback(file, chunk->shdr.sh_offset + first->offset,
+                          last->offset + last->shdr.sh_size - first->offset);
+        }
+      }
+
+      // With --release-inputs, we drop an input file from memory once
+      // all of its sections are written. Later passes such as symbol
+      // table writers may still read the file; they just page it in
+      // again.
+      if (ctx.arg.release_inputs) {
+        for (i64 i = shard.begin; i < shard.end; i++) {
+          ObjectFile<E> &file = osec->members[i]->file;
+          if (--file.num_unwritten_sections == 0)
+            file.mf->release();
+        }
+      }
+    }
+
+    // The build ID and the debug info file's CRC are computed over
+    // finished chunks while other chunks are still being written, so
+    // that we don't read the outputs again after copying. .gnu_debuglink
+    // is released after the debug info file's CRC is written to it.
+    if (--num_shards[shard.chunk_idx] == 0) {
+      if (is_debug)
+        ctx.debug_file->release(ctx, chunk);
+      else if (ctx.buildid && chunk != ctx.gnu_debuglink.get())
+        ctx.buildid->release(ctx, chunk);
+    }
+
+    if (Progress::fd != -1 && chunk->shdr.sh_type != SHT_NOBITS) {
+      if (shard.begin == -1) {
+        progress.add(chunk->shdr.sh_size);
+      } else if (shard.begin < shard.end) {
+        std::vector<InputSection<E> *> &members =
+          ((OutputSection<E> *)chunk)->members;
+        InputSection<E> *last = members[shard.end - 1];
+        progress.add(last->offset + last->shdr.sh_size -
+                     members[shard.begin]->offset);
+      }
+    }
+  });
+}
+
+// Returns a tar file containing all input files and the command line
+// arguments for --repro and --repro-file.
+template <typename E>
+TarFile create_repro_tar(Context<E> &ctx) {
+  TarFile tar("repro");
+
+  tar.append("response.txt", save_string(ctx, create_response_file(ctx)));
+  tar.append("version.txt", save_string(ctx, mold_version + "\n"));
+
+  std::unordered_set<std::string> seen;
+  for (std::unique_ptr<MappedFile<Context<E>>> &mf : ctx.mf_pool) {
+    std::string path = path_to_absolute(mf->name);
+    if (seen.insert(path).second)
+      tar.append(path, mf->get_contents());
+  }
+  return tar;
+}
+
+// Writes a zstd-compressed tar file of input files to a file given by
+// --repro-file instead of embedding it to the output file. Input files
+// are read directly from their mmap'ed buffers and compressed in
+// parallel shards.
+template <typename E>
+void write_repro_file(Context<E> &ctx) {
+  Timer t(ctx, "write_repro_file");
+
+  TarFile tar = create_repro_tar(ctx);
+  ZstdCompressor zstd(tar.size(), [&](u8 *buf, i64 offset, i64 size) {
+    tar.write_to(buf, offset, size);
+  });
+
+  std::unique_ptr<OutputFile<E>> file =
+    OutputFile<E>::open(ctx, ctx.arg.repro_file, zstd.size(), 0666);
+  zstd.write_to(file->buf);
+  file->close(ctx);
+}
+
 #define INSTANTIATE(E)                                                  \
   template void apply_exclude_libs(Context<E> &ctx);                    \
   template void create_synthetic_sections(Context<E> &ctx);             \
   template void resolve_symbols(Context<E> &ctx);                       \
+  template void register_subsections(Context<E> &ctx);                  \
   template void eliminate_comdats(Context<E> &ctx);                     \
   template void convert_common_symbols(Context<E> &ctx);                \
   template void compute_merged_section_sizes(Context<E> &ctx);          \
@@ -977,10 +1823,15 @@ void compress_debug_sections(Context<E> &ctx) {
   template ObjectFile<E> *create_internal_file(Context<E> &ctx);        \
   template void check_duplicate_symbols(Context<E> &ctx);               \
   template void sort_init_fini(Context<E> &ctx);                        \
+  template void apply_section_order(Context<E> &ctx,                     \
+    const std::unordered_map<InputSection<E> *, i64> &order);           \
+  template void sort_by_symbol_order(Context<E> &ctx);                  \
+  template void sort_by_data_order(Context<E> &ctx);                    \
   template std::vector<Chunk<E> *> collect_output_sections(Context<E> &ctx); \
   template void compute_section_sizes(Context<E> &ctx);                 \
   template void claim_unresolved_symbols(Context<E> &ctx);              \
   template void scan_rels(Context<E> &ctx);                             \
+  template void construct_relr(Context<E> &ctx);                        \
   template void apply_version_script(Context<E> &ctx);                  \
   template void parse_symbol_version(Context<E> &ctx);                  \
   template void compute_import_export(Context<E> &ctx);                 \
@@ -988,7 +1839,11 @@ void compress_debug_sections(Context<E> &ctx) {
   template i64 get_section_rank(Context<E> &ctx, Chunk<E> *chunk);      \
   template i64 set_osec_offsets(Context<E> &ctx);                       \
   template void fix_synthetic_symbols(Context<E> &ctx);                 \
-  template void compress_debug_sections(Context<E> &ctx);
+  template void inflate_nonalloc_sections(Context<E> &ctx);             \
+  template void compress_debug_sections(Context<E> &ctx);               \
+  template void copy_chunks(Context<E> &ctx);                           \
+  template TarFile create_repro_tar(Context<E> &ctx);                   \
+  template void write_repro_file(Context<E> &ctx);
 
 INSTANTIATE(X86_64);
 INSTANTIATE(I386);
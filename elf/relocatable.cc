@@ -9,9 +9,11 @@
 // independent feature from others. That's why this file share only a
 // small amount of code with other files.
 //
-// Since the -r option is a minor feature, we don't aim for speed in
-// this file. This is a "better than nothing" implementation of the -r
-// option.
+// Some build systems use -r heavily to pre-combine object files, so
+// we parallelize the parts that don't depend on input file order:
+// parsing input files, copying local symbols and writing chunks.
+// Merging global symbols and strings is done serially to keep the
+// output deterministic.
 //
 // Here is the strategy as to how to combine multiple object files
 // into one:
@@ -29,6 +31,8 @@
 #include "mold.h"
 #include "../archive-file.h"
 
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -73,7 +77,8 @@ public:
     this->out_shdr.sh_addralign = E::wordsize;
   }
 
-  void add_local_symbol(Context<E> &ctx, RObjectFile<E> &file, i64 idx);
+  void add_local_symbols(Context<E> &ctx,
+                         std::span<std::unique_ptr<RObjectFile<E>>> files);
   void add_global_symbol(Context<E> &ctx, RObjectFile<E> &file, i64 idx);
   void update_shdr(Context<E> &ctx) override;
   void write_to(Context<E> &ctx) override;
@@ -144,22 +149,54 @@ public:
 };
 
 template <typename E>
-void RSymtabSection<E>::add_local_symbol(Context<E> &ctx, RObjectFile<E> &file,
-                                         i64 idx) {
-  ElfSym<E> sym = file.syms[idx];
-  assert(sym.st_bind == STB_LOCAL);
-
-  if (!sym.is_undef() && !sym.is_abs() && !sym.is_common()) {
-    if (!file.sections[sym.st_shndx])
-      return;
-    sym.st_shndx = file.sections[sym.st_shndx]->shndx;
-  }
+static bool is_local_symbol_alive(RObjectFile<E> &file, const ElfSym<E> &sym) {
+  return sym.is_undef() || sym.is_abs() || sym.is_common() ||
+         file.sections[sym.st_shndx];
+}
 
-  std::string_view name = file.strtab + sym.st_name;
-  sym.st_name = ctx.r_strtab->add_string(name);
+// Copies local symbols of all files to .symtab. Each file gets a
+// contiguous slice of the symbol table whose position is computed
+// by prefix sum, so that slices can be filled in parallel.
+template <typename E>
+void RSymtabSection<E>::add_local_symbols(Context<E> &ctx,
+                         std::span<std::unique_ptr<RObjectFile<E>>> files) {
+  std::vector<i64> offsets(files.size() + 1);
+
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    RObjectFile<E> &file = *files[i];
+    for (i64 j = 1; j < file.first_global; j++)
+      if (is_local_symbol_alive(file, file.syms[j]))
+        offsets[i + 1]++;
+  });
+
+  offsets[0] = syms.size();
+  for (i64 i = 1; i < offsets.size(); i++)
+    offsets[i] += offsets[i - 1];
+  syms.resize(offsets.back());
+
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    RObjectFile<E> &file = *files[i];
+    i64 idx = offsets[i];
+
+    for (i64 j = 1; j < file.first_global; j++) {
+      ElfSym<E> sym = file.syms[j];
+      assert(sym.st_bind == STB_LOCAL);
+      if (!is_local_symbol_alive(file, sym))
+        continue;
 
-  file.symidx[idx] = syms.size();
-  syms.push_back(sym);
+      if (!sym.is_undef() && !sym.is_abs() && !sym.is_common())
+        sym.st_shndx = file.sections[sym.st_shndx]->shndx;
+      file.symidx[j] = idx;
+      syms[idx++] = sym;
+    }
+  });
+
+  // .strtab offsets depend on insertion order, so symbol names are
+  // added serially.
+  for (i64 i = 0; i < files.size(); i++)
+    for (i64 j = offsets[i]; j < offsets[i + 1]; j++)
+      syms[j].st_name = ctx.r_strtab->add_string(files[i]->strtab +
+                                                 syms[j].st_name);
 }
 
 template <typename E>
@@ -414,7 +451,7 @@ std::span<T> RObjectFile<E>::get_data(Context<E> &ctx, const ElfShdr<E> &shdr) {
 template <typename E>
 static std::vector<std::unique_ptr<RObjectFile<E>>>
 open_files(Context<E> &ctx, std::span<std::string_view> args) {
-  std::vector<std::unique_ptr<RObjectFile<E>>> files;
+  std::vector<std::pair<MappedFile<Context<E>> *, bool>> inputs;
   bool whole_archive = false;
 
   while (!args.empty()) {
@@ -447,18 +484,23 @@ open_files(Context<E> &ctx, std::span<std::string_view> args) {
 
     switch (get_file_type(mf)) {
     case FileType::ELF_OBJ:
-      files.emplace_back(new RObjectFile<E>(ctx, *mf, true));
+      inputs.push_back({mf, true});
       break;
     case FileType::AR:
     case FileType::THIN_AR:
       for (MappedFile<Context<E>> *child : read_archive_members(ctx, mf))
         if (get_file_type(child) == FileType::ELF_OBJ)
-          files.emplace_back(new RObjectFile<E>(ctx, *child, whole_archive));
+          inputs.push_back({child, whole_archive});
       break;
     default:
       break;
     }
   }
+
+  std::vector<std::unique_ptr<RObjectFile<E>>> files(inputs.size());
+  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
+    files[i].reset(new RObjectFile<E>(ctx, *inputs[i].first, inputs[i].second));
+  });
   return files;
 }
 
@@ -560,9 +602,7 @@ void combine_objects(Context<E> &ctx, std::span<std::string_view> file_args) {
       chunk->out_shdr.sh_name = shstrtab.add_string(chunk->name);
 
   // Copy symbols from input objects to an output object
-  for (std::unique_ptr<RObjectFile<E>> &file : files)
-    for (i64 i = 1; i < file->first_global; i++)
-      symtab.add_local_symbol(ctx, *file, i);
+  symtab.add_local_symbols(ctx, files);
 
   symtab.out_shdr.sh_info = symtab.syms.size();
 
@@ -571,24 +611,147 @@ void combine_objects(Context<E> &ctx, std::span<std::string_view> file_args) {
       symtab.add_global_symbol(ctx, *file, i);
 
   // Finalize section header
-  for (RChunk<E> *chunk : ctx.r_chunks)
+  tbb::parallel_for_each(ctx.r_chunks, [&](RChunk<E> *chunk) {
     chunk->update_shdr(ctx);
+  });
 
   // Open an output file
   i64 filesize = assign_offsets(ctx);
   std::unique_ptr<OutputFile<E>> out =
     OutputFile<E>::open(ctx, ctx.arg.output, filesize, 0666);
-  memset(out->buf, 0, filesize);
+  if (!out->is_zero_filled)
+    memset(out->buf, 0, filesize);
   ctx.buf = out->buf;
 
   // Write to the output file
-  for (RChunk<E> *chunk : ctx.r_chunks)
+  tbb::parallel_for_each(ctx.r_chunks, [&](RChunk<E> *chunk) {
     chunk->write_to(ctx);
+  });
   out->close(ctx);
 }
 
+// The rest of this file implements --emit-relocs. Unlike -r, it is a
+// small addition to a regular link: relocations of input sections are
+// copied to .rela.<name> sections of the output file, with their
+// offsets converted to output addresses and their symbols converted
+// to output .symtab indices.
+
+template <typename E>
+RelocSection<E>::RelocSection(Context<E> &ctx, OutputSection<E> &osec)
+  : Chunk<E>(this->SYNTHETIC), output_section(osec) {
+  this->name = save_string(ctx, (E::is_rel ? ".rel" : ".rela") +
+                                std::string(osec.name));
+  this->shdr.sh_type = E::is_rel ? SHT_REL : SHT_RELA;
+  this->shdr.sh_flags = SHF_INFO_LINK;
+  this->shdr.sh_entsize = sizeof(ElfRel<E>);
+  this->shdr.sh_addralign = E::wordsize;
+}
+
+template <typename E>
+void RelocSection<E>::update_shdr(Context<E> &ctx) {
+  offsets.clear();
+
+  i64 n = 0;
+  for (InputSection<E> *isec : output_section.members) {
+    offsets.push_back(n);
+    n += isec->get_rels(ctx).size();
+  }
+
+  this->shdr.sh_size = n * sizeof(ElfRel<E>);
+  this->shdr.sh_link = ctx.symtab->shndx;
+  this->shdr.sh_info = output_section.shndx;
+}
+
+// Returns an output symbol index and an addend for a relocation.
+//
+// A symbol in .symtab is referred to as-is. Other symbols, such as
+// section symbols, discarded local symbols and pieces of mergeable
+// sections, are referred to by section symbols of the output
+// sections containing them with adjusted addends. Symbols defined
+// outside of the output file are referred to by their addresses.
+template <typename E>
+static std::pair<i64, i64>
+get_output_reloc_target(Context<E> &ctx, InputSection<E> &isec,
+                        const ElfRel<E> &rel, SubsectionRef<E> *ref) {
+  if (ref)
+    return {ref->subsec->output_section.shndx,
+            ref->subsec->offset + ref->addend};
+
+  i64 addend = isec.get_addend(rel);
+  if (rel.r_sym == 0)
+    return {0, addend};
+
+  Symbol<E> &sym = *isec.file.symbols[rel.r_sym];
+
+  if (sym.file && !sym.file->is_dso && sym.write_to_symtab) {
+    i64 idx = ((ObjectFile<E> *)sym.file)->output_sym_indices[sym.sym_idx];
+    if (idx != -1)
+      return {idx, addend};
+  }
+
+  if (Subsection<E> *subsec = sym.get_subsec())
+    return {subsec->output_section.shndx, subsec->offset + sym.value + addend};
+
+  InputSection<E> *target = sym.input_section;
+  if (target && target->is_alive && !target->is_ehframe &&
+      target->output_section)
+    return {target->output_section->shndx,
+            target->offset + sym.value + addend};
+
+  return {0, sym.get_addr(ctx) + addend};
+}
+
+template <typename E>
+void RelocSection<E>::copy_buf(Context<E> &ctx) {
+  ElfRel<E> *buf = (ElfRel<E> *)(ctx.buf + this->shdr.sh_offset);
+  std::span<InputSection<E> *> members = output_section.members;
+
+  tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
+    InputSection<E> &isec = *members[i];
+    std::span<ElfRel<E>> rels = isec.get_rels(ctx);
+    ElfRel<E> *out = buf + offsets[i];
+    i64 subsec_idx = 0;
+
+    for (i64 j = 0; j < rels.size(); j++) {
+      const ElfRel<E> &rel = rels[j];
+
+      SubsectionRef<E> *ref = nullptr;
+      if (isec.rel_subsections && isec.rel_subsections[subsec_idx].idx == j)
+        ref = &isec.rel_subsections[subsec_idx++];
+
+      auto [sym_idx, addend] = get_output_reloc_target(ctx, isec, rel, ref);
+
+      memset(out + j, 0, sizeof(ElfRel<E>));
+      out[j].r_offset = isec.get_addr() + rel.r_offset;
+      out[j].r_type = rel.r_type;
+      out[j].r_sym = sym_idx;
+
+      // With REL, addends are in section contents, which already have
+      // relocations applied.
+      if constexpr (!E::is_rel)
+        out[j].r_addend = addend;
+    }
+  });
+}
+
+template <typename E>
+void create_reloc_sections(Context<E> &ctx) {
+  std::vector<Chunk<E> *> chunks = ctx.chunks;
+
+  for (Chunk<E> *chunk : chunks) {
+    if (chunk->kind == Chunk<E>::REGULAR && (chunk->shdr.sh_flags & SHF_ALLOC)) {
+      RelocSection<E> *sec =
+        new RelocSection<E>(ctx, *(OutputSection<E> *)chunk);
+      ctx.reloc_sections.push_back(std::unique_ptr<RelocSection<E>>(sec));
+      ctx.chunks.push_back(sec);
+    }
+  }
+}
+
 #define INSTANTIATE(E)                                                  \
-  template void combine_objects(Context<E> &, std::span<std::string_view>);
+  template void combine_objects(Context<E> &, std::span<std::string_view>); \
+  template class RelocSection<E>;                                       \
+  template void create_reloc_sections(Context<E> &);
 
 INSTANTIATE(X86_64);
 INSTANTIATE(I386);
@@ -0,0 +1,127 @@
+// This file builds a relocation graph of input sections, which is used
+// by both -gc-sections and ICF.
+//
+// Vertices of the graph are input sections, and there's an edge from
+// section A to section B if A has a relocation referring to B or if an
+// .eh_frame record associated with A refers to B. Edges are stored in
+// the compressed sparse row format, i.e. edges of each vertex are
+// stored contiguously in one large array, so that graph traversal
+// passes don't have to chase pointers from sections to relocation
+// records to symbols to their sections over and over again.
+//
+// Edges of a vertex are in the order of relocations. Edges for
+// .eh_frame records come after edges for relocations. Relocations
+// referring to string fragments in mergeable sections are not edges.
+
+#include "mold.h"
+
+#include <tbb/parallel_for.h>
+
+namespace mold::elf {
+
+template <typename E>
+static InputSection<E> *get_target(Symbol<E> *sym) {
+  if (!sym || sym->get_subsec())
+    return nullptr;
+  InputSection<E> *isec = sym->input_section;
+  if (!isec || !isec->is_alive)
+    return nullptr;
+  return isec;
+}
+
+// Calls `fn` for each section referred to by a given section.
+template <typename E, typename Fn>
+static void for_each_target(Context<E> &ctx, InputSection<E> &isec, Fn fn) {
+  // Non-alloc sections such as debug info sections may contain lots of
+  // relocations, but they never keep other sections alive.
+  if (!(isec.shdr.sh_flags & SHF_ALLOC))
+    return;
+
+  std::span<ElfRel<E>> rels = isec.get_rels(ctx);
+  i64 subsec_idx = 0;
+
+  for (i64 i = 0; i < rels.size(); i++) {
+    if (isec.rel_subsections && isec.rel_subsections[subsec_idx].idx == i) {
+      subsec_idx++;
+      continue;
+    }
+
+    if (InputSection<E> *target = get_target(isec.file.symbols[rels[i].r_sym]))
+      fn(target);
+  }
+
+  for (FdeRecord<E> &fde : isec.get_fdes())
+    for (ElfRel<E> &rel : fde.get_rels().subspan(1))
+      if (InputSection<E> *target = get_target(isec.file.symbols[rel.r_sym]))
+        fn(target);
+}
+
+template <typename E>
+void build_section_graph(Context<E> &ctx) {
+  Timer t(ctx, "build_section_graph");
+
+  ctx.section_graph.reset(new SectionGraph<E>);
+  SectionGraph<E> &graph = *ctx.section_graph;
+
+  // Assign an index to each input section.
+  std::vector<i64> num_sections(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    for (InputSection<E> *isec : ctx.objs[i]->sections)
+      if (isec && isec->is_alive)
+        num_sections[i]++;
+  });
+
+  std::vector<i64> section_indices(ctx.objs.size() + 1);
+  for (i64 i = 0; i < ctx.objs.size(); i++)
+    section_indices[i + 1] = section_indices[i] + num_sections[i];
+
+  graph.sections.resize(section_indices.back());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    i64 idx = section_indices[i];
+    for (InputSection<E> *isec : ctx.objs[i]->sections) {
+      if (isec && isec->is_alive) {
+        isec->graph_idx = idx;
+        graph.sections[idx++] = isec;
+      }
+    }
+  });
+
+  // Count the number of edges of each vertex.
+  i64 num_vertices = graph.sections.size();
+  graph.edge_indices.resize(num_vertices + 1);
+
+  tbb::parallel_for((i64)0, num_vertices, [&](i64 i) {
+    i64 n = 0;
+    for_each_target(ctx, *graph.sections[i], [&](InputSection<E> *) { n++; });
+    graph.edge_indices[i + 1] = n;
+  });
+
+  for (i64 i = 0; i < num_vertices; i++)
+    graph.edge_indices[i + 1] += graph.edge_indices[i];
+
+  // Fill the edge array.
+  graph.edges.resize(graph.edge_indices.back());
+
+  tbb::parallel_for((i64)0, num_vertices, [&](i64 i) {
+    u32 *edge = graph.edges.data() + graph.edge_indices[i];
+    for_each_target(ctx, *graph.sections[i], [&](InputSection<E> *target) {
+      *edge++ = target->graph_idx;
+    });
+  });
+
+  static Counter vertices("section_graph_vertices");
+  static Counter edges("section_graph_edges");
+  vertices += num_vertices;
+  edges += graph.edges.size();
+}
+
+#define INSTANTIATE(E)                                  \
+  template void build_section_graph(Context<E> &ctx);
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -0,0 +1,223 @@
+// This file implements --separate-debug-file, which writes debug info
+// sections to a separate file instead of the output file. The result
+// is equivalent to running `objcopy --only-keep-debug`,
+// `objcopy --strip-debug` and `objcopy --add-gnu-debuglink` after a
+// link, but we don't need to read and write a large output file three
+// more times.
+//
+// A debug info file consists of an ELF header, debug info sections, a
+// section name string table and a section header table. As objcopy
+// does, we also list allocated sections of the output file as
+// SHT_NOBITS sections in the section header table, so that debuggers
+// can find section addresses in the debug info file alone. Unlike
+// objcopy, we don't copy notes (see below).
+//
+// The output file gets a .gnu_debuglink section containing the debug
+// info file's name and its CRC32. We compute the CRC of fixed-size
+// shards and combine them with crc32_combine(). A shard's CRC is
+// computed as soon as all sections overlapping with it are written,
+// while other sections are still being copied, so that we don't have
+// to read the entire file again after copying.
+
+#include "mold.h"
+
+#include <tbb/parallel_for.h>
+#include <zlib.h>
+
+namespace mold::elf {
+
+template <typename E>
+static bool is_debug_section(Chunk<E> *chunk) {
+  if (chunk->shdr.sh_flags & SHF_ALLOC)
+    return false;
+  return chunk->name.starts_with(".debug") ||
+         chunk->name.starts_with(".zdebug") || chunk->name == ".gdb_index";
+}
+
+// Moves debug info sections from the output file to the debug info
+// file. This is called after the output file layout is fixed, so the
+// caller has to assign file offsets to output sections again.
+template <typename E>
+void DebugFile<E>::move_sections(Context<E> &ctx) {
+  for (Chunk<E> *chunk : ctx.chunks)
+    if (is_debug_section(chunk))
+      chunks.push_back(chunk);
+  erase(ctx.chunks, is_debug_section<E>);
+
+  // Debug info sections are placed after allocated sections, so only
+  // section indices of non-allocated sections change.
+  for (i64 i = 0, shndx = 1; i < ctx.chunks.size(); i++)
+    if (ctx.chunks[i]->kind != Chunk<E>::HEADER)
+      ctx.chunks[i]->shndx = shndx++;
+
+  ctx.symtab->update_shdr(ctx);
+  ctx.shstrtab->update_shdr(ctx);
+  ctx.ehdr->update_shdr(ctx);
+  ctx.shdr->update_shdr(ctx);
+}
+
+// Assigns file offsets to debug info sections and creates the file.
+// Each chunk's sh_offset is overwritten with its offset in this file.
+template <typename E>
+void DebugFile<E>::open(Context<E> &ctx) {
+  Timer t(ctx, "open_debug_file");
+
+  shdrs.push_back({});
+  shstrtab.push_back('\0');
+
+  auto add_name = [&](std::string_view name) {
+    i64 off = shstrtab.size();
+    shstrtab += name;
+    shstrtab.push_back('\0');
+    return off;
+  };
+
+  for (Chunk<E> *chunk : ctx.chunks) {
+    if (chunk->kind == Chunk<E>::HEADER || !(chunk->shdr.sh_flags & SHF_ALLOC))
+      continue;
+
+    // A build ID note depends on the contents of .gnu_debuglink, which
+    // in turn depends on this file, so we can't copy it. We omit notes
+    // rather than list them with no contents.
+    if (chunk->shdr.sh_type == SHT_NOTE)
+      continue;
+
+    ElfShdr<E> shdr = chunk->shdr;
+    shdr.sh_name = add_name(chunk->name);
+    shdr.sh_type = SHT_NOBITS;
+    shdr.sh_offset = 0;
+    shdr.sh_link = 0;
+    shdr.sh_info = 0;
+    shdrs.push_back(shdr);
+  }
+
+  i64 offset = sizeof(ElfEhdr<E>);
+
+  for (Chunk<E> *chunk : chunks) {
+    offset = align_to(offset, chunk->shdr.sh_addralign);
+    chunk->shdr.sh_offset = offset;
+    offset += chunk->shdr.sh_size;
+
+    ElfShdr<E> shdr = chunk->shdr;
+    shdr.sh_name = add_name(chunk->name);
+    shdrs.push_back(shdr);
+  }
+
+  ElfShdr<E> shdr = {};
+  shdr.sh_name = add_name(".shstrtab");
+  shdr.sh_type = SHT_STRTAB;
+  shdr.sh_offset = shstrtab_offset = offset;
+  shdr.sh_size = shstrtab.size();
+  shdr.sh_addralign = 1;
+  shdrs.push_back(shdr);
+
+  shoff = align_to(offset + shstrtab.size(), sizeof(typename E::WordTy));
+  i64 filesize = shoff + shdrs.size() * sizeof(ElfShdr<E>);
+
+  file = OutputFile<E>::open(ctx, ctx.arg.separate_debug_file, filesize,
+                             0666);
+
+  // Everything but the ELF header and section contents is known at
+  // this point, so we write it now. Paddings between sections are
+  // cleared here as well.
+  u8 *buf = file->buf;
+  memset(buf, 0, sizeof(ElfEhdr<E>));
+
+  i64 end = sizeof(ElfEhdr<E>);
+  for (Chunk<E> *chunk : chunks) {
+    memset(buf + end, 0, chunk->shdr.sh_offset - end);
+    end = chunk->shdr.sh_offset + chunk->shdr.sh_size;
+  }
+
+  memcpy(buf + shstrtab_offset, shstrtab.data(), shstrtab.size());
+  end = shstrtab_offset + shstrtab.size();
+  memset(buf + end, 0, shoff - end);
+  memcpy(buf + shoff, shdrs.data(), shdrs.size() * sizeof(ElfShdr<E>));
+
+  // Count the number of pieces that have yet to be written for each
+  // shard. The ELF header is written last by write_headers().
+  num_shards = (filesize + SHARD_SIZE - 1) / SHARD_SIZE;
+  shard_crcs.resize(num_shards);
+  num_pending.reset(new std::atomic_int32_t[num_shards]);
+
+  for (i64 i = 0; i < num_shards; i++)
+    num_pending[i] = 0;
+  num_pending[0]++;
+
+  for (Chunk<E> *chunk : chunks) {
+    auto [begin, end] = get_shard_range(chunk);
+    for (i64 i = begin; i < end; i++)
+      num_pending[i]++;
+  }
+
+  // Shards that consist only of paddings and headers can be
+  // checksummed now.
+  tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+    if (num_pending[i] == 0)
+      shard_crcs[i] = crc32(0, buf + i * SHARD_SIZE, get_shard_size(i));
+  });
+}
+
+template <typename E>
+std::pair<i64, i64> DebugFile<E>::get_shard_range(Chunk<E> *chunk) {
+  i64 begin = chunk->shdr.sh_offset;
+  i64 end = begin + chunk->shdr.sh_size;
+  if (chunk->shdr.sh_type == SHT_NOBITS || begin == end)
+    return {0, 0};
+  return {begin / SHARD_SIZE, (end - 1) / SHARD_SIZE + 1};
+}
+
+template <typename E>
+i64 DebugFile<E>::get_shard_size(i64 idx) {
+  return std::min(SHARD_SIZE, file->filesize - idx * SHARD_SIZE);
+}
+
+template <typename E>
+void DebugFile<E>::release_shard(i64 idx) {
+  if (--num_pending[idx] == 0)
+    shard_crcs[idx] = crc32(0, file->buf + idx * SHARD_SIZE,
+                            get_shard_size(idx));
+}
+
+// Called by copy_chunks() when a debug info section is written.
+template <typename E>
+void DebugFile<E>::release(Context<E> &ctx, Chunk<E> *chunk) {
+  auto [begin, end] = get_shard_range(chunk);
+  for (i64 i = begin; i < end; i++)
+    release_shard(i);
+}
+
+// Writes the ELF header. It is the same as the output file's except
+// that there are no program headers, so this has to be called after
+// the output file's ELF header is written.
+template <typename E>
+void DebugFile<E>::write_headers(Context<E> &ctx) {
+  ElfEhdr<E> &ehdr = *(ElfEhdr<E> *)file->buf;
+  ehdr = *(ElfEhdr<E> *)ctx.buf;
+  ehdr.e_phoff = 0;
+  ehdr.e_phnum = 0;
+  ehdr.e_shoff = shoff;
+  ehdr.e_shnum = shdrs.size();
+  ehdr.e_shstrndx = shdrs.size() - 1;
+  release_shard(0);
+}
+
+// Combines shard CRCs. All shards have been checksummed by now.
+template <typename E>
+u32 DebugFile<E>::compute_crc(Context<E> &ctx) {
+  Timer t(ctx, "debug_file_crc");
+
+  u32 crc = crc32(0, nullptr, 0);
+  for (i64 i = 0; i < num_shards; i++)
+    crc = crc32_combine(crc, shard_crcs[i], get_shard_size(i));
+  return crc;
+}
+
+#define INSTANTIATE(E)                          \
+  template class DebugFile<E>;
+
+INSTANTIATE(X86_64);
+INSTANTIATE(I386);
+INSTANTIATE(AARCH64);
+
+} // namespace mold::elf
@@ -0,0 +1,95 @@
+#include "mold.h"
+
+#include <xxh3.h>
+
+namespace mold {
+
+// Returns true if `str` matches `pat`. Since `*` is the only
+// metacharacter, we need to backtrack only to the last `*`.
+static bool glob_match(std::string_view pat, std::string_view str) {
+  i64 p = 0;
+  i64 s = 0;
+  i64 star = -1;
+  i64 mark = 0;
+
+  while (s < str.size()) {
+    if (p < pat.size() && pat[p] == '*') {
+      star = p++;
+      mark = s;
+    } else if (p < pat.size() && pat[p] == str[s]) {
+      p++;
+      s++;
+    } else if (star != -1) {
+      p = star + 1;
+      s = ++mark;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pat.size() && pat[p] == '*')
+    p++;
+  return p == pat.size();
+}
+
+void MultiGlob::add(std::string_view pat, i64 val) {
+  size_t pos = pat.find('*');
+  if (pos == pat.npos) {
+    HashedString key = {pat, XXH3_64bits(pat.data(), pat.size())};
+    i64 &v = exact.insert({key, val}).first->second;
+    v = std::max(v, val);
+    return;
+  }
+
+  // Insert the literal prefix to the trie.
+  i64 node = 0;
+  for (u8 c : pat.substr(0, pos)) {
+    auto it = std::find_if(nodes[node].children.begin(),
+                           nodes[node].children.end(),
+                           [&](std::pair<u8, i64> &x) { return x.first == c; });
+
+    if (it != nodes[node].children.end()) {
+      node = it->second;
+    } else {
+      nodes[node].children.push_back({c, (i64)nodes.size()});
+      node = nodes.size();
+      nodes.push_back({});
+    }
+  }
+
+  nodes[node].globs.push_back({pat.substr(pos), val});
+}
+
+i64 MultiGlob::find(std::string_view str) const {
+  return find(str, XXH3_64bits(str.data(), str.size()));
+}
+
+i64 MultiGlob::find(std::string_view str, u64 hash) const {
+  i64 val = -1;
+  if (!exact.empty())
+    if (auto it = exact.find({str, hash}); it != exact.end())
+      val = it->second;
+
+  i64 node = 0;
+  for (i64 i = 0;; i++) {
+    for (const Glob &glob : nodes[node].globs)
+      if (val < glob.val && glob_match(glob.pat, str.substr(i)))
+        val = glob.val;
+
+    if (i == str.size())
+      break;
+
+    auto it = std::find_if(nodes[node].children.begin(),
+                           nodes[node].children.end(),
+                           [&](const std::pair<u8, i64> &x) {
+      return x.first == (u8)str[i];
+    });
+
+    if (it == nodes[node].children.end())
+      break;
+    node = it->second;
+  }
+  return val;
+}
+
+} // namespace mold
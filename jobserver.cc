@@ -0,0 +1,149 @@
+// This file implements a client of GNU make's jobserver.
+//
+// When make runs with -jN, it hands out N job slots to the processes it
+// starts. A process started by make implicitly owns one slot, and it
+// has to take a token from the jobserver for each additional slot and
+// put it back when done. By taking part in the protocol, concurrent
+// links and other jobs in a parallel build share CPUs instead of each
+// of them starting as many threads as there are cores.
+//
+// We never wait for tokens. We take whatever is available at phase
+// boundaries and continue with that many threads.
+//
+// Make tells the location of its jobserver via MAKEFLAGS, either as
+// "--jobserver-auth=fifo:PATH" (make 4.4 or later) or as a pair of
+// inherited pipe descriptors "--jobserver-auth=R,W" (older versions
+// spell it --jobserver-fds). Inherited descriptors share their file
+// status flags with make, so we don't make them non-blocking but
+// reopen the read side via /proc instead.
+
+#include "mold.h"
+
+namespace mold {
+
+static i64 read_fd = -1;
+static i64 write_fd = -1;
+
+// Tokens we hold. We have to return the same bytes as we took.
+static char tokens[1024];
+static std::atomic<i64> num_tokens;
+
+static std::string_view get_jobserver_auth() {
+  char *env = getenv("MAKEFLAGS");
+  if (!env)
+    return "";
+
+  std::string_view flags = env;
+  std::string_view val;
+
+  for (std::string_view opt : {"--jobserver-auth=", "--jobserver-fds="}) {
+    if (size_t pos = flags.rfind(opt); pos != flags.npos) {
+      val = flags.substr(pos + opt.size());
+      break;
+    }
+  }
+  return val.substr(0, val.find(' '));
+}
+
+bool jobserver_connect() {
+  std::string_view auth = get_jobserver_auth();
+  if (auth.empty())
+    return false;
+
+  if (auth.starts_with("fifo:")) {
+    std::string path(auth.substr(5));
+    read_fd = write_fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    return read_fd != -1;
+  }
+
+  int r, w;
+  if (sscanf(std::string(auth).c_str(), "%d,%d", &r, &w) != 2 ||
+      fcntl(r, F_GETFD) == -1 || fcntl(w, F_GETFD) == -1)
+    return false;
+
+  std::string path = "/proc/self/fd/" + std::to_string(r);
+  read_fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (read_fd == -1)
+    return false;
+  write_fd = w;
+  return true;
+}
+
+// Takes or returns tokens so that we hold `n - 1` tokens, or as many as
+// are available if that's fewer. Returns the number of job slots we own,
+// including the implicit one.
+i64 jobserver_acquire(i64 n) {
+  if (read_fd == -1)
+    return 1;
+
+  n = std::clamp<i64>(n - 1, 0, sizeof(tokens));
+
+  while (num_tokens < n) {
+    char c;
+    if (read(read_fd, &c, 1) != 1)
+      break;
+    tokens[num_tokens++] = c;
+  }
+
+  while (num_tokens > n) {
+    i64 i = --num_tokens;
+    if (write(write_fd, tokens + i, 1) != 1)
+      break;
+  }
+  return num_tokens + 1;
+}
+
+// Returns all tokens to the jobserver. This is async-signal-safe, so
+// that it can be called by a signal handler.
+void jobserver_release() {
+  if (write_fd == -1)
+    return;
+
+  for (i64 n = num_tokens.exchange(0), i = 0; i < n;) {
+    i64 r = write(write_fd, tokens + i, n - i);
+    if (r <= 0)
+      return;
+    i += r;
+  }
+}
+
+// With a jobserver, we start with a single thread. Tokens are taken
+// by update(), which has to be called after we fork a child, so that
+// only one process owns them.
+ThreadBudget::ThreadBudget(i64 max_threads, bool use_jobserver)
+  : max_threads(max_threads),
+    use_jobserver(use_jobserver && jobserver_connect()) {
+  set(this->use_jobserver ? 1 : max_threads);
+}
+
+ThreadBudget::~ThreadBudget() {
+  release();
+}
+
+// Adjusts the number of threads TBB may use. With a jobserver, this
+// takes tokens that have become available since the last call.
+void ThreadBudget::update() {
+  if (use_jobserver)
+    set(jobserver_acquire(max_threads));
+}
+
+// Gives all tokens back to the jobserver, leaving us a single thread.
+void ThreadBudget::release() {
+  if (use_jobserver) {
+    jobserver_release();
+    set(1);
+  }
+}
+
+void ThreadBudget::set(i64 n) {
+  if (n != current) {
+    // The effective limit is the smallest of all live global_control
+    // objects, so we have to destroy the old one first to raise it.
+    control.reset();
+    control.reset(new tbb::global_control(
+      tbb::global_control::max_allowed_parallelism, n));
+    current = n;
+  }
+}
+
+} // namespace mold
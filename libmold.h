@@ -0,0 +1,33 @@
+// This is the public interface to use mold as a library. Unlike other
+// header files in this directory, it doesn't depend on mold's internal
+// data structures, so that it can be included by any C++ program.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mold::elf {
+
+// An input file given as a memory buffer. `name` is a pathname by
+// which the file is referred to on the command line.
+struct MemoryInput {
+  std::string name;
+  std::string_view contents;
+};
+
+// Links ELF files as if mold were executed with a given command line
+// (excluding the program name). Input files whose names match `inputs`
+// are read from memory instead of the filesystem, and the resulting
+// file is written to `output` instead of the path given by `-o`.
+// Returns 0 on success.
+//
+// A fatal error still terminates the calling process. A program that
+// has to survive a failed link should call this in a child process.
+int link_in_memory(const std::vector<std::string> &args,
+                   const std::vector<MemoryInput> &inputs,
+                   std::vector<uint8_t> &output);
+
+} // namespace mold::elf
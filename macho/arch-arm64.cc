@@ -1,5 +1,7 @@
 #include "mold.h"
 
+#include <tbb/parallel_for.h>
+
 namespace mold::macho {
 
 // Returns [hi:lo] bits of val.
@@ -15,6 +17,14 @@ static u64 encode_page(u64 val) {
   return (bits(val, 13, 12) << 29) | (bits(val, 32, 14) << 5);
 }
 
+// B and BL take a 26-bit immediate scaled by 4, so they can jump
+// within ±128 MiB of the instruction.
+static constexpr i64 BRANCH_REACH = 1 << 27;
+
+static bool is_branch_reachable(i64 val) {
+  return -BRANCH_REACH <= val && val < BRANCH_REACH;
+}
+
 template <>
 void StubsSection<ARM64>::copy_buf(Context<ARM64> &ctx) {
   u32 *buf = (u32 *)(ctx.buf + this->hdr.offset);
@@ -225,8 +235,17 @@ void Subsection<ARM64>::apply_reloc(Context<ARM64> &ctx, u8 *buf) {
         unreachable();
       break;
     case ARM64_RELOC_BRANCH26:
-      if (r.is_pcrel)
-        val -= get_addr(ctx) + r.offset;
+      assert(r.is_pcrel);
+      val -= get_addr(ctx) + r.offset;
+
+      // If the destination is out of range, jump to a thunk instead,
+      // which in turn jumps to the destination.
+      if (!is_branch_reachable(val) && range_extn &&
+          range_extn[i].thunk_idx != -1) {
+        RangeExtensionRef &ref = range_extn[i];
+        val = isec.osec.thunks[ref.thunk_idx]->get_addr(ref.sym_idx) -
+              get_addr(ctx) - r.offset;
+      }
       *(u32 *)(buf + r.offset) |= bits(val, 27, 2);
       break;
     case ARM64_RELOC_PAGE21:
@@ -255,4 +274,209 @@ void Subsection<ARM64>::apply_reloc(Context<ARM64> &ctx, u8 *buf) {
   }
 }
 
+template <>
+void RangeExtensionThunk<ARM64>::copy_buf(Context<ARM64> &ctx) {
+  u32 *buf = (u32 *)(ctx.buf + output_section.hdr.offset + offset);
+
+  static const u32 insn[] = {
+    0x90000010, // adrp x16, 0
+    0x91000210, // add  x16, x16, 0
+    0xd61f0200, // br   x16
+  };
+
+  static_assert(sizeof(insn) == ENTRY_SIZE);
+
+  for (i64 i = 0; i < targets.size(); i++) {
+    Target &t = targets[i];
+    u64 S = (t.sym ? t.sym->get_addr(ctx) : t.subsec->get_addr(ctx)) +
+            t.addend;
+    u64 P = get_addr(i);
+
+    memcpy(buf, insn, sizeof(insn));
+    buf[0] |= encode_page(page(S) - page(P));
+    buf[1] |= bits(S, 11, 0) << 10;
+    buf += 3;
+  }
+}
+
+// Returns true if we know that a branch at `r` in `subsec` can reach
+// its destination directly. This is exact for destinations in the
+// same output section that have already been assigned addresses.
+// Everything else, including stubs and other output sections, is
+// assumed to be unreachable.
+static bool is_reachable(Context<ARM64> &ctx, Subsection<ARM64> &subsec,
+                         const Relocation<ARM64> &r) {
+  Subsection<ARM64> *target = r.sym ? r.sym->subsec : r.subsec;
+  if (!target || &target->isec.osec != &subsec.isec.osec ||
+      target->raddr == (u32)-1)
+    return false;
+
+  i64 S = target->get_addr(ctx) + (r.sym ? r.sym->value : 0) + r.addend;
+  i64 P = subsec.get_addr(ctx) + r.offset;
+  return is_branch_reachable(S - P);
+}
+
+// We create thunks for an output section in batches. Subsections are
+// laid out from the beginning of the output section, and a thunk is
+// placed after the subsections that are within MAX_DISTANCE bytes
+// from the beginning of the current batch. Then, branches in the batch
+// that cannot reach their destinations directly are redirected to an
+// entry of either an existing thunk within reach or the new thunk.
+//
+// MAX_DISTANCE is smaller than BRANCH_REACH to leave room for the
+// thunk itself and the last subsection, which may straddle the
+// MAX_DISTANCE boundary.
+static constexpr i64 MAX_DISTANCE = 100 * 1024 * 1024;
+static constexpr i64 BATCH_SIZE = MAX_DISTANCE / 10;
+
+static void create_thunks(Context<ARM64> &ctx, OutputSection<ARM64> &osec) {
+  typedef RangeExtensionThunk<ARM64>::Target Target;
+
+  std::span<Subsection<ARM64> *> m = osec.members;
+  std::vector<std::unique_ptr<RangeExtensionThunk<ARM64>>> &thunks =
+    osec.thunks;
+
+  // Thunk entry indices for each thunk
+  std::vector<std::map<Target, i32>> maps;
+
+  // Offsets of subsections from the beginning of the output section
+  std::vector<i64> offsets(m.size());
+
+  for (Subsection<ARM64> *subsec : m)
+    subsec->raddr = -1;
+
+  // Subsections in [b, c) are the current batch, and those in [b, d)
+  // have been assigned offsets. Thunks before `a` are too far behind to
+  // be reachable from the current batch.
+  i64 a = 0;
+  i64 b = 0;
+  i64 c = 0;
+  i64 d = 0;
+  i64 offset = 0;
+
+  while (b < m.size()) {
+    while (d < m.size()) {
+      i64 off = align_to(offset, 1 << m[d]->p2align);
+      if (b < d && off + m[d]->input_size - offsets[b] > MAX_DISTANCE)
+        break;
+      offsets[d] = off;
+      m[d]->raddr = osec.hdr.addr + off - ctx.arg.pagezero_size;
+      offset = off + m[d]->input_size;
+      d++;
+    }
+
+    c = b + 1;
+    while (c < d && offsets[c] + m[c]->input_size - offsets[b] < BATCH_SIZE)
+      c++;
+
+    while (a < thunks.size() &&
+           thunks[a]->offset + thunks[a]->size() + BRANCH_REACH < offsets[b])
+      a++;
+
+    i64 cur = thunks.size();
+    thunks.emplace_back(new RangeExtensionThunk<ARM64>(osec));
+    maps.emplace_back();
+
+    // Find branches that need thunks. If an existing thunk already has
+    // an entry for the same destination and is within reach, use it.
+    tbb::parallel_for(b, c, [&](i64 i) {
+      Subsection<ARM64> &subsec = *m[i];
+      std::span<Relocation<ARM64>> rels = subsec.get_rels();
+
+      for (i64 j = 0; j < rels.size(); j++) {
+        const Relocation<ARM64> &r = rels[j];
+        if (r.type != ARM64_RELOC_BRANCH26 || (r.sym && !r.sym->file) ||
+            is_reachable(ctx, subsec, r))
+          continue;
+
+        if (!subsec.range_extn)
+          subsec.range_extn.reset(new RangeExtensionRef[rels.size()]);
+
+        RangeExtensionRef &ref = subsec.range_extn[j];
+        ref.thunk_idx = cur;
+
+        Target target = {r.sym, r.sym ? nullptr : r.subsec, r.addend};
+        i64 P = offsets[i] + r.offset;
+
+        for (i64 k = a; k < cur; k++) {
+          auto it = maps[k].find(target);
+          if (it == maps[k].end())
+            continue;
+
+          i64 val = thunks[k]->offset + it->second * thunks[k]->ENTRY_SIZE - P;
+          if (is_branch_reachable(val)) {
+            ref = {(i32)k, it->second};
+            break;
+          }
+        }
+      }
+    });
+
+    // Add entries to the new thunk. This is done serially so that the
+    // output is deterministic.
+    RangeExtensionThunk<ARM64> &thunk = *thunks[cur];
+
+    for (i64 i = b; i < c; i++) {
+      Subsection<ARM64> &subsec = *m[i];
+      if (!subsec.range_extn)
+        continue;
+
+      std::span<Relocation<ARM64>> rels = subsec.get_rels();
+
+      for (i64 j = 0; j < rels.size(); j++) {
+        RangeExtensionRef &ref = subsec.range_extn[j];
+        if (ref.thunk_idx != cur)
+          continue;
+
+        const Relocation<ARM64> &r = rels[j];
+        Target target = {r.sym, r.sym ? nullptr : r.subsec, r.addend};
+        auto [it, inserted] = maps[cur].insert({target, thunk.targets.size()});
+        if (inserted)
+          thunk.targets.push_back(target);
+        ref.sym_idx = it->second;
+      }
+    }
+
+    if (thunk.targets.empty()) {
+      thunks.pop_back();
+      maps.pop_back();
+    } else {
+      thunk.offset = align_to(offset, 4);
+      offset = thunk.offset + thunk.size();
+    }
+
+    b = c;
+  }
+
+  osec.hdr.size = offset;
+}
+
+// ARM64's branch instructions cannot reach destinations that are more
+// than 128 MiB away, so we create range extension thunks for such
+// branches. This function lays out the subsections of an executable
+// output section with thunks interleaved. It returns false without
+// doing anything if the section doesn't need thunks.
+//
+// Executable sections and stubs are contiguous in __TEXT, so if their
+// total size is small enough, all branches are reachable.
+bool create_range_extension_thunks(Context<ARM64> &ctx,
+                                   OutputSection<ARM64> &osec) {
+  i64 size = ARM64::stub_helper_hdr_size +
+             ctx.stubs.syms.size() *
+             (ARM64::stub_size + ARM64::stub_helper_size);
+
+  for (std::unique_ptr<OutputSegment<ARM64>> &seg : ctx.segments)
+    for (Chunk<ARM64> *chunk : seg->chunks)
+      if (chunk->is_regular && (chunk->hdr.attr & S_ATTR_SOME_INSTRUCTIONS))
+        for (Subsection<ARM64> *subsec :
+               ((OutputSection<ARM64> *)chunk)->members)
+          size += subsec->input_size + (1 << subsec->p2align);
+
+  if (size < MAX_DISTANCE)
+    return false;
+
+  create_thunks(ctx, osec);
+  return true;
+}
+
 } // namespace mold::macho
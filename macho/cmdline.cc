@@ -13,6 +13,11 @@ namespace mold::macho {
 
 static const char helpmsg[] = R"(
 Options:
+  --fork                      Spawn a child process (default)
+    --no-fork
+  --preload                   Preload input files and wait for link requests
+  --quick-exit                Use quick_exit to exit (default)
+    --no-quick-exit
   -F<PATH>                    Add DIR to framework search path
   -L<PATH>                    Add DIR to library search path
   -Z                          Do not search the standard directories when
@@ -22,15 +27,20 @@ Options:
   -adhoc_codesign             Add ad-hoc code signature to the output file
     -no_adhoc_codesign
   -arch <ARCH_NAME>           Specify target architecture
+  -bind_at_load               Bind all imported symbols at load time
   -bundle                     Produce a mach-o bundle
   -dead_strip                 Remove unreachable functions and data
   -dead_strip_dylibs          Remove unreachable dylibs from dependencies
+  -deduplicate                Fold identical functions
+    -no_deduplicate
   -demangle                   Demangle C++ symbols in log messages (default)
   -dylib                      Produce a dynamic library
   -dynamic                    Link against dylibs (default)
   -e <SYMBOL>                 Specify the entry point of a main executable
   -execute                    Produce an executable (default)
   -filelist <FILE>[,<DIR>]    Specify the list of input file names
+  -fixup_chains               Use chained fixups instead of dyld opcodes
+    -no_fixup_chains
   -framework <NAME>,[,<SUFFIX>]
                               Search for a given framework
   -headerpad <SIZE>           Allocate the size of padding after load commands
@@ -40,17 +50,20 @@ Options:
   -l<LIB>                     Search for a given library
   -lto_library <FILE>         Ignored
   -map <FILE>                 Write map file to a given file
+  -map_format [text,json]     Set map file format (default: text)
   -needed-l<LIB>              Search for a given library
   -needed-framework <NAME>[,<SUFFIX>]
                               Search for a given framework
-  -no_deduplicate             Ignored
   -o <FILE>                   Set output filename
+  -order_file <FILE>          Layout functions and data in the order given
+                              by a file
   -pagezero_size <SIZE>       Specify the size of the __PAGEZERO segment
   -platform_version <PLATFORM> <MIN_VERSION> <SDK_VERSION>
                               Set platform, platform version and SDK version
   -rpath <PATH>               Add PATH to the runpath search path list
   -syslibroot <DIR>           Prepend DIR to library search paths
   -t                          Print out each file the linker loads
+  -tbd_cache_path <DIR>       Cache parsed .tbd files in a given directory
   -v                          Report version information)";
 
 template <typename E>
@@ -169,7 +182,17 @@ void parse_nonpositional_args(Context<E> &ctx,
       exit(0);
     }
 
-    if (read_joined("-F")) {
+    if (read_flag("--fork")) {
+      ctx.arg.fork = true;
+    } else if (read_flag("--no-fork")) {
+      ctx.arg.fork = false;
+    } else if (read_flag("--preload")) {
+      ctx.arg.preload = true;
+    } else if (read_flag("--quick-exit")) {
+      ctx.arg.quick_exit = true;
+    } else if (read_flag("--no-quick-exit")) {
+      ctx.arg.quick_exit = false;
+    } else if (read_joined("-F")) {
       framework_paths.push_back(std::string(arg));
     } else if (read_joined("-L")) {
       library_paths.push_back(std::string(arg));
@@ -188,6 +211,8 @@ void parse_nonpositional_args(Context<E> &ctx,
         ctx.arg.arch = CPU_TYPE_ARM64;
       else
         Fatal(ctx) << "unknown -arch: " << arg;
+    } else if (read_flag("-bind_at_load")) {
+      ctx.arg.bind_at_load = true;
     } else if (read_flag("-bundle")) {
       ctx.output_type = MH_BUNDLE;
     } else if (read_flag("-color-diagnostics") ||
@@ -196,6 +221,8 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.dead_strip = true;
     } else if (read_flag("-dead_strip_dylibs")) {
       ctx.arg.dead_strip_dylibs = true;
+    } else if (read_flag("-deduplicate")) {
+      ctx.arg.deduplicate = true;
     } else if (read_flag("-demangle")) {
       ctx.arg.demangle = true;
     } else if (read_flag("-dylib")) {
@@ -217,6 +244,10 @@ void parse_nonpositional_args(Context<E> &ctx,
     } else if (read_arg("-filelist")) {
       remaining.push_back("-filelist");
       remaining.push_back(std::string(arg));
+    } else if (read_flag("-fixup_chains")) {
+      ctx.arg.fixup_chains = true;
+    } else if (read_flag("-no_fixup_chains")) {
+      ctx.arg.fixup_chains = false;
     } else if (read_arg("-framework")) {
       remaining.push_back("-framework");
       remaining.push_back(std::string(arg));
@@ -226,6 +257,13 @@ void parse_nonpositional_args(Context<E> &ctx,
       remaining.push_back(std::string(arg));
     } else if (read_arg("-map")) {
       ctx.arg.map = arg;
+    } else if (read_arg("-map_format")) {
+      if (arg == "text")
+        ctx.arg.map_json = false;
+      else if (arg == "json")
+        ctx.arg.map_json = true;
+      else
+        Fatal(ctx) << "invalid -map_format argument: " << arg;
     } else if (read_joined("-needed-l")) {
       remaining.push_back("-needed-l");
       remaining.push_back(std::string(arg));
@@ -233,8 +271,11 @@ void parse_nonpositional_args(Context<E> &ctx,
       remaining.push_back("-needed_framework");
       remaining.push_back(std::string(arg));
     } else if (read_flag("-no_deduplicate")) {
+      ctx.arg.deduplicate = false;
     } else if (read_arg("-o")) {
       ctx.arg.output = arg;
+    } else if (read_arg("-order_file")) {
+      ctx.arg.order_file = arg;
     } else if (read_arg("-pagezero_size")) {
       size_t pos;
       pagezero_size = std::stol(std::string(arg), &pos, 16);
@@ -253,6 +294,8 @@ void parse_nonpositional_args(Context<E> &ctx,
       ctx.arg.syslibroot.push_back(std::string(arg));
     } else if (read_flag("-t")) {
       ctx.arg.trace = true;
+    } else if (read_arg("-tbd_cache_path")) {
+      ctx.arg.tbd_cache_path = arg;
     } else if (read_flag("-v")) {
       SyncOut(ctx) << mold_version;
     } else {
@@ -1,48 +1,59 @@
 #include "mold.h"
 
+#include <tbb/concurrent_vector.h>
+#include <tbb/parallel_for_each.h>
+
 namespace mold::macho {
 
 template <typename E>
-static std::vector<Subsection<E> *> collect_root_set(Context<E> &ctx) {
-  std::vector<Subsection<E> *> rootset;
+static tbb::concurrent_vector<Subsection<E> *> collect_root_set(Context<E> &ctx) {
+  tbb::concurrent_vector<Subsection<E> *> rootset;
 
   auto mark = [&](Symbol<E> *sym) {
-    if (sym && sym->subsec)
+    if (sym && sym->subsec && !sym->subsec->is_alive.exchange(true))
       rootset.push_back(sym->subsec);
   };
 
   mark(intern(ctx, ctx.arg.entry));
 
-  if (ctx.output_type == MH_DYLIB || ctx.output_type == MH_BUNDLE)
-    for (ObjectFile<E> *file : ctx.objs)
+  if (ctx.output_type == MH_DYLIB || ctx.output_type == MH_BUNDLE) {
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
       for (Symbol<E> *sym : file->syms)
         if (sym->file == file && sym->is_extern)
           mark(sym);
+    });
+  }
 
   return rootset;
 }
 
+// Subsections in the worklist are already marked alive. We mark
+// subsections reachable from them and feed newly-marked ones back to
+// the worklist so that TBB can distribute them among threads.
 template <typename E>
-static void visit(Context<E> &ctx, Subsection<E> &subsec) {
-  if (subsec.is_alive.exchange(true))
-    return;
+static void visit(Context<E> &ctx, Subsection<E> &subsec,
+                  tbb::feeder<Subsection<E> *> &feeder) {
+  auto enqueue = [&](Subsection<E> *subsec) {
+    if (!subsec->is_alive.exchange(true))
+      feeder.add(subsec);
+  };
 
   for (Relocation<E> &rel : subsec.get_rels()) {
     if (rel.sym) {
       if (rel.sym->subsec)
-        visit(ctx, *rel.sym->subsec);
+        enqueue(rel.sym->subsec);
     } else {
-      visit(ctx, *rel.subsec);
+      enqueue(rel.subsec);
     }
   }
 
   for (UnwindRecord<E> &rec : subsec.get_unwind_records()) {
     rec.is_alive = true;
-    visit(ctx, *rec.subsec);
+    enqueue(rec.subsec);
     if (rec.lsda)
-      visit(ctx, *rec.lsda);
+      enqueue(rec.lsda);
     if (Symbol<E> *sym = rec.personality; sym && sym->subsec)
-      visit(ctx, *sym->subsec);
+      enqueue(sym->subsec);
   }
 }
 
@@ -61,43 +72,55 @@ static bool refers_live_subsection(Subsection<E> &subsec) {
 }
 
 template <typename E>
-static void mark(Context<E> &ctx, const std::vector<Subsection<E> *> &rootset) {
-  for (Subsection<E> *subsec : rootset)
-    visit(ctx, *subsec);
-
-  bool repeat;
-  do {
-    repeat = false;
-    for (ObjectFile<E> *file : ctx.objs) {
-      for (std::unique_ptr<Subsection<E>> &subsec : file->subsections) {
+static void mark(Context<E> &ctx,
+                 tbb::concurrent_vector<Subsection<E> *> &rootset) {
+  auto propagate = [&](tbb::concurrent_vector<Subsection<E> *> &worklist) {
+    tbb::parallel_for_each(worklist.begin(), worklist.end(),
+                           [&](Subsection<E> *subsec,
+                               tbb::feeder<Subsection<E> *> &feeder) {
+      visit(ctx, *subsec, feeder);
+    });
+  };
+
+  propagate(rootset);
+
+  // A live-support subsection (e.g. an entry of __eh_frame) is alive
+  // if it refers to a live subsection. Repeat until no more subsections
+  // are newly marked.
+  for (;;) {
+    tbb::concurrent_vector<Subsection<E> *> worklist;
+
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+      for (std::unique_ptr<Subsection<E>> &subsec : file->subsections)
         if ((subsec->isec.hdr.attr & S_ATTR_LIVE_SUPPORT) &&
             !subsec->is_alive &&
-            refers_live_subsection(*subsec)) {
-          visit(ctx, *subsec);
-          repeat = true;
-        }
-      }
-    }
-  } while (repeat);
+            refers_live_subsection(*subsec) &&
+            !subsec->is_alive.exchange(true))
+          worklist.push_back(subsec.get());
+    });
+
+    if (worklist.empty())
+      break;
+    propagate(worklist);
+  }
 }
 
 template <typename E>
 static void sweep(Context<E> &ctx) {
-  for (ObjectFile<E> *file : ctx.objs) {
-    erase(file->subsections, [](const std::unique_ptr<Subsection<E>> &subsec) {
-      return !subsec->is_alive;
-    });
-  }
-
-  for (ObjectFile<E> *file : ctx.objs)
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     for (Symbol<E> *&sym : file->syms)
       if (sym->file == file && sym->subsec && !sym->subsec->is_alive)
         sym = nullptr;
+
+    erase(file->subsections, [](const std::unique_ptr<Subsection<E>> &subsec) {
+      return !subsec->is_alive;
+    });
+  });
 }
 
 template <typename E>
 void dead_strip(Context<E> &ctx) {
-  std::vector<Subsection<E> *> rootset = collect_root_set(ctx);
+  tbb::concurrent_vector<Subsection<E> *> rootset = collect_root_set(ctx);
   mark(ctx, rootset);
   sweep(ctx);
 }
@@ -399,6 +399,36 @@ void dump_file(std::string path) {
       }
       break;
     }
+    case LC_DYLD_CHAINED_FIXUPS: {
+      std::cout << "LC_DYLD_CHAINED_FIXUPS\n";
+      LinkEditDataCommand &cmd = *(LinkEditDataCommand *)&lc;
+      ChainedFixupsHeader &hdr = *(ChainedFixupsHeader *)(buf + cmd.dataoff);
+      std::cout << " dataoff: 0x" << std::hex << cmd.dataoff
+                << "\n datasize: 0x" << cmd.datasize
+                << "\n starts_offset: 0x" << hdr.starts_offset
+                << "\n imports_count: " << std::dec << hdr.imports_count
+                << "\n";
+
+      ChainedImport *imports =
+        (ChainedImport *)(buf + cmd.dataoff + hdr.imports_offset);
+      char *syms = (char *)(buf + cmd.dataoff + hdr.symbols_offset);
+      for (i64 i = 0; i < hdr.imports_count; i++)
+        std::cout << " import: " << syms + imports[i].name_offset
+                  << " (dylib " << imports[i].lib_ordinal << ")\n";
+      break;
+    }
+    case LC_DYLD_EXPORTS_TRIE: {
+      std::cout << "LC_DYLD_EXPORTS_TRIE\n";
+      LinkEditDataCommand &cmd = *(LinkEditDataCommand *)&lc;
+      std::cout << " dataoff: 0x" << std::hex << cmd.dataoff
+                << "\n datasize: 0x" << cmd.datasize << "\n";
+
+      std::vector<ExportEntry> vec;
+      read_trie(vec, buf + cmd.dataoff);
+      for (ExportEntry &ent : vec)
+        std::cout << "  export_sym: " << ent.name << " 0x" << ent.addr << "\n";
+      break;
+    }
     case LC_FUNCTION_STARTS: {
       std::cout << "LC_FUNCTION_STARTS\n";
       LinkEditDataCommand &cmd = *(LinkEditDataCommand *)&lc;
@@ -0,0 +1,444 @@
+// This file implements Identical Code Folding (ICF) for Mach-O. It is
+// a port of the ELF ICF in elf/icf.cc; see that file for a detailed
+// explanation of the algorithm.
+//
+// In short, we consider subsections as vertices and relocations as
+// edges of a directed graph. Two subsections are identical if they
+// have the same contents, relocations and unwind records, and if their
+// relocations refer to identical subsections. We compute a digest of
+// each subsection from its local properties and then repeatedly
+// combine it with the digests of its successors until the number of
+// equivalence classes converges. Subsections with the same digest are
+// folded into one.
+//
+// The unit of folding is a subsection rather than an input section
+// because Mach-O object files are split into subsections at symbol
+// boundaries (i.e. there's usually one subsection per function).
+
+#include "mold.h"
+
+#include <array>
+#include <numeric>
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_sort.h>
+#include <xxh3.h>
+
+static constexpr int64_t HASH_SIZE = 16;
+
+typedef std::array<uint8_t, HASH_SIZE> Digest;
+
+namespace std {
+template<> struct hash<Digest> {
+  size_t operator()(const Digest &k) const {
+    return *(int64_t *)&k[0];
+  }
+};
+}
+
+namespace mold::macho {
+
+// We fold only code. Data may be address-significant (e.g. a program
+// may compare pointers to two distinct constants), and functions in
+// special sections such as __mod_init_func must be kept as-is.
+template <typename E>
+static bool is_eligible(Subsection<E> &subsec) {
+  const MachSection &hdr = subsec.isec.hdr;
+  return (hdr.attr & S_ATTR_PURE_INSTRUCTIONS) &&
+         hdr.type == S_REGULAR &&
+         subsec.input_size > 0;
+}
+
+static Digest digest_final(XXH3_state_t &state) {
+  XXH128_hash_t hash = XXH3_128bits_digest(&state);
+  Digest digest;
+  memcpy(digest.data(), &hash, HASH_SIZE);
+  return digest;
+}
+
+template <typename E>
+static Digest compute_digest(Context<E> &ctx, Subsection<E> &subsec) {
+  XXH3_state_t state;
+  XXH3_128bits_reset(&state);
+
+  auto hash = [&](auto val) {
+    XXH3_128bits_update(&state, &val, sizeof(val));
+  };
+
+  auto hash_string = [&](std::string_view str) {
+    hash(str.size());
+    XXH3_128bits_update(&state, str.data(), str.size());
+  };
+
+  auto hash_subsec = [&](Subsection<E> *target) {
+    if (target->icf_idx != -1) {
+      hash('1');
+    } else {
+      hash('2');
+      hash((u64)target);
+    }
+  };
+
+  hash_string(subsec.get_contents());
+  hash(subsec.p2align);
+  hash(subsec.isec.hdr.attr);
+  hash(subsec.get_rels().size());
+  hash(subsec.get_unwind_records().size());
+
+  for (Relocation<E> &rel : subsec.get_rels()) {
+    hash(rel.offset);
+    hash(rel.type);
+    hash(rel.p2size);
+    hash(rel.is_pcrel);
+    hash(rel.addend);
+
+    if (rel.sym) {
+      if (rel.sym->subsec) {
+        hash_subsec(rel.sym->subsec);
+        hash(rel.sym->value);
+      } else {
+        hash('3');
+        hash((u64)rel.sym);
+      }
+    } else {
+      hash_subsec(rel.subsec);
+    }
+  }
+
+  for (UnwindRecord<E> &rec : subsec.get_unwind_records()) {
+    hash(rec.offset);
+    hash(rec.code_len);
+    hash(rec.encoding);
+    hash((u64)rec.personality);
+    hash((u64)rec.lsda);
+    hash(rec.lsda_offset);
+  }
+
+  return digest_final(state);
+}
+
+template <typename E>
+static std::vector<Subsection<E> *> gather_subsections(Context<E> &ctx) {
+  std::vector<i64> num_subsecs(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    for (std::unique_ptr<Subsection<E>> &subsec : ctx.objs[i]->subsections)
+      if (is_eligible(*subsec))
+        num_subsecs[i]++;
+  });
+
+  std::vector<i64> indices(ctx.objs.size() + 1);
+  for (i64 i = 0; i < ctx.objs.size(); i++)
+    indices[i + 1] = indices[i] + num_subsecs[i];
+
+  std::vector<Subsection<E> *> subsecs(indices.back());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    i64 idx = indices[i];
+    for (std::unique_ptr<Subsection<E>> &subsec : ctx.objs[i]->subsections) {
+      if (is_eligible(*subsec)) {
+        subsec->icf_idx = idx;
+        subsecs[idx++] = subsec.get();
+      }
+    }
+  });
+
+  return subsecs;
+}
+
+// Edges are relocations between eligible subsections, renumbered with
+// `icf_idx`. They are kept in relocation order because the order
+// matters when we combine successors' digests.
+template <typename E>
+static void gather_edges(Context<E> &ctx, std::span<Subsection<E> *> subsecs,
+                         std::vector<u32> &edges,
+                         std::vector<u32> &edge_indices) {
+  auto get_target = [](Relocation<E> &rel) -> Subsection<E> * {
+    Subsection<E> *target = rel.sym ? rel.sym->subsec : rel.subsec;
+    if (target && target->icf_idx != -1)
+      return target;
+    return nullptr;
+  };
+
+  std::vector<i64> num_edges(subsecs.size());
+  edge_indices.resize(subsecs.size() + 1);
+
+  tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+    for (Relocation<E> &rel : subsecs[i]->get_rels())
+      if (get_target(rel))
+        num_edges[i]++;
+  });
+
+  for (i64 i = 0; i < subsecs.size(); i++)
+    edge_indices[i + 1] = edge_indices[i] + num_edges[i];
+
+  edges.resize(edge_indices.back());
+
+  tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+    i64 idx = edge_indices[i];
+    for (Relocation<E> &rel : subsecs[i]->get_rels())
+      if (Subsection<E> *target = get_target(rel))
+        edges[idx++] = target->icf_idx;
+  });
+}
+
+// Computes the reverse of the edge list, so that we can find
+// subsections that refer to a given subsection.
+static void gather_reverse_edges(std::span<u32> edges,
+                                 std::span<u32> edge_indices,
+                                 std::vector<u32> &rev_edges,
+                                 std::vector<u32> &rev_edge_indices) {
+  i64 num_digests = edge_indices.size() - 1;
+  std::vector<i64> num_edges(num_digests);
+  for (u32 j : edges)
+    num_edges[j]++;
+
+  rev_edge_indices.resize(num_digests + 1);
+  for (i64 i = 0; i < num_digests; i++)
+    rev_edge_indices[i + 1] = rev_edge_indices[i] + num_edges[i];
+
+  rev_edges.resize(edges.size());
+  std::vector<i64> pos(rev_edge_indices.begin(), rev_edge_indices.end());
+
+  for (i64 i = 0; i < num_digests; i++)
+    for (i64 j = edge_indices[i]; j < edge_indices[i + 1]; j++)
+      rev_edges[pos[edges[j]]++] = i;
+}
+
+// A digest of a subsection in a propagation round is computed from its
+// initial digest and its successors' digests in the previous round.
+// Only subsections whose successors changed need to be rehashed, so we
+// keep them in a worklist.
+namespace {
+struct Worklist {
+  std::vector<u32> subsecs;
+  std::unique_ptr<std::atomic_bool[]> queued;
+};
+}
+
+static i64 propagate(std::span<std::vector<Digest>> digests,
+                     std::span<u32> edges, std::span<u32> edge_indices,
+                     std::span<u32> rev_edges, std::span<u32> rev_edge_indices,
+                     Worklist &worklist, bool &slot,
+                     tbb::affinity_partitioner &ap) {
+  tbb::enumerable_thread_specific<std::vector<u32>> changed;
+
+  tbb::parallel_for((i64)0, (i64)worklist.subsecs.size(), [&](i64 k) {
+    i64 i = worklist.subsecs[k];
+
+    XXH3_state_t state;
+    XXH3_128bits_reset(&state);
+    XXH3_128bits_update(&state, digests[2][i].data(), HASH_SIZE);
+
+    for (i64 j = edge_indices[i]; j < edge_indices[i + 1]; j++)
+      XXH3_128bits_update(&state, digests[slot][edges[j]].data(), HASH_SIZE);
+
+    digests[!slot][i] = digest_final(state);
+
+    if (digests[slot][i] != digests[!slot][i])
+      changed.local().push_back(i);
+  }, ap);
+
+  slot = !slot;
+
+  // Compute the next worklist. A changed subsection needs to be
+  // revisited too because its digest differs between the two slots.
+  tbb::enumerable_thread_specific<std::vector<u32>> next;
+
+  auto add = [&](u32 i) {
+    if (!worklist.queued[i].exchange(true))
+      next.local().push_back(i);
+  };
+
+  i64 num_changed = 0;
+  for (std::vector<u32> &vec : changed)
+    num_changed += vec.size();
+
+  tbb::parallel_for_each(changed.begin(), changed.end(),
+                         [&](std::vector<u32> &vec) {
+    tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 k) {
+      i64 i = vec[k];
+      add(i);
+      for (i64 j = rev_edge_indices[i]; j < rev_edge_indices[i + 1]; j++)
+        add(rev_edges[j]);
+    });
+  });
+
+  worklist.subsecs.clear();
+  for (std::vector<u32> &vec : next)
+    append(worklist.subsecs, vec);
+
+  tbb::parallel_for((i64)0, (i64)worklist.subsecs.size(), [&](i64 k) {
+    worklist.queued[worklist.subsecs[k]] = false;
+  });
+  return num_changed;
+}
+
+static i64 count_num_classes(std::span<Digest> digests,
+                             tbb::affinity_partitioner &ap) {
+  std::vector<Digest> vec(digests.begin(), digests.end());
+  tbb::parallel_sort(vec);
+
+  tbb::enumerable_thread_specific<i64> num_classes;
+  tbb::parallel_for((i64)0, (i64)vec.size() - 1, [&](i64 i) {
+    if (vec[i] != vec[i + 1])
+      num_classes.local()++;
+  }, ap);
+  return num_classes.combine(std::plus());
+}
+
+// Returns true if two subsections have the same contents, relocations
+// and unwind records except relocation targets. Subsections with the
+// same digest always satisfy this unless their digests collide.
+template <typename E>
+static bool has_same_contents(Subsection<E> &a, Subsection<E> &b) {
+  if (a.get_contents() != b.get_contents() || a.p2align != b.p2align ||
+      a.isec.hdr.attr != b.isec.hdr.attr)
+    return false;
+
+  std::span<Relocation<E>> r1 = a.get_rels();
+  std::span<Relocation<E>> r2 = b.get_rels();
+  if (r1.size() != r2.size())
+    return false;
+
+  for (i64 i = 0; i < r1.size(); i++)
+    if (r1[i].offset != r2[i].offset || r1[i].type != r2[i].type ||
+        r1[i].p2size != r2[i].p2size || r1[i].is_pcrel != r2[i].is_pcrel ||
+        r1[i].addend != r2[i].addend)
+      return false;
+
+  std::span<UnwindRecord<E>> u1 = a.get_unwind_records();
+  std::span<UnwindRecord<E>> u2 = b.get_unwind_records();
+  if (u1.size() != u2.size())
+    return false;
+
+  for (i64 i = 0; i < u1.size(); i++)
+    if (u1[i].offset != u2[i].offset || u1[i].code_len != u2[i].code_len ||
+        u1[i].encoding != u2[i].encoding ||
+        u1[i].personality != u2[i].personality ||
+        u1[i].lsda != u2[i].lsda || u1[i].lsda_offset != u2[i].lsda_offset)
+      return false;
+  return true;
+}
+
+template <typename E>
+static bool is_preferred(Subsection<E> &a, Subsection<E> &b) {
+  return std::tuple(a.isec.file.priority, a.input_addr) <
+         std::tuple(b.isec.file.priority, b.input_addr);
+}
+
+template <typename E>
+void icf_sections(Context<E> &ctx) {
+  Timer t(ctx, "icf");
+
+  std::vector<Subsection<E> *> subsecs = gather_subsections(ctx);
+  if (subsecs.empty())
+    return;
+
+  std::vector<std::vector<Digest>> digests(3);
+  digests[0].resize(subsecs.size());
+
+  tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+    digests[0][i] = compute_digest(ctx, *subsecs[i]);
+  });
+
+  digests[1].resize(digests[0].size());
+  digests[2] = digests[0];
+
+  std::vector<u32> edges;
+  std::vector<u32> edge_indices;
+  gather_edges<E>(ctx, subsecs, edges, edge_indices);
+
+  std::vector<u32> rev_edges;
+  std::vector<u32> rev_edge_indices;
+  gather_reverse_edges(edges, edge_indices, rev_edges, rev_edge_indices);
+
+  // All subsections are rehashed in the first round.
+  Worklist worklist;
+  worklist.subsecs.resize(subsecs.size());
+  std::iota(worklist.subsecs.begin(), worklist.subsecs.end(), 0);
+  worklist.queued.reset(new std::atomic_bool[subsecs.size()]{});
+
+  bool slot = 0;
+
+  // Execute the propagation rounds until convergence is obtained.
+  {
+    tbb::affinity_partitioner ap;
+
+    i64 num_changed = -1;
+    while (!worklist.subsecs.empty()) {
+      i64 n = propagate(digests, edges, edge_indices, rev_edges,
+                        rev_edge_indices, worklist, slot, ap);
+      if (n == num_changed)
+        break;
+      num_changed = n;
+    }
+
+    i64 num_classes = -1;
+    while (!worklist.subsecs.empty()) {
+      for (i64 i = 0; i < 10 && !worklist.subsecs.empty(); i++)
+        propagate(digests, edges, edge_indices, rev_edges,
+                  rev_edge_indices, worklist, slot, ap);
+
+      i64 n = count_num_classes(digests[slot], ap);
+      if (n == num_classes)
+        break;
+      num_classes = n;
+    }
+  }
+
+  // Group subsections by digest.
+  {
+    tbb::concurrent_unordered_map<Digest, Subsection<E> *> map;
+    std::span<Digest> digest = digests[slot];
+
+    tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+      auto [it, inserted] = map.insert({digest[i], subsecs[i]});
+      if (!inserted && is_preferred(*subsecs[i], *it->second))
+        it->second = subsecs[i];
+    });
+
+    tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+      auto it = map.find(digest[i]);
+      assert(it != map.end());
+      if (it->second != subsecs[i] &&
+          has_same_contents(*subsecs[i], *it->second))
+        subsecs[i]->replacer = it->second;
+    });
+  }
+
+  remove_folded_subsections(ctx);
+}
+
+// Redirects symbols and relocations to the subsections that replace
+// folded ones, and removes the folded subsections.
+template <typename E>
+void remove_folded_subsections(Context<E> &ctx) {
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    for (Symbol<E> *sym : file->syms)
+      if (sym && sym->file == file && sym->subsec && sym->subsec->replacer)
+        sym->subsec = sym->subsec->replacer;
+
+    for (std::unique_ptr<Subsection<E>> &subsec : file->subsections)
+      for (Relocation<E> &rel : subsec->get_rels())
+        if (!rel.sym && rel.subsec && rel.subsec->replacer)
+          rel.subsec = rel.subsec->replacer;
+  });
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    erase(file->subsections, [](const std::unique_ptr<Subsection<E>> &subsec) {
+      return subsec->replacer;
+    });
+  });
+}
+
+#define INSTANTIATE(E)                                  \
+  template void icf_sections(Context<E> &);             \
+  template void remove_folded_subsections(Context<E> &)
+
+INSTANTIATE(ARM64);
+INSTANTIATE(X86_64);
+
+} // namespace mold::macho
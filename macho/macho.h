@@ -20,6 +20,7 @@ typedef int32_t i32;
 typedef int64_t i64;
 
 static constexpr u32 FAT_MAGIC = 0xcafebabe;
+static constexpr u32 FAT_MAGIC_64 = 0xcafebabf;
 
 static constexpr u32 MH_OBJECT = 0x1;
 static constexpr u32 MH_EXECUTE = 0x2;
@@ -342,6 +343,15 @@ struct FatArch {
   ubig32 align;
 };
 
+struct FatArch64 {
+  ubig32 cputype;
+  ubig32 cpusubtype;
+  ubig64 offset;
+  ubig64 size;
+  ubig32 align;
+  ubig32 reserved;
+};
+
 struct MachHeader {
   u32 magic;
   u32 cputype;
@@ -623,6 +633,38 @@ struct CompactUnwindEntry {
   u64 lsda;
 };
 
+// __LINKEDIT,__chainfixups
+
+static constexpr u32 DYLD_CHAINED_PTR_64_OFFSET = 6;
+static constexpr u32 DYLD_CHAINED_PTR_START_NONE = 0xffff;
+static constexpr u32 DYLD_CHAINED_IMPORT = 1;
+
+struct ChainedFixupsHeader {
+  u32 fixups_version;
+  u32 starts_offset;
+  u32 imports_offset;
+  u32 symbols_offset;
+  u32 imports_count;
+  u32 imports_format;
+  u32 symbols_format;
+};
+
+struct ChainedStartsInSegment {
+  u32 size;
+  u16 page_size;
+  u16 pointer_format;
+  u64 segment_offset;
+  u32 max_valid_pointer;
+  u16 page_count;
+  u16 page_start[1];
+};
+
+struct ChainedImport {
+  u32 lib_ordinal : 8;
+  u32 weak_import : 1;
+  u32 name_offset : 23;
+};
+
 // __LINKEDIT,__code_signature
 
 static constexpr u32 CSMAGIC_EMBEDDED_SIGNATURE = 0xfade0cc0;
@@ -1,6 +1,7 @@
 #include "mold.h"
 #include "../archive-file.h"
 #include "../cmdline.h"
+#include "../subprocess.h"
 
 #include <cstdlib>
 #include <fcntl.h>
@@ -9,6 +10,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for_each.h>
+#include <unordered_set>
 
 namespace mold::macho {
 
@@ -113,6 +117,7 @@ static bool compare_chunks(const Chunk<E> *a, const Chunk<E> *b) {
     "__binding",
     "__weak_binding",
     "__lazy_binding",
+    "__chainfixups",
     "__export",
     "__func_starts",
     "__data_in_code",
@@ -149,6 +154,22 @@ static void create_synthetic_chunks(Context<E> &ctx) {
         ((OutputSection<E> *)chunk)->members.empty())
       continue;
 
+    // With -fixup_chains, dyld binds all symbols at load time, so we
+    // need neither dyld opcodes nor lazy binding.
+    if (ctx.arg.fixup_chains) {
+      if (chunk == &ctx.rebase || chunk == &ctx.bind ||
+          chunk == &ctx.lazy_bind || chunk == &ctx.stub_helper)
+        continue;
+    } else if (chunk == &ctx.chained_fixups) {
+      continue;
+    }
+
+    // With -bind_at_load, lazy symbol pointers are bound by regular
+    // dyld opcodes, so we don't need lazy binding.
+    if (ctx.arg.bind_at_load &&
+        (chunk == &ctx.lazy_bind || chunk == &ctx.stub_helper))
+      continue;
+
     OutputSegment<E> *seg =
       OutputSegment<E>::get_instance(ctx, chunk->hdr.get_segname());
     seg->chunks.push_back(chunk);
@@ -160,42 +181,116 @@ static void create_synthetic_chunks(Context<E> &ctx) {
     sort(seg->chunks, compare_chunks<E>);
 }
 
+// Reorders subsections as specified by -order_file. Each line of the
+// file contains a symbol name, optionally prefixed by an architecture
+// name and/or an object file name followed by ':'. Subsections defining
+// the listed symbols are moved to the beginning of their output
+// sections in that order. Everything else stays in input order.
+//
+// This is typically used to cluster functions executed at launch time
+// into as few pages as possible.
+template <typename E>
+static void apply_order_file(Context<E> &ctx) {
+  Timer t(ctx, "apply_order_file");
+
+  MappedFile<Context<E>> *mf =
+    MappedFile<Context<E>>::must_open(ctx, ctx.arg.order_file);
+  std::string_view data = mf->get_contents();
+  std::string_view arch = (ctx.arg.arch == CPU_TYPE_ARM64) ? "arm64" : "x86_64";
+  std::unordered_map<Subsection<E> *, i64> order;
+
+  while (!data.empty()) {
+    size_t pos = data.find('\n');
+    std::string_view line = data.substr(0, pos);
+    data = (pos == data.npos) ? "" : data.substr(pos + 1);
+
+    line = line.substr(0, line.find('#'));
+    while (!line.empty() && isspace(line.back()))
+      line.remove_suffix(1);
+    while (!line.empty() && isspace(line[0]))
+      line.remove_prefix(1);
+
+    // Objective-C method names contain ':', so we strip only known
+    // prefixes.
+    if (size_t pos = line.find(':'); pos != line.npos) {
+      std::string_view prefix = line.substr(0, pos);
+      if (prefix == "arm64" || prefix == "arm64e" || prefix == "x86_64" ||
+          prefix == "i386")
+        line = (prefix == arch) ? line.substr(pos + 1) : "";
+    }
+
+    if (size_t pos = line.find(".o:"); pos != line.npos)
+      line = line.substr(pos + 3);
+
+    if (line.empty())
+      continue;
+
+    typename decltype(ctx.symbol_map)::const_accessor acc;
+    if (ctx.symbol_map.find(acc, line))
+      if (Subsection<E> *subsec = acc->second.subsec)
+        order.insert({subsec, order.size()});
+  }
+
+  tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
+    if (!chunk->is_regular)
+      return;
+
+    std::vector<Subsection<E> *> &vec = ((OutputSection<E> *)chunk)->members;
+    auto mid = std::stable_partition(vec.begin(), vec.end(),
+                                     [&](Subsection<E> *subsec) {
+      return order.contains(subsec);
+    });
+
+    std::sort(vec.begin(), mid, [&](Subsection<E> *a, Subsection<E> *b) {
+      return order.find(a)->second < order.find(b)->second;
+    });
+  });
+}
+
 template <typename E>
 static void scan_unwind_info(Context<E> &ctx) {
-  for (ObjectFile<E> *file : ctx.objs)
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     for (UnwindRecord<E> &rec : file->unwind_records)
       if (!ctx.arg.dead_strip || rec.is_alive)
         if (rec.personality)
           rec.personality->flags |= NEEDS_GOT;
+  });
 }
 
+// Returns symbols defined by given files that have a given flag set by
+// scan_relocations(), in file order. Files are scanned in parallel.
+template <typename E>
+static std::vector<Symbol<E> *>
+collect_symbols(std::span<InputFile<E> *> files, u8 flag) {
+  std::vector<std::vector<Symbol<E> *>> vec(files.size());
+
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    for (Symbol<E> *sym : files[i]->syms)
+      if (sym && sym->file == files[i] && (sym->flags & flag))
+        vec[i].push_back(sym);
+  });
+  return flatten(vec);
+}
+
+// Assigns GOT, stub and thread pointer slots. Slots are assigned in
+// file order so that the output is deterministic.
 template <typename E>
 static void export_symbols(Context<E> &ctx) {
-  ctx.got.add(ctx, intern(ctx, "dyld_stub_binder"));
-
-  for (ObjectFile<E> *file : ctx.objs) {
-    for (Symbol<E> *sym : file->syms) {
-      if (sym && sym->file == file) {
-        if (sym->flags & NEEDS_GOT)
-          ctx.got.add(ctx, sym);
-        if (sym->flags & NEEDS_THREAD_PTR)
-          ctx.thread_ptrs.add(ctx, sym);
-      }
-    }
-  }
+  if (!ctx.arg.fixup_chains && !ctx.arg.bind_at_load)
+    ctx.got.add(ctx, intern(ctx, "dyld_stub_binder"));
 
-  for (DylibFile<E> *file : ctx.dylibs) {
-    for (Symbol<E> *sym : file->syms) {
-      if (sym && sym->file == file) {
-        if (sym->flags & NEEDS_STUB)
-          ctx.stubs.add(ctx, sym);
-        if (sym->flags & NEEDS_GOT)
-          ctx.got.add(ctx, sym);
-        if (sym->flags & NEEDS_THREAD_PTR)
-          ctx.thread_ptrs.add(ctx, sym);
-      }
-    }
-  }
+  std::vector<InputFile<E> *> files;
+  append(files, ctx.objs);
+  append(files, ctx.dylibs);
+
+  std::vector<Symbol<E> *> stubs =
+    collect_symbols<E>(std::span(files).subspan(ctx.objs.size()), NEEDS_STUB);
+  std::vector<Symbol<E> *> gots = collect_symbols<E>(files, NEEDS_GOT);
+  std::vector<Symbol<E> *> tlvs = collect_symbols<E>(files, NEEDS_THREAD_PTR);
+
+  ctx.stubs.add(ctx, stubs);
+  ctx.got.add(ctx, gots);
+  ctx.thread_ptrs.add(ctx, tlvs);
 }
 
 template <typename E>
@@ -257,17 +352,41 @@ MappedFile<Context<E>> *find_library(Context<E> &ctx, std::string name) {
   return nullptr;
 }
 
+// Returns a view of the slice for the target architecture. A slice
+// refers to the contents of a given universal file, so no data is
+// copied or mapped again. An archive in a slice is read by offset in
+// the same way as a regular archive.
+template <typename E, typename Arch>
+static MappedFile<Context<E>> *
+find_universal_slice(Context<E> &ctx, MappedFile<Context<E>> *mf) {
+  FatHeader &hdr = *(FatHeader *)mf->data;
+  if (mf->size < sizeof(hdr) + hdr.nfat_arch * sizeof(Arch))
+    Fatal(ctx) << mf->name << ": corrupted fat header";
+
+  Arch *arch = (Arch *)(mf->data + sizeof(hdr));
+  for (i64 i = 0; i < hdr.nfat_arch; i++) {
+    if (arch[i].cputype == E::cputype) {
+      u64 offset = arch[i].offset;
+      u64 size = arch[i].size;
+      if (mf->size < offset || mf->size - offset < size)
+        Fatal(ctx) << mf->name << ": fat file slice is out of range";
+      return mf->slice(ctx, mf->name, offset, size);
+    }
+  }
+  Fatal(ctx) << mf->name << ": fat file contains no matching file";
+}
+
 template <typename E>
 static MappedFile<Context<E>> *
 strip_universal_header(Context<E> &ctx, MappedFile<Context<E>> *mf) {
+  if (mf->size < sizeof(FatHeader))
+    Fatal(ctx) << mf->name << ": corrupted fat header";
+
   FatHeader &hdr = *(FatHeader *)mf->data;
+  if (hdr.magic == FAT_MAGIC_64)
+    return find_universal_slice<E, FatArch64>(ctx, mf);
   assert(hdr.magic == FAT_MAGIC);
-
-  FatArch *arch = (FatArch *)(mf->data + sizeof(hdr));
-  for (i64 i = 0; i < hdr.nfat_arch; i++)
-    if (arch[i].cputype == E::cputype)
-      return mf->slice(ctx, mf->name, arch[i].offset, arch[i].size);
-  Fatal(ctx) << mf->name << ": fat file contains no matching file";
+  return find_universal_slice<E, FatArch>(ctx, mf);
 }
 
 template <typename E>
@@ -352,6 +471,43 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
   }
 }
 
+// When ld64.mold is running as a daemon, input files may have been
+// updated between the time when we preloaded them and the time when we
+// get a link request. This function re-reads only the updated files.
+// If an archive member or a slice of a universal file is updated, we
+// re-read the entire containing file.
+template <typename E>
+static void reload_input_files(Context<E> &ctx) {
+  std::vector<ObjectFile<E> *> objs = std::move(ctx.objs);
+  std::vector<DylibFile<E> *> dylibs = std::move(ctx.dylibs);
+  std::unordered_set<std::string> reloaded;
+
+  ctx.objs.clear();
+  ctx.dylibs.clear();
+
+  auto reload = [&](InputFile<E> *file, bool is_needed) {
+    MappedFile<Context<E>> *mf = file->mf;
+    while (mf->parent)
+      mf = mf->parent;
+
+    if (!is_updated(ctx, mf))
+      return false;
+
+    if (reloaded.insert(mf->name).second)
+      read_file(ctx, MappedFile<Context<E>>::must_open(ctx, mf->name),
+                is_needed);
+    return true;
+  };
+
+  for (ObjectFile<E> *file : objs)
+    if (!reload(file, false))
+      ctx.objs.push_back(file);
+
+  for (DylibFile<E> *file : dylibs)
+    if (!reload(file, file->is_needed))
+      ctx.dylibs.push_back(file);
+}
+
 template <typename E>
 static int do_main(int argc, char **argv) {
   Context<E> ctx;
@@ -372,8 +528,35 @@ static int do_main(int argc, char **argv) {
   if (ctx.arg.arch == CPU_TYPE_X86_64)
     return do_main<X86_64>(argc, argv);
 
+  if (!ctx.arg.preload)
+    try_resume_daemon(ctx);
+
+  install_signal_handler();
+
+  std::function<void()> on_complete;
+  std::function<bool(std::function<void()>)> wait_for_client;
+
+  // The daemon forks a child for each client, and forking a process
+  // with running TBB worker threads is not safe. So the daemon reads
+  // files with a single thread, and the children use all threads.
+  std::unique_ptr<tbb::global_control> daemon_cont;
+
+  if (ctx.arg.preload) {
+    daemon_cont.reset(new tbb::global_control(
+      tbb::global_control::max_allowed_parallelism, 1));
+    daemonize(ctx, &wait_for_client, nullptr, &on_complete);
+  } else if (ctx.arg.fork) {
+    on_complete = fork_child();
+  }
+
   read_input_files(ctx, file_args);
 
+  if (ctx.arg.preload) {
+    wait_for_client([&] { reload_input_files(ctx); });
+    daemon_cont.reset();
+    reload_input_files(ctx);
+  }
+
   i64 priority = 1;
   for (ObjectFile<E> *file : ctx.objs)
     file->priority = priority++;
@@ -383,33 +566,43 @@ static int do_main(int argc, char **argv) {
   for (i64 i = 0; i < ctx.dylibs.size(); i++)
     ctx.dylibs[i]->dylib_idx = i + 1;
 
-  for (ObjectFile<E> *file : ctx.objs)
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     file->parse(ctx);
-  for (DylibFile<E> *dylib : ctx.dylibs)
+  });
+
+  tbb::parallel_for_each(ctx.dylibs, [&](DylibFile<E> *dylib) {
     dylib->parse(ctx);
+  });
 
-  if (ctx.arg.ObjC)
-    for (ObjectFile<E> *file : ctx.objs)
+  if (ctx.arg.ObjC) {
+    tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
       if (!file->archive_name.empty() && file->is_objc_object(ctx))
         file->is_alive = true;
+    });
+  }
 
-  for (ObjectFile<E> *file : ctx.objs) {
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     if (file->is_alive)
       file->resolve_regular_symbols(ctx);
     else
       file->resolve_lazy_symbols(ctx);
-  }
+  });
 
   std::vector<ObjectFile<E> *> live_objs;
   for (ObjectFile<E> *file : ctx.objs)
     if (file->is_alive)
       live_objs.push_back(file);
 
-  for (i64 i = 0; i < live_objs.size(); i++)
-    append(live_objs, live_objs[i]->mark_live_objects(ctx));
+  tbb::parallel_for_each(live_objs,
+                         [&](ObjectFile<E> *file,
+                             tbb::feeder<ObjectFile<E> *> &feeder) {
+    for (ObjectFile<E> *obj : file->mark_live_objects(ctx))
+      feeder.add(obj);
+  });
 
-  for (DylibFile<E> *dylib : ctx.dylibs)
+  tbb::parallel_for_each(ctx.dylibs, [&](DylibFile<E> *dylib) {
     dylib->resolve_symbols(ctx);
+  });
 
   if (ctx.output_type == MH_EXECUTE && !intern(ctx, ctx.arg.entry)->file)
     Error(ctx) << "undefined entry point symbol: " << ctx.arg.entry;
@@ -426,23 +619,34 @@ static int do_main(int argc, char **argv) {
       SyncOut(ctx) << *file;
   }
 
-  for (ObjectFile<E> *file : ctx.objs)
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     file->convert_common_symbols(ctx);
+  });
+
+  merge_literals(ctx);
 
   if (ctx.arg.dead_strip)
     dead_strip(ctx);
 
+  if (ctx.arg.deduplicate)
+    icf_sections(ctx);
+
   create_synthetic_chunks(ctx);
 
-  for (ObjectFile<E> *file : ctx.objs)
+  if (!ctx.arg.order_file.empty())
+    apply_order_file(ctx);
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
     file->check_duplicate_symbols(ctx);
+  });
 
   for (i64 i = 0; i < ctx.segments.size(); i++)
     ctx.segments[i]->seg_idx = i + 1;
 
-  for (ObjectFile<E> *file : ctx.objs)
-    for (std::unique_ptr<Subsection<E> > &subsec : file->subsections)
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    for (std::unique_ptr<Subsection<E>> &subsec : file->subsections)
       subsec->scan_relocations(ctx);
+  });
 
   scan_unwind_info(ctx);
 
@@ -456,8 +660,48 @@ static int do_main(int argc, char **argv) {
   ctx.output_file = OutputFile<E>::open(ctx, ctx.arg.output, output_size, 0777);
   ctx.buf = ctx.output_file->buf;
 
-  for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments)
-    seg->copy_buf(ctx);
+  // Copy chunks to the output buffer. Chunks of all segments are
+  // processed as one flat list of tasks in file order, so that a thread
+  // never waits for a large segment while others are idle. When the
+  // last chunk of a segment is written, the thread that wrote it applies
+  // chained fixups and computes code signature hashes for the segment,
+  // which overlaps with copying the remaining chunks. The segment
+  // containing the code signature itself is hashed later by
+  // write_uuid(), which derives LC_UUID from the page hashes.
+  tbb::parallel_for_each(ctx.segments,
+                         [&](std::unique_ptr<OutputSegment<E>> &seg) {
+    seg->write_padding(ctx);
+  });
+
+  std::vector<std::pair<i64, Chunk<E> *>> tasks;
+  std::vector<std::atomic_int64_t> remaining(ctx.segments.size());
+
+  for (i64 i = 0; i < ctx.segments.size(); i++) {
+    for (Chunk<E> *chunk : ctx.segments[i]->chunks) {
+      if (chunk->hdr.type != S_ZEROFILL) {
+        tasks.push_back({i, chunk});
+        remaining[i]++;
+      }
+    }
+  }
+
+  auto finish_segment = [&](OutputSegment<E> &seg) {
+    if (ctx.arg.fixup_chains)
+      ctx.chained_fixups.write_fixups(ctx, seg);
+    if (&seg != ctx.linkedit_seg)
+      ctx.code_sig.write_hashes(ctx, seg);
+  };
+
+  for (i64 i = 0; i < ctx.segments.size(); i++)
+    if (remaining[i] == 0)
+      finish_segment(*ctx.segments[i]);
+
+  tbb::parallel_for_each(tasks, [&](std::pair<i64, Chunk<E> *> task) {
+    task.second->copy_buf(ctx);
+    if (--remaining[task.first] == 0)
+      finish_segment(*ctx.segments[task.first]);
+  });
+  ctx.code_sig.write_uuid(ctx);
   ctx.code_sig.write_signature(ctx);
 
   ctx.output_file->close(ctx);
@@ -465,6 +709,17 @@ static int do_main(int argc, char **argv) {
 
   if (!ctx.arg.map.empty())
     print_map(ctx);
+
+  std::cout << std::flush;
+  std::cerr << std::flush;
+  if (on_complete)
+    on_complete();
+
+  if (ctx.arg.quick_exit) {
+    if (!on_complete)
+      release_process_memory(ctx);
+    _exit(0);
+  }
   return 0;
 }
 
@@ -2,6 +2,9 @@
 
 #include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
 
 namespace mold::macho {
 
@@ -13,31 +16,70 @@ struct Sym {
 };
 
 template <typename E>
-void print_map(Context<E> &ctx) {
-  std::ofstream out(ctx.arg.map.c_str());
-  if (!out.is_open())
-    Fatal(ctx) << "cannot open " << ctx.arg.map << ": " << errno_string();
-
-  out << "# Path: " << ctx.arg.output << "\n"
-      << "# Arch: x86-64\n"
-      << "# Object files:\n";
+static std::string_view get_arch_name() {
+  if constexpr (std::is_same_v<E, ARM64>)
+    return "arm64";
+  return "x86_64";
+}
 
-  std::vector<Sym> syms;
+// Returns all defined symbols of live object files sorted by address.
+template <typename E>
+static std::vector<Sym> get_symbols(Context<E> &ctx) {
+  std::vector<std::vector<Sym>> vec(ctx.objs.size());
 
-  for (i64 i = 0; i < ctx.objs.size(); i++){
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
     ObjectFile<E> &file = *ctx.objs[i];
-
-    if (file.is_alive) {
-      out << "[" << std::setw(3) << i << "] " << file << "\n";
+    if (file.is_alive)
       for (Symbol<E> *sym : file.syms)
-        if (sym->file == &file)
-          syms.push_back({sym->get_addr(ctx), 0, (u32)i, sym->name});
-    }
-  }
+        if (sym && sym->file == &file)
+          vec[i].push_back({sym->get_addr(ctx), 0, (u32)i, sym->name});
+  });
 
-  sort(syms, [](const Sym &a, const Sym &b) {
-    return a.addr < b.addr;
+  std::vector<Sym> syms = flatten(vec);
+  tbb::parallel_sort(syms.begin(), syms.end(), [](const Sym &a, const Sym &b) {
+    return std::tuple(a.addr, a.fileidx, a.name) <
+           std::tuple(b.addr, b.fileidx, b.name);
   });
+  return syms;
+}
+
+// Formats `num` lines in parallel and writes them to `out` in order.
+// Lines are formatted in fixed-size batches, and only a bounded number
+// of batches are kept in memory at once.
+template <typename Fn>
+static void write_lines(std::ostream &out, i64 num, Fn fn) {
+  constexpr i64 batch_size = 1024;
+  constexpr i64 window_size = batch_size * 64;
+
+  for (i64 win = 0; win < num; win += window_size) {
+    i64 win_end = std::min<i64>(win + window_size, num);
+    std::vector<std::string> bufs((win_end - win + batch_size - 1) /
+                                  batch_size);
+
+    tbb::parallel_for((i64)0, (i64)bufs.size(), [&](i64 i) {
+      i64 begin = win + i * batch_size;
+      i64 end = std::min(begin + batch_size, win_end);
+      std::ostringstream ss;
+      for (i64 j = begin; j < end; j++)
+        fn(ss, j);
+      bufs[i] = std::move(ss.str());
+    });
+
+    for (std::string &str : bufs)
+      out << str;
+  }
+}
+
+template <typename E>
+static void print_text_map(Context<E> &ctx, std::ostream &out,
+                           std::span<Sym> syms) {
+  out << "# Path: " << ctx.arg.output << "\n"
+      << "# Arch: " << get_arch_name<E>() << "\n"
+      << "# Object files:\n";
+
+  for (i64 i = 0; i < ctx.objs.size(); i++)
+    if (ctx.objs[i]->is_alive)
+      out << "[" << std::setw(3) << i << "] " << *ctx.objs[i] << "\n";
 
   out << "# Sections:\n"
       << "# Address       Size            Segment Section\n";
@@ -45,7 +87,7 @@ void print_map(Context<E> &ctx) {
   for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments) {
     for (Chunk<E> *chunk : seg->chunks) {
       if (!chunk->is_hidden) {
-        out << "0x" << std::hex
+        out << "0x" << std::hex << std::right
             << std::setw(8) << std::setfill('0') << chunk->hdr.addr
             << "     0x"
             << std::setw(8) << std::setfill('0') << chunk->hdr.size
@@ -59,16 +101,100 @@ void print_map(Context<E> &ctx) {
   out << "# Symbols:\n"
       << "# Address       Size            File  Name\n";
 
-  for (Sym &sym : syms) {
-    out << "0x" << std::hex
-        << std::setw(8) << std::setfill('0') << sym.addr
-        << "     0x"
-        << std::setw(8) << std::setfill('0') << 0
-        << "      ["
-        << std::setw(3) << std::right << std::setfill(' ') << std::dec
-        << sym.fileidx
-        << "] " << sym.name << "\n";
+  write_lines(out, syms.size(), [&](std::ostream &ss, i64 i) {
+    Sym &sym = syms[i];
+    ss << "0x" << std::hex
+       << std::setw(8) << std::setfill('0') << sym.addr
+       << "     0x"
+       << std::setw(8) << std::setfill('0') << sym.size
+       << "      ["
+       << std::setw(3) << std::right << std::setfill(' ') << std::dec
+       << sym.fileidx
+       << "] " << sym.name << "\n";
+  });
+}
+
+static void write_json_string(std::ostream &out, std::string_view str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if ((u8)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out << buf;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+// Writes the same information as the text map file as a JSON object.
+// Each symbol is written on its own line so that the output can be
+// parsed incrementally.
+template <typename E>
+static void print_json_map(Context<E> &ctx, std::ostream &out,
+                           std::span<Sym> syms) {
+  out << "{\"path\":";
+  write_json_string(out, ctx.arg.output);
+  out << ",\"arch\":\"" << get_arch_name<E>() << "\",\"object_files\":[";
+
+  bool first = true;
+  for (i64 i = 0; i < ctx.objs.size(); i++) {
+    if (ctx.objs[i]->is_alive) {
+      std::ostringstream name;
+      name << *ctx.objs[i];
+      out << (first ? "\n" : ",\n") << "{\"index\":" << i << ",\"name\":";
+      write_json_string(out, name.str());
+      out << "}";
+      first = false;
+    }
+  }
+
+  out << "],\"sections\":[";
+  first = true;
+
+  for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments) {
+    for (Chunk<E> *chunk : seg->chunks) {
+      if (!chunk->is_hidden) {
+        out << (first ? "\n" : ",\n") << "{\"segment\":";
+        write_json_string(out, chunk->hdr.get_segname());
+        out << ",\"section\":";
+        write_json_string(out, chunk->hdr.get_sectname());
+        out << ",\"address\":" << chunk->hdr.addr
+            << ",\"size\":" << chunk->hdr.size << "}";
+        first = false;
+      }
+    }
   }
+
+  out << "],\"symbols\":[";
+
+  write_lines(out, syms.size(), [&](std::ostream &ss, i64 i) {
+    Sym &sym = syms[i];
+    ss << (i ? ",\n" : "\n") << "{\"address\":" << sym.addr
+       << ",\"size\":" << sym.size << ",\"file\":" << sym.fileidx
+       << ",\"name\":";
+    write_json_string(ss, sym.name);
+    ss << "}";
+  });
+
+  out << "\n]}\n";
+}
+
+template <typename E>
+void print_map(Context<E> &ctx) {
+  std::ofstream out(ctx.arg.map.c_str());
+  if (!out.is_open())
+    Fatal(ctx) << "cannot open " << ctx.arg.map << ": " << errno_string();
+
+  std::vector<Sym> syms = get_symbols(ctx);
+
+  if (ctx.arg.map_json)
+    print_json_map(ctx, out, syms);
+  else
+    print_text_map(ctx, out, syms);
 }
 
 #define INSTANTIATE(E)                          \
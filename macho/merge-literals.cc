@@ -0,0 +1,155 @@
+// This file merges identical literals such as C strings, ObjC method
+// names and 4/8/16-byte constants across input files.
+//
+// Literal sections are split into one subsection per literal when
+// input files are parsed. Here, we insert all literal subsections of
+// an output section to a concurrent hash table keyed by their contents.
+// For each group of identical literals, we choose one as a leader and
+// let the others be replaced by it, in the same way as ICF folds
+// identical functions.
+//
+// ObjC selector references and class references are merged in the
+// same way, but they are keyed by what they point to, because their
+// contents are just placeholders for relocations. Selector references
+// are merged after selector names, so that references to the same
+// selector name in different files point to the same name.
+
+#include "mold.h"
+
+#include <tbb/parallel_for.h>
+#include <xxh3.h>
+
+namespace mold::macho {
+
+// The leader of identical literals must satisfy the strictest alignment
+// requirement among them. Ties are broken by file priority and address
+// so that the output is deterministic.
+template <typename E>
+static bool is_preferred(Subsection<E> &a, Subsection<E> &b) {
+  return std::tuple(-a.p2align, a.isec.file.priority, a.input_addr) <
+         std::tuple(-b.p2align, b.isec.file.priority, b.input_addr);
+}
+
+// Returns the key of an ObjC reference, which is the address it points
+// to expressed as a pair of a subsection or symbol and an offset. An
+// empty string is returned if it can't be merged.
+template <typename E>
+static std::string get_objc_ref_key(Subsection<E> &ref) {
+  std::span<Relocation<E>> rels = ref.get_rels();
+  if (rels.size() != 1 || rels[0].offset != 0 || rels[0].is_pcrel ||
+      rels[0].p2size != 3)
+    return "";
+
+  Relocation<E> &rel = rels[0];
+  Subsection<E> *subsec = rel.subsec;
+  Symbol<E> *sym = nullptr;
+  i64 offset = rel.addend;
+
+  if (rel.sym) {
+    if (rel.sym->subsec) {
+      subsec = rel.sym->subsec;
+      offset += rel.sym->value;
+    } else {
+      sym = rel.sym;
+    }
+  }
+
+  if (subsec && subsec->replacer)
+    subsec = subsec->replacer;
+
+  void *target = sym ? (void *)sym : (void *)subsec;
+
+  std::string key(sizeof(target) + sizeof(offset), '\0');
+  memcpy(key.data(), &target, sizeof(target));
+  memcpy(key.data() + sizeof(target), &offset, sizeof(offset));
+  return key;
+}
+
+template <typename E>
+static void merge(Context<E> &ctx, std::vector<Subsection<E> *> &subsecs) {
+  // ObjC references are keyed by their pointees.
+  std::vector<std::string> ref_keys;
+  if (subsecs[0]->isec.is_objc_ref_section()) {
+    ref_keys.resize(subsecs.size());
+    tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+      ref_keys[i] = get_objc_ref_key(*subsecs[i]);
+    });
+  }
+
+  ConcurrentMap<Subsection<E> *> map(subsecs.size() * 2);
+  std::vector<Subsection<E> **> leaders(subsecs.size());
+
+  for (;;) {
+    std::atomic_bool is_full = false;
+
+    tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+      if (is_full)
+        return;
+
+      std::string_view key = ref_keys.empty() ? subsecs[i]->get_contents()
+                                              : ref_keys[i];
+      if (key.empty())
+        return;
+
+      u64 hash = XXH3_64bits(key.data(), key.size());
+      Subsection<E> **leader = map.insert(key, hash, subsecs[i]).first;
+      if (!leader) {
+        is_full = true;
+        return;
+      }
+
+      std::atomic_ref ref(*leader);
+      Subsection<E> *cur = ref.load();
+      while (is_preferred(*subsecs[i], *cur) &&
+             !ref.compare_exchange_weak(cur, subsecs[i]));
+      leaders[i] = leader;
+    });
+
+    if (!is_full)
+      break;
+
+    // The hash table is full. Grow it and insert all literals again.
+    map.resize(map.nbuckets * 2);
+  }
+
+  tbb::parallel_for((i64)0, (i64)subsecs.size(), [&](i64 i) {
+    if (leaders[i] && *leaders[i] != subsecs[i])
+      subsecs[i]->replacer = *leaders[i];
+  });
+}
+
+template <typename E>
+void merge_literals(Context<E> &ctx) {
+  Timer t(ctx, "merge_literals");
+
+  // Literals are merged only within the same output section.
+  std::map<OutputSection<E> *, std::vector<Subsection<E> *>> groups;
+
+  for (ObjectFile<E> *file : ctx.objs)
+    for (std::unique_ptr<Subsection<E>> &subsec : file->subsections)
+      if (subsec->isec.is_literal_section())
+        groups[&subsec->isec.osec].push_back(subsec.get());
+
+  if (groups.empty())
+    return;
+
+  // ObjC references are keyed by their pointees, which may be merged
+  // literals themselves, so merge them last.
+  for (auto &[osec, subsecs] : groups)
+    if (!subsecs[0]->isec.is_objc_ref_section())
+      merge(ctx, subsecs);
+
+  for (auto &[osec, subsecs] : groups)
+    if (subsecs[0]->isec.is_objc_ref_section())
+      merge(ctx, subsecs);
+
+  remove_folded_subsections(ctx);
+}
+
+#define INSTANTIATE(E)                          \
+  template void merge_literals(Context<E> &)
+
+INSTANTIATE(ARM64);
+INSTANTIATE(X86_64);
+
+} // namespace mold::macho
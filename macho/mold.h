@@ -9,6 +9,7 @@
 #include <tbb/concurrent_hash_map.h>
 #include <tbb/spin_mutex.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 
 namespace mold::macho {
@@ -123,8 +124,7 @@ public:
 
 private:
   void parse_dylib(Context<E> &ctx);
-  void read_trie(Context<E> &ctx, u8 *start, i64 offset = 0,
-                 const std::string &prefix = "");
+  void read_trie(Context<E> &ctx, u8 *start, i64 size);
 
   DylibFile() {
     this->is_dylib = true;
@@ -145,6 +145,22 @@ public:
   InputSection(Context<E> &ctx, ObjectFile<E> &file, const MachSection &hdr);
   void parse_relocations(Context<E> &ctx);
 
+  // Literal sections are split into individual literals rather than
+  // at symbols, so that identical literals can be merged.
+  bool is_literal_section() const {
+    return hdr.type == S_CSTRING_LITERALS || hdr.type == S_4BYTE_LITERALS ||
+           hdr.type == S_8BYTE_LITERALS || hdr.type == S_16BYTE_LITERALS ||
+           is_objc_ref_section();
+  }
+
+  // __objc_selrefs and __objc_classrefs consist of pointers to selector
+  // names and classes, respectively. They are split and merged like
+  // literals, but by their pointees instead of their contents.
+  bool is_objc_ref_section() const {
+    return hdr.match("__DATA", "__objc_selrefs") ||
+           hdr.match("__DATA", "__objc_classrefs");
+  }
+
   ObjectFile<E> &file;
   const MachSection &hdr;
   OutputSection<E> &osec;
@@ -156,6 +172,13 @@ public:
 template <typename E>
 std::ostream &operator<<(std::ostream &out, const InputSection<E> &sec);
 
+// A reference from a branch relocation to a range extension thunk
+// entry. See create_range_extension_thunks() in arch-arm64.cc.
+struct RangeExtensionRef {
+  i32 thunk_idx = -1;
+  i32 sym_idx = -1;
+};
+
 template <typename E>
 class Subsection {
 public:
@@ -187,8 +210,15 @@ public:
   u32 unwind_offset = 0;
   u32 nunwind = 0;
   u32 raddr = -1;
+  i32 icf_idx = -1;
   u16 p2align = 0;
   std::atomic_bool is_alive = false;
+
+  // Set by ICF if this subsection is folded into another one.
+  Subsection<E> *replacer = nullptr;
+
+  // Thunk entries for out-of-range branches, indexed by relocation
+  std::unique_ptr<RangeExtensionRef[]> range_extn;
 };
 
 template <typename E>
@@ -248,7 +278,7 @@ public:
   get_instance(Context<E> &ctx, std::string_view name);
 
   void set_offset(Context<E> &ctx, i64 fileoff, u64 vmaddr);
-  void copy_buf(Context<E> &ctx);
+  void write_padding(Context<E> &ctx);
 
   std::string_view name;
   SegmentCommand cmd = {};
@@ -290,6 +320,34 @@ public:
   void copy_buf(Context<E> &ctx) override;
 };
 
+// A range extension thunk is a small piece of code placed between
+// subsections. A branch instruction whose destination is too far away
+// jumps to a thunk entry instead, which then jumps to the destination
+// using a register.
+template <typename E>
+class RangeExtensionThunk {
+public:
+  struct Target {
+    auto operator<=>(const Target &) const = default;
+
+    Symbol<E> *sym = nullptr;
+    Subsection<E> *subsec = nullptr;
+    i64 addend = 0;
+  };
+
+  RangeExtensionThunk(OutputSection<E> &osec) : output_section(osec) {}
+
+  i64 size() const { return targets.size() * ENTRY_SIZE; }
+  inline u64 get_addr(i64 idx) const;
+  void copy_buf(Context<E> &ctx);
+
+  static constexpr i64 ENTRY_SIZE = 12;
+
+  OutputSection<E> &output_section;
+  i64 offset = -1;
+  std::vector<Target> targets;
+};
+
 template <typename E>
 class OutputSection : public Chunk<E> {
 public:
@@ -314,14 +372,21 @@ public:
   }
 
   std::vector<Subsection<E> *> members;
+  std::vector<std::unique_ptr<RangeExtensionThunk<E>>> thunks;
+};
+
+struct RebaseEntry {
+  i64 seg_idx;
+  i64 offset;
 };
 
+// RebaseEncoder encodes base relocations to rebase opcodes. It doesn't
+// emit REBASE_OPCODE_SET_TYPE_IMM nor REBASE_OPCODE_DONE, so that
+// multiple encoded streams can be concatenated.
 class RebaseEncoder {
 public:
-  RebaseEncoder();
   void add(i64 seg_idx, i64 offset);
   void flush();
-  void finish();
 
   std::vector<u8> buf;
 
@@ -393,14 +458,44 @@ public:
   std::vector<u8> contents;
 };
 
+// With -fixup_chains, we emit chained fixups instead of rebase and
+// bind opcodes. Each pointer that needs to be fixed up at load time
+// is overwritten with an encoded rebase or bind entry, which also
+// contains the distance to the next fixup in the same page, so that
+// dyld can walk the pointers in a page as a linked list.
+template <typename E>
+class ChainedFixupsSection : public Chunk<E> {
+public:
+  ChainedFixupsSection(Context<E> &ctx)
+    : Chunk<E>(ctx, "__LINKEDIT", "__chainfixups") {
+    this->is_hidden = true;
+    this->hdr.p2align = __builtin_ctz(8);
+  }
+
+  void compute_size(Context<E> &ctx) override;
+  void copy_buf(Context<E> &ctx) override;
+  void write_fixups(Context<E> &ctx, OutputSegment<E> &seg);
+
+private:
+  struct Fixup {
+    u64 addr;
+    i32 import_idx; // -1 if rebase
+  };
+
+  std::span<Fixup> get_fixups(OutputSegment<E> &seg);
+
+  std::vector<Fixup> fixups;
+  std::vector<u8> contents;
+};
+
+// ExportEncoder builds an export trie. Trie nodes are stored in a flat
+// array. Each node's children are stored contiguously, so a node refers
+// to them by an index and a count.
 class ExportEncoder {
 public:
   void add(std::string_view name, u32 flags, u64 addr);
   i64 finish();
-
-  void write_trie(u8 *buf) {
-    write_trie(buf, root);
-  }
+  void write_trie(u8 *buf);
 
 private:
   struct Entry {
@@ -414,16 +509,20 @@ private:
     bool is_leaf = false;
     u32 flags = 0;
     u64 addr = 0;
-    u32 offset = -1;
-    std::vector<TrieNode> children;
+    u32 offset = 0;
+    u32 children = 0;
+    u32 num_children = 0;
   };
 
-  static i64 common_prefix_len(std::span<Entry> entries, i64 len);
-  static TrieNode construct_trie(std::span<Entry> entries, i64 len);
-  static i64 set_offset(TrieNode &node, i64 offset);
-  void write_trie(u8 *buf, TrieNode &node);
+  static std::vector<std::span<Entry>>
+  split_entries(std::span<Entry> entries, i64 len);
 
-  TrieNode root;
+  static void construct_trie(std::vector<TrieNode> &nodes, i64 idx,
+                             std::span<Entry> entries, i64 len);
+
+  i64 get_node_size(TrieNode &node);
+
+  std::vector<TrieNode> nodes;
   std::vector<Entry> entries;
 };
 
@@ -487,11 +586,11 @@ public:
     this->hdr.p2align = __builtin_ctz(8);
   }
 
-  i64 add_string(std::string_view str);
   void compute_size(Context<E> &ctx) override;
   void copy_buf(Context<E> &ctx) override;
 
-  std::string contents{1, '\0'};
+  // The string table starts with a null byte.
+  i64 contents_size = 1;
 };
 
 template <typename E>
@@ -526,9 +625,15 @@ public:
   }
 
   void compute_size(Context<E> &ctx) override;
+  void write_hashes(Context<E> &ctx, OutputSegment<E> &seg);
+  void write_uuid(Context<E> &ctx);
   void write_signature(Context<E> &ctx);
 
   static constexpr i64 BLOCK_SIZE = 4096;
+
+private:
+  i64 get_hashes_offset(Context<E> &ctx);
+  void write_hashes(Context<E> &ctx, i64 begin, i64 end);
 };
 
 template <typename E>
@@ -557,6 +662,7 @@ public:
   }
 
   void add(Context<E> &ctx, Symbol<E> *sym);
+  void add(Context<E> &ctx, std::span<Symbol<E> *> syms);
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> syms;
@@ -581,12 +687,17 @@ public:
   std::vector<u8> encode(Context<E> &ctx, std::span<UnwindRecord<E>> records);
 
 private:
+  static constexpr i64 max_common_encodings = 127;
+
   u32 encode_personality(Context<E> &ctx, Symbol<E> *sym);
+  void find_common_encodings(std::span<UnwindRecord<E>> records);
 
   std::vector<std::span<UnwindRecord<E>>>
   split_records(Context<E> &ctx, std::span<UnwindRecord<E>>);
 
   std::vector<Symbol<E> *> personalities;
+  std::vector<u32> common_list;
+  std::unordered_map<u32, u32> common_encodings;
 };
 
 template <typename E>
@@ -612,6 +723,7 @@ public:
   }
 
   void add(Context<E> &ctx, Symbol<E> *sym);
+  void add(Context<E> &ctx, std::span<Symbol<E> *> syms);
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> syms;
@@ -639,11 +751,19 @@ public:
   }
 
   void add(Context<E> &ctx, Symbol<E> *sym);
+  void add(Context<E> &ctx, std::span<Symbol<E> *> syms);
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<Symbol<E> *> syms;
 };
 
+//
+// arch-arm64.cc
+//
+
+bool create_range_extension_thunks(Context<ARM64> &ctx,
+                                   OutputSection<ARM64> &osec);
+
 //
 // mapfile.cc
 //
@@ -730,6 +850,23 @@ void parse_nonpositional_args(Context<E> &ctx,
 template <typename E>
 void dead_strip(Context<E> &ctx);
 
+//
+// icf.cc
+//
+
+template <typename E>
+void icf_sections(Context<E> &ctx);
+
+template <typename E>
+void remove_folded_subsections(Context<E> &ctx);
+
+//
+// merge-literals.cc
+//
+
+template <typename E>
+void merge_literals(Context<E> &ctx);
+
 //
 // main.cc
 //
@@ -766,13 +903,19 @@ struct Context {
   struct {
     bool ObjC = false;
     bool adhoc_codesign = true;
+    bool bind_at_load = false;
     bool dead_strip = true;
     bool dead_strip_dylibs = false;
-    bool deduplicate = true;
+    bool deduplicate = false;
     bool demangle = false;
     bool dylib = false;
     bool dynamic = true;
     bool fatal_warnings = false;
+    bool fixup_chains = false;
+    bool fork = true;
+    bool map_json = false;
+    bool preload = false;
+    bool quick_exit = true;
     bool trace = false;
     i64 arch = CPU_TYPE_ARM64;
     i64 headerpad = 256;
@@ -783,7 +926,9 @@ struct Context {
     std::string chroot;
     std::string entry = "_main";
     std::string map;
+    std::string order_file;
     std::string output = "a.out";
+    std::string tbd_cache_path;
     std::vector<std::string> framework_paths;
     std::vector<std::string> library_paths;
     std::vector<std::string> rpath;
@@ -804,6 +949,7 @@ struct Context {
   tbb::concurrent_vector<std::unique_ptr<DylibFile<E>>> dylib_pool;
   tbb::concurrent_vector<std::unique_ptr<u8[]>> string_pool;
   tbb::concurrent_vector<std::unique_ptr<MappedFile<Context<E>>>> mf_pool;
+  std::unordered_map<std::string, std::string_view> memory_inputs;
   std::vector<std::unique_ptr<OutputSection<E>>> osec_pool;
 
   tbb::concurrent_vector<std::unique_ptr<TimerRecord>> timer_records;
@@ -832,6 +978,7 @@ struct Context {
   OutputRebaseSection<E> rebase{*this};
   OutputBindSection<E> bind{*this};
   OutputLazyBindSection<E> lazy_bind{*this};
+  ChainedFixupsSection<E> chained_fixups{*this};
   OutputExportSection<E> export_{*this};
   OutputFunctionStartsSection<E> function_starts{*this};
   OutputSymtabSection<E> symtab{*this};
@@ -863,6 +1010,11 @@ u64 Subsection<E>::get_addr(Context<E> &ctx) const {
   return ctx.arg.pagezero_size + raddr;
 }
 
+template <typename E>
+u64 RangeExtensionThunk<E>::get_addr(i64 idx) const {
+  return output_section.hdr.addr + offset + idx * ENTRY_SIZE;
+}
+
 template <typename E>
 u64 Symbol<E>::get_addr(Context<E> &ctx) const {
   if (subsec)
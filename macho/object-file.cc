@@ -2,6 +2,8 @@
 
 #include "../archive-file.h"
 
+#include <tbb/parallel_for.h>
+
 namespace mold::macho {
 
 template <typename E>
@@ -111,6 +113,37 @@ struct SplitInfo {
   std::vector<SplitRegion> regions;
 };
 
+// Splits a literal section into individual literals. A C string
+// section consists of null-terminated strings, and a 4/8/16-byte
+// literal section or an ObjC reference section consists of fixed-size
+// values.
+template <typename E>
+static void split_literals(Context<E> &ctx, SplitInfo<E> &info) {
+  InputSection<E> &isec = *info.isec;
+  std::string_view data = isec.contents;
+
+  if (isec.hdr.type == S_CSTRING_LITERALS) {
+    for (i64 pos = 0; pos < data.size();) {
+      i64 end = data.find('\0', pos);
+      if (end == data.npos)
+        Fatal(ctx) << isec << ": string is not null terminated";
+      info.regions.push_back({(u32)pos, (u32)(end + 1 - pos), (u32)-1, false});
+      pos = end + 1;
+    }
+    return;
+  }
+
+  i64 entsize = isec.is_objc_ref_section() ? E::wordsize :
+                (isec.hdr.type == S_4BYTE_LITERALS) ? 4 :
+                (isec.hdr.type == S_8BYTE_LITERALS) ? 8 : 16;
+
+  if (data.size() % entsize)
+    Fatal(ctx) << isec << ": section size is not a multiple of " << entsize;
+
+  for (i64 pos = 0; pos < data.size(); pos += entsize)
+    info.regions.push_back({(u32)pos, (u32)entsize, (u32)-1, false});
+}
+
 template <typename E>
 static std::vector<SplitInfo<E>> split(Context<E> &ctx, ObjectFile<E> &file) {
   std::vector<SplitInfo<E>> vec;
@@ -120,7 +153,8 @@ static std::vector<SplitInfo<E>> split(Context<E> &ctx, ObjectFile<E> &file) {
 
   for (i64 i = 0; i < file.mach_syms.size(); i++) {
     MachSym &msym = file.mach_syms[i];
-    if (msym.type == N_SECT && file.sections[msym.sect - 1]) {
+    if (msym.type == N_SECT && file.sections[msym.sect - 1] &&
+        !file.sections[msym.sect - 1]->is_literal_section()) {
       SplitRegion r;
       r.offset = msym.value - file.sections[msym.sect - 1]->hdr.addr;
       r.symidx = i;
@@ -138,6 +172,11 @@ static std::vector<SplitInfo<E>> split(Context<E> &ctx, ObjectFile<E> &file) {
   for (SplitInfo<E> &info : vec) {
     std::vector<SplitRegion> &r = info.regions;
 
+    if (info.isec->is_literal_section()) {
+      split_literals(ctx, info);
+      continue;
+    }
+
     if (r.empty()) {
       r.push_back({0, (u32)info.isec->hdr.size, (u32)-1, false});
       continue;
@@ -193,6 +232,15 @@ void ObjectFile<E>::split_subsections(Context<E> &ctx) {
     }
   }
 
+  // Symbols in literal sections don't split them, so find the literals
+  // they point to.
+  for (i64 i = 0; i < mach_syms.size(); i++) {
+    MachSym &msym = mach_syms[i];
+    if (msym.type == N_SECT && sections[msym.sect - 1] &&
+        sections[msym.sect - 1]->is_literal_section())
+      sym_to_subsec[i] = find_subsection_idx(ctx, msym.value);
+  }
+
   for (i64 i = 0; i < mach_syms.size(); i++)
     if (!mach_syms[i].ext)
       override_symbol(ctx, i);
@@ -526,28 +574,67 @@ DylibFile<E> *DylibFile<E>::create(Context<E> &ctx, MappedFile<Context<E>> *mf)
   return dylib;
 };
 
+// Reads exported symbol names from an export trie. A symbol name is a
+// concatenation of edge labels from the root to a terminal node. We walk
+// the trie with an explicit stack, building the names of all nodes in a
+// single buffer, so that we don't allocate memory for each node.
 template <typename E>
-void DylibFile<E>::read_trie(Context<E> &ctx, u8 *start, i64 offset,
-                             const std::string &prefix) {
-  u8 *buf = start + offset;
-
-  if (*buf) {
-    read_uleb(buf); // size
-    read_uleb(buf); // flags
-    read_uleb(buf); // addr
-    this->syms.push_back(intern(ctx, prefix));
-  } else {
-    buf++;
-  }
+void DylibFile<E>::read_trie(Context<E> &ctx, u8 *start, i64 size) {
+  struct Entry {
+    i64 offset;
+    i64 name_begin;
+    i64 name_len;
+  };
+
+  if (size == 0)
+    return;
+
+  std::string names;
+  std::vector<std::pair<i64, i64>> exports;
+  std::vector<Entry> stack = {{0, 0, 0}};
+
+  while (!stack.empty()) {
+    Entry ent = stack.back();
+    stack.pop_back();
+
+    if (ent.offset >= size)
+      Fatal(ctx) << *this << ": corrupted export trie";
+
+    u8 *buf = start + ent.offset;
+    i64 info_size = read_uleb(buf);
+    if (info_size)
+      exports.push_back({ent.name_begin, ent.name_len});
+    buf += info_size;
 
-  i64 nchild = *buf++;
+    i64 nchild = *buf++;
+    i64 first = stack.size();
 
-  for (i64 i = 0; i < nchild; i++) {
-    std::string suffix((char *)buf);
-    buf += suffix.size() + 1;
-    i64 off = read_uleb(buf);
-    read_trie(ctx, start, off, prefix + suffix);
+    for (i64 i = 0; i < nchild; i++) {
+      std::string_view label((char *)buf);
+      buf += label.size() + 1;
+
+      i64 begin = names.size();
+      names.append(names, ent.name_begin, ent.name_len);
+      names += label;
+      i64 offset = read_uleb(buf);
+      stack.push_back({offset, begin, ent.name_len + (i64)label.size()});
+    }
+
+    // Visit children in the order they appear.
+    std::reverse(stack.begin() + first, stack.end());
   }
+
+  // Transfer the ownership of the names to the string pool and intern
+  // them. A framework can export tens of thousands of symbols, so we
+  // intern them in parallel.
+  std::string_view pool = save_string(ctx, names);
+  i64 base = this->syms.size();
+  this->syms.resize(base + exports.size());
+
+  tbb::parallel_for((i64)0, (i64)exports.size(), [&](i64 i) {
+    auto [begin, len] = exports[i];
+    this->syms[base + i] = intern(ctx, pool.substr(begin, len));
+  });
 }
 
 template <typename E>
@@ -567,12 +654,12 @@ void DylibFile<E>::parse_dylib(Context<E> &ctx) {
     case LC_DYLD_INFO_ONLY: {
       DyldInfoCommand &cmd = *(DyldInfoCommand *)p;
       if (cmd.export_off)
-        read_trie(ctx, this->mf->data + cmd.export_off);
+        read_trie(ctx, this->mf->data + cmd.export_off, cmd.export_size);
       break;
     }
     case LC_DYLD_EXPORTS_TRIE: {
       LinkEditDataCommand &cmd = *(LinkEditDataCommand *)p;
-      read_trie(ctx, this->mf->data + cmd.dataoff);
+      read_trie(ctx, this->mf->data + cmd.dataoff, cmd.datasize);
       break;
     }
     }
@@ -586,8 +673,10 @@ void DylibFile<E>::parse(Context<E> &ctx) {
   switch (get_file_type(this->mf)) {
   case FileType::TAPI: {
     TextDylib tbd = parse_tbd(ctx, this->mf);
-    for (std::string_view sym : tbd.exports)
-      this->syms.push_back(intern(ctx, sym));
+    this->syms.resize(tbd.exports.size());
+    tbb::parallel_for((i64)0, (i64)tbd.exports.size(), [&](i64 i) {
+      this->syms[i] = intern(ctx, tbd.exports[i]);
+    });
     install_name = tbd.install_name;
     break;
   }
@@ -2,6 +2,9 @@
 
 #include <shared_mutex>
 #include <sys/mman.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_sort.h>
 
 #ifdef __APPLE__
 #  define COMMON_DIGEST_FOR_OPENSSL
@@ -53,6 +56,30 @@ static std::vector<u8> create_dyld_info_only_cmd(Context<E> &ctx) {
   return buf;
 }
 
+template <typename E>
+static std::vector<u8> create_chained_fixups_cmd(Context<E> &ctx) {
+  std::vector<u8> buf(sizeof(LinkEditDataCommand));
+  LinkEditDataCommand &cmd = *(LinkEditDataCommand *)buf.data();
+
+  cmd.cmd = LC_DYLD_CHAINED_FIXUPS;
+  cmd.cmdsize = buf.size();
+  cmd.dataoff = ctx.chained_fixups.hdr.offset;
+  cmd.datasize = ctx.chained_fixups.hdr.size;
+  return buf;
+}
+
+template <typename E>
+static std::vector<u8> create_exports_trie_cmd(Context<E> &ctx) {
+  std::vector<u8> buf(sizeof(LinkEditDataCommand));
+  LinkEditDataCommand &cmd = *(LinkEditDataCommand *)buf.data();
+
+  cmd.cmd = LC_DYLD_EXPORTS_TRIE;
+  cmd.cmdsize = buf.size();
+  cmd.dataoff = ctx.export_.hdr.offset;
+  cmd.datasize = ctx.export_.hdr.size;
+  return buf;
+}
+
 template <typename E>
 static std::vector<u8> create_symtab_cmd(Context<E> &ctx) {
   std::vector<u8> buf(sizeof(SymtabCommand));
@@ -268,7 +295,12 @@ static std::pair<i64, std::vector<u8>> create_load_commands(Context<E> &ctx) {
     }
   }
 
-  vec.push_back(create_dyld_info_only_cmd(ctx));
+  if (ctx.arg.fixup_chains) {
+    vec.push_back(create_chained_fixups_cmd(ctx));
+    vec.push_back(create_exports_trie_cmd(ctx));
+  } else {
+    vec.push_back(create_dyld_info_only_cmd(ctx));
+  }
   vec.push_back(create_symtab_cmd(ctx));
   vec.push_back(create_dysymtab_cmd(ctx));
   vec.push_back(create_uuid_cmd(ctx));
@@ -338,6 +370,9 @@ void OutputMachHeader<E>::copy_buf(Context<E> &ctx) {
   mhdr.sizeofcmds = cmds.size();
   mhdr.flags = MH_TWOLEVEL | MH_NOUNDEFS | MH_DYLDLINK | MH_PIE;
 
+  if (ctx.arg.bind_at_load)
+    mhdr.flags |= MH_BINDATLOAD;
+
   if (has_tlv(ctx))
     mhdr.flags |= MH_HAS_TLV_DESCRIPTORS;
 
@@ -381,6 +416,11 @@ OutputSection<E>::get_instance(Context<E> &ctx, std::string_view segname,
 
 template <typename E>
 void OutputSection<E>::compute_size(Context<E> &ctx) {
+  if constexpr (std::is_same_v<E, ARM64>)
+    if ((this->hdr.attr & S_ATTR_SOME_INSTRUCTIONS) &&
+        create_range_extension_thunks(ctx, *this))
+      return;
+
   u64 addr = this->hdr.addr;
 
   if (this == ctx.data) {
@@ -402,12 +442,18 @@ void OutputSection<E>::copy_buf(Context<E> &ctx) {
   u8 *buf = ctx.buf + this->hdr.offset;
   assert(this->hdr.type != S_ZEROFILL);
 
-  for (Subsection<E> *subsec : members) {
+  tbb::parallel_for_each(members, [&](Subsection<E> *subsec) {
     std::string_view data = subsec->get_contents();
     u8 *loc = buf + subsec->get_addr(ctx) - this->hdr.addr;
     memcpy(loc, data.data(), data.size());
     subsec->apply_reloc(ctx, loc);
-  }
+  });
+
+  if constexpr (std::is_same_v<E, ARM64>)
+    tbb::parallel_for_each(thunks,
+                           [&](std::unique_ptr<RangeExtensionThunk<E>> &thunk) {
+      thunk->copy_buf(ctx);
+    });
 }
 
 template <typename E>
@@ -460,6 +506,21 @@ void OutputSegment<E>::set_offset(Context<E> &ctx, i64 fileoff, u64 vmaddr) {
   cmd.fileoff = fileoff;
   cmd.vmaddr = vmaddr;
 
+  // __LINKEDIT is laid out after all other segments, so the contents of
+  // its chunks are fixed at this point. Most of them are independent of
+  // each other, so we run their encoders concurrently. The string table
+  // and the indirect symbol table depend on the symbol table, and the
+  // size of the code signature depends on its offset.
+  auto is_precomputed = [&](Chunk<E> *chunk) {
+    return this == ctx.linkedit_seg && chunk != &ctx.strtab &&
+           chunk != &ctx.indir_symtab && chunk != &ctx.code_sig;
+  };
+
+  tbb::parallel_for_each(chunks, [&](Chunk<E> *chunk) {
+    if (is_precomputed(chunk))
+      chunk->compute_size(ctx);
+  });
+
   i64 i = 0;
 
   while (i < chunks.size() && chunks[i]->hdr.type != S_ZEROFILL) {
@@ -470,7 +531,8 @@ void OutputSegment<E>::set_offset(Context<E> &ctx, i64 fileoff, u64 vmaddr) {
     sec.hdr.offset = fileoff;
     sec.hdr.addr = vmaddr;
 
-    sec.compute_size(ctx);
+    if (!is_precomputed(&sec))
+      sec.compute_size(ctx);
     fileoff += sec.hdr.size;
     vmaddr += sec.hdr.size;
   }
@@ -492,19 +554,13 @@ void OutputSegment<E>::set_offset(Context<E> &ctx, i64 fileoff, u64 vmaddr) {
     cmd.filesize = align_to(fileoff - cmd.fileoff, PAGE_SIZE);
 }
 
+// Chunks are written on top of this, so this must be called before
+// copying chunks of this segment.
 template <typename E>
-void OutputSegment<E>::copy_buf(Context<E> &ctx) {
+void OutputSegment<E>::write_padding(Context<E> &ctx) {
   // Fill text segment paddings with NOPs
   if (cmd.get_segname() == "__TEXT")
     memset(ctx.buf + cmd.fileoff, 0x90, cmd.filesize);
-
-  for (Chunk<E> *sec : chunks)
-    if (sec->hdr.type != S_ZEROFILL)
-      sec->copy_buf(ctx);
-}
-
-RebaseEncoder::RebaseEncoder() {
-  buf.push_back(REBASE_OPCODE_SET_TYPE_IMM | REBASE_TYPE_POINTER);
 }
 
 void RebaseEncoder::add(i64 seg_idx, i64 offset) {
@@ -555,41 +611,81 @@ void RebaseEncoder::flush() {
   times = 0;
 }
 
-void RebaseEncoder::finish() {
-  flush();
-  buf.push_back(REBASE_OPCODE_DONE);
-}
-
 template <typename E>
-void OutputRebaseSection<E>::compute_size(Context<E> &ctx) {
-  RebaseEncoder enc;
+static std::vector<RebaseEntry> get_rebase_entries(Context<E> &ctx) {
+  std::vector<RebaseEntry> vec;
 
-  for (i64 i = 0; i < ctx.stubs.syms.size(); i++)
-    enc.add(ctx.data_seg->seg_idx,
-            ctx.lazy_symbol_ptr.hdr.addr + i * E::wordsize -
-            ctx.data_seg->cmd.vmaddr);
+  // With -fixup_chains or -bind_at_load, lazy symbol pointers are
+  // bound at load time instead of pointing to the stub helper.
+  if (!ctx.arg.fixup_chains && !ctx.arg.bind_at_load)
+    for (i64 i = 0; i < ctx.stubs.syms.size(); i++)
+      vec.push_back({ctx.data_seg->seg_idx,
+                     ctx.lazy_symbol_ptr.hdr.addr + i * E::wordsize -
+                     ctx.data_seg->cmd.vmaddr});
 
   for (Symbol<E> *sym : ctx.got.syms)
     if (!sym->file->is_dylib)
-      enc.add(ctx.data_const_seg->seg_idx,
-              sym->get_got_addr(ctx) - ctx.data_const_seg->cmd.vmaddr);
+      vec.push_back({ctx.data_const_seg->seg_idx,
+                     sym->get_got_addr(ctx) - ctx.data_const_seg->cmd.vmaddr});
 
   for (Symbol<E> *sym : ctx.thread_ptrs.syms)
     if (!sym->file->is_dylib)
-      enc.add(ctx.data_seg->seg_idx,
-              sym->get_tlv_addr(ctx) - ctx.data_seg->cmd.vmaddr);
+      vec.push_back({ctx.data_seg->seg_idx,
+                     sym->get_tlv_addr(ctx) - ctx.data_seg->cmd.vmaddr});
 
+  // Collect base relocations of regular output sections in parallel
+  std::vector<std::pair<OutputSegment<E> *, OutputSection<E> *>> osecs;
   for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments)
     for (Chunk<E> *chunk : seg->chunks)
       if (chunk->is_regular)
-        for (Subsection<E> *subsec : ((OutputSection<E> *)chunk)->members)
-          for (Relocation<E> &rel : subsec->get_rels())
-            if (!rel.is_pcrel && rel.type == E::abs_rel)
-              enc.add(seg->seg_idx,
-                      subsec->get_addr(ctx) + rel.offset - seg->cmd.vmaddr);
+        osecs.push_back({seg.get(), (OutputSection<E> *)chunk});
+
+  std::vector<std::vector<RebaseEntry>> entries(osecs.size());
+
+  tbb::parallel_for((i64)0, (i64)osecs.size(), [&](i64 i) {
+    auto [seg, osec] = osecs[i];
+    for (Subsection<E> *subsec : osec->members)
+      for (Relocation<E> &rel : subsec->get_rels())
+        if (!rel.is_pcrel && rel.type == E::abs_rel)
+          entries[i].push_back({seg->seg_idx,
+                                subsec->get_addr(ctx) + rel.offset -
+                                seg->cmd.vmaddr});
+  });
 
-  enc.finish();
-  contents = std::move(enc.buf);
+  append(vec, flatten(entries));
+  return vec;
+}
+
+// Base relocations are sorted by address and then encoded in
+// fixed-size runs in parallel. Each run starts with a
+// REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB opcode, so it doesn't
+// depend on the state at the end of the preceding run, and the
+// resulting runs can simply be concatenated.
+template <typename E>
+void OutputRebaseSection<E>::compute_size(Context<E> &ctx) {
+  std::vector<RebaseEntry> entries = get_rebase_entries(ctx);
+
+  tbb::parallel_sort(entries.begin(), entries.end(),
+                     [](const RebaseEntry &a, const RebaseEntry &b) {
+    return std::tuple(a.seg_idx, a.offset) < std::tuple(b.seg_idx, b.offset);
+  });
+
+  constexpr i64 run_size = 1 << 16;
+  std::vector<std::vector<u8>> runs((entries.size() + run_size - 1) / run_size);
+
+  tbb::parallel_for((i64)0, (i64)runs.size(), [&](i64 i) {
+    RebaseEncoder enc;
+    i64 end = std::min<i64>((i + 1) * run_size, entries.size());
+    for (i64 j = i * run_size; j < end; j++)
+      enc.add(entries[j].seg_idx, entries[j].offset);
+    enc.flush();
+    runs[i] = std::move(enc.buf);
+  });
+
+  contents.clear();
+  contents.push_back(REBASE_OPCODE_SET_TYPE_IMM | REBASE_TYPE_POINTER);
+  append(contents, flatten(runs));
+  contents.push_back(REBASE_OPCODE_DONE);
   this->hdr.size = align_to(contents.size(), 8);
 }
 
@@ -643,6 +739,13 @@ template <typename E>
 void OutputBindSection<E>::compute_size(Context<E> &ctx) {
   BindEncoder enc;
 
+  if (ctx.arg.bind_at_load)
+    for (Symbol<E> *sym : ctx.stubs.syms)
+      enc.add(((DylibFile<E> *)sym->file)->dylib_idx, sym->name, 0,
+              ctx.data_seg->seg_idx,
+              ctx.lazy_symbol_ptr.hdr.addr + sym->stub_idx * E::wordsize -
+              ctx.data_seg->cmd.vmaddr);
+
   for (Symbol<E> *sym : ctx.got.syms)
     if (sym->file->is_dylib)
       enc.add(((DylibFile<E> *)sym->file)->dylib_idx, sym->name, 0,
@@ -714,68 +817,323 @@ void OutputLazyBindSection<E>::copy_buf(Context<E> &ctx) {
   write_vector(ctx.buf + this->hdr.offset, contents);
 }
 
+template <typename E>
+void ChainedFixupsSection<E>::compute_size(Context<E> &ctx) {
+  fixups.clear();
+  contents.clear();
+
+  for (RebaseEntry &ent : get_rebase_entries(ctx))
+    fixups.push_back({ctx.segments[ent.seg_idx - 1]->cmd.vmaddr + ent.offset,
+                      -1});
+
+  // Create the import table
+  std::vector<Symbol<E> *> imports;
+  std::unordered_map<Symbol<E> *, i32> import_idx;
+
+  auto add_bind = [&](Symbol<E> *sym, u64 addr) {
+    auto [it, inserted] = import_idx.insert({sym, imports.size()});
+    if (inserted)
+      imports.push_back(sym);
+    fixups.push_back({addr, it->second});
+  };
+
+  for (i64 i = 0; i < ctx.stubs.syms.size(); i++)
+    add_bind(ctx.stubs.syms[i],
+             ctx.lazy_symbol_ptr.hdr.addr + i * E::wordsize);
+
+  for (Symbol<E> *sym : ctx.got.syms)
+    if (sym->file->is_dylib)
+      add_bind(sym, sym->get_got_addr(ctx));
+
+  for (Symbol<E> *sym : ctx.thread_ptrs.syms)
+    if (sym->file->is_dylib)
+      add_bind(sym, sym->get_tlv_addr(ctx));
+
+  tbb::parallel_sort(fixups.begin(), fixups.end(),
+                     [](const Fixup &a, const Fixup &b) {
+    return a.addr < b.addr;
+  });
+
+  // A chained fixup has to be 4-byte aligned and can't span two pages
+  // because dyld walks the fixups in each page independently.
+  for (Fixup &fix : fixups)
+    if (fix.addr % 4 || fix.addr % PAGE_SIZE + E::wordsize > PAGE_SIZE)
+      Fatal(ctx) << "-fixup_chains: unsupported pointer location: 0x"
+                 << std::hex << fix.addr;
+
+  auto append_bytes = [&](auto val) {
+    i64 off = contents.size();
+    contents.resize(off + sizeof(val));
+    memcpy(contents.data() + off, &val, sizeof(val));
+    return off;
+  };
+
+  auto align = [&](i64 alignment) {
+    contents.resize(align_to(contents.size(), alignment));
+  };
+
+  // Write the header
+  i64 hdr_off = append_bytes(ChainedFixupsHeader{});
+
+  // Write the starts-in-image table. Segment indices are load command
+  // indices, which include __PAGEZERO.
+  i64 num_segs = ctx.segments.size() + (ctx.arg.pagezero_size ? 1 : 0);
+  align(8);
+  i64 starts_off = contents.size();
+  append_bytes((u32)num_segs);
+  i64 seg_info_off = contents.size();
+  contents.resize(contents.size() + num_segs * 4);
+
+  for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments) {
+    std::span<Fixup> vec = get_fixups(*seg);
+    if (vec.empty())
+      continue;
+
+    i64 page_count = seg->cmd.vmsize / PAGE_SIZE;
+    if (page_count > 0xffff)
+      Fatal(ctx) << "-fixup_chains: segment is too large: "
+                 << seg->cmd.get_segname();
+
+    align(8);
+    i64 seg_idx = seg->seg_idx - (ctx.arg.pagezero_size ? 0 : 1);
+    u32 off = contents.size() - starts_off;
+    memcpy(contents.data() + seg_info_off + seg_idx * 4, &off, 4);
+
+    i64 size = offsetof(ChainedStartsInSegment, page_start) + page_count * 2;
+    i64 pos = contents.size();
+    contents.resize(pos + align_to(size, 8));
+
+    ChainedStartsInSegment &rec =
+      *(ChainedStartsInSegment *)(contents.data() + pos);
+    rec.size = size;
+    rec.page_size = PAGE_SIZE;
+    rec.pointer_format = DYLD_CHAINED_PTR_64_OFFSET;
+    rec.segment_offset = seg->cmd.vmaddr - ctx.arg.pagezero_size;
+    rec.max_valid_pointer = 0;
+    rec.page_count = page_count;
+
+    for (i64 i = 0; i < page_count; i++)
+      rec.page_start[i] = DYLD_CHAINED_PTR_START_NONE;
+
+    for (Fixup &fix : vec) {
+      i64 i = (fix.addr - seg->cmd.vmaddr) / PAGE_SIZE;
+      if (rec.page_start[i] == DYLD_CHAINED_PTR_START_NONE)
+        rec.page_start[i] = (fix.addr - seg->cmd.vmaddr) % PAGE_SIZE;
+    }
+  }
+
+  // Write the import table and the symbol names
+  align(4);
+  i64 imports_off = contents.size();
+  contents.resize(contents.size() + imports.size() * sizeof(ChainedImport));
+
+  i64 symbols_off = contents.size();
+  contents.push_back('\0');
+
+  for (i64 i = 0; i < imports.size(); i++) {
+    Symbol<E> &sym = *imports[i];
+    i64 dylib_idx = ((DylibFile<E> *)sym.file)->dylib_idx;
+    i64 name_off = contents.size() - symbols_off;
+
+    if (dylib_idx > 0xff)
+      Fatal(ctx) << "-fixup_chains: too many dylibs";
+    if (name_off >= (1 << 23))
+      Fatal(ctx) << "-fixup_chains: too many imported symbols";
+
+    ChainedImport imp = {};
+    imp.lib_ordinal = dylib_idx;
+    imp.name_offset = name_off;
+    memcpy(contents.data() + imports_off + i * sizeof(imp), &imp, sizeof(imp));
+
+    contents.insert(contents.end(), (u8 *)sym.name.data(),
+                    (u8 *)(sym.name.data() + sym.name.size()));
+    contents.push_back('\0');
+  }
+
+  ChainedFixupsHeader &hdr =
+    *(ChainedFixupsHeader *)(contents.data() + hdr_off);
+  hdr.fixups_version = 0;
+  hdr.starts_offset = starts_off;
+  hdr.imports_offset = imports_off;
+  hdr.symbols_offset = symbols_off;
+  hdr.imports_count = imports.size();
+  hdr.imports_format = DYLD_CHAINED_IMPORT;
+  hdr.symbols_format = 0;
+
+  this->hdr.size = align_to(contents.size(), 8);
+}
+
+template <typename E>
+std::span<typename ChainedFixupsSection<E>::Fixup>
+ChainedFixupsSection<E>::get_fixups(OutputSegment<E> &seg) {
+  auto less = [](const Fixup &fix, u64 addr) { return fix.addr < addr; };
+  auto begin = std::lower_bound(fixups.begin(), fixups.end(),
+                                seg.cmd.vmaddr, less);
+  auto end = std::lower_bound(begin, fixups.end(),
+                              seg.cmd.vmaddr + seg.cmd.vmsize, less);
+  return {begin, end};
+}
+
+template <typename E>
+void ChainedFixupsSection<E>::copy_buf(Context<E> &ctx) {
+  write_vector(ctx.buf + this->hdr.offset, contents);
+}
+
+// Overwrites pointers in a given segment with chained fixups. This is
+// called after the segment is copied to the output buffer. Since each
+// chain is confined to one page, pages are processed in parallel.
+template <typename E>
+void ChainedFixupsSection<E>::write_fixups(Context<E> &ctx,
+                                           OutputSegment<E> &seg) {
+  std::span<Fixup> vec = get_fixups(seg);
+  if (vec.empty())
+    return;
+
+  u8 *base = ctx.buf + seg.cmd.fileoff;
+  i64 page_count = seg.cmd.vmsize / PAGE_SIZE;
+
+  tbb::parallel_for((i64)0, page_count, [&](i64 i) {
+    auto less = [](const Fixup &fix, u64 addr) { return fix.addr < addr; };
+    u64 page_addr = seg.cmd.vmaddr + i * PAGE_SIZE;
+    auto begin = std::lower_bound(vec.begin(), vec.end(), page_addr, less);
+    auto end = std::lower_bound(begin, vec.end(), page_addr + PAGE_SIZE, less);
+
+    for (auto it = begin; it != end; it++) {
+      u64 next = (it + 1 == end) ? 0 : ((it + 1)->addr - it->addr) / 4;
+      u64 *loc = (u64 *)(base + it->addr - seg.cmd.vmaddr);
+      assert(it->addr - seg.cmd.vmaddr < seg.cmd.filesize);
+
+      if (it->import_idx == -1) {
+        // Rebase: the pointer has been set to an absolute address.
+        u64 target = *loc - ctx.arg.pagezero_size;
+        *loc = (target & ((1LL << 36) - 1)) | ((*loc >> 56) << 36) |
+               (next << 51);
+      } else {
+        // Bind
+        *loc = (u64)it->import_idx | (next << 51) | (1ULL << 63);
+      }
+    }
+  });
+}
+
 void ExportEncoder::add(std::string_view name, u32 flags, u64 addr) {
   entries.push_back({name, flags, addr});
 }
 
+// Builds an export trie. Entries are sorted first, so entries sharing
+// a prefix form a contiguous range. Subtrees of the root's children
+// are independent of each other, so they are constructed in parallel
+// and then concatenated into one array.
 i64 ExportEncoder::finish() {
-  sort(entries, [](const Entry &a, const Entry &b) {
+  tbb::parallel_sort(entries.begin(), entries.end(),
+                     [](const Entry &a, const Entry &b) {
     return a.name < b.name;
   });
 
-  TrieNode trie = construct_trie(entries, 0);
+  std::vector<std::span<Entry>> groups = split_entries(entries, 0);
+  std::vector<std::vector<TrieNode>> subtrees(groups.size());
 
-  if (trie.prefix.empty())
-    root = std::move(trie);
-  else
-    root.children.push_back(std::move(trie));
+  tbb::parallel_for((i64)0, (i64)groups.size(), [&](i64 i) {
+    subtrees[i].resize(1);
+    construct_trie(subtrees[i], 0, groups[i], 0);
+  });
 
-  i64 size = set_offset(root, 0);
-  for (;;) {
-    i64 sz = set_offset(root, 0);
-    if (sz == size)
-      return sz;
-    size = sz;
-  }
-}
+  // The root is followed by its children and then by the other nodes
+  // of each subtree. Fix up child indices accordingly.
+  nodes.resize(1 + groups.size());
+  nodes[0].children = 1;
+  nodes[0].num_children = groups.size();
 
-i64 ExportEncoder::common_prefix_len(std::span<Entry> entries, i64 len) {
-  for (; len < entries[0].name.size(); len++)
-    for (Entry &ent : entries.subspan(1))
-      if (ent.name.size() == len || ent.name[len] != entries[0].name[len])
-        return len;
-  return len;
-}
+  for (i64 i = 0; i < subtrees.size(); i++) {
+    i64 base = nodes.size() - 1;
+    for (TrieNode &node : subtrees[i])
+      if (node.num_children)
+        node.children += base;
 
-ExportEncoder::TrieNode
-ExportEncoder::construct_trie(std::span<Entry> entries, i64 len) {
-  TrieNode node;
+    nodes[i + 1] = subtrees[i][0];
+    nodes.insert(nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+  }
 
-  i64 new_len = common_prefix_len(entries, len);
-  if (new_len > len) {
-    node.prefix = entries[0].name.substr(len, new_len - len);
-    if (entries[0].name.size() == new_len) {
-      node.is_leaf = true;
-      node.flags = entries[0].flags;
-      node.addr = entries[0].addr;
-      entries = entries.subspan(1);
+  // Nodes are written in the array order. The size of a node depends
+  // on the ULEB-encoded offsets of its children, so we repeat assigning
+  // offsets until they become stable. Since offsets never decrease,
+  // this converges after a few passes.
+  std::vector<i64> sizes(nodes.size());
+
+  for (;;) {
+    tbb::parallel_for((i64)0, (i64)nodes.size(), [&](i64 i) {
+      sizes[i] = get_node_size(nodes[i]);
+    });
+
+    bool changed = false;
+    i64 offset = 0;
+    for (i64 i = 0; i < nodes.size(); i++) {
+      if (nodes[i].offset != offset) {
+        nodes[i].offset = offset;
+        changed = true;
+      }
+      offset += sizes[i];
     }
+
+    if (!changed)
+      return offset;
   }
+}
+
+// Splits sorted entries into groups by the character at a given
+// position. Entries in the same group share a common prefix.
+std::vector<std::span<ExportEncoder::Entry>>
+ExportEncoder::split_entries(std::span<Entry> entries, i64 len) {
+  std::vector<std::span<Entry>> vec;
 
   for (i64 i = 0; i < entries.size();) {
     i64 j = i + 1;
-    u8 c = entries[i].name[new_len];
-    while (j < entries.size() && c == entries[j].name[new_len])
+    u8 c = entries[i].name[len];
+    while (j < entries.size() && c == entries[j].name[len])
       j++;
-    node.children.push_back(construct_trie(entries.subspan(i, j - i), new_len));
+    vec.push_back(entries.subspan(i, j - i));
     i = j;
   }
-  return node;
+  return vec;
 }
 
-i64 ExportEncoder::set_offset(TrieNode &node, i64 offset) {
-  node.offset = offset;
+void ExportEncoder::construct_trie(std::vector<TrieNode> &nodes, i64 idx,
+                                   std::span<Entry> entries, i64 len) {
+  // Since entries are sorted, the common prefix of all entries is
+  // the same as the one of the first and the last entries.
+  std::string_view first = entries.front().name;
+  std::string_view last = entries.back().name;
+  i64 new_len = len;
+  while (new_len < first.size() && new_len < last.size() &&
+         first[new_len] == last[new_len])
+    new_len++;
+
+  TrieNode &node = nodes[idx];
+  node.prefix = first.substr(len, new_len - len);
+
+  if (first.size() == new_len) {
+    node.is_leaf = true;
+    node.flags = entries[0].flags;
+    node.addr = entries[0].addr;
+    entries = entries.subspan(1);
+  }
+
+  if (entries.empty())
+    return;
+
+  std::vector<std::span<Entry>> groups = split_entries(entries, new_len);
+
+  // `node` may be invalidated by resize()
+  i64 children = nodes.size();
+  nodes[idx].children = children;
+  nodes[idx].num_children = groups.size();
+  nodes.resize(children + groups.size());
+
+  for (i64 i = 0; i < groups.size(); i++)
+    construct_trie(nodes, children + i, groups[i], new_len);
+}
 
+i64 ExportEncoder::get_node_size(TrieNode &node) {
   i64 size = 0;
   if (node.is_leaf) {
     size = uleb_size(node.flags) + uleb_size(node.addr);
@@ -786,36 +1144,35 @@ i64 ExportEncoder::set_offset(TrieNode &node, i64 offset) {
 
   size++; // # of children
 
-  for (TrieNode &child : node.children) {
+  for (i64 i = 0; i < node.num_children; i++) {
+    TrieNode &child = nodes[node.children + i];
     // +1 for NUL byte
     size += child.prefix.size() + 1 + uleb_size(child.offset);
   }
-
-  for (TrieNode &child : node.children)
-    size += set_offset(child, offset + size);
   return size;
 }
 
-void ExportEncoder::write_trie(u8 *start, TrieNode &node) {
-  u8 *buf = start + node.offset;
-
-  if (node.is_leaf) {
-    buf += write_uleb(buf, uleb_size(node.flags) + uleb_size(node.addr));
-    buf += write_uleb(buf, node.flags);
-    buf += write_uleb(buf, node.addr);
-  } else {
-    *buf++ = 0;
-  }
+void ExportEncoder::write_trie(u8 *start) {
+  tbb::parallel_for((i64)0, (i64)nodes.size(), [&](i64 i) {
+    TrieNode &node = nodes[i];
+    u8 *buf = start + node.offset;
 
-  *buf++ = node.children.size();
+    if (node.is_leaf) {
+      buf += write_uleb(buf, uleb_size(node.flags) + uleb_size(node.addr));
+      buf += write_uleb(buf, node.flags);
+      buf += write_uleb(buf, node.addr);
+    } else {
+      *buf++ = 0;
+    }
 
-  for (TrieNode &child : node.children) {
-    buf += write_string(buf, child.prefix);
-    buf += write_uleb(buf, child.offset);
-  }
+    *buf++ = node.num_children;
 
-  for (TrieNode &child : node.children)
-    write_trie(start, child);
+    for (i64 j = 0; j < node.num_children; j++) {
+      TrieNode &child = nodes[node.children + j];
+      buf += write_string(buf, child.prefix);
+      buf += write_uleb(buf, child.offset);
+    }
+  });
 }
 
 template <typename E>
@@ -833,30 +1190,48 @@ void OutputExportSection<E>::copy_buf(Context<E> &ctx) {
   enc.write_trie(ctx.buf + this->hdr.offset);
 }
 
+// Function starts are a ULEB128-encoded stream of deltas between sorted
+// function addresses. We collect and sort addresses in parallel and then
+// encode fixed-size blocks of them independently. Each block needs only
+// the last address of the previous block, so blocks can be encoded
+// concurrently and concatenated.
 template <typename E>
 void OutputFunctionStartsSection<E>::compute_size(Context<E> &ctx) {
-  std::vector<u64> addrs;
+  std::vector<std::vector<u64>> vec(ctx.objs.size());
 
-  for (ObjectFile<E> *file : ctx.objs)
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
     for (Symbol<E> *sym : file->syms)
       if (sym && sym->file == file && sym->subsec &&
           &sym->subsec->isec.osec == ctx.text)
-        addrs.push_back(sym->get_addr(ctx));
+        vec[i].push_back(sym->get_addr(ctx));
+  });
 
-  std::sort(addrs.begin(), addrs.end());
+  std::vector<u64> addrs = flatten(vec);
+  tbb::parallel_sort(addrs.begin(), addrs.end());
 
-  contents.resize(addrs.size() * 5);
+  constexpr i64 block_size = 1 << 16;
+  std::vector<std::vector<u8>> blocks((addrs.size() + block_size - 1) /
+                                      block_size);
 
-  u8 *p = contents.data();
-  u64 last = ctx.arg.pagezero_size;
+  tbb::parallel_for((i64)0, (i64)blocks.size(), [&](i64 i) {
+    i64 begin = i * block_size;
+    i64 end = std::min<i64>(begin + block_size, addrs.size());
+    u64 last = (i == 0) ? ctx.arg.pagezero_size : addrs[begin - 1];
 
-  for (u64 val : addrs) {
-    p += write_uleb(p, val - last);
-    last = val;
-  }
+    std::vector<u8> &buf = blocks[i];
+    buf.resize((end - begin) * 10);
+    u8 *p = buf.data();
+
+    for (i64 j = begin; j < end; j++) {
+      p += write_uleb(p, addrs[j] - last);
+      last = addrs[j];
+    }
+    buf.resize(p - buf.data());
+  });
 
-  this->hdr.size = p - contents.data();
-  contents.resize(this->hdr.size);
+  contents = flatten(blocks);
+  this->hdr.size = contents.size();
 }
 
 template <typename E>
@@ -864,40 +1239,85 @@ void OutputFunctionStartsSection<E>::copy_buf(Context<E> &ctx) {
   write_vector(ctx.buf + this->hdr.offset, contents);
 }
 
+// Symbols and their names are laid out file by file. We count symbols
+// and string bytes for each file in parallel and then assign each file
+// its first symbol index and string table offset by prefix sum, so
+// that copy_buf() can write all files concurrently.
 template <typename E>
 void OutputSymtabSection<E>::compute_size(Context<E> &ctx) {
+  std::vector<InputFile<E> *> files;
   for (ObjectFile<E> *file : ctx.objs)
-    for (Symbol<E> *sym : file->syms)
-      if (sym && sym->file == file)
-        globals.push_back({sym, ctx.strtab.add_string(sym->name)});
+    files.push_back(file);
+  for (DylibFile<E> *dylib : ctx.dylibs)
+    files.push_back(dylib);
+
+  auto is_output = [](InputFile<E> *file, Symbol<E> *sym) {
+    if (!sym || sym->file != file)
+      return false;
+    if (file->is_dylib)
+      return sym->stub_idx != -1 || sym->got_idx != -1;
+    return true;
+  };
+
+  std::vector<i64> num_syms(files.size());
+  std::vector<i64> strtab_size(files.size());
+
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    for (Symbol<E> *sym : files[i]->syms) {
+      if (is_output(files[i], sym)) {
+        num_syms[i]++;
+        strtab_size[i] += sym->name.size() + 1;
+      }
+    }
+  });
 
-  i64 idx = globals.size();
+  std::vector<i64> sym_offsets(files.size() + 1);
+  std::vector<i64> str_offsets(files.size() + 1);
+  str_offsets[0] = ctx.strtab.contents_size;
 
-  for (DylibFile<E> *dylib : ctx.dylibs) {
-    for (Symbol<E> *sym : dylib->syms) {
-      if (sym && sym->file == dylib &&
-          (sym->stub_idx != -1 || sym->got_idx != -1)) {
-        undefs.push_back({sym, ctx.strtab.add_string(sym->name)});
+  for (i64 i = 0; i < files.size(); i++) {
+    sym_offsets[i + 1] = sym_offsets[i] + num_syms[i];
+    str_offsets[i + 1] = str_offsets[i] + strtab_size[i];
+  }
+
+  i64 num_globals = sym_offsets[ctx.objs.size()];
+  globals.resize(num_globals);
+  undefs.resize(sym_offsets.back() - num_globals);
 
-        if (sym->stub_idx != -1)
-          ctx.indir_symtab.stubs.push_back({sym, idx});
-        else
-          ctx.indir_symtab.gots.push_back({sym, idx});
+  tbb::parallel_for((i64)0, (i64)files.size(), [&](i64 i) {
+    i64 idx = sym_offsets[i];
+    i64 stroff = str_offsets[i];
+
+    for (Symbol<E> *sym : files[i]->syms) {
+      if (is_output(files[i], sym)) {
+        Entry &ent = (idx < num_globals) ? globals[idx] : undefs[idx - num_globals];
+        ent = {sym, stroff};
         idx++;
+        stroff += sym->name.size() + 1;
       }
     }
+  });
+
+  for (i64 i = 0; i < undefs.size(); i++) {
+    Symbol<E> *sym = undefs[i].sym;
+    if (sym->stub_idx != -1)
+      ctx.indir_symtab.stubs.push_back({sym, num_globals + i});
+    else
+      ctx.indir_symtab.gots.push_back({sym, num_globals + i});
   }
 
-  this->hdr.size = idx * sizeof(MachSym);
+  ctx.strtab.contents_size = str_offsets.back();
+  this->hdr.size = sym_offsets.back() * sizeof(MachSym);
 }
 
 template <typename E>
 void OutputSymtabSection<E>::copy_buf(Context<E> &ctx) {
   MachSym *buf = (MachSym *)(ctx.buf + this->hdr.offset);
+  u8 *strtab = ctx.buf + ctx.strtab.hdr.offset;
   memset(buf, 0, this->hdr.size);
 
-  auto write = [&](Entry &ent) {
-    MachSym &msym = *buf++;
+  auto write = [&](Entry &ent, i64 idx) {
+    MachSym &msym = buf[idx];
     Symbol<E> &sym = *ent.sym;
 
     msym.stroff = ent.stroff;
@@ -913,32 +1333,38 @@ void OutputSymtabSection<E>::copy_buf(Context<E> &ctx) {
       msym.desc = ((DylibFile<E> *)sym.file)->dylib_idx << 8;
     else if (sym.referenced_dynamically)
       msym.desc = REFERENCED_DYNAMICALLY;
+
+    write_string(strtab + ent.stroff, sym.name);
   };
 
-  for (Entry &ent : locals)
-    write(ent);
-  for (Entry &ent : globals)
-    write(ent);
-  for (Entry &ent : undefs)
-    write(ent);
-}
+  i64 num_locals = locals.size();
+  i64 num_globals = globals.size();
 
-template <typename E>
-i64 OutputStrtabSection<E>::add_string(std::string_view str) {
-  i64 off = contents.size();
-  contents += str;
-  contents += '\0';
-  return off;
+  tbb::parallel_for((i64)0, num_locals, [&](i64 i) {
+    write(locals[i], i);
+  });
+
+  tbb::parallel_for((i64)0, num_globals, [&](i64 i) {
+    write(globals[i], num_locals + i);
+  });
+
+  tbb::parallel_for((i64)0, (i64)undefs.size(), [&](i64 i) {
+    write(undefs[i], num_locals + num_globals + i);
+  });
 }
 
 template <typename E>
 void OutputStrtabSection<E>::compute_size(Context<E> &ctx) {
-  this->hdr.size = align_to(contents.size(), 1 << this->hdr.p2align);
+  this->hdr.size = align_to(contents_size, 1 << this->hdr.p2align);
 }
 
+// Symbol names are written by OutputSymtabSection::copy_buf(). We only
+// need to write the leading null byte and clear the trailing padding.
 template <typename E>
 void OutputStrtabSection<E>::copy_buf(Context<E> &ctx) {
-  memcpy(ctx.buf + this->hdr.offset, &contents[0], contents.size());
+  u8 *buf = ctx.buf + this->hdr.offset;
+  buf[0] = '\0';
+  memset(buf + contents_size, 0, this->hdr.size - contents_size);
 }
 
 template <typename E>
@@ -969,13 +1395,98 @@ void OutputIndirectSymtabSection<E>::copy_buf(Context<E> &ctx) {
 
 template <typename E>
 void CodeSignatureSection<E>::compute_size(Context<E> &ctx) {
+  i64 num_blocks = align_to(this->hdr.offset, BLOCK_SIZE) / BLOCK_SIZE;
+  this->hdr.size = get_hashes_offset(ctx) + num_blocks * SHA256_SIZE;
+}
+
+template <typename E>
+i64 CodeSignatureSection<E>::get_hashes_offset(Context<E> &ctx) {
   i64 filename_size = align_to(path_filename(ctx.arg.output).size() + 1, 16);
+  return sizeof(CodeSignatureHeader) + sizeof(CodeSignatureBlobIndex) +
+         sizeof(CodeSignatureDirectory) + filename_size;
+}
+
+// Computes SHA256 hashes of the output file's pages in [begin, end).
+// `begin` and `end` must be page-aligned except for the last page,
+// which ends at the beginning of this section.
+template <typename E>
+void CodeSignatureSection<E>::write_hashes(Context<E> &ctx, i64 begin,
+                                           i64 end) {
+  assert(begin % BLOCK_SIZE == 0);
+  end = std::min<i64>(end, this->hdr.offset);
+  if (begin >= end)
+    return;
+
+  u8 *buf = ctx.buf + this->hdr.offset + get_hashes_offset(ctx);
+
+  tbb::parallel_for((i64)(begin / BLOCK_SIZE),
+                    (i64)(align_to(end, BLOCK_SIZE) / BLOCK_SIZE),
+                    [&](i64 i) {
+    u8 *start = ctx.buf + i * BLOCK_SIZE;
+    u8 *last = ctx.buf + std::min<i64>((i + 1) * BLOCK_SIZE, end);
+    SHA256(start, last - start, buf + i * SHA256_SIZE);
+  });
+}
+
+// Hashes the pages of a given segment. This is called right after the
+// segment is copied to the output buffer, so that hashing overlaps with
+// copying other segments. Segments are page-aligned in the output file,
+// so no page is shared between two segments.
+template <typename E>
+void CodeSignatureSection<E>::write_hashes(Context<E> &ctx,
+                                           OutputSegment<E> &seg) {
+  write_hashes(ctx, seg.cmd.fileoff, seg.cmd.fileoff + seg.cmd.filesize);
+}
+
+// Computes LC_UUID from the contents of the output file and writes it
+// to the Mach-O header. Page hashes for segments other than the one
+// containing this section must have been written by write_hashes().
+//
+// The UUID is a hash of the page hashes, so we don't need to read the
+// output file again to compute it. Pages are hashed while LC_UUID is
+// still zero, so we rehash the page containing the UUID after writing
+// it to keep the code signature valid.
+template <typename E>
+void CodeSignatureSection<E>::write_uuid(Context<E> &ctx) {
+  for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments)
+    if (seg->cmd.fileoff <= this->hdr.offset &&
+        this->hdr.offset < seg->cmd.fileoff + seg->cmd.filesize)
+      write_hashes(ctx, *seg);
+
+  MachHeader &mhdr = *(MachHeader *)(ctx.buf + ctx.mach_hdr.hdr.offset);
+  u8 *p = (u8 *)(&mhdr + 1);
+  UUIDCommand *cmd = nullptr;
+
+  for (i64 i = 0; i < mhdr.ncmds; i++) {
+    LoadCommand &lc = *(LoadCommand *)p;
+    if (lc.cmd == LC_UUID) {
+      cmd = (UUIDCommand *)p;
+      break;
+    }
+    p += lc.cmdsize;
+  }
+  assert(cmd);
+
   i64 num_blocks = align_to(this->hdr.offset, BLOCK_SIZE) / BLOCK_SIZE;
-  this->hdr.size = sizeof(CodeSignatureHeader) + sizeof(CodeSignatureBlobIndex) +
-                   sizeof(CodeSignatureDirectory) + filename_size +
-                   num_blocks * SHA256_SIZE;
+  u8 digest[SHA256_SIZE];
+  SHA256(ctx.buf + this->hdr.offset + get_hashes_offset(ctx),
+         num_blocks * SHA256_SIZE, digest);
+  memcpy(cmd->uuid, digest, sizeof(cmd->uuid));
+
+  // Indicate that this is a name-based UUID (version 5) as lld does.
+  cmd->uuid[6] = (cmd->uuid[6] & 0b00001111) | 0b01010000;
+
+  // Indicate that this is an RFC4122 variant.
+  cmd->uuid[8] = (cmd->uuid[8] & 0b00111111) | 0b10000000;
+
+  i64 off = (u8 *)cmd - ctx.buf;
+  i64 begin = align_down(off, BLOCK_SIZE);
+  i64 end = align_to(off + sizeof(*cmd), BLOCK_SIZE);
+  write_hashes(ctx, begin, end);
 }
 
+// Writes a code signature. Page hashes must have been written by
+// write_hashes() and write_uuid().
 template <typename E>
 void CodeSignatureSection<E>::write_signature(Context<E> &ctx) {
   u8 *buf = ctx.buf + this->hdr.offset;
@@ -1017,14 +1528,6 @@ void CodeSignatureSection<E>::write_signature(Context<E> &ctx) {
     dir.exec_seg_flags = CS_EXECSEG_MAIN_BINARY;
 
   memcpy(buf, filename.data(), filename.size());
-  buf += filename_size;
-
-  for (i64 i = 0; i < num_blocks; i++) {
-    u8 *start = ctx.buf + i * BLOCK_SIZE;
-    u8 *end = ctx.buf + std::min<i64>((i + 1) * BLOCK_SIZE, this->hdr.offset);
-    SHA256(start, end - start, buf);
-    buf += SHA256_SIZE;
-  }
 
   // A hack borrowed from lld.
   msync(ctx.buf, ctx.output_file->filesize, MS_INVALIDATE);
@@ -1034,7 +1537,10 @@ template <typename E>
 void DataInCodeSection<E>::compute_size(Context<E> &ctx) {
   assert(contents.empty());
 
-  for (ObjectFile<E> *file : ctx.objs) {
+  std::vector<std::vector<DataInCodeEntry>> vec(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
     std::span<DataInCodeEntry> entries = file->data_in_code_entries;
 
     for (std::unique_ptr<Subsection<E>> &subsec : file->subsections) {
@@ -1048,13 +1554,14 @@ void DataInCodeSection<E>::compute_size(Context<E> &ctx) {
       if (ent.offset < subsec->input_addr + subsec->input_size) {
         u32 offset = subsec->get_addr(ctx) + subsec->input_addr - ent.offset -
                      ctx.text_seg->cmd.vmaddr;
-        contents.push_back({offset, ent.length, ent.kind});
+        vec[i].push_back({offset, ent.length, ent.kind});
       }
 
       entries = entries.subspan(1);
     }
-  }
+  });
 
+  contents = flatten(vec);
   this->hdr.size = contents.size() * sizeof(contents[0]);
 }
 
@@ -1065,10 +1572,19 @@ void DataInCodeSection<E>::copy_buf(Context<E> &ctx) {
 
 template <typename E>
 void StubsSection<E>::add(Context<E> &ctx, Symbol<E> *sym) {
-  assert(sym->stub_idx == -1);
-  sym->stub_idx = syms.size();
+  add(ctx, std::span<Symbol<E> *>(&sym, 1));
+}
+
+// Appends given symbols and assigns them consecutive stub indices.
+template <typename E>
+void StubsSection<E>::add(Context<E> &ctx, std::span<Symbol<E> *> vec) {
+  i64 base = syms.size();
+  syms.insert(syms.end(), vec.begin(), vec.end());
 
-  syms.push_back(sym);
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    assert(vec[i]->stub_idx == -1);
+    vec[i]->stub_idx = base + i;
+  });
 
   i64 nsyms = syms.size();
   this->hdr.size = nsyms * E::stub_size;
@@ -1078,52 +1594,103 @@ void StubsSection<E>::add(Context<E> &ctx, Symbol<E> *sym) {
   ctx.lazy_symbol_ptr.hdr.size = nsyms * E::wordsize;
 }
 
+// __unwind_info consists of a header, a table of common encodings,
+// personality functions, a first-level index, LSDA entries and
+// second-level pages. Once records are sorted by address, each
+// second-level page is independent of the others, so we compute the
+// size of each page in parallel, assign offsets and then write pages
+// in parallel.
 template <typename E>
 std::vector<u8>
 UnwindEncoder<E>::encode(Context<E> &ctx, std::span<UnwindRecord<E>> records) {
-  i64 num_lsda = 0;
-
-  for (UnwindRecord<E> &rec : records) {
+  for (UnwindRecord<E> &rec : records)
     if (rec.personality)
       rec.encoding |= encode_personality(ctx, rec.personality);
-    if (rec.lsda)
-      num_lsda++;
+
+  find_common_encodings(records);
+
+  struct Page {
+    std::span<UnwindRecord<E>> records;
+    std::unordered_map<u32, u32> encodings;
+    i64 num_lsda = 0;
+    i64 offset = 0;
+    i64 lsda_offset = 0;
+  };
+
+  std::vector<std::span<UnwindRecord<E>>> spans = split_records(ctx, records);
+  std::vector<Page> pages(spans.size());
+
+  // Assign page-local encoding indices. Indices below the number of
+  // common encodings refer to the table in the section header.
+  tbb::parallel_for((i64)0, (i64)pages.size(), [&](i64 i) {
+    Page &page = pages[i];
+    page.records = spans[i];
+
+    for (UnwindRecord<E> &rec : page.records) {
+      if (!common_encodings.contains(rec.encoding))
+        page.encodings.insert({rec.encoding,
+                               common_list.size() + page.encodings.size()});
+      if (rec.lsda)
+        page.num_lsda++;
+    }
+  });
+
+  i64 personality_offset = sizeof(UnwindSectionHeader) + common_list.size() * 4;
+  i64 page1_offset = personality_offset + personalities.size() * 4;
+  i64 lsda_offset = page1_offset +
+                    (pages.size() + 1) * sizeof(UnwindFirstLevelPage);
+
+  i64 num_lsda = 0;
+  for (Page &page : pages) {
+    page.lsda_offset = lsda_offset + num_lsda * sizeof(UnwindLsdaEntry);
+    num_lsda += page.num_lsda;
   }
 
-  std::vector<std::span<UnwindRecord<E>>> pages = split_records(ctx, records);
+  i64 offset = lsda_offset + num_lsda * sizeof(UnwindLsdaEntry);
+  for (Page &page : pages) {
+    page.offset = offset;
+    offset += sizeof(UnwindSecondLevelPage) +
+              page.records.size() * sizeof(UnwindPageEntry) +
+              page.encodings.size() * 4;
+  }
 
-  // Allocate a buffer that is more than large enough to hold the
-  // entire section.
-  std::vector<u8> buf(4096 * 1024);
+  std::vector<u8> buf(offset);
 
   // Write the section header.
   UnwindSectionHeader &uhdr = *(UnwindSectionHeader *)buf.data();
   uhdr.version = UNWIND_SECTION_VERSION;
   uhdr.encoding_offset = sizeof(uhdr);
-  uhdr.encoding_count = 0;
-  uhdr.personality_offset = sizeof(uhdr);
+  uhdr.encoding_count = common_list.size();
+  uhdr.personality_offset = personality_offset;
   uhdr.personality_count = personalities.size();
-  uhdr.page_offset = sizeof(uhdr) + personalities.size() * 4;
+  uhdr.page_offset = page1_offset;
   uhdr.page_count = pages.size() + 1;
 
+  // Write the common encodings
+  u32 *encoding = (u32 *)(buf.data() + sizeof(uhdr));
+  for (u32 enc : common_list)
+    *encoding++ = enc;
+
   // Write the personalities
-  u32 *per = (u32 *)(buf.data() + sizeof(uhdr));
+  u32 *per = (u32 *)(buf.data() + personality_offset);
   for (Symbol<E> *sym : personalities) {
     assert(sym->got_idx != -1);
     *per++ = sym->get_got_addr(ctx);
   }
 
   // Write first level pages, LSDA and second level pages
-  UnwindFirstLevelPage *page1 = (UnwindFirstLevelPage *)per;
-  UnwindLsdaEntry *lsda = (UnwindLsdaEntry *)(page1 + (pages.size() + 1));
-  UnwindSecondLevelPage *page2 = (UnwindSecondLevelPage *)(lsda + num_lsda);
+  UnwindFirstLevelPage *page1 = (UnwindFirstLevelPage *)(buf.data() + page1_offset);
 
-  for (std::span<UnwindRecord<E>> span : pages) {
-    page1->func_addr = span[0].get_func_raddr(ctx);
-    page1->page_offset = (u8 *)page2 - buf.data();
-    page1->lsda_offset = (u8 *)lsda - buf.data();
+  tbb::parallel_for((i64)0, (i64)pages.size(), [&](i64 i) {
+    Page &page = pages[i];
+    u32 func_addr = page.records[0].get_func_raddr(ctx);
 
-    for (UnwindRecord<E> &rec : span) {
+    page1[i].func_addr = func_addr;
+    page1[i].page_offset = page.offset;
+    page1[i].lsda_offset = page.lsda_offset;
+
+    UnwindLsdaEntry *lsda = (UnwindLsdaEntry *)(buf.data() + page.lsda_offset);
+    for (UnwindRecord<E> &rec : page.records) {
       if (rec.lsda) {
         lsda->func_addr = rec.get_func_raddr(ctx);
         lsda->lsda_addr = rec.lsda->raddr + rec.lsda_offset;
@@ -1131,43 +1698,75 @@ UnwindEncoder<E>::encode(Context<E> &ctx, std::span<UnwindRecord<E>> records) {
       }
     }
 
-    std::unordered_map<u32, u32> map;
-    for (UnwindRecord<E> &rec : span)
-      map.insert({rec.encoding, map.size()});
-
+    UnwindSecondLevelPage *page2 =
+      (UnwindSecondLevelPage *)(buf.data() + page.offset);
     page2->kind = UNWIND_SECOND_LEVEL_COMPRESSED;
     page2->page_offset = sizeof(UnwindSecondLevelPage);
-    page2->page_count = span.size();
+    page2->page_count = page.records.size();
 
     UnwindPageEntry *entry = (UnwindPageEntry *)(page2 + 1);
-    for (UnwindRecord<E> &rec : span) {
-      entry->func_addr = rec.get_func_raddr(ctx) - page1->func_addr;
-      entry->encoding = map[rec.encoding];
+    for (UnwindRecord<E> &rec : page.records) {
+      entry->func_addr = rec.get_func_raddr(ctx) - func_addr;
+      if (auto it = common_encodings.find(rec.encoding);
+          it != common_encodings.end())
+        entry->encoding = it->second;
+      else
+        entry->encoding = page.encodings[rec.encoding];
       entry++;
     }
 
     page2->encoding_offset = (u8 *)entry - (u8 *)page2;
-    page2->encoding_count = map.size();
+    page2->encoding_count = page.encodings.size();
 
     u32 *encoding = (u32 *)entry;
-    for (std::pair<u32, u32> kv : map)
-      encoding[kv.second] = kv.first;
-
-    page1++;
-    page2 = (UnwindSecondLevelPage *)(encoding + map.size());
-    break;
-  }
+    for (std::pair<u32, u32> kv : page.encodings)
+      encoding[kv.second - common_list.size()] = kv.first;
+  });
 
   // Write a terminator
   UnwindRecord<E> &last = records[records.size() - 1];
-  page1->func_addr = last.subsec->raddr + last.subsec->input_size + 1;
-  page1->page_offset = 0;
-  page1->lsda_offset = (u8 *)lsda - buf.data();
-
-  buf.resize((u8 *)page2 - buf.data());
+  page1[pages.size()].func_addr =
+    last.subsec->raddr + last.subsec->input_size + 1;
+  page1[pages.size()].page_offset = 0;
+  page1[pages.size()].lsda_offset =
+    lsda_offset + num_lsda * sizeof(UnwindLsdaEntry);
   return buf;
 }
 
+// Encodings that are used by many records are stored only once in the
+// section header instead of in each second-level page. We count the
+// number of occurrences of each encoding in parallel.
+template <typename E>
+void UnwindEncoder<E>::find_common_encodings(std::span<UnwindRecord<E>> records) {
+  constexpr i64 chunk_size = 1 << 14;
+  tbb::concurrent_hash_map<u32, i64> counts;
+
+  tbb::parallel_for((i64)0, (i64)records.size(), chunk_size, [&](i64 begin) {
+    i64 end = std::min<i64>(begin + chunk_size, records.size());
+    std::unordered_map<u32, i64> map;
+    for (i64 i = begin; i < end; i++)
+      map[records[i].encoding]++;
+
+    for (std::pair<u32, i64> kv : map) {
+      typename decltype(counts)::accessor acc;
+      counts.insert(acc, kv.first);
+      acc->second += kv.second;
+    }
+  });
+
+  std::vector<std::pair<u32, i64>> vec(counts.begin(), counts.end());
+  sort(vec, [](const std::pair<u32, i64> &a, const std::pair<u32, i64> &b) {
+    return std::tuple(b.second, a.first) < std::tuple(a.second, b.first);
+  });
+
+  for (std::pair<u32, i64> kv : vec) {
+    if (kv.second < 2 || common_list.size() == max_common_encodings)
+      break;
+    common_encodings.insert({kv.first, common_list.size()});
+    common_list.push_back(kv.first);
+  }
+}
+
 template <typename E>
 u32 UnwindEncoder<E>::encode_personality(Context<E> &ctx, Symbol<E> *sym) {
   assert(sym);
@@ -1189,18 +1788,32 @@ UnwindEncoder<E>::split_records(Context<E> &ctx,
                                 std::span<UnwindRecord<E>> records) {
   constexpr i64 max_group_size = 4096;
 
-  sort(records, [&](const UnwindRecord<E> &a, const UnwindRecord<E> &b) {
-    return a.get_func_raddr(ctx) < b.get_func_raddr(ctx);
-  });
+  // A compressed page entry refers to an encoding with an 8-bit index,
+  // so a page can use at most 256 distinct encodings including the
+  // common ones.
+  i64 max_local_encodings = 256 - common_list.size();
 
   std::vector<std::span<UnwindRecord<E>>> vec;
 
   for (i64 i = 0; i < records.size();) {
+    std::unordered_set<u32> local;
+    if (!common_encodings.contains(records[i].encoding))
+      local.insert(records[i].encoding);
+
     i64 j = 1;
     u64 end_addr = records[i].get_func_raddr(ctx) + (1 << 24);
+
     while (j < max_group_size && i + j < records.size() &&
-           records[i + j].get_func_raddr(ctx) < end_addr)
+           records[i + j].get_func_raddr(ctx) < end_addr) {
+      u32 enc = records[i + j].encoding;
+      if (!common_encodings.contains(enc) && !local.contains(enc)) {
+        if (local.size() == max_local_encodings)
+          break;
+        local.insert(enc);
+      }
       j++;
+    }
+
     vec.push_back(records.subspan(i, j));
     i += j;
   }
@@ -1209,18 +1822,31 @@ UnwindEncoder<E>::split_records(Context<E> &ctx,
 
 template <typename E>
 static std::vector<u8> construct_unwind_info(Context<E> &ctx) {
-  std::vector<UnwindRecord<E>> records;
-
+  std::vector<OutputSection<E> *> osecs;
   for (std::unique_ptr<OutputSegment<E>> &seg : ctx.segments)
     for (Chunk<E> *chunk : seg->chunks)
       if (chunk->is_regular)
-        for (Subsection<E> *subsec : ((OutputSection<E> *)chunk)->members)
-          for (UnwindRecord<E> &rec : subsec->get_unwind_records())
-            if (!ctx.arg.dead_strip || rec.is_alive)
-              records.push_back(rec);
+        osecs.push_back((OutputSection<E> *)chunk);
 
+  // Gather unwind records for each output section in parallel.
+  std::vector<std::vector<UnwindRecord<E>>> vec(osecs.size());
+
+  tbb::parallel_for((i64)0, (i64)osecs.size(), [&](i64 i) {
+    for (Subsection<E> *subsec : osecs[i]->members)
+      for (UnwindRecord<E> &rec : subsec->get_unwind_records())
+        if (!ctx.arg.dead_strip || rec.is_alive)
+          vec[i].push_back(rec);
+  });
+
+  std::vector<UnwindRecord<E>> records = flatten(vec);
   if (records.empty())
     return {};
+
+  tbb::parallel_sort(records.begin(), records.end(),
+                     [&](const UnwindRecord<E> &a, const UnwindRecord<E> &b) {
+    return a.get_func_raddr(ctx) < b.get_func_raddr(ctx);
+  });
+
   return UnwindEncoder<E>().encode(ctx, records);
 }
 
@@ -1236,9 +1862,18 @@ void UnwindInfoSection<E>::copy_buf(Context<E> &ctx) {
 
 template <typename E>
 void GotSection<E>::add(Context<E> &ctx, Symbol<E> *sym) {
-  assert(sym->got_idx == -1);
-  sym->got_idx = syms.size();
-  syms.push_back(sym);
+  add(ctx, std::span<Symbol<E> *>(&sym, 1));
+}
+
+template <typename E>
+void GotSection<E>::add(Context<E> &ctx, std::span<Symbol<E> *> vec) {
+  i64 base = syms.size();
+  syms.insert(syms.end(), vec.begin(), vec.end());
+
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    assert(vec[i]->got_idx == -1);
+    vec[i]->got_idx = base + i;
+  });
   this->hdr.size = syms.size() * E::wordsize;
 }
 
@@ -1254,16 +1889,27 @@ template <typename E>
 void LazySymbolPtrSection<E>::copy_buf(Context<E> &ctx) {
   u64 *buf = (u64 *)(ctx.buf + this->hdr.offset);
 
+  // With -bind_at_load, there's no stub helper. dyld fills the pointers.
   for (i64 i = 0; i < ctx.stubs.syms.size(); i++)
-    buf[i] = ctx.stub_helper.hdr.addr + E::stub_helper_hdr_size +
+    buf[i] = ctx.arg.bind_at_load ? 0 :
+             ctx.stub_helper.hdr.addr + E::stub_helper_hdr_size +
              i * E::stub_helper_size;
 }
 
 template <typename E>
 void ThreadPtrsSection<E>::add(Context<E> &ctx, Symbol<E> *sym) {
-  assert(sym->tlv_idx == -1);
-  sym->tlv_idx = syms.size();
-  syms.push_back(sym);
+  add(ctx, std::span<Symbol<E> *>(&sym, 1));
+}
+
+template <typename E>
+void ThreadPtrsSection<E>::add(Context<E> &ctx, std::span<Symbol<E> *> vec) {
+  i64 base = syms.size();
+  syms.insert(syms.end(), vec.begin(), vec.end());
+
+  tbb::parallel_for((i64)0, (i64)vec.size(), [&](i64 i) {
+    assert(vec[i]->tlv_idx == -1);
+    vec[i]->tlv_idx = base + i;
+  });
   this->hdr.size = syms.size() * E::wordsize;
 }
 
@@ -1282,6 +1928,7 @@ void ThreadPtrsSection<E>::copy_buf(Context<E> &ctx) {
   template class OutputRebaseSection<E>;                \
   template class OutputBindSection<E>;                  \
   template class OutputLazyBindSection<E>;              \
+  template class ChainedFixupsSection<E>;               \
   template class OutputExportSection<E>;                \
   template class OutputFunctionStartsSection<E>;        \
   template class OutputSymtabSection<E>;                \
@@ -8,7 +8,9 @@
 //
 // On macOS, it looks like the system does not assume that an executable
 // is mutated once it is created. Due to some code signing mechanism or
-// something, we always have to create a fresh file.
+// something, we always have to create a fresh file. We still create
+// it in the same directory as the output and rename it over the old
+// file, so that a half-written file is never visible.
 
 #include "mold.h"
 
@@ -16,9 +18,72 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <tbb/parallel_for.h>
 
 namespace mold::macho {
 
+inline u32 get_umask() {
+  u32 orig_umask = umask(0);
+  umask(orig_umask);
+  return orig_umask;
+}
+
+// Reserve disk blocks for a new file upfront and prefault its pages in
+// parallel, so that we don't take one page fault per page when copying
+// sections. Both are just optimizations, so errors are ignored.
+static void preallocate(i64 fd, i64 filesize) {
+#if defined(__APPLE__)
+  fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, filesize, 0};
+  fcntl(fd, F_PREALLOCATE, &store);
+#elif defined(__linux__)
+  fallocate(fd, 0, 0, filesize);
+#endif
+}
+
+static void prefault(u8 *buf, i64 filesize) {
+#ifdef MADV_POPULATE_WRITE
+  i64 chunk_size = 16 * 1024 * 1024;
+  i64 num_chunks = (filesize + chunk_size - 1) / chunk_size;
+
+  tbb::parallel_for((i64)0, num_chunks, [&](i64 i) {
+    i64 size = std::min(chunk_size, filesize - i * chunk_size);
+    madvise(buf + i * chunk_size, size, MADV_POPULATE_WRITE);
+  });
+#endif
+}
+
+// Writes a given buffer to a file with multiple threads.
+template <typename E>
+static void write_parallel(Context<E> &ctx, i64 fd, u8 *buf, i64 filesize,
+                           std::string_view path) {
+  i64 chunk_size = 16 * 1024 * 1024;
+  i64 num_chunks = (filesize + chunk_size - 1) / chunk_size;
+
+  tbb::parallel_for((i64)0, num_chunks, [&](i64 i) {
+    i64 off = i * chunk_size;
+    i64 end = std::min(filesize, off + chunk_size);
+
+    while (off < end) {
+      ssize_t n = pwrite(fd, buf + off, end - off, off);
+      if (n <= 0)
+        Fatal(ctx) << path << ": write failed: " << errno_string();
+      off += n;
+    }
+  });
+}
+
+// Writes a given buffer to a file that is not seekable, such as a pipe.
+template <typename E>
+static void write_sequential(Context<E> &ctx, i64 fd, u8 *buf, i64 filesize,
+                             std::string_view path) {
+  for (i64 off = 0; off < filesize;) {
+    ssize_t n = write(fd, buf + off, filesize - off);
+    if (n <= 0)
+      Fatal(ctx) << path << ": write failed: " << errno_string();
+    off += n;
+  }
+}
+
 template <typename E>
 class MemoryMappedOutputFile : public OutputFile<E> {
 public:
@@ -33,7 +98,9 @@ public:
 
     if (ftruncate(fd, filesize))
       Fatal(ctx) << "ftruncate failed";
-    if (fchmod(fd, perm) == -1)
+    preallocate(fd, filesize);
+
+    if (fchmod(fd, (perm & ~get_umask())) == -1)
       Fatal(ctx) << "fchmod failed";
 
     this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
@@ -41,6 +108,7 @@ public:
     if (this->buf == MAP_FAILED)
       Fatal(ctx) << path << ": mmap failed: " << errno_string();
     ::close(fd);
+    prefault(this->buf, filesize);
   }
 
   void close(Context<E> &ctx) override {
@@ -62,13 +130,15 @@ public:
                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
     if (this->buf == MAP_FAILED)
       Fatal(ctx) << "mmap failed: " << errno_string();
+    prefault(this->buf, filesize);
   }
 
   void close(Context<E> &ctx) override {
     Timer t(ctx, "close_file");
 
     if (this->path == "-") {
-      fwrite(this->buf, this->filesize, 1, stdout);
+      fflush(stdout);
+      write_sequential(ctx, STDOUT_FILENO, this->buf, this->filesize, "-");
       fclose(stdout);
       return;
     }
@@ -77,9 +147,14 @@ public:
     if (fd == -1)
       Fatal(ctx) << "cannot open " << this->path << ": " << errno_string();
 
-    FILE *fp = fdopen(fd, "w");
-    fwrite(this->buf, this->filesize, 1, fp);
-    fclose(fp);
+    // A block device can be written by multiple threads, but a pipe or
+    // a character device has to be written from beginning to end.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)))
+      write_parallel(ctx, fd, this->buf, this->filesize, this->path);
+    else
+      write_sequential(ctx, fd, this->buf, this->filesize, this->path);
+    ::close(fd);
   }
 
 private:
@@ -1,6 +1,9 @@
 #include "mold.h"
 
+#include <fcntl.h>
 #include <optional>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace mold::macho {
 
@@ -18,8 +21,7 @@ static std::string_view get_line(std::string_view str, i64 pos) {
   return str.substr(begin, end - begin);
 }
 
-static std::vector<YamlNode>
-get_vector(YamlNode &node, std::string_view key) {
+static std::span<YamlNode> get_vector(YamlNode &node, std::string_view key) {
   if (auto *map = std::get_if<std::map<std::string_view, YamlNode>>(&node.data))
     if (auto it = map->find(key); it != map->end())
       if (auto *vec = std::get_if<std::vector<YamlNode>>(&it->second.data))
@@ -36,7 +38,7 @@ get_string(YamlNode &node, std::string_view key) {
   return {};
 }
 
-static bool contains(const std::vector<YamlNode> &vec, std::string_view key) {
+static bool contains(std::span<YamlNode> vec, std::string_view key) {
   for (const YamlNode &mem : vec)
     if (const std::string_view *s = std::get_if<std::string_view>(&mem.data))
       if (*s == key)
@@ -125,18 +127,166 @@ static TextDylib parse(Context<E> &ctx, MappedFile<Context<E>> *mf,
   std::vector<TextDylib> vec;
   for (YamlNode &node : nodes)
     if (std::optional<TextDylib> dylib = to_tbd(node, arch))
-      vec.push_back(*dylib);
+      vec.push_back(std::move(*dylib));
   return squash(ctx, vec);
 }
 
+// With -tbd_cache_path, the results of parsing .tbd files are saved
+// to a given directory. Linking against an SDK reads the same large
+// .tbd files over and over, but they rarely change, so we can skip
+// YAML parsing on subsequent links.
+//
+// A cache file consists of a magic string, the size and the mtime of
+// the .tbd file, followed by length-prefixed strings. A cache file is
+// used only if the .tbd file's path, size and mtime match the recorded
+// ones. Strings of a TextDylib read from a cache file point directly
+// into the memory-mapped cache file.
+static constexpr std::string_view tbd_cache_magic = "MOLDTBD1";
+
+template <typename E>
+static std::string get_cache_path(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                                  std::string_view arch) {
+  std::string key = mf->name + ":" + std::string(arch);
+  return ctx.arg.tbd_cache_path + "/" +
+         std::to_string(std::hash<std::string>()(key)) + ".tbd-cache";
+}
+
+template <typename E>
+static std::optional<TextDylib>
+read_cache(Context<E> &ctx, MappedFile<Context<E>> *mf, std::string_view arch,
+           const std::string &path) {
+  MappedFile<Context<E>> *cache = MappedFile<Context<E>>::open(ctx, path);
+  if (!cache)
+    return {};
+
+  std::string_view data = cache->get_contents();
+  if (!data.starts_with(tbd_cache_magic))
+    return {};
+  data = data.substr(tbd_cache_magic.size());
+
+  bool ok = true;
+
+  auto read_int = [&]() -> i64 {
+    i64 val = 0;
+    if (data.size() < sizeof(val)) {
+      ok = false;
+      return 0;
+    }
+    memcpy(&val, data.data(), sizeof(val));
+    data = data.substr(sizeof(val));
+    return val;
+  };
+
+  auto read_string = [&]() -> std::string_view {
+    i64 len = read_int();
+    if (!ok || len < 0 || data.size() < len) {
+      ok = false;
+      return {};
+    }
+    std::string_view str = data.substr(0, len);
+    data = data.substr(len);
+    return str;
+  };
+
+  i64 size = read_int();
+  i64 mtime = read_int();
+  i64 num_reexported_libs = read_int();
+  i64 num_exports = read_int();
+  std::string_view name = read_string();
+  std::string_view arch2 = read_string();
+
+  if (!ok || size != mf->size || mtime != mf->mtime || name != mf->name ||
+      arch2 != arch || num_reexported_libs < 0 || num_exports < 0)
+    return {};
+
+  TextDylib tbd;
+  tbd.uuid = read_string();
+  tbd.install_name = read_string();
+  tbd.current_version = read_string();
+  tbd.parent_umbrella = read_string();
+
+  tbd.reexported_libs.reserve(num_reexported_libs);
+  for (i64 i = 0; ok && i < num_reexported_libs; i++)
+    tbd.reexported_libs.push_back(read_string());
+
+  tbd.exports.reserve(num_exports);
+  for (i64 i = 0; ok && i < num_exports; i++)
+    tbd.exports.push_back(read_string());
+
+  if (!ok)
+    return {};
+  return tbd;
+}
+
+// Writing a cache file is just an optimization, so errors are ignored.
+// We write to a temporary file and then rename it so that concurrent
+// linker processes never see a partially-written cache file.
+template <typename E>
+static void write_cache(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                        std::string_view arch, const std::string &path,
+                        const TextDylib &tbd) {
+  std::string buf(tbd_cache_magic);
+
+  auto write_int = [&](i64 val) {
+    buf.append((char *)&val, sizeof(val));
+  };
+
+  auto write_string = [&](std::string_view str) {
+    write_int(str.size());
+    buf.append(str);
+  };
+
+  write_int(mf->size);
+  write_int(mf->mtime);
+  write_int(tbd.reexported_libs.size());
+  write_int(tbd.exports.size());
+  write_string(mf->name);
+  write_string(arch);
+  write_string(tbd.uuid);
+  write_string(tbd.install_name);
+  write_string(tbd.current_version);
+  write_string(tbd.parent_umbrella);
+
+  for (std::string_view lib : tbd.reexported_libs)
+    write_string(lib);
+  for (std::string_view sym : tbd.exports)
+    write_string(sym);
+
+  std::string tmp = path + ".XXXXXX";
+  i64 fd = mkstemp(tmp.data());
+  if (fd == -1)
+    return;
+
+  bool ok = (write(fd, buf.data(), buf.size()) == buf.size());
+  close(fd);
+
+  if (!ok || rename(tmp.c_str(), path.c_str()) == -1)
+    unlink(tmp.c_str());
+}
+
+template <typename E>
+static TextDylib parse_cached(Context<E> &ctx, MappedFile<Context<E>> *mf,
+                              std::string_view arch) {
+  if (ctx.arg.tbd_cache_path.empty())
+    return parse(ctx, mf, arch);
+
+  std::string path = get_cache_path(ctx, mf, arch);
+  if (std::optional<TextDylib> tbd = read_cache(ctx, mf, arch, path))
+    return *tbd;
+
+  TextDylib tbd = parse(ctx, mf, arch);
+  write_cache(ctx, mf, arch, path, tbd);
+  return tbd;
+}
+
 template <>
 TextDylib parse_tbd(Context<ARM64> &ctx, MappedFile<Context<ARM64>> *mf) {
-  return parse(ctx, mf, "arm64-macos");
+  return parse_cached(ctx, mf, "arm64-macos");
 }
 
 template <>
 TextDylib parse_tbd(Context<X86_64> &ctx, MappedFile<Context<X86_64>> *mf) {
-  return parse(ctx, mf, "x86_64-macos");
+  return parse_cached(ctx, mf, "x86_64-macos");
 }
 
 } // namespace mold::macho
@@ -2,13 +2,19 @@
 
 #include "byteorder.h"
 
+#include <array>
 #include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
+#include <functional>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <span>
 #include <sstream>
 #include <string>
@@ -18,9 +24,39 @@
 #include <sys/types.h>
 #include <tbb/concurrent_vector.h>
 #include <tbb/enumerable_thread_specific.h>
+#include <tbb/global_control.h>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
+#ifdef MOLD_USE_MIMALLOC
+#include <mimalloc.h>
+#endif
+
+// A function marked with MOLD_TARGET_CLONES is compiled multiple times
+// for different x86-64 instruction set levels, and the best version for
+// the host CPU is selected by an ifunc when mold is loaded. This way,
+// a single mold executable can use wide vector instructions on
+// machines that support them. Use it for small, hot loops that the
+// compiler can vectorize.
+//
+// ifuncs are available only for ELF with glibc. They don't work with
+// sanitizers either. On AArch64, NEON is always available, so we don't
+// need to dispatch at runtime.
+#if defined(__x86_64__) && defined(__ELF__) && defined(__GLIBC__) && \
+    !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__) && \
+    defined(__has_attribute)
+# if __has_attribute(target_clones)
+#  define MOLD_TARGET_CLONES \
+     __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", \
+                                   "default")))
+# endif
+#endif
+
+#ifndef MOLD_TARGET_CLONES
+# define MOLD_TARGET_CLONES
+#endif
+
 namespace mold {
 
 using namespace std::literals::string_literals;
@@ -38,6 +74,12 @@ typedef int64_t i64;
 
 template <typename C> class OutputFile;
 
+template <typename T, typename U>
+void push_to_pool(tbb::concurrent_vector<T> &pool, U &&val);
+
+template <typename C>
+void add_to_string_pool(C &ctx, u8 *buf, i64 size);
+
 inline char *output_tmpfile;
 inline char *socket_tmpfile;
 inline thread_local bool opt_demangle;
@@ -59,10 +101,7 @@ public:
     opt_demangle = ctx.arg.demangle;
   }
 
-  ~SyncOut() {
-    std::lock_guard lock(mu);
-    out << ss.str() << "\n";
-  }
+  ~SyncOut();
 
   template <class T> SyncOut &operator<<(T &&val) {
     ss << std::forward<T>(val);
@@ -133,6 +172,46 @@ private:
   SyncOut<C> out;
 };
 
+// SyncOut takes a global lock for each line, which serializes threads
+// if many lines are written from a parallel loop. DeferredOut instead
+// collects lines in per-thread buffers and writes them all at once in
+// sorted order when flushed, so the output doesn't depend on thread
+// scheduling either.
+template <typename C>
+class DeferredOut {
+public:
+  class Line {
+  public:
+    Line(DeferredOut &parent) : parent(parent) {
+      opt_demangle = parent.ctx.arg.demangle;
+    }
+
+    ~Line() {
+      parent.lines.local().push_back(ss.str());
+    }
+
+    template <class T> Line &operator<<(T &&val) {
+      ss << std::forward<T>(val);
+      return *this;
+    }
+
+  private:
+    DeferredOut &parent;
+    std::stringstream ss;
+  };
+
+  DeferredOut(C &ctx, std::ostream &out = std::cout) : ctx(ctx), out(out) {}
+  ~DeferredOut() { flush(); }
+
+  Line line() { return Line(*this); }
+  void flush();
+
+private:
+  C &ctx;
+  std::ostream &out;
+  tbb::enumerable_thread_specific<std::vector<std::string>> lines;
+};
+
 #define unreachable() assert(0 && "unreachable")
 
 //
@@ -186,6 +265,18 @@ inline void sort(T &vec, U less) {
   std::stable_sort(vec.begin(), vec.end(), less);
 }
 
+// mimalloc keeps freed pages in the heap of the thread that freed them
+// for reuse. That's fine for a linker process which exits after a link,
+// but a long-running process that holds on to preloaded inputs or links
+// in memory repeatedly would retain the peak memory usage of all links
+// so far. This function returns memory freed by the calling thread to
+// the OS.
+inline void release_free_memory() {
+#ifdef MOLD_USE_MIMALLOC
+  mi_collect(true);
+#endif
+}
+
 inline i64 write_string(u8 *buf, std::string_view str) {
   memcpy(buf, str.data(), str.size());
   buf[str.size()] = '\0';
@@ -243,7 +334,7 @@ std::string_view save_string(C &ctx, const std::string &str) {
   u8 *buf = new u8[str.size() + 1];
   memcpy(buf, str.data(), str.size());
   buf[str.size()] = '\0';
-  ctx.string_pool.push_back(std::unique_ptr<u8[]>(buf));
+  add_to_string_pool(ctx, buf, str.size() + 1);
   return {(char *)buf, str.size()};
 }
 
@@ -268,6 +359,10 @@ public:
     }
   }
 
+  i64 get_memory_usage() const {
+    return nbuckets * (sizeof(keys[0]) + sizeof(sizes[0]) + sizeof(values[0]));
+  }
+
   void resize(i64 nbuckets) {
     this->~ConcurrentMap();
 
@@ -279,6 +374,9 @@ public:
     values = (T *)calloc(nbuckets, sizeof(values[0]));
   }
 
+  // Returns a pointer to the value for a given key and true if the key
+  // is newly inserted. Returns a null pointer if the map is not
+  // allocated yet or the probe sequence for the key is full.
   std::pair<T *, bool> insert(std::string_view key, u64 hash, const T &val) {
     if (!keys)
       return {nullptr, false};
@@ -312,11 +410,54 @@ public:
       idx = (idx & ~mask) | ((idx + 1) & mask);
       retry++;
     }
-
-    assert(false && "ConcurrentMap is full");
     return {nullptr, false};
   }
 
+  // Returns a pointer to the value for a given key or a null pointer
+  // if the key is not in the map. This function must not be called
+  // concurrently with insert() for the same key.
+  T *find(std::string_view key, u64 hash) {
+    if (!keys)
+      return nullptr;
+
+    i64 idx = hash & (nbuckets - 1);
+    for (i64 retry = 0; retry < MAX_RETRY; retry++) {
+      const char *ptr = keys[idx];
+      if (ptr == nullptr)
+        return nullptr;
+      if (ptr != locked && key.size() == sizes[idx] &&
+          memcmp(ptr, key.data(), sizes[idx]) == 0)
+        return values + idx;
+
+      u64 mask = nbuckets / NUM_SHARDS - 1;
+      idx = (idx & ~mask) | ((idx + 1) & mask);
+    }
+    return nullptr;
+  }
+
+  // Inserting many keys into a large map is dominated by cache misses
+  // on buckets and then on the keys they point to. A caller that knows
+  // upcoming keys can hide the latency by calling prefetch() for a key
+  // some iterations before insert(), and prefetch_key() for the key
+  // after that, once the bucket is likely in cache.
+  void prefetch(u64 hash) const {
+    if (keys) {
+      i64 idx = hash & (nbuckets - 1);
+      __builtin_prefetch(keys + idx);
+      __builtin_prefetch(sizes + idx);
+      __builtin_prefetch(values + idx);
+    }
+  }
+
+  void prefetch_key(u64 hash) const {
+    if (keys) {
+      const char *ptr =
+        keys[hash & (nbuckets - 1)].load(std::memory_order_relaxed);
+      if (ptr && ptr != locked)
+        __builtin_prefetch(ptr);
+    }
+  }
+
   bool has_key(i64 idx) {
     return keys[idx];
   }
@@ -379,6 +520,67 @@ private:
   std::unique_ptr<u8[]> vec;
 };
 
+//
+// Arena
+//
+
+// Arena is a bump-pointer allocator for objects that live until the
+// end of the process, such as input sections. Allocating from an arena
+// is much cheaper than calling `new`, and objects allocated from the
+// same arena are placed next to each other in memory. Memory is released
+// all at once when the arena is destroyed. Objects that have non-trivial
+// destructors are destroyed at that time in the reverse order of
+// allocation.
+//
+// Arena is not thread-safe. Each input file has its own arena so that
+// files can be parsed in parallel.
+class Arena {
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+
+  ~Arena() {
+    for (i64 i = dtors.size() - 1; i >= 0; i--)
+      dtors[i].first(dtors[i].second);
+  }
+
+  void *alloc(i64 size, i64 align = alignof(std::max_align_t)) {
+    assert(align <= alignof(std::max_align_t));
+
+    // Large objects get their own blocks so that they don't waste the
+    // rest of the current block.
+    if (size > BLOCK_SIZE / 4) {
+      blocks.emplace_back(new u8[size]);
+      return blocks.back().get();
+    }
+
+    u8 *p = (u8 *)(((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1));
+    if (!cur || p + size > end) {
+      blocks.emplace_back(new u8[BLOCK_SIZE]);
+      p = blocks.back().get();
+      end = p + BLOCK_SIZE;
+    }
+    cur = p + size;
+    return p;
+  }
+
+  template <typename T, typename... Args>
+  T *create(Args &&...args) {
+    T *obj = new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      dtors.push_back({[](void *p) { ((T *)p)->~T(); }, obj});
+    return obj;
+  }
+
+private:
+  static constexpr i64 BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<u8[]>> blocks;
+  std::vector<std::pair<void (*)(void *), void *>> dtors;
+  u8 *cur = nullptr;
+  u8 *end = nullptr;
+};
+
 //
 // threads.cc
 //
@@ -428,32 +630,141 @@ std::string_view path_basename(std::string_view path);
 std::string path_to_absolute(std::string_view path);
 std::string path_clean(std::string_view path);
 
+//
+// jobserver.cc
+//
+
+bool jobserver_connect();
+i64 jobserver_acquire(i64 n);
+void jobserver_release();
+
+// ThreadBudget limits the number of threads TBB may use. With
+// --jobserver, the limit is the number of job slots we own in GNU make's
+// jobserver, which is adjusted at phase boundaries by update().
+class ThreadBudget {
+public:
+  ThreadBudget(i64 max_threads, bool use_jobserver);
+  ~ThreadBudget();
+
+  void update();
+  void release();
+
+private:
+  void set(i64 n);
+
+  i64 max_threads;
+  bool use_jobserver;
+  i64 current = 0;
+  std::unique_ptr<tbb::global_control> control;
+};
+
 //
 // demangle.cc
 //
 
+// Returns a demangled name. Results are cached, so `name` must outlive
+// the process.
 std::string_view demangle(std::string_view name);
 
+// Same as demangle() but doesn't cache the result. The returned string
+// is valid until the next call on the same thread.
+std::string_view demangle_uncached(std::string_view name);
+
+//
+// glob.cc
+//
+
+// MultiGlob matches a string against many glob patterns at once.
+// Only `*` is a metacharacter. Patterns are indexed by their literal
+// prefixes in a trie, so that only patterns whose prefixes match a
+// given string are examined.
+class MultiGlob {
+public:
+  MultiGlob() : nodes(1) {}
+
+  void add(std::string_view pat, i64 val);
+  bool empty() const { return exact.empty() && nodes.size() == 1; }
+
+  // Returns the largest value among patterns matching a given string,
+  // or -1 if no pattern matches.
+  i64 find(std::string_view str) const;
+
+  // Same as above, but the caller gives XXH3_64bits(str), so that
+  // strings that already have their hashes aren't hashed again.
+  i64 find(std::string_view str, u64 hash) const;
+
+private:
+  struct Glob {
+    std::string_view pat;
+    i64 val;
+  };
+
+  struct HashedString {
+    bool operator==(const HashedString &x) const { return str == x.str; }
+    std::string_view str;
+    u64 hash;
+  };
+
+  struct Hasher {
+    size_t operator()(const HashedString &x) const { return x.hash; }
+  };
+
+  struct TrieNode {
+    std::vector<std::pair<u8, i64>> children;
+    std::vector<Glob> globs;
+  };
+
+  std::unordered_map<HashedString, i64, Hasher> exact;
+  std::vector<TrieNode> nodes;
+};
+
 //
 // compress.cc
 //
 
-class ZlibCompressor {
+// Compressors take input data either as a buffer or as a callback
+// that writes the [offset, offset + size) part of the input to a given
+// buffer. With the latter, input is materialized one shard at a time,
+// so the whole uncompressed data doesn't have to be in memory at once.
+typedef std::function<void(u8 *buf, i64 offset, i64 size)> CompressorInput;
+
+// A part of compressor input that is already compressed in the
+// output format (a zlib stream for ZlibCompressor, or zstd frames for
+// ZstdCompressor). It is spliced into the output instead of being
+// compressed again. If it cannot be spliced, it is read via
+// CompressorInput and compressed as usual.
+struct CompressedRange {
+  i64 offset = 0;
+  i64 size = 0;
+  std::string_view data;
+};
+
+class Compressor {
+public:
+  virtual ~Compressor() = default;
+  virtual void write_to(u8 *buf) = 0;
+  virtual i64 size() const = 0;
+};
+
+class ZlibCompressor : public Compressor {
 public:
   ZlibCompressor(std::string_view input);
-  void write_to(u8 *buf);
-  i64 size() const;
+  ZlibCompressor(i64 size, CompressorInput input,
+                 std::span<const CompressedRange> ranges = {});
+  void write_to(u8 *buf) override;
+  i64 size() const override;
 
 private:
   std::vector<std::vector<u8>> shards;
   u64 checksum = 0;
 };
 
-class GzipCompressor {
+class GzipCompressor : public Compressor {
 public:
   GzipCompressor(std::string_view input);
-  void write_to(u8 *buf);
-  i64 size() const;
+  GzipCompressor(i64 size, CompressorInput input);
+  void write_to(u8 *buf) override;
+  i64 size() const override;
 
 private:
   std::vector<std::vector<u8>> shards;
@@ -461,15 +772,33 @@ private:
   u32 uncompressed_size = 0;
 };
 
+class ZstdCompressor : public Compressor {
+public:
+  ZstdCompressor(std::string_view input);
+  ZstdCompressor(i64 size, CompressorInput input,
+                 std::span<const CompressedRange> ranges = {});
+  void write_to(u8 *buf) override;
+  i64 size() const override;
+
+private:
+  std::vector<std::vector<u8>> shards;
+};
+
 //
 // perf.cc
 //
 
+struct TimerRecord;
+
+typedef enum { STATS_TEXT, STATS_JSON } StatsFormat;
+
+void print_stats(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+                 StatsFormat format);
+
 // Counter is used to collect statistics numbers.
 class Counter {
 public:
   Counter(std::string_view name, i64 value = 0) : name(name), values(value) {
-    static std::mutex mu;
     std::lock_guard lock(mu);
     instances.push_back(this);
   }
@@ -480,13 +809,16 @@ public:
     return *this;
   }
 
-  Counter &operator+=(int delta) {
+  Counter &operator+=(i64 delta) {
     if (enabled)
       values.local() += delta;
     return *this;
   }
 
-  static void print();
+  // Returns the current values of all counters in the order of
+  // creation. TimerRecord uses it to attribute counter increments to
+  // linker passes.
+  static std::vector<i64> snapshot();
 
   static inline bool enabled = false;
 
@@ -496,7 +828,257 @@ private:
   std::string_view name;
   tbb::enumerable_thread_specific<i64> values;
 
+  static inline std::mutex mu;
   static inline std::vector<Counter *> instances;
+
+  friend class Histogram;
+  friend void print_stats(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                          StatsFormat);
+};
+
+// Histogram is used to collect the distribution of numbers (e.g. the
+// number of relocations of each input section). Values are counted in
+// power-of-two buckets; bucket N contains values in [2^(N-1), 2^N).
+class Histogram {
+public:
+  Histogram(std::string_view name) : name(name) {
+    std::lock_guard lock(Counter::mu);
+    instances.push_back(this);
+  }
+
+  void add(i64 val) {
+    if (Counter::enabled) {
+      Data &data = values.local();
+      data.buckets[std::bit_width((u64)std::max<i64>(val, 0))]++;
+      data.count++;
+      data.sum += val;
+      data.max = std::max(data.max, val);
+    }
+  }
+
+private:
+  struct Data {
+    i64 count = 0;
+    i64 sum = 0;
+    i64 max = 0;
+    i64 buckets[65] = {};
+  };
+
+  Data get_value();
+
+  std::string_view name;
+  tbb::enumerable_thread_specific<Data> values;
+
+  static inline std::vector<Histogram *> instances;
+
+  friend void print_stats(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                          StatsFormat);
+};
+
+// LockStats counts acquisitions of a lock shared by threads and the
+// time spent waiting for it while another thread held it. They are
+// printed with --stats to find which shared data structure limits
+// scalability.
+//
+// For data structures that lock internally, such as
+// tbb::concurrent_hash_map, we can't tell whether an operation had to
+// wait, so measure() counts the time of the entire operation as wait
+// time. Such stats are created with `is_mutex` false and have no
+// contention counter.
+class LockStats {
+public:
+  LockStats(std::string_view name, bool is_mutex = true)
+    : acquired_name(std::string(name) + "_acquired"),
+      contended_name(std::string(name) + "_contended"),
+      wait_name(std::string(name) + "_wait_ns"),
+      acquired(acquired_name), wait_ns(wait_name) {
+    if (is_mutex)
+      contended.emplace(contended_name);
+  }
+
+  template <typename Mutex>
+  void lock(Mutex &mu) {
+    if (!Counter::enabled) {
+      mu.lock();
+      return;
+    }
+
+    acquired++;
+    if (mu.try_lock())
+      return;
+
+    (*contended)++;
+    i64 start = get_time();
+    mu.lock();
+    wait_ns += get_time() - start;
+  }
+
+  template <typename Fn>
+  void measure(Fn fn) {
+    if (!Counter::enabled) {
+      fn();
+      return;
+    }
+
+    acquired++;
+    i64 start = get_time();
+    fn();
+    wait_ns += get_time() - start;
+  }
+
+private:
+  static i64 get_time() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  std::string acquired_name;
+  std::string contended_name;
+  std::string wait_name;
+  Counter acquired;
+  Counter wait_ns;
+  std::optional<Counter> contended;
+};
+
+// ProfiledLock is std::lock_guard that records lock statistics.
+template <typename Mutex>
+class ProfiledLock {
+public:
+  ProfiledLock(Mutex &mu, LockStats &stats) : mu(mu) {
+    stats.lock(mu);
+  }
+
+  ~ProfiledLock() {
+    mu.unlock();
+  }
+
+private:
+  Mutex &mu;
+};
+
+// Stats of concurrent_vector::push_back() on the object pools in Context
+inline LockStats &pool_lock_stats() {
+  static LockStats stats("pool_push_back", false);
+  return stats;
+}
+
+template <typename T, typename U>
+void push_to_pool(tbb::concurrent_vector<T> &pool, U &&val) {
+  pool_lock_stats().measure([&] { pool.push_back(std::forward<U>(val)); });
+}
+
+// Transfers the ownership of a heap buffer to `ctx.string_pool`.
+template <typename C>
+void add_to_string_pool(C &ctx, u8 *buf, i64 size) {
+  static Counter bytes("mem_string_pool");
+  bytes += size;
+  push_to_pool(ctx.string_pool, std::unique_ptr<u8[]>(buf));
+}
+
+template <typename C>
+SyncOut<C>::~SyncOut() {
+  static LockStats stats("sync_out_lock");
+  ProfiledLock lock(mu, stats);
+  out << ss.str() << "\n";
+}
+
+template <typename C>
+void DeferredOut<C>::flush() {
+  std::vector<std::string> vec;
+  for (std::vector<std::string> &v : lines)
+    for (std::string &str : v)
+      vec.push_back(std::move(str));
+  lines.clear();
+
+  if (vec.empty())
+    return;
+
+  sort(vec);
+
+  std::string buf;
+  for (std::string &str : vec)
+    buf += str + "\n";
+
+  static LockStats stats("deferred_out_lock");
+  ProfiledLock lock(SyncOut<C>::mu, stats);
+  out << buf;
+}
+
+// MemoryBudget limits the total size of memory that threads use at
+// the same time in memory-heavy passes for --memory-limit. A thread
+// that would exceed the limit waits until other threads release their
+// shares. A request larger than the limit is granted when nobody else
+// holds any, so that it doesn't wait forever.
+//
+// A thread must not wait for other tasks while holding a share, or a
+// task stolen by the thread may wait for the share forever. Use
+// tbb::this_task_arena::isolate() if it runs a nested parallel loop.
+class MemoryBudget {
+public:
+  class Share {
+  public:
+    Share(MemoryBudget &budget, i64 size) : budget(budget), size(size) {
+      budget.acquire(size);
+    }
+
+    ~Share() {
+      budget.release(size);
+    }
+
+  private:
+    MemoryBudget &budget;
+    i64 size;
+  };
+
+  // Zero means unlimited.
+  i64 limit = 0;
+
+private:
+  void acquire(i64 size) {
+    if (limit == 0)
+      return;
+    std::unique_lock lock(mu);
+    cond.wait(lock, [&] { return used == 0 || used + size <= limit; });
+    used += size;
+  }
+
+  void release(i64 size) {
+    if (limit == 0)
+      return;
+    {
+      std::lock_guard lock(mu);
+      used -= size;
+    }
+    cond.notify_all();
+  }
+
+  std::mutex mu;
+  std::condition_variable cond;
+  i64 used = 0;
+};
+
+// A span of a task in a parallel loop recorded by TaskTimer
+struct TaskRecord {
+  std::string_view name;
+  i64 start;
+  i64 end;
+  i64 tid;
+};
+
+// HwCounters reads hardware performance counters for --perf-counters.
+// Each thread in the thread pool opens its own set of counters with
+// perf_event_open(2), and snapshot() returns their sums over all
+// threads, so that a phase gets the counts of all threads that worked
+// for it. Only user-space events are counted.
+class HwCounters {
+public:
+  enum { CYCLES, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, NUM };
+
+  // Returns false if counters are not available on this system.
+  static bool enable();
+  static std::array<i64, NUM> snapshot();
+
+  static inline bool enabled = false;
 };
 
 // Timer and TimeRecord records elapsed time (wall clock time)
@@ -505,6 +1087,10 @@ struct TimerRecord {
   TimerRecord(std::string name, TimerRecord *parent = nullptr);
   void stop();
 
+  // Timers are used only by --perf and --stats. Since getrusage() is
+  // not cheap, no record is created unless either option is given.
+  static inline bool enabled = false;
+
   std::string name;
   TimerRecord *parent;
   tbb::concurrent_vector<TimerRecord *> children;
@@ -512,30 +1098,156 @@ struct TimerRecord {
   i64 end;
   i64 user;
   i64 sys;
+
+  // Growth of the peak resident set size in KiB. Since getrusage()
+  // reports only the peak of the whole process, a phase that doesn't
+  // raise the high-water mark gets zero.
+  i64 maxrss;
+  i64 minflt;
+  i64 majflt;
+  i64 nvcsw;
+  i64 nivcsw;
+
+  // A small integer identifying the thread that started this timer
+  i64 tid;
   bool stopped = false;
+
+  // With --stats, increments of each counter while this timer was
+  // running, indexed in the same way as Counter::snapshot().
+  std::vector<i64> counters;
+
+  // With --perf-counters, increments of hardware counters
+  std::array<i64, HwCounters::NUM> hw = {};
+
+  tbb::concurrent_vector<TaskRecord> tasks;
 };
 
+typedef enum { PERF_TEXT, PERF_JSON, PERF_CHROME_TRACE } PerfFormat;
+
 void
-print_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &);
+print_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                    PerfFormat format = PERF_TEXT);
+
+std::string
+serialize_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &);
+
+void print_perf_sweep(std::span<const i64> threads,
+                      std::span<const std::string> results);
+
+// Progress publishes the current phase of a link to a file descriptor
+// given by --progress-fd, so that a build system can tell a slow link
+// from a stuck one. Each message is a single line written with a
+// single write(2), e.g. "phase resolve_symbols", "icf 3 1520" (round
+// and the number of changed sections) or "progress copy_buf 123 456"
+// (done and total). A Unix domain socket or a pipe can be used.
+class Progress {
+public:
+  static void write(const std::string &line);
+
+  static inline i64 fd = -1;
+};
+
+// ProgressCounter reports the progress of a parallel loop. Increments
+// are cheap, and updates are rate-limited so that they don't flood
+// the reader.
+class ProgressCounter {
+public:
+  ProgressCounter(std::string_view name, i64 total)
+    : name(name), total(total) {}
+
+  ~ProgressCounter() {
+    if (Progress::fd != -1)
+      report(done);
+  }
+
+  void add(i64 n) {
+    if (Progress::fd != -1)
+      maybe_report(done += n);
+  }
+
+private:
+  void maybe_report(i64 val);
+  void report(i64 val);
+
+  std::string_view name;
+  i64 total;
+  std::atomic<i64> done = 0;
+  std::atomic<i64> last_time = 0;
+};
 
 template <typename C>
 class Timer {
 public:
-  Timer(C &ctx, std::string name, Timer *parent = nullptr) {
-    record = new TimerRecord(name, parent ? parent->record : nullptr);
+  Timer(C &ctx, std::string_view name, Timer *parent = nullptr) {
+    if (Progress::fd != -1)
+      Progress::write("phase " + std::string(name));
+    if (!TimerRecord::enabled)
+      return;
+    record = new TimerRecord(std::string(name),
+                             parent ? parent->record : nullptr);
     ctx.timer_records.push_back(std::unique_ptr<TimerRecord>(record));
   }
 
   ~Timer() {
-    record->stop();
+    stop();
   }
 
   void stop() {
-    record->stop();
+    if (record)
+      record->stop();
+  }
+
+private:
+  TimerRecord *record = nullptr;
+
+  friend class TaskTimer;
+};
+
+// TaskTimer records the time spent by each task of a parallel loop and
+// the thread that ran it, so that --perf can show how evenly the work
+// of the loop is distributed to threads. Unlike Timer, it doesn't call
+// getrusage(), and it does nothing unless --perf is given, so it is
+// cheap enough to be used for each input file or output section.
+class TaskTimer {
+public:
+  template <typename C>
+  TaskTimer(C &ctx, Timer<C> &parent, std::string_view name)
+    : parent(ctx.arg.perf ? parent.record : nullptr), name(name) {
+    if (this->parent)
+      start = get_time();
+  }
+
+  ~TaskTimer();
+
+private:
+  static i64 get_time();
+
+  TimerRecord *parent;
+  std::string_view name;
+  i64 start = 0;
+
+  friend class CostTimer;
+};
+
+// CostTimer adds the time spent in its scope to a given counter. It is
+// used to attribute link time to individual input files for
+// --perf=files and does nothing if `enabled` is false.
+class CostTimer {
+public:
+  CostTimer(bool enabled, std::atomic<i64> &counter)
+    : counter(enabled ? &counter : nullptr) {
+    if (this->counter)
+      start = TaskTimer::get_time();
+  }
+
+  ~CostTimer() {
+    if (counter)
+      *counter += TaskTimer::get_time() - start;
   }
 
 private:
-  TimerRecord *record;
+  std::atomic<i64> *counter;
+  i64 start = 0;
 };
 
 //
@@ -552,15 +1264,18 @@ public:
   TarFile(std::string basedir) : basedir(basedir) {}
   void append(std::string path, std::string_view data);
   void write_to(u8 *buf);
+  void write_to(u8 *buf, i64 offset, i64 size);
   i64 size() const { return size_; }
 
 private:
   static constexpr i64 BLOCK_SIZE = 512;
 
   std::string encode_path(std::string path);
+  std::string get_header(i64 idx);
 
   std::string basedir;
   std::vector<std::pair<std::string, std::string_view>> contents;
+  std::vector<i64> offsets;
   i64 size_ = BLOCK_SIZE * 2;
 };
 
@@ -592,20 +1307,57 @@ public:
     return true;
   }
 
+  void release();
+
   std::string name;
   u8 *data = nullptr;
   i64 size = 0;
   i64 mtime = 0;
   bool given_fullpath = true;
+  bool is_mmapped = false;
   MappedFile *parent = nullptr;
 };
 
+// Files smaller than this are read into memory instead of being
+// mmap'ed. A program may be built from hundreds of thousands of tiny
+// object files, and mapping each of them costs a VMA, page faults
+// and an munmap at exit.
+static constexpr i64 SMALL_FILE_SIZE = 16 * 1024;
+
+// Allocates a buffer for a small input file. Buffers are carved out of
+// large per-thread slabs which live as long as `ctx`.
+template <typename C>
+u8 *alloc_small_file_buffer(C &ctx, i64 size) {
+  static constexpr i64 SLAB_SIZE = 1024 * 1024;
+  thread_local u8 *slab = nullptr;
+  thread_local i64 remaining = 0;
+
+  size = align_to(size, 16);
+  if (remaining < size) {
+    slab = new u8[SLAB_SIZE];
+    remaining = SLAB_SIZE;
+    add_to_string_pool(ctx, slab, SLAB_SIZE);
+  }
+
+  u8 *buf = slab;
+  slab += size;
+  remaining -= size;
+  return buf;
+}
+
 template <typename C>
 MappedFile<C> *MappedFile<C>::open(C &ctx, std::string path) {
   MappedFile *mf = new MappedFile;
   mf->name = path;
 
-  ctx.mf_pool.push_back(std::unique_ptr<MappedFile>(mf));
+  push_to_pool(ctx.mf_pool, std::unique_ptr<MappedFile>(mf));
+
+  // An input file given as a memory buffer by a library user
+  if (auto it = ctx.memory_inputs.find(path); it != ctx.memory_inputs.end()) {
+    mf->data = (u8 *)it->second.data();
+    mf->size = it->second.size();
+    return mf;
+  }
 
   if (path.starts_with('/') && !ctx.arg.chroot.empty())
     path = ctx.arg.chroot + "/" + path_clean(path);
@@ -626,10 +1378,27 @@ MappedFile<C> *MappedFile<C>::open(C &ctx, std::string path) {
   mf->mtime = (u64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
 #endif
 
-  if (st.st_size > 0) {
+  if (0 < st.st_size && st.st_size <= SMALL_FILE_SIZE) {
+    mf->data = alloc_small_file_buffer(ctx, st.st_size);
+    for (i64 off = 0; off < st.st_size;) {
+      ssize_t n = pread(fd, mf->data + off, st.st_size - off, off);
+      if (n <= 0)
+        Fatal(ctx) << path << ": read failed: " << errno_string();
+      off += n;
+    }
+  } else if (st.st_size > 0) {
     mf->data = (u8 *)mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    mf->is_mmapped = true;
     if (mf->data == MAP_FAILED)
       Fatal(ctx) << path << ": mmap failed: " << errno_string();
+
+    // Input files are opened one after another before we start parsing
+    // them. Ask the kernel to start reading the file contents now, so
+    // that the I/O overlaps with opening the remaining files instead of
+    // being serialized on page faults at first touch. This matters on
+    // slow file systems such as NFS. This is just a hint, so failure is
+    // harmless.
+    madvise(mf->data, st.st_size, MADV_WILLNEED);
   }
 
   close(fd);
@@ -652,13 +1421,31 @@ MappedFile<C>::slice(C &ctx, std::string name, u64 start, u64 size) {
   mf->size = size;
   mf->parent = this;
 
-  ctx.mf_pool.push_back(std::unique_ptr<MappedFile>(mf));
+  push_to_pool(ctx.mf_pool, std::unique_ptr<MappedFile>(mf));
   return mf;
 }
 
+// Drops pages of this file from memory. Since input files are mapped
+// read-only and privately, the pages are read from the file again if
+// they are accessed after this, so this is always safe. Files that are
+// read into memory buffers are not released.
+template <typename C>
+void MappedFile<C>::release() {
+  MappedFile *mf = this;
+  while (mf->parent)
+    mf = mf->parent;
+  if (!mf->is_mmapped || size == 0)
+    return;
+
+  static const i64 page_size = sysconf(_SC_PAGESIZE);
+  u64 begin = align_down((u64)data, page_size);
+  u64 end = align_to((u64)data + size, page_size);
+  madvise((void *)begin, end - begin, MADV_DONTNEED);
+}
+
 template <typename C>
 MappedFile<C>::~MappedFile() {
-  if (size && !parent)
+  if (is_mmapped)
     munmap(data, size);
 }
 
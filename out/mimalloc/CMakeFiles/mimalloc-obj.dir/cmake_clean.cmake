@@ -0,0 +1,9 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/mimalloc-obj.dir/src/static.c.o"
+  "CMakeFiles/mimalloc-obj.dir/src/static.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/mimalloc-obj.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,32 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/third-party/mimalloc/src/alloc-aligned.c" "CMakeFiles/mimalloc-static.dir/src/alloc-aligned.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/alloc-aligned.c.o.d"
+  "/root/repo/third-party/mimalloc/src/alloc-posix.c" "CMakeFiles/mimalloc-static.dir/src/alloc-posix.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/alloc-posix.c.o.d"
+  "/root/repo/third-party/mimalloc/src/alloc.c" "CMakeFiles/mimalloc-static.dir/src/alloc.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/alloc.c.o.d"
+  "/root/repo/third-party/mimalloc/src/arena.c" "CMakeFiles/mimalloc-static.dir/src/arena.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/arena.c.o.d"
+  "/root/repo/third-party/mimalloc/src/bitmap.c" "CMakeFiles/mimalloc-static.dir/src/bitmap.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/bitmap.c.o.d"
+  "/root/repo/third-party/mimalloc/src/heap.c" "CMakeFiles/mimalloc-static.dir/src/heap.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/heap.c.o.d"
+  "/root/repo/third-party/mimalloc/src/init.c" "CMakeFiles/mimalloc-static.dir/src/init.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/init.c.o.d"
+  "/root/repo/third-party/mimalloc/src/options.c" "CMakeFiles/mimalloc-static.dir/src/options.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/options.c.o.d"
+  "/root/repo/third-party/mimalloc/src/os.c" "CMakeFiles/mimalloc-static.dir/src/os.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/os.c.o.d"
+  "/root/repo/third-party/mimalloc/src/page.c" "CMakeFiles/mimalloc-static.dir/src/page.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/page.c.o.d"
+  "/root/repo/third-party/mimalloc/src/random.c" "CMakeFiles/mimalloc-static.dir/src/random.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/random.c.o.d"
+  "/root/repo/third-party/mimalloc/src/region.c" "CMakeFiles/mimalloc-static.dir/src/region.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/region.c.o.d"
+  "/root/repo/third-party/mimalloc/src/segment.c" "CMakeFiles/mimalloc-static.dir/src/segment.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/segment.c.o.d"
+  "/root/repo/third-party/mimalloc/src/stats.c" "CMakeFiles/mimalloc-static.dir/src/stats.c.o" "gcc" "CMakeFiles/mimalloc-static.dir/src/stats.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/mimalloc-test-stress.dir/test/test-stress.c.o"
+  "CMakeFiles/mimalloc-test-stress.dir/test/test-stress.c.o.d"
+  "mimalloc-test-stress"
+  "mimalloc-test-stress.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/mimalloc-test-stress.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
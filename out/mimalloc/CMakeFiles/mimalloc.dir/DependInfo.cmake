@@ -0,0 +1,38 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/third-party/mimalloc/src/alloc-aligned.c" "CMakeFiles/mimalloc.dir/src/alloc-aligned.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/alloc-aligned.c.o.d"
+  "/root/repo/third-party/mimalloc/src/alloc-posix.c" "CMakeFiles/mimalloc.dir/src/alloc-posix.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/alloc-posix.c.o.d"
+  "/root/repo/third-party/mimalloc/src/alloc.c" "CMakeFiles/mimalloc.dir/src/alloc.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/alloc.c.o.d"
+  "/root/repo/third-party/mimalloc/src/arena.c" "CMakeFiles/mimalloc.dir/src/arena.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/arena.c.o.d"
+  "/root/repo/third-party/mimalloc/src/bitmap.c" "CMakeFiles/mimalloc.dir/src/bitmap.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/bitmap.c.o.d"
+  "/root/repo/third-party/mimalloc/src/heap.c" "CMakeFiles/mimalloc.dir/src/heap.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/heap.c.o.d"
+  "/root/repo/third-party/mimalloc/src/init.c" "CMakeFiles/mimalloc.dir/src/init.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/init.c.o.d"
+  "/root/repo/third-party/mimalloc/src/options.c" "CMakeFiles/mimalloc.dir/src/options.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/options.c.o.d"
+  "/root/repo/third-party/mimalloc/src/os.c" "CMakeFiles/mimalloc.dir/src/os.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/os.c.o.d"
+  "/root/repo/third-party/mimalloc/src/page.c" "CMakeFiles/mimalloc.dir/src/page.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/page.c.o.d"
+  "/root/repo/third-party/mimalloc/src/random.c" "CMakeFiles/mimalloc.dir/src/random.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/random.c.o.d"
+  "/root/repo/third-party/mimalloc/src/region.c" "CMakeFiles/mimalloc.dir/src/region.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/region.c.o.d"
+  "/root/repo/third-party/mimalloc/src/segment.c" "CMakeFiles/mimalloc.dir/src/segment.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/segment.c.o.d"
+  "/root/repo/third-party/mimalloc/src/stats.c" "CMakeFiles/mimalloc.dir/src/stats.c.o" "gcc" "CMakeFiles/mimalloc.dir/src/stats.c.o.d"
+  )
+
+# Pairs of files generated by the same build rule.
+set(CMAKE_MULTIPLE_OUTPUT_PAIRS
+  "/root/repo/out/mimalloc/libmimalloc.so" "/root/repo/out/mimalloc/libmimalloc.so.1.7"
+  )
+
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,65 @@
+file(REMOVE_RECURSE
+  "../../gnu_12.2_cxx11_64_relwithdebinfo/libtbb.a"
+  "../../gnu_12.2_cxx11_64_relwithdebinfo/libtbb.pdb"
+  "CMakeFiles/tbb.dir/address_waiter.cpp.o"
+  "CMakeFiles/tbb.dir/address_waiter.cpp.o.d"
+  "CMakeFiles/tbb.dir/allocator.cpp.o"
+  "CMakeFiles/tbb.dir/allocator.cpp.o.d"
+  "CMakeFiles/tbb.dir/arena.cpp.o"
+  "CMakeFiles/tbb.dir/arena.cpp.o.d"
+  "CMakeFiles/tbb.dir/arena_slot.cpp.o"
+  "CMakeFiles/tbb.dir/arena_slot.cpp.o.d"
+  "CMakeFiles/tbb.dir/concurrent_bounded_queue.cpp.o"
+  "CMakeFiles/tbb.dir/concurrent_bounded_queue.cpp.o.d"
+  "CMakeFiles/tbb.dir/dynamic_link.cpp.o"
+  "CMakeFiles/tbb.dir/dynamic_link.cpp.o.d"
+  "CMakeFiles/tbb.dir/exception.cpp.o"
+  "CMakeFiles/tbb.dir/exception.cpp.o.d"
+  "CMakeFiles/tbb.dir/global_control.cpp.o"
+  "CMakeFiles/tbb.dir/global_control.cpp.o.d"
+  "CMakeFiles/tbb.dir/governor.cpp.o"
+  "CMakeFiles/tbb.dir/governor.cpp.o.d"
+  "CMakeFiles/tbb.dir/itt_notify.cpp.o"
+  "CMakeFiles/tbb.dir/itt_notify.cpp.o.d"
+  "CMakeFiles/tbb.dir/main.cpp.o"
+  "CMakeFiles/tbb.dir/main.cpp.o.d"
+  "CMakeFiles/tbb.dir/market.cpp.o"
+  "CMakeFiles/tbb.dir/market.cpp.o.d"
+  "CMakeFiles/tbb.dir/misc.cpp.o"
+  "CMakeFiles/tbb.dir/misc.cpp.o.d"
+  "CMakeFiles/tbb.dir/misc_ex.cpp.o"
+  "CMakeFiles/tbb.dir/misc_ex.cpp.o.d"
+  "CMakeFiles/tbb.dir/observer_proxy.cpp.o"
+  "CMakeFiles/tbb.dir/observer_proxy.cpp.o.d"
+  "CMakeFiles/tbb.dir/parallel_pipeline.cpp.o"
+  "CMakeFiles/tbb.dir/parallel_pipeline.cpp.o.d"
+  "CMakeFiles/tbb.dir/private_server.cpp.o"
+  "CMakeFiles/tbb.dir/private_server.cpp.o.d"
+  "CMakeFiles/tbb.dir/profiling.cpp.o"
+  "CMakeFiles/tbb.dir/profiling.cpp.o.d"
+  "CMakeFiles/tbb.dir/queuing_rw_mutex.cpp.o"
+  "CMakeFiles/tbb.dir/queuing_rw_mutex.cpp.o.d"
+  "CMakeFiles/tbb.dir/rml_tbb.cpp.o"
+  "CMakeFiles/tbb.dir/rml_tbb.cpp.o.d"
+  "CMakeFiles/tbb.dir/rtm_mutex.cpp.o"
+  "CMakeFiles/tbb.dir/rtm_mutex.cpp.o.d"
+  "CMakeFiles/tbb.dir/rtm_rw_mutex.cpp.o"
+  "CMakeFiles/tbb.dir/rtm_rw_mutex.cpp.o.d"
+  "CMakeFiles/tbb.dir/semaphore.cpp.o"
+  "CMakeFiles/tbb.dir/semaphore.cpp.o.d"
+  "CMakeFiles/tbb.dir/small_object_pool.cpp.o"
+  "CMakeFiles/tbb.dir/small_object_pool.cpp.o.d"
+  "CMakeFiles/tbb.dir/task.cpp.o"
+  "CMakeFiles/tbb.dir/task.cpp.o.d"
+  "CMakeFiles/tbb.dir/task_dispatcher.cpp.o"
+  "CMakeFiles/tbb.dir/task_dispatcher.cpp.o.d"
+  "CMakeFiles/tbb.dir/task_group_context.cpp.o"
+  "CMakeFiles/tbb.dir/task_group_context.cpp.o.d"
+  "CMakeFiles/tbb.dir/version.cpp.o"
+  "CMakeFiles/tbb.dir/version.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tbb.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
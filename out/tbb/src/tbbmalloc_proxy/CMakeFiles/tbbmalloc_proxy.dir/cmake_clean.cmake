@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../../gnu_12.2_cxx11_64_relwithdebinfo/libtbbmalloc_proxy.a"
+  "../../gnu_12.2_cxx11_64_relwithdebinfo/libtbbmalloc_proxy.pdb"
+  "CMakeFiles/tbbmalloc_proxy.dir/function_replacement.cpp.o"
+  "CMakeFiles/tbbmalloc_proxy.dir/function_replacement.cpp.o.d"
+  "CMakeFiles/tbbmalloc_proxy.dir/proxy.cpp.o"
+  "CMakeFiles/tbbmalloc_proxy.dir/proxy.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tbbmalloc_proxy.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
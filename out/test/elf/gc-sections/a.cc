@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+int two() { return 2; }
+
+int live_var1 = 1;
+int live_var2 = two();
+int dead_var1 = 3;
+int dead_var2 = 4;
+
+void live_fn1() {}
+void live_fn2() { live_fn1(); }
+void dead_fn1() {}
+void dead_fn2() { dead_fn1(); }
+
+int main() {
+  printf("%d %d\n", live_var1, live_var2);
+  live_fn2();
+}
@@ -0,0 +1,6 @@
+extern long ext_var;
+void print64(long);
+
+int main() {
+  print64(ext_var);
+}
@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+extern _Thread_local int x1;
+static _Thread_local int x2 = 2;
+static _Thread_local int x3 = 3;
+
+int main() {
+  x1 += 10;
+  x2 += 10;
+  printf("%d %d %d\n", x1, x2, x3);
+  return 0;
+}
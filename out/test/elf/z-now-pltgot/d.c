@@ -0,0 +1,3 @@
+#include <stdio.h>
+void hello();
+int main() { void (*p)() = hello; printf("%d ", p == hello); hello(); }
@@ -4,7 +4,14 @@
 #include <iomanip>
 #include <ios>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/time.h>
+#include <tbb/task_scheduler_observer.h>
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#endif
 
 namespace mold {
 
@@ -12,14 +19,24 @@ i64 Counter::get_value() {
   return values.combine(std::plus());
 }
 
-void Counter::print() {
-  sort(instances, [](Counter *a, Counter *b) {
-    return a->get_value() > b->get_value();
-  });
-
+std::vector<i64> Counter::snapshot() {
+  std::lock_guard lock(mu);
+  std::vector<i64> vec;
   for (Counter *c : instances)
-    std::cout << std::setw(20) << std::right << c->name
-              << "=" << c->get_value() << "\n";
+    vec.push_back(c->get_value());
+  return vec;
+}
+
+Histogram::Data Histogram::get_value() {
+  Data res;
+  for (Data &data : values) {
+    res.count += data.count;
+    res.sum += data.sum;
+    res.max = std::max(res.max, data.max);
+    for (i64 i = 0; i < std::size(res.buckets); i++)
+      res.buckets[i] += data.buckets[i];
+  }
+  return res;
 }
 
 static i64 now_nsec() {
@@ -32,6 +49,12 @@ static i64 to_nsec(struct timeval t) {
   return (i64)t.tv_sec * 1000000000 + t.tv_usec * 1000;
 }
 
+static i64 get_tid() {
+  static std::atomic<i64> counter;
+  thread_local i64 tid = counter++;
+  return tid;
+}
+
 TimerRecord::TimerRecord(std::string name, TimerRecord *parent)
   : name(name), parent(parent) {
   struct rusage usage;
@@ -40,6 +63,18 @@ TimerRecord::TimerRecord(std::string name, TimerRecord *parent)
   start = now_nsec();
   user = to_nsec(usage.ru_utime);
   sys = to_nsec(usage.ru_stime);
+  maxrss = usage.ru_maxrss;
+  minflt = usage.ru_minflt;
+  majflt = usage.ru_majflt;
+  nvcsw = usage.ru_nvcsw;
+  nivcsw = usage.ru_nivcsw;
+  tid = get_tid();
+
+  if (Counter::enabled)
+    counters = Counter::snapshot();
+
+  if (HwCounters::enabled)
+    hw = HwCounters::snapshot();
 
   if (parent)
     parent->children.push_back(this);
@@ -56,26 +91,394 @@ void TimerRecord::stop() {
   end = now_nsec();
   user = to_nsec(usage.ru_utime) - user;
   sys = to_nsec(usage.ru_stime) - sys;
+  maxrss = usage.ru_maxrss - maxrss;
+  minflt = usage.ru_minflt - minflt;
+  majflt = usage.ru_majflt - majflt;
+  nvcsw = usage.ru_nvcsw - nvcsw;
+  nivcsw = usage.ru_nivcsw - nivcsw;
+
+  if (Counter::enabled) {
+    std::vector<i64> vec = Counter::snapshot();
+    for (i64 i = 0; i < counters.size(); i++)
+      vec[i] -= counters[i];
+    counters = std::move(vec);
+  }
+
+  if (HwCounters::enabled) {
+    std::array<i64, HwCounters::NUM> vals = HwCounters::snapshot();
+    for (i64 i = 0; i < HwCounters::NUM; i++)
+      hw[i] = vals[i] - hw[i];
+  }
+}
+
+#ifdef __linux__
+namespace {
+// perf_event_open(2) file descriptors of one thread. -1 means that
+// the event is not supported.
+typedef std::array<int, HwCounters::NUM> HwCounterFds;
+
+// Opens counters for the current thread when it joins the thread pool.
+class HwCounterObserver : public tbb::task_scheduler_observer {
+public:
+  void on_scheduler_entry(bool) override;
+
+  std::mutex mu;
+  std::vector<HwCounterFds> threads;
+};
+}
+
+static HwCounterObserver *observer;
+
+static HwCounterFds open_hw_counters() {
+  static const std::pair<u32, u64> events[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+
+  HwCounterFds fds;
+  for (i64 i = 0; i < HwCounters::NUM; i++) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = events[i].first;
+    attr.config = events[i].second;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // The kernel multiplexes counters if there are more events than
+    // hardware counters. We scale the values by these times.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  return fds;
+}
+
+void HwCounterObserver::on_scheduler_entry(bool) {
+  // A worker thread may join and leave the arena many times.
+  thread_local bool opened = false;
+  if (opened)
+    return;
+  opened = true;
+
+  HwCounterFds fds = open_hw_counters();
+  std::lock_guard lock(mu);
+  threads.push_back(fds);
+}
+
+bool HwCounters::enable() {
+  if (enabled)
+    return true;
+
+  HwCounterFds fds = open_hw_counters();
+  if (fds[CYCLES] == -1)
+    return false;
+
+  observer = new HwCounterObserver;
+  observer->threads.push_back(fds);
+  observer->observe(true);
+  enabled = true;
+  return true;
+}
+
+std::array<i64, HwCounters::NUM> HwCounters::snapshot() {
+  std::array<i64, NUM> vals = {};
+  std::lock_guard lock(observer->mu);
+
+  for (HwCounterFds &fds : observer->threads) {
+    for (i64 i = 0; i < NUM; i++) {
+      u64 buf[3];
+      if (fds[i] == -1 || read(fds[i], buf, sizeof(buf)) != sizeof(buf))
+        continue;
+      if (buf[2])
+        vals[i] += (double)buf[0] * buf[1] / buf[2];
+    }
+  }
+  return vals;
+}
+#else
+bool HwCounters::enable() {
+  return false;
+}
+
+std::array<i64, HwCounters::NUM> HwCounters::snapshot() {
+  return {};
+}
+#endif
+
+i64 TaskTimer::get_time() {
+  return now_nsec();
+}
+
+TaskTimer::~TaskTimer() {
+  if (parent)
+    parent->tasks.push_back({name, start, now_nsec(), get_tid()});
+}
+
+void Progress::write(const std::string &line) {
+  std::string buf = line + "\n";
+
+  // Use send(2) if possible so that a reader that has gone away
+  // doesn't kill us with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+  i64 n = send(fd, buf.data(), buf.size(), MSG_NOSIGNAL);
+  if (n == -1 && errno == ENOTSOCK)
+    n = ::write(fd, buf.data(), buf.size());
+#else
+  i64 n = ::write(fd, buf.data(), buf.size());
+#endif
+
+  // Progress reports are best-effort. Stop if the reader is gone.
+  if (n == -1 && errno != EINTR && errno != EAGAIN)
+    fd = -1;
+}
+
+// Reports at most every 100 milliseconds.
+void ProgressCounter::maybe_report(i64 val) {
+  i64 now = now_nsec();
+  i64 last = last_time;
+  if (now - last >= 100000000 && last_time.compare_exchange_strong(last, now))
+    report(val);
+}
+
+void ProgressCounter::report(i64 val) {
+  Progress::write("progress " + std::string(name) + " " +
+                  std::to_string(val) + " " + std::to_string(total));
+}
+
+namespace {
+// Statistics of tasks recorded by TaskTimer for one parallel loop
+struct LoadBalance {
+  LoadBalance(TimerRecord &rec);
+
+  double get_mean() const {
+    return (double)total / std::max<i64>(1, num_tasks);
+  }
+
+  // The ratio of the slowest task to the average one. A large number
+  // means that a few stragglers keep the other threads idle.
+  double get_imbalance() const {
+    return max / std::max(1.0, get_mean());
+  }
+
+  i64 num_tasks = 0;
+  i64 num_threads = 0;
+  i64 max = 0;
+  i64 total = 0;
+  std::string_view slowest;
+
+  // The sum of task times for each thread, indexed by tid
+  std::vector<i64> busy;
+};
+}
+
+LoadBalance::LoadBalance(TimerRecord &rec) {
+  num_tasks = rec.tasks.size();
+
+  for (TaskRecord &task : rec.tasks) {
+    i64 dur = task.end - task.start;
+    total += dur;
+    if (max < dur) {
+      max = dur;
+      slowest = task.name;
+    }
+
+    if (busy.size() <= task.tid)
+      busy.resize(task.tid + 1);
+    busy[task.tid] += dur;
+  }
+
+  for (i64 x : busy)
+    if (x)
+      num_threads++;
+}
+
+static void print_load_balance(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+  bool header = false;
+
+  for (std::unique_ptr<TimerRecord> &rec : records) {
+    if (rec->tasks.empty())
+      continue;
+
+    if (!header) {
+      std::cout << "\n   Tasks Threads  Max(ms) Mean(ms) Max/Mean  "
+                   "Busy(%)  Name (slowest task)\n";
+      header = true;
+    }
+
+    // Busy(%) is the fraction of the wall-clock time of the loop during
+    // which threads that took part in it were running tasks.
+    LoadBalance lb(*rec);
+    i64 wall = std::max<i64>(1, rec->end - rec->start);
+
+    printf(" % 7lld % 7lld % 8.3f % 8.3f % 8.2f % 8.1f  %s (%.*s)\n",
+           (long long)lb.num_tasks, (long long)lb.num_threads,
+           (double)lb.max / 1000000, lb.get_mean() / 1000000,
+           lb.get_imbalance(),
+           100.0 * lb.total / wall / std::max<i64>(1, lb.num_threads),
+           rec->name.c_str(), (int)lb.slowest.size(), lb.slowest.data());
+  }
 }
 
 static void print_rec(TimerRecord &rec, i64 indent) {
-  printf(" % 8.3f % 8.3f % 8.3f  %s%s\n",
+  printf(" % 8.3f % 8.3f % 8.3f % 8.1f % 8lld % 6lld % 7lld % 7lld  %s%s\n",
          ((double)rec.user / 1000000000),
          ((double)rec.sys / 1000000000),
          (((double)rec.end - rec.start) / 1000000000),
+         ((double)rec.maxrss / 1024),
+         (long long)rec.minflt,
+         (long long)rec.majflt,
+         (long long)rec.nvcsw,
+         (long long)rec.nivcsw,
          std::string(indent * 2, ' ').c_str(),
          rec.name.c_str());
 
-  sort(rec.children, [](TimerRecord *a, TimerRecord *b) {
-    return a->start < b->start;
-  });
-
   for (TimerRecord *child : rec.children)
     print_rec(*child, indent + 1);
 }
 
-void print_timer_records(
-    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+// Prints hardware counters in millions. IPC (instructions per cycle)
+// tells whether a phase is compute-bound (high) or memory-bound (low).
+static void print_hw_rec(TimerRecord &rec, i64 indent) {
+  i64 cycles = rec.hw[HwCounters::CYCLES];
+  double ipc = cycles ? (double)rec.hw[HwCounters::INSTRUCTIONS] / cycles : 0;
+
+  printf(" % 9.1f % 9.1f % 5.2f % 8.2f % 8.2f % 9.2f  %s%s\n",
+         (double)cycles / 1000000,
+         (double)rec.hw[HwCounters::INSTRUCTIONS] / 1000000,
+         ipc,
+         (double)rec.hw[HwCounters::LLC_MISSES] / 1000000,
+         (double)rec.hw[HwCounters::DTLB_MISSES] / 1000000,
+         (double)rec.hw[HwCounters::BRANCH_MISSES] / 1000000,
+         std::string(indent * 2, ' ').c_str(),
+         rec.name.c_str());
+
+  for (TimerRecord *child : rec.children)
+    print_hw_rec(*child, indent + 1);
+}
+
+static std::string json_string(std::string_view str) {
+  std::string buf = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      buf += '\\';
+      buf += c;
+    } else if ((u8)c < 0x20) {
+      char tmp[7];
+      snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+      buf += tmp;
+    } else {
+      buf += c;
+    }
+  }
+  return buf + "\"";
+}
+
+// Formats a duration in nanoseconds in a given unit without losing
+// precision to scientific notation.
+static std::string format_time(i64 nsec, i64 unit) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.6f", (double)nsec / unit);
+  return buf;
+}
+
+static void print_rusage_json(TimerRecord &rec) {
+  std::cout << "\"maxrss_kb\":" << rec.maxrss
+            << ",\"minflt\":" << rec.minflt
+            << ",\"majflt\":" << rec.majflt
+            << ",\"nvcsw\":" << rec.nvcsw
+            << ",\"nivcsw\":" << rec.nivcsw;
+
+  if (HwCounters::enabled)
+    std::cout << ",\"cycles\":" << rec.hw[HwCounters::CYCLES]
+              << ",\"instructions\":" << rec.hw[HwCounters::INSTRUCTIONS]
+              << ",\"llc_misses\":" << rec.hw[HwCounters::LLC_MISSES]
+              << ",\"dtlb_misses\":" << rec.hw[HwCounters::DTLB_MISSES]
+              << ",\"branch_misses\":" << rec.hw[HwCounters::BRANCH_MISSES];
+}
+
+static void print_json(TimerRecord &rec) {
+  std::cout << "{\"name\":" << json_string(rec.name)
+            << ",\"user\":" << format_time(rec.user, 1000000000)
+            << ",\"sys\":" << format_time(rec.sys, 1000000000)
+            << ",\"real\":" << format_time(rec.end - rec.start, 1000000000)
+            << ",";
+  print_rusage_json(rec);
+
+  if (!rec.tasks.empty()) {
+    LoadBalance lb(rec);
+    std::cout << ",\"tasks\":{\"count\":" << lb.num_tasks
+              << ",\"max\":" << format_time(lb.max, 1000000000)
+              << ",\"mean\":" << format_time(lb.get_mean(), 1000000000)
+              << ",\"slowest\":" << json_string(lb.slowest)
+              << ",\"busy\":{";
+
+    bool first = true;
+    for (i64 i = 0; i < lb.busy.size(); i++) {
+      if (lb.busy[i]) {
+        if (!first)
+          std::cout << ",";
+        first = false;
+        std::cout << "\"" << i << "\":" << format_time(lb.busy[i], 1000000000);
+      }
+    }
+    std::cout << "}}";
+  }
+
+  std::cout << ",\"children\":[";
+
+  for (i64 i = 0; i < rec.children.size(); i++) {
+    if (i)
+      std::cout << ",";
+    print_json(*rec.children[i]);
+  }
+  std::cout << "]}";
+}
+
+// Prints records in the Chrome trace event format. Each record becomes
+// a "complete" event whose timestamp and duration are in microseconds.
+static void
+print_chrome_trace(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+  i64 base = records.empty() ? 0 : records[0]->start;
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    base = std::min(base, rec->start);
+
+  std::cout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  for (i64 i = 0; i < records.size(); i++) {
+    TimerRecord &rec = *records[i];
+    if (i)
+      std::cout << ",";
+    std::cout << "\n{\"name\":" << json_string(rec.name)
+              << ",\"ph\":\"X\",\"pid\":" << getpid()
+              << ",\"tid\":" << rec.tid
+              << ",\"ts\":" << format_time(rec.start - base, 1000)
+              << ",\"dur\":" << format_time(rec.end - rec.start, 1000)
+              << ",\"args\":{\"user\":" << format_time(rec.user, 1000000000)
+              << ",\"sys\":" << format_time(rec.sys, 1000000000) << ",";
+    print_rusage_json(rec);
+    std::cout << "}}";
+
+    for (TaskRecord &task : rec.tasks)
+      std::cout << ",\n{\"name\":" << json_string(task.name)
+                << ",\"cat\":\"task\",\"ph\":\"X\",\"pid\":" << getpid()
+                << ",\"tid\":" << task.tid
+                << ",\"ts\":" << format_time(task.start - base, 1000)
+                << ",\"dur\":" << format_time(task.end - task.start, 1000)
+                << ",\"args\":{\"loop\":" << json_string(rec.name) << "}}";
+  }
+  std::cout << "\n]}\n";
+}
+
+// Stops all timers and links each record to the innermost record
+// that encloses it.
+static void
+build_timer_tree(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
   for (i64 i = records.size() - 1; i >= 0; i--)
     records[i]->stop();
 
@@ -94,13 +497,262 @@ void print_timer_records(
     }
   }
 
-  std::cout << "     User   System     Real  Name\n";
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    sort(rec->children, [](TimerRecord *a, TimerRecord *b) {
+      return a->start < b->start;
+    });
+}
+
+void print_timer_records(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+    PerfFormat format) {
+  build_timer_tree(records);
+
+  switch (format) {
+  case PERF_TEXT:
+    std::cout << "     User   System     Real  RSS(MB)   MinFlt MajFlt   "
+                 "VolCS InvolCS  Name\n";
+
+    for (std::unique_ptr<TimerRecord> &rec : records)
+      if (!rec->parent)
+        print_rec(*rec, 0);
 
+    if (HwCounters::enabled) {
+      std::cout << "\n Cycles(M) Instrs(M)   IPC   LLC(M)  dTLB(M) "
+                   "BrMiss(M)  Name\n";
+      for (std::unique_ptr<TimerRecord> &rec : records)
+        if (!rec->parent)
+          print_hw_rec(*rec, 0);
+    }
+
+    print_load_balance(records);
+    break;
+  case PERF_JSON: {
+    std::cout << "[";
+    bool first = true;
+    for (std::unique_ptr<TimerRecord> &rec : records) {
+      if (!rec->parent) {
+        if (!first)
+          std::cout << ",";
+        first = false;
+        print_json(*rec);
+      }
+    }
+    std::cout << "]\n";
+    break;
+  }
+  case PERF_CHROME_TRACE:
+    print_chrome_trace(records);
+    break;
+  }
+
+  std::cout << std::flush;
+}
+
+static void serialize_rec(TimerRecord &rec, i64 depth, std::string &out) {
+  out += std::to_string(depth) + "\t" + std::to_string(rec.end - rec.start) +
+         "\t" + rec.name + "\n";
+  for (TimerRecord *child : rec.children)
+    serialize_rec(*child, depth + 1, out);
+}
+
+// Serializes timer records as "depth\tnanoseconds\tname" lines in
+// depth-first order for print_perf_sweep().
+std::string
+serialize_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records) {
+  build_timer_tree(records);
+
+  std::string out;
   for (std::unique_ptr<TimerRecord> &rec : records)
     if (!rec->parent)
-      print_rec(*rec, 0);
+      serialize_rec(*rec, 0, out);
+  return out;
+}
 
-  std::cout << std::flush;
+// Prints the wall time of each phase at each thread count along with
+// its speedup and parallel efficiency relative to the first thread
+// count. A phase whose efficiency drops quickly as threads are added
+// is serial or limited by memory bandwidth, and by Amdahl's law it
+// bounds the speedup of the whole link.
+void print_perf_sweep(std::span<const i64> threads,
+                      std::span<const std::string> results) {
+  struct Row {
+    i64 depth;
+    std::string name;
+    std::vector<i64> nsec;
+  };
+
+  // Phases are identified by their paths in the timer tree, and rows
+  // are in the order in which they first appear.
+  std::vector<Row> rows;
+  std::unordered_map<std::string, i64> index;
+
+  for (i64 i = 0; i < results.size(); i++) {
+    std::vector<std::string> path;
+    std::istringstream in(results[i]);
+    std::string line;
+
+    while (std::getline(in, line)) {
+      size_t p1 = line.find('\t');
+      size_t p2 = line.find('\t', p1 + 1);
+      if (p1 == line.npos || p2 == line.npos)
+        continue;
+
+      i64 depth = std::stoll(line.substr(0, p1));
+      i64 nsec = std::stoll(line.substr(p1 + 1, p2 - p1 - 1));
+      std::string name = line.substr(p2 + 1);
+
+      path.resize(depth);
+      path.push_back(name);
+
+      std::string key;
+      for (std::string &s : path)
+        key += s + "\n";
+
+      auto [it, inserted] = index.insert({key, rows.size()});
+      if (inserted)
+        rows.push_back({depth, name, std::vector<i64>(threads.size())});
+      rows[it->second].nsec[i] += nsec;
+    }
+  }
+
+  std::cout << std::setw(14) << ("threads=" + std::to_string(threads[0]));
+  for (i64 i = 1; i < threads.size(); i++)
+    std::cout << std::setw(23) << ("threads=" + std::to_string(threads[i]));
+  std::cout << "\n";
+
+  std::cout << "          Real";
+  for (i64 i = 1; i < threads.size(); i++)
+    std::cout << "     Real Speedup   Eff";
+  std::cout << "  Name\n";
+
+  for (Row &row : rows) {
+    printf(" % 13.3f", (double)row.nsec[0] / 1000000000);
+
+    for (i64 i = 1; i < threads.size(); i++) {
+      if (row.nsec[0] == 0 || row.nsec[i] == 0) {
+        printf(" % 8.3f       -     -", (double)row.nsec[i] / 1000000000);
+        continue;
+      }
+
+      double speedup = (double)row.nsec[0] / row.nsec[i];
+      double efficiency = speedup * threads[0] / threads[i];
+      printf(" % 8.3f % 6.2fx % 4.0f%%", (double)row.nsec[i] / 1000000000,
+             speedup, efficiency * 100);
+    }
+
+    printf("  %s%s\n", std::string(row.depth * 2, ' ').c_str(),
+           row.name.c_str());
+  }
+}
+
+// Returns the range of values of the i'th histogram bucket.
+static std::pair<i64, i64> get_bucket_range(i64 i) {
+  if (i == 0)
+    return {0, 0};
+  return {(i64)1 << (i - 1), (i64)(((u64)1 << i) - 1)};
+}
+
+void print_stats(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+                 StatsFormat format) {
+  std::vector<Counter *> &counters = Counter::instances;
+  std::vector<i64> values = Counter::snapshot();
+
+  std::vector<i64> order(values.size());
+  for (i64 i = 0; i < order.size(); i++)
+    order[i] = i;
+
+  sort(order, [&](i64 a, i64 b) { return values[a] > values[b]; });
+
+  // Timers whose counter deltas are all zero are not interesting.
+  std::vector<TimerRecord *> phases;
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    if (rec->stopped && std::any_of(rec->counters.begin(), rec->counters.end(),
+                                    [](i64 x) { return x != 0; }))
+      phases.push_back(rec.get());
+
+  if (format == STATS_TEXT) {
+    for (i64 i : order)
+      std::cout << std::setw(20) << std::right << counters[i]->name
+                << "=" << values[i] << "\n";
+
+    for (Histogram *h : Histogram::instances) {
+      Histogram::Data data = h->get_value();
+      std::cout << "\n" << h->name << ": count=" << data.count
+                << " sum=" << data.sum << " max=" << data.max << "\n";
+
+      for (i64 i = 0; i < std::size(data.buckets); i++) {
+        if (data.buckets[i]) {
+          auto [lo, hi] = get_bucket_range(i);
+          std::cout << std::setw(20) << std::right
+                    << (std::to_string(lo) + "-" + std::to_string(hi))
+                    << " " << data.buckets[i] << "\n";
+        }
+      }
+    }
+
+    for (TimerRecord *rec : phases) {
+      std::cout << "\n" << rec->name << ":\n";
+      for (i64 i : order)
+        if (i < rec->counters.size() && rec->counters[i])
+          std::cout << std::setw(20) << std::right << counters[i]->name
+                    << "=" << rec->counters[i] << "\n";
+    }
+    std::cout << std::flush;
+    return;
+  }
+
+  auto print_counters = [&](std::vector<i64> &vals) {
+    std::cout << "{";
+    bool first = true;
+    for (i64 i : order) {
+      if (i < vals.size() && vals[i]) {
+        if (!first)
+          std::cout << ",";
+        first = false;
+        std::cout << json_string(counters[i]->name) << ":" << vals[i];
+      }
+    }
+    std::cout << "}";
+  };
+
+  std::cout << "{\"counters\":";
+  print_counters(values);
+
+  std::cout << ",\n\"histograms\":{";
+  for (i64 i = 0; i < Histogram::instances.size(); i++) {
+    Histogram *h = Histogram::instances[i];
+    Histogram::Data data = h->get_value();
+    if (i)
+      std::cout << ",";
+    std::cout << "\n" << json_string(h->name) << ":{\"count\":" << data.count
+              << ",\"sum\":" << data.sum << ",\"max\":" << data.max
+              << ",\"buckets\":[";
+
+    bool first = true;
+    for (i64 j = 0; j < std::size(data.buckets); j++) {
+      if (data.buckets[j]) {
+        if (!first)
+          std::cout << ",";
+        first = false;
+        auto [lo, hi] = get_bucket_range(j);
+        std::cout << "{\"min\":" << lo << ",\"max\":" << hi
+                  << ",\"count\":" << data.buckets[j] << "}";
+      }
+    }
+    std::cout << "]}";
+  }
+
+  std::cout << "},\n\"phases\":[";
+  for (i64 i = 0; i < phases.size(); i++) {
+    if (i)
+      std::cout << ",";
+    std::cout << "\n{\"name\":" << json_string(phases[i]->name)
+              << ",\"counters\":";
+    print_counters(phases[i]->counters);
+    std::cout << "}";
+  }
+  std::cout << "\n]}\n" << std::flush;
 }
 
 } // namespace mold
@@ -0,0 +1,660 @@
+// This file implements --preload (a resident daemon that preloads
+// input files), --fork (a child process that hides exit latency) and
+// --perf-sweep (a child process for each thread count).
+// They are shared between the ELF and Mach-O linkers.
+
+#pragma once
+
+#include "mold.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <tbb/parallel_for_each.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#ifdef __linux__
+#  include <sys/inotify.h>
+#endif
+
+#ifdef __APPLE__
+#  define COMMON_DIGEST_FOR_OPENSSL
+#  include <CommonCrypto/CommonDigest.h>
+#else
+#  include <openssl/sha.h>
+#endif
+
+#define DAEMON_TIMEOUT 30
+
+// The daemon re-reads updated input files once no more updates have
+// been observed for this many milliseconds.
+#define DAEMON_RELOAD_DELAY 100
+
+namespace mold {
+
+// Returns true if a given file has been modified since it was mapped.
+// A file is identified by a (name, size, mtime) tuple, which is the
+// same key as FileCache uses.
+template <typename C>
+bool is_updated(C &ctx, MappedFile<C> *mf) {
+  struct stat st;
+  if (stat(mf->name.c_str(), &st) < 0)
+    Fatal(ctx) << mf->name << ": stat failed: " << errno_string();
+
+#ifdef __APPLE__
+  i64 mtime = (u64)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  i64 mtime = (u64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  return st.st_size != mf->size || mtime != mf->mtime;
+}
+
+// Exiting from a program with large memory usage is slow --
+// it may take a few hundred milliseconds. To hide the latency,
+// we fork a child and let it do the actual linking work.
+//
+// fork may fail if the system is low on memory (e.g. in a container
+// whose memory limit accounts for committed memory). That's not
+// fatal; we just link in the current process.
+inline std::function<void()> fork_child() {
+  int pipefd[2];
+  if (pipe(pipefd) == -1)
+    return {};
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return {};
+  }
+
+  if (pid > 0) {
+    // Parent
+    close(pipefd[1]);
+
+    char buf[1];
+    if (read(pipefd[0], buf, 1) == 1)
+      _exit(0);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    if (WIFEXITED(status))
+      _exit(WEXITSTATUS(status));
+    if (WIFSIGNALED(status))
+      raise(WTERMSIG(status));
+    _exit(1);
+  }
+
+  // Child
+  close(pipefd[0]);
+
+  return [=]() {
+    char buf[] = {1};
+    int n = write(pipefd[1], buf, 1);
+    assert(n == 1);
+  };
+}
+
+// --perf-sweep links the same inputs at each of the given thread
+// counts. The parent reads input files once and forks a child for
+// each thread count, which inherits the files and does the rest of
+// the link. Children run one at a time so that they don't compete for
+// CPUs, and they send their timer records back over a pipe. Once all
+// children have finished, the parent prints a table comparing them and
+// exits.
+//
+// Returns the thread count in a child. The parent doesn't return.
+template <typename C>
+i64 fork_perf_sweep(C &ctx) {
+  std::vector<std::string> results;
+
+  for (i64 threads : ctx.arg.perf_sweep) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1)
+      Fatal(ctx) << "pipe failed: " << errno_string();
+
+    std::cout << std::flush;
+    std::cerr << std::flush;
+
+    pid_t pid = fork();
+    if (pid == -1)
+      Fatal(ctx) << "fork failed: " << errno_string();
+
+    if (pid == 0) {
+      // Child
+      close(pipefd[0]);
+      ctx.perf_sweep_fd = pipefd[1];
+      return threads;
+    }
+
+    // Parent
+    close(pipefd[1]);
+
+    std::string buf;
+    char tmp[4096];
+    for (;;) {
+      i64 n = read(pipefd[0], tmp, sizeof(tmp));
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      buf.append(tmp, n);
+    }
+    close(pipefd[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      Fatal(ctx) << "--perf-sweep: link with " << threads
+                 << " threads failed";
+    results.push_back(std::move(buf));
+  }
+
+  print_perf_sweep(ctx.arg.perf_sweep, results);
+  std::cout << std::flush;
+  _exit(0);
+}
+
+// If we didn't fork, the caller has to wait for the kernel to tear
+// down our address space after we exit. We hide part of that latency
+// without fork by closing stdout and stderr first, so that a caller
+// reading them sees EOF, and by dropping page table entries of mmap'ed
+// input files in parallel, which the kernel would otherwise do on a
+// single thread at exit.
+template <typename C>
+void release_process_memory(C &ctx) {
+  fclose(stdout);
+  fclose(stderr);
+
+  tbb::parallel_for_each(ctx.mf_pool, [](std::unique_ptr<MappedFile<C>> &mf) {
+    if (mf->size && !mf->parent)
+      madvise(mf->data, mf->size, MADV_DONTNEED);
+  });
+}
+
+inline std::string base64(u8 *data, u64 size) {
+  static const char chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+_";
+
+  std::ostringstream out;
+
+  auto encode = [&](u32 x) {
+    out << chars[x & 0b111111]
+        << chars[(x >> 6) & 0b111111]
+        << chars[(x >> 12) & 0b111111]
+        << chars[(x >> 18) & 0b111111];
+  };
+
+  i64 i = 0;
+  for (; i < size - 3; i += 3)
+    encode((data[i + 2] << 16) | (data[i + 1] << 8) | data[i]);
+
+  if (i == size - 1)
+    encode(data[i]);
+  else if (i == size - 2)
+    encode((data[i + 1] << 8) | data[i]);
+  return out.str();
+}
+
+// We ignore linker plugin options, but the GCC driver passes a
+// temporary file name, which differs on each invocation, as a plugin
+// option. This function removes them so that they don't affect the
+// identity of a link.
+inline std::vector<std::string_view>
+remove_plugin_args(std::span<std::string_view> args) {
+  std::vector<std::string_view> vec;
+
+  for (i64 i = 0; i < args.size(); i++) {
+    std::string_view arg = args[i];
+    if (arg == "-plugin" || arg == "--plugin" ||
+        arg == "-plugin-opt" || arg == "--plugin-opt") {
+      i++;
+      continue;
+    }
+
+    if (!arg.starts_with("-plugin") && !arg.starts_with("--plugin"))
+      vec.push_back(arg);
+  }
+  return vec;
+}
+
+inline std::string compute_sha256(std::span<std::string_view> argv) {
+  SHA256_CTX sha;
+  SHA256_Init(&sha);
+
+  for (std::string_view arg : remove_plugin_args(argv)) {
+    if (arg != "-preload" && arg != "--preload") {
+      SHA256_Update(&sha, arg.data(), arg.size());
+      char buf[] = {0};
+      SHA256_Update(&sha, buf, 1);
+    }
+  }
+
+  u8 digest[32];
+  SHA256_Final(digest, &sha);
+  return base64(digest, sizeof(digest));
+}
+
+// Sends a file descriptor over a Unix domain socket. Returns false
+// on error.
+inline bool try_send_fd(i64 conn, i64 fd) {
+  struct iovec iov;
+  char dummy = '1';
+  iov.iov_base = &dummy;
+  iov.iov_len = 1;
+
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  char buf[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = buf;
+  msg.msg_controllen = CMSG_LEN(sizeof(int));
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  *(int *)CMSG_DATA(cmsg) = fd;
+
+  return sendmsg(conn, &msg, 0) != -1;
+}
+
+template <typename C>
+void send_fd(C &ctx, i64 conn, i64 fd) {
+  if (!try_send_fd(conn, fd))
+    Fatal(ctx) << "sendmsg failed: " << errno_string();
+}
+
+// Receives a file descriptor from a Unix domain socket. Returns -1 on
+// error or if the peer has closed the connection.
+inline i64 try_recv_fd(i64 conn) {
+  struct iovec iov;
+  char buf[1];
+  iov.iov_base = buf;
+  iov.iov_len = sizeof(buf);
+
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  char cmsgbuf[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = (caddr_t)cmsgbuf;
+  msg.msg_controllen = sizeof(cmsgbuf);
+
+  if (recvmsg(conn, &msg, 0) <= 0)
+    return -1;
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS)
+    return -1;
+  return *(int *)CMSG_DATA(cmsg);
+}
+
+template <typename C>
+i64 recv_fd(C &ctx, i64 conn) {
+  i64 fd = try_recv_fd(conn);
+  if (fd == -1)
+    Fatal(ctx) << "recvmsg failed: " << errno_string();
+  return fd;
+}
+
+// InputWatcher watches input files for updates using inotify. We watch
+// directories containing input files rather than files themselves
+// because compilers often write a new file to a temporary path and
+// then rename it. Updates are not detected on non-Linux systems.
+template <typename C>
+class InputWatcher {
+public:
+  InputWatcher(C &ctx) {
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1)
+      return;
+
+    for (std::unique_ptr<MappedFile<C>> &mf : ctx.mf_pool) {
+      if (mf->parent || mf->name.empty())
+        continue;
+
+      std::string dir(path_dirname(mf->name));
+      i64 wd = inotify_add_watch(fd, dir.empty() ? "/" : dir.c_str(),
+                                 IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd != -1)
+        files.insert(std::to_string(wd) + "/" +
+                     std::string(path_filename(mf->name)));
+    }
+#endif
+  }
+
+  ~InputWatcher() {
+    if (fd != -1)
+      close(fd);
+  }
+
+  // Consumes pending events. Returns true if any of them is about
+  // an input file.
+  bool read_events() {
+    bool updated = false;
+#ifdef __linux__
+    alignas(struct inotify_event) char buf[4096];
+    for (;;) {
+      i64 n = read(fd, buf, sizeof(buf));
+      if (n <= 0)
+        break;
+
+      for (char *p = buf; p < buf + n;) {
+        struct inotify_event *ev = (struct inotify_event *)p;
+        p += sizeof(*ev) + ev->len;
+
+        if ((ev->mask & IN_Q_OVERFLOW) ||
+            (ev->len && files.contains(std::to_string(ev->wd) + "/" +
+                                       ev->name)))
+          updated = true;
+      }
+    }
+#endif
+    return updated;
+  }
+
+  i64 fd = -1;
+
+private:
+  // Watch descriptors of directories and base names of input files
+  // concatenated with "/"
+  std::unordered_set<std::string> files;
+};
+
+template <typename C>
+void try_resume_daemon(C &ctx) {
+  i64 conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (conn == -1)
+    Fatal(ctx) << "socket failed: " << errno_string();
+
+  std::string path = "/tmp/mold-" + compute_sha256(ctx.cmdline_args);
+
+  struct sockaddr_un name = {};
+  name.sun_family = AF_UNIX;
+  memcpy(name.sun_path, path.data(), path.size());
+
+  if (connect(conn, (struct sockaddr *)&name, sizeof(name)) != 0) {
+    close(conn);
+    return;
+  }
+
+  // The daemon may close the connection without serving us, in which
+  // case we link by ourselves. Don't get killed by SIGPIPE meanwhile.
+  void (*handler)(int) = signal(SIGPIPE, SIG_IGN);
+  bool ok = try_send_fd(conn, STDOUT_FILENO) &&
+            try_send_fd(conn, STDERR_FILENO);
+  signal(SIGPIPE, handler);
+
+  if (!ok) {
+    close(conn);
+    return;
+  }
+
+  char buf[1];
+  i64 r = read(conn, buf, 1);
+  close(conn);
+  if (r == 1)
+    exit(0);
+}
+
+template <typename C>
+void daemonize(C &ctx,
+               std::function<bool(std::function<void()>)> *wait_for_client,
+               std::function<void(std::function<bool()>)>
+                 *wait_for_speculative_client,
+               std::function<void()> *on_complete) {
+  if (daemon(1, 0) == -1)
+    Fatal(ctx) << "daemon failed: " << errno_string();
+
+  i64 sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock == -1)
+    Fatal(ctx) << "socket failed: " << errno_string();
+
+  socket_tmpfile =
+    strdup(("/tmp/mold-" + compute_sha256(ctx.cmdline_args)).c_str());
+
+  struct sockaddr_un name = {};
+  name.sun_family = AF_UNIX;
+  strcpy(name.sun_path, socket_tmpfile);
+
+  u32 orig_mask = umask(0177);
+
+  if (bind(sock, (struct sockaddr *)&name, sizeof(name)) == -1) {
+    if (errno != EADDRINUSE)
+      Fatal(ctx) << "bind failed: " << errno_string();
+
+    unlink(socket_tmpfile);
+    if (bind(sock, (struct sockaddr *)&name, sizeof(name)) == -1)
+      Fatal(ctx) << "bind failed: " << errno_string();
+  }
+
+  umask(orig_mask);
+
+  if (listen(sock, 0) == -1)
+    Fatal(ctx) << "listen failed: " << errno_string();
+
+  static i64 conn = -1;
+
+  // If speculation is enabled, the daemon forks a speculative process
+  // whenever its inputs are settled. That process links the preloaded
+  // inputs in the background up to the point where the output layout
+  // is fixed, and then serves clients instead of the daemon: for each
+  // client, it forks a child which writes the output using the
+  // precomputed layout. The daemon passes client connections to it
+  // over `spec_fd`.
+  //
+  // Speculation is abandoned if input files are updated. If the
+  // speculative process dies or a client's child finds an updated
+  // input, the client sees EOF and links by itself as usual.
+  static i64 spec_fd = -1;
+  static pid_t spec_pid = -1;
+  static i64 spec_out = -1;
+
+  auto stop_speculation = [] {
+    if (spec_pid != -1) {
+      kill(spec_pid, SIGKILL);
+      close(spec_fd);
+      spec_pid = -1;
+      spec_fd = -1;
+    }
+  };
+
+  // Forks a speculative process. Returns true in the child.
+  auto start_speculation = [=]() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+      return false;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+
+    if (pid == 0) {
+      close(fds[0]);
+      spec_fd = fds[1];
+
+      // Messages printed while linking in the background would not
+      // reach any client, so we capture them. If there are any, we
+      // give up speculation and let clients link by themselves.
+      char path[] = "/tmp/mold-spec-XXXXXX";
+      spec_out = mkstemp(path);
+      if (spec_out == -1)
+        _exit(0);
+      unlink(path);
+      dup2(spec_out, STDOUT_FILENO);
+      dup2(spec_out, STDERR_FILENO);
+      return true;
+    }
+
+    close(fds[1]);
+    spec_fd = fds[0];
+    spec_pid = pid;
+    return false;
+  };
+
+  // The daemon serves any number of clients, including concurrent ones,
+  // until it becomes idle for DAEMON_TIMEOUT seconds. For each client,
+  // we fork a child which inherits preloaded files and does the actual
+  // linking, while the parent goes back to waiting for a next client.
+  // Children are reaped automatically.
+  //
+  // While waiting, the parent watches input files and calls `reload`
+  // when they are updated, so that children inherit freshly parsed
+  // files instead of re-reading them on the critical path. Updates
+  // come in bursts during a build, so we wait for them to settle.
+  //
+  // Returns true in a speculative process and false in a child serving
+  // a client.
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  *wait_for_client = [=, &ctx](std::function<void()> reload) {
+    InputWatcher<C> watcher(ctx);
+    bool reload_pending = false;
+    bool speculate = wait_for_speculative_client;
+
+    for (;;) {
+      if (speculate && spec_pid == -1 && !reload_pending) {
+        speculate = false;
+        if (start_speculation()) {
+          close(sock);
+          socket_tmpfile = nullptr;
+          return true;
+        }
+      }
+
+      fd_set rfds;
+      FD_ZERO(&rfds);
+      FD_SET(sock, &rfds);
+      if (watcher.fd != -1)
+        FD_SET(watcher.fd, &rfds);
+
+      struct timeval tv;
+      tv.tv_sec = reload_pending ? 0 : DAEMON_TIMEOUT;
+      tv.tv_usec = reload_pending ? DAEMON_RELOAD_DELAY * 1000 : 0;
+
+      i64 res = select(std::max(sock, watcher.fd) + 1, &rfds, NULL, NULL, &tv);
+      if (res == -1) {
+        if (errno == EINTR)
+          continue;
+        Fatal(ctx) << "select failed: " << errno_string();
+      }
+
+      if (res == 0) {
+        if (reload_pending) {
+          reload_pending = false;
+          reload();
+          speculate = wait_for_speculative_client;
+          continue;
+        }
+
+        stop_speculation();
+        unlink(socket_tmpfile);
+        std::cout << "timeout\n";
+        exit(0);
+      }
+
+      if (watcher.fd != -1 && FD_ISSET(watcher.fd, &rfds)) {
+        if (watcher.read_events()) {
+          reload_pending = true;
+          stop_speculation();
+        }
+        if (!FD_ISSET(sock, &rfds))
+          continue;
+      }
+
+      conn = accept(sock, NULL, NULL);
+      if (conn == -1) {
+        if (errno == EINTR || errno == ECONNABORTED)
+          continue;
+        Fatal(ctx) << "accept failed: " << errno_string();
+      }
+
+      if (spec_pid != -1) {
+        if (try_send_fd(spec_fd, conn)) {
+          close(conn);
+          continue;
+        }
+        stop_speculation();
+      }
+
+      pid_t pid = fork();
+      if (pid == -1)
+        Fatal(ctx) << "fork failed: " << errno_string();
+
+      if (pid == 0) {
+        // Child. The socket file belongs to the parent, so we must not
+        // remove it on exit.
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        close(sock);
+        if (spec_fd != -1)
+          close(spec_fd);
+        socket_tmpfile = nullptr;
+        dup2(recv_fd(ctx, conn), STDOUT_FILENO);
+        dup2(recv_fd(ctx, conn), STDERR_FILENO);
+        return false;
+      }
+
+      close(conn);
+    }
+  };
+
+  // Called by a speculative process once the output layout is fixed.
+  // Returns in a child serving a client if none of the inputs have
+  // been updated since they were read. `is_updated` tells that.
+  if (wait_for_speculative_client) {
+    *wait_for_speculative_client = [&ctx](std::function<bool()> is_updated) {
+      std::cout << std::flush;
+      if (lseek(spec_out, 0, SEEK_END) != 0)
+        _exit(0);
+      close(spec_out);
+
+      for (;;) {
+        i64 fd = try_recv_fd(spec_fd);
+        if (fd == -1)
+          _exit(0);
+
+        pid_t pid = fork();
+        if (pid == -1)
+          _exit(0);
+
+        if (pid == 0) {
+          signal(SIGCHLD, SIG_DFL);
+          signal(SIGPIPE, SIG_DFL);
+          close(spec_fd);
+          if (is_updated())
+            _exit(0);
+
+          conn = fd;
+          dup2(recv_fd(ctx, conn), STDOUT_FILENO);
+          dup2(recv_fd(ctx, conn), STDERR_FILENO);
+          return;
+        }
+
+        close(fd);
+      }
+    };
+  }
+
+  *on_complete = [=]() {
+    char buf[] = {1};
+    int n = write(conn, buf, 1);
+    assert(n == 1);
+  };
+}
+
+} // namespace mold
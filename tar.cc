@@ -56,47 +56,63 @@ std::string TarFile::encode_path(std::string path) {
 
 void TarFile::append(std::string path, std::string_view data) {
   contents.push_back({path, data});
+  offsets.push_back(size_ - BLOCK_SIZE * 2);
 
   size_ += BLOCK_SIZE * 2;
   size_ += align_to(encode_path(path).size(), BLOCK_SIZE);
   size_ += align_to(data.size(), BLOCK_SIZE);
 }
 
-void TarFile::write_to(u8 *buf) {
-  u8 *start = buf;
-  memset(buf, 0, size_);
-
-  for (i64 i = 0; i < contents.size(); i++) {
-    assert(buf - start <= size_);
-
-    const std::string &path = contents[i].first;
-    std::string_view data = contents[i].second;
-
-    // Write PAX header
-    static_assert(sizeof(UstarHeader) == BLOCK_SIZE);
-    UstarHeader &pax = *(UstarHeader *)buf;
-    buf += BLOCK_SIZE;
-
-    std::string attr = encode_path(path);
-    sprintf(pax.size, "%011zo", attr.size());
-    pax.typeflag[0] = 'x';
-    pax.flush();
-
-    // Write pathname
-    memcpy(buf, attr.data(), attr.size());
-    buf += align_to(attr.size(), BLOCK_SIZE);
-
-    // Write Ustar header
-    UstarHeader &ustar = *(UstarHeader *)buf;
-    buf += BLOCK_SIZE;
+// Returns a PAX header, a pathname and a Ustar header for the idx-th
+// file, which precede the file contents in an archive.
+std::string TarFile::get_header(i64 idx) {
+  std::string attr = encode_path(contents[idx].first);
+  i64 attr_size = align_to(attr.size(), BLOCK_SIZE);
+  std::string buf(BLOCK_SIZE * 2 + attr_size, '\0');
+
+  // Write PAX header
+  static_assert(sizeof(UstarHeader) == BLOCK_SIZE);
+  UstarHeader &pax = *(UstarHeader *)&buf[0];
+  sprintf(pax.size, "%011zo", attr.size());
+  pax.typeflag[0] = 'x';
+  pax.flush();
+
+  // Write pathname
+  memcpy(&buf[BLOCK_SIZE], attr.data(), attr.size());
+
+  // Write Ustar header
+  UstarHeader &ustar = *(UstarHeader *)&buf[BLOCK_SIZE + attr_size];
+  memcpy(ustar.mode, "0000664", 8);
+  sprintf(ustar.size, "%011zo", contents[idx].second.size());
+  ustar.flush();
+  return buf;
+}
 
-    memcpy(ustar.mode, "0000664", 8);
-    sprintf(ustar.size, "%011zo", data.size());
-    ustar.flush();
+void TarFile::write_to(u8 *buf) {
+  write_to(buf, 0, size_);
+}
 
-    // Write file contents
-    memcpy(buf, data.data(), data.size());
-    buf += align_to(data.size(), BLOCK_SIZE);
+// Writes the [offset, offset + size) part of an archive to buf. File
+// contents are copied directly from their sources, so an archive can
+// be compressed shard by shard without materializing it in memory.
+void TarFile::write_to(u8 *buf, i64 offset, i64 size) {
+  i64 end = offset + size;
+  memset(buf, 0, size);
+
+  auto copy = [&](i64 begin, std::string_view data) {
+    i64 lo = std::max(begin, offset);
+    i64 hi = std::min<i64>(begin + data.size(), end);
+    if (lo < hi)
+      memcpy(buf + lo - offset, data.data() + lo - begin, hi - lo);
+  };
+
+  auto it = std::upper_bound(offsets.begin(), offsets.end(), offset);
+  i64 i = (it == offsets.begin()) ? 0 : it - offsets.begin() - 1;
+
+  for (; i < contents.size() && offsets[i] < end; i++) {
+    std::string hdr = get_header(i);
+    copy(offsets[i], hdr);
+    copy(offsets[i] + hdr.size(), contents[i].second);
   }
 }
 
@@ -0,0 +1,499 @@
+// This is a generator of synthetic x86-64 ELF relocatable object
+// files for scaling experiments. It writes any number of object files
+// without invoking a compiler, so that we can create inputs that are
+// 10x or 100x larger than what we usually get from real programs and
+// see how each linker pass scales.
+//
+// Each generated file fN.o contains
+//
+//  - functions spread over a number of .text.* sections, each of which
+//    calls functions defined in other files via PLT32 relocations,
+//  - COMDAT groups whose signatures are the same in all files, so that
+//    all but one of them are eliminated by the linker,
+//  - a .rodata.str1.1 section whose strings are duplicated in all
+//    files, so that they are merged by the linker, and
+//  - .eh_frame records for functions.
+//
+// File 0 also defines `main`, so the generated files can be linked
+// into an executable with a regular compiler driver. Generated
+// programs are not meant to be run.
+//
+// Usage: gen-elf [options] <output-directory>
+
+#include "../../elf/elf.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace mold::elf;
+
+struct Config {
+  i64 files = 100;
+  i64 sections = 10;
+  i64 symbols = 100;
+  i64 relocs = 4;
+  i64 comdats = 10;
+  i64 strings = 100;
+  i64 eh_frames = 100;
+  std::string outdir;
+};
+
+static const char helpmsg[] = R"(
+Options:
+  --files N          Number of object files (default: 100)
+  --sections N       Number of .text sections per file (default: 10)
+  --symbols N        Number of functions per file (default: 100)
+  --relocs N         Number of relocations per function (default: 4)
+  --comdats N        Number of COMDAT groups per file (default: 10)
+  --strings N        Number of mergeable strings per file (default: 100)
+  --eh-frames N      Number of functions with .eh_frame records
+                     per file (default: 100)
+  --help             Report usage information)";
+
+// A string table builder.
+class StrtabBuilder {
+public:
+  StrtabBuilder() : buf(1, '\0') {}
+
+  u32 add(std::string_view str) {
+    u32 off = buf.size();
+    buf += str;
+    buf += '\0';
+    return off;
+  }
+
+  std::string buf;
+};
+
+template <typename T>
+static void append(std::string &buf, const T &val) {
+  buf.append((const char *)&val, sizeof(val));
+}
+
+static void write32(std::string &buf, i64 off, u32 val) {
+  memcpy(buf.data() + off, &val, 4);
+}
+
+static std::string func_name(i64 file, i64 idx) {
+  return "f" + std::to_string(file) + "_" + std::to_string(idx);
+}
+
+// Sections of an object file under construction.
+struct Section {
+  std::string name;
+  u32 type = 0;
+  u64 flags = 0;
+  u32 link = 0;
+  u32 info = 0;
+  u64 align = 1;
+  u64 entsize = 0;
+  std::string contents;
+  std::vector<ElfRel<X86_64>> rels;
+};
+
+// A function body consists of `relocs` calls followed by `ret`.
+static constexpr i64 CALL_SIZE = 5;
+
+static std::string gen_object(const Config &config, i64 file_idx) {
+  std::vector<Section> sections(1);
+  std::vector<ElfSym<X86_64>> locals(1);
+  std::vector<ElfSym<X86_64>> globals;
+  std::unordered_map<std::string, i64> undefs;
+  StrtabBuilder strtab;
+
+  i64 num_funcs = std::max<i64>(config.symbols, 1);
+  i64 num_text = std::min(std::max<i64>(config.sections, 1), num_funcs);
+
+  // Global symbol indices are not known until all local symbols have
+  // been added, so we use a negative number for a global symbol index
+  // and fix it up when writing relocations.
+  auto global_idx = [](i64 i) { return -1 - i; };
+
+  auto add_global = [&](std::string_view name, u16 shndx, u64 value,
+                        u64 size, u8 type, u8 bind) {
+    ElfSym<X86_64> sym = {};
+    sym.st_name = strtab.add(name);
+    sym.st_type = type;
+    sym.st_bind = bind;
+    sym.st_shndx = shndx;
+    sym.st_value = value;
+    sym.st_size = size;
+    globals.push_back(sym);
+    return global_idx(globals.size() - 1);
+  };
+
+  auto get_func_sym = [&](i64 file, i64 idx) -> i64 {
+    std::string name = func_name(file, idx);
+    auto it = undefs.find(name);
+    if (it != undefs.end())
+      return it->second;
+    i64 sym = add_global(name, SHN_UNDEF, 0, 0, STT_NOTYPE, STB_GLOBAL);
+    undefs[name] = sym;
+    return sym;
+  };
+
+  auto add_section_sym = [&](i64 shndx) {
+    ElfSym<X86_64> sym = {};
+    sym.st_type = STT_SECTION;
+    sym.st_shndx = shndx;
+    locals.push_back(sym);
+    return locals.size() - 1;
+  };
+
+  // Create .text sections
+  std::vector<i64> text_shndx(num_text);
+  std::vector<i64> text_sym(num_text);
+
+  for (i64 i = 0; i < num_text; i++) {
+    text_shndx[i] = sections.size();
+    Section &sec = sections.emplace_back();
+    sec.name = ".text." + func_name(file_idx, i);
+    sec.type = SHT_PROGBITS;
+    sec.flags = SHF_ALLOC | SHF_EXECINSTR;
+    sec.align = 16;
+    text_sym[i] = add_section_sym(text_shndx[i]);
+  }
+
+  // Create functions. Function i is placed in section i % num_text.
+  // Defined symbols are added first so that they'll never be confused
+  // with undefined ones.
+  struct Func {
+    i64 sec;
+    i64 offset;
+    i64 size;
+  };
+
+  std::vector<Func> funcs(num_funcs);
+  i64 func_size = config.relocs * CALL_SIZE + 1;
+
+  for (i64 i = 0; i < num_funcs; i++) {
+    i64 sec = i % num_text;
+    std::string &buf = sections[text_shndx[sec]].contents;
+
+    buf.resize((buf.size() + 15) & ~15, '\xcc');
+    funcs[i] = {sec, (i64)buf.size(), func_size};
+    buf.resize(buf.size() + func_size);
+
+    std::string name = func_name(file_idx, i);
+    undefs[name] = add_global(name, text_shndx[sec], funcs[i].offset,
+                              func_size, STT_FUNC, STB_GLOBAL);
+  }
+
+  if (file_idx == 0)
+    add_global("main", text_shndx[0], funcs[0].offset, func_size,
+               STT_FUNC, STB_GLOBAL);
+
+  // Function i of file N calls function i + j of file N + j + 1 for
+  // each j < relocs, so that all files depend on each other.
+  for (i64 i = 0; i < num_funcs; i++) {
+    Section &sec = sections[text_shndx[funcs[i].sec]];
+    u8 *loc = (u8 *)sec.contents.data() + funcs[i].offset;
+
+    for (i64 j = 0; j < config.relocs; j++) {
+      i64 file = (file_idx + j + 1) % config.files;
+      i64 sym = get_func_sym(file, (i + j) % num_funcs);
+
+      loc[j * CALL_SIZE] = 0xe8;
+      memset(loc + j * CALL_SIZE + 1, 0, 4);
+
+      ElfRel<X86_64> rel = {};
+      rel.r_offset = funcs[i].offset + j * CALL_SIZE + 1;
+      rel.r_type = R_X86_64_PLT32;
+      rel.r_sym = sym;
+      rel.r_addend = -4;
+      sec.rels.push_back(rel);
+    }
+    loc[config.relocs * CALL_SIZE] = 0xc3;
+  }
+
+  // Create COMDAT groups. Each group consists of one section containing
+  // a weak function that is identical in all files.
+  for (i64 i = 0; i < config.comdats; i++) {
+    std::string name = "comdat_" + std::to_string(i);
+
+    Section &group = sections.emplace_back();
+    group.name = ".group";
+    group.type = SHT_GROUP;
+    group.align = 4;
+    group.entsize = 4;
+    group.info = add_global(name, sections.size(), 0, 3, STT_FUNC, STB_WEAK);
+    append<u32>(group.contents, GRP_COMDAT);
+    append<u32>(group.contents, sections.size());
+
+    Section &sec = sections.emplace_back();
+    sec.name = ".text." + name;
+    sec.type = SHT_PROGBITS;
+    sec.flags = SHF_ALLOC | SHF_EXECINSTR | SHF_GROUP;
+    sec.align = 16;
+    sec.contents = "\x31\xc0\xc3"; // xor %eax, %eax; ret
+  }
+
+  // Create a mergeable string section
+  if (config.strings > 0) {
+    Section &sec = sections.emplace_back();
+    sec.name = ".rodata.str1.1";
+    sec.type = SHT_PROGBITS;
+    sec.flags = SHF_ALLOC | SHF_MERGE | SHF_STRINGS;
+    sec.entsize = 1;
+
+    for (i64 i = 0; i < config.strings; i++) {
+      sec.contents += "string number " + std::to_string(i);
+      sec.contents += '\0';
+    }
+  }
+
+  // Mark the stack as non-executable
+  {
+    Section &sec = sections.emplace_back();
+    sec.name = ".note.GNU-stack";
+    sec.type = SHT_PROGBITS;
+  }
+
+  // Create .eh_frame with one CIE and one FDE for each function
+  i64 num_fdes = std::min(config.eh_frames, num_funcs);
+
+  if (num_fdes > 0) {
+    Section &sec = sections.emplace_back();
+    sec.name = ".eh_frame";
+    sec.type = SHT_X86_64_UNWIND;
+    sec.flags = SHF_ALLOC;
+    sec.align = 8;
+
+    // CIE with augmentation "zR" and pcrel|sdata4 FDE encoding
+    static const u8 cie[] = {
+      0x14, 0, 0, 0,           // length
+      0, 0, 0, 0,              // CIE ID
+      1,                       // version
+      'z', 'R', 0,             // augmentation string
+      1,                       // code alignment factor
+      0x78,                    // data alignment factor (-8)
+      0x10,                    // return address register
+      1,                       // augmentation data length
+      0x1b,                    // FDE pointer encoding
+      0x0c, 0x07, 0x08,        // DW_CFA_def_cfa: rsp+8
+      0x90, 0x01,              // DW_CFA_offset: rip at cfa-8
+      0, 0,                    // padding
+    };
+    sec.contents.append((const char *)cie, sizeof(cie));
+
+    for (i64 i = 0; i < num_fdes; i++) {
+      i64 off = sec.contents.size();
+      sec.contents.resize(off + 20);
+      write32(sec.contents, off, 16);         // length
+      write32(sec.contents, off + 4, off + 4); // CIE pointer
+      write32(sec.contents, off + 12, funcs[i].size);
+
+      ElfRel<X86_64> rel = {};
+      rel.r_offset = off + 8;
+      rel.r_type = R_X86_64_PC32;
+      rel.r_sym = text_sym[funcs[i].sec];
+      rel.r_addend = funcs[i].offset;
+      sec.rels.push_back(rel);
+    }
+  }
+
+  // Create relocation sections
+  i64 shstrtab_idx = 0;
+  i64 symtab_idx = sections.size();
+  for (Section &sec : sections)
+    if (!sec.rels.empty())
+      symtab_idx++;
+
+  for (i64 i = 1, end = sections.size(); i < end; i++) {
+    if (sections[i].rels.empty())
+      continue;
+
+    std::string contents;
+    for (ElfRel<X86_64> rel : sections[i].rels) {
+      if ((i32)rel.r_sym < 0)
+        rel.r_sym = locals.size() - 1 - (i32)rel.r_sym;
+      append(contents, rel);
+    }
+
+    Section &rel = sections.emplace_back();
+    rel.name = ".rela" + sections[i].name;
+    rel.type = SHT_RELA;
+    rel.flags = SHF_INFO_LINK;
+    rel.link = symtab_idx;
+    rel.info = i;
+    rel.align = 8;
+    rel.entsize = sizeof(ElfRel<X86_64>);
+    rel.contents = std::move(contents);
+  }
+
+  for (Section &sec : sections) {
+    if (sec.type == SHT_GROUP) {
+      sec.link = symtab_idx;
+      sec.info = locals.size() - 1 - (i32)sec.info;
+    }
+  }
+
+  // Create .symtab, .strtab and .shstrtab
+  {
+    Section &sec = sections.emplace_back();
+    sec.name = ".symtab";
+    sec.type = SHT_SYMTAB;
+    sec.link = symtab_idx + 1;
+    sec.info = locals.size();
+    sec.align = 8;
+    sec.entsize = sizeof(ElfSym<X86_64>);
+
+    for (ElfSym<X86_64> &sym : locals)
+      append(sec.contents, sym);
+    for (ElfSym<X86_64> &sym : globals)
+      append(sec.contents, sym);
+  }
+
+  {
+    Section &sec = sections.emplace_back();
+    sec.name = ".strtab";
+    sec.type = SHT_STRTAB;
+    sec.contents = std::move(strtab.buf);
+  }
+
+  {
+    shstrtab_idx = sections.size();
+    Section &sec = sections.emplace_back();
+    sec.name = ".shstrtab";
+    sec.type = SHT_STRTAB;
+  }
+
+  // Write the file
+  StrtabBuilder shstrtab;
+  std::vector<u32> sh_names(sections.size());
+  for (i64 i = 1; i < (i64)sections.size(); i++)
+    sh_names[i] = shstrtab.add(sections[i].name);
+  sections[shstrtab_idx].contents = std::move(shstrtab.buf);
+
+  std::string buf(sizeof(ElfEhdr<X86_64>), '\0');
+  std::vector<u64> offsets(sections.size());
+
+  for (i64 i = 1; i < (i64)sections.size(); i++) {
+    buf.resize((buf.size() + sections[i].align - 1) & ~(sections[i].align - 1));
+    offsets[i] = buf.size();
+    buf += sections[i].contents;
+  }
+
+  buf.resize((buf.size() + 7) & ~7);
+  u64 shoff = buf.size();
+
+  for (i64 i = 0; i < (i64)sections.size(); i++) {
+    Section &sec = sections[i];
+    ElfShdr<X86_64> shdr = {};
+    if (i > 0) {
+      shdr.sh_name = sh_names[i];
+      shdr.sh_type = sec.type;
+      shdr.sh_flags = sec.flags;
+      shdr.sh_offset = offsets[i];
+      shdr.sh_size = sec.contents.size();
+      shdr.sh_link = sec.link;
+      shdr.sh_info = sec.info;
+      shdr.sh_addralign = sec.align;
+      shdr.sh_entsize = sec.entsize;
+    }
+    append(buf, shdr);
+  }
+
+  ElfEhdr<X86_64> ehdr = {};
+  memcpy(ehdr.e_ident, "\177ELF", 4);
+  ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+  ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+  ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr.e_type = ET_REL;
+  ehdr.e_machine = EM_X86_64;
+  ehdr.e_version = EV_CURRENT;
+  ehdr.e_shoff = shoff;
+  ehdr.e_ehsize = sizeof(ElfEhdr<X86_64>);
+  ehdr.e_shentsize = sizeof(ElfShdr<X86_64>);
+  ehdr.e_shnum = sections.size();
+  ehdr.e_shstrndx = shstrtab_idx;
+  memcpy(buf.data(), &ehdr, sizeof(ehdr));
+  return buf;
+}
+
+[[noreturn]] static void usage(int status) {
+  std::cout << "Usage: gen-elf [options] <output-directory>\n"
+            << helpmsg << "\n";
+  exit(status);
+}
+
+static Config parse_args(int argc, char **argv) {
+  Config config;
+
+  auto read_arg = [&](int &i, std::string_view name, i64 &val) {
+    if (argv[i] != name)
+      return false;
+    if (i + 1 == argc)
+      usage(1);
+
+    char *end;
+    val = strtoll(argv[++i], &end, 10);
+    if (*end || val < 0) {
+      std::cerr << "gen-elf: " << name << ": invalid number: "
+                << argv[i] << "\n";
+      exit(1);
+    }
+    return true;
+  };
+
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == std::string_view("--help"))
+      usage(0);
+
+    if (read_arg(i, "--files", config.files) ||
+        read_arg(i, "--sections", config.sections) ||
+        read_arg(i, "--symbols", config.symbols) ||
+        read_arg(i, "--relocs", config.relocs) ||
+        read_arg(i, "--comdats", config.comdats) ||
+        read_arg(i, "--strings", config.strings) ||
+        read_arg(i, "--eh-frames", config.eh_frames))
+      continue;
+
+    if (argv[i][0] == '-' || !config.outdir.empty())
+      usage(1);
+    config.outdir = argv[i];
+  }
+
+  if (config.outdir.empty() || config.files == 0)
+    usage(1);
+  return config;
+}
+
+int main(int argc, char **argv) {
+  Config config = parse_args(argc, argv);
+
+  // Files are independent of each other, so we create them in parallel.
+  i64 num_threads = std::max<i64>(std::thread::hardware_concurrency(), 1);
+  std::vector<std::thread> threads;
+  std::atomic_bool failed = false;
+
+  for (i64 t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (i64 i = t; i < config.files; i += num_threads) {
+        std::string path = config.outdir + "/f" + std::to_string(i) + ".o";
+        std::string buf = gen_object(config, i);
+        std::ofstream out(path, std::ios::binary);
+        out.write(buf.data(), buf.size());
+        out.close();
+
+        if (!out) {
+          std::cerr << "gen-elf: cannot write " << path << "\n";
+          failed = true;
+          return;
+        }
+      }
+    });
+  }
+
+  for (std::thread &th : threads)
+    th.join();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+// Micro-benchmarks for data structures and routines that are on the
+// hot paths of mold, so that a change to one of them can be evaluated
+// without running full links.
+//
+//  - ConcurrentMap insert and lookup throughput with 1 to 128 threads,
+//    with threads inserting either disjoint or the same set of keys
+//  - HyperLogLog insert throughput with per-thread sketches merged at
+//    the end as estimate_num_symbols() does
+//  - BitVector set and test throughput
+//  - hash_string throughput for various key lengths
+//  - zlib, gzip and zstd compression throughput for various shard
+//    sizes
+//
+// Each result is printed as a "name threads value unit" line. The best
+// of a few runs is reported.
+//
+// Usage: micro-bench [options] [benchmark-name-prefix...]
+
+#include "../../elf/mold.h"
+
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+using namespace mold;
+using namespace mold::elf;
+
+struct Config {
+  i64 keys = 1000000;
+  i64 bytes = 64 * 1024 * 1024;
+  i64 runs = 3;
+  i64 max_threads = 128;
+  std::vector<std::string_view> filters;
+};
+
+static const char helpmsg[] = R"(
+Options:
+  --keys N           Number of keys for map and hash benchmarks
+                     (default: 1000000)
+  --bytes N          Number of bytes for compression benchmarks
+                     (default: 67108864)
+  --runs N           Number of runs of each benchmark (default: 3)
+  --max-threads N    Maximum number of threads (default: 128)
+  --help             Report usage information)";
+
+static Config config;
+
+[[noreturn]] static void usage(int status) {
+  std::cout << "Usage: micro-bench [options] [benchmark-name-prefix...]\n"
+            << helpmsg << "\n";
+  exit(status);
+}
+
+static Config parse_args(int argc, char **argv) {
+  Config config;
+
+  auto read_arg = [&](int &i, std::string_view name, i64 &val) {
+    if (argv[i] != name)
+      return false;
+    if (i + 1 == argc)
+      usage(1);
+
+    char *end;
+    val = strtoll(argv[++i], &end, 10);
+    if (*end || val <= 0) {
+      std::cerr << "micro-bench: " << name << ": invalid number: "
+                << argv[i] << "\n";
+      exit(1);
+    }
+    return true;
+  };
+
+  for (int i = 1; i < argc; i++) {
+    if (argv[i] == std::string_view("--help"))
+      usage(0);
+
+    if (read_arg(i, "--keys", config.keys) ||
+        read_arg(i, "--bytes", config.bytes) ||
+        read_arg(i, "--runs", config.runs) ||
+        read_arg(i, "--max-threads", config.max_threads))
+      continue;
+
+    if (argv[i][0] == '-')
+      usage(1);
+    config.filters.push_back(argv[i]);
+  }
+  return config;
+}
+
+static bool is_enabled(std::string_view name) {
+  if (config.filters.empty())
+    return true;
+  for (std::string_view prefix : config.filters)
+    if (name.starts_with(prefix))
+      return true;
+  return false;
+}
+
+// Runs `fn` in an arena of a given number of threads and returns the
+// best wall time in seconds. `setup` is called before each run and is
+// not timed.
+template <typename Setup, typename Fn>
+static double measure(i64 threads, Setup setup, Fn fn) {
+  tbb::global_control gc(tbb::global_control::max_allowed_parallelism,
+                         threads);
+  tbb::task_arena arena(threads);
+  double best = 1e30;
+
+  for (i64 i = 0; i < config.runs; i++) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    arena.execute(fn);
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  return best;
+}
+
+template <typename Fn>
+static double measure(i64 threads, Fn fn) {
+  return measure(threads, [] {}, fn);
+}
+
+static void report(std::string_view name, i64 threads, double val,
+                   std::string_view unit) {
+  std::cout << name << " " << threads << " " << std::fixed
+            << std::setprecision(1) << val << " " << unit << std::endl;
+}
+
+static std::vector<i64> thread_counts() {
+  std::vector<i64> vec;
+  for (i64 i = 1; i <= config.max_threads; i *= 2)
+    vec.push_back(i);
+  return vec;
+}
+
+// Symbol-like strings such as "_ZN4mold3elf8symbol123E"
+static std::vector<std::string> gen_keys(i64 n) {
+  std::vector<std::string> vec(n);
+  for (i64 i = 0; i < n; i++)
+    vec[i] = "_ZN4mold3elf" + std::to_string(i * 7919) + "symbolE";
+  return vec;
+}
+
+static void bench_concurrent_map() {
+  std::vector<std::string> keys = gen_keys(config.keys);
+  std::vector<u64> hashes(keys.size());
+  for (i64 i = 0; i < keys.size(); i++)
+    hashes[i] = hash_string(keys[i]);
+
+  for (i64 threads : thread_counts()) {
+    ConcurrentMap<i64> map;
+
+    // Each thread inserts a disjoint subset of keys.
+    if (is_enabled("concurrent-map-insert")) {
+      double sec = measure(threads, [&] { map.resize(keys.size() * 2); }, [&] {
+        tbb::parallel_for((i64)0, (i64)keys.size(), [&](i64 i) {
+          map.insert(keys[i], hashes[i], i);
+        });
+      });
+      report("concurrent-map-insert", threads, keys.size() / sec / 1e6,
+             "Mops/s");
+    }
+
+    // Every thread inserts all keys, so that threads contend for the
+    // same buckets as they do for common symbols such as `printf`.
+    if (is_enabled("concurrent-map-insert-contended")) {
+      double sec = measure(threads, [&] { map.resize(keys.size() * 2); }, [&] {
+        tbb::parallel_for((i64)0, threads, [&](i64) {
+          for (i64 i = 0; i < keys.size(); i++)
+            map.insert(keys[i], hashes[i], i);
+        }, tbb::static_partitioner());
+      });
+      report("concurrent-map-insert-contended", threads,
+             keys.size() * threads / sec / 1e6, "Mops/s");
+    }
+
+    if (is_enabled("concurrent-map-find")) {
+      map.resize(keys.size() * 2);
+      for (i64 i = 0; i < keys.size(); i++)
+        map.insert(keys[i], hashes[i], i);
+
+      std::atomic<i64> found = 0;
+      double sec = measure(threads, [&] {
+        tbb::parallel_for(tbb::blocked_range<i64>(0, keys.size()),
+                          [&](const tbb::blocked_range<i64> &r) {
+          i64 n = 0;
+          for (i64 i = r.begin(); i < r.end(); i++)
+            n += (map.find(keys[i], hashes[i]) != nullptr);
+          found += n;
+        });
+      });
+      assert(found == keys.size() * config.runs);
+      report("concurrent-map-find", threads, keys.size() / sec / 1e6,
+             "Mops/s");
+    }
+  }
+}
+
+static void bench_hyperloglog() {
+  if (!is_enabled("hyperloglog"))
+    return;
+
+  std::vector<u64> hashes(config.keys);
+  std::mt19937_64 rand;
+  for (u64 &h : hashes)
+    h = rand();
+
+  for (i64 threads : thread_counts()) {
+    double sec = measure(threads, [&] {
+      HyperLogLog estimator;
+      tbb::parallel_for(tbb::blocked_range<i64>(0, hashes.size()),
+                        [&](const tbb::blocked_range<i64> &r) {
+        HyperLogLog local;
+        for (i64 i = r.begin(); i < r.end(); i++)
+          local.insert(hashes[i]);
+        estimator.merge(local);
+      });
+      assert(estimator.get_cardinality() > 0);
+    });
+    report("hyperloglog", threads, hashes.size() / sec / 1e6, "Mops/s");
+  }
+}
+
+static void bench_bitvector() {
+  if (!is_enabled("bitvector"))
+    return;
+
+  i64 n = config.keys * 16;
+  BitVector bv;
+  bv.resize(n);
+
+  double sec = measure(1, [&] {
+    for (i64 i = 0; i < n; i += 3)
+      bv[i] = true;
+    i64 count = 0;
+    for (i64 i = 0; i < n; i++)
+      count += bv[i];
+    assert(count == (n + 2) / 3);
+  });
+  report("bitvector", 1, (n / 3 + n) / sec / 1e6, "Mops/s");
+}
+
+static void bench_hash_string() {
+  for (i64 len : {8, 32, 128, 1024}) {
+    std::string name = "hash-string-" + std::to_string(len);
+    if (!is_enabled(name))
+      continue;
+
+    i64 n = std::max<i64>(config.bytes / len, 1);
+    std::string buf(n * len, 'x');
+    for (i64 i = 0; i < buf.size(); i++)
+      buf[i] = 'a' + (i * 31) % 26;
+
+    u64 sum = 0;
+    double sec = measure(1, [&] {
+      for (i64 i = 0; i < n; i++)
+        sum += hash_string({buf.data() + i * len, (size_t)len});
+    });
+    asm volatile("" :: "r"(sum));
+    report(name, 1, buf.size() / sec / 1e6, "MB/s");
+  }
+}
+
+// Compresses input in shards of a given size in parallel as the
+// compressors in compress.cc do. A shard size is a trade-off between
+// parallelism and compression ratio, so we report both. Since the
+// compressors split their input into 1 MiB shards, we don't try larger
+// ones.
+static void bench_compress() {
+  std::string input(config.bytes, '\0');
+  std::mt19937_64 rand;
+  std::vector<std::string> words = gen_keys(4096);
+  for (i64 i = 0; i < input.size();) {
+    std::string_view w = words[rand() % words.size()];
+    i64 n = std::min<i64>(w.size(), input.size() - i);
+    memcpy(input.data() + i, w.data(), n);
+    i += n;
+  }
+
+  auto run = [&](std::string_view kind, auto create) {
+    for (i64 shard_size : {16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024}) {
+      std::string name = std::string(kind) + "-" +
+                         std::to_string(shard_size / 1024) + "k";
+      if (!is_enabled(name))
+        continue;
+
+      i64 num_shards = (input.size() + shard_size - 1) / shard_size;
+
+      for (i64 threads : thread_counts()) {
+        std::atomic<i64> compressed_size = 0;
+        double sec = measure(threads, [&] { compressed_size = 0; }, [&] {
+          tbb::parallel_for((i64)0, num_shards, [&](i64 i) {
+            std::string_view shard =
+              std::string_view(input).substr(i * shard_size, shard_size);
+            compressed_size += create(shard)->size();
+          });
+        });
+
+        report(name, threads, input.size() / sec / 1e6, "MB/s");
+        if (threads == 1)
+          report(name + "-ratio", threads,
+                 compressed_size * 100.0 / input.size(), "%");
+      }
+    }
+  };
+
+  if (is_enabled("zlib"))
+    run("zlib", [](std::string_view s) {
+      return std::make_unique<ZlibCompressor>(s);
+    });
+
+  if (is_enabled("gzip"))
+    run("gzip", [](std::string_view s) {
+      return std::make_unique<GzipCompressor>(s);
+    });
+
+  if (is_enabled("zstd"))
+    run("zstd", [](std::string_view s) {
+      return std::make_unique<ZstdCompressor>(s);
+    });
+}
+
+int main(int argc, char **argv) {
+  config = parse_args(argc, argv);
+
+  bench_concurrent_map();
+  bench_hyperloglog();
+  bench_bitvector();
+  bench_hash_string();
+  bench_compress();
+  return 0;
+}
@@ -0,0 +1,130 @@
+#!/bin/bash
+# Link-time benchmarks.
+#
+# This script synthesizes a few representative workloads and measures
+# the wall time and peak RSS of mold linking each of them. Results are
+# written to out/bench/results.txt as "name wall_ms rss_kb" lines along
+# with --perf output for each workload.
+#
+# If BASELINE is set to a previous results file, each result is
+# compared with it, and the script fails if wall time or peak RSS grew
+# by more than TOLERANCE percent (default: 10). Baselines depend on
+# the machine, so they are not checked in.
+#
+# Usage: BASELINE=baseline.txt ./run.sh [workload...]
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+t=$(pwd)/../../out/bench
+mkdir -p $t
+
+CC=${CC:-cc}
+RUNS=${RUNS:-3}
+TOLERANCE=${TOLERANCE:-10}
+SCALE=${SCALE:-1}
+
+# Generates N object files, each of which defines a few functions.
+gen_objs() {
+  local dir=$1 n=$2 flags=$3
+  mkdir -p $dir
+  for i in $(seq 1 $n); do
+    cat <<EOF > $dir/f$i.c
+int g$i;
+int f${i}_a(int x) { return x + $i + g$i; }
+int f${i}_b(int x) { return f${i}_a(x) * $i; }
+int f${i}_c(int x) { return f${i}_b(x) - f${i}_a(x); }
+EOF
+  done
+  (cd $dir; ls f*.c | xargs -P$(nproc) -n16 $CC -c $flags)
+}
+
+gen_main() {
+  local file=$1 n=$2
+  {
+    for i in $(seq 1 $n); do echo "int f${i}_c(int);"; done
+    echo "int main() { int x = 0;"
+    for i in $(seq 1 $n); do echo "  x += f${i}_c(x);"; done
+    echo "  return x & 1; }"
+  } > $file.c
+  $CC -c -o $file.o $file.c
+}
+
+setup_many_objs() {
+  gen_objs $t/many-objs $((5000 * SCALE)) -O1
+  gen_main $t/many-objs/main $((5000 * SCALE))
+  LINK="$t/many-objs/main.o $t/many-objs/f*.o"
+}
+
+setup_archive() {
+  gen_objs $t/archive $((5000 * SCALE)) -O1
+  gen_main $t/archive/main $((2500 * SCALE))
+  rm -f $t/archive/libf.a
+  ar rcs $t/archive/libf.a $t/archive/f*.o
+  LINK="-static $t/archive/main.o $t/archive/libf.a"
+}
+
+setup_debug() {
+  gen_objs $t/debug $((2000 * SCALE)) "-O1 -g"
+  gen_main $t/debug/main $((2000 * SCALE))
+  LINK="$t/debug/main.o $t/debug/f*.o"
+}
+
+setup_icf_gc() {
+  gen_objs $t/icf-gc $((5000 * SCALE)) "-O1 -ffunction-sections -fdata-sections"
+  gen_main $t/icf-gc/main $((1000 * SCALE))
+  LINK="-Wl,--icf=all -Wl,--gc-sections $t/icf-gc/main.o $t/icf-gc/f*.o"
+}
+
+setup_dso() {
+  gen_objs $t/dso $((5000 * SCALE)) "-O1 -fPIC"
+  LINK="-shared $t/dso/f*.o"
+}
+
+# Uses gen-elf to create a large number of object files without
+# invoking the compiler. GEN_ELF_FLAGS can be used to change the
+# shape of the input (see `gen-elf --help`).
+setup_synthetic() {
+  ${CXX:-c++} -std=c++20 -O2 -pthread -o $t/gen-elf gen-elf.cc
+  rm -rf $t/synthetic
+  mkdir -p $t/synthetic
+  $t/gen-elf --files $((10000 * SCALE)) $GEN_ELF_FLAGS $t/synthetic
+  LINK="$t/synthetic/f*.o"
+}
+
+WORKLOADS=${@:-many_objs archive debug icf_gc dso synthetic}
+results=$t/results.txt
+: > $results
+status=0
+
+for w in $WORKLOADS; do
+  setup_$w
+
+  best_ms=
+  best_rss=
+  for i in $(seq 1 $RUNS); do
+    /usr/bin/time -f '%e %M' -o $t/time.txt \
+      $CC -B$(dirname $mold) -o $t/$w.out $LINK -Wl,--perf > $t/$w.perf
+    read sec rss < $t/time.txt
+    ms=$(awk "BEGIN { printf \"%d\", $sec * 1000 }")
+    [ -z "$best_ms" -o "$ms" -lt "${best_ms:-0}" ] && best_ms=$ms
+    [ -z "$best_rss" -o "$rss" -lt "${best_rss:-0}" ] && best_rss=$rss
+  done
+
+  echo "$w $best_ms $best_rss" | tee -a $results
+
+  if [ -n "$BASELINE" ]; then
+    read _ base_ms base_rss < <(grep "^$w " $BASELINE || echo "$w 0 0")
+    if [ "$base_ms" -gt 0 ] &&
+       [ $((best_ms * 100)) -gt $((base_ms * (100 + TOLERANCE))) ]; then
+      echo "$w: wall time regressed: $base_ms ms -> $best_ms ms"
+      status=1
+    fi
+    if [ "$base_rss" -gt 0 ] &&
+       [ $((best_rss * 100)) -gt $((base_rss * (100 + TOLERANCE))) ]; then
+      echo "$w: peak RSS regressed: $base_rss KiB -> $best_rss KiB"
+      status=1
+    fi
+  fi
+done
+
+exit $status
@@ -0,0 +1,63 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+echo 'int main() {}' | aarch64-linux-gnu-gcc -o $t/exe -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/a.o -c -xassembler -
+.globl get_foo, get_bar
+get_foo:
+  adrp x0, :got:foo
+  ldr  x0, [x0, :got_lo12:foo]
+  ldr  w0, [x0]
+  ret
+get_bar:
+  adrp x0, :got:bar
+  ldr  x0, [x0, :got_lo12:bar]
+  ldr  w0, [x0]
+  ret
+EOF
+
+# Put 2 MiB of data between the code and bar so that bar is out of
+# ADR's ±1 MiB range.
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/b.o -c -xassembler -
+.data
+.globl foo, bar
+foo:
+  .word 3
+.space 0x200000
+bar:
+  .word 5
+EOF
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/c.o -c -xc -
+#include <stdio.h>
+int get_foo();
+int get_bar();
+int main() {
+  printf("%d %d\n", get_foo(), get_bar());
+}
+EOF
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o -pie
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q '^3 5$'
+
+aarch64-linux-gnu-objdump -d $t/exe > $t/log
+grep -A2 '<get_foo>:' $t/log | grep -q 'adr	x0'
+grep -A2 '<get_bar>:' $t/log | grep -q 'add	x0, x0'
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o \
+  -Wl,-no-relax
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q '^3 5$'
+
+aarch64-linux-gnu-objdump -d $t/exe > $t/log
+grep -A2 '<get_foo>:' $t/log | grep -q 'ldr	x0, \[x0'
+
+echo OK
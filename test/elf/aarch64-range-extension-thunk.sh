@@ -0,0 +1,45 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+echo 'int main() {}' | aarch64-linux-gnu-gcc -o $t/exe -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/a.o -c -xc -
+#include <stdio.h>
+void foo();
+int main() {
+  printf("main ");
+  foo();
+  return 0;
+}
+EOF
+
+# Put 144 MiB of code between main and foo so that they cannot
+# reach each other directly.
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/b.o -c -xassembler -
+.section .text.pad,"ax",@progbits
+.space 0x9000000
+EOF
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/c.o -c -xc -
+#include <stdio.h>
+void foo() {
+  printf("foo\n");
+}
+EOF
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q 'main foo'
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o \
+  -static
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q 'main foo'
+
+echo OK
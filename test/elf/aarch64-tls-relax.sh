@@ -0,0 +1,49 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+echo 'int main() {}' | aarch64-linux-gnu-gcc -o $t/exe -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/a.o -c -xc - -fPIC -mtls-dialect=trad
+__thread int foo = 3;
+int get_foo() { return foo; }
+EOF
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/b.o -c -xc - -fPIC \
+  -ftls-model=initial-exec
+__thread int bar = 5;
+int get_bar() { return bar; }
+EOF
+
+cat <<EOF | aarch64-linux-gnu-gcc -o $t/c.o -c -xc -
+#include <stdio.h>
+int get_foo();
+int get_bar();
+int main() {
+  printf("%d %d\n", get_foo(), get_bar());
+}
+EOF
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q '^3 5$'
+
+aarch64-linux-gnu-objdump -d $t/exe > $t/log
+! grep -A8 '<get_foo>:' $t/log | grep -q '__tls_get_addr' || false
+grep -A8 '<get_foo>:' $t/log | grep -q 'mrs	x1, tpidr_el0'
+grep -A8 '<get_bar>:' $t/log | grep -q 'movk'
+
+aarch64-linux-gnu-gcc -B`dirname $mold` -o $t/exe $t/a.o $t/b.o $t/c.o \
+  -Wl,-no-relax
+qemu-aarch64 -L /usr/aarch64-linux-gnu $t/exe | grep -q '^3 5$'
+
+aarch64-linux-gnu-objdump -d $t/exe > $t/log
+grep -A8 '<get_foo>:' $t/log | grep -q '__tls_get_addr'
+
+echo OK
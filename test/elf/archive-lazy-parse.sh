@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+int foo() { return 3; }
+EOF
+
+# b.o contains a broken compressed section. Sections of an archive
+# member are parsed only when the member is pulled in, so the error
+# must not be reported unless b.o is actually needed.
+cat <<EOF | cc -o $t/b.o -c -x assembler -
+  .text
+  .globl bar
+bar:
+  ret
+  .section .zdebug_foo,"",@progbits
+  .ascii "XXXXXXXXXXXXXXXX"
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+rm -f $t/d.a
+ar rcs $t/d.a $t/a.o $t/b.o
+
+clang -fuse-ld=$mold -o $t/exe $t/c.o $t/d.a
+$t/exe | grep -q '^3$'
+
+! clang -fuse-ld=$mold -o $t/exe $t/c.o $t/d.a -Wl,-u,bar 2> $t/log || false
+grep -q 'corrupted compressed section' $t/log
+
+echo OK
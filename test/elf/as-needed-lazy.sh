@@ -0,0 +1,49 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+int foo = 3;
+extern int bar __attribute__((alias("foo")));
+int get_bar() { return bar; }
+EOF
+
+cat <<EOF | cc -fPIC -c -o $t/b.o -xc -
+int unused1() { return 1; }
+int unused2() { return 2; }
+EOF
+
+cat <<EOF | cc -c -o $t/c.o -xc -
+#include <stdio.h>
+extern int foo;
+int get_bar();
+int main() {
+  foo = 5;
+  printf("%d %d\n", foo, get_bar());
+}
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/libfoo.so $t/a.o -Wl,-soname,libfoo.so
+clang -fuse-ld=$mold -shared -o $t/libunused.so $t/b.o
+cp $t/libfoo.so $t/libfoo2.so
+
+# Definitions of an unneeded DSO are not registered, and a DSO that
+# has the same soname as a preceding one is ignored.
+clang -fuse-ld=$mold -no-pie -o $t/exe -Wl,-rpath=$t $t/c.o \
+  -Wl,--as-needed $t/libunused.so $t/libfoo.so $t/libfoo2.so -Wl,-stats > $t/log
+grep -q 'dso_lazy_syms=[1-9]' $t/log
+$t/exe | grep -q '5 5'
+
+readelf --dynamic $t/exe > $t/log2
+grep -Fq 'Shared library: [libfoo.so]' $t/log2
+! grep -Fq libunused.so $t/log2 || false
+
+# `bar` is an alias of a copy-relocated symbol, so it has to be
+# exported even though no one refers to it.
+readelf --dyn-syms $t/exe | grep -Eq ' bar$'
+
+echo OK
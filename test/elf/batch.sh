@@ -0,0 +1,52 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -x assembler -
+.globl _start
+_start:
+  mov \$60, %eax
+  mov \$3, %edi
+  syscall
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -x assembler -
+.globl _start
+_start:
+  mov \$60, %eax
+  mov \$5, %edi
+  syscall
+EOF
+
+rm -f $t/exe1 $t/exe2
+
+cat <<EOF > $t/manifest
+# comment
+-o $t/exe1 $t/a.o
+
+-o $t/exe2 $t/b.o
+EOF
+
+$mold -batch $t/manifest
+
+set +e
+$t/exe1; [ $? = 3 ] || { echo exe1 failed; exit 1; }
+$t/exe2; [ $? = 5 ] || { echo exe2 failed; exit 1; }
+set -e
+
+cat <<EOF > $t/manifest2
+-o $t/exe3 $t/a.o
+-o $t/exe4 $t/nonexistent.o
+-o $t/exe5 $t/b.o
+EOF
+
+! $mold -batch $t/manifest2 >& $t/log
+grep -q 'job failed:.*nonexistent' $t/log
+[ -x $t/exe3 ]
+[ -x $t/exe5 ]
+
+echo OK
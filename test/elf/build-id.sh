@@ -24,6 +24,9 @@ readelf -n $t/exe | grep -q 'GNU.*0x00000014.*NT_GNU_BUILD_ID'
 clang -o $t/exe $t/a.c -fuse-ld=$mold -Wl,-build-id=sha256
 readelf -n $t/exe | grep -q 'GNU.*0x00000020.*NT_GNU_BUILD_ID'
 
+clang -o $t/exe $t/a.c -fuse-ld=$mold -Wl,-build-id=fast
+readelf -n $t/exe | grep -q 'GNU.*0x00000010.*NT_GNU_BUILD_ID'
+
 clang -o $t/exe $t/a.c -fuse-ld=$mold -Wl,-build-id=0xdeadbeef
 readelf -n $t/exe | grep -q 'Build ID: deadbeef'
 
@@ -0,0 +1,35 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF2 | cc -o $t/a.o -c -xc -ffunction-sections -
+void a() {}
+void b() {}
+void c() { a(); }
+void d() {}
+int main() { b(); c(); d(); }
+EOF2
+
+cat <<EOF2 > $t/profile
+main c 100
+c a 90
+main b 1
+EOF2
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--call-graph-ordering-file=$t/profile
+$t/exe
+
+nm $t/exe | grep -E ' T (a|b|c|d|main)$' | sort > $t/log
+grep -A1 ' main$' $t/log | grep -q ' c$'
+grep -A1 ' c$' $t/log | grep -q ' a$'
+
+echo 'foo bar' > $t/profile
+! clang -fuse-ld=$mold -o $t/exe $t/a.o \
+  -Wl,--call-graph-ordering-file=$t/profile 2> $t/log || false
+grep -q 'invalid call graph profile entry' $t/log
+
+echo OK
@@ -0,0 +1,33 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ "$(uname -m)" = x86_64 ] || { echo skipped; exit; }
+
+for i in 1 2 3; do
+  cat <<EOF | cc -o $t/$i.o -c -x assembler -
+.section .text.foo,"axG",@progbits,foo,comdat
+.globl foo
+foo:
+  mov \$$i, %eax
+  ret
+EOF
+done
+
+cat <<EOF | cc -o $t/main.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/main.o $t/2.o $t/3.o $t/1.o
+$t/exe | grep -q '^2$'
+
+clang -fuse-ld=$mold -o $t/exe $t/main.o $t/3.o $t/1.o $t/2.o
+$t/exe | grep -q '^3$'
+
+echo OK
@@ -0,0 +1,26 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -g -o $t/a.o -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+# Shards are compressed with libdeflate if available and with zlib
+# otherwise. Both have to produce the same uncompressed contents.
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o -Wl,--compress-debug-sections=zlib
+MOLD_NO_LIBDEFLATE=1 clang -fuse-ld=$mold -o $t/exe2 $t/a.o \
+  -Wl,--compress-debug-sections=zlib
+$t/exe1 | grep -q 'Hello world'
+
+readelf -WS $t/exe1 | grep -E '\.debug_info .* C ' > /dev/null
+readelf -z -x .debug_info $t/exe1 > $t/log1
+readelf -z -x .debug_info $t/exe2 > $t/log2
+diff -q $t/log1 $t/log2 > /dev/null
+
+echo OK
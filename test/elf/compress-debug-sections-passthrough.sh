@@ -0,0 +1,42 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -x assembler -
+.section .debug_foo,"",@progbits
+.fill 50000, 1, 1
+.ascii "foo"
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -x assembler -
+.section .debug_foo,"",@progbits
+.fill 70000, 1, 2
+.ascii "bar"
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+int main() { return 0; }
+EOF
+
+objcopy --compress-debug-sections=zlib $t/a.o $t/a2.o
+objcopy --compress-debug-sections=zlib-gnu $t/b.o $t/b2.o
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o $t/b.o $t/c.o
+readelf -x .debug_foo $t/exe1 > $t/log1
+
+# Compressed input streams are spliced into the output as-is
+clang -fuse-ld=$mold -o $t/exe2 $t/a2.o $t/b2.o $t/c.o \
+  -Wl,--compress-debug-sections=zlib
+readelf -z -x .debug_foo $t/exe2 > $t/log2
+diff -q $t/log1 $t/log2
+
+clang -fuse-ld=$mold -o $t/exe3 $t/a2.o $t/b2.o $t/c.o \
+  -Wl,--compress-debug-sections=zlib-gnu
+readelf -z -x .zdebug_foo $t/exe3 | sed 's/zdebug/debug/' > $t/log3
+diff -q $t/log1 $t/log3
+
+echo OK
@@ -25,4 +25,8 @@ dwarfdump $t/exe > $t/log
 fgrep -q .zdebug_info $t/log
 fgrep -q .zdebug_str $t/log
 
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--compress-debug-sections=zstd
+readelf -Wt $t/exe > $t/log
+grep -q 'ZSTD' $t/log
+
 echo OK
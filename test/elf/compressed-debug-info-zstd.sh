@@ -0,0 +1,32 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ..."
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+echo 'int main() {}' | clang -c -o /dev/null -gz=zstd -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | clang -c -o $t/a.o -g -gz=zstd -xc++ -
+int main() {
+  return 0;
+}
+EOF
+
+cat <<EOF | clang -c -o $t/b.o -g -gz=zlib -xc++ -
+int foo() {
+  return 0;
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+dwarfdump $t/exe > /dev/null
+readelf --sections $t/exe | fgrep -q .debug_info
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o $t/b.o \
+  -Wl,--compress-debug-sections=zlib
+dwarfdump $t/exe2 > /dev/null
+
+echo ' OK'
@@ -0,0 +1,49 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -o $t/a.o -c -x assembler -
+  .globl foo, bar, baz, qux
+  .type foo, @object
+  .type bar, @object
+  .size foo, 4
+  .size bar, 4
+  .data
+baz:
+  .long 1
+foo:
+bar:
+  .long 42
+qux:
+  .long 3
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/b.so $t/a.o
+
+cat <<EOF | cc -fno-PIC -o $t/c.o -c -xc -
+#include <stdio.h>
+
+extern int foo;
+extern int bar;
+
+int main() {
+  foo = 5;
+  printf("%d %d\n", foo, bar);
+  return 0;
+}
+EOF
+
+clang -fuse-ld=$mold -no-pie -o $t/exe $t/c.o $t/b.so
+$t/exe | grep -q '5 5'
+
+readelf --dyn-syms $t/exe > $t/log
+grep -q ' foo$' $t/log
+grep -q ' bar$' $t/log
+! grep -q ' baz$' $t/log || false
+! grep -q ' qux$' $t/log || false
+
+echo OK
@@ -0,0 +1,42 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fdata-sections -c -o $t/a.o -xc -
+#include <stdio.h>
+int cold1 = 1;
+int hot1 = 2;
+int cold2 = 3;
+int hot2 = 4;
+int cold3 = 5;
+int main() { printf("%d %d %d %d %d\n", cold1, hot1, cold2, hot2, cold3); }
+EOF
+
+cat <<EOF > $t/order
+hot2
+hot1 write-hot
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--data-ordering-file=$t/order
+$t/exe | grep -q '1 2 3 4 5'
+
+nm $t/exe > $t/log
+addr() { echo $((0x$(grep " $1$" $t/log | cut -d' ' -f1))); }
+
+[ $(addr hot2) -lt $(addr hot1) ]
+[ $(addr hot1) -lt $(addr cold1) ]
+
+# A write-hot symbol doesn't share a cache line with other data.
+[ $(($(addr hot1) % 64)) = 0 ]
+[ $(addr cold1) -ge $(($(addr hot1) + 64)) ]
+
+echo 'foo bar' > $t/order2
+! clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--data-ordering-file=$t/order2 \
+  2> $t/log2 || false
+grep -q 'invalid data ordering entry' $t/log2
+
+echo OK
@@ -0,0 +1,52 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | clang -c -o $t/a.o -gdwarf-5 -gpubnames -xc -
+#include <stdio.h>
+
+void hello();
+
+static void greet() {
+  printf("Hello world\n");
+}
+
+int main() {
+  greet();
+  hello();
+  return 0;
+}
+EOF
+
+cat <<EOF | clang -c -o $t/b.o -gdwarf-5 -gpubnames -xc -
+#include <stdio.h>
+
+struct point { int x, y; };
+struct point origin;
+
+void hello() {
+  printf("%d %d\n", origin.x, origin.y);
+}
+EOF
+
+readelf -SW $t/a.o | grep -Fq .debug_names || { echo skipped; exit; }
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o $t/b.o
+readelf --debug-dump $t/exe1 > $t/log1
+[ $(grep -c 'CU table:' $t/log1) = 2 ]
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o $t/b.o -Wl,--debug-names
+$t/exe2 | grep -q 'Hello world'
+
+readelf --debug-dump $t/exe2 > $t/log2
+[ $(grep -c 'CU table:' $t/log2) = 1 ]
+grep -Eq 'main: .*DW_IDX_compile_unit=0 ' $t/log2
+grep -Eq 'greet: .*DW_IDX_compile_unit=0 ' $t/log2
+grep -Eq 'hello: .*DW_IDX_compile_unit=0x1 ' $t/log2
+grep -Eq 'origin: .*DW_IDX_compile_unit=0x1 ' $t/log2
+
+echo OK
@@ -0,0 +1,23 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+char buf[3000000] = {1};
+int main() { printf("Hello %d\n", buf[0]); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o -Wl,-build-id=sha1
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o -Wl,-build-id=sha1 -Wl,-early-writeback
+cmp $t/exe1 $t/exe2
+$t/exe2 | grep -q 'Hello 1'
+
+clang -fuse-ld=$mold -o $t/exe3 $t/a.o -Wl,-early-writeback -Wl,-copy-file-range
+$t/exe3 | grep -q 'Hello 1'
+
+echo OK
@@ -0,0 +1,33 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+#include <stdio.h>
+static int foo() { return 3; }
+int bar() { return foo() + 1; }
+int main() { printf("Hello %d\n", bar()); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-emit-relocs
+$t/exe | grep -q 'Hello 4'
+
+readelf -S $t/exe > $t/log
+grep -Eq '\.rela\.text +RELA' $t/log
+
+readelf -r $t/exe > $t/log
+grep -q "Relocation section '.rela.text'" $t/log
+grep -Eq 'R_X86_64_PLT32 +0+[0-9a-f]* bar - 4' $t/log
+grep -Eq 'R_X86_64_PC32 +0+[0-9a-f]* \.rodata' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-q -Wl,-s
+$t/exe | grep -q 'Hello 4'
+readelf -r $t/exe | grep -q "Relocation section '.rela.text'"
+
+echo OK
@@ -0,0 +1,51 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF2 | cc -c -o $t/a.o -g -ggnu-pubnames -xc -
+#include <stdio.h>
+
+void hello();
+
+static void greet() {
+  printf("Hello world\n");
+}
+
+int main() {
+  greet();
+  hello();
+  return 0;
+}
+EOF2
+
+cat <<EOF2 | cc -c -o $t/b.o -g -ggnu-pubnames -xc -
+#include <stdio.h>
+
+struct point { int x, y; };
+struct point origin;
+
+void hello() {
+  printf("%d %d\n", origin.x, origin.y);
+}
+EOF2
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -Wl,--gdb-index
+$t/exe | grep -q 'Hello world'
+
+readelf -W --debug-dump=gdb_index $t/exe > $t/log
+grep -q 'Version 7' $t/log
+grep -q 'main: 0 \[global, function\]' $t/log
+grep -q 'greet: 0 \[static, function\]' $t/log
+grep -q 'hello: 1 \[global, function\]' $t/log
+grep -q 'origin: 1 \[global, variable\]' $t/log
+grep -q 'point: 1 \[static, type\]' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -Wl,--gdb-index \
+  -Wl,--compress-debug-sections=zlib
+readelf -W --debug-dump=gdb_index $t/exe | grep -q 'hello: 1'
+
+echo OK
@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+int foo1() { return 1; }
+int foo2() { return 2; }
+int foo3() { return 3; }
+int foo4() { return 4; }
+int foo5() { return 5; }
+EOF
+
+cat <<EOF | cc -c -o $t/b.o -xc -
+#include <stdio.h>
+int foo1(), foo2(), foo3(), foo4(), foo5();
+int main() { printf("%d\n", foo1() + foo2() + foo3() + foo4() + foo5()); }
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/c.so $t/a.o
+readelf -WS $t/c.so | grep -q '\.gnu\.hash'
+! readelf -WS $t/c.so | grep -q ' \.hash' || false
+
+clang -fuse-ld=$mold -shared -o $t/c.so $t/a.o -Wl,--hash-style=sysv
+readelf -WS $t/c.so | grep -q ' \.hash'
+! readelf -WS $t/c.so | grep -q '\.gnu\.hash' || false
+
+clang -fuse-ld=$mold -o $t/exe $t/b.o $t/c.so
+LD_LIBRARY_PATH=$t $t/exe | grep -q '^15$'
+
+clang -fuse-ld=$mold -shared -o $t/c.so $t/a.o -Wl,--hash-style=both
+readelf -WS $t/c.so | grep -q ' \.hash'
+readelf -WS $t/c.so | grep -q '\.gnu\.hash'
+LD_LIBRARY_PATH=$t $t/exe | grep -q '^15$'
+
+echo OK
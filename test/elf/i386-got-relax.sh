@@ -0,0 +1,45 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+echo 'int main() {}' | cc -m32 -o $t/exe -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | clang -c -o $t/a.o -x assembler -m32 -Wa,-mrelax-relocations=yes -
+.globl get_foo
+get_foo:
+  call __x86.get_pc_thunk.cx
+  add \$_GLOBAL_OFFSET_TABLE_, %ecx
+  mov foo@GOT(%ecx), %eax
+  mov (%eax), %eax
+  ret
+
+__x86.get_pc_thunk.cx:
+  mov (%esp), %ecx
+  ret
+EOF
+
+cat <<EOF | clang -fPIE -c -o $t/b.o -xc - -m32
+#include <stdio.h>
+
+int foo = 42;
+int get_foo();
+
+int main() {
+  printf("%d\n", get_foo());
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -m32 -pie
+$t/exe | grep -q '^42$'
+objdump -d $t/exe | grep -A4 '<get_foo>:' | grep -q 'lea '
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -m32 -pie -Wl,-no-relax
+$t/exe | grep -q '^42$'
+objdump -d $t/exe | grep -A4 '<get_foo>:' | grep -q 'mov .*(%ecx),%eax'
+
+echo OK
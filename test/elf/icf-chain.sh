@@ -0,0 +1,34 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -O1 -ffunction-sections -xc -
+#include <stdio.h>
+
+__attribute__((noinline)) int leaf1(int x) { return x + 1; }
+__attribute__((noinline)) int leaf2(int x) { return x * 5; }
+__attribute__((noinline)) int mid1(int x) { return leaf1(x) + 3; }
+__attribute__((noinline)) int mid2(int x) { return leaf2(x) + 3; }
+__attribute__((noinline)) int top1(int x) { return mid1(x) * 7; }
+__attribute__((noinline)) int top2(int x) { return mid2(x) * 7; }
+__attribute__((noinline)) int top3(int x) { return mid1(x) * 7; }
+
+int main() {
+  printf("%d %d %d\n", top1(2), top2(2), top3(2));
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-icf=all -Wl,-print-icf-sections \
+  > $t/log
+$t/exe | grep -q '^42 91 42$'
+grep -q 'removing identical section.*top3' $t/log
+! grep -q 'removing identical section.*top2' $t/log || false
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-icf=all -Wl,-gc-sections
+$t/exe | grep -q '^42 91 42$'
+
+echo OK
@@ -0,0 +1,56 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+echo .addrsig | clang -c -o /dev/null -x assembler - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | clang -c -o $t/a.o -x assembler -
+.globl _start
+_start:
+  lea tbl1(%rip), %rax
+  lea tbl2(%rip), %rax
+  lea tbl3(%rip), %rax
+  lea tbl4(%rip), %rax
+  ret
+
+.section .rodata.tbl1,"a"
+.p2align 3
+tbl1:
+  .quad 1, 2, 3, 4
+
+.section .rodata.tbl2,"a"
+.p2align 3
+tbl2:
+  .quad 1, 2, 3, 4
+
+.section .rodata.tbl3,"a"
+.p2align 3
+tbl3:
+  .quad 5, 6, 7, 8
+
+.section .rodata.tbl4,"a"
+.p2align 3
+tbl4:
+  .quad 5, 6, 7, 8
+
+.addrsig
+.addrsig_sym tbl3
+EOF
+
+addr() { nm $t/exe | grep " $1\$" | cut -d' ' -f1; }
+
+# Data is not folded by default.
+$mold -o $t/exe $t/a.o -icf=all
+[ "$(addr tbl1)" != "$(addr tbl2)" ]
+
+# Data whose address is not significant is folded with -icf=all-data.
+$mold -o $t/exe $t/a.o -icf=all-data
+[ "$(addr tbl1)" = "$(addr tbl2)" ]
+[ "$(addr tbl3)" != "$(addr tbl4)" ]
+
+echo OK
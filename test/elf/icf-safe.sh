@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | clang -c -o $t/a.o -ffunction-sections -fdata-sections -xc -
+#include <stdio.h>
+
+int bar1(int x) { return x * 3 + 1; }
+int bar2(int x) { return x * 3 + 1; }
+
+__attribute__((noinline)) int foo1(int x) { return x * 7 + 2; }
+__attribute__((noinline)) int foo2(int x) { return x * 7 + 2; }
+
+int main() {
+  printf("%d %d\n", (long)foo1 == (long)foo2, bar1(1) + bar2(2));
+  return 0;
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-icf=safe \
+  -Wl,-print-icf-sections > $t/log
+$t/exe | grep -q '^0 11$'
+! grep -q 'selected section.*foo' $t/log || false
+
+# Sections whose addresses are not taken can be folded only if the
+# compiler emitted an address significance table.
+if readelf -S $t/a.o | grep -q llvm_addrsig; then
+  grep -q 'selected section.*bar' $t/log
+else
+  ! grep -q 'selected section' $t/log || false
+fi
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-icf=all
+$t/exe | grep -q '^1 11$'
+
+echo OK
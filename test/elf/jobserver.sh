@@ -0,0 +1,44 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+# Emulate GNU make's jobserver with three tokens in a fifo.
+rm -f $t/fifo
+mkfifo $t/fifo
+exec 3<>$t/fifo
+printf '+++' >&3
+
+MAKEFLAGS="-j4 --jobserver-auth=fifo:$t/fifo" \
+  clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--jobserver -Wl,--thread-count=4
+$t/exe | grep -q 'Hello world'
+
+MAKEFLAGS="-j4 --jobserver-auth=3,3" \
+  clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--jobserver -Wl,--thread-count=4
+$t/exe | grep -q 'Hello world'
+
+# Tokens are returned even if we fail.
+cat <<EOF | cc -o $t/b.o -c -xc -
+int foo();
+int main() { foo(); }
+EOF
+
+! MAKEFLAGS="-j4 --jobserver-auth=fifo:$t/fifo" \
+  clang -fuse-ld=$mold -o $t/exe $t/b.o -Wl,--jobserver \
+  -Wl,--thread-count=4 2> /dev/null || false
+
+# All tokens have to be returned.
+[ "$(timeout 5 head -c 3 <&3)" = '+++' ]
+
+exec 3>&-
+echo OK
@@ -0,0 +1,43 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello\n"); }
+EOF
+
+rm -rf $t/cache
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-link-cache=$t/cache
+$t/exe | grep -q Hello
+[ "$(ls $t/cache | wc -l)" = 1 ]
+cmp $t/exe $t/cache/*
+
+# A cache hit doesn't link the program, so -Map is not written.
+rm -f $t/exe
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-link-cache=$t/cache \
+  -Wl,-Map=$t/map
+$t/exe | grep -q Hello
+[ "$(ls $t/cache | wc -l)" = 2 ]
+
+rm -f $t/exe $t/map
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-link-cache=$t/cache \
+  -Wl,-Map=$t/map
+$t/exe | grep -q Hello
+[ ! -e $t/map ]
+
+# Changing an input file invalidates the cache.
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("World\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-link-cache=$t/cache
+$t/exe | grep -q World
+[ "$(ls $t/cache | wc -l)" = 3 ]
+
+echo OK
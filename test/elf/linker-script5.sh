@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -o $t/a.o -c -xc -
+int foo() { return 3; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+int bar() { return 4; }
+EOF
+
+rm -f $t/libfoo.a
+clang -fuse-ld=$mold -shared -o $t/libfoo.so $t/a.o
+ar rcs $t/libfoo.a $t/b.o
+
+cat <<EOF > $t/script
+GROUP(AS_NEEDED(-lfoo))
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+#include <stdio.h>
+int foo();
+int bar();
+int main() { printf("%d %d\n", foo(), bar()); }
+EOF
+
+# The same script resolves to different files depending on -Bstatic.
+clang -fuse-ld=$mold -o $t/exe $t/c.o -L$t $t/script \
+  -Wl,-Bstatic $t/script -Wl,-Bdynamic -Wl,-rpath=$t
+$t/exe | grep -q '3 4'
+
+readelf --dynamic $t/exe | grep -Fq 'libfoo.so]'
+
+echo OK
@@ -0,0 +1,36 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+echo 'int main() {}' | gcc -flto -o /dev/null -xc - >& /dev/null \
+  || { echo skipped; exit; }
+
+cat <<EOF | gcc -flto -c -o $t/a.o -xc -
+#include <stdio.h>
+int foo(int);
+int main() {
+  printf("Hello %d\n", foo(3));
+  return 0;
+}
+EOF
+
+cat <<EOF | gcc -flto -c -o $t/b.o -xc -
+int foo(int x) { return x * 3 + 1; }
+int bar(void) { return 42; }
+EOF
+
+rm -f $t/c.a
+ar rcs $t/c.a $t/b.o
+
+gcc -B`dirname $mold` -flto -O2 -o $t/exe1 $t/a.o $t/b.o
+$t/exe1 | grep -q 'Hello 10'
+! nm $t/exe1 | grep -q ' T bar$' || false
+
+gcc -B`dirname $mold` -flto -O2 -o $t/exe2 $t/a.o $t/c.a
+$t/exe2 | grep -q 'Hello 10'
+
+echo OK
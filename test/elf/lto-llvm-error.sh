@@ -11,6 +11,6 @@ int main() {}
 EOF
 
 ! clang -fuse-ld=$mold -o $t/exe $t/a.o &> $t/log
-grep -q '.*/a.o: .*mold does not support LTO' $t/log
+grep -q '.*/a.o: .*no --plugin option was given' $t/log
 
 echo OK
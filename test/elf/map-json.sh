@@ -0,0 +1,19 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+int foo() { return 3; }
+int main() { return foo(); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-Map=$t/map -Wl,--Map-format=json
+python3 -m json.tool $t/map > /dev/null
+fgrep -q '"name":"foo"' $t/map
+fgrep -q '"name":".text"' $t/map
+
+echo OK
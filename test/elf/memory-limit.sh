@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -x assembler -
+.section .debug_foo,"",@progbits
+.fill 300000, 1, 1
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -x assembler -
+.section .debug_foo,"",@progbits
+.fill 300000, 1, 2
+.section .debug_bar,"",@progbits
+.fill 300000, 1, 3
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o $t/b.o $t/c.o
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o $t/b.o $t/c.o -Wl,--memory-limit=64K
+cmp $t/exe1 $t/exe2
+$t/exe2 | grep -q Hello
+
+clang -fuse-ld=$mold -o $t/exe3 $t/a.o $t/b.o $t/c.o \
+  -Wl,-compress-debug-sections=zlib
+clang -fuse-ld=$mold -o $t/exe4 $t/a.o $t/b.o $t/c.o \
+  -Wl,-compress-debug-sections=zlib -Wl,--memory-limit=1M
+cmp $t/exe3 $t/exe4
+
+! clang -fuse-ld=$mold -o $t/exe5 $t/c.o -Wl,--memory-limit=foo 2> $t/log || false
+grep -q 'not a number' $t/log
+
+echo OK
@@ -0,0 +1,30 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -O2 -xc -
+const char *foo() { return "foobar"; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -O2 -xc -
+#include <stdio.h>
+const char *foo();
+int main() {
+  const char *x = foo();
+  const char *y = "bar";
+  printf("%s %s %d\n", x, y, (int)(y - x));
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+$t/exe | grep -q '^foobar bar'
+! $t/exe | grep -q '^foobar bar 3$' || false
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -Wl,-O2
+$t/exe | grep -q '^foobar bar 3$'
+
+echo OK
@@ -0,0 +1,38 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -O2 -xc -
+#include <uchar.h>
+const char16_t *foo() { return u"Hello"; }
+const char16_t *bar() { return u"World"; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -O2 -xc -
+#include <stdio.h>
+#include <uchar.h>
+
+const char16_t *foo();
+const char16_t *bar();
+
+void print(const char16_t *s) {
+  for (; *s; s++)
+    putchar(*s);
+}
+
+int main() {
+  print(foo());
+  print(u" ");
+  print(bar());
+  printf(" %d\n", bar() == (const char16_t *)u"World");
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+$t/exe | grep -q '^Hello World 1$'
+
+echo OK
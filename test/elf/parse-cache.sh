@@ -0,0 +1,48 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+void hello() { printf("Hello world\n"); }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+void hello();
+int main() { hello(); printf("Hello world\n"); }
+EOF
+
+rm -rf $t/cache
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o $t/b.o -Wl,-parse-cache=$t/cache
+$t/exe1 | grep -q 'Hello world'
+n=$(ls $t/cache | wc -l)
+[ $n -gt 0 ]
+
+# Pieces read from the cache are merged the same way.
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o $t/b.o -Wl,-parse-cache=$t/cache \
+  -Wl,-stats > $t/log
+grep -q 'parse_cache_hits=[1-9]' $t/log
+$t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
+
+# Changing an input file invalidates its cache entry.
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+void hello() { printf("Hello again\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe3 $t/a.o $t/b.o -Wl,-parse-cache=$t/cache
+$t/exe3 | grep -q 'Hello again'
+[ $(ls $t/cache | wc -l) = $((n + 1)) ]
+
+# A broken cache entry is ignored.
+for f in $t/cache/*; do echo garbage > $f; done
+clang -fuse-ld=$mold -o $t/exe4 $t/a.o $t/b.o -Wl,-parse-cache=$t/cache
+$t/exe4 | grep -q 'Hello again'
+
+echo OK
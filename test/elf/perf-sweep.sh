@@ -0,0 +1,24 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -xc -
+#include <stdio.h>
+int main() { printf("Hello\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf-sweep=1,2 > $t/log
+grep -q 'threads=1 *threads=2' $t/log
+grep -q 'Real Speedup   Eff  Name' $t/log
+grep -q ' all$' $t/log
+grep -q ' copy_buf$' $t/log
+$t/exe | grep -q Hello
+
+! clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf-sweep=0 2> $t/log || false
+grep -q 'invalid thread count: 0' $t/log
+
+echo OK
@@ -0,0 +1,35 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -xc -
+int main() {}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf > $t/log
+grep -q 'User   System     Real' $t/log
+grep -q ' copy_buf$' $t/log
+grep -q 'Max/Mean.*Name (slowest task)' $t/log
+grep -q ' copy_buf (.*)$' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf=json > $t/log
+grep -q '^\[{"name":"all",' $t/log
+grep -q '"name":"copy_buf",.*"maxrss_kb":.*"tasks":{"count":' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf=chrome-trace > $t/log
+grep -q '^{"displayTimeUnit":"ms","traceEvents":\[' $t/log
+grep -q '^{"name":"copy_buf","ph":"X",' $t/log
+grep -q '"cat":"task".*"args":{"loop":"copy_buf"}' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf=files > $t/log
+grep -q '^Parse(ms) Scan(ms) Copy(ms) Size(MB) Sections' $t/log
+grep -q ' .*/a\.o$' $t/log
+
+! clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf=foo 2> $t/log || false
+grep -q 'unknown --perf argument: foo' $t/log
+
+echo OK
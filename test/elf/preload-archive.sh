@@ -0,0 +1,42 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+void hello();
+int main() {
+  hello();
+}
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+void hello() {
+  printf("Hello world\n");
+}
+EOF
+
+rm -f $t/exe $t/d.a
+ar rcs $t/d.a $t/b.o
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/d.a -Wl,-preload
+! test -e $t/exe || false
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+void hello() {
+  printf("Hello archive\n");
+}
+EOF
+
+rm -f $t/d.a
+ar rcs $t/d.a $t/b.o
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/d.a
+$t/exe | grep -q 'Hello archive'
+
+echo OK
@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf -Wl,-preload
+
+# Links served by the daemon either re-read updated files first or
+# check that a layout computed in the background is still valid.
+# Wait for the daemon to start listening.
+for i in $(seq 1 20); do
+  rm -f $t/exe
+  clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf > $t/log0
+  grep -Eq 'reload_input_files|check_speculated_files' $t/log0 && break
+  sleep 0.5
+done
+grep -Eq 'reload_input_files|check_speculated_files' $t/log0
+$t/exe | grep -q 'Hello world'
+
+# The daemon keeps serving clients, including concurrent ones.
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf > $t/log1 &
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-perf > $t/log2 &
+wait
+
+grep -Eq 'reload_input_files|check_speculated_files' $t/log1
+grep -Eq 'reload_input_files|check_speculated_files' $t/log2
+$t/exe | grep -q 'Hello world'
+
+echo OK
@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+int foo();
+int main() { return 0; }
+void bar() { foo(); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--warn-unresolved-symbols \
+  -Wl,-perf -Wl,-preload
+
+# The daemon links its inputs in the background, but a warning printed
+# while doing so must still be shown to each client.
+for i in $(seq 1 20); do
+  clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--warn-unresolved-symbols \
+    -Wl,-perf > $t/log 2>&1
+  grep -Eq 'reload_input_files|check_speculated_files' $t/log && break
+  sleep 0.5
+done
+
+grep -Eq 'reload_input_files|check_speculated_files' $t/log
+grep -q 'undefined symbol:.*foo' $t/log
+$t/exe
+
+echo OK
@@ -0,0 +1,47 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+rm -f $t/exe
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-preload
+! test -e $t/exe || false
+
+# Replace the input file the way compilers do, via a temporary file,
+# and give the daemon a chance to re-read it before we link.
+cat <<EOF | cc -o $t/a.o.tmp -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello again\n");
+}
+EOF
+mv $t/a.o.tmp $t/a.o
+sleep 1
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o
+$t/exe | grep -q 'Hello again'
+
+# Link right after an update, before the daemon notices it.
+cat <<EOF | cc -o $t/a.o.tmp -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello once more\n");
+}
+EOF
+mv $t/a.o.tmp $t/a.o
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o
+$t/exe | grep -q 'Hello once more'
+
+echo OK
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -ffunction-sections -xc -
+int foo() { return 1; }
+int bar() { return 1; }
+int main() { return foo() - bar(); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-icf=all \
+  -Wl,-progress-fd=3 3> $t/log
+grep -q '^phase parse_input_files$' $t/log
+grep -q '^progress parse [0-9]* [0-9]*$' $t/log
+grep -q '^icf 1 [0-9]*$' $t/log
+grep -q '^progress copy_buf [0-9]* [0-9]*$' $t/log
+tail -1 $t/log | grep -q '^done$'
+$t/exe
+
+! clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-progress-fd=99 2> $t/log || false
+grep -q 'bad file descriptor: 99' $t/log
+
+echo OK
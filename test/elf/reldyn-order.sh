@@ -0,0 +1,42 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+int z = 5;
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/b.so $t/a.o
+
+cat <<EOF | cc -fPIC -c -o $t/c.o -xc -
+#include <stdio.h>
+int x = 1, y = 2;
+int *p[] = {&x, &y, &x};
+extern int z;
+int *q = &z;
+void *fp = (void *)printf;
+int main() { printf("%d %d %d\n", *p[0], *p[1], *q); }
+EOF
+
+cat <<EOF | cc -fPIC -c -o $t/d.o -xc -
+int w = 3;
+int *r[] = {&w, &w};
+EOF
+
+clang -fuse-ld=$mold -pie -o $t/exe $t/c.o $t/d.o $t/b.so
+$t/exe | grep -q '^1 2 5$'
+
+# R_RELATIVE relocations come first in the address order,
+# and DT_RELACOUNT is the number of them.
+readelf -rW $t/exe | sed -n '/\.rela\.dyn/,/^$/p' | \
+  awk '$3 ~ /_RELATIVE$/' > $t/log
+readelf -rW $t/exe | sed -n '/\.rela\.dyn/,/^$/p' | \
+  awk '$3 ~ /^R_/' | head -$(wc -l < $t/log) | cmp - $t/log
+sort -c $t/log
+readelf -d $t/exe | grep -q "(RELACOUNT) *$(wc -l < $t/log)\$"
+
+echo OK
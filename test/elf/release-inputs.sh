@@ -0,0 +1,30 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+# Make the object files large enough to be mmap'ed.
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+char buf[100000] = {1};
+void hello() { printf("Hello %d\n", buf[0]); }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+char buf2[100000] = {2};
+void hello();
+int main() { hello(); }
+EOF
+
+rm -f $t/c.a
+ar rcs $t/c.a $t/a.o
+
+clang -fuse-ld=$mold -o $t/exe1 $t/b.o $t/c.a
+clang -fuse-ld=$mold -o $t/exe2 $t/b.o $t/c.a -Wl,-release-inputs
+cmp $t/exe1 $t/exe2
+$t/exe2 | grep -q 'Hello 1'
+
+echo OK
@@ -34,4 +34,13 @@ tar -C $t -xzf $t/repro.tar.gz
 fgrep -q /a.o  $t/repro/response.txt
 fgrep -q mold $t/repro/version.txt
 
+
+rm -rf $t/repro
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-repro-file=$t/repro.tar.zst
+! readelf --sections $t/exe | fgrep -q .repro || false
+
+zstd -dc $t/repro.tar.zst | tar -C $t -xf -
+fgrep -q /a.o  $t/repro/response.txt
+fgrep -q mold $t/repro/version.txt
+
 echo OK
@@ -0,0 +1,28 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -g -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--separate-debug-file
+$t/exe | grep -q 'Hello world'
+
+readelf -SW $t/exe > $t/log
+grep -Fq .gnu_debuglink $t/log
+! grep -Fq .debug_info $t/log || false
+
+readelf -SW $t/exe.dbg | grep -Fq .debug_info
+readelf --string-dump=.gnu_debuglink $t/exe | grep -Fq exe.dbg
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o -Wl,--separate-debug-file=$t/foo.dbg
+readelf -SW $t/foo.dbg | grep -Fq .debug_info
+readelf --string-dump=.gnu_debuglink $t/exe2 | grep -Fq foo.dbg
+
+echo OK
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ -d /dev/shm ] || { echo skipped; exit; }
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+void hello() { printf("Hello world\n"); }
+int main() { hello(); printf("Hello world\n"); }
+EOF
+
+dir=/dev/shm/mold-parse-cache-$(id -u)
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o -Wl,-shm-parse-cache
+$t/exe1 | grep -q 'Hello world'
+[ "$(stat -c %a $dir)" = 700 ]
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o -Wl,-shm-parse-cache -Wl,-stats > $t/log
+grep -q 'parse_cache_hits=[1-9]' $t/log
+cmp $t/exe1 $t/exe2
+
+echo OK
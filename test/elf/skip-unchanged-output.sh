@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello\n"); }
+EOF
+
+rm -f $t/exe
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-skip-unchanged-output
+$t/exe | grep -q Hello
+readelf -SW $t/exe | grep -Fq .mold.input-digest
+
+# The output is not rewritten if inputs are the same, even if their
+# timestamps have changed.
+mtime="$(stat -c %y $t/exe)"
+touch $t/a.o
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-skip-unchanged-output
+[ "$(stat -c %y $t/exe)" = "$mtime" ]
+
+# Changing an input file or the command line relinks the output.
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("World\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-skip-unchanged-output
+$t/exe | grep -q World
+[ "$(stat -c %y $t/exe)" != "$mtime" ]
+
+mtime="$(stat -c %y $t/exe)"
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-skip-unchanged-output -Wl,-s
+[ "$(stat -c %y $t/exe)" != "$mtime" ]
+
+echo OK
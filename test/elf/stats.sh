@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-stats > $t/log
+grep -q ' num_objs=' $t/log
+grep -q '^relocs_per_section: count=' $t/log
+grep -q '^input_section_size: count=' $t/log
+grep -q 'pool_push_back_acquired=' $t/log
+grep -q ' mem_obj_pool=' $t/log
+grep -q ' peak_rss_kb=' $t/log
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-stats=json > $t/log
+python3 -m json.tool $t/log > /dev/null
+grep -q '^{"counters":{.*"num_objs":' $t/log
+grep -q '^"relocs_per_section":{"count":.*"buckets":\[{"min":' $t/log
+grep -q '"phases":\[' $t/log
+
+! clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-stats=foo 2> $t/log || false
+grep -q 'unknown --stats argument: foo' $t/log
+
+echo OK
@@ -0,0 +1,18 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -g -o $t/a.o -xc -
+int main() {}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--strip-debug-except=.debug_line
+readelf --sections $t/exe > $t/log
+fgrep -q .debug_line $t/log
+! fgrep -q .debug_info $t/log || false
+
+echo OK
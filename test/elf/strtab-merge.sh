@@ -0,0 +1,34 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -c -o $t/a.o -xc -
+static int helper() { return 1; }
+int foo() { return helper(); }
+EOF
+
+cat <<EOF | cc -c -o $t/b.o -xc -
+static int helper() { return 2; }
+int bar() { return helper(); }
+EOF
+
+cat <<EOF | cc -c -o $t/c.o -xc -
+#include <stdio.h>
+static int helper() { return 3; }
+int foo();
+int bar();
+int main() { printf("%d\n", foo() + bar() + helper()); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o $t/c.o
+$t/exe | grep -q '^6$'
+
+# Identical local symbol names share the same string.
+[ "$(readelf -sW $t/exe | grep -c ' helper$')" = 3 ]
+[ "$(readelf -p .strtab $t/exe | grep -c ' helper$')" = 1 ]
+
+echo OK
@@ -0,0 +1,30 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF2 | cc -o $t/a.o -c -xc -ffunction-sections -
+void foo() {}
+void bar() {}
+void baz() {}
+int main() { foo(); bar(); baz(); }
+EOF2
+
+cat <<EOF2 > $t/order
+baz
+main
+foo
+EOF2
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--symbol-ordering-file=$t/order
+$t/exe
+
+nm $t/exe | grep -E ' T (foo|bar|baz|main)$' | sort > $t/log
+grep -A1 ' baz$' $t/log | grep -q ' main$'
+grep -A1 ' main$' $t/log | grep -q ' foo$'
+grep -A1 ' foo$' $t/log | grep -q ' bar$'
+
+echo OK
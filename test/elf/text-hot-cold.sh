@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+
+__attribute__((section(".text.unlikely.foo"))) int cold() { return 1; }
+__attribute__((section(".text.startup.foo"))) int startup() { return 2; }
+__attribute__((section(".text.foo"))) int normal() { return 3; }
+__attribute__((section(".text.hot.foo"))) int hot() { return 4; }
+
+int main() {
+  printf("%d\n", cold() + startup() + normal() + hot());
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o
+$t/exe | grep -q 10
+
+nm -n $t/exe | grep -E ' (hot|normal|startup|cold)$' | awk '{print $3}' | \
+  tr '\n' ' ' | grep -q '^hot normal startup cold $'
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-z,keep-text-section-prefix
+readelf -W --sections $t/exe | grep -q '\.text\.hot'
+
+echo OK
@@ -0,0 +1,36 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+int five() { return 5; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+static int seven() { return 7; }
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+#include <stdio.h>
+int five();
+int main() { printf("%d\n", five()); }
+EOF
+
+rm -f $t/d.a
+(cd $t; ar rcsT d.a a.o b.o)
+
+# b.o defines no global symbol, so it is never opened.
+rm $t/b.o
+
+clang -fuse-ld=$mold -o $t/exe $t/c.o $t/d.a
+$t/exe | grep -q 5
+
+! clang -fuse-ld=$mold -o $t/exe $t/c.o -Wl,--whole-archive $t/d.a \
+  -Wl,--no-whole-archive 2> $t/log || false
+grep -q 'cannot open .*b.o' $t/log
+
+echo OK
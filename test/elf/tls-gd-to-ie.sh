@@ -0,0 +1,44 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+# Skip if target is not x86-64
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+cat <<EOF | gcc -fPIC -c -o $t/a.o -xc -
+_Thread_local int x1 = 1;
+EOF
+
+cat <<EOF > $t/b.c
+#include <stdio.h>
+
+extern _Thread_local int x1;
+static _Thread_local int x2 = 2;
+static _Thread_local int x3 = 3;
+
+int main() {
+  x1 += 10;
+  x2 += 10;
+  printf("%d %d %d\n", x1, x2, x3);
+  return 0;
+}
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/c.so $t/a.o
+
+for opt in -fplt -fno-plt; do
+  gcc -fPIC -O2 $opt -c -o $t/b.o $t/b.c
+
+  clang -fuse-ld=$mold -o $t/exe $t/b.o $t/c.so
+  $t/exe | grep -q '^11 12 3$'
+  ! objdump -d $t/exe | grep -A20 '<main>:' | grep -q __tls_get_addr || false
+
+  clang -fuse-ld=$mold -o $t/exe $t/b.o $t/c.so -Wl,-no-relax
+  $t/exe | grep -q '^11 12 3$'
+done
+
+echo OK
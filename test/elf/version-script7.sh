@@ -0,0 +1,39 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<'EOF' > $t/a.ver
+VER1 { foo*; };
+VER2 { foo_b*r; *_baz; };
+VER3 { foo_bar_x; extern "C++" { ns::func*; }; };
+VER4 { *zz*; };
+EOF
+
+cat <<EOF | c++ -fPIC -c -o $t/b.o -xc++ -
+extern "C" {
+int foo1() { return 1; }
+int foo_bar() { return 2; }
+int foo_bar_x() { return 3; }
+int foo_xyz_baz() { return 4; }
+int fizzbuzz() { return 5; }
+int foo_buzz() { return 6; }
+}
+namespace ns { int func1() { return 7; } }
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/c.so $t/b.o -Wl,--version-script=$t/a.ver
+
+readelf --dyn-syms $t/c.so > $t/log
+grep -q ' foo1@@VER1$' $t/log
+grep -q ' foo_bar@@VER2$' $t/log
+grep -q ' foo_bar_x@@VER3$' $t/log
+grep -q ' foo_xyz_baz@@VER2$' $t/log
+grep -q ' fizzbuzz@@VER4$' $t/log
+grep -q ' foo_buzz@@VER4$' $t/log
+grep -q ' _ZN2ns5func1Ev@@VER3$' $t/log
+
+echo OK
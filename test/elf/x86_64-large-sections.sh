@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+cat <<EOF | cc -c -o $t/a.o -xc - -mcmodel=medium -mlarge-data-threshold=1000
+const char large_ro[4000] = {1};
+char large_rw[4000] = {2};
+char large_bss[4000];
+EOF
+
+cat <<EOF | cc -c -o $t/b.o -xc -
+#include <stdio.h>
+extern const char large_ro[];
+extern char large_rw[], large_bss[];
+const char small_ro[10] = {3};
+char small_rw[10] = {4};
+char small_bss[10];
+int main() {
+  printf("%d %d %d %d %d %d\n", large_ro[0], large_rw[0], large_bss[0],
+         small_ro[0], small_rw[0], small_bss[0]);
+}
+EOF
+
+readelf -WS $t/a.o | grep -Fq .lrodata || { echo skipped; exit; }
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+$t/exe | grep -q '1 2 0 3 4 0'
+
+# Large sections are placed after all the other sections.
+readelf -WS $t/exe | grep -E '\.(bss|lbss|lrodata|ldata) ' | \
+  awk '{ print $2 }' | tr '\n' ' ' > $t/log
+grep -q '^.bss .lbss .lrodata .ldata $' $t/log
+
+echo OK
@@ -0,0 +1,40 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+[ $(uname -m) = x86_64 ] || { echo skipped; exit; }
+
+cat <<EOF | cc -o $t/a.o -c -x assembler -
+  .globl main
+  .section .text.main,"ax",@progbits
+main:
+  xor %eax, %eax
+  jmp main.part1
+
+  .section .text.main.part1,"ax",@progbits
+main.part1:
+  add \$1, %eax
+  jmp main.part2
+
+  .section .text.main.part2,"ax",@progbits
+main.part2:
+  add \$2, %eax
+  ret
+EOF
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o
+[ "$($t/exe1; echo $?)" = 3 ]
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o -Wl,-optimize-bb-jumps
+[ "$($t/exe2; echo $?)" = 3 ]
+
+objdump -d $t/exe1 > $t/log1
+objdump -d $t/exe2 > $t/log2
+grep -A8 '<main>:' $t/log1 | grep -q 'jmp.*<main.part1>'
+! grep -A8 '<main>:' $t/log2 | grep -q 'jmp.*<main.part[12]>' || false
+
+echo OK
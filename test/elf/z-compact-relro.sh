@@ -0,0 +1,34 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+#include <stdio.h>
+int x = 5;
+int *p = &x;
+void hello() { printf("Hello %d\n", *p); }
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/b.so $t/a.o
+clang -fuse-ld=$mold -shared -o $t/c.so $t/a.o -Wl,-z,compact-relro
+
+# The RW data follows the RELRO data in a separate segment.
+readelf -Wl $t/c.so > $t/log
+[ "$(grep -c 'LOAD.*RW' $t/log)" = 2 ]
+grep -q GNU_RELRO $t/log
+
+[ $(stat -c %s $t/c.so) -lt $(stat -c %s $t/b.so) ]
+
+cat <<EOF | cc -fPIC -c -o $t/d.o -xc -
+void hello();
+int main() { hello(); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe -Wl,-rpath=$t $t/d.o $t/c.so -Wl,-z,compact-relro
+$t/exe | grep -q 'Hello 5'
+
+echo OK
@@ -0,0 +1,29 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -ffunction-sections -
+#include <stdio.h>
+
+int normal() { return 1; }
+__attribute__((section(".text.hot.hot"))) int hot() { return 2; }
+
+int main() {
+  printf("%d\n", normal() + hot());
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-z,hugepage-text
+$t/exe | grep -q 3
+
+readelf -W --segments $t/exe | grep 'LOAD.*R E' > $t/log
+grep -Eq '^ *LOAD +0x[0-9a-f]*00000 0x[0-9a-f]*00000 .* 0x200000$' $t/log
+
+# .text.hot.* comes first in .text
+nm -n $t/exe | grep -E ' (hot|normal)$' | head -1 | grep -q ' hot$'
+
+echo OK
@@ -0,0 +1,44 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -fPIC -c -o $t/a.o -xc -
+#include <stdio.h>
+
+void world() {
+  printf("world\n");
+}
+
+void hello() {
+  printf("Hello ");
+  world();
+}
+EOF
+
+clang -fuse-ld=$mold -shared -o $t/b.so $t/a.o -Wl,-z,now
+readelf -WS $t/b.so > $t/log1
+! grep -Fq ' .plt ' $t/log1 || false
+grep -Fq ' .plt.got ' $t/log1
+
+cat <<EOF | cc -fPIC -c -o $t/c.o -xc -
+void hello();
+int main() { hello(); }
+EOF
+
+clang -fuse-ld=$mold -pie -o $t/exe1 -Wl,-rpath=$t $t/c.o $t/b.so -Wl,-z,now
+$t/exe1 | grep -q 'Hello world'
+
+readelf -WS $t/exe1 > $t/log2
+! grep -Fq ' .plt ' $t/log2 || false
+grep -Fq ' .plt.got ' $t/log2
+
+# Without -z now, lazy PLT entries are created as before.
+clang -fuse-ld=$mold -pie -o $t/exe2 -Wl,-rpath=$t $t/c.o $t/b.so
+$t/exe2 | grep -q 'Hello world'
+readelf -WS $t/exe2 | grep -Fq ' .plt '
+
+echo OK
@@ -0,0 +1,50 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | clang -fPIC -c -o $t/a.o -xc -
+#include <stdio.h>
+
+int x = 1, y = 2, z = 3;
+
+int *arr[] = {
+  &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x,
+  &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y,
+  &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z,
+  &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x,
+  &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y, &z, &x, &y,
+};
+
+struct {
+  char c;
+  int *p;
+} __attribute__((packed)) s = {0, &z};
+
+int *get_y() { return &y; }
+
+int main() {
+  int sum = 0;
+  for (int i = 0; i < sizeof(arr) / sizeof(*arr); i++)
+    sum += *arr[i];
+  printf("%d %d %d\n", sum, *s.p, *get_y());
+}
+EOF
+
+clang -fuse-ld=$mold -pie -o $t/exe $t/a.o -Wl,-z,pack-relative-relocs
+$t/exe | grep -q '^159 3 2$'
+
+readelf -WS $t/exe | grep -q '\.relr\.dyn'
+readelf --dynamic $t/exe | grep -q '(RELR)'
+
+# A relocation at a misaligned address stays in .rela.dyn.
+readelf -r $t/exe | grep -q _RELATIVE
+
+clang -fuse-ld=$mold -pie -o $t/exe $t/a.o
+$t/exe | grep -q '^159 3 2$'
+! readelf -WS $t/exe | grep -q '\.relr\.dyn' || false
+
+echo OK
@@ -0,0 +1,35 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/elf/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+__attribute__((section(".data.zero"))) char zero[3000000] = {0};
+__attribute__((aligned(2097152))) char buf[100] = {1};
+int main() { printf("Hello %d %d\n", zero[100], buf[0]); }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+__attribute__((section(".data.zero"))) char zero[3000000] = {5};
+__attribute__((aligned(2097152))) char buf[100] = {3};
+int main() { printf("Hello %d %d\n", zero[0], buf[0]); }
+EOF
+
+# The first link creates a new file, and the following links reuse
+# the existing file that contains stale bytes.
+rm -f $t/exe1 $t/exe2
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o
+$t/exe1 | grep -q 'Hello 0 1'
+
+clang -fuse-ld=$mold -o $t/exe2 $t/b.o
+$t/exe2 | grep -q 'Hello 5 3'
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o
+$t/exe2 | grep -q 'Hello 0 1'
+cmp $t/exe1 $t/exe2
+
+echo OK
@@ -0,0 +1,26 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-bind_at_load
+$t/exe | grep -q 'Hello world'
+
+otool -l $t/exe > $t/log
+grep -q LC_DYLD_INFO_ONLY $t/log
+grep -q __la_symbol_ptr $t/log
+! grep -q __stub_helper $t/log || false
+
+otool -hv $t/exe | grep -q BINDATLOAD
+
+echo OK
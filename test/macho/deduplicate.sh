@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc - -O2
+int foo(int x) { return x * 3 + 1; }
+int bar(int x) { return x * 3 + 1; }
+int baz(int x) { return x * 5 + 2; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+int foo(int);
+int bar(int);
+int baz(int);
+int main() {
+  printf("%d %d %d %d\n", foo(1), bar(2), baz(3), foo == bar);
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+$t/exe | grep -q '^4 7 17 0$'
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -Wl,-deduplicate
+$t/exe | grep -q '^4 7 17 1$'
+
+echo OK
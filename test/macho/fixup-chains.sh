@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+static const char *msg = "Hello world";
+const char **ptr = &msg;
+int main() {
+  printf("%s\n", *ptr);
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-fixup_chains
+$t/exe | grep -q 'Hello world'
+
+otool -l $t/exe > $t/log
+grep -q LC_DYLD_CHAINED_FIXUPS $t/log
+grep -q LC_DYLD_EXPORTS_TRIE $t/log
+! grep -q LC_DYLD_INFO_ONLY $t/log || false
+! grep -q __stub_helper $t/log || false
+
+echo OK
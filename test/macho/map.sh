@@ -28,4 +28,12 @@ grep -Eq '^0x[0-9A-Fa-f]+     0x[0-9A-Fa-f]+      __TEXT  __text$' $t/map
 grep -Eq '^0x[0-9A-Fa-f]+     0x[0-9A-Fa-f]+      \[  0\] _hello$' $t/map
 grep -Eq '^0x[0-9A-Fa-f]+     0x[0-9A-Fa-f]+      \[  1\] _main$' $t/map
 
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -Wl,-map,$t/map.json \
+  -Wl,-map_format,json
+
+python3 -c 'import json, sys; json.load(open(sys.argv[1]))' $t/map.json
+grep -q '"section":"__text"' $t/map.json
+grep -q '"file":0,"name":"_hello"' $t/map.json
+grep -q '"file":1,"name":"_main"' $t/map.json
+
 echo OK
@@ -0,0 +1,31 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+void hello() {
+  printf("Hello world %f\n", 1.5);
+}
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+void hello();
+int main() {
+  hello();
+  printf("Hello world %f\n", 1.5);
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+[ "$($t/exe | grep -c 'Hello world 1.500000')" = 2 ]
+
+otool -v -s __TEXT __cstring $t/exe > $t/log
+[ "$(grep -c 'Hello world' $t/log)" = 1 ]
+
+echo OK
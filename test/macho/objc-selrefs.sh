@@ -0,0 +1,32 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xobjective-c -
+#import <Foundation/NSObject.h>
+void foo() { [NSObject description]; [NSObject hash]; }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xobjective-c -
+#import <Foundation/NSObject.h>
+void foo();
+int main() {
+  foo();
+  [NSObject description]; [NSObject hash];
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o -framework Foundation
+$t/exe
+
+# There is only one selector reference for each of `description` and
+# `hash`, and only one class reference to NSObject.
+otool -l $t/exe > $t/log
+grep -A4 'sectname __objc_selrefs' $t/log | grep -q 'size 0x0*10$'
+grep -A4 'sectname __objc_classrefs' $t/log | grep -q 'size 0x0*8$'
+
+echo OK
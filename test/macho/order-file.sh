@@ -0,0 +1,32 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+
+void print(const char *s) { printf("%s\n", s); }
+void hello() { print("Hello world"); }
+void howdy() { print("Howdy world"); }
+int main() { hello(); howdy(); }
+EOF
+
+cat <<EOF > $t/order
+# comment
+_howdy
+arm64:_main
+x86_64:_main
+a.o:_hello
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,-order_file,$t/order
+$t/exe | grep -q 'Hello world'
+
+nm -n $t/exe | grep -E ' T _(howdy|main|hello|print)$' | awk '{print $3}' > $t/log
+[ "$(tr '\n' ' ' < $t/log)" = '_howdy _main _hello _print ' ]
+
+echo OK
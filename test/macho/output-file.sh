@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+rm -f $t/exe
+(umask 077; clang -fuse-ld=$mold -o $t/exe $t/a.o)
+[ "$(stat -f %Lp $t/exe)" = 700 ]
+
+# An existing output file is replaced with a new one.
+ino=$(stat -f %i $t/exe)
+clang -fuse-ld=$mold -o $t/exe $t/a.o
+$t/exe | grep -q 'Hello world'
+[ "$(stat -f %i $t/exe)" != $ino ]
+
+# No temporary file is left behind.
+! ls -a $t | grep -q '^\.mold-' || false
+
+echo OK
@@ -0,0 +1,32 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+rm -f $t/exe
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o -Wl,--preload
+! test -e $t/exe || false
+
+# a.o is updated after it was preloaded, so the daemon has to reload it.
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello again\n");
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o
+$t/exe | grep -q 'Hello again'
+
+echo OK
@@ -0,0 +1,44 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+[ "`uname -p`" = arm ] || { echo skipped; exit; }
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+void foo();
+void pad();
+int main(int argc, char **argv) {
+  if (argc > 100)
+    pad();
+  printf("main ");
+  foo();
+  return 0;
+}
+EOF
+
+# Put 144 MiB of code between main and foo so that they cannot
+# reach each other directly.
+cat <<EOF | cc -o $t/b.o -c -xassembler -
+.text
+.globl _pad
+_pad:
+.space 0x9000000
+.subsections_via_symbols
+EOF
+
+cat <<EOF | cc -o $t/c.o -c -xc -
+#include <stdio.h>
+void foo() {
+  printf("foo\n");
+}
+EOF
+
+clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o $t/c.o
+$t/exe | grep -q 'main foo'
+
+echo OK
@@ -0,0 +1,27 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() {
+  printf("Hello world\n");
+}
+EOF
+
+rm -rf $t/cache
+mkdir -p $t/cache
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o -Wl,-tbd_cache_path,$t/cache
+$t/exe1 | grep -q 'Hello world'
+ls $t/cache | grep -q '\.tbd-cache$'
+
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o -Wl,-tbd_cache_path,$t/cache
+$t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
+
+echo OK
@@ -22,7 +22,19 @@ int main() {
 }
 EOF
 
-clang -fuse-ld=$mold -o $t/exe $t/a.o $t/b.o
+clang -fuse-ld=$mold -o $t/exe $t/fat.o $t/b.o
 $t/exe | grep -q 'Hello world'
 
+rm -f $t/c.a
+ar rcs $t/c.a $t/a.o
+lipo $t/c.a -create -output $t/fat.a
+
+clang -fuse-ld=$mold -o $t/exe $t/b.o $t/fat.a
+$t/exe | grep -q 'Hello world'
+
+if lipo $t/a.o -create -fat64 -output $t/fat64.o 2> /dev/null; then
+  clang -fuse-ld=$mold -o $t/exe $t/fat64.o $t/b.o
+  $t/exe | grep -q 'Hello world'
+fi
+
 echo OK
@@ -0,0 +1,32 @@
+#!/bin/bash
+set -e
+cd $(dirname $0)
+mold=`pwd`/../../ld64.mold
+echo -n "Testing $(basename -s .sh $0) ... "
+t=$(pwd)/../../out/test/macho/$(basename -s .sh $0)
+mkdir -p $t
+
+cat <<EOF | cc -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+cat <<EOF | cc -o $t/b.o -c -xc -
+#include <stdio.h>
+int main() { printf("Howdy world\n"); }
+EOF
+
+clang -fuse-ld=$mold -o $t/exe1 $t/a.o
+clang -fuse-ld=$mold -o $t/exe2 $t/a.o
+clang -fuse-ld=$mold -o $t/exe3 $t/b.o
+$t/exe1 | grep -q 'Hello world'
+
+otool -l $t/exe1 | grep uuid > $t/log1
+otool -l $t/exe2 | grep uuid > $t/log2
+otool -l $t/exe3 | grep uuid > $t/log3
+
+! grep -q '00000000-0000-0000-0000-000000000000' $t/log1 || false
+cmp $t/log1 $t/log2
+! cmp $t/log1 $t/log3 > /dev/null || false
+
+echo OK